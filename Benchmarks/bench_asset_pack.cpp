@@ -0,0 +1,260 @@
+// Asset pack loading
+// Writes 256 vertex and index buffers (8 MB in all) both as separate files and as one
+// asset pack (window/asset_pack.h), then compares loading them:
+// - Per file: each file is opened and read into a temporary allocation, then copied into a buffer
+//             allocated at the GPU alignment (WindowBufferCreate)
+// - Pack: the pack is read (mapped on PC) at once, its pointers fixed up, and the buffers made from
+//         the data in place (WindowAssetPackCreateBuffer; on PC, the data is still copied into the
+//         buffer objects)
+// The files were just written, so both are read from the OS cache (PC) or from the SD card cache
+
+#include "benchmarks.h"
+
+#include <window/asset_pack.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define BENCH_PACK_ASSETS   256
+#define BENCH_PACK_ROUNDS   5
+#define BENCH_PACK_FINDS    100000
+
+#ifdef TEST_WIN
+#define BENCH_PACK_DIR ""
+#define BENCH_PACK_PLATFORM WINDOW_PACK_PLATFORM_PC
+#else
+#define BENCH_PACK_DIR "fs:/vol/external01/"
+#define BENCH_PACK_PLATFORM WINDOW_PACK_PLATFORM_WIIU
+#endif
+
+#define BENCH_PACK_PATH BENCH_PACK_DIR "bench_assets.pak"
+
+// Even assets are vertex buffers, odd ones index buffers
+static WindowPackAssetType BenchPackGetType(u32 i)
+{
+    return (i & 1) ? WINDOW_PACK_ASSET_INDEX_BUFFER : WINDOW_PACK_ASSET_VERTEX_BUFFER;
+}
+
+// Sizes from 4 KB to 60 KB, 32 KB on average
+static u32 BenchPackGetSize(u32 i)
+{
+    return (4 + (i * 37) % 57) * 1024;
+}
+
+static void BenchPackGetName(u32 i, char* name, u32 size)
+{
+    std::snprintf(name, size, "asset_%03u", i);
+}
+
+static void BenchPackGetFilePath(u32 i, char* path, u32 size)
+{
+    std::snprintf(path, size, BENCH_PACK_DIR "bench_asset_%03u.bin", i);
+}
+
+// Write each asset to its own file and to the pack
+// Returns false if a file could not be written
+static bool BenchPackWriteFiles()
+{
+    WindowPackWriter* writer = WindowPackWriterCreate(BENCH_PACK_PLATFORM);
+    if (!writer)
+        return false;
+
+    bool success = true;
+    for (u32 i = 0; i < BENCH_PACK_ASSETS && success; i++)
+    {
+        u32 size = BenchPackGetSize(i);
+        u32* data = (u32*)std::malloc(size);
+        if (!data)
+        {
+            success = false;
+            break;
+        }
+
+        for (u32 j = 0; j < size / 4; j++)
+            data[j] = i * 4096 + j;
+
+        WindowPackAssetType type = BenchPackGetType(i);
+        u32 alignment = type == WINDOW_PACK_ASSET_VERTEX_BUFFER ? WINDOW_PACK_ALIGN_VERTEX : WINDOW_PACK_ALIGN_INDEX;
+
+        char name[64];
+        BenchPackGetName(i, name, sizeof(name));
+        u32 offset = WindowPackWriterAppend(writer, data, size, alignment);
+        success = offset != 0 && WindowPackWriterAddEntry(writer, name, type, offset, size, 0);
+
+        char path[256];
+        BenchPackGetFilePath(i, path, sizeof(path));
+        FILE* file = std::fopen(path, "wb");
+        success = success && file && std::fwrite(data, 1, size, file) == size;
+        if (file)
+            success = std::fclose(file) == 0 && success;
+
+        std::free(data);
+    }
+
+    success = success && WindowPackWriterSave(writer, BENCH_PACK_PATH);
+    WindowPackWriterDestroy(writer);
+    return success;
+}
+
+static void BenchPackRemoveFiles()
+{
+    for (u32 i = 0; i < BENCH_PACK_ASSETS; i++)
+    {
+        char path[256];
+        BenchPackGetFilePath(i, path, sizeof(path));
+        std::remove(path);
+    }
+
+    std::remove(BENCH_PACK_PATH);
+}
+
+// Load every asset from its own file
+// Returns the time taken in milliseconds, or a negative value if a file could not be read
+static f64 BenchPackLoadFiles(WindowBuffer** buffers)
+{
+    f64 start = WindowGetTime();
+
+    for (u32 i = 0; i < BENCH_PACK_ASSETS; i++)
+    {
+        char path[256];
+        BenchPackGetFilePath(i, path, sizeof(path));
+
+        FILE* file = std::fopen(path, "rb");
+        if (!file)
+            return -1.0;
+
+        std::fseek(file, 0, SEEK_END);
+        u32 size = (u32)std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+
+        void* data = std::malloc(size);
+        bool read = data && std::fread(data, 1, size, file) == size;
+        std::fclose(file);
+
+        // The copy into memory at the GPU alignment
+        if (read)
+        {
+            WindowBufferType type = BenchPackGetType(i) == WINDOW_PACK_ASSET_VERTEX_BUFFER ? WINDOW_BUFFER_TYPE_VERTEX : WINDOW_BUFFER_TYPE_INDEX;
+            buffers[i] = WindowBufferCreate(type, size, data);
+        }
+
+        std::free(data);
+        if (!read)
+            return -1.0;
+    }
+
+    return (WindowGetTime() - start) * 1000.0;
+}
+
+// Load every asset from the pack
+// Returns the time taken in milliseconds, or a negative value if the pack could not be loaded
+static f64 BenchPackLoadPack(WindowBuffer** buffers, WindowAssetPack** pPack)
+{
+    f64 start = WindowGetTime();
+
+    WindowAssetPack* pack = WindowAssetPackLoad(BENCH_PACK_PATH);
+    if (!pack)
+        return -1.0;
+
+    for (u32 i = 0; i < BENCH_PACK_ASSETS; i++)
+    {
+        char name[64];
+        BenchPackGetName(i, name, sizeof(name));
+
+        buffers[i] = WindowAssetPackCreateBuffer(pack, name);
+    }
+
+    *pPack = pack;
+    return (WindowGetTime() - start) * 1000.0;
+}
+
+static void BenchPackDestroyBuffers(WindowBuffer** buffers)
+{
+    for (u32 i = 0; i < BENCH_PACK_ASSETS; i++)
+    {
+        WindowBufferDestroy(buffers[i]);
+        buffers[i] = NULL;
+    }
+}
+
+void BenchAssetPack()
+{
+    if (!BenchPackWriteFiles())
+    {
+        BenchPrint("Could not write the asset files to \"" BENCH_PACK_DIR "\"");
+        BenchPackRemoveFiles();
+        return;
+    }
+
+    u32 total_size = 0;
+    for (u32 i = 0; i < BENCH_PACK_ASSETS; i++)
+        total_size += BenchPackGetSize(i);
+
+    BenchPrint("  %u assets, %.2f MB, best and average of %u rounds:", BENCH_PACK_ASSETS, total_size / (1024.0 * 1024.0), BENCH_PACK_ROUNDS);
+
+    static WindowBuffer* buffers[BENCH_PACK_ASSETS];
+    f64 files_best = 1e30, files_total = 0.0;
+    f64 pack_best = 1e30, pack_total = 0.0;
+    WindowAssetPackStats stats;
+    std::memset(&stats, 0, sizeof(stats));
+
+    for (u32 round = 0; round < BENCH_PACK_ROUNDS; round++)
+    {
+        f64 files_ms = BenchPackLoadFiles(buffers);
+        BenchPackDestroyBuffers(buffers);
+
+        WindowAssetPack* pack = NULL;
+        f64 pack_ms = BenchPackLoadPack(buffers, &pack);
+
+        if (files_ms < 0.0 || pack_ms < 0.0)
+        {
+            BenchPrint("Could not read the assets back");
+            BenchPackDestroyBuffers(buffers);
+            WindowAssetPackFree(pack);
+            BenchPackRemoveFiles();
+            return;
+        }
+
+        // The buffers use the pack in place on Wii U, so they go first
+        BenchPackDestroyBuffers(buffers);
+        WindowAssetPackGetStats(pack, &stats);
+
+        // Lookups through the hash table, on the last round
+        if (round == BENCH_PACK_ROUNDS - 1)
+        {
+            char names[BENCH_PACK_ASSETS][16];
+            for (u32 i = 0; i < BENCH_PACK_ASSETS; i++)
+                BenchPackGetName(i, names[i], sizeof(names[i]));
+
+            u32 found = 0;
+            f64 start = WindowGetTime();
+            for (u32 i = 0; i < BENCH_PACK_FINDS; i++)
+            {
+                WindowAsset asset;
+                found += WindowAssetPackFind(pack, names[i % BENCH_PACK_ASSETS], &asset) ? 1 : 0;
+            }
+            f64 find_ns = (WindowGetTime() - start) * 1e9 / BENCH_PACK_FINDS;
+
+            BenchPrint("  find: %.1f ns per lookup (%u of %u found)", find_ns, found, BENCH_PACK_FINDS);
+        }
+
+        WindowAssetPackFree(pack);
+
+        files_total += files_ms;
+        pack_total += pack_ms;
+        if (files_ms < files_best)
+            files_best = files_ms;
+        if (pack_ms < pack_best)
+            pack_best = pack_ms;
+    }
+
+    BenchPrint("  per file: %7.2f ms (avg %7.2f ms), %u opens and reads, %u copies", files_best,
+               files_total / BENCH_PACK_ROUNDS, BENCH_PACK_ASSETS, BENCH_PACK_ASSETS);
+    BenchPrint("  pack:     %7.2f ms (avg %7.2f ms), 1 %s of %.2f MB, %u fixups (%.3f ms), %u entries", pack_best,
+               pack_total / BENCH_PACK_ROUNDS, stats.mapped ? "mapping" : "read", stats.size / (1024.0 * 1024.0),
+               stats.num_fixups, stats.fixup_ms, stats.num_entries);
+    BenchPrint("  speedup:  %.2fx", files_best / pack_best);
+
+    BenchPackRemoveFiles();
+}
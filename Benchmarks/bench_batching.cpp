@@ -0,0 +1,227 @@
+// Batching
+// Draws thousands of small meshes per frame, first with one attribute buffer binding and one draw
+// per mesh, then packed once into a static batch, then packed again every frame into a dynamic batch
+// (see window/batcher.h), and reports the draws issued and saved and the CPU time per frame
+
+#include "benchmarks.h"
+
+#include <window/batcher.h>
+#include <window/buffer.h>
+#include <window/shader_mode.h>
+
+#ifdef TEST_WIN
+#include <GL/glew.h>
+#else
+#include <gx2/event.h>
+#endif
+
+#include <cmath>
+
+#define BENCH_BATCH_MESHES      2048
+#define BENCH_BATCH_FRAMES      60
+
+// Each mesh is a small hexagon (a center and 6 corners)
+#define BENCH_BATCH_VERTICES    7
+#define BENCH_BATCH_INDICES     18
+
+static u32 sBenchBatchIndices[BENCH_BATCH_INDICES];
+
+static void BenchBatchWriteIndices()
+{
+    for (u32 i = 0; i < 6; i++)
+    {
+        sBenchBatchIndices[i * 3 + 0] = 0;
+        sBenchBatchIndices[i * 3 + 1] = 1 + i;
+        sBenchBatchIndices[i * 3 + 2] = 1 + (i + 1) % 6;
+    }
+}
+
+// Write the vertices of a mesh, placed on a grid and drifting with the frame number
+static void BenchBatchWriteVertices(f32* pos, u32 mesh, u32 frame)
+{
+    const u32 columns = 64;
+    const f32 radius = 0.012f;
+
+    f32 cx = -0.95f + (f32)(mesh % columns) * (1.9f / columns) + std::sin((f32)(mesh + frame) * 0.05f) * 0.005f;
+    f32 cy = -0.95f + (f32)(mesh / columns) * (1.9f * columns / BENCH_BATCH_MESHES);
+
+    *pos++ = cx;
+    *pos++ = cy;
+    *pos++ = 0.0f;
+
+    for (u32 i = 0; i < 6; i++)
+    {
+        f32 angle = (f32)i * (6.2831853f / 6.0f);
+        *pos++ = cx + std::cos(angle) * radius;
+        *pos++ = cy + std::sin(angle) * radius;
+        *pos++ = 0.0f;
+    }
+}
+
+// Run frames with the given draw function, and print the average CPU time spent drawing
+static void BenchBatchRun(const char* name, void (*draw)(void*, u32), void* user_data, u32 draws_per_frame, u32 draws_saved)
+{
+    f64 draw_ms = 0.0;
+    f64 start_time = WindowGetTime();
+
+    for (u32 frame = 0; frame < BENCH_BATCH_FRAMES; frame++)
+    {
+        BenchClear(0.2f, 0.3f, 0.3f);
+
+        f64 t0 = WindowGetTime();
+        draw(user_data, frame);
+        draw_ms += (WindowGetTime() - t0) * 1000.0;
+
+        WindowSwapBuffers();
+    }
+
+    f64 frame_ms = (WindowGetTime() - start_time) * 1000.0 / BENCH_BATCH_FRAMES;
+
+    BenchPrint("%s: %u draws per frame (%u saved), CPU %.3f ms, frame %.3f ms", name, draws_per_frame, draws_saved,
+               draw_ms / BENCH_BATCH_FRAMES, frame_ms);
+}
+
+// One buffer and one draw per mesh
+struct BenchBatchMeshes
+{
+    WindowBuffer* vertex_buffers[BENCH_BATCH_MESHES];
+    WindowBuffer* index_buffer;
+#ifdef TEST_WIN
+    u32 vertex_arrays[BENCH_BATCH_MESHES];
+#endif
+};
+
+static void BenchBatchDrawMeshes(void* user_data, u32 frame)
+{
+    BenchBatchMeshes* meshes = (BenchBatchMeshes*)user_data;
+    (void)frame;
+
+    for (u32 i = 0; i < BENCH_BATCH_MESHES; i++)
+    {
+#ifdef TEST_WIN
+        glBindVertexArray(meshes->vertex_arrays[i]);
+#else
+        WindowSetVertexBuffer(0, meshes->vertex_buffers[i], 3 * sizeof(f32));
+#endif
+        WindowDrawIndexed(BENCH_BATCH_INDICES, 0);
+    }
+}
+
+static void BenchBatchDrawStatic(void* user_data, u32 frame)
+{
+    (void)frame;
+
+    WindowBatcherDraw((WindowBatcher*)user_data);
+}
+
+static void BenchBatchDrawDynamic(void* user_data, u32 frame)
+{
+    WindowBatcher* batcher = (WindowBatcher*)user_data;
+
+    // Every mesh is written again, straight into the batch
+    WindowBatcherBegin(batcher);
+    for (u32 i = 0; i < BENCH_BATCH_MESHES; i++)
+    {
+        f32* pos = (f32*)WindowBatcherAdd(batcher, NULL, BENCH_BATCH_VERTICES, sBenchBatchIndices, BENCH_BATCH_INDICES);
+        if (!pos)
+            break;
+
+        BenchBatchWriteVertices(pos, i, frame);
+    }
+
+    WindowBatcherDraw(batcher);
+}
+
+void BenchBatching()
+{
+    BenchBatchWriteIndices();
+
+    WindowShaderSet shaders;
+    u32 offset_location;
+    BenchCreateTriangleShaders(&shaders, &offset_location);
+    WindowSetShaders(&shaders);
+
+#ifdef TEST_WIN
+    glUniform4f(offset_location, 0.0f, 0.0f, 0.0f, 1.0f);
+#endif
+
+    BenchPrint("%u meshes of %u vertices and %u indices per frame", BENCH_BATCH_MESHES, BENCH_BATCH_VERTICES, BENCH_BATCH_INDICES);
+
+    // Unbatched: what every test in the repository does, one attribute buffer and one draw per mesh
+    static BenchBatchMeshes meshes;
+    meshes.index_buffer = WindowBufferCreate(WINDOW_BUFFER_TYPE_INDEX, sizeof(sBenchBatchIndices), sBenchBatchIndices);
+    for (u32 i = 0; i < BENCH_BATCH_MESHES; i++)
+    {
+        f32 pos[BENCH_BATCH_VERTICES * 3];
+        BenchBatchWriteVertices(pos, i, 0);
+        meshes.vertex_buffers[i] = WindowBufferCreate(WINDOW_BUFFER_TYPE_VERTEX, sizeof(pos), pos);
+
+#ifdef TEST_WIN
+        glGenVertexArrays(1, &meshes.vertex_arrays[i]);
+        glBindVertexArray(meshes.vertex_arrays[i]);
+
+        WindowSetVertexBuffer(0, meshes.vertex_buffers[i], 3 * sizeof(f32));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(f32), (void*)0);
+
+        WindowSetIndexBuffer(meshes.index_buffer);
+#endif
+    }
+#ifdef TEST_GX2
+    WindowSetIndexBuffer(meshes.index_buffer);
+#endif
+
+    BenchBatchRun("Unbatched", BenchBatchDrawMeshes, &meshes, BENCH_BATCH_MESHES, 0);
+
+    // Batched: the same meshes with the same layout and shaders, one draw
+    WindowBatchLayout layout;
+    layout.stride = 3 * sizeof(f32);
+    layout.num_attribs = 1;
+    layout.attribs[0].location = 0;
+    layout.attribs[0].components = 3;
+    layout.attribs[0].offset = 0;
+
+    WindowBatcher* static_batcher = WindowBatcherCreate(&layout, BENCH_BATCH_MESHES * BENCH_BATCH_VERTICES, BENCH_BATCH_MESHES * BENCH_BATCH_INDICES, false);
+    WindowBatcher* dynamic_batcher = WindowBatcherCreate(&layout, BENCH_BATCH_MESHES * BENCH_BATCH_VERTICES, BENCH_BATCH_MESHES * BENCH_BATCH_INDICES, true);
+    if (!static_batcher || !dynamic_batcher)
+    {
+        BenchPrint("Could not create the batchers");
+    }
+    else
+    {
+        f64 t0 = WindowGetTime();
+
+        WindowBatcherBegin(static_batcher);
+        for (u32 i = 0; i < BENCH_BATCH_MESHES; i++)
+        {
+            f32 pos[BENCH_BATCH_VERTICES * 3];
+            BenchBatchWriteVertices(pos, i, 0);
+            WindowBatcherAdd(static_batcher, pos, BENCH_BATCH_VERTICES, sBenchBatchIndices, BENCH_BATCH_INDICES);
+        }
+
+        BenchPrint("Static batch built in %.3f ms", (WindowGetTime() - t0) * 1000.0);
+
+        BenchBatchRun("Static batch", BenchBatchDrawStatic, static_batcher, 1, BENCH_BATCH_MESHES - 1);
+        BenchBatchRun("Dynamic batch", BenchBatchDrawDynamic, dynamic_batcher, 1, BENCH_BATCH_MESHES - 1);
+
+        WindowBatcherStats stats;
+        WindowBatcherGetStats(dynamic_batcher, &stats);
+        BenchPrint("  Dynamic batch: %u vertices, %u indices, %u draws saved in %u frames, %u fence waits, %u failed adds",
+                   stats.vertices, stats.indices, stats.draws_saved, stats.draws, stats.fence_waits, stats.failed_adds);
+    }
+
+#ifdef TEST_WIN
+    glBindVertexArray(GL_NONE);
+    glDeleteVertexArrays(BENCH_BATCH_MESHES, meshes.vertex_arrays);
+#else
+    // The GPU must be done with the buffers before they are freed
+    GX2DrawDone();
+#endif
+
+    WindowBatcherDestroy(static_batcher);
+    WindowBatcherDestroy(dynamic_batcher);
+
+    for (u32 i = 0; i < BENCH_BATCH_MESHES; i++)
+        WindowBufferDestroy(meshes.vertex_buffers[i]);
+    WindowBufferDestroy(meshes.index_buffer);
+}
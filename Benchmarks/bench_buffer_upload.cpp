@@ -0,0 +1,233 @@
+// Buffer upload
+// Draws a static grid mesh many times per frame and rewrites a dynamic copy of it every frame,
+// with the buffers created in each mode (see window/buffer.h), and compares the CPU cost and the bytes
+// copied to the GPU
+// - Client: the index buffer is passed as a client pointer, so every draw copies it
+// - Copy: glBufferData / glBufferSubData copies from CPU memory
+// - Persistent: persistently-mapped buffers written in place, like the Wii U shared memory
+// On Wii U, buffers are always in shared memory, so only one mode is measured
+
+#include "benchmarks.h"
+
+#include <window/buffer.h>
+#include <window/coherency.h>
+#include <window/shader_mode.h>
+
+#ifdef TEST_WIN
+#include <GL/glew.h>
+#else
+#include <gx2/event.h>
+#endif
+
+#include <cmath>
+
+#define BENCH_BUFFER_GRID       64  // Quads per side of the grid
+#define BENCH_BUFFER_DRAWS      64  // Draws of the static grid per frame
+#define BENCH_BUFFER_FRAMES     30
+
+#define BENCH_BUFFER_VERTICES   ((BENCH_BUFFER_GRID + 1) * (BENCH_BUFFER_GRID + 1))
+#define BENCH_BUFFER_INDICES    (BENCH_BUFFER_GRID * BENCH_BUFFER_GRID * 6)
+
+// Write the grid vertices (a small square in the middle of the screen, rippling with the frame number)
+static void BenchBufferWriteVertices(f32* pos, u32 frame)
+{
+    const f32 size = 0.2f;
+    const f32 step = size / BENCH_BUFFER_GRID;
+    const f32 ripple = std::sin((f32)frame * 0.1f) * step * 0.25f;
+
+    for (u32 y = 0; y <= BENCH_BUFFER_GRID; y++)
+    {
+        for (u32 x = 0; x <= BENCH_BUFFER_GRID; x++)
+        {
+            *pos++ = -size * 0.5f + (f32)x * step + ((y & 1) ? ripple : -ripple);
+            *pos++ = -size * 0.5f + (f32)y * step;
+            *pos++ = 0.0f;
+        }
+    }
+}
+
+static void BenchBufferWriteIndices(u32* idx)
+{
+    for (u32 y = 0; y < BENCH_BUFFER_GRID; y++)
+    {
+        for (u32 x = 0; x < BENCH_BUFFER_GRID; x++)
+        {
+            u32 i = y * (BENCH_BUFFER_GRID + 1) + x;
+
+            *idx++ = i;
+            *idx++ = i + 1;
+            *idx++ = i + BENCH_BUFFER_GRID + 1;
+            *idx++ = i + 1;
+            *idx++ = i + BENCH_BUFFER_GRID + 2;
+            *idx++ = i + BENCH_BUFFER_GRID + 1;
+        }
+    }
+}
+
+static const char* BenchBufferModeName(WindowBufferMode mode)
+{
+    switch (mode)
+    {
+    case WINDOW_BUFFER_MODE_CLIENT:     return "Client";
+    case WINDOW_BUFFER_MODE_COPY:       return "Copy";
+    case WINDOW_BUFFER_MODE_PERSISTENT: return "Persistent";
+    }
+    return "?";
+}
+
+struct BenchBufferMesh
+{
+    WindowBuffer* vertex_buffer;
+#ifdef TEST_WIN
+    u32 vertex_array;
+#endif
+};
+
+static void BenchBufferSetMesh(const BenchBufferMesh* mesh)
+{
+#ifdef TEST_WIN
+    // The vertex array object holds the vertex buffer and the index buffer
+    glBindVertexArray(mesh->vertex_array);
+#else
+    WindowSetVertexBuffer(0, mesh->vertex_buffer, 3 * sizeof(f32));
+#endif
+}
+
+static void BenchBufferRun(WindowBufferMode mode, const f32* pos_data, const u32* idx_data)
+{
+    if (!WindowSetBufferMode(mode))
+    {
+        BenchPrint("%s: not supported", BenchBufferModeName(mode));
+        return;
+    }
+
+    // One static mesh, and a dynamic one double-buffered so that the CPU never writes the vertices
+    // the GPU may still be reading
+    WindowBuffer* index_buffer = WindowBufferCreate(WINDOW_BUFFER_TYPE_INDEX, BENCH_BUFFER_INDICES * sizeof(u32), idx_data);
+    BenchBufferMesh meshes[3];
+    for (u32 i = 0; i < 3; i++)
+        meshes[i].vertex_buffer = WindowBufferCreate(WINDOW_BUFFER_TYPE_VERTEX, BENCH_BUFFER_VERTICES * 3 * sizeof(f32), i == 0 ? pos_data : NULL);
+
+    if (!index_buffer || !meshes[0].vertex_buffer || !meshes[1].vertex_buffer || !meshes[2].vertex_buffer)
+    {
+        BenchPrint("%s: could not create the buffers", BenchBufferModeName(mode));
+
+        WindowBufferDestroy(index_buffer);
+        for (u32 i = 0; i < 3; i++)
+            WindowBufferDestroy(meshes[i].vertex_buffer);
+        return;
+    }
+
+#ifdef TEST_WIN
+    for (u32 i = 0; i < 3; i++)
+    {
+        glGenVertexArrays(1, &meshes[i].vertex_array);
+        glBindVertexArray(meshes[i].vertex_array);
+
+        WindowSetVertexBuffer(0, meshes[i].vertex_buffer, 3 * sizeof(f32));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(f32), (void*)0);
+
+        // Bound once per vertex array object
+        WindowSetIndexBuffer(index_buffer);
+    }
+#else
+    WindowSetIndexBuffer(index_buffer);
+#endif
+
+    WindowBufferStats start_stats;
+    WindowGetBufferStats(&start_stats);
+
+    f64 static_ms = 0.0, dynamic_ms = 0.0;
+    f64 start_time = WindowGetTime();
+
+    for (u32 frame = 0; frame < BENCH_BUFFER_FRAMES; frame++)
+    {
+        BenchClear(0.2f, 0.3f, 0.3f);
+
+        // Static mesh: the same indices, drawn many times
+        f64 t0 = WindowGetTime();
+
+        BenchBufferSetMesh(&meshes[0]);
+        for (u32 i = 0; i < BENCH_BUFFER_DRAWS; i++)
+            WindowDrawIndexed(BENCH_BUFFER_INDICES, 0);
+
+        // Dynamic mesh: the vertices are rewritten every frame
+        f64 t1 = WindowGetTime();
+
+        BenchBufferMesh* dynamic = &meshes[1 + (frame & 1)];
+        BenchBufferWriteVertices((f32*)dynamic->vertex_buffer->data, frame);
+        COHERENCY_CPU_WRITE(dynamic->vertex_buffer->data, dynamic->vertex_buffer->size);
+        WindowBufferFlush(dynamic->vertex_buffer, 0, dynamic->vertex_buffer->size);
+
+        BenchBufferSetMesh(dynamic);
+        WindowDrawIndexed(BENCH_BUFFER_INDICES, 0);
+
+        f64 t2 = WindowGetTime();
+        static_ms += (t1 - t0) * 1000.0;
+        dynamic_ms += (t2 - t1) * 1000.0;
+
+        WindowSwapBuffers();
+    }
+
+    f64 frame_ms = (WindowGetTime() - start_time) * 1000.0 / BENCH_BUFFER_FRAMES;
+
+    WindowBufferStats stats;
+    WindowGetBufferStats(&stats);
+
+    BenchPrint(
+        "%s: static draws %.3f ms, dynamic update %.3f ms, frame %.3f ms, %.1f KB copied per frame",
+        BenchBufferModeName(index_buffer->mode),
+        static_ms / BENCH_BUFFER_FRAMES,
+        dynamic_ms / BENCH_BUFFER_FRAMES,
+        frame_ms,
+        (f64)(stats.copied_bytes - start_stats.copied_bytes) / 1024.0 / BENCH_BUFFER_FRAMES
+    );
+
+#ifdef TEST_WIN
+    glBindVertexArray(GL_NONE);
+    for (u32 i = 0; i < 3; i++)
+        glDeleteVertexArrays(1, &meshes[i].vertex_array);
+#else
+    // The GPU must be done with the buffers before they are freed
+    GX2DrawDone();
+#endif
+
+    WindowBufferDestroy(index_buffer);
+    for (u32 i = 0; i < 3; i++)
+        WindowBufferDestroy(meshes[i].vertex_buffer);
+}
+
+void BenchBufferUpload()
+{
+    static f32 pos_data[BENCH_BUFFER_VERTICES * 3];
+    static u32 idx_data[BENCH_BUFFER_INDICES];
+    BenchBufferWriteVertices(pos_data, 0);
+    BenchBufferWriteIndices(idx_data);
+
+    WindowShaderSet shaders;
+    u32 offset_location;
+    BenchCreateTriangleShaders(&shaders, &offset_location);
+    WindowSetShaders(&shaders);
+
+#ifdef TEST_WIN
+    glUniform4f(offset_location, 0.0f, 0.0f, 0.0f, 1.0f);
+#endif
+
+    BenchPrint(
+        "%u-vertex grid, %u KB of indices, drawn %u times per frame, plus one dynamic copy rewritten every frame",
+        BENCH_BUFFER_VERTICES, (u32)(BENCH_BUFFER_INDICES * sizeof(u32) / 1024), BENCH_BUFFER_DRAWS
+    );
+
+    WindowBufferMode default_mode = WindowGetBufferMode();
+
+#ifdef TEST_WIN
+    BenchBufferRun(WINDOW_BUFFER_MODE_CLIENT, pos_data, idx_data);
+    BenchBufferRun(WINDOW_BUFFER_MODE_COPY, pos_data, idx_data);
+    BenchBufferRun(WINDOW_BUFFER_MODE_PERSISTENT, pos_data, idx_data);
+#else
+    BenchBufferRun(WINDOW_BUFFER_MODE_PERSISTENT, pos_data, idx_data);
+#endif
+
+    WindowSetBufferMode(default_mode);
+}
@@ -0,0 +1,134 @@
+// Command generation scaling
+// Records the same frame of many small draws (each with some CPU work to compute its uniforms)
+// with 1, 2, 3 and (on PC) as many workers as there are hardware threads
+
+#include "benchmarks.h"
+
+#include <window/cmd_list.h>
+#include <window/jobs.h>
+
+#include <cmath>
+#include <thread>
+
+#define BENCH_CMD_DRAWS     10000
+#define BENCH_CMD_FRAMES    60
+#define BENCH_CMD_LIST_SIZE 0x200000
+
+struct BenchCmdFrame
+{
+    WindowShaderSet shaders;
+    WindowVertexInput input;
+    u32 offset_location;
+    u32 frame;
+};
+
+// Stand-in for per-object work (culling, animation, matrix setup...)
+static void BenchCmdComputeOffset(u32 draw, u32 frame, f32* offset)
+{
+    f32 angle = (f32)(draw * 7 + frame) * 0.001f;
+    f32 radius = 0.0f;
+    for (u32 i = 0; i < 64; i++)
+        radius += std::sin(angle + (f32)i) * (1.0f / 64.0f);
+
+    offset[0] = std::cos(angle) * (0.5f + radius * 0.25f);
+    offset[1] = std::sin(angle) * (0.5f + radius * 0.25f);
+    offset[2] = 0.0f;
+    offset[3] = 0.05f;
+}
+
+static void BenchCmdRecordList(WindowCmdList* cmd_list, u32 index, u32 count, void* user_data)
+{
+    BenchCmdFrame* frame = (BenchCmdFrame*)user_data;
+
+    WindowCmdSetShaders(cmd_list, &frame->shaders);
+    WindowCmdSetVertexInput(cmd_list, &frame->input);
+
+    u32 begin, end;
+    JobsSplitRange(BENCH_CMD_DRAWS, index, count, &begin, &end);
+
+    for (u32 i = begin; i < end; i++)
+    {
+        f32 offset[4];
+        BenchCmdComputeOffset(i, frame->frame, offset);
+
+        WindowCmdSetVertexUniforms(cmd_list, frame->offset_location, 1, offset);
+        WindowCmdDraw(cmd_list, 3, 0);
+    }
+}
+
+void BenchCmdScaling()
+{
+    BenchCmdFrame frame;
+    BenchCreateTriangleShaders(&frame.shaders, &frame.offset_location);
+    BenchCreateTriangleInput(&frame.input);
+
+    u32 worker_counts[4] = { 1, 2, 3, 0 };
+    u32 num_configs = 3;
+
+#ifdef TEST_WIN
+    u32 hw_threads = std::thread::hardware_concurrency();
+    if (hw_threads > 3)
+    {
+        worker_counts[3] = hw_threads < JOBS_MAX_WORKERS ? hw_threads : JOBS_MAX_WORKERS;
+        num_configs = 4;
+    }
+#endif
+
+    f64 base_frame_ms = 0.0;
+
+    for (u32 config = 0; config < num_configs; config++)
+    {
+        u32 num_workers = worker_counts[config];
+
+        if (!JobsInit(num_workers))
+        {
+            BenchPrint("%u workers: could not start the job pool", num_workers);
+            continue;
+        }
+
+        if (!WindowCmdInit(num_workers, BENCH_CMD_LIST_SIZE))
+        {
+            BenchPrint("%u workers: could not create the command lists", num_workers);
+            JobsExit();
+            continue;
+        }
+
+        f64 record_ms = 0.0, submit_ms = 0.0;
+        WindowCmdStats stats;
+
+        f64 start_time = WindowGetTime();
+
+        for (u32 i = 0; i < BENCH_CMD_FRAMES; i++)
+        {
+            frame.frame = i;
+
+            BenchClear(0.2f, 0.3f, 0.3f);
+
+            WindowCmdRecord(BenchCmdRecordList, &frame);
+            WindowCmdSubmit();
+
+            WindowSwapBuffers();
+
+            WindowCmdGetStats(&stats);
+            record_ms += stats.record_ms;
+            submit_ms += stats.submit_ms;
+        }
+
+        f64 frame_ms = (WindowGetTime() - start_time) * 1000.0 / BENCH_CMD_FRAMES;
+        if (config == 0)
+            base_frame_ms = frame_ms;
+
+        BenchPrint(
+            "%u workers: record %.3f ms, submit %.3f ms, frame %.3f ms (x%.2f), %u bytes/frame",
+            stats.num_workers,
+            record_ms / BENCH_CMD_FRAMES,
+            submit_ms / BENCH_CMD_FRAMES,
+            frame_ms,
+            base_frame_ms / frame_ms,
+            stats.bytes_used
+        );
+
+        WindowCmdExit();
+        JobsExit();
+    }
+}
@@ -0,0 +1,253 @@
+// Helpers shared by the benchmarks
+
+#include "benchmarks.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+#include <iostream>
+
+#else // TEST_GX2
+
+#include "../Test3_Hello_Triangle/triangle_gx2.hpp"
+
+#include <coreinit/debug.h>
+#include <coreinit/memdefaultheap.h>
+#include <gx2/clear.h>
+#include <gx2/mem.h>
+
+#endif
+
+// Positions of the triangle vertices
+// (Aligned and static since the GPU reads it directly on Wii U)
+__attribute__((aligned(0x40))) static const f32 sTrianglePosData[] = {
+    -0.5f, -0.5f, 0.0f,
+     0.5f, -0.5f, 0.0f,
+     0.0f,  0.5f, 0.0f
+};
+
+void BenchPrint(const char* fmt, ...)
+{
+    char line[512];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+#ifdef TEST_WIN
+    std::printf("%s\n", line);
+    std::fflush(stdout);
+#else
+    OSReport("%s\n", line);
+#endif
+}
+
+void BenchClear(f32 r, f32 g, f32 b)
+{
+#ifdef TEST_WIN
+    glClearColor(r, g, b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+#else
+    GX2ClearColor(WindowGetColorBuffer(), r, g, b, 1.0f);
+    WindowMakeContextCurrent();
+#endif
+}
+
+#ifdef TEST_WIN
+
+static u32 BenchCompileShader(u32 type, const char* src)
+{
+    u32 shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, NULL);
+    glCompileShader(shader);
+
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+
+    return shader;
+}
+
+#endif // TEST_WIN
+
+void BenchCreateTriangleShaders(WindowShaderSet* pShaders, u32* pOffsetLocation)
+{
+#ifdef TEST_WIN
+
+    const char* vertex_shader_src =
+        "#version 330 core\n"
+        "layout(location = 0) in vec3 v_inPos;\n"
+        "uniform vec4 u_offset;\n\n"
+
+        "void main()\n"
+        "{\n"
+        "    gl_Position = vec4(v_inPos * u_offset.w + u_offset.xyz, 1.0);\n"
+        "}\n";
+
+    const char* fragment_shader_src =
+        "#version 330 core\n"
+        "out vec4 o_FragColor;\n\n"
+
+        "void main()\n"
+        "{\n"
+        "    o_FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
+        "}\n";
+
+    u32 vertex_shader = BenchCompileShader(GL_VERTEX_SHADER, vertex_shader_src);
+    u32 fragment_shader = BenchCompileShader(GL_FRAGMENT_SHADER, fragment_shader_src);
+
+    pShaders->program = glCreateProgram();
+    glAttachShader(pShaders->program, vertex_shader);
+    glAttachShader(pShaders->program, fragment_shader);
+    glLinkProgram(pShaders->program);
+
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    glUseProgram(pShaders->program);
+
+    if (pOffsetLocation)
+        *pOffsetLocation = glGetUniformLocation(pShaders->program, "u_offset");
+
+#else // TEST_GX2
+
+    GX2Invalidate(GX2_INVALIDATE_MODE_CPU_SHADER, triangle_VSH.program, triangle_VSH.size);
+    GX2Invalidate(GX2_INVALIDATE_MODE_CPU_SHADER, triangle_PSH.program, triangle_PSH.size);
+
+    // Same fetch shader as Test 3
+    GX2AttribStream pos_stream;
+    pos_stream.location = 0;
+    pos_stream.buffer = 0;
+    pos_stream.offset = 0;
+    pos_stream.format = GX2_ATTRIB_FORMAT_FLOAT_32_32_32;
+    pos_stream.mask = GX2_SEL_MASK(GX2_SQ_SEL_X, GX2_SQ_SEL_Y, GX2_SQ_SEL_Z, GX2_SQ_SEL_1);
+    pos_stream.endianSwap = GX2_ENDIAN_SWAP_DEFAULT;
+    pos_stream.type = GX2_ATTRIB_INDEX_PER_VERTEX;
+    pos_stream.aluDivisor = 0;
+
+    static GX2FetchShader triangle_FSH;
+
+    u32 triangle_FSH_size = GX2CalcFetchShaderSizeEx(
+        1,
+        GX2_FETCH_SHADER_TESSELLATION_NONE,
+        GX2_TESSELLATION_MODE_DISCRETE
+    );
+    void* triangle_FSH_program = MEMAllocFromDefaultHeapEx(
+        triangle_FSH_size,
+        GX2_SHADER_PROGRAM_ALIGNMENT
+    );
+
+    GX2InitFetchShaderEx(
+        &triangle_FSH,
+        (u8*)triangle_FSH_program,
+        1,
+        &pos_stream,
+        GX2_FETCH_SHADER_TESSELLATION_NONE,
+        GX2_TESSELLATION_MODE_DISCRETE
+    );
+
+    GX2Invalidate(GX2_INVALIDATE_MODE_CPU_SHADER, triangle_FSH.program, triangle_FSH.size);
+
+    WindowSetShaderMode(WINDOW_SHADER_MODE_UNIFORM_REGISTER);
+
+    pShaders->fetch_shader = &triangle_FSH;
+    pShaders->vertex_shader = &triangle_VSH;
+    pShaders->pixel_shader = &triangle_PSH;
+
+    // The compiled Test 3 vertex shader has no uniforms, so writing the first register is harmless
+    if (pOffsetLocation)
+        *pOffsetLocation = 0;
+
+#endif
+}
+
+void BenchCreateTriangleBlockShaders(WindowShaderSet* pShaders)
+{
+#ifdef TEST_WIN
+
+    const char* vertex_shader_src =
+        "#version 330 core\n"
+        "layout(location = 0) in vec3 v_inPos;\n"
+        "layout(std140) uniform Object\n"
+        "{\n"
+        "    vec4 u_offset;\n"
+        "};\n\n"
+
+        "void main()\n"
+        "{\n"
+        "    gl_Position = vec4(v_inPos * u_offset.w + u_offset.xyz, 1.0);\n"
+        "}\n";
+
+    const char* fragment_shader_src =
+        "#version 330 core\n"
+        "out vec4 o_FragColor;\n\n"
+
+        "void main()\n"
+        "{\n"
+        "    o_FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
+        "}\n";
+
+    u32 vertex_shader = BenchCompileShader(GL_VERTEX_SHADER, vertex_shader_src);
+    u32 fragment_shader = BenchCompileShader(GL_FRAGMENT_SHADER, fragment_shader_src);
+
+    pShaders->program = glCreateProgram();
+    glAttachShader(pShaders->program, vertex_shader);
+    glAttachShader(pShaders->program, fragment_shader);
+    glLinkProgram(pShaders->program);
+
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    // Vertex shader block 0
+    u32 block_index = glGetUniformBlockIndex(pShaders->program, "Object");
+    if (block_index != GL_INVALID_INDEX)
+        glUniformBlockBinding(pShaders->program, block_index, 0);
+
+    glUseProgram(pShaders->program);
+
+#else // TEST_GX2
+
+    // There is no compiled uniform block version of the Test 3 shaders; since they have no uniforms,
+    // the same shaders work in uniform block mode (the bound blocks are simply not read)
+    BenchCreateTriangleShaders(pShaders, NULL);
+
+    WindowSetShaderMode(WINDOW_SHADER_MODE_UNIFORM_BLOCK);
+
+#endif
+}
+
+void BenchCreateTriangleInput(WindowVertexInput* pInput)
+{
+#ifdef TEST_WIN
+
+    glGenVertexArrays(1, &pInput->vertex_array);
+    glBindVertexArray(pInput->vertex_array);
+
+    u32 VBO;
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(sTrianglePosData), sTrianglePosData, GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+
+#else // TEST_GX2
+
+    GX2Invalidate(GX2_INVALIDATE_MODE_CPU_ATTRIBUTE_BUFFER, (void*)sTrianglePosData, sizeof(sTrianglePosData));
+
+    pInput->slot = 0;
+    pInput->size = sizeof(sTrianglePosData);
+    pInput->stride = 3 * sizeof(float);
+    pInput->data = sTrianglePosData;
+
+#endif
+}
@@ -0,0 +1,156 @@
+// Frustum culling
+// Culls 100k and 1M bounding spheres scattered around the camera against its view frustum
+// (window/culling.h), with each implementation on one thread, then with the best one on every worker,
+// and reports the time per frame and the visible objects
+
+#include "benchmarks.h"
+
+#include <window/culling.h>
+#include <window/jobs.h>
+
+#include <cmath>
+#include <vector>
+
+#define BENCH_CULL_MAX_OBJECTS  1000000
+#define BENCH_CULL_FRAMES       16
+#define BENCH_CULL_WORLD_SIZE   200.0f
+
+static const char* BenchCullPathName(WindowCullPath path)
+{
+    switch (path)
+    {
+    case WINDOW_CULL_PATH_SCALAR:   return "Scalar";
+    case WINDOW_CULL_PATH_SSE:      return "SSE";
+    case WINDOW_CULL_PATH_AVX:      return "AVX";
+    }
+    return "?";
+}
+
+// View-projection matrix of a camera at the origin, turning around the Y axis with the frame number
+// (column-major, 60 degree vertical field of view, 16:9)
+static void BenchCullViewProj(u32 frame, f32* m)
+{
+    const f32 near_z = 0.1f, far_z = BENCH_CULL_WORLD_SIZE * 0.75f;
+    const f32 f = 1.0f / std::tan(30.0f * 3.14159265f / 180.0f);
+    const f32 aspect = 16.0f / 9.0f;
+
+    f32 angle = (f32)frame * 0.1f;
+    f32 c = std::cos(angle), s = std::sin(angle);
+
+    // Projection * rotation around Y
+    f32 a = f / aspect;
+    f32 b = (far_z + near_z) / (near_z - far_z);
+    f32 d = 2.0f * far_z * near_z / (near_z - far_z);
+
+    const f32 result[16] = {
+        a * c, 0.0f, -b * s,  s,
+        0.0f,  f,    0.0f,    0.0f,
+        a * s, 0.0f, b * c,   -c,
+        0.0f,  0.0f, d,       0.0f
+    };
+    for (u32 i = 0; i < 16; i++)
+        m[i] = result[i];
+}
+
+// Cull the scene for a few frames and return the average time
+static f64 BenchCullRun(const WindowCullBounds* bounds, u32* visible, u32* pVisible)
+{
+    f64 total_ms = 0.0;
+    u32 total_visible = 0;
+
+    for (u32 frame = 0; frame < BENCH_CULL_FRAMES; frame++)
+    {
+        f32 view_proj[16];
+        BenchCullViewProj(frame, view_proj);
+
+        WindowFrustum frustum;
+        WindowFrustumFromMatrix(&frustum, view_proj);
+
+        total_visible += WindowCull(&frustum, bounds, visible);
+
+        WindowCullStats stats;
+        WindowCullGetStats(&stats);
+        total_ms += stats.cull_ms;
+    }
+
+    *pVisible = total_visible / BENCH_CULL_FRAMES;
+    return total_ms / BENCH_CULL_FRAMES;
+}
+
+void BenchCulling()
+{
+    WindowCullBounds bounds;
+    if (!WindowCullBoundsInit(&bounds, BENCH_CULL_MAX_OBJECTS))
+    {
+        BenchPrint("Could not allocate the bounds");
+        return;
+    }
+
+    std::vector<u32> visible(BENCH_CULL_MAX_OBJECTS);
+
+    // Deterministic scatter
+    u32 seed = 1;
+    for (u32 i = 0; i < BENCH_CULL_MAX_OBJECTS; i++)
+    {
+        f32 values[4];
+        for (u32 j = 0; j < 4; j++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            values[j] = (f32)(seed >> 8) / (f32)(1 << 24);
+        }
+
+        bounds.x[i] = (values[0] - 0.5f) * BENCH_CULL_WORLD_SIZE;
+        bounds.y[i] = (values[1] - 0.5f) * BENCH_CULL_WORLD_SIZE;
+        bounds.z[i] = (values[2] - 0.5f) * BENCH_CULL_WORLD_SIZE;
+        bounds.radius[i] = 0.5f + values[3] * 1.5f;
+    }
+
+    WindowCullPath default_path = WindowCullGetPath();
+
+    static const u32 object_counts[] = { 100000, 1000000 };
+    for (u32 i = 0; i < sizeof(object_counts) / sizeof(object_counts[0]); i++)
+    {
+        bounds.count = object_counts[i];
+        BenchPrint("%u objects:", bounds.count);
+
+        // One thread (the job pool is not running)
+        u32 reference_visible = 0;
+        for (u32 path = WINDOW_CULL_PATH_SCALAR; path <= WINDOW_CULL_PATH_AVX; path++)
+        {
+            if (!WindowCullSetPath((WindowCullPath)path))
+            {
+                BenchPrint("  %-6s 1 thread:  not supported", BenchCullPathName((WindowCullPath)path));
+                continue;
+            }
+
+            u32 num_visible;
+            f64 ms = BenchCullRun(&bounds, visible.data(), &num_visible);
+            if (path == WINDOW_CULL_PATH_SCALAR)
+                reference_visible = num_visible;
+
+            BenchPrint("  %-6s 1 thread:  %7.3f ms (%5.2f ns per object), %u visible%s",
+                       BenchCullPathName((WindowCullPath)path), ms, ms * 1e6 / bounds.count, num_visible,
+                       num_visible == reference_visible ? "" : " (MISMATCH)");
+        }
+
+        WindowCullSetPath(default_path);
+
+        // Every worker
+        if (JobsInit(0))
+        {
+            u32 num_visible;
+            f64 ms = BenchCullRun(&bounds, visible.data(), &num_visible);
+
+            WindowCullStats stats;
+            WindowCullGetStats(&stats);
+
+            BenchPrint("  %-6s %u workers: %7.3f ms (%5.2f ns per object), %u visible%s",
+                       BenchCullPathName(stats.path), stats.num_workers, ms, ms * 1e6 / bounds.count, num_visible,
+                       num_visible == reference_visible ? "" : " (MISMATCH)");
+
+            JobsExit();
+        }
+    }
+
+    WindowCullBoundsFree(&bounds);
+}
@@ -0,0 +1,142 @@
+// Dynamic resolution
+// Renders a fill-bound frame (many overlapping screen-covering triangles) at full resolution to measure its GPU time,
+// then enables dynamic resolution with a target of half that time and reports how the render scale
+// and the GPU frame time settle
+// Without a usable GPU timer, dynamic resolution uses the time between swaps, and so does the benchmark
+
+#include "benchmarks.h"
+
+#include <window/cmd_list.h>
+
+#define BENCH_DYNRES_LAYERS        64
+#define BENCH_DYNRES_WARMUP_FRAMES 60
+#define BENCH_DYNRES_FRAMES        240
+#define BENCH_DYNRES_REPORT_FRAMES 30
+
+struct BenchDynResFrame
+{
+    WindowShaderSet shaders;
+    WindowVertexInput input;
+    u32 offset_location;
+};
+
+static void BenchDynResRecordList(WindowCmdList* cmd_list, u32 index, u32 count, void* user_data)
+{
+    BenchDynResFrame* frame = (BenchDynResFrame*)user_data;
+
+    WindowCmdSetShaders(cmd_list, &frame->shaders);
+    WindowCmdSetVertexInput(cmd_list, &frame->input);
+
+    // Scaled up 8 times, the triangle covers the whole screen
+    static const f32 offset[4] = { 0.0f, 0.0f, 0.0f, 8.0f };
+    WindowCmdSetVertexUniforms(cmd_list, frame->offset_location, 1, offset);
+
+    for (u32 i = 0; i < BENCH_DYNRES_LAYERS; i++)
+        WindowCmdDraw(cmd_list, 3, 0);
+}
+
+// Time of the last frame, as dynamic resolution measures it
+static f64 BenchDynResFrameTime(const WindowFrameStats* stats)
+{
+    return stats->gpu_timer ? stats->gpu_frame_ms : stats->swap_frame_ms;
+}
+
+static void BenchDynamicResolutionFrame(BenchDynResFrame* frame)
+{
+    BenchClear(0.2f, 0.3f, 0.3f);
+
+    WindowCmdRecord(BenchDynResRecordList, frame);
+    WindowCmdSubmit();
+
+    WindowSwapBuffers();
+}
+
+void BenchDynamicResolution()
+{
+    BenchDynResFrame draw;
+    BenchCreateTriangleShaders(&draw.shaders, &draw.offset_location);
+    BenchCreateTriangleInput(&draw.input);
+
+    // A single list, recorded on this thread
+    if (!WindowCmdInit(1, 0x10000))
+    {
+        BenchPrint("Could not create the command list");
+        return;
+    }
+
+    WindowFrameStats stats;
+    WindowGetFrameStats(&stats);
+    const char* time_kind = stats.gpu_timer ? "GPU" : "between swaps";
+
+    // Measure the full resolution cost first
+    f64 full_gpu_ms = 0.0;
+    u32 full_gpu_frames = 0;
+    for (u32 frame = 0; frame < BENCH_DYNRES_WARMUP_FRAMES; frame++)
+    {
+        BenchDynamicResolutionFrame(&draw);
+
+        // Skip the first frames, as the GPU times are read back a few frames late
+        WindowGetFrameStats(&stats);
+        if (frame >= BENCH_DYNRES_WARMUP_FRAMES / 2 && BenchDynResFrameTime(&stats) > 0.0)
+        {
+            full_gpu_ms += BenchDynResFrameTime(&stats);
+            full_gpu_frames++;
+        }
+    }
+
+    if (full_gpu_frames == 0)
+    {
+        BenchPrint("%s frame time not available", time_kind);
+        WindowCmdExit();
+        return;
+    }
+
+    full_gpu_ms /= full_gpu_frames;
+
+    u32 fb_width, fb_height;
+    WindowGetFramebufferSize(&fb_width, &fb_height);
+    BenchPrint("Full resolution %ux%u: %.3f ms %s", fb_width, fb_height, full_gpu_ms, time_kind);
+
+    // Only half of that fits in the target, so the scale should settle around sqrt(0.5 * 0.9) = ~0.67
+    f64 target_ms = full_gpu_ms * 0.5;
+    BenchPrint("Target %.3f ms, minimum scale 0.5:", target_ms);
+    WindowSetDynamicResolution(true, 0.5f, target_ms);
+
+    f64 gpu_ms = 0.0;
+    u32 over_target = 0;
+    for (u32 frame = 1; frame <= BENCH_DYNRES_FRAMES; frame++)
+    {
+        BenchDynamicResolutionFrame(&draw);
+
+        WindowGetFrameStats(&stats);
+        gpu_ms += BenchDynResFrameTime(&stats);
+        if (BenchDynResFrameTime(&stats) > target_ms)
+            over_target++;
+
+        if (frame % BENCH_DYNRES_REPORT_FRAMES == 0)
+        {
+            u32 render_width, render_height;
+            WindowGetRenderSize(&render_width, &render_height);
+
+            BenchPrint(
+                "  frame %3u: scale %.3f (%ux%u), %.3f ms %s, %u of %u frames over target",
+                frame,
+                stats.render_scale,
+                render_width,
+                render_height,
+                gpu_ms / BENCH_DYNRES_REPORT_FRAMES,
+                time_kind,
+                over_target,
+                BENCH_DYNRES_REPORT_FRAMES
+            );
+
+            gpu_ms = 0.0;
+            over_target = 0;
+        }
+    }
+
+    BenchPrint("%u scale changes", stats.scale_changes);
+
+    WindowSetDynamicResolution(false, 0.0f, 0.0);
+    WindowCmdExit();
+}
@@ -0,0 +1,131 @@
+// Frame graph
+// Builds, compiles and executes the graph of a typical frame every frame: a shadow map, a depth
+// pre-pass, an HDR scene pass, ambient occlusion, a bloom chain and tone mapping to the window,
+// plus a debug view that nothing reads (and is culled)
+// The passes only clear their targets: this measures the cost of the graph itself, and reports how much
+// memory the transient targets take with and without aliasing
+
+#include "benchmarks.h"
+
+#include <window/frame_graph.h>
+
+#define BENCH_GRAPH_FRAMES      120
+#define BENCH_GRAPH_BLOOM_MIPS  4
+
+static u32 sBenchGraphPasses = 0;
+
+static void BenchGraphPass(void* user_data)
+{
+    (void)user_data;
+    sBenchGraphPasses++;
+}
+
+static void BenchGraphBuild(u32 width, u32 height)
+{
+    WindowGraphBegin();
+
+    u32 shadow_map = WindowGraphCreateTarget("shadow map", 1024, 1024, WINDOW_RT_FORMAT_D32F);
+    u32 depth = WindowGraphCreateTarget("scene depth", width, height, WINDOW_RT_FORMAT_D24S8);
+    u32 hdr = WindowGraphCreateTarget("hdr", width, height, WINDOW_RT_FORMAT_RGBA16F);
+    u32 ao = WindowGraphCreateTarget("ambient occlusion", width / 2, height / 2, WINDOW_RT_FORMAT_R32F);
+    u32 debug = WindowGraphCreateTarget("debug view", width, height, WINDOW_RT_FORMAT_RGBA8);
+
+    u32 pass = WindowGraphAddPass("shadows", BenchGraphPass, NULL);
+    WindowGraphWrite(pass, shadow_map, true);
+
+    pass = WindowGraphAddPass("depth pre-pass", BenchGraphPass, NULL);
+    WindowGraphWrite(pass, depth, true);
+
+    pass = WindowGraphAddPass("ambient occlusion", BenchGraphPass, NULL);
+    WindowGraphRead(pass, depth);
+    WindowGraphWrite(pass, ao, true);
+
+    pass = WindowGraphAddPass("scene", BenchGraphPass, NULL);
+    WindowGraphRead(pass, shadow_map);
+    WindowGraphRead(pass, ao);
+    WindowGraphWrite(pass, hdr, true);
+    WindowGraphWrite(pass, depth, false);
+
+    pass = WindowGraphAddPass("debug view", BenchGraphPass, NULL);
+    WindowGraphRead(pass, shadow_map);
+    WindowGraphWrite(pass, debug, true);
+
+    // Each level of the bloom chain only needs the previous one
+    static const char* bloom_names[BENCH_GRAPH_BLOOM_MIPS] = { "bloom 1", "bloom 2", "bloom 3", "bloom 4" };
+    u32 previous = hdr;
+    for (u32 mip = 1; mip <= BENCH_GRAPH_BLOOM_MIPS; mip++)
+    {
+        u32 bloom = WindowGraphCreateTarget(bloom_names[mip - 1], width >> mip, height >> mip, WINDOW_RT_FORMAT_RGBA16F);
+
+        pass = WindowGraphAddPass(bloom_names[mip - 1], BenchGraphPass, NULL);
+        WindowGraphRead(pass, previous);
+        WindowGraphWrite(pass, bloom, true);
+        previous = bloom;
+    }
+
+    pass = WindowGraphAddPass("tone mapping", BenchGraphPass, NULL);
+    WindowGraphRead(pass, hdr);
+    WindowGraphRead(pass, previous);
+    WindowGraphWrite(pass, WINDOW_GRAPH_WINDOW_COLOR, true);
+    WindowGraphSetClearColor(WINDOW_GRAPH_WINDOW_COLOR, 0.2f, 0.3f, 0.3f, 1.0f);
+}
+
+void BenchFrameGraph()
+{
+    u32 width, height;
+    WindowGetRenderSize(&width, &height);
+
+    f64 build_time = 0.0;
+    f64 compile_time = 0.0;
+    f64 execute_time = 0.0;
+    sBenchGraphPasses = 0;
+
+    for (u32 frame = 0; frame < BENCH_GRAPH_FRAMES; frame++)
+    {
+        f64 start_time = WindowGetTime();
+        BenchGraphBuild(width, height);
+        build_time += WindowGetTime() - start_time;
+
+        start_time = WindowGetTime();
+        bool compiled = WindowGraphCompile();
+        compile_time += WindowGetTime() - start_time;
+
+        if (!compiled)
+        {
+            BenchPrint("The graph could not be compiled");
+            WindowGraphExit();
+            return;
+        }
+
+        start_time = WindowGetTime();
+        WindowGraphExecute();
+        execute_time += WindowGetTime() - start_time;
+
+        if (frame == 0)
+            WindowGraphPrint();
+
+        WindowSwapBuffers();
+    }
+
+    WindowGraphStats stats;
+    WindowGraphGetStats(&stats);
+
+    BenchPrint(
+        "%u passes executed per frame, build %.2f us, compile %.2f us, execute %.2f us per frame",
+        sBenchGraphPasses / BENCH_GRAPH_FRAMES,
+        build_time * 1000000.0 / BENCH_GRAPH_FRAMES,
+        compile_time * 1000000.0 / BENCH_GRAPH_FRAMES,
+        execute_time * 1000000.0 / BENCH_GRAPH_FRAMES
+    );
+    BenchPrint(
+        "Transient memory: %u KB aliased, %u KB without aliasing (%.1f%% saved), %u targets for %u transients",
+        stats.aliased_size / 1024,
+        stats.unaliased_size / 1024,
+        stats.unaliased_size ? 100.0 * (stats.unaliased_size - stats.aliased_size) / stats.unaliased_size : 0.0,
+        stats.num_physical_targets,
+        stats.num_transients - stats.num_culled_transients
+    );
+
+    WindowGraphExit();
+    WindowRenderTargetExit();
+}
@@ -0,0 +1,48 @@
+// Framebuffer planner
+// Prints the plan of the window buffers, then the plans for 1080p with a few combinations of
+// formats and MEM1 budgets, to show which layouts fit and what they cost
+
+#include "benchmarks.h"
+
+struct BenchPlanConfig
+{
+    WindowRenderTargetFormat color_format;
+    WindowRenderTargetFormat depth_format;
+    u32 mem1_budget;
+    u32 downgrade;
+};
+
+static const BenchPlanConfig sBenchPlanConfigs[] = {
+    { WINDOW_RT_FORMAT_RGBA8,   WINDOW_RT_FORMAT_D32F,  0,        0 },
+    { WINDOW_RT_FORMAT_RGBA8,   WINDOW_RT_FORMAT_D24S8, 0,        0 },
+    { WINDOW_RT_FORMAT_RGBA8,   WINDOW_RT_FORMAT_D16,   0,        0 },
+    { WINDOW_RT_FORMAT_RGBA16F, WINDOW_RT_FORMAT_D32F,  0,        0 },
+    { WINDOW_RT_FORMAT_RGBA16F, WINDOW_RT_FORMAT_D32F,  0x1000000, 0 },
+    { WINDOW_RT_FORMAT_RGBA16F, WINDOW_RT_FORMAT_D32F,  0x1000000, WINDOW_DOWNGRADE_DEPTH },
+    { WINDOW_RT_FORMAT_RGBA16F, WINDOW_RT_FORMAT_D32F,  0x1000000, WINDOW_DOWNGRADE_DEPTH | WINDOW_DOWNGRADE_COLOR },
+};
+
+void BenchFramebufferPlan()
+{
+    WindowFramebufferPlan plan;
+
+    BenchPrint("Window:");
+    WindowGetFramebufferPlan(&plan);
+    WindowPrintFramebufferPlan(&plan);
+
+    for (u32 i = 0; i < sizeof(sBenchPlanConfigs) / sizeof(sBenchPlanConfigs[0]); i++)
+    {
+        const BenchPlanConfig& config = sBenchPlanConfigs[i];
+
+        WindowHint(WINDOW_HINT_COLOR_FORMAT, config.color_format);
+        WindowHint(WINDOW_HINT_DEPTH_FORMAT, config.depth_format);
+        WindowHint(WINDOW_HINT_MEM1_BUDGET, config.mem1_budget);
+        WindowHint(WINDOW_HINT_DOWNGRADE, config.downgrade);
+
+        BenchPrint("MEM1 budget %u KB, downgrade flags 0x%x:", config.mem1_budget / 1024, config.downgrade);
+        if (WindowPlanFramebuffer(1920, 1080, &plan))
+            WindowPrintFramebufferPlan(&plan);
+    }
+
+    WindowDefaultHints();
+}
@@ -0,0 +1,103 @@
+// GPU scopes
+// Profiles a frame split in scopes (clear, fill-bound layers in two nested halves, and the swap added
+// by WindowSwapBuffers) with the GPU profiler, and reports the average GPU and CPU time of each scope
+
+#include "benchmarks.h"
+
+#include <window/cmd_list.h>
+#include <window/gpu_profiler.h>
+
+#define BENCH_SCOPES_LAYERS      16
+#define BENCH_SCOPES_FRAMES      120
+
+struct BenchScopesFrame
+{
+    WindowShaderSet shaders;
+    WindowVertexInput input;
+    u32 offset_location;
+};
+
+static void BenchScopesRecordList(WindowCmdList* cmd_list, u32 index, u32 count, void* user_data)
+{
+    BenchScopesFrame* frame = (BenchScopesFrame*)user_data;
+
+    WindowCmdSetShaders(cmd_list, &frame->shaders);
+    WindowCmdSetVertexInput(cmd_list, &frame->input);
+
+    // Scaled up 8 times, the triangle covers the whole screen
+    static const f32 offset[4] = { 0.0f, 0.0f, 0.0f, 8.0f };
+    WindowCmdSetVertexUniforms(cmd_list, frame->offset_location, 1, offset);
+
+    for (u32 i = 0; i < BENCH_SCOPES_LAYERS / 2; i++)
+        WindowCmdDraw(cmd_list, 3, 0);
+}
+
+void BenchGpuScopes()
+{
+    BenchScopesFrame frame;
+    BenchCreateTriangleShaders(&frame.shaders, &frame.offset_location);
+    BenchCreateTriangleInput(&frame.input);
+
+    // A single list, recorded on this thread
+    if (!WindowCmdInit(1, 0x10000))
+    {
+        BenchPrint("Could not create the command list");
+        return;
+    }
+
+    WindowGpuProfilerInit();
+
+    const char* names[WINDOW_GPU_PROFILER_MAX_SCOPES];
+    u32 depths[WINDOW_GPU_PROFILER_MAX_SCOPES];
+    f64 gpu_ms[WINDOW_GPU_PROFILER_MAX_SCOPES] = { 0.0 };
+    f64 cpu_ms[WINDOW_GPU_PROFILER_MAX_SCOPES] = { 0.0 };
+    u32 num_scopes = 0;
+    u32 num_frames = 0;
+
+    for (u32 i = 0; i < BENCH_SCOPES_FRAMES; i++)
+    {
+        WindowGpuScopeBegin("Clear");
+        BenchClear(0.2f, 0.3f, 0.3f);
+        WindowGpuScopeEnd();
+
+        WindowGpuScopeBegin("Layers");
+        for (u32 half = 0; half < 2; half++)
+        {
+            WindowGpuScopeBegin(half == 0 ? "First half" : "Second half");
+            WindowCmdRecord(BenchScopesRecordList, &frame);
+            WindowCmdSubmit();
+            WindowGpuScopeEnd();
+        }
+        WindowGpuScopeEnd();
+
+        WindowSwapBuffers();
+
+        // Results arrive a few frames late
+        const WindowGpuScopeTiming* scopes;
+        u32 count = WindowGpuProfilerGetResults(&scopes);
+        if (count == 0)
+            continue;
+
+        num_scopes = count;
+        num_frames++;
+        for (u32 j = 0; j < count; j++)
+        {
+            names[j] = scopes[j].name;
+            depths[j] = scopes[j].depth;
+            gpu_ms[j] += scopes[j].gpu_ms;
+            cpu_ms[j] += scopes[j].cpu_ms;
+        }
+    }
+
+    BenchPrint("%u layers, average of %u frames (GPU ms / CPU ms):", BENCH_SCOPES_LAYERS, num_frames);
+    for (u32 i = 0; i < num_scopes; i++)
+    {
+        BenchPrint(
+            "  %*s%-*s %8.3f %8.3f",
+            (int)(depths[i] * 2), "", (int)(24 - depths[i] * 2), names[i], gpu_ms[i] / num_frames, cpu_ms[i] / num_frames
+        );
+    }
+
+    WindowGpuProfilerExit();
+    WindowCmdExit();
+}
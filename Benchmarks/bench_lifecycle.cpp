@@ -0,0 +1,137 @@
+// Lifecycle
+// Sends the application to the background and back repeatedly while it holds a render target,
+// and reports how long releasing and restoring the foreground-only memory takes (the resume latency)
+// - PC: the events are simulated with WindowPostLifecycleEvent
+// - Wii U: the events come from ProcUI, so the HOME Menu has to be opened and closed by hand
+//          while the benchmark runs
+
+#include "benchmarks.h"
+
+#include <window/render_target.h>
+
+#ifdef TEST_WIN
+#include <GL/glew.h>
+#else
+#include <gx2/clear.h>
+#endif
+
+#ifdef TEST_WIN
+#define BENCH_LIFECYCLE_CYCLES          32
+#define BENCH_LIFECYCLE_FRAMES_PER_CYCLE 4
+#else
+#define BENCH_LIFECYCLE_FRAMES          1200 // About 20 seconds
+#endif
+
+struct BenchLifecycleCounts
+{
+    u32 releases;
+    u32 acquires;
+};
+
+static void BenchLifecycleCallback(WindowLifecycleEvent event, void* user_data)
+{
+    BenchLifecycleCounts* counts = (BenchLifecycleCounts*)user_data;
+    if (event == WINDOW_LIFECYCLE_RELEASE_FOREGROUND)
+        counts->releases++;
+    else
+        counts->acquires++;
+}
+
+static void BenchLifecycleFrame(WindowRenderTarget* target)
+{
+    // Render to the held target, then to the window
+    if (target)
+    {
+        WindowSetRenderTargets(target, NULL);
+#ifdef TEST_WIN
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+#else
+        GX2ClearColor(&target->color_buffer, 0.0f, 0.0f, 0.0f, 1.0f);
+#endif
+    }
+
+    WindowSetRenderTargets(NULL, NULL);
+    BenchClear(0.2f, 0.3f, 0.3f);
+
+    WindowSwapBuffers();
+}
+
+void BenchLifecycle()
+{
+    BenchLifecycleCounts counts = { 0, 0 };
+    WindowSetLifecycleCallback(BenchLifecycleCallback, &counts);
+
+    // Held across the cycles, so that it has to get its memory back on each resume
+    u32 fb_width, fb_height;
+    WindowGetFramebufferSize(&fb_width, &fb_height);
+    WindowRenderTarget* target = WindowAcquireRenderTarget(fb_width / 2, fb_height / 2, WINDOW_RT_FORMAT_RGBA8, 1);
+
+    WindowLifecycleStats start_stats;
+    WindowGetLifecycleStats(&start_stats);
+
+    f64 release_ms = 0.0;
+    f64 resume_ms = 0.0;
+
+#ifdef TEST_WIN
+
+    for (u32 i = 0; i < BENCH_LIFECYCLE_CYCLES; i++)
+    {
+        for (u32 j = 0; j < BENCH_LIFECYCLE_FRAMES_PER_CYCLE; j++)
+            BenchLifecycleFrame(target);
+
+        WindowPostLifecycleEvent(WINDOW_LIFECYCLE_RELEASE_FOREGROUND);
+        WindowPostLifecycleEvent(WINDOW_LIFECYCLE_ACQUIRE_FOREGROUND);
+        if (!WindowIsRunning())
+            break;
+
+        WindowLifecycleStats stats;
+        WindowGetLifecycleStats(&stats);
+        release_ms += stats.last_release_ms;
+        resume_ms += stats.last_resume_ms;
+    }
+
+#else // TEST_GX2
+
+    BenchPrint("Open and close the HOME Menu a few times in the next 20 seconds");
+
+    u32 seen_resumes = start_stats.resumes;
+    for (u32 i = 0; i < BENCH_LIFECYCLE_FRAMES && WindowIsRunning(); i++)
+    {
+        BenchLifecycleFrame(target);
+
+        WindowLifecycleStats stats;
+        WindowGetLifecycleStats(&stats);
+        if (stats.resumes != seen_resumes)
+        {
+            seen_resumes = stats.resumes;
+            release_ms += stats.last_release_ms;
+            resume_ms += stats.last_resume_ms;
+            BenchPrint("  Resumed after %.0f ms in the background", stats.last_background_ms);
+        }
+    }
+
+#endif // TEST_WIN
+
+    WindowLifecycleStats stats;
+    WindowGetLifecycleStats(&stats);
+    u32 resumes = stats.resumes - start_stats.resumes;
+
+    WindowRenderTargetStats target_stats;
+    WindowGetRenderTargetStats(&target_stats);
+
+    BenchPrint("%u releases, %u resumes (callback: %u / %u)", stats.releases - start_stats.releases, resumes,
+               counts.releases, counts.acquires);
+    if (resumes > 0)
+    {
+        BenchPrint("  Release: %.3f ms average", release_ms / resumes);
+        BenchPrint("  Resume:  %.3f ms average, %.3f ms max", resume_ms / resumes, stats.max_resume_ms);
+        BenchPrint("  Window buffers given back: %u KB", stats.released_bytes / 1024);
+    }
+    BenchPrint("  Render target pool: MEM1 %u KB, MEM2 %u KB", target_stats.mem1_used / 1024,
+               target_stats.mem2_used / 1024);
+
+    if (target)
+        WindowReleaseRenderTarget(target);
+    WindowSetLifecycleCallback(NULL, NULL);
+}
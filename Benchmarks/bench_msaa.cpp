@@ -0,0 +1,214 @@
+// MSAA cost
+// Renders the same fill-bound frame (overlapping screen-covering triangles) into framebuffer-sized
+// color and depth targets with 1, 2, 4 and 8 samples per pixel, then resolves the color target,
+// and reports the GPU time of the fill and of the resolve (each in a GPU scope), memory and sample
+// bandwidth of each level
+
+#include "benchmarks.h"
+
+#include <window/cmd_list.h>
+#include <window/gpu_profiler.h>
+#include <window/render_target.h>
+
+#include <string.h>
+
+#ifdef TEST_WIN
+#include <GL/glew.h>
+#else
+#include <gx2/clear.h>
+#include <gx2/registers.h>
+#endif
+
+#define BENCH_MSAA_LAYERS      16
+#define BENCH_MSAA_FRAMES      40
+#define BENCH_MSAA_SKIP_FRAMES 6   // GPU times are read back a few frames late (and the first ones belong to the previous level)
+
+struct BenchMsaaFrame
+{
+    WindowShaderSet shaders;
+    WindowVertexInput input;
+    u32 offset_location;
+};
+
+static void BenchMsaaRecordList(WindowCmdList* cmd_list, u32 index, u32 count, void* user_data)
+{
+    BenchMsaaFrame* frame = (BenchMsaaFrame*)user_data;
+
+    WindowCmdSetShaders(cmd_list, &frame->shaders);
+    WindowCmdSetVertexInput(cmd_list, &frame->input);
+
+    // Scaled up 8 times, the triangle covers the whole screen
+    static const f32 offset[4] = { 0.0f, 0.0f, 0.0f, 8.0f };
+    WindowCmdSetVertexUniforms(cmd_list, frame->offset_location, 1, offset);
+
+    for (u32 i = 0; i < BENCH_MSAA_LAYERS; i++)
+        WindowCmdDraw(cmd_list, 3, 0);
+}
+
+static void BenchMsaaSetDepthTest(bool enable)
+{
+#ifdef TEST_WIN
+    if (enable)
+        glEnable(GL_DEPTH_TEST);
+    else
+        glDisable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+#else
+    GX2SetDepthOnlyControl(enable, enable, GX2_COMPARE_FUNC_LEQUAL);
+#endif
+}
+
+static void BenchMsaaClear(WindowRenderTarget* color, WindowRenderTarget* depth)
+{
+    WindowSetRenderTargets(color, depth);
+
+#ifdef TEST_WIN
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClearDepth(1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+#else
+    GX2ClearColor(&color->color_buffer, 0.0f, 0.0f, 0.0f, 1.0f);
+    GX2ClearDepthStencilEx(&depth->depth_buffer, 1.0f, 0, GX2_CLEAR_FLAGS_DEPTH);
+
+    // Clearing resets the current render targets
+    WindowSetRenderTargets(color, depth);
+#endif
+
+    // Every layer passes the depth test and writes its depth, so that each layer touches every
+    // color and depth sample
+    BenchMsaaSetDepthTest(true);
+}
+
+// Render frames into the targets, resolving the color target if given, and get the average GPU time
+// of the fill and of the resolve in milliseconds
+static void BenchMsaaRun(BenchMsaaFrame* frame, WindowRenderTarget* color, WindowRenderTarget* depth, WindowRenderTarget* resolved,
+                         f64* pFillMs, f64* pResolveMs)
+{
+    f64 fill_ms = 0.0;
+    f64 resolve_ms = 0.0;
+    u32 gpu_frames = 0;
+
+    for (u32 i = 0; i < BENCH_MSAA_FRAMES; i++)
+    {
+        WindowGpuScopeBegin("Fill");
+        BenchMsaaClear(color, depth);
+
+        WindowCmdRecord(BenchMsaaRecordList, frame);
+        WindowCmdSubmit();
+        WindowGpuScopeEnd();
+
+        if (resolved)
+        {
+            WindowGpuScopeBegin("Resolve");
+            WindowResolveRenderTarget(color, resolved);
+            WindowGpuScopeEnd();
+        }
+
+        BenchMsaaSetDepthTest(false);
+        WindowSetRenderTargets(NULL, NULL);
+        WindowSwapBuffers();
+
+        if (i < BENCH_MSAA_SKIP_FRAMES)
+            continue;
+
+        const WindowGpuScopeTiming* scopes;
+        u32 count = WindowGpuProfilerGetResults(&scopes);
+        if (count == 0)
+            continue;
+
+        for (u32 j = 0; j < count; j++)
+        {
+            if (strcmp(scopes[j].name, "Fill") == 0)
+                fill_ms += scopes[j].gpu_ms;
+            else if (strcmp(scopes[j].name, "Resolve") == 0)
+                resolve_ms += scopes[j].gpu_ms;
+        }
+
+        gpu_frames++;
+    }
+
+    *pFillMs = gpu_frames != 0 ? fill_ms / gpu_frames : 0.0;
+    *pResolveMs = gpu_frames != 0 ? resolve_ms / gpu_frames : 0.0;
+}
+
+void BenchMsaa()
+{
+    BenchMsaaFrame frame;
+    BenchCreateTriangleShaders(&frame.shaders, &frame.offset_location);
+    BenchCreateTriangleInput(&frame.input);
+
+    // A single list, recorded on this thread
+    if (!WindowCmdInit(1, 0x10000))
+    {
+        BenchPrint("Could not create the command list");
+        return;
+    }
+
+    WindowGpuProfilerInit();
+
+    u32 width, height;
+    WindowGetFramebufferSize(&width, &height);
+    BenchPrint("%ux%u, RGBA8 + D32F, %u layers per frame", width, height, BENCH_MSAA_LAYERS);
+
+    static const u32 sample_counts[] = { 1, 2, 4, 8 };
+    f64 base_fill_ms = 0.0;
+
+    for (u32 i = 0; i < sizeof(sample_counts) / sizeof(sample_counts[0]); i++)
+    {
+        u32 samples = sample_counts[i];
+
+        WindowRenderTargetStats stats;
+        WindowGetRenderTargetStats(&stats);
+        u32 memory_before = stats.mem1_used + stats.mem2_used;
+        u32 mem1_before = stats.mem1_used;
+
+        WindowRenderTarget* color = WindowAcquireRenderTarget(width, height, WINDOW_RT_FORMAT_RGBA8, samples);
+        WindowRenderTarget* depth = WindowAcquireRenderTarget(width, height, WINDOW_RT_FORMAT_D32F, samples);
+        WindowRenderTarget* resolved = samples > 1 ? WindowAcquireRenderTarget(width, height, WINDOW_RT_FORMAT_RGBA8, 1) : NULL;
+
+        WindowGetRenderTargetStats(&stats);
+        u32 memory = stats.mem1_used + stats.mem2_used - memory_before;
+        u32 mem1 = stats.mem1_used - mem1_before;
+
+        if (!color || !depth || (samples > 1 && !resolved))
+        {
+            BenchPrint("%ux: not supported", samples);
+        }
+        else
+        {
+            f64 fill_ms, resolve_ms;
+            BenchMsaaRun(&frame, color, depth, resolved, &fill_ms, &resolve_ms);
+            if (samples == 1)
+                base_fill_ms = fill_ms;
+
+            // Color and depth samples written by the layers
+            f64 sample_mb = (f64)width * height * samples * (4 + 4) * BENCH_MSAA_LAYERS / (1024.0 * 1024.0);
+
+            BenchPrint(
+                "%ux: fill %.3f ms (x%.2f), resolve %.3f ms, %u KB (%u KB in MEM1), %.0f MB of samples (%.2f GB/s)",
+                samples,
+                fill_ms,
+                base_fill_ms > 0.0 ? fill_ms / base_fill_ms : 0.0,
+                resolve_ms,
+                memory / 1024,
+                mem1 / 1024,
+                sample_mb,
+                fill_ms > 0.0 ? sample_mb / 1024.0 / (fill_ms / 1000.0) : 0.0
+            );
+        }
+
+        if (color)
+            WindowReleaseRenderTarget(color);
+        if (depth)
+            WindowReleaseRenderTarget(depth);
+        if (resolved)
+            WindowReleaseRenderTarget(resolved);
+
+        // Give the memory back before the next level
+        WindowTrimRenderTargets(0);
+    }
+
+    WindowGpuProfilerExit();
+    WindowRenderTargetExit();
+    WindowCmdExit();
+}
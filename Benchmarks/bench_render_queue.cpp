@@ -0,0 +1,160 @@
+// Render queue
+// Queues 10k to 100k draws using random shader sets, vertex inputs and materials, and replays them
+// through the render queue (window/render_queue.h) in the order they were queued, then sorted by key,
+// and reports the sort time and the state changes per frame
+
+#include "benchmarks.h"
+
+#include <window/cmd_list.h>
+#include <window/jobs.h>
+#include <window/render_queue.h>
+
+#define BENCH_QUEUE_MAX_DRAWS   100000
+#define BENCH_QUEUE_FRAMES      4
+#define BENCH_QUEUE_SHADERS     8
+#define BENCH_QUEUE_INPUTS      16
+#define BENCH_QUEUE_MATERIALS   256
+#define BENCH_QUEUE_LISTS       3
+#define BENCH_QUEUE_LIST_SIZE   0x1000000
+
+struct BenchQueueState
+{
+    WindowShaderSet shaders[BENCH_QUEUE_SHADERS];
+    WindowVertexInput inputs[BENCH_QUEUE_INPUTS];
+    u32 shader_ids[BENCH_QUEUE_SHADERS];
+    u32 input_ids[BENCH_QUEUE_INPUTS];
+    u32 material_ids[BENCH_QUEUE_MATERIALS];
+};
+
+// Small deterministic generator, so that every run queues the same draws
+static u32 BenchQueueRandom(u32* seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed >> 8;
+}
+
+// Queue the draws of a frame, in the order a scene traversal would produce them
+static void BenchQueueFill(const BenchQueueState* state, u32 num_draws)
+{
+    static const WindowQueueDraw draw = { 3, 0, NULL };
+
+    u32 seed = 12345;
+
+    WindowQueueBegin();
+    for (u32 i = 0; i < num_draws; i++)
+    {
+        u32 pass = (BenchQueueRandom(&seed) & 7) == 0 ? 1 : 0;
+        u32 shaders = state->shader_ids[BenchQueueRandom(&seed) % BENCH_QUEUE_SHADERS];
+        u32 input = state->input_ids[BenchQueueRandom(&seed) % BENCH_QUEUE_INPUTS];
+        u32 material = state->material_ids[BenchQueueRandom(&seed) % BENCH_QUEUE_MATERIALS];
+        f32 depth = (f32)(BenchQueueRandom(&seed) & 0xFFFF) / 65535.0f;
+
+        WindowQueueSubmitDraw(pass, shaders, input, material, depth, &draw);
+    }
+}
+
+static void BenchQueueRun(const BenchQueueState* state, u32 num_draws, bool sort)
+{
+    f64 sort_ms = 0.0, record_ms = 0.0, submit_ms = 0.0;
+    WindowQueueStats stats;
+
+    f64 start_time = WindowGetTime();
+
+    for (u32 frame = 0; frame < BENCH_QUEUE_FRAMES; frame++)
+    {
+        BenchClear(0.2f, 0.3f, 0.3f);
+
+        BenchQueueFill(state, num_draws);
+        if (sort)
+            WindowQueueSort();
+        WindowQueueFlush();
+
+        WindowSwapBuffers();
+
+        WindowQueueGetStats(&stats);
+        if (sort)
+            sort_ms += stats.sort_ms;
+
+        WindowCmdStats cmd_stats;
+        WindowCmdGetStats(&cmd_stats);
+        record_ms += cmd_stats.record_ms;
+        submit_ms += cmd_stats.submit_ms;
+    }
+
+    f64 frame_ms = (WindowGetTime() - start_time) * 1000.0 / BENCH_QUEUE_FRAMES;
+
+    BenchPrint(
+        "  %s: %u state changes (%u shaders, %u inputs, %u materials), sort %.3f ms (%u passes), record %.3f ms, submit %.3f ms, frame %.3f ms",
+        sort ? "Sorted  " : "Unsorted",
+        stats.state_changes, stats.shader_changes, stats.input_changes, stats.material_changes,
+        sort_ms / BENCH_QUEUE_FRAMES, sort ? stats.radix_passes : 0,
+        record_ms / BENCH_QUEUE_FRAMES, submit_ms / BENCH_QUEUE_FRAMES, frame_ms
+    );
+}
+
+void BenchRenderQueue()
+{
+    if (!JobsInit(BENCH_QUEUE_LISTS))
+    {
+        BenchPrint("Could not start the job pool");
+        return;
+    }
+
+    if (!WindowCmdInit(BENCH_QUEUE_LISTS, BENCH_QUEUE_LIST_SIZE))
+    {
+        BenchPrint("Could not create the command lists");
+        JobsExit();
+        return;
+    }
+
+    if (!WindowQueueInit(BENCH_QUEUE_MAX_DRAWS))
+    {
+        BenchPrint("Could not create the render queue");
+        WindowCmdExit();
+        JobsExit();
+        return;
+    }
+
+    static BenchQueueState state;
+    u32 offset_location = 0;
+
+    for (u32 i = 0; i < BENCH_QUEUE_SHADERS; i++)
+    {
+        BenchCreateTriangleShaders(&state.shaders[i], &offset_location);
+        state.shader_ids[i] = WindowQueueAddShaders(&state.shaders[i]);
+    }
+
+    for (u32 i = 0; i < BENCH_QUEUE_INPUTS; i++)
+    {
+        BenchCreateTriangleInput(&state.inputs[i]);
+        state.input_ids[i] = WindowQueueAddInput(&state.inputs[i]);
+    }
+
+    // Each material places its draws somewhere on a grid
+    for (u32 i = 0; i < BENCH_QUEUE_MATERIALS; i++)
+    {
+        WindowQueueMaterial material;
+        material.location = offset_location;
+        material.count = 1;
+        material.values[0] = -0.9f + (f32)(i % 16) * 0.12f;
+        material.values[1] = -0.9f + (f32)(i / 16) * 0.12f;
+        material.values[2] = 0.0f;
+        material.values[3] = 0.05f;
+
+        state.material_ids[i] = WindowQueueAddMaterial(&material);
+    }
+
+    BenchPrint("%u shader sets, %u vertex inputs, %u materials, 2 passes", BENCH_QUEUE_SHADERS, BENCH_QUEUE_INPUTS, BENCH_QUEUE_MATERIALS);
+
+    static const u32 draw_counts[] = { 10000, 30000, 100000 };
+    for (u32 i = 0; i < sizeof(draw_counts) / sizeof(draw_counts[0]); i++)
+    {
+        BenchPrint("%u draws:", draw_counts[i]);
+        BenchQueueRun(&state, draw_counts[i], false);
+        BenchQueueRun(&state, draw_counts[i], true);
+    }
+
+    WindowQueueExit();
+    WindowCmdExit();
+    JobsExit();
+}
@@ -0,0 +1,114 @@
+// Render target pool
+// Acquires and releases the targets of a typical post-processing chain every frame
+// (a shadow map, an HDR scene target and a bloom down-sampling chain), and reports how often the
+// pool had to allocate and where the targets were placed
+
+#include "benchmarks.h"
+
+#include <window/render_target.h>
+
+#ifdef TEST_WIN
+#include <GL/glew.h>
+#else
+#include <gx2/clear.h>
+#endif
+
+#define BENCH_RT_FRAMES     120
+#define BENCH_RT_BLOOM_MIPS 5
+
+static void BenchRenderTargetsClear(WindowRenderTarget* color, WindowRenderTarget* depth)
+{
+    WindowSetRenderTargets(color, depth);
+
+#ifdef TEST_WIN
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClearDepth(1.0);
+    glClear((color ? GL_COLOR_BUFFER_BIT : 0) | (depth ? GL_DEPTH_BUFFER_BIT : 0));
+#else
+    if (color)
+        GX2ClearColor(&color->color_buffer, 0.0f, 0.0f, 0.0f, 1.0f);
+    if (depth)
+        GX2ClearDepthStencilEx(&depth->depth_buffer, 1.0f, 0, GX2_CLEAR_FLAGS_DEPTH);
+
+    // Clearing resets the current render targets
+    WindowSetRenderTargets(color, depth);
+#endif
+}
+
+void BenchRenderTargets()
+{
+    u32 fb_width, fb_height;
+    WindowGetFramebufferSize(&fb_width, &fb_height);
+
+    f64 acquire_time = 0.0;
+    u32 first_frame_allocations = 0;
+
+    for (u32 frame = 0; frame < BENCH_RT_FRAMES; frame++)
+    {
+        f64 start_time = WindowGetTime();
+
+        WindowRenderTarget* shadow_map = WindowAcquireRenderTarget(1024, 1024, WINDOW_RT_FORMAT_D32F, 1);
+        acquire_time += WindowGetTime() - start_time;
+
+        BenchRenderTargetsClear(NULL, shadow_map);
+
+        start_time = WindowGetTime();
+        WindowRenderTarget* scene = WindowAcquireRenderTarget(fb_width, fb_height, WINDOW_RT_FORMAT_RGBA16F, 1);
+        WindowRenderTarget* scene_depth = WindowAcquireRenderTarget(fb_width, fb_height, WINDOW_RT_FORMAT_D24S8, 1);
+        acquire_time += WindowGetTime() - start_time;
+
+        BenchRenderTargetsClear(scene, scene_depth);
+
+        // The shadow map is not needed past the scene pass
+        WindowReleaseRenderTarget(shadow_map);
+        WindowReleaseRenderTarget(scene_depth);
+
+        // Each level of the bloom chain only needs the previous one
+        WindowRenderTarget* previous = scene;
+        for (u32 mip = 1; mip <= BENCH_RT_BLOOM_MIPS; mip++)
+        {
+            start_time = WindowGetTime();
+            WindowRenderTarget* bloom = WindowAcquireRenderTarget(fb_width >> mip, fb_height >> mip, WINDOW_RT_FORMAT_RGBA16F, 1);
+            acquire_time += WindowGetTime() - start_time;
+
+            BenchRenderTargetsClear(bloom, NULL);
+
+            WindowReleaseRenderTarget(previous);
+            previous = bloom;
+        }
+
+        WindowReleaseRenderTarget(previous);
+
+        WindowSetRenderTargets(NULL, NULL);
+        BenchClear(0.2f, 0.3f, 0.3f);
+        WindowSwapBuffers();
+
+        if (frame == 0)
+        {
+            WindowRenderTargetStats stats;
+            WindowGetRenderTargetStats(&stats);
+            first_frame_allocations = stats.allocations;
+        }
+    }
+
+    WindowRenderTargetStats stats;
+    WindowGetRenderTargetStats(&stats);
+
+    BenchPrint(
+        "%u acquires, %u allocations (%u in the first frame), %.2f us per acquire",
+        stats.acquires,
+        stats.allocations,
+        first_frame_allocations,
+        acquire_time * 1000000.0 / stats.acquires
+    );
+    BenchPrint(
+        "%u targets, peak %u in use, MEM1 %u / %u KB, MEM2 %u KB",
+        stats.num_targets,
+        stats.peak_in_use,
+        stats.mem1_used / 1024,
+        stats.mem1_budget / 1024,
+        stats.mem2_used / 1024
+    );
+
+    WindowRenderTargetExit();
+}
@@ -0,0 +1,146 @@
+// GPR / stack partition
+// Prints the resources used by the Test 3 shaders according to their register headers and the partition
+// computed for them and for a range of heavier shaders, then renders the same fill-bound frame with the
+// fixed partition and with automatic partitioning and reports the GPU time of each
+
+#include "benchmarks.h"
+
+#include <window/cmd_list.h>
+#include <window/shader_mode.h>
+
+#include <cstdio>
+
+#define BENCH_PARTITION_LAYERS      32
+#define BENCH_PARTITION_FRAMES      60
+#define BENCH_PARTITION_SKIP_FRAMES 6   // GPU times are read back a few frames late
+
+struct BenchPartitionFrame
+{
+    WindowShaderSet shaders;
+    WindowVertexInput input;
+    u32 offset_location;
+};
+
+static void BenchPartitionRecordList(WindowCmdList* cmd_list, u32 index, u32 count, void* user_data)
+{
+    BenchPartitionFrame* frame = (BenchPartitionFrame*)user_data;
+
+    WindowCmdSetShaders(cmd_list, &frame->shaders);
+    WindowCmdSetVertexInput(cmd_list, &frame->input);
+
+    // Scaled up 8 times, the triangle covers the whole screen
+    static const f32 offset[4] = { 0.0f, 0.0f, 0.0f, 8.0f };
+    WindowCmdSetVertexUniforms(cmd_list, frame->offset_location, 1, offset);
+
+    for (u32 i = 0; i < BENCH_PARTITION_LAYERS; i++)
+        WindowCmdDraw(cmd_list, 3, 0);
+}
+
+// Render frames and return their average GPU time in milliseconds
+static f64 BenchPartitionRun(BenchPartitionFrame* frame)
+{
+    f64 gpu_ms = 0.0;
+    u32 gpu_frames = 0;
+
+    for (u32 i = 0; i < BENCH_PARTITION_FRAMES; i++)
+    {
+        BenchClear(0.2f, 0.3f, 0.3f);
+
+        WindowCmdRecord(BenchPartitionRecordList, frame);
+        WindowCmdSubmit();
+
+        WindowSwapBuffers();
+
+        WindowFrameStats stats;
+        WindowGetFrameStats(&stats);
+        if (i >= BENCH_PARTITION_SKIP_FRAMES && stats.gpu_frame_ms > 0.0)
+        {
+            gpu_ms += stats.gpu_frame_ms;
+            gpu_frames++;
+        }
+    }
+
+    return gpu_frames != 0 ? gpu_ms / gpu_frames : 0.0;
+}
+
+static void BenchPrintPartition(const char* name, const WindowShaderNeeds* needs, const WindowShaderPartition* partition)
+{
+    BenchPrint(
+        "%s: VS %u GPRs / %u stack, PS %u GPRs / %u stack -> VS %u GPRs / %u stack (%u waves), PS %u GPRs / %u stack (%u waves)",
+        name,
+        needs->vs_gprs, needs->vs_stack,
+        needs->ps_gprs, needs->ps_stack,
+        partition->vs_gprs, partition->vs_stack, partition->vs_waves,
+        partition->ps_gprs, partition->ps_stack, partition->ps_waves
+    );
+}
+
+void BenchShaderPartition()
+{
+    BenchPartitionFrame frame;
+    BenchCreateTriangleShaders(&frame.shaders, &frame.offset_location);
+    BenchCreateTriangleInput(&frame.input);
+
+    WindowShaderPartition partition;
+
+    // The fixed partition, and the wavefronts it allows for the shaders below
+    WindowGetDefaultShaderPartition(&partition);
+    BenchPrint(
+        "Fixed: VS %u GPRs / %u stack, PS %u GPRs / %u stack",
+        partition.vs_gprs, partition.vs_stack,
+        partition.ps_gprs, partition.ps_stack
+    );
+
+#ifdef TEST_GX2
+    WindowShaderNeeds triangle_needs;
+    WindowGetShaderNeeds(&frame.shaders, &triangle_needs);
+    WindowComputeShaderPartition(&triangle_needs, &partition);
+    BenchPrintPartition("Test 3 shaders", &triangle_needs, &partition);
+#else
+    BenchPrint("Test 3 shaders: register headers not available on PC");
+#endif
+
+    // Heavier shaders, as found in lit and skinned scenes
+    static const WindowShaderNeeds sample_needs[] = {
+        {  4, 0,   4, 0 },
+        {  8, 1,  16, 1 },
+        { 16, 2,  24, 2 },
+        { 24, 2,  40, 4 },
+        { 32, 4,  64, 4 },
+        { 64, 8, 120, 8 },
+    };
+
+    for (u32 i = 0; i < sizeof(sample_needs) / sizeof(sample_needs[0]); i++)
+    {
+        WindowComputeShaderPartition(&sample_needs[i], &partition);
+
+        // With the fixed partition, the stages get 48 / needs and 200 / needs wavefronts
+        char name[64];
+        snprintf(
+            name, sizeof(name), "Example %u (fixed: %u / %u waves)",
+            i + 1, 48 / sample_needs[i].vs_gprs, 200 / sample_needs[i].ps_gprs
+        );
+        BenchPrintPartition(name, &sample_needs[i], &partition);
+    }
+
+    // A single list, recorded on this thread
+    if (!WindowCmdInit(1, 0x10000))
+    {
+        BenchPrint("Could not create the command list");
+        return;
+    }
+
+    f64 fixed_ms = BenchPartitionRun(&frame);
+
+    WindowSetShaderPartitionAuto(true);
+    f64 auto_ms = BenchPartitionRun(&frame);
+
+    WindowGetShaderPartition(&partition);
+    BenchPrint(
+        "%u layers: fixed partition %.3f ms GPU, automatic partition %.3f ms GPU (VS %u GPRs, PS %u GPRs)",
+        BENCH_PARTITION_LAYERS, fixed_ms, auto_ms, partition.vs_gprs, partition.ps_gprs
+    );
+
+    WindowSetShaderPartitionAuto(false);
+    WindowCmdExit();
+}
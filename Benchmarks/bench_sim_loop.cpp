@@ -0,0 +1,196 @@
+// Simulation/render thread split
+// Runs the same particle simulation at a fixed 120 Hz and renders it as fast as possible, with the
+// steps run on the render thread between frames, then on the simulation thread (window/sim_loop.h)
+// The cost of a step and of rendering a frame are both calibrated to 40% of the timestep on the host,
+// so that the gain does not depend on the speed of the processor
+
+#include "benchmarks.h"
+
+#include <window/sim_loop.h>
+
+#include <cmath>
+
+#define BENCH_SIM_PARTICLES 1024
+#define BENCH_SIM_TIMESTEP  (1.0 / 120.0)
+#define BENCH_SIM_SECONDS   2.0
+
+// Fraction of the timestep a step, and the render work of a frame, are calibrated to
+#define BENCH_SIM_WORK_FRACTION 0.4
+
+struct BenchSimParticle
+{
+    f32 x, y;
+    f32 vx, vy;
+};
+
+struct BenchSimState
+{
+    BenchSimParticle particles[BENCH_SIM_PARTICLES];
+};
+
+struct BenchSimContext
+{
+    u32 step_iterations;
+    u32 render_iterations;
+};
+
+// Stand-in for per-particle work (forces, collisions...), the cost of which grows with iterations
+static f32 BenchSimParticleWork(const BenchSimParticle* particle, u32 iterations)
+{
+    f32 sum = 0.0f;
+    for (u32 i = 0; i < iterations; i++)
+        sum += std::sin(particle->x * (f32)(i + 1)) * std::cos(particle->y + (f32)i);
+
+    return sum / (f32)(iterations + 1);
+}
+
+static void BenchSimStep(void* state, f64 timestep, u64 step, void* user_data)
+{
+    (void)step;
+
+    BenchSimState* sim = (BenchSimState*)state;
+    const BenchSimContext* context = (const BenchSimContext*)user_data;
+    f32 dt = (f32)timestep;
+
+    for (u32 i = 0; i < BENCH_SIM_PARTICLES; i++)
+    {
+        BenchSimParticle* particle = &sim->particles[i];
+
+        // Pulled towards the center, plus some noise
+        f32 noise = BenchSimParticleWork(particle, context->step_iterations);
+        particle->vx += (-particle->x + noise * 0.1f) * dt;
+        particle->vy += (-particle->y - noise * 0.1f) * dt;
+        particle->x += particle->vx * dt;
+        particle->y += particle->vy * dt;
+    }
+}
+
+static void BenchSimInterpolate(void* dst, const void* prev, const void* next, f32 alpha, void* user_data)
+{
+    (void)user_data;
+
+    const BenchSimState* a = (const BenchSimState*)prev;
+    const BenchSimState* b = (const BenchSimState*)next;
+    BenchSimState* out = (BenchSimState*)dst;
+
+    for (u32 i = 0; i < BENCH_SIM_PARTICLES; i++)
+    {
+        out->particles[i].x = a->particles[i].x + (b->particles[i].x - a->particles[i].x) * alpha;
+        out->particles[i].y = a->particles[i].y + (b->particles[i].y - a->particles[i].y) * alpha;
+        out->particles[i].vx = b->particles[i].vx;
+        out->particles[i].vy = b->particles[i].vy;
+    }
+}
+
+// Stand-in for the CPU side of rendering the particles (culling, building vertices...)
+static f32 BenchSimRender(const BenchSimState* state, u32 iterations)
+{
+    f32 sum = 0.0f;
+    for (u32 i = 0; i < BENCH_SIM_PARTICLES; i++)
+        sum += BenchSimParticleWork(&state->particles[i], iterations);
+
+    return sum / (f32)BENCH_SIM_PARTICLES;
+}
+
+static void BenchSimInitState(BenchSimState* state)
+{
+    for (u32 i = 0; i < BENCH_SIM_PARTICLES; i++)
+    {
+        f32 angle = (f32)i * 0.1f;
+        state->particles[i].x = std::cos(angle) * 0.5f;
+        state->particles[i].y = std::sin(angle) * 0.5f;
+        state->particles[i].vx = -state->particles[i].y;
+        state->particles[i].vy = state->particles[i].x;
+    }
+}
+
+// Number of iterations of BenchSimParticleWork over all particles that take a given time
+static u32 BenchSimCalibrate(const BenchSimState* state, f64 target_time)
+{
+    const u32 probe_iterations = 8;
+
+    f64 start = WindowGetTime();
+    volatile f32 sink = BenchSimRender(state, probe_iterations);
+    (void)sink;
+    f64 time = WindowGetTime() - start;
+
+    u32 iterations = time > 0.0 ? (u32)(probe_iterations * target_time / time) : probe_iterations;
+    return iterations > 0 ? iterations : 1;
+}
+
+void BenchSimLoop()
+{
+    static BenchSimState initial_state;
+    BenchSimInitState(&initial_state);
+
+    BenchSimContext context;
+    context.step_iterations = BenchSimCalibrate(&initial_state, BENCH_SIM_TIMESTEP * BENCH_SIM_WORK_FRACTION);
+    context.render_iterations = context.step_iterations;
+
+    BenchPrint("%u particles, %.0f Hz steps, step and frame work calibrated to %.2f ms each (%u iterations)",
+               BENCH_SIM_PARTICLES, 1.0 / BENCH_SIM_TIMESTEP,
+               BENCH_SIM_TIMESTEP * BENCH_SIM_WORK_FRACTION * 1000.0, context.step_iterations);
+
+    f64 base_fps = 0.0;
+
+    for (u32 threaded = 0; threaded < 2; threaded++)
+    {
+        WindowSimDesc desc;
+        desc.state_size = sizeof(BenchSimState);
+        desc.initial_state = &initial_state;
+        desc.timestep = BENCH_SIM_TIMESTEP;
+        desc.threaded = threaded != 0;
+        desc.step = BenchSimStep;
+        desc.interpolate = BenchSimInterpolate;
+        desc.user_data = &context;
+
+        WindowSimLoop* loop = WindowSimLoopCreate(&desc);
+        if (!loop)
+        {
+            BenchPrint("%s: could not create the simulation loop", threaded ? "Threaded" : "Single thread");
+            continue;
+        }
+
+        u32 frames = 0;
+        f64 render_time = 0.0;
+        f64 start_time = WindowGetTime();
+        f64 elapsed;
+
+        do
+        {
+            const BenchSimState* state = (const BenchSimState*)WindowSimLoopAcquire(loop);
+
+            f64 render_start = WindowGetTime();
+            f32 shade = BenchSimRender(state, context.render_iterations);
+            render_time += WindowGetTime() - render_start;
+
+            BenchClear(0.2f, 0.3f + shade * 0.01f, 0.3f);
+            WindowSwapBuffers();
+
+            frames++;
+            elapsed = WindowGetTime() - start_time;
+        }
+        while (elapsed < BENCH_SIM_SECONDS);
+
+        WindowSimStats stats;
+        WindowSimLoopGetStats(loop, &stats);
+        WindowSimLoopDestroy(loop);
+
+        f64 fps = frames / elapsed;
+        if (!threaded)
+            base_fps = fps;
+
+        BenchPrint(
+            "%s: %.1f fps (x%.2f), %.1f steps/s, step %.3f ms, render %.3f ms, %llu of %llu snapshots rendered, %llu steps dropped",
+            threaded ? "Threaded" : "Single thread",
+            fps,
+            base_fps > 0.0 ? fps / base_fps : 0.0,
+            stats.steps / elapsed,
+            stats.steps > 0 ? stats.step_ms / stats.steps : 0.0,
+            render_time * 1000.0 / frames,
+            (unsigned long long)stats.consumed,
+            (unsigned long long)stats.published,
+            (unsigned long long)stats.dropped_steps
+        );
+    }
+}
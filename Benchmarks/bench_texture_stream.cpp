@@ -0,0 +1,135 @@
+// Texture streaming
+// Places 48 textures of 1024x1024 (half RGBA8, half BC1 if supported) in a ring around a turning camera, and streams
+// their levels (window/texture_stream.h) as they come into view, in a budget holding a fraction of
+// them, then reports the loader bandwidth, the residency and the evictions as the camera turns
+// The levels are generated by the read callback instead of being read from a file, so the bandwidth is
+// that of the loader thread and of the uploads alone
+
+#include "benchmarks.h"
+
+#include <window/texture_stream.h>
+
+#include <cmath>
+#include <cstring>
+
+#define BENCH_STREAM_TEXTURES   48
+#define BENCH_STREAM_SIZE       1024
+#define BENCH_STREAM_BUDGET     (32 * 1024 * 1024)
+#define BENCH_STREAM_FRAMES     240 // One turn of the camera
+#define BENCH_STREAM_REPORT     60  // Frames between two reports
+
+static const f32 sPi = 3.14159265f;
+
+// Fill a level with a value depending on the texture and the level
+static bool BenchStreamRead(void* user_data, u32 level, void* dst, u32 size)
+{
+    u32 index = (u32)(uintptr_t)user_data;
+    std::memset(dst, (int)((index * 16 + level) & 0xFF), size);
+    return true;
+}
+
+static void BenchStreamReport(u32 frame, f64 update_ms)
+{
+    WindowStreamStats stats;
+    WindowStreamGetStats(&stats);
+
+    BenchPrint(
+        "  frame %3u: resident %5.1f / %.0f MB (tails %.2f MB, loading %4.1f MB), %u levels missing, "
+        "%u loads, %u evictions, loader %.0f MB/s, %.1f MB uploaded, update %.3f ms",
+        frame, stats.resident_bytes / (1024.0 * 1024.0), stats.budget / (1024.0 * 1024.0),
+        stats.tail_bytes / (1024.0 * 1024.0), stats.loading_bytes / (1024.0 * 1024.0), stats.missing_levels,
+        stats.loads, stats.evictions, stats.load_mb_per_s, stats.uploaded_bytes / (1024.0 * 1024.0), update_ms
+    );
+}
+
+void BenchTextureStream()
+{
+    if (!WindowStreamInit(BENCH_STREAM_BUDGET))
+    {
+        BenchPrint("Could not start the texture loader");
+        return;
+    }
+
+    WindowStreamTexture* textures[BENCH_STREAM_TEXTURES];
+    u32 full_size = 0;
+
+    // Without S3TC support (PC), every texture is RGBA8
+    bool bc1_supported = WindowIsTextureFormatSupported(WINDOW_TEXTURE_FORMAT_BC1);
+    if (!bc1_supported)
+        BenchPrint("BC1 is not supported, using RGBA8 only");
+
+    for (u32 i = 0; i < BENCH_STREAM_TEXTURES; i++)
+    {
+        WindowStreamTextureDesc desc;
+        desc.width = BENCH_STREAM_SIZE;
+        desc.height = BENCH_STREAM_SIZE;
+        desc.levels = 0;
+        desc.format = (i & 1) && bc1_supported ? WINDOW_TEXTURE_FORMAT_BC1 : WINDOW_TEXTURE_FORMAT_RGBA8;
+        desc.read = BenchStreamRead;
+        desc.user_data = (void*)(uintptr_t)i;
+
+        textures[i] = WindowStreamCreateTexture(&desc);
+        if (!textures[i])
+        {
+            BenchPrint("Could not create texture %u", i);
+            for (u32 j = 0; j < i; j++)
+                WindowStreamDestroyTexture(textures[j]);
+            WindowStreamExit();
+            return;
+        }
+
+        // Full chain: 4/3 of level 0
+        full_size += BENCH_STREAM_SIZE * BENCH_STREAM_SIZE * (desc.format == WINDOW_TEXTURE_FORMAT_BC1 ? 2 : 16) / 3;
+    }
+
+    BenchPrint("%u textures of %ux%u (%.0f MB with all levels), budget %.0f MB",
+               BENCH_STREAM_TEXTURES, BENCH_STREAM_SIZE, BENCH_STREAM_SIZE,
+               full_size / (1024.0 * 1024.0), BENCH_STREAM_BUDGET / (1024.0 * 1024.0));
+
+    f64 update_ms = 0.0;
+    u32 max_used = 0;
+
+    for (u32 frame = 0; frame < BENCH_STREAM_FRAMES; frame++)
+    {
+        f64 start_time = WindowGetTime();
+        WindowStreamUpdate();
+        update_ms += (WindowGetTime() - start_time) * 1000.0;
+
+        WindowStreamStats stats;
+        WindowStreamGetStats(&stats);
+        if (stats.resident_bytes + stats.loading_bytes > max_used)
+            max_used = stats.resident_bytes + stats.loading_bytes;
+
+        BenchClear(0.2f, 0.3f, 0.3f);
+
+        // Textures within 45 degrees of the view direction are visible, and the closer they are to
+        // the center of the view, the larger they are on screen
+        f32 camera = (f32)frame * 2.0f * sPi / BENCH_STREAM_FRAMES;
+        for (u32 i = 0; i < BENCH_STREAM_TEXTURES; i++)
+        {
+            f32 delta = std::fabs(std::remainder((f32)i * 2.0f * sPi / BENCH_STREAM_TEXTURES - camera, 2.0f * sPi));
+            if (delta > sPi / 4.0f)
+                continue;
+
+            u32 screen_size = BENCH_STREAM_SIZE >> (u32)(delta / (sPi / 32.0f));
+
+            WindowStreamRequest(textures[i], WindowStreamGetLevelForSize(textures[i], screen_size));
+            WindowStreamBindTexture(textures[i], 0);
+        }
+
+        WindowSwapBuffers();
+
+        if ((frame + 1) % BENCH_STREAM_REPORT == 0)
+        {
+            BenchStreamReport(frame + 1, update_ms / BENCH_STREAM_REPORT);
+            update_ms = 0.0;
+        }
+    }
+
+    BenchPrint("Peak use %.1f MB of the %.0f MB budget", max_used / (1024.0 * 1024.0), BENCH_STREAM_BUDGET / (1024.0 * 1024.0));
+
+    for (u32 i = 0; i < BENCH_STREAM_TEXTURES; i++)
+        WindowStreamDestroyTexture(textures[i]);
+
+    WindowStreamExit();
+}
@@ -0,0 +1,115 @@
+// Trace overhead
+// Measures the cost of recording a scope with the CPU trace recorder, before recording starts
+// (disabled) and while it runs, on the main thread alone and on every worker at once
+
+#include "benchmarks.h"
+
+#include <window/jobs.h>
+#include <window/trace.h>
+
+// Scopes recorded per round by each thread (half a ring, so that no scope is dropped if the writer
+// thread has drained the rings between rounds)
+#define BENCH_TRACE_SCOPES  (TRACE_RING_SIZE / 2)
+#define BENCH_TRACE_ROUNDS  16
+
+#ifdef TEST_WIN
+#define BENCH_TRACE_PATH "trace_bench.json"
+#else
+#define BENCH_TRACE_PATH "fs:/vol/external01/trace_bench.json"
+#endif
+
+// Record BENCH_TRACE_SCOPES scopes, nested two deep
+static void BenchTraceRecord()
+{
+    for (u32 i = 0; i < BENCH_TRACE_SCOPES / 2; i++)
+    {
+        TraceBegin("Outer");
+        TraceBegin("Inner");
+        TraceEnd();
+        TraceEnd();
+    }
+}
+
+static void BenchTraceJob(u32 worker, u32 worker_count, void* user_data)
+{
+    f64* times = (f64*)user_data;
+
+    f64 start = WindowGetTime();
+    BenchTraceRecord();
+    times[worker] = WindowGetTime() - start;
+}
+
+// Wait for the writer thread to write every scope recorded so far
+static void BenchTraceWaitForWriter()
+{
+    TraceStats stats;
+    do
+    {
+        TraceGetStats(&stats);
+    } while (stats.written + stats.dropped < stats.recorded);
+}
+
+void BenchTraceOverhead()
+{
+    // Not recording yet: each call only checks whether recording has started
+    f64 start = WindowGetTime();
+    for (u32 i = 0; i < BENCH_TRACE_ROUNDS; i++)
+        BenchTraceRecord();
+    f64 disabled_ns = (WindowGetTime() - start) * 1e9 / (BENCH_TRACE_ROUNDS * BENCH_TRACE_SCOPES);
+
+    if (!TraceInit(BENCH_TRACE_PATH))
+    {
+        BenchPrint("Could not start recording to " BENCH_TRACE_PATH);
+        return;
+    }
+
+    TraceSetThreadName("Main");
+
+    // Main thread alone
+    f64 main_time = 0.0;
+    for (u32 i = 0; i < BENCH_TRACE_ROUNDS; i++)
+    {
+        start = WindowGetTime();
+        BenchTraceRecord();
+        main_time += WindowGetTime() - start;
+
+        BenchTraceWaitForWriter();
+    }
+    f64 main_ns = main_time * 1e9 / (BENCH_TRACE_ROUNDS * BENCH_TRACE_SCOPES);
+
+    // Every worker at once (started after TraceInit so that they are named in the trace)
+    f64 workers_ns = 0.0;
+    u32 num_workers = 0;
+    if (JobsInit(0))
+    {
+        num_workers = JobsGetWorkerCount();
+
+        f64 times[JOBS_MAX_WORKERS];
+        f64 worker_time = 0.0;
+        for (u32 i = 0; i < BENCH_TRACE_ROUNDS; i++)
+        {
+            JobsRun(BenchTraceJob, times);
+            for (u32 j = 0; j < num_workers; j++)
+                worker_time += times[j];
+
+            BenchTraceWaitForWriter();
+        }
+        workers_ns = worker_time * 1e9 / (BENCH_TRACE_ROUNDS * BENCH_TRACE_SCOPES * num_workers);
+
+        JobsExit();
+    }
+
+    TraceStats stats;
+    TraceGetStats(&stats);
+    TraceExit();
+
+    BenchPrint("%u scopes per thread per round, %u rounds", BENCH_TRACE_SCOPES, BENCH_TRACE_ROUNDS);
+    BenchPrint("  Disabled:             %6.1f ns per scope", disabled_ns);
+    BenchPrint("  Main thread:          %6.1f ns per scope", main_ns);
+    BenchPrint("  %2u workers at once:   %6.1f ns per scope", num_workers, workers_ns);
+    BenchPrint(
+        "  %u threads, %llu scopes recorded, %llu written, %llu dropped (written to " BENCH_TRACE_PATH ")",
+        stats.num_threads, (unsigned long long)stats.recorded, (unsigned long long)stats.written,
+        (unsigned long long)stats.dropped
+    );
+}
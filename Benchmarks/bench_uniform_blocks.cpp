@@ -0,0 +1,189 @@
+// Uniform blocks
+// Draws many small objects per frame, first with each draw writing its uniforms into registers
+// (uniform register mode), then with every object's uniforms allocated from the per-frame uniform
+// buffer and each draw only binding its block (uniform block mode), and compares the frame costs
+
+#include "benchmarks.h"
+
+#include <window/cmd_list.h>
+#include <window/jobs.h>
+#include <window/uniform_buffer.h>
+
+#include <cmath>
+
+#define BENCH_UBO_OBJECTS   4096
+#define BENCH_UBO_FRAMES    60
+#define BENCH_UBO_LISTS     3
+#define BENCH_UBO_LIST_SIZE 0x100000
+
+struct BenchUboFrame
+{
+    WindowShaderSet shaders;
+    WindowVertexInput input;
+    u32 offset_location;
+    u32 frame;
+};
+
+// Per-object uniforms (one vec4, as in the shaders)
+static void BenchUboComputeOffset(u32 object, u32 frame, f32* offset)
+{
+    f32 angle = (f32)(object * 7 + frame) * 0.0015f;
+    f32 radius = 0.2f + (f32)(object % 64) * (0.7f / 64.0f);
+
+    offset[0] = std::cos(angle) * radius;
+    offset[1] = std::sin(angle) * radius;
+    offset[2] = 0.0f;
+    offset[3] = 0.03f;
+}
+
+static void BenchUboRecordRegisters(WindowCmdList* cmd_list, u32 index, u32 count, void* user_data)
+{
+    BenchUboFrame* frame = (BenchUboFrame*)user_data;
+
+    WindowCmdSetShaders(cmd_list, &frame->shaders);
+    WindowCmdSetVertexInput(cmd_list, &frame->input);
+
+    u32 begin, end;
+    JobsSplitRange(BENCH_UBO_OBJECTS, index, count, &begin, &end);
+
+    for (u32 i = begin; i < end; i++)
+    {
+        f32 offset[4];
+        BenchUboComputeOffset(i, frame->frame, offset);
+
+        // The values are copied into the command stream of every draw
+        WindowCmdSetVertexUniforms(cmd_list, frame->offset_location, 1, offset);
+        WindowCmdDraw(cmd_list, 3, 0);
+    }
+}
+
+static void BenchUboRecordBlocks(WindowCmdList* cmd_list, u32 index, u32 count, void* user_data)
+{
+    BenchUboFrame* frame = (BenchUboFrame*)user_data;
+
+    WindowCmdSetShaders(cmd_list, &frame->shaders);
+    WindowCmdSetVertexInput(cmd_list, &frame->input);
+
+    u32 begin, end;
+    JobsSplitRange(BENCH_UBO_OBJECTS, index, count, &begin, &end);
+
+    for (u32 i = begin; i < end; i++)
+    {
+        // The values are written once into the frame's uniform buffer; the draw only refers to them
+        WindowUniformBlock block;
+        f32* offset = (f32*)WindowUniformAlloc(4 * sizeof(f32), &block);
+        if (!offset)
+            break;
+
+        BenchUboComputeOffset(i, frame->frame, offset);
+
+        WindowCmdSetVertexUniformBlock(cmd_list, 0, &block);
+        WindowCmdDraw(cmd_list, 3, 0);
+    }
+}
+
+// Render frames and print the average times
+static void BenchUboRun(const char* name, WindowRecordFunc record_func, BenchUboFrame* frame, bool blocks)
+{
+    f64 record_ms = 0.0, submit_ms = 0.0;
+    WindowCmdStats stats;
+
+    f64 start_time = WindowGetTime();
+
+    for (u32 i = 0; i < BENCH_UBO_FRAMES; i++)
+    {
+        frame->frame = i;
+
+        if (blocks)
+            WindowUniformBeginFrame();
+
+        BenchClear(0.2f, 0.3f, 0.3f);
+
+        WindowCmdRecord(record_func, frame);
+        WindowCmdSubmit();
+
+        WindowSwapBuffers();
+
+        WindowCmdGetStats(&stats);
+        record_ms += stats.record_ms;
+        submit_ms += stats.submit_ms;
+    }
+
+    f64 frame_ms = (WindowGetTime() - start_time) * 1000.0 / BENCH_UBO_FRAMES;
+
+    if (blocks)
+    {
+        WindowUniformStats uniform_stats;
+        WindowUniformGetStats(&uniform_stats);
+
+        BenchPrint(
+            "%s: record %.3f ms, submit %.3f ms, frame %.3f ms, %u KB of lists, %u KB of uniforms (%u-byte blocks), %u fence waits, %u failed allocations",
+            name,
+            record_ms / BENCH_UBO_FRAMES,
+            submit_ms / BENCH_UBO_FRAMES,
+            frame_ms,
+            stats.bytes_used / 1024,
+            uniform_stats.peak_bytes / 1024,
+            uniform_stats.alignment,
+            uniform_stats.fence_waits,
+            uniform_stats.failed_allocs
+        );
+    }
+    else
+    {
+        BenchPrint(
+            "%s: record %.3f ms, submit %.3f ms, frame %.3f ms, %u KB of lists",
+            name,
+            record_ms / BENCH_UBO_FRAMES,
+            submit_ms / BENCH_UBO_FRAMES,
+            frame_ms,
+            stats.bytes_used / 1024
+        );
+    }
+}
+
+void BenchUniformBlocks()
+{
+    if (!JobsInit(BENCH_UBO_LISTS))
+    {
+        BenchPrint("Could not start the job pool");
+        return;
+    }
+
+    if (!WindowCmdInit(BENCH_UBO_LISTS, BENCH_UBO_LIST_SIZE))
+    {
+        BenchPrint("Could not create the command lists");
+        JobsExit();
+        return;
+    }
+
+    BenchPrint("%u objects per frame, %u lists", BENCH_UBO_OBJECTS, BENCH_UBO_LISTS);
+
+    BenchUboFrame frame;
+    BenchCreateTriangleShaders(&frame.shaders, &frame.offset_location);
+    BenchCreateTriangleInput(&frame.input);
+
+    BenchUboRun("Uniform registers", BenchUboRecordRegisters, &frame, false);
+
+    // Room for every object's block (blocks are aligned, so each takes at least 256 bytes)
+    if (!WindowUniformInit(BENCH_UBO_OBJECTS * 256))
+    {
+        BenchPrint("Could not create the uniform buffer");
+    }
+    else
+    {
+        BenchCreateTriangleBlockShaders(&frame.shaders);
+
+        WindowUniformStats uniform_stats;
+        WindowUniformGetStats(&uniform_stats);
+        BenchPrint("Uniform buffer: 2 x %u KB%s", uniform_stats.frame_size / 1024, uniform_stats.persistent ? ", persistently mapped" : "");
+
+        BenchUboRun("Uniform blocks", BenchUboRecordBlocks, &frame, true);
+
+        WindowUniformExit();
+        WindowSetShaderMode(WINDOW_SHADER_MODE_UNIFORM_REGISTER);
+    }
+
+    WindowCmdExit();
+    JobsExit();
+}
@@ -0,0 +1,46 @@
+// Benchmarks for the windowing library and the modules built on top of it
+
+#ifndef BENCHMARKS_H_
+#define BENCHMARKS_H_
+
+#include <window/window.h>
+
+// Print a line of benchmark output (to stdout on PC, to the system log with OSReport on Wii U)
+void BenchPrint(const char* fmt, ...);
+
+// Clear the window color buffer
+void BenchClear(f32 r, f32 g, f32 b);
+
+// Set up the shaders of Test 3 (a single vec3 position attribute at location 0)
+// On PC, the vertex shader also adds the "u_offset" vec4 uniform to the position;
+// its location is returned through pOffsetLocation (0 on Wii U, where it is the first uniform register)
+void BenchCreateTriangleShaders(WindowShaderSet* pShaders, u32* pOffsetLocation);
+
+// Same shaders, in uniform block mode: the vertex shader reads "u_offset" from vertex uniform block 0
+// (On Wii U, the Test 3 shaders are used as they are, so the block is not read)
+void BenchCreateTriangleBlockShaders(WindowShaderSet* pShaders);
+
+// Set up a vertex input holding a small triangle
+void BenchCreateTriangleInput(WindowVertexInput* pInput);
+
+// Benchmarks (one per file)
+void BenchCmdScaling();
+void BenchRenderTargets();
+void BenchFramebufferPlan();
+void BenchDynamicResolution();
+void BenchMsaa();
+void BenchUniformBlocks();
+void BenchShaderPartition();
+void BenchGpuScopes();
+void BenchTraceOverhead();
+void BenchLifecycle();
+void BenchBufferUpload();
+void BenchBatching();
+void BenchRenderQueue();
+void BenchCulling();
+void BenchTextureStream();
+void BenchAssetPack();
+void BenchFrameGraph();
+void BenchSimLoop();
+
+#endif // BENCHMARKS_H_
@@ -0,0 +1,75 @@
+// Benchmark runner
+// Runs every benchmark, or only those named on the command line (PC)
+
+#include "benchmarks.h"
+
+#include <cstring>
+
+struct Benchmark
+{
+    const char* name;
+    void (*func)();
+};
+
+static const Benchmark sBenchmarks[] = {
+    { "cmd_scaling", BenchCmdScaling },
+    { "render_targets", BenchRenderTargets },
+    { "framebuffer_plan", BenchFramebufferPlan },
+    { "dynamic_resolution", BenchDynamicResolution },
+    { "msaa", BenchMsaa },
+    { "uniform_blocks", BenchUniformBlocks },
+    { "shader_partition", BenchShaderPartition },
+    { "gpu_scopes", BenchGpuScopes },
+    { "trace_overhead", BenchTraceOverhead },
+    { "lifecycle", BenchLifecycle },
+    { "buffer_upload", BenchBufferUpload },
+    { "batching", BenchBatching },
+    { "render_queue", BenchRenderQueue },
+    { "culling", BenchCulling },
+    { "texture_stream", BenchTextureStream },
+    { "asset_pack", BenchAssetPack },
+    { "frame_graph", BenchFrameGraph },
+    { "sim_loop", BenchSimLoop },
+};
+
+static bool BenchIsSelected(const char* name, int argc, char** argv)
+{
+    if (argc < 2)
+        return true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    u32 fb_width, fb_height;
+    if (!WindowInit(1280, 720, &fb_width, &fb_height))
+        return -1;
+
+    // Measure raw throughput, not the display
+    WindowSetSwapInterval(0);
+
+    for (u32 i = 0; i < sizeof(sBenchmarks) / sizeof(sBenchmarks[0]); i++)
+    {
+        if (!BenchIsSelected(sBenchmarks[i].name, argc, argv))
+            continue;
+
+        BenchPrint("=== %s ===", sBenchmarks[i].name);
+        sBenchmarks[i].func();
+    }
+
+#ifdef TEST_GX2
+    // Keep the results on screen until the application is closed from the HOME Menu
+    while (WindowIsRunning())
+        WindowSwapBuffers();
+#endif
+
+    WindowExit();
+    return 0;
+}
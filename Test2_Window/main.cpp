@@ -1,32 +1,122 @@
 // Test for creation of a window
 // Renders animated colors through the color buffer clear color
+// The colors are animated by a simulation thread at a fixed rate (see window/sim_loop.h), so the
+// animation runs at the same speed whatever the frame rate
 
 #include <window/window.h>
+#include <window/sim_loop.h>
 
 #ifdef TEST_WIN
-#include <GLFW/glfw3.h>
+#include <GL/glew.h>
 #else // TEST_GX2
 #include <gx2/clear.h>
 #endif
 
+// Build with WINDOW_CAPTURE defined to capture the calls below (see window/capture.h)
+#include <window/capture_calls.h>
+
+// State of the simulation: the color and how fast each channel changes per step
+struct ColorState
+{
+    f32 r, r_step;
+    f32 g, g_step;
+    f32 b, b_step;
+};
+
+// Move a channel by its step, bouncing between 0 and 1
+static void StepChannel(f32* value, f32* step)
+{
+    *value += *step;
+
+    if (*value >= 1.0 || *value <= 0.0)
+    {
+        *step = -*step;
+
+        if (*value > 1.0)
+            *value = 1.0;
+        else if (*value < 0.0)
+            *value = 0.0;
+    }
+}
+
+// Called on the simulation thread, 60 times per second
+static void StepColor(void* state, f64 timestep, u64 step, void* user_data)
+{
+    ColorState* color = (ColorState*)state;
+
+    StepChannel(&color->r, &color->r_step);
+    StepChannel(&color->g, &color->g_step);
+    StepChannel(&color->b, &color->b_step);
+}
+
+// Called on the render thread, to blend the two newest steps
+static void InterpolateColor(void* dst, const void* prev, const void* next, f32 alpha, void* user_data)
+{
+    const ColorState* a = (const ColorState*)prev;
+    const ColorState* b = (const ColorState*)next;
+    ColorState* color = (ColorState*)dst;
+
+    *color = *b;
+    color->r = a->r + (b->r - a->r) * alpha;
+    color->g = a->g + (b->g - a->g) * alpha;
+    color->b = a->b + (b->b - a->b) * alpha;
+}
+
 int main()
 {
+#ifdef WINDOW_CAPTURE
+    // Record the calls into a capture file, to replay with tools/capture_replay
+    // Started first so that WindowInit is captured as well
+    CaptureInit(CAPTURE_DEFAULT_PATH);
+#endif
+
     u32 fb_width, fb_height;
     if (!WindowInit(1280, 720, &fb_width, &fb_height))
+    {
+#ifdef WINDOW_CAPTURE
+        CaptureExit();
+#endif
         return -1;
+    }
 
     // Make window context current
     //WindowMakeContextCurrent();
     // No need, automatically done by WindowInit()
 
-    f32 r = 0.0, r_step = 0.01;
-    f32 g = 0.0, g_step = 0.02;
-    f32 b = 0.0, b_step = 0.04;
+    const ColorState initial_color = {
+        0.0f, 0.01f,
+        0.0f, 0.02f,
+        0.0f, 0.04f
+    };
+
+    // Start the simulation thread
+    WindowSimDesc sim_desc;
+    sim_desc.state_size = sizeof(ColorState);
+    sim_desc.initial_state = &initial_color;
+    sim_desc.timestep = 1.0 / 60.0;
+    sim_desc.threaded = true;
+    sim_desc.step = StepColor;
+    sim_desc.interpolate = InterpolateColor;
+    sim_desc.user_data = NULL;
+
+    WindowSimLoop* sim = WindowSimLoopCreate(&sim_desc);
+    if (!sim)
+    {
+        WindowExit();
+#ifdef WINDOW_CAPTURE
+        CaptureExit();
+#endif
+        return -1;
+    }
 
     while (WindowIsRunning())
     {
         // Window context should already be current at this point
 
+        // Newest color published by the simulation thread
+        const ColorState* color = (const ColorState*)WindowSimLoopAcquire(sim);
+        f32 r = color->r, g = color->g, b = color->b;
+
 #ifdef TEST_WIN
 
         // Set the current clear color to the given color
@@ -49,43 +139,16 @@ int main()
         WindowMakeContextCurrent();
 
 #endif
-        r += r_step;
-        g += g_step;
-        b += b_step;
-
-        if (r >= 1.0 || r <= 0.0)
-        {
-            r_step = -r_step;
-
-            if (r > 1.0)
-                r = 1.0;
-            else if (r < 0.0)
-                r = 0.0;
-        }
-
-        if (g >= 1.0 || g <= 0.0)
-        {
-            g_step = -g_step;
-
-            if (g > 1.0)
-                g = 1.0;
-            else if (g < 0.0)
-                g = 0.0;
-        }
-
-        if (b >= 1.0 || b <= 0.0)
-        {
-            b_step = -b_step;
-
-            if (b > 1.0)
-                b = 1.0;
-            else if (b < 0.0)
-                b = 0.0;
-        }
 
         WindowSwapBuffers();
     }
 
+    WindowSimLoopDestroy(sim);
     WindowExit();
+
+#ifdef WINDOW_CAPTURE
+    CaptureExit();
+#endif
+
     return 0;
 }
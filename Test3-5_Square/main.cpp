@@ -2,12 +2,13 @@
 // Based on second half of:
 // https://learnopengl.com/Getting-started/Hello-Triangle
 
+#include <window/buffer.h>
+#include <window/coherency.h>
 #include <window/window.h>
 
 #ifdef TEST_WIN
 
 #include <GL/glew.h>
-#include <GLFW/glfw3.h>
 
 #else // TEST_GX2
 
@@ -15,18 +16,34 @@
 
 #include <coreinit/memdefaultheap.h>
 #include <gx2/clear.h>
-#include <gx2/draw.h>
 #include <gx2/mem.h>
 #include <gx2/registers.h>
 #include <gx2/utils.h>
 
 #endif
 
+// Build with WINDOW_CAPTURE defined to capture the calls below (see window/capture.h)
+#include <window/capture_calls.h>
+
+// Build with WINDOW_COHERENCY defined to audit the cache invalidations below (see window/coherency.h)
+#include <window/coherency_calls.h>
+
 int main()
 {
+#ifdef WINDOW_CAPTURE
+    // Record the calls into a capture file, to replay with tools/capture_replay
+    // Started first so that WindowInit is captured as well
+    CaptureInit(CAPTURE_DEFAULT_PATH);
+#endif
+
     u32 fb_width, fb_height;
     if (!WindowInit(1280, 720, &fb_width, &fb_height))
+    {
+#ifdef WINDOW_CAPTURE
+        CaptureExit();
+#endif
         return -1;
+    }
 
     /*        Make window context current        */
 
@@ -47,15 +64,21 @@ int main()
     // Index buffers are dealt with in the same way as method 2; the index buffer pointer must be
     // passed to the draw function when drawing.
 
-    // The LearnOpenGL example used the first method, but for the sake of comparison with GX2,
-    // the second method will be used here instead for the OpenGL version of this example.
-    // This is inefficient since the index buffer will be copied to the GPU on every draw call.
-    // However, that isn't a problem on Wii U since the index buffer memory is shared between the CPU
+    // The second method is inefficient since the index buffer is copied to the GPU on every draw
+    // call. That isn't a problem on Wii U since the index buffer memory is shared between the CPU
     // and GPU and no copying happens between them.
 
+    // To get the same behavior in OpenGL, the vertex and index buffers are created with WindowBuffer
+    // (window/buffer.h): by default, the buffer objects are mapped persistently (ARB_buffer_storage)
+    // and written in place, like the Wii U shared memory, and the EBO is bound to the VAO only once.
+    // (Call WindowSetBufferMode(WINDOW_BUFFER_MODE_CLIENT) before creating the buffers to go back to
+    // the second method, or WINDOW_BUFFER_MODE_COPY for plain glBufferData copies.)
+
     // Note: GX2 treats index buffers the same as attribute buffers when it comes to shared memory:
     // * Cache must be invalidated and data can be altered or freed only after the draw call is done.
     // * Alignment is not a requirement, but there is a recommended value (32 for index buffers).
+    // WindowBufferCreate and WindowBufferFlush invalidate the cache; the same rules apply to
+    // persistently-mapped buffers in OpenGL.
 
     /*        Create Shader Program        */
 
@@ -122,7 +145,7 @@ int main()
 
 #endif
 
-    /*        Create VBO        */
+    /*        Create VBO and EBO        */
 
     // Positions of the square vertices
     const f32 pos_data[] = {
@@ -145,42 +168,43 @@ int main()
     // Bind it
     glBindVertexArray(VAO);
 
-    // Generate VBO
-    u32 VBO;
-    glGenBuffers(1, &VBO);
-    // Bind it
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // Set data of currently bound VBO
-    glBufferData(GL_ARRAY_BUFFER, sizeof(pos_data), pos_data, GL_STATIC_DRAW);
-
-    // We will not use an EBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_NONE);
-
-#else // TEST_GX2
+#endif
 
-    // Make sure to flush CPU cache and invalidate GPU cache
-    GX2Invalidate(GX2_INVALIDATE_MODE_CPU_ATTRIBUTE_BUFFER, (void*)pos_data, sizeof(pos_data));
+    // Create the buffers with their data
+    // (On Wii U, they are allocated in MEM2 and the CPU cache is flushed and the GPU cache invalidated)
+    WindowBuffer* vertex_buffer = WindowBufferCreate(WINDOW_BUFFER_TYPE_VERTEX, sizeof(pos_data), pos_data);
+    WindowBuffer* index_buffer = WindowBufferCreate(WINDOW_BUFFER_TYPE_INDEX, sizeof(idx_data), idx_data);
+    if (!vertex_buffer || !index_buffer)
+    {
+        WindowBufferDestroy(vertex_buffer);
+        WindowBufferDestroy(index_buffer);
+        WindowExit();
+#ifdef WINDOW_CAPTURE
+        CaptureExit();
+#endif
+        return -1;
+    }
 
     // Index of vertex buffer slot we are going to use
     u32 VBO = 0;
-    // Set its data
-    GX2SetAttribBuffer(
+    // Use the vertex buffer for it
+    // - OpenGL: binds the VBO to GL_ARRAY_BUFFER
+    // - GX2: sets the attribute buffer of the slot (GX2SetAttribBuffer)
+    WindowSetVertexBuffer(
         VBO,               // Vertex buffer slot to bind the data to
-        sizeof(pos_data),  // Size of buffer data
-        3 * sizeof(float), // Stride (Size of each vertex)
-        pos_data           // Buffer data
+        vertex_buffer,     // Buffer
+        3 * sizeof(float)  // Stride (Size of each vertex)
     );
 
-    // Make sure to flush CPU cache and invalidate GPU cache for the index buffer too
-    GX2Invalidate(GX2_INVALIDATE_MODE_CPU_ATTRIBUTE_BUFFER, (void*)idx_data, sizeof(idx_data));
-
-#endif
+    // Use the index buffer for the draws
+    // (In OpenGL, the EBO is bound to the VAO, which remembers it from now on)
+    WindowSetIndexBuffer(index_buffer);
 
     /*        Describe our vertex attributes for the vertex fetch stage        */
 
 #ifdef TEST_WIN
 
-    // VBO is already bound at this stage
+    // VBO is already bound at this stage (the slot index is the attribute location here)
 
     // Set vertex attribute at location 0 (position)
     glEnableVertexAttribArray(0);
@@ -310,11 +334,9 @@ int main()
 
         /*        Draw the triangle        */
 
-#ifdef TEST_WIN
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)idx_data);
-#else // TEST_GX2
-        GX2DrawIndexedEx(GX2_PRIMITIVE_MODE_TRIANGLES, 6, GX2_INDEX_TYPE_U32, (void*)idx_data, 0, 1);
-#endif
+        // - OpenGL: glDrawElements with an offset into the EBO (or the index data in client mode)
+        // - GX2: GX2DrawIndexedEx with the index buffer address
+        WindowDrawIndexed(6, 0);
 
         WindowSwapBuffers();
     }
@@ -324,7 +346,6 @@ int main()
 #ifdef TEST_WIN
 
     glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
-    glDeleteBuffers(1, &VBO);
 
     glBindVertexArray(GL_NONE);
     glDeleteVertexArrays(1, &VAO);
@@ -334,10 +355,26 @@ int main()
 
 #else // TEST_GX2
 
-    // TODO: The program can't break from the main loop yet
+    // The loop ends when the application is closed from the HOME Menu
+    // (The shader programs are static, only the fetch shader program was allocated)
+    MEMFreeToDefaultHeap(triangle_FSH_program);
+
+#endif
+
+    // (On Wii U, the GPU is already done with them: it was made idle when the foreground was released)
+    WindowBufferDestroy(vertex_buffer);
+    WindowBufferDestroy(index_buffer);
 
+#ifdef WINDOW_COHERENCY
+    // Report the invalidations that were not needed and the ones that were missing
+    CoherencyPrint();
 #endif
 
     WindowExit();
+
+#ifdef WINDOW_CAPTURE
+    CaptureExit();
+#endif
+
     return 0;
 }
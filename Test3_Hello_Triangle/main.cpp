@@ -3,11 +3,13 @@
 // https://learnopengl.com/Getting-started/Hello-Triangle
 
 #include <window/window.h>
+#include <window/coherency.h>
+#include <window/gpu_profiler.h>
+#include <window/trace.h>
 
 #ifdef TEST_WIN
 
 #include <GL/glew.h>
-#include <GLFW/glfw3.h>
 #include <iostream>
 
 #else // TEST_GX2
@@ -22,17 +24,48 @@
 
 #endif
 
+// Build with WINDOW_CAPTURE defined to capture the calls below (see window/capture.h)
+#include <window/capture_calls.h>
+
+// Build with WINDOW_COHERENCY defined to audit the cache invalidations below (see window/coherency.h)
+#include <window/coherency_calls.h>
+
 int main()
 {
+#ifdef WINDOW_CAPTURE
+    // Record the calls into a capture file, to replay with tools/capture_replay
+    // Started first so that WindowInit is captured as well
+    CaptureInit(CAPTURE_DEFAULT_PATH);
+#endif
+
+    // Record where the CPU time goes into a trace file (open it in chrome://tracing or ui.perfetto.dev)
+    // Started first so that WindowInit is traced as well
+#ifdef TEST_WIN
+    TraceInit("trace.json");
+#else // TEST_GX2
+    TraceInit("fs:/vol/external01/trace.json");
+#endif
+
     u32 fb_width, fb_height;
     if (!WindowInit(1280, 720, &fb_width, &fb_height))
+    {
+#ifdef WINDOW_CAPTURE
+        CaptureExit();
+#endif
+        TraceExit();
         return -1;
+    }
 
     /*        Make window context current        */
 
     // No need, automatically done by WindowInit()
     //WindowMakeContextCurrent();
 
+    // Measure how long the GPU takes to clear, draw and swap
+    // (The results are printed every few seconds)
+    WindowGpuProfilerInit();
+    u32 frame = 0;
+
     /*        Create Shader Program        */
 
 #ifdef TEST_WIN
@@ -182,7 +215,8 @@ int main()
     /*        Create VBO        */
 
     // Positions of the triangle vertices
-    const f32 pos_data[] = {
+    // (Static, since on Wii U the GPU keeps reading them from this memory for as long as the program runs)
+    static const f32 pos_data[] = {
         -0.5f, -0.5f, 0.0f,
          0.5f, -0.5f, 0.0f,
          0.0f,  0.5f, 0.0f
@@ -228,6 +262,9 @@ int main()
     // do *not* require special alignment, but it is recommended that they are aligned by 64
     // (They do still require cache invalidation)
 
+    // pos_data is static: the CPU wrote its values when the program was loaded, so they may still be in the CPU cache
+    COHERENCY_CPU_WRITE(pos_data, sizeof(pos_data));
+
     // Make sure to flush CPU cache and invalidate GPU cache
     // (GX2_INVALIDATE_MODE_ATTRIBUTE_BUFFER: Invalidate attribute buffer cache on the GPU)
     GX2Invalidate(GX2_INVALIDATE_MODE_CPU_ATTRIBUTE_BUFFER, (void*)pos_data, sizeof(pos_data));
@@ -383,10 +420,15 @@ int main()
 
     while (WindowIsRunning())
     {
+        TraceBegin("Frame");
+
         /*        Clear the color buffer        */
 
         // Window context should already be current at this point
 
+        TraceBegin("Clear");
+        WindowGpuScopeBegin("Clear");
+
 #ifdef TEST_WIN
 
         // Set the current clear color to the given color
@@ -410,15 +452,29 @@ int main()
 
 #endif
 
+        WindowGpuScopeEnd();
+        TraceEnd();
+
         /*        Draw the triangle        */
 
+        TraceBegin("Draw");
+        WindowGpuScopeBegin("Draw");
+
 #ifdef TEST_WIN
         glDrawArrays(GL_TRIANGLES, 0, 3);
 #else // TEST_GX2
         GX2DrawEx(GX2_PRIMITIVE_MODE_TRIANGLES, 3, 0, 1);
 #endif
 
+        WindowGpuScopeEnd();
+        TraceEnd();
+
         WindowSwapBuffers();
+
+        if (++frame % 600 == 0)
+            WindowGpuProfilerPrint();
+
+        TraceEnd();
     }
 
     /*        Free resources        */
@@ -436,10 +492,23 @@ int main()
 
 #else // TEST_GX2
 
-    // TODO: The program can't break from the main loop yet
+    // The loop ends when the application is closed from the HOME Menu
+    // (The shader programs and attribute data are static, only the fetch shader program was allocated)
+    MEMFreeToDefaultHeap(triangle_FSH_program);
+
+#endif
 
+#ifdef WINDOW_COHERENCY
+    // Report the invalidations that were not needed and the ones that were missing
+    CoherencyPrint();
 #endif
 
     WindowExit();
+
+#ifdef WINDOW_CAPTURE
+    CaptureExit();
+#endif
+
+    TraceExit();
     return 0;
 }
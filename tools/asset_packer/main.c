@@ -0,0 +1,680 @@
+// Asset packer
+// Builds an asset pack (window/asset_pack_format.h) from a manifest listing its assets, for the Wii U
+// (big-endian, GX2 shaders and tiled textures) or for PC (little-endian, GLSL sources and untiled
+// textures), with every payload stored at the offset alignment GX2 wants for it
+//
+// Manifest: one asset per line, "<type> <name> <file> [argument]", with paths relative to the manifest
+// Lines starting with "wiiu:" or "pc:" only apply to that platform, and '#' starts a comment
+//   blob <name> <file> [alignment]         Bytes, stored as they are (64-byte aligned by default)
+//   vertex <name> <file> [element size]    Vertex data, little-endian, swapped to big-endian by elements
+//                                          of 1, 2 or 4 bytes (default 4) in Wii U packs
+//   index <name> <file>                    32-bit indices, little-endian
+//   vertex_shader <name> <file>            Wii U: the first vertex shader of a .gsh file; PC: GLSL source
+//   pixel_shader <name> <file>             Wii U: the first pixel shader of a .gsh file; PC: GLSL source
+//   fetch_shader <name> <attrib>...        Attributes as location:buffer:offset:format, with format
+//                                          float1, float2, float3, float4 or unorm8x4
+//   texture <name> <file>                  A .gtx file (e.g. from texture_encoder), untiled for PC packs
+
+#include <window/asset_pack_format.h>
+
+#include "../texture_encoder/surface_layout.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// GFD (.gsh, .gtx) file format: a file header followed by blocks; all fields are big-endian
+#define GFD_FILE_MAGIC  0x47667832  // "Gfx2"
+#define GFD_BLOCK_MAGIC 0x424C4B7B  // "BLK{"
+
+#define GFD_BLOCK_END_OF_FILE           1
+#define GFD_BLOCK_VERTEX_SHADER_HEADER  3
+#define GFD_BLOCK_VERTEX_SHADER_PROGRAM 5
+#define GFD_BLOCK_PIXEL_SHADER_HEADER   6
+#define GFD_BLOCK_PIXEL_SHADER_PROGRAM  7
+#define GFD_BLOCK_TEXTURE_HEADER        11
+#define GFD_BLOCK_TEXTURE_IMAGE         12
+#define GFD_BLOCK_TEXTURE_MIPMAP        13
+
+// Shader header blocks end with a relocation header, listing the pointer fields of the serialized
+// structure; a pointer holds a tag in its upper bits and an offset from the start of the block
+#define GFD_RELOCATION_MAGIC    0x7D424C4B  // "}BLK"
+#define GFD_RELOCATION_SIZE     0x28
+#define GFD_PATCH_MASK          0xFFF00000
+#define GFD_PATCH_DATA          0xD0600000
+#define GFD_PATCH_TEXT          0xCA700000
+
+// Offsets of the program pointer of the serialized GX2VertexShader and GX2PixelShader
+// (after their 52 and 41 registers and the program size)
+#define GX2_VERTEX_SHADER_PROGRAM_OFFSET 0xD4
+#define GX2_PIXEL_SHADER_PROGRAM_OFFSET  0xA8
+
+// Fields of the serialized GX2Texture
+#define GX2_TEXTURE_SIZE                0x9C
+#define GX2_TEXTURE_WIDTH_OFFSET        0x04
+#define GX2_TEXTURE_HEIGHT_OFFSET       0x08
+#define GX2_TEXTURE_LEVELS_OFFSET       0x10
+#define GX2_TEXTURE_FORMAT_OFFSET       0x14
+#define GX2_TEXTURE_IMAGE_SIZE_OFFSET   0x20
+#define GX2_TEXTURE_IMAGE_OFFSET        0x24
+#define GX2_TEXTURE_MIPMAP_SIZE_OFFSET  0x28
+#define GX2_TEXTURE_MIPMAPS_OFFSET      0x2C
+#define GX2_TEXTURE_TILE_MODE_OFFSET    0x30
+#define GX2_TEXTURE_SWIZZLE_OFFSET      0x34
+#define GX2_TEXTURE_ALIGNMENT_OFFSET    0x38
+
+// Values of WindowTextureFormat (window/window.h)
+#define TEXTURE_FORMAT_RGBA8    0
+#define TEXTURE_FORMAT_BC1      1
+#define TEXTURE_FORMAT_BC3      2
+#define TEXTURE_FORMAT_BC4      3
+#define TEXTURE_FORMAT_BC5      4
+
+// Exit codes
+#define EXIT_ERROR 1
+
+typedef struct Packer
+{
+    WindowPackWriter* writer;
+    WindowPackPlatform platform;
+    const char* manifest;
+    u32 line;
+    u32 num_assets;
+    char directory[512];    // Directory of the manifest, with a trailing slash (empty if none)
+} Packer;
+
+static u32 ReadBE32(const u8* p)
+{
+    return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3];
+}
+
+static void Error(const Packer* packer, const char* message, const char* detail)
+{
+    fprintf(stderr, "%s:%u: %s%s%s\n", packer->manifest, packer->line, message, detail ? ": " : "", detail ? detail : "");
+}
+
+static bool OutOfMemory(const Packer* packer)
+{
+    Error(packer, "out of memory", NULL);
+    return false;
+}
+
+static u8* ReadFile(const Packer* packer, const char* name, u32* pSize)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : packer->directory, name);
+
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        Error(packer, "can't open", path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // One more byte, so that text files can be terminated
+    u8* data = size >= 0 ? (u8*)malloc(size + 1) : NULL;
+    if (data && fread(data, 1, size, file) != (size_t)size)
+    {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    if (!data)
+    {
+        Error(packer, "can't read", path);
+        return NULL;
+    }
+
+    data[size] = 0;
+    *pSize = (u32)size;
+    return data;
+}
+
+// Find the first block of a type in a GFD file
+// Returns the block data, or NULL if there is none
+static const u8* FindGfdBlock(const u8* data, u32 size, u32 type, u32* pSize)
+{
+    if (size < 0x20 || ReadBE32(data) != GFD_FILE_MAGIC)
+        return NULL;
+
+    u32 offset = ReadBE32(data + 4);
+    while (offset + 0x20 <= size)
+    {
+        const u8* block = data + offset;
+        u32 header_size = ReadBE32(block + 4);
+        u32 block_type = ReadBE32(block + 16);
+        u32 data_size = ReadBE32(block + 20);
+
+        if (ReadBE32(block) != GFD_BLOCK_MAGIC || header_size < 0x20 || header_size > size - offset || data_size > size - offset - header_size ||
+            block_type == GFD_BLOCK_END_OF_FILE)
+            return NULL;
+
+        if (block_type == type)
+        {
+            *pSize = data_size;
+            return block + header_size;
+        }
+
+        offset += header_size + data_size;
+    }
+
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+// Assets
+//------------------------------------------------------------------------------
+
+static bool AddEntry(Packer* packer, const char* name, WindowPackAssetType type, u32 offset, u32 size, u32 info)
+{
+    if (offset == 0)
+        return OutOfMemory(packer);
+
+    if (!WindowPackWriterAddEntry(packer->writer, name, type, offset, size, info))
+    {
+        Error(packer, "asset name used twice", name);
+        return false;
+    }
+
+    packer->num_assets++;
+    return true;
+}
+
+static bool AddBlob(Packer* packer, const char* name, const char* file, const char* argument)
+{
+    u32 alignment = argument ? (u32)strtoul(argument, NULL, 0) : WINDOW_PACK_ALIGN_DEFAULT;
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        Error(packer, "alignment is not a power of two", argument);
+        return false;
+    }
+
+    u32 size;
+    u8* data = ReadFile(packer, file, &size);
+    if (!data)
+        return false;
+
+    u32 offset = WindowPackWriterAppend(packer->writer, data, size, alignment);
+    free(data);
+    return AddEntry(packer, name, WINDOW_PACK_ASSET_BLOB, offset, size, 0);
+}
+
+static bool AddBuffer(Packer* packer, const char* name, const char* file, const char* argument, bool index)
+{
+    u32 element_size = index ? 4 : argument ? (u32)strtoul(argument, NULL, 0) : 4;
+    if (element_size != 1 && element_size != 2 && element_size != 4)
+    {
+        Error(packer, "element size must be 1, 2 or 4", argument);
+        return false;
+    }
+
+    u32 size;
+    u8* data = ReadFile(packer, file, &size);
+    if (!data)
+        return false;
+
+    if (size % element_size != 0)
+    {
+        Error(packer, "size is not a multiple of the element size", file);
+        free(data);
+        return false;
+    }
+
+    // GX2 reads big-endian vertex data and indices (GX2_ENDIAN_SWAP_DEFAULT, GX2_INDEX_TYPE_U32)
+    if (packer->platform == WINDOW_PACK_PLATFORM_WIIU)
+    {
+        for (u32 i = 0; i < size; i += element_size)
+        {
+            for (u32 j = 0; j < element_size / 2; j++)
+            {
+                u8 byte = data[i + j];
+                data[i + j] = data[i + element_size - 1 - j];
+                data[i + element_size - 1 - j] = byte;
+            }
+        }
+    }
+
+    u32 alignment = index ? WINDOW_PACK_ALIGN_INDEX : WINDOW_PACK_ALIGN_VERTEX;
+    u32 offset = WindowPackWriterAppend(packer->writer, data, size, alignment);
+    free(data);
+    return AddEntry(packer, name, index ? WINDOW_PACK_ASSET_INDEX_BUFFER : WINDOW_PACK_ASSET_VERTEX_BUFFER, offset, size, 0);
+}
+
+// Store the shader structure of a .gsh file, its variables and its program, with their pointers
+// relocated to offsets in the pack
+static bool AddGx2Shader(Packer* packer, const char* name, const char* file, const u8* data, u32 size, bool vertex)
+{
+    u32 header_size, program_size;
+    const u8* header = FindGfdBlock(data, size, vertex ? GFD_BLOCK_VERTEX_SHADER_HEADER : GFD_BLOCK_PIXEL_SHADER_HEADER, &header_size);
+    const u8* program = FindGfdBlock(data, size, vertex ? GFD_BLOCK_VERTEX_SHADER_PROGRAM : GFD_BLOCK_PIXEL_SHADER_PROGRAM, &program_size);
+    u32 program_field = vertex ? GX2_VERTEX_SHADER_PROGRAM_OFFSET : GX2_PIXEL_SHADER_PROGRAM_OFFSET;
+
+    if (!header || !program || header_size < program_field + 4 + GFD_RELOCATION_SIZE)
+    {
+        Error(packer, vertex ? "no vertex shader in" : "no pixel shader in", file);
+        return false;
+    }
+
+    const u8* relocation = header + header_size - GFD_RELOCATION_SIZE;
+    u32 patch_count = ReadBE32(relocation + 32);
+    u32 patch_offset = ReadBE32(relocation + 36) & ~GFD_PATCH_MASK;
+    if (ReadBE32(relocation) != GFD_RELOCATION_MAGIC || patch_offset > header_size || patch_count > (header_size - patch_offset) / 4)
+    {
+        Error(packer, "bad relocation header in", file);
+        return false;
+    }
+
+    WindowPackWriter* writer = packer->writer;
+    u32 object = WindowPackWriterAppend(writer, header, header_size, WINDOW_PACK_ALIGN_DEFAULT);
+    u32 program_offset = object ? WindowPackWriterAppend(writer, program, program_size, WINDOW_PACK_ALIGN_PROGRAM) : 0;
+    if (program_offset == 0)
+        return OutOfMemory(packer);
+
+    for (u32 i = 0; i < patch_count; i++)
+    {
+        u32 patch = ReadBE32(header + patch_offset + i * 4);
+        if (patch == 0)
+            continue;
+
+        u32 field = patch & ~GFD_PATCH_MASK;
+        if (field > header_size - 4)
+        {
+            Error(packer, "bad relocation in", file);
+            return false;
+        }
+
+        u32 value = ReadBE32(header + field);
+        if (value == 0)
+            continue;
+
+        u32 tag = value & GFD_PATCH_MASK;
+        u32 target = value & ~GFD_PATCH_MASK;
+        if ((tag != GFD_PATCH_DATA && tag != GFD_PATCH_TEXT) || target >= header_size)
+        {
+            Error(packer, "bad relocation in", file);
+            return false;
+        }
+
+        if (!WindowPackWriterSetPointer(writer, object + field, object + target))
+            return OutOfMemory(packer);
+    }
+
+    // The program is not part of the header block: the GFD loader sets it
+    if (!WindowPackWriterSetPointer(writer, object + program_field, program_offset))
+        return OutOfMemory(packer);
+
+    WindowPackWriterSet32(writer, object + program_field - 4, program_size);
+
+    return AddEntry(packer, name, vertex ? WINDOW_PACK_ASSET_VERTEX_SHADER : WINDOW_PACK_ASSET_PIXEL_SHADER,
+                    object, program_offset + program_size - object, 0);
+}
+
+static bool AddShader(Packer* packer, const char* name, const char* file, bool vertex)
+{
+    u32 size;
+    u8* data = ReadFile(packer, file, &size);
+    if (!data)
+        return false;
+
+    bool success;
+    if (packer->platform == WINDOW_PACK_PLATFORM_WIIU)
+    {
+        success = AddGx2Shader(packer, name, file, data, size, vertex);
+    }
+    else
+    {
+        // GLSL source, with its terminating NUL
+        u32 offset = WindowPackWriterAppend(packer->writer, data, size + 1, WINDOW_PACK_ALIGN_DEFAULT);
+        success = AddEntry(packer, name, vertex ? WINDOW_PACK_ASSET_VERTEX_SHADER : WINDOW_PACK_ASSET_PIXEL_SHADER, offset, size + 1, 0);
+    }
+
+    free(data);
+    return success;
+}
+
+static bool AddFetchShader(Packer* packer, const char* name, char** attribs, u32 num_attribs)
+{
+    static const char* const format_names[WINDOW_PACK_ATTRIB_COUNT] = { "float1", "float2", "float3", "float4", "unorm8x4" };
+
+    if (num_attribs == 0)
+    {
+        Error(packer, "fetch shader without attributes", name);
+        return false;
+    }
+
+    WindowPackWriter* writer = packer->writer;
+    u32 object = WindowPackWriterAppend(writer, NULL, sizeof(WindowPackFetchShader) + num_attribs * sizeof(WindowPackAttrib), WINDOW_PACK_ALIGN_DEFAULT);
+    if (object == 0)
+        return OutOfMemory(packer);
+
+    for (u32 i = 0; i < num_attribs; i++)
+    {
+        char format[32];
+        u32 words[4];
+        if (sscanf(attribs[i], "%u:%u:%u:%31s", &words[0], &words[1], &words[2], format) != 4)
+        {
+            Error(packer, "attributes are location:buffer:offset:format", attribs[i]);
+            return false;
+        }
+
+        for (words[3] = 0; words[3] < WINDOW_PACK_ATTRIB_COUNT && strcmp(format, format_names[words[3]]) != 0; words[3]++)
+            ;
+        if (words[3] == WINDOW_PACK_ATTRIB_COUNT)
+        {
+            Error(packer, "unknown attribute format", format);
+            return false;
+        }
+
+        u32 attrib = object + sizeof(WindowPackFetchShader) + i * sizeof(WindowPackAttrib);
+        for (u32 j = 0; j < 4; j++)
+            WindowPackWriterSet32(writer, attrib + j * 4, words[j]);
+    }
+
+    WindowPackWriterSet32(writer, object + offsetof(WindowPackFetchShader, num_attribs), num_attribs);
+
+    // Space for the program the Wii U loader builds
+    u32 end = object + sizeof(WindowPackFetchShader) + num_attribs * sizeof(WindowPackAttrib);
+    if (packer->platform == WINDOW_PACK_PLATFORM_WIIU)
+    {
+        u32 program_size = WINDOW_PACK_FETCH_PROGRAM_SIZE(num_attribs);
+        u32 program = WindowPackWriterAppend(writer, NULL, program_size, WINDOW_PACK_ALIGN_PROGRAM);
+        if (program == 0 || !WindowPackWriterSetPointer(writer, object + offsetof(WindowPackFetchShader, program), program))
+            return OutOfMemory(packer);
+
+        WindowPackWriterSet32(writer, object + offsetof(WindowPackFetchShader, program_size), program_size);
+        end = program + program_size;
+    }
+
+    return AddEntry(packer, name, WINDOW_PACK_ASSET_FETCH_SHADER, object, end - object, num_attribs);
+}
+
+// Store a GX2Texture, with its image and mipmaps at the alignment of the surface
+static bool AddGx2Texture(Packer* packer, const char* name, const u8* header, const u8* image, const u8* mipmaps)
+{
+    WindowPackWriter* writer = packer->writer;
+    u32 image_size = ReadBE32(header + GX2_TEXTURE_IMAGE_SIZE_OFFSET);
+    u32 mipmap_size = mipmaps ? ReadBE32(header + GX2_TEXTURE_MIPMAP_SIZE_OFFSET) : 0;
+    u32 alignment = ReadBE32(header + GX2_TEXTURE_ALIGNMENT_OFFSET);
+
+    u32 object = WindowPackWriterAppend(writer, header, GX2_TEXTURE_SIZE, WINDOW_PACK_ALIGN_DEFAULT);
+    u32 image_offset = object ? WindowPackWriterAppend(writer, image, image_size, alignment) : 0;
+    if (image_offset == 0 || !WindowPackWriterSetPointer(writer, object + GX2_TEXTURE_IMAGE_OFFSET, image_offset))
+        return OutOfMemory(packer);
+
+    u32 end = image_offset + image_size;
+    if (mipmap_size > 0)
+    {
+        u32 mipmap_offset = WindowPackWriterAppend(writer, mipmaps, mipmap_size, alignment);
+        if (mipmap_offset == 0 || !WindowPackWriterSetPointer(writer, object + GX2_TEXTURE_MIPMAPS_OFFSET, mipmap_offset))
+            return OutOfMemory(packer);
+
+        end = mipmap_offset + mipmap_size;
+    }
+
+    return AddEntry(packer, name, WINDOW_PACK_ASSET_TEXTURE, object, end - object, 0);
+}
+
+// Store a WindowPackTexture, with its levels untiled
+static bool AddPcTexture(Packer* packer, const char* name, const char* file, const u8* header, const u8* image, const u8* mipmaps)
+{
+    u32 format = ReadBE32(header + GX2_TEXTURE_FORMAT_OFFSET);
+    u32 texture_format, element_bits, block_size = 4;
+    switch (format & 0x3F)
+    {
+    case 0x1A: texture_format = TEXTURE_FORMAT_RGBA8; element_bits = 32; block_size = 1; break;
+    case 0x31: texture_format = TEXTURE_FORMAT_BC1;   element_bits = 64;  break;
+    case 0x33: texture_format = TEXTURE_FORMAT_BC3;   element_bits = 128; break;
+    case 0x34: texture_format = TEXTURE_FORMAT_BC4;   element_bits = 64;  break;
+    case 0x35: texture_format = TEXTURE_FORMAT_BC5;   element_bits = 128; break;
+    default:
+        Error(packer, "texture format not supported on PC", file);
+        return false;
+    }
+
+    // The same layout as the one the texture was tiled with
+    SurfaceLayout layout;
+    if (!SurfaceComputeLayout(&layout, format, element_bits, block_size, ReadBE32(header + GX2_TEXTURE_WIDTH_OFFSET),
+                              ReadBE32(header + GX2_TEXTURE_HEIGHT_OFFSET), ReadBE32(header + GX2_TEXTURE_LEVELS_OFFSET),
+                              (SurfaceTileMode)ReadBE32(header + GX2_TEXTURE_TILE_MODE_OFFSET),
+                              (ReadBE32(header + GX2_TEXTURE_SWIZZLE_OFFSET) >> 8) & 7) ||
+        layout.image_size != ReadBE32(header + GX2_TEXTURE_IMAGE_SIZE_OFFSET) ||
+        (layout.mipmap_size > 0 && !mipmaps))
+    {
+        Error(packer, "unexpected texture layout", file);
+        return false;
+    }
+
+    WindowPackWriter* writer = packer->writer;
+    u32 object = WindowPackWriterAppend(writer, NULL, sizeof(WindowPackTexture), WINDOW_PACK_ALIGN_DEFAULT);
+    if (object == 0)
+        return OutOfMemory(packer);
+
+    WindowPackWriterSet32(writer, object + offsetof(WindowPackTexture, format), texture_format);
+    WindowPackWriterSet32(writer, object + offsetof(WindowPackTexture, width), layout.width);
+    WindowPackWriterSet32(writer, object + offsetof(WindowPackTexture, height), layout.height);
+    WindowPackWriterSet32(writer, object + offsetof(WindowPackTexture, levels), layout.mip_levels);
+
+    u32 end = object + sizeof(WindowPackTexture);
+    for (u32 level = 0; level < layout.mip_levels; level++)
+    {
+        const SurfaceLevel* info = &layout.levels[level];
+        u32 level_size = info->width * info->height * (element_bits / 8);
+
+        u32 offset = WindowPackWriterAppend(writer, NULL, level_size, 16);
+        if (offset == 0)
+            return OutOfMemory(packer);
+
+        SurfaceUntileLevel(&layout, level, level == 0 ? image : mipmaps + info->offset, WindowPackWriterGetData(writer, offset));
+
+        WindowPackWriterSet32(writer, object + offsetof(WindowPackTexture, level_offsets) + level * 4, offset - object);
+        WindowPackWriterSet32(writer, object + offsetof(WindowPackTexture, level_sizes) + level * 4, level_size);
+        end = offset + level_size;
+    }
+
+    return AddEntry(packer, name, WINDOW_PACK_ASSET_TEXTURE, object, end - object, 0);
+}
+
+static bool AddTexture(Packer* packer, const char* name, const char* file)
+{
+    u32 size;
+    u8* data = ReadFile(packer, file, &size);
+    if (!data)
+        return false;
+
+    u32 header_size, image_size, mipmap_size = 0;
+    const u8* header = FindGfdBlock(data, size, GFD_BLOCK_TEXTURE_HEADER, &header_size);
+    const u8* image = FindGfdBlock(data, size, GFD_BLOCK_TEXTURE_IMAGE, &image_size);
+    const u8* mipmaps = FindGfdBlock(data, size, GFD_BLOCK_TEXTURE_MIPMAP, &mipmap_size);
+
+    bool success = false;
+    if (!header || header_size < GX2_TEXTURE_SIZE || !image || image_size < ReadBE32(header + GX2_TEXTURE_IMAGE_SIZE_OFFSET) ||
+        (mipmaps && mipmap_size < ReadBE32(header + GX2_TEXTURE_MIPMAP_SIZE_OFFSET)))
+        Error(packer, "not a GX2 texture file", file);
+    else if (packer->platform == WINDOW_PACK_PLATFORM_WIIU)
+        success = AddGx2Texture(packer, name, header, image, mipmaps);
+    else
+        success = AddPcTexture(packer, name, file, header, image, mipmaps);
+
+    free(data);
+    return success;
+}
+
+//------------------------------------------------------------------------------
+// Manifest
+//------------------------------------------------------------------------------
+
+#define MAX_TOKENS 40
+
+static bool AddAsset(Packer* packer, char** tokens, u32 num_tokens)
+{
+    const char* type = tokens[0];
+    if (num_tokens < 3)
+    {
+        Error(packer, "expected <type> <name> <file>", NULL);
+        return false;
+    }
+
+    const char* name = tokens[1];
+    const char* argument = num_tokens > 3 ? tokens[3] : NULL;
+
+    if (strcmp(type, "blob") == 0)
+        return AddBlob(packer, name, tokens[2], argument);
+    if (strcmp(type, "vertex") == 0)
+        return AddBuffer(packer, name, tokens[2], argument, false);
+    if (strcmp(type, "index") == 0)
+        return AddBuffer(packer, name, tokens[2], NULL, true);
+    if (strcmp(type, "vertex_shader") == 0)
+        return AddShader(packer, name, tokens[2], true);
+    if (strcmp(type, "pixel_shader") == 0)
+        return AddShader(packer, name, tokens[2], false);
+    if (strcmp(type, "fetch_shader") == 0)
+        return AddFetchShader(packer, name, tokens + 2, num_tokens - 2);
+    if (strcmp(type, "texture") == 0)
+        return AddTexture(packer, name, tokens[2]);
+
+    Error(packer, "unknown asset type", type);
+    return false;
+}
+
+static bool ReadManifest(Packer* packer)
+{
+    FILE* file = fopen(packer->manifest, "r");
+    if (!file)
+    {
+        fprintf(stderr, "%s: can't open the manifest\n", packer->manifest);
+        return false;
+    }
+
+    const char* platform_prefix = packer->platform == WINDOW_PACK_PLATFORM_WIIU ? "wiiu:" : "pc:";
+    const char* other_prefix = packer->platform == WINDOW_PACK_PLATFORM_WIIU ? "pc:" : "wiiu:";
+
+    bool success = true;
+    char line[4096];
+    while (success && fgets(line, sizeof(line), file))
+    {
+        packer->line++;
+
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+
+        char* tokens[MAX_TOKENS];
+        u32 num_tokens = 0;
+        for (char* token = strtok(line, " \t\r\n"); token && num_tokens < MAX_TOKENS; token = strtok(NULL, " \t\r\n"))
+            tokens[num_tokens++] = token;
+
+        if (num_tokens == 0)
+            continue;
+
+        // Platform-specific lines
+        char** asset = tokens;
+        if (strcmp(tokens[0], other_prefix) == 0)
+            continue;
+        if (strcmp(tokens[0], platform_prefix) == 0)
+        {
+            asset++;
+            num_tokens--;
+            if (num_tokens == 0)
+                continue;
+        }
+
+        success = AddAsset(packer, asset, num_tokens);
+    }
+
+    fclose(file);
+    return success;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "Usage: asset_packer [options] <manifest> <output>\n"
+        "Builds an asset pack from the assets listed in a manifest (see the top of main.c for its syntax)\n"
+        "Options:\n"
+        "  -p wiiu|pc  Platform to build the pack for (default wiiu)\n"
+        "Exit code: 0 on success, 1 on errors\n"
+    );
+}
+
+int main(int argc, char** argv)
+{
+    Packer packer;
+    memset(&packer, 0, sizeof(packer));
+    packer.platform = WINDOW_PACK_PLATFORM_WIIU;
+
+    const char* output = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-p") == 0 && i + 1 < argc)
+        {
+            const char* platform = argv[++i];
+            if (strcmp(platform, "wiiu") == 0)
+                packer.platform = WINDOW_PACK_PLATFORM_WIIU;
+            else if (strcmp(platform, "pc") == 0)
+                packer.platform = WINDOW_PACK_PLATFORM_PC;
+            else
+            {
+                PrintUsage();
+                return EXIT_ERROR;
+            }
+        }
+        else if (arg[0] == '-' || (packer.manifest && output))
+        {
+            PrintUsage();
+            return EXIT_ERROR;
+        }
+        else if (!packer.manifest)
+            packer.manifest = arg;
+        else
+            output = arg;
+    }
+
+    if (!packer.manifest || !output)
+    {
+        PrintUsage();
+        return EXIT_ERROR;
+    }
+
+    // Paths in the manifest are relative to it
+    const char* slash = strrchr(packer.manifest, '/');
+    if (slash && (size_t)(slash - packer.manifest + 1) < sizeof(packer.directory))
+        memcpy(packer.directory, packer.manifest, slash - packer.manifest + 1);
+
+    packer.writer = WindowPackWriterCreate(packer.platform);
+    if (!packer.writer)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_ERROR;
+    }
+
+    bool success = ReadManifest(&packer);
+    if (success && !WindowPackWriterSave(packer.writer, output))
+    {
+        fprintf(stderr, "%s: could not write the pack\n", output);
+        success = false;
+    }
+
+    if (success)
+    {
+        FILE* file = fopen(output, "rb");
+        long size = 0;
+        if (file)
+        {
+            fseek(file, 0, SEEK_END);
+            size = ftell(file);
+            fclose(file);
+        }
+        printf("Wrote %s: %s pack, %u assets, %ld bytes\n", output, packer.platform == WINDOW_PACK_PLATFORM_WIIU ? "Wii U" : "PC",
+               packer.num_assets, size);
+    }
+
+    WindowPackWriterDestroy(packer.writer);
+    return success ? 0 : EXIT_ERROR;
+}
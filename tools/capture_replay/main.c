@@ -0,0 +1,1129 @@
+// Capture replayer
+// Replays a capture file (window/capture_format.h, written by window/capture.h) headless, with the
+// window library built for PC, as fast as possible (swap intervals are ignored), and reports the CPU
+// cost of each kind of call and of each frame, so that the same workload can be timed on every
+// revision of the library
+// - PC captures: the OpenGL calls are made again, with the object names of the capture mapped to the
+//   names of the replay
+// - Wii U captures: GX2 shaders can't run on PC, so every draw uses a fallback program (attribute 0 as
+//   the position, constant color); the fetch shaders' attribute streams become vertex attribute
+//   pointers, and the contents are swapped to little-endian (attribute data by the element size of
+//   their format, Window* buffers by 32-bit words, indices by the index size). GX2 calls with no
+//   OpenGL equivalent (invalidations, shader mode, uniform registers, clears of targets other than the
+//   window buffers) are counted but do nothing
+// The costs are those of the PC driver: a Wii U capture tells how the workload scales (calls, draws,
+// bytes), not how long the console takes
+
+#include <window/buffer.h>
+#include <window/capture_format.h>
+#include <window/window.h>
+
+#include <GL/glew.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXIT_ERROR 1
+
+// Most OpenGL object names of a PC capture that can be mapped
+#define REPLAY_MAX_NAMES 65536
+
+// GX2 attribute buffer slots
+#define REPLAY_MAX_SLOTS 16
+
+// Vertex attribute locations the fallback program's vertex array can enable
+#define REPLAY_MAX_LOCATIONS 16
+
+// Contents of a data record (in the capture's byte order)
+typedef struct ReplayData
+{
+    const u8* bytes;
+    u32 size;
+} ReplayData;
+
+// GX2 attribute buffer slot: attribute data or a Window* buffer
+typedef struct ReplaySlot
+{
+    u32 data;
+    WindowBuffer* buffer;
+    u32 stride;
+} ReplaySlot;
+
+// GX2 fetch shader
+typedef struct ReplayFetchShader
+{
+    u32 num_attribs;
+    const CaptureAttrib* attribs;   // In the (swapped) records of the capture
+} ReplayFetchShader;
+
+typedef struct ReplayOpStats
+{
+    u64 calls;
+    f64 time;                       // Seconds
+} ReplayOpStats;
+
+typedef struct ReplayFrame
+{
+    f64 ms;                         // Replay time of the frame, swap included
+    u32 captured_us;                // CPU time of the frame when it was captured
+    u32 calls;
+} ReplayFrame;
+
+static const char* const sOpNames[CAPTURE_OP_COUNT] = {
+    [CAPTURE_OP_DATA]                       = "data",
+    [CAPTURE_OP_WINDOW_INIT]                = "WindowInit",
+    [CAPTURE_OP_WINDOW_EXIT]                = "WindowExit",
+    [CAPTURE_OP_FRAME]                      = "WindowSwapBuffers",
+    [CAPTURE_OP_MAKE_CONTEXT_CURRENT]       = "WindowMakeContextCurrent",
+    [CAPTURE_OP_SET_SWAP_INTERVAL]          = "WindowSetSwapInterval",
+    [CAPTURE_OP_SET_BUFFER_MODE]            = "WindowSetBufferMode",
+    [CAPTURE_OP_BUFFER_CREATE]              = "WindowBufferCreate",
+    [CAPTURE_OP_BUFFER_FLUSH]               = "WindowBufferFlush",
+    [CAPTURE_OP_BUFFER_DESTROY]             = "WindowBufferDestroy",
+    [CAPTURE_OP_SET_VERTEX_BUFFER]          = "WindowSetVertexBuffer",
+    [CAPTURE_OP_SET_INDEX_BUFFER]           = "WindowSetIndexBuffer",
+    [CAPTURE_OP_DRAW_INDEXED]               = "WindowDrawIndexed",
+    [CAPTURE_OP_GX2_CLEAR_COLOR]            = "GX2ClearColor",
+    [CAPTURE_OP_GX2_CLEAR_DEPTH_STENCIL]    = "GX2ClearDepthStencilEx",
+    [CAPTURE_OP_GX2_SET_SHADER_MODE]        = "GX2SetShaderModeEx",
+    [CAPTURE_OP_GX2_SHADER]                 = "(GX2 shader program)",
+    [CAPTURE_OP_GX2_FETCH_SHADER]           = "GX2InitFetchShaderEx",
+    [CAPTURE_OP_GX2_SET_SHADER]             = "GX2Set*Shader",
+    [CAPTURE_OP_GX2_SET_ATTRIB_BUFFER]      = "GX2SetAttribBuffer",
+    [CAPTURE_OP_GX2_DRAW]                   = "GX2DrawEx",
+    [CAPTURE_OP_GX2_DRAW_INDEXED]           = "GX2DrawIndexedEx",
+    [CAPTURE_OP_GX2_INVALIDATE]             = "GX2Invalidate",
+    [CAPTURE_OP_GX2_SET_POLYGON_CONTROL]    = "GX2SetPolygonControl",
+    [CAPTURE_OP_GX2_SET_UNIFORM_REG]        = "GX2Set*UniformReg",
+    [CAPTURE_OP_GL_CLEAR_COLOR]             = "glClearColor",
+    [CAPTURE_OP_GL_CLEAR]                   = "glClear",
+    [CAPTURE_OP_GL_VIEWPORT]                = "glViewport",
+    [CAPTURE_OP_GL_POLYGON_MODE]            = "glPolygonMode",
+    [CAPTURE_OP_GL_CREATE_SHADER]           = "glCreateShader",
+    [CAPTURE_OP_GL_SHADER_SOURCE]           = "glShaderSource",
+    [CAPTURE_OP_GL_COMPILE_SHADER]          = "glCompileShader",
+    [CAPTURE_OP_GL_DELETE_SHADER]           = "glDeleteShader",
+    [CAPTURE_OP_GL_CREATE_PROGRAM]          = "glCreateProgram",
+    [CAPTURE_OP_GL_ATTACH_SHADER]           = "glAttachShader",
+    [CAPTURE_OP_GL_LINK_PROGRAM]            = "glLinkProgram",
+    [CAPTURE_OP_GL_USE_PROGRAM]             = "glUseProgram",
+    [CAPTURE_OP_GL_DELETE_PROGRAM]          = "glDeleteProgram",
+    [CAPTURE_OP_GL_UNIFORM4FV]              = "glUniform4fv",
+    [CAPTURE_OP_GL_GEN_VERTEX_ARRAY]        = "glGenVertexArrays",
+    [CAPTURE_OP_GL_BIND_VERTEX_ARRAY]       = "glBindVertexArray",
+    [CAPTURE_OP_GL_DELETE_VERTEX_ARRAY]     = "glDeleteVertexArrays",
+    [CAPTURE_OP_GL_GEN_BUFFER]              = "glGenBuffers",
+    [CAPTURE_OP_GL_BIND_BUFFER]             = "glBindBuffer",
+    [CAPTURE_OP_GL_BUFFER_DATA]             = "glBufferData",
+    [CAPTURE_OP_GL_BUFFER_SUB_DATA]         = "glBufferSubData",
+    [CAPTURE_OP_GL_DELETE_BUFFER]           = "glDeleteBuffers",
+    [CAPTURE_OP_GL_ENABLE_ATTRIB_ARRAY]     = "glEnableVertexAttribArray",
+    [CAPTURE_OP_GL_ATTRIB_POINTER]          = "glVertexAttribPointer",
+    [CAPTURE_OP_GL_DRAW_ARRAYS]             = "glDrawArrays",
+    [CAPTURE_OP_GL_DRAW_ELEMENTS]           = "glDrawElements",
+};
+
+typedef struct Replay
+{
+    // Capture
+    u8* file;
+    u32 file_size;
+    bool swap;                      // The capture was written in the other byte order
+    CapturePlatform platform;
+    u32 num_frames;                 // Frames in the capture
+    bool has_init;                  // The capture has a WindowInit record
+
+    ReplayData* data;               // By id
+    u32 num_data;                   // Highest id + 1
+
+    // Objects, by their name or id in the capture
+    u32* names;                     // PC: shaders and programs (they share names)
+    u32* vertex_arrays;
+    u32* buffers;
+    WindowBuffer** window_buffers;
+    u32 num_window_buffers;
+    ReplayFetchShader* fetch_shaders;
+    u32 num_fetch_shaders;
+
+    // Wii U replay state
+    u32 program;                    // Fallback program
+    u32 vertex_array;
+    u32* data_buffers;              // Buffer objects made from data records, by id and swap size (1, 2, 4)
+    ReplaySlot slots[REPLAY_MAX_SLOTS];
+    const ReplayFetchShader* fetch_shader;
+    const WindowBuffer* index_buffer;
+    u32 enabled_locations;          // Mask of the enabled attribute locations
+
+    // Options
+    u32 warmup;
+    u32 max_frames;
+    bool verbose;
+
+    // Results
+    ReplayOpStats ops[CAPTURE_OP_COUNT];
+    ReplayFrame* frames;
+    u32 frame;                      // Frames replayed
+    u64 calls;
+    u64 skipped;                    // Calls using objects or features the replayer does not have
+    f64 frame_start;
+} Replay;
+
+static inline u32 Swap32(u32 value)
+{
+    return __builtin_bswap32(value);
+}
+
+static inline f32 FloatFromBits(u32 bits)
+{
+    f32 value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Copy contents of the capture, swapping elements of swap_size bytes if the byte order differs
+static void CopySwapped(const Replay* replay, u8* dst, const u8* src, u32 size, u32 swap_size)
+{
+    if (!replay->swap || swap_size <= 1)
+    {
+        memcpy(dst, src, size);
+        return;
+    }
+
+    u32 i = 0;
+    for (; i + swap_size <= size; i += swap_size)
+    {
+        for (u32 j = 0; j < swap_size; j++)
+            dst[i + j] = src[i + swap_size - 1 - j];
+    }
+
+    memcpy(dst + i, src + i, size - i);
+}
+
+static bool ReadFile(Replay* replay, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "%s: could not open the file\n", path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    replay->file = size > 0 ? (u8*)malloc((size_t)size) : NULL;
+    bool success = replay->file && fread(replay->file, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+
+    if (!success)
+    {
+        fprintf(stderr, "%s: could not read the file\n", path);
+        return false;
+    }
+
+    replay->file_size = (u32)size;
+    return true;
+}
+
+// Check the records, swap their words to the host byte order and index the data records
+static bool ParseCapture(Replay* replay, const char* path)
+{
+    if (replay->file_size < sizeof(CaptureHeader))
+    {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        return false;
+    }
+
+    u32* header = (u32*)replay->file;
+    if (header[0] == Swap32(CAPTURE_MAGIC))
+    {
+        replay->swap = true;
+        for (u32 i = 0; i < sizeof(CaptureHeader) / 4; i++)
+            header[i] = Swap32(header[i]);
+    }
+
+    const CaptureHeader* capture_header = (const CaptureHeader*)header;
+    if (capture_header->magic != CAPTURE_MAGIC || capture_header->version != CAPTURE_VERSION ||
+        capture_header->platform >= CAPTURE_PLATFORM_COUNT)
+    {
+        fprintf(stderr, "%s: not a capture file of version %u\n", path, CAPTURE_VERSION);
+        return false;
+    }
+
+    replay->platform = (CapturePlatform)capture_header->platform;
+
+    u32* words = (u32*)(replay->file + sizeof(CaptureHeader));
+    u32 num_words = (replay->file_size - sizeof(CaptureHeader)) / 4;
+    u32 capacity = 0;
+
+    // A capture that was not closed properly ends in the middle of a record: it is cut there
+    for (u32 i = 0; i < num_words;)
+    {
+        if (replay->swap)
+            words[i] = Swap32(words[i]);
+
+        u32 op = CAPTURE_RECORD_OP(words[i]);
+        u32 size = CAPTURE_RECORD_WORDS(words[i]);
+        if (op >= CAPTURE_OP_COUNT || size > num_words - i - 1)
+        {
+            fprintf(stderr, "%s: capture cut at word %u\n", path, i);
+            replay->file_size = sizeof(CaptureHeader) + i * 4;
+            break;
+        }
+
+        u32* args = &words[i + 1];
+        if (op == CAPTURE_OP_DATA)
+        {
+            // Only the id and size are swapped: the bytes are kept as the capture saw them
+            if (replay->swap && size >= 2)
+            {
+                args[0] = Swap32(args[0]);
+                args[1] = Swap32(args[1]);
+            }
+
+            u32 id = args[0];
+            if (size < 2 || CAPTURE_DATA_WORDS(args[1]) > size - 2)
+            {
+                fprintf(stderr, "%s: invalid data record at word %u\n", path, i);
+                return false;
+            }
+
+            if (id >= capacity)
+            {
+                u32 new_capacity = capacity ? capacity : 256;
+                while (new_capacity <= id)
+                    new_capacity *= 2;
+
+                ReplayData* data = (ReplayData*)realloc(replay->data, new_capacity * sizeof(ReplayData));
+                if (!data)
+                {
+                    fprintf(stderr, "Out of memory\n");
+                    return false;
+                }
+
+                memset(data + capacity, 0, (new_capacity - capacity) * sizeof(ReplayData));
+                replay->data = data;
+                capacity = new_capacity;
+            }
+
+            replay->data[id].bytes = (const u8*)&args[2];
+            replay->data[id].size = args[1];
+            if (id >= replay->num_data)
+                replay->num_data = id + 1;
+        }
+        else
+        {
+            if (replay->swap)
+            {
+                for (u32 j = 0; j < size; j++)
+                    args[j] = Swap32(args[j]);
+            }
+
+            if (op == CAPTURE_OP_FRAME)
+                replay->num_frames++;
+            else if (op == CAPTURE_OP_WINDOW_INIT)
+                replay->has_init = true;
+        }
+
+        i += 1 + size;
+    }
+
+    return true;
+}
+
+static const ReplayData* GetData(const Replay* replay, u32 id)
+{
+    if (id == 0 || id >= replay->num_data || !replay->data[id].bytes)
+        return NULL;
+
+    return &replay->data[id];
+}
+
+// Map an OpenGL name of the capture (0 for names that can't be mapped)
+static u32* GetName(u32* names, u32 name)
+{
+    static u32 sNone;
+    sNone = 0;
+    return name < REPLAY_MAX_NAMES ? &names[name] : &sNone;
+}
+
+// Grow a table indexed by id to hold an id
+static bool GrowTable(void** pTable, u32* pCount, u32 id, u32 element_size)
+{
+    if (id < *pCount)
+        return true;
+
+    u32 count = *pCount ? *pCount : 64;
+    while (count <= id)
+        count *= 2;
+
+    void* table = realloc(*pTable, (size_t)count * element_size);
+    if (!table)
+        return false;
+
+    memset((u8*)table + (size_t)*pCount * element_size, 0, (size_t)(count - *pCount) * element_size);
+    *pTable = table;
+    *pCount = count;
+    return true;
+}
+
+static WindowBuffer* GetWindowBuffer(const Replay* replay, u32 id)
+{
+    return id < replay->num_window_buffers ? replay->window_buffers[id] : NULL;
+}
+
+/*        Wii U captures        */
+
+static u32 CompileShader(GLenum type, const char* source)
+{
+    u32 shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+// Program drawing every Wii U draw: attribute 0 as the position, in a constant color
+static void CreateFallbackProgram(Replay* replay)
+{
+    u32 vertex_shader = CompileShader(GL_VERTEX_SHADER,
+        "#version 330 core\n"
+        "layout(location = 0) in vec4 v_inPos;\n"
+        "void main() { gl_Position = v_inPos; }\n");
+    u32 pixel_shader = CompileShader(GL_FRAGMENT_SHADER,
+        "#version 330 core\n"
+        "out vec4 o_FragColor;\n"
+        "void main() { o_FragColor = vec4(1.0, 0.5, 0.2, 1.0); }\n");
+
+    replay->program = glCreateProgram();
+    glAttachShader(replay->program, vertex_shader);
+    glAttachShader(replay->program, pixel_shader);
+    glLinkProgram(replay->program);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(pixel_shader);
+
+    glGenVertexArrays(1, &replay->vertex_array);
+    glBindVertexArray(replay->vertex_array);
+}
+
+// Get the buffer object holding the contents of a data record, swapped by elements of swap_size bytes
+static u32 GetDataBuffer(Replay* replay, u32 id, u32 swap_size)
+{
+    const ReplayData* data = GetData(replay, id);
+    if (!data)
+        return 0;
+
+    u32 index = id * 3 + (swap_size == 4 ? 2 : swap_size == 2 ? 1 : 0);
+    if (replay->data_buffers[index] != 0)
+        return replay->data_buffers[index];
+
+    u8* bytes = (u8*)malloc(data->size);
+    if (!bytes)
+        return 0;
+
+    CopySwapped(replay, bytes, data->bytes, data->size, swap_size);
+
+    u32 buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, data->size, bytes, GL_STATIC_DRAW);
+    free(bytes);
+
+    replay->data_buffers[index] = buffer;
+    return buffer;
+}
+
+// Point the attributes of the current fetch shader to the attribute buffer slots
+static bool SetAttribs(Replay* replay)
+{
+    const ReplayFetchShader* fetch_shader = replay->fetch_shader;
+    if (!fetch_shader)
+        return false;
+
+    u32 enabled_locations = 0;
+    for (u32 i = 0; i < fetch_shader->num_attribs; i++)
+    {
+        const CaptureAttrib* attrib = &fetch_shader->attribs[i];
+        if (attrib->components == 0 || attrib->buffer >= REPLAY_MAX_SLOTS || attrib->location >= REPLAY_MAX_LOCATIONS)
+            continue;
+
+        const ReplaySlot* slot = &replay->slots[attrib->buffer];
+        u32 buffer = slot->buffer ? slot->buffer->buffer : GetDataBuffer(replay, slot->data, attrib->swap_size);
+        if (buffer == 0)
+            continue;
+
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glVertexAttribPointer(attrib->location, attrib->components, attrib->type, attrib->normalized ? GL_TRUE : GL_FALSE,
+                              slot->stride, (const void*)(uintptr_t)attrib->offset);
+        glVertexAttribDivisor(attrib->location, attrib->divisor);
+        glEnableVertexAttribArray(attrib->location);
+        enabled_locations |= 1u << attrib->location;
+    }
+
+    // Attributes of the previous fetch shader
+    for (u32 location = 0; location < REPLAY_MAX_LOCATIONS; location++)
+    {
+        if ((replay->enabled_locations & ~enabled_locations) & (1u << location))
+            glDisableVertexAttribArray(location);
+    }
+
+    replay->enabled_locations = enabled_locations;
+    return true;
+}
+
+static void ReplayPolygonControl(const u32* args)
+{
+    glFrontFace(args[0] ? GL_CW : GL_CCW);
+
+    if (args[1] || args[2])
+    {
+        glEnable(GL_CULL_FACE);
+        glCullFace(args[1] && args[2] ? GL_FRONT_AND_BACK : (args[1] ? GL_FRONT : GL_BACK));
+    }
+    else
+        glDisable(GL_CULL_FACE);
+
+    // The core profile only has one mode for both faces
+    glPolygonMode(GL_FRONT_AND_BACK, args[3] ? args[4] : GL_FILL);
+}
+
+/*        Replay        */
+
+// Replay a record
+// Returns false if it was skipped
+static bool ReplayOp(Replay* replay, u32 op, const u32* args, u32 num_args)
+{
+    bool wiiu = replay->platform == CAPTURE_PLATFORM_WIIU;
+
+    switch (op)
+    {
+    // Window* API
+    case CAPTURE_OP_WINDOW_INIT:
+    {
+        u32 width, height;
+        if (num_args < 2 || !WindowInit(args[0], args[1], &width, &height))
+        {
+            fprintf(stderr, "WindowInit failed\n");
+            exit(EXIT_ERROR);
+        }
+
+        if (wiiu)
+            CreateFallbackProgram(replay);
+        return true;
+    }
+    case CAPTURE_OP_WINDOW_EXIT:
+        // Everything is released after the report
+        return true;
+    case CAPTURE_OP_FRAME:
+        WindowSwapBuffers();
+        return true;
+    case CAPTURE_OP_MAKE_CONTEXT_CURRENT:
+        WindowMakeContextCurrent();
+        return true;
+    case CAPTURE_OP_SET_SWAP_INTERVAL:
+        // As fast as possible
+        return true;
+    case CAPTURE_OP_SET_BUFFER_MODE:
+        WindowSetBufferMode((WindowBufferMode)args[0]);
+        return true;
+    case CAPTURE_OP_BUFFER_CREATE:
+    {
+        const ReplayData* data = GetData(replay, args[3]);
+        u8* bytes = data ? (u8*)malloc(args[2]) : NULL;
+        if (bytes)
+            CopySwapped(replay, bytes, data->bytes, data->size < args[2] ? data->size : args[2], 4);
+
+        WindowBuffer* buffer = WindowBufferCreate((WindowBufferType)args[1], args[2], bytes);
+        free(bytes);
+
+        if (args[0] == 0 || !buffer ||
+            !GrowTable((void**)&replay->window_buffers, &replay->num_window_buffers, args[0], sizeof(WindowBuffer*)))
+        {
+            WindowBufferDestroy(buffer);
+            return false;
+        }
+
+        replay->window_buffers[args[0]] = buffer;
+        return true;
+    }
+    case CAPTURE_OP_BUFFER_FLUSH:
+    {
+        WindowBuffer* buffer = GetWindowBuffer(replay, args[0]);
+        const ReplayData* data = GetData(replay, args[3]);
+        if (!buffer || args[1] + args[2] > buffer->size)
+            return false;
+
+        if (data)
+            CopySwapped(replay, (u8*)buffer->data + args[1], data->bytes, data->size < args[2] ? data->size : args[2], 4);
+
+        WindowBufferFlush(buffer, args[1], args[2]);
+        return true;
+    }
+    case CAPTURE_OP_BUFFER_DESTROY:
+    {
+        WindowBuffer* buffer = GetWindowBuffer(replay, args[0]);
+        if (!buffer)
+            return false;
+
+        if (replay->index_buffer == buffer)
+            replay->index_buffer = NULL;
+        for (u32 i = 0; i < REPLAY_MAX_SLOTS; i++)
+        {
+            if (replay->slots[i].buffer == buffer)
+                replay->slots[i].buffer = NULL;
+        }
+
+        WindowBufferDestroy(buffer);
+        replay->window_buffers[args[0]] = NULL;
+        return true;
+    }
+    case CAPTURE_OP_SET_VERTEX_BUFFER:
+    {
+        WindowBuffer* buffer = GetWindowBuffer(replay, args[1]);
+        if (!buffer)
+            return false;
+
+        if (wiiu)
+        {
+            // Pointed to by the fetch shader's attributes at the next draw
+            if (args[0] >= REPLAY_MAX_SLOTS)
+                return false;
+
+            replay->slots[args[0]].buffer = buffer;
+            replay->slots[args[0]].data = 0;
+            replay->slots[args[0]].stride = args[2];
+        }
+        else
+            WindowSetVertexBuffer(args[0], buffer, args[2]);
+        return true;
+    }
+    case CAPTURE_OP_SET_INDEX_BUFFER:
+    {
+        WindowBuffer* buffer = GetWindowBuffer(replay, args[0]);
+        if (!buffer)
+            return false;
+
+        WindowSetIndexBuffer(buffer);
+        replay->index_buffer = buffer;
+        return true;
+    }
+    case CAPTURE_OP_DRAW_INDEXED:
+        if (!replay->index_buffer)
+            return false;
+
+        if (wiiu)
+        {
+            if (!SetAttribs(replay))
+                return false;
+
+            // GX2 draws may have bound other indices to the vertex array
+            WindowSetIndexBuffer(replay->index_buffer);
+        }
+
+        WindowDrawIndexed(args[0], args[1]);
+        return true;
+
+    // GX2
+    case CAPTURE_OP_GX2_CLEAR_COLOR:
+        if (!args[0])
+            return false;
+
+        glClearColor(FloatFromBits(args[1]), FloatFromBits(args[2]), FloatFromBits(args[3]), FloatFromBits(args[4]));
+        glClear(GL_COLOR_BUFFER_BIT);
+        return true;
+    case CAPTURE_OP_GX2_CLEAR_DEPTH_STENCIL:
+        if (!args[0])
+            return false;
+
+        // GX2_CLEAR_FLAGS_DEPTH (1) and GX2_CLEAR_FLAGS_STENCIL (2)
+        glClearDepth(FloatFromBits(args[1]));
+        glClearStencil((GLint)args[2]);
+        glClear(((args[3] & 1) ? GL_DEPTH_BUFFER_BIT : 0) | ((args[3] & 2) ? GL_STENCIL_BUFFER_BIT : 0));
+        return true;
+    case CAPTURE_OP_GX2_SET_SHADER_MODE:
+    case CAPTURE_OP_GX2_SHADER:
+    case CAPTURE_OP_GX2_INVALIDATE:
+    case CAPTURE_OP_GX2_SET_UNIFORM_REG:
+        // Nothing to do on PC
+        return true;
+    case CAPTURE_OP_GX2_FETCH_SHADER:
+    {
+        u32 words = sizeof(CaptureAttrib) / sizeof(u32);
+        if (args[0] == 0 || num_args < 2 || args[1] > (num_args - 2) / words ||
+            !GrowTable((void**)&replay->fetch_shaders, &replay->num_fetch_shaders, args[0], sizeof(ReplayFetchShader)))
+            return false;
+
+        replay->fetch_shaders[args[0]].num_attribs = args[1];
+        replay->fetch_shaders[args[0]].attribs = (const CaptureAttrib*)&args[2];
+        return true;
+    }
+    case CAPTURE_OP_GX2_SET_SHADER:
+        if (args[0] == CAPTURE_SHADER_FETCH)
+        {
+            replay->fetch_shader = args[1] < replay->num_fetch_shaders && replay->fetch_shaders[args[1]].attribs
+                                 ? &replay->fetch_shaders[args[1]] : NULL;
+            return replay->fetch_shader != NULL;
+        }
+
+        glUseProgram(replay->program);
+        return true;
+    case CAPTURE_OP_GX2_SET_ATTRIB_BUFFER:
+        if (args[0] >= REPLAY_MAX_SLOTS)
+            return false;
+
+        replay->slots[args[0]].buffer = NULL;
+        replay->slots[args[0]].data = args[3];
+        replay->slots[args[0]].stride = args[2];
+        return true;
+    case CAPTURE_OP_GX2_DRAW:
+        if (args[0] == CAPTURE_PRIMITIVE_UNSUPPORTED || !SetAttribs(replay))
+            return false;
+
+        if (args[3] > 1)
+            glDrawArraysInstanced(args[0], args[2], args[1], args[3]);
+        else
+            glDrawArrays(args[0], args[2], args[1]);
+        return true;
+    case CAPTURE_OP_GX2_DRAW_INDEXED:
+    {
+        // Indices of the _LE index types are already little-endian
+        u32 index_size = args[2];
+        u32 indices = GetDataBuffer(replay, args[4], args[3] ? 1 : index_size);
+        if (args[0] == CAPTURE_PRIMITIVE_UNSUPPORTED || indices == 0 || !SetAttribs(replay))
+            return false;
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+
+        GLenum type = index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        if (args[6] > 1)
+            glDrawElementsInstancedBaseVertex(args[0], args[1], type, NULL, args[6], (GLint)args[5]);
+        else if (args[5] != 0)
+            glDrawElementsBaseVertex(args[0], args[1], type, NULL, (GLint)args[5]);
+        else
+            glDrawElements(args[0], args[1], type, NULL);
+        return true;
+    }
+    case CAPTURE_OP_GX2_SET_POLYGON_CONTROL:
+        ReplayPolygonControl(args);
+        return true;
+
+    // OpenGL
+    case CAPTURE_OP_GL_CLEAR_COLOR:
+        glClearColor(FloatFromBits(args[0]), FloatFromBits(args[1]), FloatFromBits(args[2]), FloatFromBits(args[3]));
+        return true;
+    case CAPTURE_OP_GL_CLEAR:
+        glClear(args[0]);
+        return true;
+    case CAPTURE_OP_GL_VIEWPORT:
+        glViewport((GLint)args[0], (GLint)args[1], (GLsizei)args[2], (GLsizei)args[3]);
+        return true;
+    case CAPTURE_OP_GL_POLYGON_MODE:
+        glPolygonMode(args[0], args[1]);
+        return true;
+    case CAPTURE_OP_GL_CREATE_SHADER:
+        *GetName(replay->names, args[0]) = glCreateShader(args[1]);
+        return true;
+    case CAPTURE_OP_GL_SHADER_SOURCE:
+    {
+        const ReplayData* data = GetData(replay, args[1]);
+        u32 shader = *GetName(replay->names, args[0]);
+        if (!data || shader == 0)
+            return false;
+
+        const char* source = (const char*)data->bytes;
+        GLint length = (GLint)data->size;
+        glShaderSource(shader, 1, &source, &length);
+        return true;
+    }
+    case CAPTURE_OP_GL_COMPILE_SHADER:
+        glCompileShader(*GetName(replay->names, args[0]));
+        return true;
+    case CAPTURE_OP_GL_DELETE_SHADER:
+        glDeleteShader(*GetName(replay->names, args[0]));
+        *GetName(replay->names, args[0]) = 0;
+        return true;
+    case CAPTURE_OP_GL_CREATE_PROGRAM:
+        *GetName(replay->names, args[0]) = glCreateProgram();
+        return true;
+    case CAPTURE_OP_GL_ATTACH_SHADER:
+        glAttachShader(*GetName(replay->names, args[0]), *GetName(replay->names, args[1]));
+        return true;
+    case CAPTURE_OP_GL_LINK_PROGRAM:
+        glLinkProgram(*GetName(replay->names, args[0]));
+        return true;
+    case CAPTURE_OP_GL_USE_PROGRAM:
+        glUseProgram(*GetName(replay->names, args[0]));
+        return true;
+    case CAPTURE_OP_GL_DELETE_PROGRAM:
+        glDeleteProgram(*GetName(replay->names, args[0]));
+        *GetName(replay->names, args[0]) = 0;
+        return true;
+    case CAPTURE_OP_GL_UNIFORM4FV:
+        if (num_args < 2 || args[1] > (num_args - 2) / 4)
+            return false;
+
+        glUniform4fv((GLint)args[0], (GLsizei)args[1], (const GLfloat*)&args[2]);
+        return true;
+    case CAPTURE_OP_GL_GEN_VERTEX_ARRAY:
+        glGenVertexArrays(1, GetName(replay->vertex_arrays, args[0]));
+        return true;
+    case CAPTURE_OP_GL_BIND_VERTEX_ARRAY:
+        glBindVertexArray(*GetName(replay->vertex_arrays, args[0]));
+        return true;
+    case CAPTURE_OP_GL_DELETE_VERTEX_ARRAY:
+        glDeleteVertexArrays(1, GetName(replay->vertex_arrays, args[0]));
+        *GetName(replay->vertex_arrays, args[0]) = 0;
+        return true;
+    case CAPTURE_OP_GL_GEN_BUFFER:
+        glGenBuffers(1, GetName(replay->buffers, args[0]));
+        return true;
+    case CAPTURE_OP_GL_BIND_BUFFER:
+        glBindBuffer(args[0], *GetName(replay->buffers, args[1]));
+        return true;
+    case CAPTURE_OP_GL_BUFFER_DATA:
+    {
+        const ReplayData* data = GetData(replay, args[2]);
+        if (data && data->size < args[1])
+            return false;
+
+        glBufferData(args[0], args[1], data ? data->bytes : NULL, args[3]);
+        return true;
+    }
+    case CAPTURE_OP_GL_BUFFER_SUB_DATA:
+    {
+        const ReplayData* data = GetData(replay, args[3]);
+        if (!data || data->size < args[2])
+            return false;
+
+        glBufferSubData(args[0], args[1], args[2], data->bytes);
+        return true;
+    }
+    case CAPTURE_OP_GL_DELETE_BUFFER:
+        glDeleteBuffers(1, GetName(replay->buffers, args[0]));
+        *GetName(replay->buffers, args[0]) = 0;
+        return true;
+    case CAPTURE_OP_GL_ENABLE_ATTRIB_ARRAY:
+        glEnableVertexAttribArray(args[0]);
+        return true;
+    case CAPTURE_OP_GL_ATTRIB_POINTER:
+        glVertexAttribPointer(args[0], (GLint)args[1], args[2], args[3] ? GL_TRUE : GL_FALSE, (GLsizei)args[4],
+                              (const void*)(uintptr_t)args[5]);
+        return true;
+    case CAPTURE_OP_GL_DRAW_ARRAYS:
+        glDrawArrays(args[0], (GLint)args[1], (GLsizei)args[2]);
+        return true;
+    case CAPTURE_OP_GL_DRAW_ELEMENTS:
+        if (args[3])
+        {
+            // Client indices
+            const ReplayData* data = GetData(replay, args[4]);
+            if (!data)
+                return false;
+
+            glDrawElements(args[0], (GLsizei)args[1], args[2], data->bytes);
+        }
+        else
+            glDrawElements(args[0], (GLsizei)args[1], args[2], (const void*)(uintptr_t)args[4]);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Number of argument words each record needs at least
+static u32 GetMinArgs(u32 op)
+{
+    switch (op)
+    {
+    case CAPTURE_OP_WINDOW_INIT:                return 5;
+    case CAPTURE_OP_FRAME:                      return 2;
+    case CAPTURE_OP_SET_SWAP_INTERVAL:          return 1;
+    case CAPTURE_OP_SET_BUFFER_MODE:            return 1;
+    case CAPTURE_OP_BUFFER_CREATE:              return 4;
+    case CAPTURE_OP_BUFFER_FLUSH:               return 4;
+    case CAPTURE_OP_BUFFER_DESTROY:             return 1;
+    case CAPTURE_OP_SET_VERTEX_BUFFER:          return 3;
+    case CAPTURE_OP_SET_INDEX_BUFFER:           return 1;
+    case CAPTURE_OP_DRAW_INDEXED:               return 2;
+    case CAPTURE_OP_GX2_CLEAR_COLOR:            return 5;
+    case CAPTURE_OP_GX2_CLEAR_DEPTH_STENCIL:    return 4;
+    case CAPTURE_OP_GX2_FETCH_SHADER:           return 2;
+    case CAPTURE_OP_GX2_SET_SHADER:             return 2;
+    case CAPTURE_OP_GX2_SET_ATTRIB_BUFFER:      return 4;
+    case CAPTURE_OP_GX2_DRAW:                   return 4;
+    case CAPTURE_OP_GX2_DRAW_INDEXED:           return 7;
+    case CAPTURE_OP_GX2_SET_POLYGON_CONTROL:    return 9;
+    case CAPTURE_OP_GL_CLEAR_COLOR:             return 4;
+    case CAPTURE_OP_GL_CLEAR:                   return 1;
+    case CAPTURE_OP_GL_VIEWPORT:                return 4;
+    case CAPTURE_OP_GL_POLYGON_MODE:            return 2;
+    case CAPTURE_OP_GL_CREATE_SHADER:           return 2;
+    case CAPTURE_OP_GL_SHADER_SOURCE:           return 2;
+    case CAPTURE_OP_GL_ATTACH_SHADER:           return 2;
+    case CAPTURE_OP_GL_UNIFORM4FV:              return 2;
+    case CAPTURE_OP_GL_BIND_BUFFER:             return 2;
+    case CAPTURE_OP_GL_BUFFER_DATA:             return 4;
+    case CAPTURE_OP_GL_BUFFER_SUB_DATA:         return 4;
+    case CAPTURE_OP_GL_ATTRIB_POINTER:          return 6;
+    case CAPTURE_OP_GL_DRAW_ARRAYS:             return 3;
+    case CAPTURE_OP_GL_DRAW_ELEMENTS:           return 5;
+    case CAPTURE_OP_WINDOW_EXIT:
+    case CAPTURE_OP_MAKE_CONTEXT_CURRENT:
+    case CAPTURE_OP_DATA:                       return 0;
+    default:                                    return 1;
+    }
+}
+
+static bool Run(Replay* replay)
+{
+    const u32* words = (const u32*)(replay->file + sizeof(CaptureHeader));
+    u32 num_words = (replay->file_size - sizeof(CaptureHeader)) / 4;
+    u32 frame_calls = 0;
+
+    replay->frame_start = WindowGetTime();
+
+    for (u32 i = 0; i < num_words && replay->frame < replay->max_frames; )
+    {
+        u32 op = CAPTURE_RECORD_OP(words[i]);
+        u32 num_args = CAPTURE_RECORD_WORDS(words[i]);
+        const u32* args = &words[i + 1];
+        i += 1 + num_args;
+
+        // Data records were indexed by ParseCapture
+        if (op == CAPTURE_OP_DATA)
+            continue;
+
+        if (num_args < GetMinArgs(op))
+        {
+            replay->skipped++;
+            continue;
+        }
+
+        bool measured = replay->frame >= replay->warmup;
+
+        f64 start = WindowGetTime();
+        bool replayed = ReplayOp(replay, op, args, num_args);
+        f64 end = WindowGetTime();
+
+        if (!replayed)
+            replay->skipped++;
+
+        if (measured)
+        {
+            replay->ops[op].calls++;
+            replay->ops[op].time += end - start;
+            replay->calls++;
+        }
+        frame_calls++;
+
+        if (op == CAPTURE_OP_FRAME)
+        {
+            ReplayFrame* frame = &replay->frames[replay->frame];
+            frame->ms = (end - replay->frame_start) * 1000.0;
+            frame->captured_us = args[1];
+            frame->calls = frame_calls;
+
+            if (replay->verbose)
+                printf("frame %u: %.3f ms (captured: %.3f ms of CPU time), %u calls%s\n", replay->frame, frame->ms,
+                       frame->captured_us / 1000.0, frame->calls, measured ? "" : " (warm-up)");
+
+            replay->frame++;
+            replay->frame_start = end;
+            frame_calls = 0;
+        }
+    }
+
+    return true;
+}
+
+static int CompareFrames(const void* a, const void* b)
+{
+    f64 ms_a = *(const f64*)a;
+    f64 ms_b = *(const f64*)b;
+    return ms_a < ms_b ? -1 : (ms_a > ms_b ? 1 : 0);
+}
+
+static void PrintReport(const Replay* replay, const char* path)
+{
+    u32 first = replay->warmup < replay->frame ? replay->warmup : replay->frame;
+    u32 num_frames = replay->frame - first;
+
+    f64 total = 0.0;
+    for (u32 op = 0; op < CAPTURE_OP_COUNT; op++)
+        total += replay->ops[op].time;
+
+    printf("Replayed %s: %s capture, %u of %u frames (%u warm-up), %llu calls in %.2f ms, %llu skipped\n", path,
+           replay->platform == CAPTURE_PLATFORM_WIIU ? "Wii U" : "PC", replay->frame, replay->num_frames, first,
+           (unsigned long long)replay->calls, total * 1000.0, (unsigned long long)replay->skipped);
+
+    // Calls by total time (insertion sort: there are few opcodes)
+    u32 order[CAPTURE_OP_COUNT];
+    for (u32 op = 0; op < CAPTURE_OP_COUNT; op++)
+    {
+        u32 i = op;
+        for (; i > 0 && replay->ops[order[i - 1]].time < replay->ops[op].time; i--)
+            order[i] = order[i - 1];
+        order[i] = op;
+    }
+
+    printf("\n%-28s %10s %12s %10s %7s\n", "call", "calls", "total ms", "avg us", "%");
+    for (u32 i = 0; i < CAPTURE_OP_COUNT; i++)
+    {
+        const ReplayOpStats* stats = &replay->ops[order[i]];
+        if (stats->calls == 0)
+            continue;
+
+        printf("%-28s %10llu %12.3f %10.3f %6.1f%%\n", sOpNames[order[i]], (unsigned long long)stats->calls,
+               stats->time * 1000.0, stats->time * 1e6 / stats->calls, total > 0.0 ? 100.0 * stats->time / total : 0.0);
+    }
+
+    if (num_frames == 0)
+        return;
+
+    // Frame times, swap included
+    f64* ms = (f64*)malloc(num_frames * sizeof(f64));
+    if (!ms)
+        return;
+
+    f64 sum = 0.0, captured_sum = 0.0;
+    u32 captured_max = 0;
+    for (u32 i = 0; i < num_frames; i++)
+    {
+        const ReplayFrame* frame = &replay->frames[first + i];
+        ms[i] = frame->ms;
+        sum += frame->ms;
+        captured_sum += frame->captured_us / 1000.0;
+        if (frame->captured_us > captured_max)
+            captured_max = frame->captured_us;
+    }
+
+    qsort(ms, num_frames, sizeof(f64), CompareFrames);
+
+    printf("\nFrames: min %.3f ms, avg %.3f ms, median %.3f ms, max %.3f ms (%.1f frames per second)\n", ms[0],
+           sum / num_frames, ms[num_frames / 2], ms[num_frames - 1], sum > 0.0 ? num_frames * 1000.0 / sum : 0.0);
+    printf("Captured CPU time: avg %.3f ms, max %.3f ms\n", captured_sum / num_frames, captured_max / 1000.0);
+
+    free(ms);
+}
+
+static void Destroy(Replay* replay)
+{
+    if (replay->data_buffers)
+    {
+        for (u32 i = 0; i < replay->num_data * 3; i++)
+        {
+            if (replay->data_buffers[i] != 0)
+                glDeleteBuffers(1, &replay->data_buffers[i]);
+        }
+    }
+
+    for (u32 i = 0; i < replay->num_window_buffers; i++)
+        WindowBufferDestroy(replay->window_buffers[i]);
+
+    if (replay->program != 0)
+    {
+        glDeleteProgram(replay->program);
+        glDeleteVertexArrays(1, &replay->vertex_array);
+    }
+
+    free(replay->data_buffers);
+    free(replay->window_buffers);
+    free(replay->fetch_shaders);
+    free(replay->names);
+    free(replay->vertex_arrays);
+    free(replay->buffers);
+    free(replay->frames);
+    free(replay->data);
+    free(replay->file);
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "Usage: capture_replay [options] <capture>\n"
+        "Replays a capture (see window/capture.h) headless, as fast as possible, and reports the cost of each call and frame\n"
+        "Options:\n"
+        "  -w <frames>  Frames to replay before measuring (default 0)\n"
+        "  -n <frames>  Frames to replay at most (default: all)\n"
+        "  -v           Print the time of every frame\n"
+        "Exit code: 0 on success, 1 on errors\n"
+    );
+}
+
+int main(int argc, char** argv)
+{
+    Replay replay;
+    memset(&replay, 0, sizeof(replay));
+    replay.max_frames = 0xFFFFFFFF;
+
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-w") == 0 && i + 1 < argc)
+            replay.warmup = (u32)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(arg, "-n") == 0 && i + 1 < argc)
+            replay.max_frames = (u32)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(arg, "-v") == 0)
+            replay.verbose = true;
+        else if (arg[0] == '-' || path)
+        {
+            PrintUsage();
+            return EXIT_ERROR;
+        }
+        else
+            path = arg;
+    }
+
+    if (!path)
+    {
+        PrintUsage();
+        return EXIT_ERROR;
+    }
+
+    if (!ReadFile(&replay, path) || !ParseCapture(&replay, path))
+    {
+        Destroy(&replay);
+        return EXIT_ERROR;
+    }
+
+    replay.names = (u32*)calloc(REPLAY_MAX_NAMES, sizeof(u32));
+    replay.vertex_arrays = (u32*)calloc(REPLAY_MAX_NAMES, sizeof(u32));
+    replay.buffers = (u32*)calloc(REPLAY_MAX_NAMES, sizeof(u32));
+    replay.data_buffers = (u32*)calloc((size_t)replay.num_data * 3 + 1, sizeof(u32));
+    replay.frames = (ReplayFrame*)calloc((size_t)replay.num_frames + 1, sizeof(ReplayFrame));
+    if (!replay.names || !replay.vertex_arrays || !replay.buffers || !replay.data_buffers || !replay.frames)
+    {
+        fprintf(stderr, "Out of memory\n");
+        Destroy(&replay);
+        return EXIT_ERROR;
+    }
+
+    if (!replay.has_init)
+    {
+        // The capture started after WindowInit: open a window of the default size
+        u32 width, height;
+        if (!WindowInit(1280, 720, &width, &height))
+        {
+            fprintf(stderr, "WindowInit failed\n");
+            Destroy(&replay);
+            return EXIT_ERROR;
+        }
+
+        if (replay.platform == CAPTURE_PLATFORM_WIIU)
+            CreateFallbackProgram(&replay);
+    }
+
+    Run(&replay);
+
+    // Wait for the GPU, so that the driver's deferred work does not run during the report
+    glFinish();
+
+    PrintReport(&replay, path);
+
+    Destroy(&replay);
+    WindowExit();
+    return 0;
+}
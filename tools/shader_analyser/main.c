@@ -0,0 +1,279 @@
+// Command-line front end of the shader analyser
+// Analyses the shaders of GX2 shader files (.gsh) or raw program microcode, and optionally fails
+// when a shader goes over a budget, so that it can be used in a build pipeline to catch regressions
+
+#include "shader_analyser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// GFD (.gsh) file format: a file header followed by blocks; all fields are big-endian
+#define GFD_FILE_MAGIC  0x47667832  // "Gfx2"
+#define GFD_BLOCK_MAGIC 0x424C4B7B  // "BLK{"
+
+#define GFD_BLOCK_END_OF_FILE           1
+#define GFD_BLOCK_VERTEX_SHADER_HEADER  3
+#define GFD_BLOCK_VERTEX_SHADER_PROGRAM 5
+#define GFD_BLOCK_PIXEL_SHADER_HEADER   6
+#define GFD_BLOCK_PIXEL_SHADER_PROGRAM  7
+
+// Exit codes
+#define EXIT_OVER_BUDGET 1
+#define EXIT_ERROR       2
+
+typedef struct Budget
+{
+    f32 max_cycles;
+    u32 max_gprs;
+    u32 max_alu;
+    u32 max_fetches;
+} Budget;
+
+static u32 ReadBE32(const u8* p)
+{
+    return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3];
+}
+
+static u8* ReadFile(const char* path, u32* pSize)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8* data = size > 0 ? (u8*)malloc(size) : NULL;
+    if (data && fread(data, 1, size, file) != (size_t)size)
+    {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    *pSize = (u32)size;
+    return data;
+}
+
+// Analyse one shader and check it against the budget
+// Returns 0, EXIT_OVER_BUDGET or EXIT_ERROR
+static int AnalyseShader(const char* name, const u8* program, u32 size, ShaderStage stage, s64 sq_pgm_resources, bool disassemble, const Budget* budget)
+{
+    printf("%s (%s shader, %u bytes)\n", name, stage == SHADER_STAGE_VERTEX ? "vertex" : "pixel", size);
+
+    ShaderAnalysis analysis;
+    char error[128];
+    bool ok = ShaderAnalyse(program, size, stage, &analysis, disassemble ? stdout : NULL, error, sizeof(error));
+
+    if (!ok)
+    {
+        fprintf(stderr, "%s: %s\n", name, error);
+        return EXIT_ERROR;
+    }
+
+    ShaderPrintAnalysis(stdout, &analysis);
+
+    // The register header tells how many GPRs the compiler reserved (including clause temporaries)
+    u32 gprs = analysis.gprs;
+    if (sq_pgm_resources >= 0)
+    {
+        gprs = ShaderGetRegisterGprs((u32)sq_pgm_resources);
+        printf("  Register header:   %u GPRs, stack size %u\n", gprs, ShaderGetRegisterStack((u32)sq_pgm_resources));
+    }
+
+    int result = 0;
+    if (budget->max_cycles > 0.0f && analysis.est_cycles > budget->max_cycles)
+    {
+        printf("  OVER BUDGET: %.2f cycles > %.2f\n", analysis.est_cycles, budget->max_cycles);
+        result = EXIT_OVER_BUDGET;
+    }
+    if (budget->max_gprs > 0 && gprs > budget->max_gprs)
+    {
+        printf("  OVER BUDGET: %u GPRs > %u\n", gprs, budget->max_gprs);
+        result = EXIT_OVER_BUDGET;
+    }
+    if (budget->max_alu > 0 && analysis.alu_instructions > budget->max_alu)
+    {
+        printf("  OVER BUDGET: %u ALU instructions > %u\n", analysis.alu_instructions, budget->max_alu);
+        result = EXIT_OVER_BUDGET;
+    }
+    if (budget->max_fetches > 0 && analysis.tex_fetches + analysis.vtx_fetches > budget->max_fetches)
+    {
+        printf("  OVER BUDGET: %u fetches > %u\n", analysis.tex_fetches + analysis.vtx_fetches, budget->max_fetches);
+        result = EXIT_OVER_BUDGET;
+    }
+
+    return result;
+}
+
+// Analyse every shader of a GFD file
+static int AnalyseGfd(const char* path, const u8* data, u32 size, bool disassemble, const Budget* budget)
+{
+    if (size < 0x20 || ReadBE32(data) != GFD_FILE_MAGIC)
+    {
+        fprintf(stderr, "%s: not a GX2 shader file\n", path);
+        return EXIT_ERROR;
+    }
+
+    int result = 0;
+    u32 num_shaders = 0;
+
+    // Register values of the last shader header, per stage (-1 if none)
+    s64 vs_resources = -1, ps_resources = -1;
+
+    u32 offset = ReadBE32(data + 4);
+    while (offset + 0x20 <= size)
+    {
+        const u8* block = data + offset;
+        if (ReadBE32(block) != GFD_BLOCK_MAGIC)
+        {
+            fprintf(stderr, "%s: bad block at offset 0x%X\n", path, offset);
+            return EXIT_ERROR;
+        }
+
+        u32 header_size = ReadBE32(block + 4);
+        u32 type = ReadBE32(block + 16);
+        u32 data_size = ReadBE32(block + 20);
+        const u8* block_data = block + header_size;
+
+        if (offset + header_size + data_size > size)
+        {
+            fprintf(stderr, "%s: block at offset 0x%X overruns the file\n", path, offset);
+            return EXIT_ERROR;
+        }
+
+        if (type == GFD_BLOCK_END_OF_FILE)
+            break;
+
+        // The shader headers are serialized GX2VertexShader / GX2PixelShader structures,
+        // which start with the SQ_PGM_RESOURCES register
+        if (type == GFD_BLOCK_VERTEX_SHADER_HEADER && data_size >= 4)
+            vs_resources = ReadBE32(block_data);
+        else if (type == GFD_BLOCK_PIXEL_SHADER_HEADER && data_size >= 4)
+            ps_resources = ReadBE32(block_data);
+        else if (type == GFD_BLOCK_VERTEX_SHADER_PROGRAM || type == GFD_BLOCK_PIXEL_SHADER_PROGRAM)
+        {
+            bool vertex = type == GFD_BLOCK_VERTEX_SHADER_PROGRAM;
+
+            char name[512];
+            snprintf(name, sizeof(name), "%s [%u]", path, num_shaders++);
+
+            int shader_result = AnalyseShader(
+                name, block_data, data_size,
+                vertex ? SHADER_STAGE_VERTEX : SHADER_STAGE_PIXEL,
+                vertex ? vs_resources : ps_resources,
+                disassemble, budget
+            );
+
+            if (shader_result > result)
+                result = shader_result;
+        }
+
+        offset += header_size + data_size;
+    }
+
+    if (num_shaders == 0)
+    {
+        fprintf(stderr, "%s: no vertex or pixel shader found\n", path);
+        return EXIT_ERROR;
+    }
+
+    return result;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "Usage: shader_analyser [options] <file>...\n"
+        "Analyses the vertex and pixel shaders of GX2 shader files (.gsh), or raw program microcode\n"
+        "Options:\n"
+        "  -t vs|ps           Treat the files as raw programs of the given stage\n"
+        "  -r <value>         SQ_PGM_RESOURCES register value of raw programs (e.g. 0x102)\n"
+        "  -d                 Print the disassembly\n"
+        "  --max-cycles <n>   Fail if a shader's estimated cost is over n cycles\n"
+        "  --max-gprs <n>     Fail if a shader uses more than n GPRs\n"
+        "  --max-alu <n>      Fail if a shader has more than n ALU instructions\n"
+        "  --max-fetches <n>  Fail if a shader has more than n fetches\n"
+        "Exit code: 0 if all shaders are within budget, 1 if one is over budget, 2 on errors\n"
+    );
+}
+
+int main(int argc, char** argv)
+{
+    Budget budget = { 0.0f, 0, 0, 0 };
+    bool disassemble = false;
+    bool raw = false;
+    ShaderStage raw_stage = SHADER_STAGE_VERTEX;
+    s64 raw_resources = -1;
+    int num_files = 0;
+    int result = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(arg, "-d") == 0)
+            disassemble = true;
+        else if (strcmp(arg, "-t") == 0 && has_value)
+        {
+            raw = true;
+            const char* stage = argv[++i];
+            if (strcmp(stage, "vs") == 0)
+                raw_stage = SHADER_STAGE_VERTEX;
+            else if (strcmp(stage, "ps") == 0)
+                raw_stage = SHADER_STAGE_PIXEL;
+            else
+            {
+                PrintUsage();
+                return EXIT_ERROR;
+            }
+        }
+        else if (strcmp(arg, "-r") == 0 && has_value)
+            raw_resources = (s64)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(arg, "--max-cycles") == 0 && has_value)
+            budget.max_cycles = (f32)atof(argv[++i]);
+        else if (strcmp(arg, "--max-gprs") == 0 && has_value)
+            budget.max_gprs = (u32)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(arg, "--max-alu") == 0 && has_value)
+            budget.max_alu = (u32)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(arg, "--max-fetches") == 0 && has_value)
+            budget.max_fetches = (u32)strtoul(argv[++i], NULL, 0);
+        else if (arg[0] == '-')
+        {
+            PrintUsage();
+            return EXIT_ERROR;
+        }
+        else
+        {
+            num_files++;
+
+            u32 size;
+            u8* data = ReadFile(arg, &size);
+            if (!data)
+            {
+                fprintf(stderr, "%s: could not read the file\n", arg);
+                result = EXIT_ERROR;
+                continue;
+            }
+
+            int file_result = raw
+                ? AnalyseShader(arg, data, size, raw_stage, raw_resources, disassemble, &budget)
+                : AnalyseGfd(arg, data, size, disassemble, &budget);
+
+            if (file_result > result)
+                result = file_result;
+
+            free(data);
+        }
+    }
+
+    if (num_files == 0)
+    {
+        PrintUsage();
+        return EXIT_ERROR;
+    }
+
+    return result;
+}
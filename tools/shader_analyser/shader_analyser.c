@@ -0,0 +1,761 @@
+// Offline analyser for Wii U (R600 / R700 family) shader microcode
+// Encodings follow the R600 / R700 instruction set architecture documents
+// Every instruction word is stored in little-endian byte order in the program
+
+#include "shader_analyser.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+// Cost model (per vertex or pixel, in shader core cycles)
+#define SHADER_CYCLES_PER_ALU_GROUP    1.0f  // One VLIW group issues per cycle
+#define SHADER_CYCLES_PER_TEX_FETCH    1.0f  // Bilinear fetch from the texture cache
+#define SHADER_CYCLES_PER_VTX_FETCH    1.0f
+#define SHADER_CYCLES_PER_CLAUSE       0.5f  // Switching clauses costs a few cycles per wavefront
+#define SHADER_CYCLES_PER_EXPORT       0.25f
+
+// CF instructions (CF_WORD1::CF_INST, bits 23-29)
+#define CF_INST_NOP                 0
+#define CF_INST_TEX                 1
+#define CF_INST_VTX                 2
+#define CF_INST_VTX_TC              3
+#define CF_INST_LOOP_START          4
+#define CF_INST_LOOP_END            5
+#define CF_INST_LOOP_START_DX10     6
+#define CF_INST_LOOP_START_NO_AL    7
+#define CF_INST_LOOP_CONTINUE       8
+#define CF_INST_LOOP_BREAK          9
+#define CF_INST_JUMP                10
+#define CF_INST_PUSH                11
+#define CF_INST_PUSH_ELSE           12
+#define CF_INST_ELSE                13
+#define CF_INST_POP                 14
+#define CF_INST_POP_JUMP            15
+#define CF_INST_POP_PUSH            16
+#define CF_INST_POP_PUSH_ELSE       17
+#define CF_INST_CALL                18
+#define CF_INST_CALL_FS             19
+#define CF_INST_RETURN              20
+#define CF_INST_EMIT_VERTEX         21
+#define CF_INST_EMIT_CUT_VERTEX     22
+#define CF_INST_CUT_VERTEX          23
+#define CF_INST_KILL                24
+#define CF_INST_MEM_STREAM0         32
+#define CF_INST_MEM_STREAM1         33
+#define CF_INST_MEM_STREAM2         34
+#define CF_INST_MEM_STREAM3         35
+#define CF_INST_MEM_SCRATCH         36
+#define CF_INST_MEM_REDUCTION       37
+#define CF_INST_MEM_RING            38
+#define CF_INST_EXPORT              39
+#define CF_INST_EXPORT_DONE         40
+
+// ALU clause CF instructions (CF_ALU_WORD1::CF_INST, bits 26-29; bit 29 is always set)
+static const char* const sAluCfNames[8] = {
+    "ALU", "ALU_PUSH_BEFORE", "ALU_POP_AFTER", "ALU_POP2_AFTER",
+    "ALU_EXT", "ALU_CONTINUE", "ALU_BREAK", "ALU_ELSE_AFTER"
+};
+
+// ALU source selects
+#define ALU_SRC_GPR_MAX             127
+#define ALU_SRC_CLAUSE_TEMP_FIRST   124  // T0-T3 (R700: the last 4 GPRs are clause temporaries)
+#define ALU_SRC_KCACHE0_FIRST       128
+#define ALU_SRC_KCACHE1_FIRST       160
+#define ALU_SRC_0                   248
+#define ALU_SRC_1                   249
+#define ALU_SRC_1_INT               250
+#define ALU_SRC_M_1_INT             251
+#define ALU_SRC_0_5                 252
+#define ALU_SRC_LITERAL             253
+#define ALU_SRC_PV                  254
+#define ALU_SRC_PS                  255
+#define ALU_SRC_CFILE_FIRST         256
+
+typedef struct ShaderAluOp
+{
+    const char* name;
+    u8 num_srcs;
+    bool trans;                 // Only the transcendental unit can execute it
+} ShaderAluOp;
+
+// ALU_WORD1_OP2::ALU_INST (bits 7-17)
+static const ShaderAluOp sAluOp2[0x80] = {
+    [0x00] = { "ADD", 2, false },           [0x01] = { "MUL", 2, false },
+    [0x02] = { "MUL_IEEE", 2, false },      [0x03] = { "MAX", 2, false },
+    [0x04] = { "MIN", 2, false },           [0x05] = { "MAX_DX10", 2, false },
+    [0x06] = { "MIN_DX10", 2, false },      [0x08] = { "SETE", 2, false },
+    [0x09] = { "SETGT", 2, false },         [0x0A] = { "SETGE", 2, false },
+    [0x0B] = { "SETNE", 2, false },         [0x0C] = { "SETE_DX10", 2, false },
+    [0x0D] = { "SETGT_DX10", 2, false },    [0x0E] = { "SETGE_DX10", 2, false },
+    [0x0F] = { "SETNE_DX10", 2, false },    [0x10] = { "FRACT", 1, false },
+    [0x11] = { "TRUNC", 1, false },         [0x12] = { "CEIL", 1, false },
+    [0x13] = { "RNDNE", 1, false },         [0x14] = { "FLOOR", 1, false },
+    [0x15] = { "MOVA", 1, false },          [0x16] = { "MOVA_FLOOR", 1, false },
+    [0x18] = { "MOVA_INT", 1, false },      [0x19] = { "MOV", 1, false },
+    [0x1A] = { "NOP", 0, false },           [0x1E] = { "PRED_SETGT_UINT", 2, false },
+    [0x1F] = { "PRED_SETGE_UINT", 2, false },
+    [0x20] = { "PRED_SETE", 2, false },     [0x21] = { "PRED_SETGT", 2, false },
+    [0x22] = { "PRED_SETGE", 2, false },    [0x23] = { "PRED_SETNE", 2, false },
+    [0x24] = { "PRED_SET_INV", 1, false },  [0x25] = { "PRED_SET_POP", 2, false },
+    [0x26] = { "PRED_SET_CLR", 0, false },  [0x27] = { "PRED_SET_RESTORE", 1, false },
+    [0x28] = { "PRED_SETE_PUSH", 2, false },  [0x29] = { "PRED_SETGT_PUSH", 2, false },
+    [0x2A] = { "PRED_SETGE_PUSH", 2, false }, [0x2B] = { "PRED_SETNE_PUSH", 2, false },
+    [0x2C] = { "KILLE", 2, false },         [0x2D] = { "KILLGT", 2, false },
+    [0x2E] = { "KILLGE", 2, false },        [0x2F] = { "KILLNE", 2, false },
+    [0x30] = { "AND_INT", 2, false },       [0x31] = { "OR_INT", 2, false },
+    [0x32] = { "XOR_INT", 2, false },       [0x33] = { "NOT_INT", 1, false },
+    [0x34] = { "ADD_INT", 2, false },       [0x35] = { "SUB_INT", 2, false },
+    [0x36] = { "MAX_INT", 2, false },       [0x37] = { "MIN_INT", 2, false },
+    [0x38] = { "MAX_UINT", 2, false },      [0x39] = { "MIN_UINT", 2, false },
+    [0x3A] = { "SETE_INT", 2, false },      [0x3B] = { "SETGT_INT", 2, false },
+    [0x3C] = { "SETGE_INT", 2, false },     [0x3D] = { "SETNE_INT", 2, false },
+    [0x3E] = { "SETGT_UINT", 2, false },    [0x3F] = { "SETGE_UINT", 2, false },
+    [0x40] = { "KILLGT_UINT", 2, false },   [0x41] = { "KILLGE_UINT", 2, false },
+    [0x42] = { "PRED_SETE_INT", 2, false }, [0x43] = { "PRED_SETGT_INT", 2, false },
+    [0x44] = { "PRED_SETGE_INT", 2, false },[0x45] = { "PRED_SETNE_INT", 2, false },
+    [0x46] = { "KILLE_INT", 2, false },     [0x47] = { "KILLGT_INT", 2, false },
+    [0x48] = { "KILLGE_INT", 2, false },    [0x49] = { "KILLNE_INT", 2, false },
+    [0x50] = { "DOT4", 2, false },          [0x51] = { "DOT4_IEEE", 2, false },
+    [0x52] = { "CUBE", 2, false },          [0x53] = { "MAX4", 1, false },
+    [0x60] = { "MOVA_GPR_INT", 1, false },
+    [0x61] = { "EXP_IEEE", 1, true },       [0x62] = { "LOG_CLAMPED", 1, true },
+    [0x63] = { "LOG_IEEE", 1, true },       [0x64] = { "RECIP_CLAMPED", 1, true },
+    [0x65] = { "RECIP_FF", 1, true },       [0x66] = { "RECIP_IEEE", 1, true },
+    [0x67] = { "RECIPSQRT_CLAMPED", 1, true }, [0x68] = { "RECIPSQRT_FF", 1, true },
+    [0x69] = { "RECIPSQRT_IEEE", 1, true }, [0x6A] = { "SQRT_IEEE", 1, true },
+    [0x6B] = { "FLT_TO_INT", 1, true },     [0x6C] = { "INT_TO_FLT", 1, true },
+    [0x6D] = { "UINT_TO_FLT", 1, true },    [0x6E] = { "SIN", 1, true },
+    [0x6F] = { "COS", 1, true },            [0x70] = { "ASHR_INT", 2, true },
+    [0x71] = { "LSHR_INT", 2, true },       [0x72] = { "LSHL_INT", 2, true },
+    [0x73] = { "MULLO_INT", 2, true },      [0x74] = { "MULHI_INT", 2, true },
+    [0x75] = { "MULLO_UINT", 2, true },     [0x76] = { "MULHI_UINT", 2, true },
+    [0x77] = { "RECIP_INT", 1, true },      [0x78] = { "RECIP_UINT", 1, true },
+    [0x79] = { "FLT_TO_UINT", 1, true },
+};
+
+// ALU_WORD1_OP3::ALU_INST (bits 13-17)
+static const char* const sAluOp3Names[0x20] = {
+    [0x0C] = "MUL_LIT",     [0x0D] = "MUL_LIT_M2",     [0x0E] = "MUL_LIT_M4",     [0x0F] = "MUL_LIT_D2",
+    [0x10] = "MULADD",      [0x11] = "MULADD_M2",      [0x12] = "MULADD_M4",      [0x13] = "MULADD_D2",
+    [0x14] = "MULADD_IEEE", [0x15] = "MULADD_IEEE_M2", [0x16] = "MULADD_IEEE_M4", [0x17] = "MULADD_IEEE_D2",
+    [0x18] = "CNDE",        [0x19] = "CNDGT",          [0x1A] = "CNDGE",
+    [0x1C] = "CNDE_INT",    [0x1D] = "CNDGT_INT",      [0x1E] = "CNDGE_INT",
+};
+
+// TEX_WORD0::TEX_INST (bits 0-4)
+static const char* const sTexNames[0x20] = {
+    [0x00] = "VTX_FETCH",       [0x01] = "VTX_SEMANTIC",     [0x03] = "LD",
+    [0x04] = "GET_RESINFO",     [0x05] = "GET_NUM_SAMPLES",  [0x06] = "GET_LOD",
+    [0x07] = "GET_GRADIENTS_H", [0x08] = "GET_GRADIENTS_V",  [0x0B] = "SET_GRADIENTS_H",
+    [0x0C] = "SET_GRADIENTS_V", [0x0D] = "PASS",
+    [0x10] = "SAMPLE",          [0x11] = "SAMPLE_L",         [0x12] = "SAMPLE_LB",
+    [0x13] = "SAMPLE_LZ",       [0x14] = "SAMPLE_G",         [0x15] = "SAMPLE_G_L",
+    [0x16] = "SAMPLE_G_LB",     [0x17] = "SAMPLE_G_LZ",      [0x18] = "SAMPLE_C",
+    [0x19] = "SAMPLE_C_L",      [0x1A] = "SAMPLE_C_LB",      [0x1B] = "SAMPLE_C_LZ",
+    [0x1C] = "SAMPLE_C_G",      [0x1D] = "SAMPLE_C_G_L",     [0x1E] = "SAMPLE_C_G_LB",
+    [0x1F] = "SAMPLE_C_G_LZ",
+};
+
+static const char sChannels[] = "xyzw";
+static const char sSwizzles[] = "xyzw01?_";
+
+typedef struct ShaderDecoder
+{
+    const u8* program;
+    u32 num_words;
+    ShaderAnalysis* analysis;
+    FILE* out;
+    char* error;
+    u32 error_size;
+    bool used_temps[4];
+} ShaderDecoder;
+
+static u32 ShaderReadWord(const ShaderDecoder* decoder, u32 index)
+{
+    const u8* p = decoder->program + index * 4;
+    return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static f32 ShaderWordToFloat(u32 word)
+{
+    f32 value;
+    memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+static bool ShaderFail(ShaderDecoder* decoder, const char* fmt, ...)
+{
+    if (decoder->error && decoder->error_size > 0)
+    {
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(decoder->error, decoder->error_size, fmt, args);
+        va_end(args);
+    }
+
+    return false;
+}
+
+// Note a GPR access for the register count
+static void ShaderUseGpr(ShaderDecoder* decoder, u32 gpr)
+{
+    if (gpr >= ALU_SRC_CLAUSE_TEMP_FIRST && gpr <= ALU_SRC_GPR_MAX)
+    {
+        if (!decoder->used_temps[gpr - ALU_SRC_CLAUSE_TEMP_FIRST])
+        {
+            decoder->used_temps[gpr - ALU_SRC_CLAUSE_TEMP_FIRST] = true;
+            decoder->analysis->clause_temps++;
+        }
+    }
+    else if (gpr + 1 > decoder->analysis->gprs)
+    {
+        decoder->analysis->gprs = gpr + 1;
+    }
+}
+
+static void ShaderFormatGpr(char* buf, size_t size, u32 gpr)
+{
+    if (gpr >= ALU_SRC_CLAUSE_TEMP_FIRST && gpr <= ALU_SRC_GPR_MAX)
+        snprintf(buf, size, "T%u", gpr - ALU_SRC_CLAUSE_TEMP_FIRST);
+    else
+        snprintf(buf, size, "R%u", gpr);
+}
+
+// Format an ALU source operand
+static void ShaderFormatAluSrc(char* buf, size_t size, u32 sel, u32 chan, bool neg, bool abs, bool rel, const u32* literals)
+{
+    char value[48];
+    char c = sChannels[chan];
+
+    if (sel <= ALU_SRC_GPR_MAX)
+    {
+        char gpr[8];
+        ShaderFormatGpr(gpr, sizeof(gpr), sel);
+        snprintf(value, sizeof(value), "%s%s.%c", gpr, rel ? "[AL]" : "", c);
+    }
+    else if (sel < ALU_SRC_KCACHE1_FIRST)
+        snprintf(value, sizeof(value), "KC0[%u].%c", sel - ALU_SRC_KCACHE0_FIRST, c);
+    else if (sel < ALU_SRC_KCACHE1_FIRST + 32)
+        snprintf(value, sizeof(value), "KC1[%u].%c", sel - ALU_SRC_KCACHE1_FIRST, c);
+    else if (sel >= ALU_SRC_CFILE_FIRST)
+        snprintf(value, sizeof(value), "C%u%s.%c", sel - ALU_SRC_CFILE_FIRST, rel ? "[AL]" : "", c);
+    else
+    {
+        switch (sel)
+        {
+        case ALU_SRC_0:       snprintf(value, sizeof(value), "0.0f"); break;
+        case ALU_SRC_1:       snprintf(value, sizeof(value), "1.0f"); break;
+        case ALU_SRC_1_INT:   snprintf(value, sizeof(value), "1"); break;
+        case ALU_SRC_M_1_INT: snprintf(value, sizeof(value), "-1"); break;
+        case ALU_SRC_0_5:     snprintf(value, sizeof(value), "0.5f"); break;
+        case ALU_SRC_LITERAL:
+            snprintf(value, sizeof(value), "(0x%08X, %g)", literals[chan], ShaderWordToFloat(literals[chan]));
+            break;
+        case ALU_SRC_PV:      snprintf(value, sizeof(value), "PV.%c", c); break;
+        case ALU_SRC_PS:      snprintf(value, sizeof(value), "PS"); break;
+        default:              snprintf(value, sizeof(value), "?%u", sel); break;
+        }
+    }
+
+    snprintf(buf, size, "%s%s%s%s", neg ? "-" : "", abs ? "|" : "", value, abs ? "|" : "");
+}
+
+// Decode an ALU clause
+static bool ShaderDecodeAluClause(ShaderDecoder* decoder, u32 addr, u32 count)
+{
+    ShaderAnalysis* analysis = decoder->analysis;
+
+    // ADDR and COUNT are in 64-bit slots, literals included
+    u32 slot = addr;
+    u32 end = addr + count;
+    if (end * 2 > decoder->num_words)
+        return ShaderFail(decoder, "ALU clause at slot %u overruns the program", addr);
+
+    u32 group = 0;
+    while (slot < end)
+    {
+        // Collect one instruction group (up to 5 instructions, the last one has LAST set)
+        u32 words[5][2];
+        u32 num_insts = 0;
+        bool last = false;
+
+        while (!last)
+        {
+            if (slot >= end || num_insts == 5)
+                return ShaderFail(decoder, "Unterminated ALU group at slot %u", slot);
+
+            words[num_insts][0] = ShaderReadWord(decoder, slot * 2);
+            words[num_insts][1] = ShaderReadWord(decoder, slot * 2 + 1);
+            last = (words[num_insts][0] >> 31) & 1;
+            num_insts++;
+            slot++;
+        }
+
+        // Literal constants follow the group, in pairs
+        u32 literals[4] = { 0, 0, 0, 0 };
+        u32 num_literals = 0;
+        for (u32 i = 0; i < num_insts; i++)
+        {
+            bool op3 = ((words[i][1] >> 15) & 7) != 0;
+            u32 srcs[3][2] = {
+                { words[i][0] & 0x1FF, (words[i][0] >> 10) & 3 },
+                { (words[i][0] >> 13) & 0x1FF, (words[i][0] >> 23) & 3 },
+                { words[i][1] & 0x1FF, (words[i][1] >> 10) & 3 },
+            };
+
+            for (u32 j = 0; j < (op3 ? 3u : 2u); j++)
+            {
+                if (srcs[j][0] == ALU_SRC_LITERAL && srcs[j][1] + 1 > num_literals)
+                    num_literals = srcs[j][1] + 1;
+            }
+        }
+
+        u32 literal_slots = (num_literals + 1) / 2;
+        if (slot + literal_slots > end)
+            return ShaderFail(decoder, "ALU literals at slot %u overrun the clause", slot);
+
+        for (u32 i = 0; i < literal_slots * 2; i++)
+            literals[i] = ShaderReadWord(decoder, slot * 2 + i);
+
+        slot += literal_slots;
+        analysis->literals += num_literals;
+        analysis->alu_groups++;
+
+        // Decode the instructions
+        bool units_used[4] = { false, false, false, false };
+        for (u32 i = 0; i < num_insts; i++)
+        {
+            u32 w0 = words[i][0];
+            u32 w1 = words[i][1];
+            bool op3 = ((w1 >> 15) & 7) != 0;
+
+            const char* name;
+            char unknown_name[16];
+            u32 num_srcs;
+            bool trans = false;
+            bool write = true;
+
+            if (op3)
+            {
+                u32 inst = (w1 >> 13) & 0x1F;
+                name = sAluOp3Names[inst];
+                if (!name)
+                {
+                    snprintf(unknown_name, sizeof(unknown_name), "OP3_%02X", inst);
+                    name = unknown_name;
+                }
+                num_srcs = 3;
+            }
+            else
+            {
+                u32 inst = (w1 >> 7) & 0x7FF;
+                const ShaderAluOp* op = inst < 0x80 ? &sAluOp2[inst] : NULL;
+                if (op && op->name)
+                {
+                    name = op->name;
+                    num_srcs = op->num_srcs;
+                    trans = op->trans;
+                }
+                else
+                {
+                    snprintf(unknown_name, sizeof(unknown_name), "OP2_%03X", inst);
+                    name = unknown_name;
+                    num_srcs = 2;
+                }
+                write = (w1 >> 4) & 1;
+            }
+
+            u32 dst_gpr = (w1 >> 21) & 0x7F;
+            u32 dst_chan = (w1 >> 29) & 3;
+
+            // Instructions go to the vector unit of their destination channel;
+            // the transcendental unit takes trans-only instructions and the second one of a channel
+            char unit;
+            if (trans || units_used[dst_chan])
+            {
+                unit = 't';
+                analysis->trans_instructions += trans;
+            }
+            else
+            {
+                unit = sChannels[dst_chan];
+                units_used[dst_chan] = true;
+            }
+
+            analysis->alu_instructions++;
+
+            u32 sels[3] = { w0 & 0x1FF, (w0 >> 13) & 0x1FF, w1 & 0x1FF };
+            for (u32 j = 0; j < num_srcs; j++)
+            {
+                if (sels[j] <= ALU_SRC_GPR_MAX)
+                    ShaderUseGpr(decoder, sels[j]);
+            }
+
+            if (write)
+                ShaderUseGpr(decoder, dst_gpr);
+
+            if (decoder->out)
+            {
+                char dst[16];
+                if (write)
+                {
+                    char gpr[8];
+                    ShaderFormatGpr(gpr, sizeof(gpr), dst_gpr);
+                    snprintf(dst, sizeof(dst), "%s.%c", gpr, sChannels[dst_chan]);
+                }
+                else
+                    snprintf(dst, sizeof(dst), "____");
+
+                fprintf(decoder->out, "      %3u %c: %-12s%s", group, unit, name, dst);
+
+                for (u32 j = 0; j < num_srcs; j++)
+                {
+                    char src[64];
+                    if (j == 0)
+                        ShaderFormatAluSrc(src, sizeof(src), sels[0], (w0 >> 10) & 3, (w0 >> 12) & 1, !op3 && (w1 & 1), (w0 >> 9) & 1, literals);
+                    else if (j == 1)
+                        ShaderFormatAluSrc(src, sizeof(src), sels[1], (w0 >> 23) & 3, (w0 >> 25) & 1, !op3 && ((w1 >> 1) & 1), (w0 >> 22) & 1, literals);
+                    else
+                        ShaderFormatAluSrc(src, sizeof(src), sels[2], (w1 >> 10) & 3, (w1 >> 12) & 1, false, (w1 >> 9) & 1, literals);
+                    fprintf(decoder->out, ", %s", src);
+                }
+
+                if ((w1 >> 31) & 1)
+                    fprintf(decoder->out, " CLAMP");
+                fprintf(decoder->out, "\n");
+            }
+        }
+
+        group++;
+    }
+
+    return true;
+}
+
+// Decode a TEX or VTX clause (fetch instructions are 128 bits each)
+static bool ShaderDecodeFetchClause(ShaderDecoder* decoder, u32 addr, u32 count, bool vtx)
+{
+    ShaderAnalysis* analysis = decoder->analysis;
+
+    // ADDR is in 64-bit units
+    u32 first_word = addr * 2;
+    if (first_word + count * 4 > decoder->num_words)
+        return ShaderFail(decoder, "Fetch clause at slot %u overruns the program", addr);
+
+    for (u32 i = 0; i < count; i++)
+    {
+        u32 w0 = ShaderReadWord(decoder, first_word + i * 4);
+        u32 w1 = ShaderReadWord(decoder, first_word + i * 4 + 1);
+
+        u32 inst = w0 & 0x1F;
+        u32 resource = (w0 >> 8) & 0xFF;
+        u32 src_gpr = (w0 >> 16) & 0x7F;
+        u32 dst_gpr = w1 & 0x7F;
+
+        // Vertex fetches are VTX_FETCH / VTX_SEMANTIC in VTX clauses
+        bool is_vtx = vtx || inst <= 0x01;
+        if (is_vtx)
+            analysis->vtx_fetches++;
+        else
+            analysis->tex_fetches++;
+
+        ShaderUseGpr(decoder, src_gpr);
+
+        // Channels selected as 7 are masked out
+        char dst_swizzle[5];
+        bool writes = false;
+        for (u32 c = 0; c < 4; c++)
+        {
+            u32 sel = (w1 >> (9 + c * 3)) & 7;
+            dst_swizzle[c] = sSwizzles[sel];
+            writes |= sel != 7;
+        }
+        dst_swizzle[4] = '\0';
+
+        if (writes)
+            ShaderUseGpr(decoder, dst_gpr);
+
+        if (decoder->out)
+        {
+            const char* name = sTexNames[inst];
+            char unknown_name[16];
+            if (!name)
+            {
+                snprintf(unknown_name, sizeof(unknown_name), "TEX_%02X", inst);
+                name = unknown_name;
+            }
+
+            char src[8], dst[8];
+            ShaderFormatGpr(src, sizeof(src), src_gpr);
+            ShaderFormatGpr(dst, sizeof(dst), dst_gpr);
+
+            if (is_vtx)
+            {
+                fprintf(decoder->out, "      %3u   %-12s%s.%s, %s.%c, b%u\n", i, name, dst, dst_swizzle, src, sChannels[(w0 >> 24) & 3], resource);
+            }
+            else
+            {
+                u32 w2 = ShaderReadWord(decoder, first_word + i * 4 + 2);
+                u32 sampler = (w2 >> 15) & 0x1F;
+                char src_swizzle[5];
+                for (u32 c = 0; c < 4; c++)
+                    src_swizzle[c] = sSwizzles[(w2 >> (20 + c * 3)) & 7];
+                src_swizzle[4] = '\0';
+
+                fprintf(decoder->out, "      %3u   %-12s%s.%s, %s.%s, t%u, s%u\n", i, name, dst, dst_swizzle, src, src_swizzle, resource, sampler);
+            }
+        }
+    }
+
+    return true;
+}
+
+static const char* ShaderGetCfName(u32 inst)
+{
+    switch (inst)
+    {
+    case CF_INST_NOP:              return "NOP";
+    case CF_INST_TEX:              return "TEX";
+    case CF_INST_VTX:              return "VTX";
+    case CF_INST_VTX_TC:           return "VTX_TC";
+    case CF_INST_LOOP_START:       return "LOOP_START";
+    case CF_INST_LOOP_END:         return "LOOP_END";
+    case CF_INST_LOOP_START_DX10:  return "LOOP_START_DX10";
+    case CF_INST_LOOP_START_NO_AL: return "LOOP_START_NO_AL";
+    case CF_INST_LOOP_CONTINUE:    return "LOOP_CONTINUE";
+    case CF_INST_LOOP_BREAK:       return "LOOP_BREAK";
+    case CF_INST_JUMP:             return "JUMP";
+    case CF_INST_PUSH:             return "PUSH";
+    case CF_INST_PUSH_ELSE:        return "PUSH_ELSE";
+    case CF_INST_ELSE:             return "ELSE";
+    case CF_INST_POP:              return "POP";
+    case CF_INST_POP_JUMP:         return "POP_JUMP";
+    case CF_INST_POP_PUSH:         return "POP_PUSH";
+    case CF_INST_POP_PUSH_ELSE:    return "POP_PUSH_ELSE";
+    case CF_INST_CALL:             return "CALL";
+    case CF_INST_CALL_FS:          return "CALL_FS";
+    case CF_INST_RETURN:           return "RETURN";
+    case CF_INST_EMIT_VERTEX:      return "EMIT_VERTEX";
+    case CF_INST_EMIT_CUT_VERTEX:  return "EMIT_CUT_VERTEX";
+    case CF_INST_CUT_VERTEX:       return "CUT_VERTEX";
+    case CF_INST_KILL:             return "KILL";
+    case CF_INST_MEM_STREAM0:      return "MEM_STREAM0";
+    case CF_INST_MEM_STREAM1:      return "MEM_STREAM1";
+    case CF_INST_MEM_STREAM2:      return "MEM_STREAM2";
+    case CF_INST_MEM_STREAM3:      return "MEM_STREAM3";
+    case CF_INST_MEM_SCRATCH:      return "MEM_SCRATCH";
+    case CF_INST_MEM_REDUCTION:    return "MEM_REDUCTION";
+    case CF_INST_MEM_RING:         return "MEM_RING";
+    case CF_INST_EXPORT:           return "EXP";
+    case CF_INST_EXPORT_DONE:      return "EXP_DONE";
+    default:                       return NULL;
+    }
+}
+
+static void ShaderPrintExport(ShaderDecoder* decoder, u32 w0, u32 w1, ShaderStage stage)
+{
+    static const char* const pixel_types[4] = { "PIX", "Z", "?", "?" };
+    static const char* const vertex_types[4] = { "?", "POS", "PARAM", "?" };
+
+    u32 array_base = w0 & 0x1FFF;
+    u32 type = (w0 >> 13) & 3;
+    u32 gpr = (w0 >> 15) & 0x7F;
+    u32 burst = ((w1 >> 17) & 0xF) + 1;
+
+    const char* type_name = stage == SHADER_STAGE_PIXEL ? pixel_types[type] : vertex_types[type];
+
+    // Position exports start at 60
+    if (stage == SHADER_STAGE_VERTEX && type == 1 && array_base >= 60)
+        array_base -= 60;
+
+    char swizzle[5];
+    for (u32 c = 0; c < 4; c++)
+        swizzle[c] = sSwizzles[(w1 >> (c * 3)) & 7];
+    swizzle[4] = '\0';
+
+    fprintf(decoder->out, ": %s%u, R%u.%s", type_name, array_base, gpr, swizzle);
+    if (burst > 1)
+        fprintf(decoder->out, " BURST(%u)", burst);
+}
+
+bool ShaderAnalyse(const u8* program, u32 size, ShaderStage stage, ShaderAnalysis* pAnalysis, FILE* disassembly, char* error, u32 error_size)
+{
+    memset(pAnalysis, 0, sizeof(ShaderAnalysis));
+    if (error && error_size > 0)
+        error[0] = '\0';
+
+    ShaderDecoder decoder;
+    memset(&decoder, 0, sizeof(decoder));
+    decoder.program = program;
+    decoder.num_words = size / 4;
+    decoder.analysis = pAnalysis;
+    decoder.out = disassembly;
+    decoder.error = error;
+    decoder.error_size = error_size;
+
+    bool ok = true;
+    bool end = false;
+
+    for (u32 cf = 0; !end; cf++)
+    {
+        if (cf * 2 + 1 >= decoder.num_words)
+        {
+            ok = ShaderFail(&decoder, "Program ends without END_OF_PROGRAM");
+            break;
+        }
+
+        u32 w0 = ShaderReadWord(&decoder, cf * 2);
+        u32 w1 = ShaderReadWord(&decoder, cf * 2 + 1);
+        pAnalysis->cf_instructions++;
+
+        // ALU clauses have their own encoding
+        if ((w1 >> 29) & 1)
+        {
+            u32 inst = (w1 >> 26) & 7;
+            u32 addr = w0 & 0x3FFFFF;
+            u32 count = ((w1 >> 18) & 0x7F) + 1;
+            pAnalysis->alu_clauses++;
+
+            if (disassembly)
+            {
+                fprintf(disassembly, "%02u %s: ADDR(%u) CNT(%u)", cf, sAluCfNames[inst], addr, count);
+                u32 kcache_mode0 = (w0 >> 30) & 3;
+                u32 kcache_mode1 = w1 & 3;
+                if (kcache_mode0)
+                    fprintf(disassembly, " KCACHE0(CB%u:%u-%u)", (w0 >> 22) & 0xF, ((w1 >> 2) & 0xFF) * 16, ((w1 >> 2) & 0xFF) * 16 + (kcache_mode0 == 1 ? 15 : 31));
+                if (kcache_mode1)
+                    fprintf(disassembly, " KCACHE1(CB%u:%u-%u)", (w0 >> 26) & 0xF, ((w1 >> 10) & 0xFF) * 16, ((w1 >> 10) & 0xFF) * 16 + (kcache_mode1 == 1 ? 15 : 31));
+                fprintf(disassembly, "\n");
+            }
+
+            if (!ShaderDecodeAluClause(&decoder, addr, count))
+            {
+                ok = false;
+                break;
+            }
+            continue;
+        }
+
+        u32 inst = (w1 >> 23) & 0x7F;
+        const char* name = ShaderGetCfName(inst);
+
+        if (!name)
+        {
+            ok = ShaderFail(&decoder, "Unknown CF instruction %u at %u", inst, cf);
+            break;
+        }
+
+        end = (w1 >> 21) & 1;
+
+        if (disassembly)
+            fprintf(disassembly, "%02u %s", cf, name);
+
+        switch (inst)
+        {
+        case CF_INST_TEX:
+        case CF_INST_VTX:
+        case CF_INST_VTX_TC:
+        {
+            // COUNT is bits 10-12, with a fourth bit in bit 19 (R700)
+            u32 count = (((w1 >> 10) & 7) | (((w1 >> 19) & 1) << 3)) + 1;
+            bool vtx = inst != CF_INST_TEX;
+            if (vtx)
+                pAnalysis->vtx_clauses++;
+            else
+                pAnalysis->tex_clauses++;
+
+            if (disassembly)
+                fprintf(disassembly, ": ADDR(%u) CNT(%u)\n", w0, count);
+
+            if (!ShaderDecodeFetchClause(&decoder, w0, count, vtx))
+                ok = false;
+            break;
+        }
+
+        case CF_INST_EXPORT:
+        case CF_INST_EXPORT_DONE:
+        case CF_INST_MEM_STREAM0:
+        case CF_INST_MEM_STREAM1:
+        case CF_INST_MEM_STREAM2:
+        case CF_INST_MEM_STREAM3:
+        case CF_INST_MEM_SCRATCH:
+        case CF_INST_MEM_REDUCTION:
+        case CF_INST_MEM_RING:
+        {
+            u32 burst = ((w1 >> 17) & 0xF) + 1;
+            pAnalysis->exports += burst;
+
+            // Every exported register counts as used
+            u32 gpr = (w0 >> 15) & 0x7F;
+            for (u32 i = 0; i < burst; i++)
+                ShaderUseGpr(&decoder, gpr + i);
+
+            if (disassembly)
+            {
+                if (inst == CF_INST_EXPORT || inst == CF_INST_EXPORT_DONE)
+                    ShaderPrintExport(&decoder, w0, w1, stage);
+                fprintf(disassembly, "%s\n", end ? " END_OF_PROGRAM" : "");
+            }
+            break;
+        }
+
+        case CF_INST_LOOP_START:
+        case CF_INST_LOOP_START_DX10:
+        case CF_INST_LOOP_START_NO_AL:
+            pAnalysis->loops++;
+            // Fall through
+        default:
+            if (inst == CF_INST_CALL_FS)
+                pAnalysis->calls_fetch_shader = true;
+
+            if (disassembly)
+            {
+                if (inst == CF_INST_JUMP || inst == CF_INST_ELSE || inst == CF_INST_POP_JUMP || inst == CF_INST_CALL ||
+                    inst == CF_INST_LOOP_START || inst == CF_INST_LOOP_START_DX10 || inst == CF_INST_LOOP_START_NO_AL ||
+                    inst == CF_INST_LOOP_END || inst == CF_INST_LOOP_BREAK || inst == CF_INST_LOOP_CONTINUE)
+                    fprintf(disassembly, " ADDR(%u)", w0);
+                if (w1 & 7)
+                    fprintf(disassembly, " POP_CNT(%u)", w1 & 7);
+                fprintf(disassembly, "%s\n", end ? " END_OF_PROGRAM" : "");
+            }
+            break;
+        }
+
+        if (!ok)
+            break;
+    }
+
+    // Cost estimate
+    f32 alu_cycles = pAnalysis->alu_groups * SHADER_CYCLES_PER_ALU_GROUP;
+    f32 fetch_cycles = pAnalysis->tex_fetches * SHADER_CYCLES_PER_TEX_FETCH + pAnalysis->vtx_fetches * SHADER_CYCLES_PER_VTX_FETCH;
+    u32 clauses = pAnalysis->alu_clauses + pAnalysis->tex_clauses + pAnalysis->vtx_clauses;
+
+    pAnalysis->est_cycles = (alu_cycles > fetch_cycles ? alu_cycles : fetch_cycles)
+                          + clauses * SHADER_CYCLES_PER_CLAUSE
+                          + pAnalysis->exports * SHADER_CYCLES_PER_EXPORT;
+
+    return ok;
+}
+
+u32 ShaderGetRegisterGprs(u32 sq_pgm_resources)
+{
+    return sq_pgm_resources & 0xFF;
+}
+
+u32 ShaderGetRegisterStack(u32 sq_pgm_resources)
+{
+    return (sq_pgm_resources >> 8) & 0xFF;
+}
+
+void ShaderPrintAnalysis(FILE* out, const ShaderAnalysis* analysis)
+{
+    fprintf(out, "  CF instructions:   %u (%u ALU, %u TEX, %u VTX clauses, %u exports%s%s)\n",
+            analysis->cf_instructions, analysis->alu_clauses, analysis->tex_clauses, analysis->vtx_clauses,
+            analysis->exports, analysis->loops ? ", loops counted once" : "",
+            analysis->calls_fetch_shader ? ", calls the fetch shader" : "");
+    fprintf(out, "  ALU:               %u instructions in %u groups (%u transcendental, %u literals)\n",
+            analysis->alu_instructions, analysis->alu_groups, analysis->trans_instructions, analysis->literals);
+    fprintf(out, "  Fetches:           %u TEX, %u VTX\n", analysis->tex_fetches, analysis->vtx_fetches);
+    fprintf(out, "  GPRs:              %u (+%u clause temporaries)\n", analysis->gprs, analysis->clause_temps);
+    fprintf(out, "  Estimated cost:    %.2f cycles\n", analysis->est_cycles);
+}
@@ -0,0 +1,79 @@
+// Offline analyser for Wii U (R600 / R700 family) shader microcode
+// Decodes the control flow (CF), ALU and fetch (TEX / VTX) clauses of a vertex or pixel shader program,
+// counts instructions, clauses, GPRs and fetches, and estimates the cost of the shader per vertex or pixel
+// The estimate is a simple throughput model (see ShaderAnalysis::est_cycles); it is meant to compare
+// shaders against each other and catch regressions, not to predict exact timings
+
+#ifndef SHADER_ANALYSER_H_
+#define SHADER_ANALYSER_H_
+
+#include <test_types.h>
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef enum ShaderStage
+{
+    SHADER_STAGE_VERTEX,
+    SHADER_STAGE_PIXEL
+} ShaderStage;
+
+typedef struct ShaderAnalysis
+{
+    // Control flow
+    u32 cf_instructions;        // Number of CF instructions
+    u32 alu_clauses;
+    u32 tex_clauses;
+    u32 vtx_clauses;
+    u32 exports;                // Number of export instructions (including their bursts)
+    u32 loops;                  // Number of loops (their bodies are counted once)
+    bool calls_fetch_shader;    // Vertex shaders: whether the fetch shader is called
+
+    // ALU
+    u32 alu_groups;             // Number of VLIW instruction groups (one issue cycle each)
+    u32 alu_instructions;       // Number of ALU instructions
+    u32 trans_instructions;     // Instructions only the transcendental unit can execute
+    u32 literals;               // Number of literal constants
+
+    // Fetches
+    u32 tex_fetches;            // Texture fetches
+    u32 vtx_fetches;            // Vertex fetches (in the shader itself, not the fetch shader)
+
+    // Registers
+    u32 gprs;                   // Highest GPR index used + 1 (not counting clause temporaries)
+    u32 clause_temps;           // Number of clause temporaries used (T0-T3)
+
+    // Estimated cost per vertex or pixel, in shader core cycles
+    // ALU groups and fetches run on separate units and overlap between wavefronts,
+    // so the cost is the largest of the two, plus an overhead per clause switch
+    f32 est_cycles;
+} ShaderAnalysis;
+
+// Analyse a shader program
+// Parameters:
+// - program: The program microcode, as passed to the GPU (the "program" of a GX2VertexShader / GX2PixelShader)
+// - size: Size of the program in bytes
+// - stage: Stage of the program
+// - pAnalysis: Output analysis
+// - disassembly: Stream to print the disassembly to, or NULL
+// - error: Buffer receiving an error message if the program can't be decoded (may be NULL)
+// - error_size: Size of the error buffer
+// Returns false if the program is malformed (the analysis then covers the part decoded so far)
+bool ShaderAnalyse(const u8* program, u32 size, ShaderStage stage, ShaderAnalysis* pAnalysis, FILE* disassembly, char* error, u32 error_size);
+
+// Get the number of GPRs and the stack size from an SQ_PGM_RESOURCES_VS / SQ_PGM_RESOURCES_PS register value
+u32 ShaderGetRegisterGprs(u32 sq_pgm_resources);
+u32 ShaderGetRegisterStack(u32 sq_pgm_resources);
+
+// Print the analysis as a short report
+void ShaderPrintAnalysis(FILE* out, const ShaderAnalysis* analysis);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // SHADER_ANALYSER_H_
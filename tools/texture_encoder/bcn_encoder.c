@@ -0,0 +1,910 @@
+// Block-compressed texture (BCn) encoder and decoder
+// Every format is built from two kinds of 4x4 blocks:
+// - Color blocks (BC1, and the color of BC3): two RGB565 endpoints and a 2-bit index per pixel into a
+//   palette of the endpoints and two colors between them (or one, and transparent black, in the
+//   punch-through alpha mode of BC1)
+// - Single channel blocks (BC4, BC5, and the alpha of BC3): two 8-bit endpoints and a 3-bit index per
+//   pixel into a palette of the endpoints and six values between them (or four, 0 and 255)
+
+#include "bcn_encoder.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif // __SSE2__
+
+const char* BcnGetFormatName(BcnFormat format)
+{
+    static const char* const names[BCN_FORMAT_COUNT] = {
+        "RGBA8", "BC1", "BC3", "BC4", "BC5"
+    };
+
+    return format < BCN_FORMAT_COUNT ? names[format] : "?";
+}
+
+const char* BcnGetQualityName(BcnQuality quality)
+{
+    static const char* const names[BCN_QUALITY_COUNT] = {
+        "fast", "normal", "high"
+    };
+
+    return quality < BCN_QUALITY_COUNT ? names[quality] : "?";
+}
+
+u32 BcnGetElementSize(BcnFormat format)
+{
+    switch (format)
+    {
+    case BCN_FORMAT_BC1: return 8;
+    case BCN_FORMAT_BC3: return 16;
+    case BCN_FORMAT_BC4: return 8;
+    case BCN_FORMAT_BC5: return 16;
+    default:             return 4;
+    }
+}
+
+u32 BcnGetImageSize(BcnFormat format, u32 width, u32 height)
+{
+    if (format != BCN_FORMAT_RGBA8)
+    {
+        width = (width + 3) / 4;
+        height = (height + 3) / 4;
+    }
+
+    return width * height * BcnGetElementSize(format);
+}
+
+bool BcnHasSimd()
+{
+#if defined(__SSE2__)
+    return true;
+#else
+    return false;
+#endif // __SSE2__
+}
+
+//------------------------------------------------------------------------------
+// Blocks
+//------------------------------------------------------------------------------
+
+// Gather the 16 pixels of a block (RGBA, row by row), repeating the last row and column of the image
+static void BcnLoadBlock(const u8* rgba, u32 width, u32 height, u32 block_x, u32 block_y, u8* block)
+{
+    for (u32 y = 0; y < 4; y++)
+    {
+        u32 src_y = block_y * 4 + y;
+        if (src_y >= height)
+            src_y = height - 1;
+
+        for (u32 x = 0; x < 4; x++)
+        {
+            u32 src_x = block_x * 4 + x;
+            if (src_x >= width)
+                src_x = width - 1;
+
+            memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)src_y * width + src_x) * 4, 4);
+        }
+    }
+}
+
+static void BcnWrite16(u8* dst, u32 value)
+{
+    dst[0] = (u8)value;
+    dst[1] = (u8)(value >> 8);
+}
+
+static u32 BcnRead16(const u8* src)
+{
+    return (u32)src[0] | ((u32)src[1] << 8);
+}
+
+//------------------------------------------------------------------------------
+// Color blocks
+//------------------------------------------------------------------------------
+
+static u32 BcnPack565(const s32* rgb)
+{
+    s32 r = (rgb[0] * 31 + 127) / 255;
+    s32 g = (rgb[1] * 63 + 127) / 255;
+    s32 b = (rgb[2] * 31 + 127) / 255;
+    return (u32)((r << 11) | (g << 5) | b);
+}
+
+static void BcnUnpack565(u32 color, s32* rgb)
+{
+    s32 r = (color >> 11) & 31;
+    s32 g = (color >> 5) & 63;
+    s32 b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Palette of a color block: four colors, or three and transparent black
+static void BcnColorPalette(u32 c0, u32 c1, bool four_colors, s32 palette[4][3])
+{
+    BcnUnpack565(c0, palette[0]);
+    BcnUnpack565(c1, palette[1]);
+
+    for (u32 i = 0; i < 3; i++)
+    {
+        if (four_colors)
+        {
+            palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+            palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+        }
+        else
+        {
+            palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+            palette[3][i] = 0;
+        }
+    }
+}
+
+// Endpoints of the colors of the pixels in a mask
+// Fast: the corners of the bounding box, on the diagonal the colors vary along
+// Otherwise: the extreme colors along the principal axis of the colors
+static void BcnColorEndpoints(const u8* block, u32 mask, BcnQuality quality, s32* ep0, s32* ep1)
+{
+    s32 min[3] = { 255, 255, 255 }, max[3] = { 0, 0, 0 };
+    s32 sum[3] = { 0, 0, 0 };
+    u32 count = 0;
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        if (!(mask & (1u << i)))
+            continue;
+
+        for (u32 c = 0; c < 3; c++)
+        {
+            s32 v = block[i * 4 + c];
+            if (v < min[c]) min[c] = v;
+            if (v > max[c]) max[c] = v;
+            sum[c] += v;
+        }
+        count++;
+    }
+
+    // Covariance of the colors (scaled by the number of pixels)
+    f32 mean[3], cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (u32 c = 0; c < 3; c++)
+        mean[c] = (f32)sum[c] / (f32)count;
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        if (!(mask & (1u << i)))
+            continue;
+
+        f32 r = block[i * 4 + 0] - mean[0];
+        f32 g = block[i * 4 + 1] - mean[1];
+        f32 b = block[i * 4 + 2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    if (quality == BCN_QUALITY_FAST)
+    {
+        // Flip the box diagonal on the channels varying against the widest one
+        u32 widest = 0;
+        for (u32 c = 1; c < 3; c++)
+            if (max[c] - min[c] > max[widest] - min[widest])
+                widest = c;
+
+        static const u32 cov_index[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+        for (u32 c = 0; c < 3; c++)
+        {
+            bool flip = cov[cov_index[widest][c]] < 0.0f;
+            ep0[c] = flip ? min[c] : max[c];
+            ep1[c] = flip ? max[c] : min[c];
+        }
+        return;
+    }
+
+    // Principal axis by power iteration, starting from the box diagonal
+    f32 axis[3] = { (f32)(max[0] - min[0]), (f32)(max[1] - min[1]), (f32)(max[2] - min[2]) };
+    for (u32 iteration = 0; iteration < 4; iteration++)
+    {
+        f32 x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        f32 y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        f32 z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+
+        f32 length = fmaxf(fabsf(x), fmaxf(fabsf(y), fabsf(z)));
+        if (length < 1e-6f)
+            break;
+
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    f32 min_dot = 1e30f, max_dot = -1e30f;
+    u32 min_pixel = 0, max_pixel = 0;
+    for (u32 i = 0; i < 16; i++)
+    {
+        if (!(mask & (1u << i)))
+            continue;
+
+        f32 dot = block[i * 4 + 0] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+        if (dot < min_dot) { min_dot = dot; min_pixel = i; }
+        if (dot > max_dot) { max_dot = dot; max_pixel = i; }
+    }
+
+    for (u32 c = 0; c < 3; c++)
+    {
+        ep0[c] = block[max_pixel * 4 + c];
+        ep1[c] = block[min_pixel * 4 + c];
+    }
+}
+
+// Indices of the four color palette by projection on the endpoint axis (fast, approximate)
+static void BcnProjectColorIndices(const u8* block, s32 palette[4][3], u8* indices)
+{
+    // Steps from endpoint 1 (0) to endpoint 0 (3), and the index of each step
+    static const u8 step_index[4] = { 1, 3, 2, 0 };
+
+    s32 axis[3] = { palette[0][0] - palette[1][0], palette[0][1] - palette[1][1], palette[0][2] - palette[1][2] };
+    s32 length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        s32 dot = (block[i * 4 + 0] - palette[1][0]) * axis[0]
+                + (block[i * 4 + 1] - palette[1][1]) * axis[1]
+                + (block[i * 4 + 2] - palette[1][2]) * axis[2];
+
+        s32 step = length > 0 ? (dot * 6 + length) / (2 * length) : 0;
+        step = step < 0 ? 0 : step > 3 ? 3 : step;
+        indices[i] = step_index[step];
+    }
+}
+
+// Indices of the nearest entries of the four color palette
+// Returns the total squared error
+static u32 BcnSelectColorIndices(const u8* block, s32 palette[4][3], u8* indices)
+{
+    u32 error = 0;
+
+#if defined(__SSE2__)
+
+    // Four pixels at a time: each pair of pixels widens to eight 16-bit channels (alpha masked out),
+    // and the madd of the differences gives R^2+G^2 and B^2 per pixel, summed by a shuffle
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+
+    __m128i entries[4];
+    for (u32 e = 0; e < 4; e++)
+        entries[e] = _mm_setr_epi16((s16)palette[e][0], (s16)palette[e][1], (s16)palette[e][2], 0,
+                                    (s16)palette[e][0], (s16)palette[e][1], (s16)palette[e][2], 0);
+
+    for (u32 group = 0; group < 4; group++)
+    {
+        __m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(block + group * 16)), rgb_mask);
+        __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+
+        __m128i best = _mm_set1_epi32(0x7FFFFFFF);
+        __m128i best_index = zero;
+
+        for (u32 e = 0; e < 4; e++)
+        {
+            __m128i diff_lo = _mm_sub_epi16(lo, entries[e]);
+            __m128i diff_hi = _mm_sub_epi16(hi, entries[e]);
+            __m128 sq_lo = _mm_castsi128_ps(_mm_madd_epi16(diff_lo, diff_lo));
+            __m128 sq_hi = _mm_castsi128_ps(_mm_madd_epi16(diff_hi, diff_hi));
+
+            __m128i even = _mm_castps_si128(_mm_shuffle_ps(sq_lo, sq_hi, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i odd = _mm_castps_si128(_mm_shuffle_ps(sq_lo, sq_hi, _MM_SHUFFLE(3, 1, 3, 1)));
+            __m128i distance = _mm_add_epi32(even, odd);
+
+            __m128i closer = _mm_cmplt_epi32(distance, best);
+            best = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best));
+            best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32((s32)e)), _mm_andnot_si128(closer, best_index));
+        }
+
+        u32 distances[4], group_indices[4];
+        _mm_storeu_si128((__m128i*)distances, best);
+        _mm_storeu_si128((__m128i*)group_indices, best_index);
+
+        for (u32 i = 0; i < 4; i++)
+        {
+            indices[group * 4 + i] = (u8)group_indices[i];
+            error += distances[i];
+        }
+    }
+
+#else
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        u32 best = 0xFFFFFFFF;
+        for (u32 e = 0; e < 4; e++)
+        {
+            s32 dr = block[i * 4 + 0] - palette[e][0];
+            s32 dg = block[i * 4 + 1] - palette[e][1];
+            s32 db = block[i * 4 + 2] - palette[e][2];
+            u32 distance = (u32)(dr * dr + dg * dg + db * db);
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = (u8)e;
+            }
+        }
+        error += best;
+    }
+
+#endif // __SSE2__
+
+    return error;
+}
+
+// Endpoints minimizing the squared error of the four color palette for fixed indices
+// Returns false if the indices do not constrain both endpoints
+static bool BcnRefineColorEndpoints(const u8* block, const u8* indices, s32* ep0, s32* ep1)
+{
+    // Weight of endpoint 0 for each index, in thirds
+    static const s32 weights[4] = { 3, 0, 2, 1 };
+
+    f32 aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    f32 ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        f32 a = weights[indices[i]] / 3.0f;
+        f32 b = 1.0f - a;
+        aa += a * a; ab += a * b; bb += b * b;
+        for (u32 c = 0; c < 3; c++)
+        {
+            ax[c] += a * block[i * 4 + c];
+            bx[c] += b * block[i * 4 + c];
+        }
+    }
+
+    f32 det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f)
+        return false;
+
+    for (u32 c = 0; c < 3; c++)
+    {
+        f32 v0 = (bb * ax[c] - ab * bx[c]) / det;
+        f32 v1 = (aa * bx[c] - ab * ax[c]) / det;
+        ep0[c] = v0 < 0.0f ? 0 : v0 > 255.0f ? 255 : (s32)(v0 + 0.5f);
+        ep1[c] = v1 < 0.0f ? 0 : v1 > 255.0f ? 255 : (s32)(v1 + 0.5f);
+    }
+    return true;
+}
+
+static void BcnWriteColorBlock(u8* dst, u32 c0, u32 c1, const u8* indices)
+{
+    u32 bits = 0;
+    for (u32 i = 0; i < 16; i++)
+        bits |= (u32)indices[i] << (i * 2);
+
+    BcnWrite16(dst, c0);
+    BcnWrite16(dst + 2, c1);
+    BcnWrite16(dst + 4, bits & 0xFFFF);
+    BcnWrite16(dst + 6, bits >> 16);
+}
+
+// Encode the colors of a block in the four color mode (c0 > c1)
+static void BcnEncodeColorBlock(const u8* block, BcnQuality quality, u8* dst)
+{
+    s32 ep0[3], ep1[3];
+    BcnColorEndpoints(block, 0xFFFF, quality, ep0, ep1);
+
+    u32 c0 = BcnPack565(ep0);
+    u32 c1 = BcnPack565(ep1);
+    u8 indices[16];
+
+    if (c0 == c1)
+    {
+        // Solid color: c0 == c1 would select the three color mode in BC1, so only index 0 is used
+        memset(indices, 0, sizeof(indices));
+        BcnWriteColorBlock(dst, c0, c1, indices);
+        return;
+    }
+
+    if (c0 < c1)
+    {
+        u32 swap = c0; c0 = c1; c1 = swap;
+    }
+
+    s32 palette[4][3];
+    BcnColorPalette(c0, c1, true, palette);
+
+    if (quality == BCN_QUALITY_FAST)
+    {
+        BcnProjectColorIndices(block, palette, indices);
+        BcnWriteColorBlock(dst, c0, c1, indices);
+        return;
+    }
+
+    u32 error = BcnSelectColorIndices(block, palette, indices);
+
+    // Alternate between solving the endpoints for the indices and the indices for the endpoints,
+    // as long as the error decreases
+    for (u32 iteration = 0; quality == BCN_QUALITY_HIGH && iteration < 2 && error > 0; iteration++)
+    {
+        if (!BcnRefineColorEndpoints(block, indices, ep0, ep1))
+            break;
+
+        u32 new_c0 = BcnPack565(ep0);
+        u32 new_c1 = BcnPack565(ep1);
+        if (new_c0 == new_c1)
+            break;
+        if (new_c0 < new_c1)
+        {
+            u32 swap = new_c0; new_c0 = new_c1; new_c1 = swap;
+        }
+
+        s32 new_palette[4][3];
+        u8 new_indices[16];
+        BcnColorPalette(new_c0, new_c1, true, new_palette);
+        u32 new_error = BcnSelectColorIndices(block, new_palette, new_indices);
+        if (new_error >= error)
+            break;
+
+        c0 = new_c0;
+        c1 = new_c1;
+        error = new_error;
+        memcpy(indices, new_indices, sizeof(indices));
+    }
+
+    BcnWriteColorBlock(dst, c0, c1, indices);
+}
+
+// Encode a BC1 block: blocks with pixels of alpha under 128 use the three color mode (c0 <= c1),
+// where index 3 is transparent black
+static void BcnEncodeBc1Block(const u8* block, BcnQuality quality, u8* dst)
+{
+    u32 opaque = 0;
+    for (u32 i = 0; i < 16; i++)
+        if (block[i * 4 + 3] >= 128)
+            opaque |= 1u << i;
+
+    if (opaque == 0xFFFF)
+    {
+        BcnEncodeColorBlock(block, quality, dst);
+        return;
+    }
+
+    u8 indices[16];
+    u32 c0 = 0, c1 = 0;
+
+    if (opaque != 0)
+    {
+        s32 ep0[3], ep1[3];
+        BcnColorEndpoints(block, opaque, quality, ep0, ep1);
+        c0 = BcnPack565(ep0);
+        c1 = BcnPack565(ep1);
+        if (c0 > c1)
+        {
+            u32 swap = c0; c0 = c1; c1 = swap;
+        }
+    }
+
+    s32 palette[4][3];
+    BcnColorPalette(c0, c1, false, palette);
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        indices[i] = 3;
+        if (!(opaque & (1u << i)))
+            continue;
+
+        u32 best = 0xFFFFFFFF;
+        for (u32 e = 0; e < 3; e++)
+        {
+            s32 dr = block[i * 4 + 0] - palette[e][0];
+            s32 dg = block[i * 4 + 1] - palette[e][1];
+            s32 db = block[i * 4 + 2] - palette[e][2];
+            u32 distance = (u32)(dr * dr + dg * dg + db * db);
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = (u8)e;
+            }
+        }
+    }
+
+    BcnWriteColorBlock(dst, c0, c1, indices);
+}
+
+static void BcnDecodeColorBlock(const u8* src, bool always_four_colors, u8* block)
+{
+    u32 c0 = BcnRead16(src);
+    u32 c1 = BcnRead16(src + 2);
+    u32 bits = BcnRead16(src + 4) | (BcnRead16(src + 6) << 16);
+    bool four_colors = always_four_colors || c0 > c1;
+
+    s32 palette[4][3];
+    BcnColorPalette(c0, c1, four_colors, palette);
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        u32 index = (bits >> (i * 2)) & 3;
+        for (u32 c = 0; c < 3; c++)
+            block[i * 4 + c] = (u8)palette[index][c];
+        block[i * 4 + 3] = (!four_colors && index == 3) ? 0 : 255;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Single channel blocks
+//------------------------------------------------------------------------------
+
+// Palette of a single channel block: eight values if a0 > a1, otherwise six and 0 and 255
+static void BcnChannelPalette(u32 a0, u32 a1, u32* palette)
+{
+    palette[0] = a0;
+    palette[1] = a1;
+
+    if (a0 > a1)
+    {
+        for (u32 i = 2; i < 8; i++)
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+    }
+    else
+    {
+        for (u32 i = 2; i < 6; i++)
+            palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// Indices of the nearest palette entries
+// Returns the total squared error
+static u32 BcnSelectChannelIndices(const u8* values, const u32* palette, u8* indices)
+{
+    u32 error = 0;
+
+#if defined(__SSE2__)
+
+    // All 16 values at once: the nearest entry has the smallest absolute difference, computed with
+    // saturating subtractions both ways
+    __m128i v = _mm_loadu_si128((const __m128i*)values);
+    __m128i best = _mm_set1_epi8((char)0xFF);
+    __m128i best_index = _mm_setzero_si128();
+
+    for (u32 e = 0; e < 8; e++)
+    {
+        __m128i entry = _mm_set1_epi8((char)palette[e]);
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(v, entry), _mm_subs_epu8(entry, v));
+        __m128i new_best = _mm_min_epu8(diff, best);
+        __m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(new_best, best), _mm_set1_epi8(-1));
+        best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8((char)e)), _mm_andnot_si128(closer, best_index));
+        best = new_best;
+    }
+
+    _mm_storeu_si128((__m128i*)indices, best_index);
+
+    __m128i lo = _mm_unpacklo_epi8(best, _mm_setzero_si128());
+    __m128i hi = _mm_unpackhi_epi8(best, _mm_setzero_si128());
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    error = (u32)_mm_cvtsi128_si32(sum);
+
+#else
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        u32 best = 0xFFFFFFFF;
+        for (u32 e = 0; e < 8; e++)
+        {
+            s32 diff = (s32)values[i] - (s32)palette[e];
+            u32 distance = (u32)(diff * diff);
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = (u8)e;
+            }
+        }
+        error += best;
+    }
+
+#endif // __SSE2__
+
+    return error;
+}
+
+static void BcnWriteChannelBlock(u8* dst, u32 a0, u32 a1, const u8* indices)
+{
+    u64 bits = 0;
+    for (u32 i = 0; i < 16; i++)
+        bits |= (u64)indices[i] << (i * 3);
+
+    dst[0] = (u8)a0;
+    dst[1] = (u8)a1;
+    for (u32 i = 0; i < 6; i++)
+        dst[2 + i] = (u8)(bits >> (i * 8));
+}
+
+static void BcnEncodeChannelBlock(const u8* values, BcnQuality quality, u8* dst)
+{
+    u32 min = 255, max = 0;
+    for (u32 i = 0; i < 16; i++)
+    {
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+
+    u8 indices[16];
+
+    if (min == max)
+    {
+        memset(indices, 0, sizeof(indices));
+        BcnWriteChannelBlock(dst, max, min, indices);
+        return;
+    }
+
+    if (quality == BCN_QUALITY_FAST)
+    {
+        // Nearest of the eight steps from min to max: step 7 is a0 (index 0), step 0 is a1 (index 1),
+        // and step s in between is index 8 - s
+        for (u32 i = 0; i < 16; i++)
+        {
+            u32 step = ((values[i] - min) * 14 + (max - min)) / (2 * (max - min));
+            indices[i] = (u8)(step == 7 ? 0 : step == 0 ? 1 : 8 - step);
+        }
+        BcnWriteChannelBlock(dst, max, min, indices);
+        return;
+    }
+
+    u32 palette[8];
+    BcnChannelPalette(max, min, palette);
+    u32 error = BcnSelectChannelIndices(values, palette, indices);
+    u32 a0 = max, a1 = min;
+
+    // Six value mode: 0 and 255 come for free, so the endpoints only need to span the other values
+    if (quality == BCN_QUALITY_HIGH && error > 0)
+    {
+        u32 inner_min = 255, inner_max = 0;
+        for (u32 i = 0; i < 16; i++)
+        {
+            if (values[i] == 0 || values[i] == 255)
+                continue;
+            if (values[i] < inner_min) inner_min = values[i];
+            if (values[i] > inner_max) inner_max = values[i];
+        }
+        if (inner_min > inner_max)
+            inner_min = inner_max = 0;
+
+        u32 six_palette[8];
+        u8 six_indices[16];
+        BcnChannelPalette(inner_min, inner_max, six_palette);
+        u32 six_error = BcnSelectChannelIndices(values, six_palette, six_indices);
+
+        if (six_error < error)
+        {
+            a0 = inner_min;
+            a1 = inner_max;
+            memcpy(indices, six_indices, sizeof(indices));
+        }
+    }
+
+    BcnWriteChannelBlock(dst, a0, a1, indices);
+}
+
+static void BcnDecodeChannelBlock(const u8* src, u8* values)
+{
+    u32 palette[8];
+    BcnChannelPalette(src[0], src[1], palette);
+
+    u64 bits = 0;
+    for (u32 i = 0; i < 6; i++)
+        bits |= (u64)src[2 + i] << (i * 8);
+
+    for (u32 i = 0; i < 16; i++)
+        values[i] = (u8)palette[(bits >> (i * 3)) & 7];
+}
+
+//------------------------------------------------------------------------------
+// Images
+//------------------------------------------------------------------------------
+
+static void BcnEncodeBlock(BcnFormat format, BcnQuality quality, const u8* block, u8* dst)
+{
+    u8 values[16];
+
+    switch (format)
+    {
+    case BCN_FORMAT_BC1:
+        BcnEncodeBc1Block(block, quality, dst);
+        break;
+
+    case BCN_FORMAT_BC3:
+        for (u32 i = 0; i < 16; i++)
+            values[i] = block[i * 4 + 3];
+        BcnEncodeChannelBlock(values, quality, dst);
+        BcnEncodeColorBlock(block, quality, dst + 8);
+        break;
+
+    case BCN_FORMAT_BC4:
+    case BCN_FORMAT_BC5:
+        for (u32 c = 0; c < (format == BCN_FORMAT_BC5 ? 2u : 1u); c++)
+        {
+            for (u32 i = 0; i < 16; i++)
+                values[i] = block[i * 4 + c];
+            BcnEncodeChannelBlock(values, quality, dst + c * 8);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+typedef struct BcnEncodeJob
+{
+    BcnFormat format;
+    BcnQuality quality;
+    const u8* rgba;
+    u32 width;
+    u32 height;
+    u8* dst;
+    u32 first_row;  // Rows of blocks to encode
+    u32 end_row;
+} BcnEncodeJob;
+
+static void* BcnEncodeRows(void* arg)
+{
+    const BcnEncodeJob* job = (const BcnEncodeJob*)arg;
+    u32 blocks_x = (job->width + 3) / 4;
+    u32 element_size = BcnGetElementSize(job->format);
+
+    u8 block[64];
+    for (u32 y = job->first_row; y < job->end_row; y++)
+    {
+        u8* dst = job->dst + (size_t)y * blocks_x * element_size;
+        for (u32 x = 0; x < blocks_x; x++, dst += element_size)
+        {
+            BcnLoadBlock(job->rgba, job->width, job->height, x, y, block);
+            BcnEncodeBlock(job->format, job->quality, block, dst);
+        }
+    }
+
+    return NULL;
+}
+
+void BcnEncode(BcnFormat format, BcnQuality quality, const u8* rgba, u32 width, u32 height, u8* dst, u32 num_threads)
+{
+    if (format == BCN_FORMAT_RGBA8)
+    {
+        memcpy(dst, rgba, (size_t)width * height * 4);
+        return;
+    }
+
+    u32 blocks_y = (height + 3) / 4;
+
+    if (num_threads == 0)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = processors > 0 ? (u32)processors : 1;
+    }
+    if (num_threads > blocks_y)
+        num_threads = blocks_y;
+    if (num_threads > 64)
+        num_threads = 64;
+
+    BcnEncodeJob jobs[64];
+    pthread_t threads[64];
+    bool started[64];
+
+    for (u32 i = 0; i < num_threads; i++)
+    {
+        BcnEncodeJob* job = &jobs[i];
+        job->format = format;
+        job->quality = quality;
+        job->rgba = rgba;
+        job->width = width;
+        job->height = height;
+        job->dst = dst;
+        job->first_row = blocks_y * i / num_threads;
+        job->end_row = blocks_y * (i + 1) / num_threads;
+    }
+
+    // The calling thread takes the first rows; rows of threads that fail to start are encoded afterwards
+    for (u32 i = 1; i < num_threads; i++)
+        started[i] = pthread_create(&threads[i], NULL, BcnEncodeRows, &jobs[i]) == 0;
+
+    BcnEncodeRows(&jobs[0]);
+
+    for (u32 i = 1; i < num_threads; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            BcnEncodeRows(&jobs[i]);
+    }
+}
+
+void BcnDecode(BcnFormat format, const u8* src, u32 width, u32 height, u8* rgba)
+{
+    if (format == BCN_FORMAT_RGBA8)
+    {
+        memcpy(rgba, src, (size_t)width * height * 4);
+        return;
+    }
+
+    u32 blocks_x = (width + 3) / 4;
+    u32 blocks_y = (height + 3) / 4;
+    u32 element_size = BcnGetElementSize(format);
+
+    for (u32 by = 0; by < blocks_y; by++)
+    {
+        for (u32 bx = 0; bx < blocks_x; bx++, src += element_size)
+        {
+            u8 block[64];
+            u8 values[16];
+
+            switch (format)
+            {
+            case BCN_FORMAT_BC1:
+                BcnDecodeColorBlock(src, false, block);
+                break;
+
+            case BCN_FORMAT_BC3:
+                BcnDecodeColorBlock(src + 8, true, block);
+                BcnDecodeChannelBlock(src, values);
+                for (u32 i = 0; i < 16; i++)
+                    block[i * 4 + 3] = values[i];
+                break;
+
+            default:
+                memset(block, 0, sizeof(block));
+                for (u32 c = 0; c < (format == BCN_FORMAT_BC5 ? 2u : 1u); c++)
+                {
+                    BcnDecodeChannelBlock(src + c * 8, values);
+                    for (u32 i = 0; i < 16; i++)
+                        block[i * 4 + c] = values[i];
+                }
+                for (u32 i = 0; i < 16; i++)
+                    block[i * 4 + 3] = 255;
+                break;
+            }
+
+            for (u32 y = 0; y < 4 && by * 4 + y < height; y++)
+                for (u32 x = 0; x < 4 && bx * 4 + x < width; x++)
+                    memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+        }
+    }
+}
+
+f64 BcnComputePsnr(BcnFormat format, const u8* rgba, const u8* decoded, u32 width, u32 height)
+{
+    u32 channels;
+    switch (format)
+    {
+    case BCN_FORMAT_BC1: channels = 3; break;
+    case BCN_FORMAT_BC4: channels = 1; break;
+    case BCN_FORMAT_BC5: channels = 2; break;
+    default:             channels = 4; break;
+    }
+
+    u64 error = 0;
+    size_t num_pixels = (size_t)width * height, num_measured = 0;
+    for (size_t i = 0; i < num_pixels; i++)
+    {
+        // BC1 turns pixels of alpha under 128 to transparent black: their color is not measured
+        if (format == BCN_FORMAT_BC1 && rgba[i * 4 + 3] < 128)
+            continue;
+
+        num_measured++;
+        for (u32 c = 0; c < channels; c++)
+        {
+            s32 diff = (s32)rgba[i * 4 + c] - (s32)decoded[i * 4 + c];
+            error += (u64)(diff * diff);
+        }
+    }
+
+    if (error == 0)
+        return 999.0;
+
+    f64 mse = (f64)error / ((f64)num_measured * channels);
+    return 10.0 * log10(255.0 * 255.0 / mse);
+}
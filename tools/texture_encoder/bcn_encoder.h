@@ -0,0 +1,76 @@
+// Block-compressed texture (BCn) encoder and decoder
+// Encodes RGBA8 images to BC1 (DXT1), BC3 (DXT5), BC4 (RGTC1) and BC5 (RGTC2), with the blocks of an
+// image spread over several threads, and the palette index search vectorized with SSE2 when the host
+// supports it
+// The decoder is the reference used to measure the quality (PSNR) of the encoder
+
+#ifndef BCN_ENCODER_H_
+#define BCN_ENCODER_H_
+
+#include <test_types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef enum BcnFormat
+{
+    BCN_FORMAT_RGBA8,   // Not compressed, 4 bytes per pixel
+    BCN_FORMAT_BC1,     // RGB with 1-bit alpha, 8 bytes per block
+    BCN_FORMAT_BC3,     // RGBA, 16 bytes per block
+    BCN_FORMAT_BC4,     // Red, 8 bytes per block
+    BCN_FORMAT_BC5,     // Red and green, 16 bytes per block
+    BCN_FORMAT_COUNT
+} BcnFormat;
+
+// Encoder quality levels
+// - FAST: endpoints from the bounding box of the block, indices from their projection on the endpoint axis
+// - NORMAL: endpoints from the principal axis of the block colors, indices from the nearest palette entry
+// - HIGH: NORMAL, then endpoints refined by least squares over the chosen indices (BC1 / BC3 colors),
+//         and both BC4 interpolation modes tried (alpha, BC4, BC5)
+typedef enum BcnQuality
+{
+    BCN_QUALITY_FAST,
+    BCN_QUALITY_NORMAL,
+    BCN_QUALITY_HIGH,
+    BCN_QUALITY_COUNT
+} BcnQuality;
+
+// Name of the format (e.g. "BC1") and of the quality level (e.g. "normal")
+const char* BcnGetFormatName(BcnFormat format);
+const char* BcnGetQualityName(BcnQuality quality);
+
+// Size of one element of the format in bytes (a pixel, or a 4x4 block if compressed)
+u32 BcnGetElementSize(BcnFormat format);
+
+// Size of an encoded image in bytes, with tightly packed rows of elements
+u32 BcnGetImageSize(BcnFormat format, u32 width, u32 height);
+
+// Whether the encoder uses SSE2
+bool BcnHasSimd();
+
+// Encode an image
+// Parameters:
+// - format: Format to encode to
+// - quality: Quality level
+// - rgba: Pixels, 4 bytes each (R, G, B, A), with tightly packed rows
+// - width, height: Size of the image in pixels (blocks on the edges repeat the last row and column)
+// - dst: Receives BcnGetImageSize bytes, rows of blocks from the top
+// - num_threads: Threads to spread the rows of blocks over (0 for one per processor)
+void BcnEncode(BcnFormat format, BcnQuality quality, const u8* rgba, u32 width, u32 height, u8* dst, u32 num_threads);
+
+// Decode an image (the channels a format lacks are decoded as 0 for color and 255 for alpha)
+void BcnDecode(BcnFormat format, const u8* src, u32 width, u32 height, u8* rgba);
+
+// Peak signal-to-noise ratio in dB between an image and its decoded encoding, over the channels the
+// format stores (RGB for BC1, of the pixels with alpha of 128 or more, RGBA for BC3, R for BC4,
+// RG for BC5)
+// Returns a large value (999) if the images are identical
+f64 BcnComputePsnr(BcnFormat format, const u8* rgba, const u8* decoded, u32 width, u32 height);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // BCN_ENCODER_H_
@@ -0,0 +1,646 @@
+// Command-line front end of the texture encoder
+// Encodes an image and its mip chain to BC1, BC3, BC4, BC5 (or RGBA8), lays the levels out and tiles
+// them like GX2CalcSurfaceSizeAndAlignment would, and writes a GX2 texture file (.gtx) whose image and
+// mipmap blocks are aligned in the file, so that they can be given to a GX2Surface in place
+// In benchmark mode, reports the encoder speed and quality (PSNR) at each quality level
+
+#include "bcn_encoder.h"
+#include "surface_layout.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// GFD (.gtx) file format: a file header followed by blocks; all fields are big-endian
+#define GFD_FILE_MAGIC  0x47667832  // "Gfx2"
+#define GFD_BLOCK_MAGIC 0x424C4B7B  // "BLK{"
+#define GFD_HEADER_SIZE 0x20
+
+#define GFD_BLOCK_END_OF_FILE       1
+#define GFD_BLOCK_PADDING           2
+#define GFD_BLOCK_TEXTURE_HEADER    11
+#define GFD_BLOCK_TEXTURE_IMAGE     12
+#define GFD_BLOCK_TEXTURE_MIPMAP    13
+
+// Size of a serialized GX2Texture (GX2Surface, view, component map and registers)
+#define GFD_TEXTURE_HEADER_SIZE 0x9C
+
+// Exit codes
+#define EXIT_ERROR 1
+
+// Benchmark: encode for at least this long at each quality level, and keep the fastest run
+#define BENCH_MIN_SECONDS 0.5
+
+static f64 GetTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (f64)now.tv_sec + (f64)now.tv_nsec * 1e-9;
+}
+
+static void WriteBE32(u8* p, u32 value)
+{
+    p[0] = (u8)(value >> 24);
+    p[1] = (u8)(value >> 16);
+    p[2] = (u8)(value >> 8);
+    p[3] = (u8)value;
+}
+
+//------------------------------------------------------------------------------
+// Images
+//------------------------------------------------------------------------------
+
+// Read the next header token of a PNM file (skipping whitespace and comments)
+static bool ReadPnmToken(FILE* file, char* token, u32 size)
+{
+    int c = fgetc(file);
+    for (;;)
+    {
+        while (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            c = fgetc(file);
+        if (c != '#')
+            break;
+        while (c != '\n' && c != EOF)
+            c = fgetc(file);
+    }
+
+    u32 length = 0;
+    while (c != EOF && c != ' ' && c != '\t' && c != '\r' && c != '\n')
+    {
+        if (length + 1 < size)
+            token[length++] = (char)c;
+        c = fgetc(file);
+    }
+    token[length] = '\0';
+
+    // The single whitespace after the last header token is consumed with it
+    return length > 0;
+}
+
+// Read an 8-bit binary PPM (P6, RGB) or PAM (P7, RGB or RGBA) image, as RGBA
+static u8* ReadImage(const char* path, u32* pWidth, u32* pHeight)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    char token[64];
+    u32 width = 0, height = 0, depth = 3, max_value = 0;
+    bool valid = ReadPnmToken(file, token, sizeof(token));
+
+    if (valid && strcmp(token, "P6") == 0)
+    {
+        valid = ReadPnmToken(file, token, sizeof(token));
+        width = (u32)strtoul(token, NULL, 10);
+        valid = valid && ReadPnmToken(file, token, sizeof(token));
+        height = (u32)strtoul(token, NULL, 10);
+        valid = valid && ReadPnmToken(file, token, sizeof(token));
+        max_value = (u32)strtoul(token, NULL, 10);
+    }
+    else if (valid && strcmp(token, "P7") == 0)
+    {
+        while ((valid = ReadPnmToken(file, token, sizeof(token))) && strcmp(token, "ENDHDR") != 0)
+        {
+            char value[64];
+            if (strcmp(token, "TUPLTYPE") == 0)
+                valid = ReadPnmToken(file, value, sizeof(value));
+            else if (strcmp(token, "WIDTH") == 0 && (valid = ReadPnmToken(file, value, sizeof(value))))
+                width = (u32)strtoul(value, NULL, 10);
+            else if (strcmp(token, "HEIGHT") == 0 && (valid = ReadPnmToken(file, value, sizeof(value))))
+                height = (u32)strtoul(value, NULL, 10);
+            else if (strcmp(token, "DEPTH") == 0 && (valid = ReadPnmToken(file, value, sizeof(value))))
+                depth = (u32)strtoul(value, NULL, 10);
+            else if (strcmp(token, "MAXVAL") == 0 && (valid = ReadPnmToken(file, value, sizeof(value))))
+                max_value = (u32)strtoul(value, NULL, 10);
+            if (!valid)
+                break;
+        }
+    }
+    else
+        valid = false;
+
+    u8* rgba = NULL;
+    if (valid && width > 0 && height > 0 && width <= 8192 && height <= 8192 && max_value == 255 && (depth == 3 || depth == 4))
+    {
+        size_t num_pixels = (size_t)width * height;
+        rgba = (u8*)malloc(num_pixels * 4);
+
+        if (rgba && fread(rgba, depth, num_pixels, file) == num_pixels)
+        {
+            // Spread RGB pixels to RGBA in place, from the end
+            if (depth == 3)
+            {
+                for (size_t i = num_pixels; i-- > 0;)
+                {
+                    rgba[i * 4 + 3] = 255;
+                    rgba[i * 4 + 2] = rgba[i * 3 + 2];
+                    rgba[i * 4 + 1] = rgba[i * 3 + 1];
+                    rgba[i * 4 + 0] = rgba[i * 3 + 0];
+                }
+            }
+        }
+        else
+        {
+            free(rgba);
+            rgba = NULL;
+        }
+    }
+
+    fclose(file);
+    *pWidth = width;
+    *pHeight = height;
+    return rgba;
+}
+
+// Halve an image with a box filter (the last row or column of odd sizes is averaged with the one before)
+static u8* DownsampleImage(const u8* rgba, u32 width, u32 height, u32* pWidth, u32* pHeight)
+{
+    u32 new_width = width > 1 ? width / 2 : 1;
+    u32 new_height = height > 1 ? height / 2 : 1;
+
+    u8* result = (u8*)malloc((size_t)new_width * new_height * 4);
+    if (!result)
+        return NULL;
+
+    for (u32 y = 0; y < new_height; y++)
+    {
+        u32 y0 = y * 2 < height ? y * 2 : height - 1;
+        u32 y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+
+        for (u32 x = 0; x < new_width; x++)
+        {
+            u32 x0 = x * 2 < width ? x * 2 : width - 1;
+            u32 x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+
+            for (u32 c = 0; c < 4; c++)
+            {
+                u32 sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c]
+                        + rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+                result[((size_t)y * new_width + x) * 4 + c] = (u8)((sum + 2) / 4);
+            }
+        }
+    }
+
+    *pWidth = new_width;
+    *pHeight = new_height;
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// Formats
+//------------------------------------------------------------------------------
+
+// GX2SurfaceFormat of each format
+static u32 GetSurfaceFormat(BcnFormat format)
+{
+    switch (format)
+    {
+    case BCN_FORMAT_BC1: return 0x31;   // GX2_SURFACE_FORMAT_UNORM_BC1
+    case BCN_FORMAT_BC3: return 0x33;   // GX2_SURFACE_FORMAT_UNORM_BC3
+    case BCN_FORMAT_BC4: return 0x34;   // GX2_SURFACE_FORMAT_UNORM_BC4
+    case BCN_FORMAT_BC5: return 0x35;   // GX2_SURFACE_FORMAT_UNORM_BC5
+    default:             return 0x1A;   // GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8
+    }
+}
+
+// Component selection of the texture: channels a format lacks read as 0 (color) or 1 (alpha)
+static u32 GetCompMap(BcnFormat format)
+{
+    switch (format)
+    {
+    case BCN_FORMAT_BC4: return 0x00040405; // X, 0, 0, 1
+    case BCN_FORMAT_BC5: return 0x00010405; // X, Y, 0, 1
+    default:             return 0x00010203; // X, Y, Z, W
+    }
+}
+
+static bool ParseFormat(const char* name, BcnFormat* pFormat)
+{
+    static const char* const names[BCN_FORMAT_COUNT] = { "rgba8", "bc1", "bc3", "bc4", "bc5" };
+
+    for (u32 i = 0; i < BCN_FORMAT_COUNT; i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            *pFormat = (BcnFormat)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseQuality(const char* name, BcnQuality* pQuality)
+{
+    for (u32 i = 0; i < BCN_QUALITY_COUNT; i++)
+    {
+        if (strcmp(name, BcnGetQualityName((BcnQuality)i)) == 0)
+        {
+            *pQuality = (BcnQuality)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Output files
+//------------------------------------------------------------------------------
+
+static u8* WriteGfdBlockHeader(u8* p, u32 type, u32 data_size)
+{
+    WriteBE32(p + 0, GFD_BLOCK_MAGIC);
+    WriteBE32(p + 4, GFD_HEADER_SIZE);
+    WriteBE32(p + 8, 1);            // Major version
+    WriteBE32(p + 12, 0);           // Minor version
+    WriteBE32(p + 16, type);
+    WriteBE32(p + 20, data_size);
+    WriteBE32(p + 24, 0);           // Id
+    WriteBE32(p + 28, 0);           // Index of the texture in the file
+    return p + GFD_HEADER_SIZE;
+}
+
+// Append a padding block if needed, so that the data of the next block starts at an aligned offset
+static u8* WriteGfdPadding(u8* start, u8* p, u32 alignment)
+{
+    u32 data_offset = (u32)(p - start) + GFD_HEADER_SIZE;
+    if (data_offset % alignment == 0)
+        return p;
+
+    u32 padding = (alignment - (data_offset + GFD_HEADER_SIZE) % alignment) % alignment;
+    p = WriteGfdBlockHeader(p, GFD_BLOCK_PADDING, padding);
+    memset(p, 0, padding);
+    return p + padding;
+}
+
+// Write a .gtx file: the GX2Texture header (pointers left NULL), then the image and mipmaps, each at an
+// offset aligned to the surface alignment
+static bool WriteGtx(const char* path, const SurfaceLayout* layout, BcnFormat format, const u8* image, const u8* mipmaps)
+{
+    u32 max_size = GFD_HEADER_SIZE * 8 + GFD_TEXTURE_HEADER_SIZE + layout->image_size + layout->mipmap_size + layout->alignment * 2;
+    u8* data = (u8*)calloc(1, max_size);
+    if (!data)
+        return false;
+
+    u8* p = data;
+    WriteBE32(p + 0, GFD_FILE_MAGIC);
+    WriteBE32(p + 4, GFD_HEADER_SIZE);
+    WriteBE32(p + 8, 7);            // Major version
+    WriteBE32(p + 12, 1);           // Minor version
+    WriteBE32(p + 16, 2);           // GPU version
+    WriteBE32(p + 20, 1);           // Align mode: block data is aligned in the file
+    p += GFD_HEADER_SIZE;
+
+    p = WriteGfdBlockHeader(p, GFD_BLOCK_TEXTURE_HEADER, GFD_TEXTURE_HEADER_SIZE);
+    const u32 texture[GFD_TEXTURE_HEADER_SIZE / 4] = {
+        1,                          // dim: GX2_SURFACE_DIM_TEXTURE_2D
+        layout->width,
+        layout->height,
+        1,                          // depth
+        layout->mip_levels,
+        layout->format,
+        0,                          // aa: GX2_AA_MODE1X
+        1,                          // use: GX2_SURFACE_USE_TEXTURE
+        layout->image_size,
+        0,                          // image
+        layout->mipmap_size,
+        0,                          // mipmaps
+        layout->tile_mode,
+        layout->swizzle,
+        layout->alignment,
+        layout->pitch,
+        layout->mip_level_offset[0], layout->mip_level_offset[1], layout->mip_level_offset[2],
+        layout->mip_level_offset[3], layout->mip_level_offset[4], layout->mip_level_offset[5],
+        layout->mip_level_offset[6], layout->mip_level_offset[7], layout->mip_level_offset[8],
+        layout->mip_level_offset[9], layout->mip_level_offset[10], layout->mip_level_offset[11],
+        layout->mip_level_offset[12],
+        0,                          // viewFirstMip
+        layout->mip_levels,         // viewNumMips
+        0,                          // viewFirstSlice
+        1,                          // viewNumSlices
+        GetCompMap(format),
+        0, 0, 0, 0, 0               // regs: set by GX2InitTextureRegs at load time
+    };
+    for (u32 i = 0; i < GFD_TEXTURE_HEADER_SIZE / 4; i++)
+        WriteBE32(p + i * 4, texture[i]);
+    p += GFD_TEXTURE_HEADER_SIZE;
+
+    p = WriteGfdPadding(data, p, layout->alignment);
+    p = WriteGfdBlockHeader(p, GFD_BLOCK_TEXTURE_IMAGE, layout->image_size);
+    memcpy(p, image, layout->image_size);
+    p += layout->image_size;
+
+    if (layout->mipmap_size > 0)
+    {
+        p = WriteGfdPadding(data, p, layout->alignment);
+        p = WriteGfdBlockHeader(p, GFD_BLOCK_TEXTURE_MIPMAP, layout->mipmap_size);
+        memcpy(p, mipmaps, layout->mipmap_size);
+        p += layout->mipmap_size;
+    }
+
+    p = WriteGfdBlockHeader(p, GFD_BLOCK_END_OF_FILE, 0);
+
+    FILE* file = fopen(path, "wb");
+    bool success = file && fwrite(data, 1, p - data, file) == (size_t)(p - data);
+    if (file)
+        success = fclose(file) == 0 && success;
+
+    free(data);
+    return success;
+}
+
+//------------------------------------------------------------------------------
+// Commands
+//------------------------------------------------------------------------------
+
+typedef struct Options
+{
+    BcnFormat format;
+    bool format_set;
+    BcnQuality quality;
+    u32 mip_levels;
+    SurfaceTileMode tile_mode;
+    u32 swizzle;
+    u32 num_threads;
+    bool raw;
+    bool bench;
+} Options;
+
+// Encode every level, and write them tiled to a .gtx file, or untiled to a raw file
+static int EncodeTexture(const char* input, const char* output, const u8* rgba, u32 width, u32 height, const Options* options)
+{
+    SurfaceLayout layout;
+    u32 block_size = options->format == BCN_FORMAT_RGBA8 ? 1 : 4;
+    if (!SurfaceComputeLayout(&layout, GetSurfaceFormat(options->format), BcnGetElementSize(options->format) * 8, block_size,
+                              width, height, options->mip_levels, options->tile_mode, options->swizzle))
+    {
+        fprintf(stderr, "%s: can't lay out a %ux%u surface\n", input, width, height);
+        return EXIT_ERROR;
+    }
+
+    printf("%s: %ux%u, %s (%s), %u levels, %s, swizzle %u\n", input, width, height,
+           BcnGetFormatName(options->format), BcnGetQualityName(options->quality), layout.mip_levels,
+           SurfaceGetTileModeName(layout.tile_mode), layout.swizzle >> 8);
+
+    u8* image = (u8*)calloc(1, layout.image_size);
+    u8* mipmaps = (u8*)calloc(1, layout.mipmap_size + 1);
+    u32 raw_size = 0;
+    for (u32 level = 0; level < layout.mip_levels; level++)
+        raw_size += BcnGetImageSize(options->format, width >> level ? width >> level : 1, height >> level ? height >> level : 1);
+    u8* raw = (u8*)malloc(raw_size);
+
+    if (!image || !mipmaps || !raw)
+    {
+        free(image);
+        free(mipmaps);
+        free(raw);
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_ERROR;
+    }
+
+    const u8* level_rgba = rgba;
+    u8* level_owned = NULL;
+    u32 level_width = width, level_height = height;
+    u32 raw_offset = 0;
+    u64 encoded_pixels = 0;
+    f64 encode_seconds = 0.0;
+    f64 psnr = 0.0;
+    int result = 0;
+
+    for (u32 level = 0; level < layout.mip_levels; level++)
+    {
+        if (level > 0)
+        {
+            u8* next = DownsampleImage(level_rgba, level_width, level_height, &level_width, &level_height);
+            free(level_owned);
+            level_rgba = level_owned = next;
+            if (!next)
+            {
+                fprintf(stderr, "Out of memory\n");
+                result = EXIT_ERROR;
+                break;
+            }
+        }
+
+        u8* encoded = raw + raw_offset;
+        f64 start_time = GetTime();
+        BcnEncode(options->format, options->quality, level_rgba, level_width, level_height, encoded, options->num_threads);
+        encode_seconds += GetTime() - start_time;
+        encoded_pixels += (u64)level_width * level_height;
+        raw_offset += BcnGetImageSize(options->format, level_width, level_height);
+
+        if (level == 0)
+        {
+            u8* decoded = (u8*)malloc((size_t)width * height * 4);
+            if (decoded)
+            {
+                BcnDecode(options->format, encoded, width, height, decoded);
+                psnr = BcnComputePsnr(options->format, rgba, decoded, width, height);
+                free(decoded);
+            }
+        }
+
+        const SurfaceLevel* info = &layout.levels[level];
+        SurfaceTileLevel(&layout, level, encoded, level == 0 ? image : mipmaps + info->offset);
+
+        printf("  level %2u: %4ux%-4u %s, pitch %4u, %-8s %8u bytes at 0x%X in the %s\n", level, info->width, info->height,
+               block_size == 1 ? "pixels" : "blocks", info->pitch, SurfaceGetTileModeName(info->tile_mode), info->size,
+               info->offset, level == 0 ? "image" : "mipmaps");
+    }
+
+    free(level_owned);
+
+    if (result == 0)
+    {
+        printf("Encoded %.2f MB in %.1f ms (%.0f MB/s, %s), PSNR %.2f dB (level 0)\n",
+               encoded_pixels * 4 / (1024.0 * 1024.0), encode_seconds * 1000.0,
+               encoded_pixels * 4 / (1024.0 * 1024.0) / encode_seconds, BcnHasSimd() ? "SSE2" : "scalar", psnr);
+
+        bool written;
+        if (options->raw)
+        {
+            FILE* file = fopen(output, "wb");
+            written = file && fwrite(raw, 1, raw_size, file) == raw_size;
+            if (file)
+                written = fclose(file) == 0 && written;
+            if (written)
+                printf("Wrote %s: %u bytes, levels untiled and tightly packed\n", output, raw_size);
+        }
+        else
+        {
+            written = WriteGtx(output, &layout, options->format, image, mipmaps);
+            if (written)
+                printf("Wrote %s: image %u bytes, mipmaps %u bytes, alignment %u, pitch %u\n", output,
+                       layout.image_size, layout.mipmap_size, layout.alignment, layout.pitch);
+        }
+
+        if (!written)
+        {
+            fprintf(stderr, "%s: could not write the file\n", output);
+            result = EXIT_ERROR;
+        }
+    }
+
+    free(image);
+    free(mipmaps);
+    free(raw);
+    return result;
+}
+
+// Encode one format at a quality level until BENCH_MIN_SECONDS have passed
+// Returns the best MB/s
+static f64 BenchEncode(BcnFormat format, BcnQuality quality, const u8* rgba, u32 width, u32 height, u8* encoded, u32 num_threads)
+{
+    f64 best_seconds = 1e30, total_seconds = 0.0;
+    for (u32 run = 0; run < 3 || total_seconds < BENCH_MIN_SECONDS; run++)
+    {
+        f64 start_time = GetTime();
+        BcnEncode(format, quality, rgba, width, height, encoded, num_threads);
+        f64 seconds = GetTime() - start_time;
+
+        total_seconds += seconds;
+        if (seconds < best_seconds)
+            best_seconds = seconds;
+    }
+
+    return (f64)width * height * 4 / (1024.0 * 1024.0) / best_seconds;
+}
+
+static int BenchTexture(const char* input, const u8* rgba, u32 width, u32 height, const Options* options)
+{
+    u8* encoded = (u8*)malloc((size_t)width * height * 4);
+    u8* decoded = (u8*)malloc((size_t)width * height * 4);
+    if (!encoded || !decoded)
+    {
+        free(encoded);
+        free(decoded);
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_ERROR;
+    }
+
+    printf("%s: %ux%u (%.2f MB of RGBA8), %s, speed of the fastest run over %.1f s\n", input, width, height,
+           width * height * 4 / (1024.0 * 1024.0), BcnHasSimd() ? "SSE2" : "scalar", BENCH_MIN_SECONDS);
+
+    for (u32 format = BCN_FORMAT_BC1; format < BCN_FORMAT_COUNT; format++)
+    {
+        if (options->format_set && format != options->format)
+            continue;
+
+        for (u32 quality = 0; quality < BCN_QUALITY_COUNT; quality++)
+        {
+            f64 single_mb_per_s = BenchEncode((BcnFormat)format, (BcnQuality)quality, rgba, width, height, encoded, 1);
+            f64 mb_per_s = BenchEncode((BcnFormat)format, (BcnQuality)quality, rgba, width, height, encoded, options->num_threads);
+
+            BcnDecode((BcnFormat)format, encoded, width, height, decoded);
+            f64 psnr = BcnComputePsnr((BcnFormat)format, rgba, decoded, width, height);
+
+            printf("  %s %-6s: %7.1f MB/s on 1 thread, %7.1f MB/s on all threads, PSNR %6.2f dB\n",
+                   BcnGetFormatName((BcnFormat)format), BcnGetQualityName((BcnQuality)quality),
+                   single_mb_per_s, mb_per_s, psnr);
+        }
+    }
+
+    free(encoded);
+    free(decoded);
+    return 0;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "Usage: texture_encoder [options] <image> [output]\n"
+        "Encodes an 8-bit binary PPM (P6) or PAM (P7, RGB or RGBA) image and its mip chain to a GX2 texture\n"
+        "file (.gtx), with the levels laid out and tiled like GX2CalcSurfaceSizeAndAlignment does\n"
+        "Options:\n"
+        "  -f rgba8|bc1|bc3|bc4|bc5  Format (default bc1)\n"
+        "  -q fast|normal|high       Quality (default normal)\n"
+        "  -m <n>                    Number of levels (default: the full chain, down to 1x1)\n"
+        "  -t linear|1d|2d           Tile mode (default 2d)\n"
+        "  -s <0-7>                  Bank and pipe swizzle of 2D tiled levels (default 0)\n"
+        "  -j <n>                    Encoder threads (default: one per processor)\n"
+        "  -r                        Write the levels untiled and tightly packed, level 0 first, instead\n"
+        "                            of a .gtx file (the layout texture streaming reads)\n"
+        "  -b                        Benchmark: encode the image at each quality level (in the format of\n"
+        "                            -f, or in every compressed format) and report MB/s and PSNR\n"
+        "Exit code: 0 on success, 1 on errors\n"
+    );
+}
+
+int main(int argc, char** argv)
+{
+    Options options = { BCN_FORMAT_BC1, false, BCN_QUALITY_NORMAL, 0, SURFACE_TILE_MODE_TILED_2D_THIN1, 0, 0, false, false };
+    const char* input = NULL;
+    const char* output = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool valid = true;
+
+        if (strcmp(arg, "-f") == 0 && has_value)
+            valid = options.format_set = ParseFormat(argv[++i], &options.format);
+        else if (strcmp(arg, "-q") == 0 && has_value)
+            valid = ParseQuality(argv[++i], &options.quality);
+        else if (strcmp(arg, "-m") == 0 && has_value)
+            options.mip_levels = (u32)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(arg, "-t") == 0 && has_value)
+        {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "linear") == 0)
+                options.tile_mode = SURFACE_TILE_MODE_LINEAR_ALIGNED;
+            else if (strcmp(mode, "1d") == 0)
+                options.tile_mode = SURFACE_TILE_MODE_TILED_1D_THIN1;
+            else if (strcmp(mode, "2d") == 0)
+                options.tile_mode = SURFACE_TILE_MODE_TILED_2D_THIN1;
+            else
+                valid = false;
+        }
+        else if (strcmp(arg, "-s") == 0 && has_value)
+        {
+            options.swizzle = (u32)strtoul(argv[++i], NULL, 0);
+            valid = options.swizzle <= 7;
+        }
+        else if (strcmp(arg, "-j") == 0 && has_value)
+            options.num_threads = (u32)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(arg, "-r") == 0)
+            options.raw = true;
+        else if (strcmp(arg, "-b") == 0)
+            options.bench = true;
+        else if (arg[0] == '-')
+            valid = false;
+        else if (!input)
+            input = arg;
+        else if (!output)
+            output = arg;
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            PrintUsage();
+            return EXIT_ERROR;
+        }
+    }
+
+    if (!input || (!output && !options.bench))
+    {
+        PrintUsage();
+        return EXIT_ERROR;
+    }
+
+    u32 width, height;
+    u8* rgba = ReadImage(input, &width, &height);
+    if (!rgba)
+    {
+        fprintf(stderr, "%s: could not read the image (8-bit binary PPM or PAM, up to 8192x8192)\n", input);
+        return EXIT_ERROR;
+    }
+
+    int result = options.bench
+        ? BenchTexture(input, rgba, width, height, &options)
+        : EncodeTexture(input, output, rgba, width, height, &options);
+
+    free(rgba);
+    return result;
+}
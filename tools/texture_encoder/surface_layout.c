@@ -0,0 +1,270 @@
+// GX2 surface layout and tiling
+// Wii U GPU configuration: 2 pipes, 4 banks, 256-byte pipe interleave
+// - Micro tiles are 8x8 elements; within one, the element order interleaves the bits of x and y
+//   depending on the element size
+// - 1D tiled: micro tiles follow each other in rows
+// - 2D tiled: macro tiles of 32x16 elements (4x2 micro tiles) follow each other in rows, and each of
+//   their micro tiles goes to a different pipe and bank; the address interleaves 256 bytes of one
+//   micro tile, the pipe bit and the bank bits. The swizzle is XORed into the pipe and bank, so that
+//   surfaces with different swizzles spread over different banks
+
+#include "surface_layout.h"
+
+#define SURFACE_PIPES               2
+#define SURFACE_BANKS               4
+#define SURFACE_PIPE_INTERLEAVE     256
+#define SURFACE_MICRO_TILE_SIZE     8
+#define SURFACE_MACRO_TILE_WIDTH    (SURFACE_MICRO_TILE_SIZE * SURFACE_BANKS)   // 32
+#define SURFACE_MACRO_TILE_HEIGHT   (SURFACE_MICRO_TILE_SIZE * SURFACE_PIPES)   // 16
+
+static u32 SurfaceNextPow2(u32 value)
+{
+    u32 result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+static u32 SurfaceAlign(u32 value, u32 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+const char* SurfaceGetTileModeName(SurfaceTileMode tile_mode)
+{
+    switch (tile_mode)
+    {
+    case SURFACE_TILE_MODE_LINEAR_ALIGNED: return "linear";
+    case SURFACE_TILE_MODE_TILED_1D_THIN1: return "1D tiled";
+    case SURFACE_TILE_MODE_TILED_2D_THIN1: return "2D tiled";
+    }
+    return "?";
+}
+
+// Tile mode of a level: levels past 0 of a 2D tiled surface drop to 1D tiling once they are smaller
+// than a macro tile (wider for small elements, so that a row of micro tiles fills a pipe interleave)
+static SurfaceTileMode SurfaceGetLevelTileMode(SurfaceTileMode tile_mode, u32 element_bits, u32 level, u32 width, u32 height)
+{
+    if (level == 0 || tile_mode != SURFACE_TILE_MODE_TILED_2D_THIN1)
+        return tile_mode;
+
+    u32 micro_tile_bytes = element_bits * SURFACE_MICRO_TILE_SIZE * SURFACE_MICRO_TILE_SIZE / 8;
+    u32 width_align_factor = micro_tile_bytes < SURFACE_PIPE_INTERLEAVE ? SURFACE_PIPE_INTERLEAVE / micro_tile_bytes : 1;
+
+    if (SurfaceNextPow2(width) < width_align_factor * SURFACE_MACRO_TILE_WIDTH || SurfaceNextPow2(height) < SURFACE_MACRO_TILE_HEIGHT)
+        return SURFACE_TILE_MODE_TILED_1D_THIN1;
+
+    return tile_mode;
+}
+
+// Base, pitch and height alignments of a level
+static void SurfaceGetAlignments(SurfaceTileMode tile_mode, u32 element_bits, u32* pBaseAlign, u32* pPitchAlign, u32* pHeightAlign)
+{
+    switch (tile_mode)
+    {
+    case SURFACE_TILE_MODE_LINEAR_ALIGNED:
+    {
+        u32 pitch_align = SURFACE_PIPE_INTERLEAVE * 8 / element_bits;
+        *pBaseAlign = SURFACE_PIPE_INTERLEAVE;
+        *pPitchAlign = pitch_align > 64 ? pitch_align : 64;
+        *pHeightAlign = 1;
+        break;
+    }
+
+    case SURFACE_TILE_MODE_TILED_1D_THIN1:
+    {
+        u32 pitch_align = SURFACE_PIPE_INTERLEAVE / element_bits;
+        *pBaseAlign = SURFACE_PIPE_INTERLEAVE;
+        *pPitchAlign = pitch_align > SURFACE_MICRO_TILE_SIZE ? pitch_align : SURFACE_MICRO_TILE_SIZE;
+        *pHeightAlign = SURFACE_MICRO_TILE_SIZE;
+        break;
+    }
+
+    case SURFACE_TILE_MODE_TILED_2D_THIN1:
+    {
+        u32 pitch_align = SURFACE_MACRO_TILE_WIDTH * (SURFACE_PIPE_INTERLEAVE / element_bits / 8);
+        if (pitch_align < SURFACE_MACRO_TILE_WIDTH)
+            pitch_align = SURFACE_MACRO_TILE_WIDTH;
+
+        u32 macro_tile_bytes = element_bits * SURFACE_MACRO_TILE_WIDTH * SURFACE_MACRO_TILE_HEIGHT / 8;
+        u32 row_bytes = element_bits * pitch_align * SURFACE_MACRO_TILE_HEIGHT / 8;
+
+        *pBaseAlign = macro_tile_bytes > row_bytes ? macro_tile_bytes : row_bytes;
+        *pPitchAlign = pitch_align;
+        *pHeightAlign = SURFACE_MACRO_TILE_HEIGHT;
+        break;
+    }
+    }
+}
+
+bool SurfaceComputeLayout(SurfaceLayout* pLayout, u32 format, u32 element_bits, u32 block_size, u32 width, u32 height, u32 mip_levels, SurfaceTileMode tile_mode, u32 swizzle)
+{
+    if (width == 0 || height == 0 || (block_size != 1 && block_size != 4) || swizzle > 7)
+        return false;
+    if (element_bits != 8 && element_bits != 16 && element_bits != 32 && element_bits != 64 && element_bits != 128)
+        return false;
+    if (tile_mode != SURFACE_TILE_MODE_LINEAR_ALIGNED && tile_mode != SURFACE_TILE_MODE_TILED_1D_THIN1 && tile_mode != SURFACE_TILE_MODE_TILED_2D_THIN1)
+        return false;
+
+    u32 largest = width > height ? width : height;
+    u32 max_levels = 1;
+    while ((largest >> max_levels) != 0)
+        max_levels++;
+
+    if (max_levels > SURFACE_MAX_LEVELS)
+        return false;
+    if (mip_levels == 0 || mip_levels > max_levels)
+        mip_levels = max_levels;
+
+    SurfaceLayout* layout = pLayout;
+    *layout = (SurfaceLayout){ 0 };
+    layout->format = format;
+    layout->width = width;
+    layout->height = height;
+    layout->mip_levels = mip_levels;
+    layout->tile_mode = tile_mode;
+    layout->swizzle = tile_mode == SURFACE_TILE_MODE_TILED_2D_THIN1 ? swizzle << 8 : 0;
+    layout->element_bits = element_bits;
+    layout->block_size = block_size;
+
+    for (u32 level = 0; level < mip_levels; level++)
+    {
+        SurfaceLevel* info = &layout->levels[level];
+
+        u32 level_width = width >> level ? width >> level : 1;
+        u32 level_height = height >> level ? height >> level : 1;
+        info->width = (level_width + block_size - 1) / block_size;
+        info->height = (level_height + block_size - 1) / block_size;
+
+        // Levels past 0 are padded to powers of two (compressed ones in pixels, before counting blocks)
+        u32 pitch = info->width, padded_height = info->height;
+        if (level > 0)
+        {
+            pitch = (SurfaceNextPow2(level_width) + block_size - 1) / block_size;
+            padded_height = (SurfaceNextPow2(level_height) + block_size - 1) / block_size;
+        }
+
+        info->tile_mode = SurfaceGetLevelTileMode(tile_mode, element_bits, level, pitch, padded_height);
+
+        if (level > 0)
+        {
+            pitch = SurfaceNextPow2(pitch);
+            padded_height = SurfaceNextPow2(padded_height);
+        }
+
+        u32 base_align, pitch_align, height_align;
+        SurfaceGetAlignments(info->tile_mode, element_bits, &base_align, &pitch_align, &height_align);
+
+        info->pitch = SurfaceAlign(pitch, pitch_align);
+        info->padded_height = SurfaceAlign(padded_height, height_align);
+        info->size = info->pitch * info->padded_height * element_bits / 8;
+
+        if (level == 0)
+        {
+            layout->image_size = info->size;
+            layout->alignment = base_align;
+            layout->pitch = info->pitch;
+            info->offset = 0;
+        }
+        else
+        {
+            info->offset = SurfaceAlign(layout->mipmap_size, base_align);
+            if (level == 1)
+                layout->mip_level_offset[0] = SurfaceAlign(layout->image_size, base_align);
+            else
+                layout->mip_level_offset[level - 1] = info->offset;
+            layout->mipmap_size = info->offset + info->size;
+        }
+    }
+
+    return true;
+}
+
+// Index of an element within its micro tile
+static u32 SurfaceGetMicroTileIndex(u32 x, u32 y, u32 element_bits)
+{
+    u32 x0 = x & 1, x1 = (x >> 1) & 1, x2 = (x >> 2) & 1;
+    u32 y0 = y & 1, y1 = (y >> 1) & 1, y2 = (y >> 2) & 1;
+
+    switch (element_bits)
+    {
+    case 8:   return x0 | (x1 << 1) | (x2 << 2) | (y1 << 3) | (y0 << 4) | (y2 << 5);
+    case 16:  return x0 | (x1 << 1) | (x2 << 2) | (y0 << 3) | (y1 << 4) | (y2 << 5);
+    case 32:  return x0 | (x1 << 1) | (y0 << 2) | (x2 << 3) | (y1 << 4) | (y2 << 5);
+    case 64:  return x0 | (y0 << 1) | (x1 << 2) | (x2 << 3) | (y1 << 4) | (y2 << 5);
+    default:  return y0 | (x0 << 1) | (x1 << 2) | (x2 << 3) | (y1 << 4) | (y2 << 5);
+    }
+}
+
+u32 SurfaceGetElementOffset(const SurfaceLayout* layout, u32 level, u32 x, u32 y)
+{
+    const SurfaceLevel* info = &layout->levels[level];
+    u32 element_bits = layout->element_bits;
+
+    if (info->tile_mode == SURFACE_TILE_MODE_LINEAR_ALIGNED)
+        return (y * info->pitch + x) * element_bits / 8;
+
+    u32 element_offset = SurfaceGetMicroTileIndex(x, y, element_bits) * element_bits / 8;
+
+    if (info->tile_mode == SURFACE_TILE_MODE_TILED_1D_THIN1)
+    {
+        u32 micro_tile_bytes = element_bits * SURFACE_MICRO_TILE_SIZE * SURFACE_MICRO_TILE_SIZE / 8;
+        u32 micro_tiles_per_row = info->pitch / SURFACE_MICRO_TILE_SIZE;
+        u32 micro_tile_index = x / SURFACE_MICRO_TILE_SIZE + (y / SURFACE_MICRO_TILE_SIZE) * micro_tiles_per_row;
+        return micro_tile_index * micro_tile_bytes + element_offset;
+    }
+
+    // Pipe and bank of the micro tile, then the swizzle
+    u32 pipe = ((y >> 3) ^ (x >> 3)) & 1;
+    u32 bank = (((y >> 5) ^ (x >> 3)) & 1) | ((((y >> 4) ^ (x >> 4)) & 1) << 1);
+
+    u32 pipe_swizzle = (layout->swizzle >> 8) & 1;
+    u32 bank_swizzle = (layout->swizzle >> 9) & 3;
+    u32 bank_pipe = ((pipe + SURFACE_PIPES * bank) ^ (pipe_swizzle + SURFACE_PIPES * bank_swizzle)) % (SURFACE_PIPES * SURFACE_BANKS);
+    pipe = bank_pipe % SURFACE_PIPES;
+    bank = bank_pipe / SURFACE_PIPES;
+
+    // Offset within the pipe and bank: the macro tiles before this one hold an eighth of their bytes
+    // in each pipe and bank
+    u32 macro_tile_bytes = element_bits * SURFACE_MACRO_TILE_WIDTH * SURFACE_MACRO_TILE_HEIGHT / 8;
+    u32 macro_tiles_per_row = info->pitch / SURFACE_MACRO_TILE_WIDTH;
+    u32 macro_tile_index = x / SURFACE_MACRO_TILE_WIDTH + (y / SURFACE_MACRO_TILE_HEIGHT) * macro_tiles_per_row;
+    u32 offset = element_offset + macro_tile_index * macro_tile_bytes / (SURFACE_PIPES * SURFACE_BANKS);
+
+    // Low 8 bits, then the pipe bit, then the 2 bank bits, then the rest
+    u32 offset_low = offset & (SURFACE_PIPE_INTERLEAVE - 1);
+    u32 offset_high = (offset & ~(SURFACE_PIPE_INTERLEAVE - 1)) << 3;
+    return offset_high | (bank << 9) | (pipe << 8) | offset_low;
+}
+
+void SurfaceTileLevel(const SurfaceLayout* layout, u32 level, const u8* src, u8* dst)
+{
+    const SurfaceLevel* info = &layout->levels[level];
+    u32 element_size = layout->element_bits / 8;
+
+    for (u32 y = 0; y < info->height; y++)
+    {
+        for (u32 x = 0; x < info->width; x++, src += element_size)
+        {
+            u8* element = dst + SurfaceGetElementOffset(layout, level, x, y);
+            for (u32 i = 0; i < element_size; i++)
+                element[i] = src[i];
+        }
+    }
+}
+
+void SurfaceUntileLevel(const SurfaceLayout* layout, u32 level, const u8* src, u8* dst)
+{
+    const SurfaceLevel* info = &layout->levels[level];
+    u32 element_size = layout->element_bits / 8;
+
+    for (u32 y = 0; y < info->height; y++)
+    {
+        for (u32 x = 0; x < info->width; x++, dst += element_size)
+        {
+            const u8* element = src + SurfaceGetElementOffset(layout, level, x, y);
+            for (u32 i = 0; i < element_size; i++)
+                dst[i] = element[i];
+        }
+    }
+}
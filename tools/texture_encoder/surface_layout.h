@@ -0,0 +1,97 @@
+// GX2 surface layout and tiling
+// Computes the layout GX2CalcSurfaceSizeAndAlignment gives a single-sampled 2D texture (the rules of the
+// R600 address library the Wii U GPU uses): the tile mode, pitch, padded height and alignment of each
+// level, the image and mipmap sizes and the mip level offsets
+// Then places the elements of each level at their tiled address, so that the image and mipmap buffers
+// can be given to a GX2Surface with the same layout as they are
+// Only the thin tile modes textures use are supported: linear aligned, 1D tiled and 2D tiled
+
+#ifndef SURFACE_LAYOUT_H_
+#define SURFACE_LAYOUT_H_
+
+#include <test_types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Most levels a surface can have (8192x8192)
+#define SURFACE_MAX_LEVELS 14
+
+// Tile modes (values of GX2TileMode)
+typedef enum SurfaceTileMode
+{
+    SURFACE_TILE_MODE_LINEAR_ALIGNED = 1,
+    SURFACE_TILE_MODE_TILED_1D_THIN1 = 2,
+    SURFACE_TILE_MODE_TILED_2D_THIN1 = 4
+} SurfaceTileMode;
+
+typedef struct SurfaceLevel
+{
+    u32 width;                  // Size in elements (pixels, or 4x4 blocks if compressed)
+    u32 height;
+    u32 pitch;                  // Padded size in elements
+    u32 padded_height;
+    SurfaceTileMode tile_mode;  // Level 0 keeps the surface's; small levels of 2D tiled surfaces are 1D tiled
+    u32 offset;                 // Offset of the level in the image (level 0) or in the mipmaps (other levels)
+    u32 size;                   // Size of the level in bytes
+} SurfaceLevel;
+
+typedef struct SurfaceLayout
+{
+    // Fields of the GX2Surface
+    u32 format;                 // GX2SurfaceFormat
+    u32 width;                  // Size of level 0 in pixels
+    u32 height;
+    u32 mip_levels;
+    SurfaceTileMode tile_mode;
+    u32 swizzle;                // Bank and pipe swizzle in bits 8-10 (as set by GX2SetSurfaceSwizzle)
+    u32 image_size;
+    u32 mipmap_size;
+    u32 alignment;
+    u32 pitch;                  // Pitch of level 0 in elements
+    u32 mip_level_offset[13];   // [0]: offset of the mipmaps from the image, [n]: offset of level n + 1 in the mipmaps
+
+    // Layout of each level
+    u32 element_bits;           // Bits per element
+    u32 block_size;             // Pixels per element along each dimension (1, or 4 if compressed)
+    SurfaceLevel levels[SURFACE_MAX_LEVELS];
+} SurfaceLayout;
+
+// Compute the layout of a surface
+// Parameters:
+// - pLayout: Output layout
+// - format: GX2SurfaceFormat value (only stored in the layout)
+// - element_bits: Bits per element (e.g. 32 for RGBA8, 64 for BC1)
+// - block_size: Pixels per element along each dimension (1, or 4 if compressed)
+// - width, height: Size of level 0 in pixels
+// - mip_levels: Number of levels (clamped to the full chain)
+// - tile_mode: Tile mode of the surface
+// - swizzle: Bank and pipe swizzle (0-7) of 2D tiled levels
+// Returns false if the parameters are invalid
+bool SurfaceComputeLayout(SurfaceLayout* pLayout, u32 format, u32 element_bits, u32 block_size, u32 width, u32 height, u32 mip_levels, SurfaceTileMode tile_mode, u32 swizzle);
+
+// Byte offset of an element (x, y) of a level, from the start of the level
+u32 SurfaceGetElementOffset(const SurfaceLayout* layout, u32 level, u32 x, u32 y);
+
+// Place the elements of a level at their tiled addresses
+// Parameters:
+// - layout: Layout of the surface
+// - level: Level
+// - src: Elements of the level, with tightly packed rows
+// - dst: Start of the level (image, or mipmaps + levels[level].offset), levels[level].size bytes
+//        (padding is left untouched)
+void SurfaceTileLevel(const SurfaceLayout* layout, u32 level, const u8* src, u8* dst);
+
+// Gather the elements of a level from their tiled addresses, with tightly packed rows
+void SurfaceUntileLevel(const SurfaceLayout* layout, u32 level, const u8* src, u8* dst);
+
+// Name of a tile mode (e.g. "2D tiled")
+const char* SurfaceGetTileModeName(SurfaceTileMode tile_mode);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // SURFACE_LAYOUT_H_
@@ -0,0 +1,566 @@
+// Asset packs
+
+#include "asset_pack.h"
+#include "coherency.h"
+#include "format.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+// Packs are mapped where mmap is available
+#ifndef _WIN32
+#define WINDOW_ASSET_PACK_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#else // TEST_GX2
+
+#include <coreinit/memdefaultheap.h>
+#include <gx2/mem.h>
+#include <gx2/shaders.h>
+#include <gx2/texture.h>
+
+// Audits the GX2 calls of this file when built with WINDOW_COHERENCY
+#include "coherency_calls.h"
+
+// Most attributes of a fetch shader
+#define WINDOW_ASSET_PACK_MAX_ATTRIBS 32
+
+// The GX2FetchShader is built in the space the template reserves for it
+typedef char WindowAssetPackFetchShaderFits[sizeof(GX2FetchShader) <= WINDOW_PACK_FETCH_SHADER_SIZE ? 1 : -1];
+
+#endif
+
+struct WindowAssetPack
+{
+    u8* data;
+    const WindowPackHeader* header;
+    const WindowPackEntry* entries;
+    const u32* slots;
+    const char* names;
+#ifdef TEST_WIN
+    u32* textures;          // Texture object of each entry
+#else
+    void** programs;        // Fetch shader programs allocated at load time, when the reserved space
+                            // was too small (one per entry)
+#endif
+    WindowAssetPackStats stats;
+};
+
+//------------------------------------------------------------------------------
+// Reading
+//------------------------------------------------------------------------------
+
+static bool WindowAssetPackCheckHeader(const WindowPackHeader* header, u32 file_size)
+{
+    if (header->magic != WINDOW_PACK_MAGIC || header->version != WINDOW_PACK_VERSION)
+        return false;
+
+#ifdef TEST_WIN
+    if (header->platform != WINDOW_PACK_PLATFORM_PC)
+        return false;
+#else
+    if (header->platform != WINDOW_PACK_PLATFORM_WIIU)
+        return false;
+#endif
+
+    if (header->size != file_size || header->size < sizeof(WindowPackHeader))
+        return false;
+
+    // Sections within the pack, and a power of two of slots
+    u32 size = header->size;
+    if (header->entries_offset > size || header->num_entries > (size - header->entries_offset) / sizeof(WindowPackEntry))
+        return false;
+    if (header->slots_offset > size || header->num_slots > (size - header->slots_offset) / sizeof(u32))
+        return false;
+    if (header->fixups_offset > size || header->num_fixups > (size - header->fixups_offset) / sizeof(u32))
+        return false;
+    if (header->names_offset > size || header->num_slots == 0 || (header->num_slots & (header->num_slots - 1)) != 0)
+        return false;
+    if (header->alignment == 0 || (header->alignment & (header->alignment - 1)) != 0)
+        return false;
+
+    return true;
+}
+
+#ifdef WINDOW_ASSET_PACK_MMAP
+
+static u8* WindowAssetPackMap(const char* path, u32* pSize)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(WindowPackHeader) || st.st_size > 0x7FFFFFFF)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // Private and writable, so that the fixups (if any) only touch the pages they relocate
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    *pSize = (u32)st.st_size;
+    return (u8*)data;
+}
+
+#endif // WINDOW_ASSET_PACK_MMAP
+
+// Read the whole pack in one read, into memory aligned to the alignment of the pack
+static u8* WindowAssetPackRead(const char* path, u32* pSize)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    // The header gives the size and alignment to allocate
+    WindowPackHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != WINDOW_PACK_MAGIC ||
+        header.size < sizeof(header) || header.alignment == 0 || fseek(file, 0, SEEK_SET) != 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+#ifdef TEST_WIN
+    u8* data = (u8*)malloc(header.size);
+#else
+    u8* data = (u8*)MEMAllocFromDefaultHeapEx(header.size, header.alignment);
+#endif
+    if (!data)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    if (fread(data, 1, header.size, file) != header.size)
+    {
+#ifdef TEST_WIN
+        free(data);
+#else
+        MEMFreeToDefaultHeap(data);
+#endif
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *pSize = header.size;
+    return data;
+}
+
+static void WindowAssetPackRelease(WindowAssetPack* pack)
+{
+    if (!pack->data)
+        return;
+
+    COHERENCY_FORGET(pack->data, pack->stats.size);
+
+#ifdef WINDOW_ASSET_PACK_MMAP
+    if (pack->stats.mapped)
+    {
+        munmap(pack->data, pack->stats.size);
+        return;
+    }
+#endif // WINDOW_ASSET_PACK_MMAP
+
+#ifdef TEST_WIN
+    free(pack->data);
+#else
+    MEMFreeToDefaultHeap(pack->data);
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Preparing the assets
+//------------------------------------------------------------------------------
+
+#ifdef TEST_WIN
+
+static void WindowAssetPackCreateTexture(WindowAssetPack* pack, u32 index)
+{
+    const WindowPackEntry* entry = &pack->entries[index];
+    const WindowPackTexture* header = (const WindowPackTexture*)(pack->data + entry->offset);
+
+    WindowTextureFormat format = (WindowTextureFormat)header->format;
+    if (format >= WINDOW_TEXTURE_FORMAT_COUNT || !WindowIsTextureFormatSupported(format) ||
+        header->levels == 0 || header->levels > WINDOW_PACK_MAX_LEVELS)
+        return;
+
+    u32 internal_format, gl_format, type;
+    WindowTextureFormatGetGL(format, &internal_format, &gl_format, &type);
+
+    glGenTextures(1, &pack->textures[index]);
+    glBindTexture(GL_TEXTURE_2D, pack->textures[index]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header->levels - 1);
+
+    for (u32 level = 0; level < header->levels; level++)
+    {
+        u32 width = header->width >> level ? header->width >> level : 1;
+        u32 height = header->height >> level ? header->height >> level : 1;
+        const u8* data = (const u8*)header + header->level_offsets[level];
+
+        if (WindowTextureFormatIsCompressed(format))
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height, 0, header->level_sizes[level], data);
+        else
+            glTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height, 0, gl_format, type, data);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, GL_NONE);
+}
+
+#else // TEST_GX2
+
+static void WindowAssetPackInitFetchShader(WindowAssetPack* pack, u32 index)
+{
+    const WindowPackEntry* entry = &pack->entries[index];
+    WindowPackFetchShader* fetch = (WindowPackFetchShader*)(pack->data + entry->offset);
+    const WindowPackAttrib* attribs = (const WindowPackAttrib*)(fetch + 1);
+
+    if (fetch->num_attribs > WINDOW_ASSET_PACK_MAX_ATTRIBS ||
+        entry->size < sizeof(WindowPackFetchShader) + fetch->num_attribs * sizeof(WindowPackAttrib))
+        return;
+
+    GX2AttribStream streams[WINDOW_ASSET_PACK_MAX_ATTRIBS];
+    for (u32 i = 0; i < fetch->num_attribs; i++)
+    {
+        GX2AttribStream* stream = &streams[i];
+        stream->location = attribs[i].location;
+        stream->buffer = attribs[i].buffer;
+        stream->offset = attribs[i].offset;
+        stream->type = GX2_ATTRIB_INDEX_PER_VERTEX;
+        stream->aluDivisor = 0;
+        stream->endianSwap = GX2_ENDIAN_SWAP_DEFAULT;
+
+        switch (attribs[i].format)
+        {
+        case WINDOW_PACK_ATTRIB_FLOAT1:
+            stream->format = GX2_ATTRIB_FORMAT_FLOAT_32;
+            stream->mask = GX2_SEL_MASK(GX2_SQ_SEL_X, GX2_SQ_SEL_0, GX2_SQ_SEL_0, GX2_SQ_SEL_1);
+            break;
+        case WINDOW_PACK_ATTRIB_FLOAT2:
+            stream->format = GX2_ATTRIB_FORMAT_FLOAT_32_32;
+            stream->mask = GX2_SEL_MASK(GX2_SQ_SEL_X, GX2_SQ_SEL_Y, GX2_SQ_SEL_0, GX2_SQ_SEL_1);
+            break;
+        case WINDOW_PACK_ATTRIB_FLOAT3:
+            stream->format = GX2_ATTRIB_FORMAT_FLOAT_32_32_32;
+            stream->mask = GX2_SEL_MASK(GX2_SQ_SEL_X, GX2_SQ_SEL_Y, GX2_SQ_SEL_Z, GX2_SQ_SEL_1);
+            break;
+        case WINDOW_PACK_ATTRIB_FLOAT4:
+            stream->format = GX2_ATTRIB_FORMAT_FLOAT_32_32_32_32;
+            stream->mask = GX2_SEL_MASK(GX2_SQ_SEL_X, GX2_SQ_SEL_Y, GX2_SQ_SEL_Z, GX2_SQ_SEL_W);
+            break;
+        default:
+            stream->format = GX2_ATTRIB_FORMAT_UNORM_8_8_8_8;
+            stream->mask = GX2_SEL_MASK(GX2_SQ_SEL_X, GX2_SQ_SEL_Y, GX2_SQ_SEL_Z, GX2_SQ_SEL_W);
+            break;
+        }
+    }
+
+    // The packer reserves an upper bound of the program size; should the GX2 library need more,
+    // the program is allocated instead
+    u8* program = (u8*)(uintptr_t)fetch->program;
+    u32 program_size = GX2CalcFetchShaderSizeEx(fetch->num_attribs, GX2_FETCH_SHADER_TESSELLATION_NONE, GX2_TESSELLATION_MODE_DISCRETE);
+    if (program_size > fetch->program_size || !program)
+    {
+        program = (u8*)MEMAllocFromDefaultHeapEx(program_size, GX2_SHADER_PROGRAM_ALIGNMENT);
+        if (!program)
+            return;
+
+        pack->programs[index] = program;
+    }
+
+    GX2InitFetchShaderEx((GX2FetchShader*)fetch->shader, program, fetch->num_attribs, streams,
+                         GX2_FETCH_SHADER_TESSELLATION_NONE, GX2_TESSELLATION_MODE_DISCRETE);
+
+    // Programs outside of the pack are not covered by the invalidation of the pack
+    if (pack->programs[index])
+        GX2Invalidate(GX2_INVALIDATE_MODE_CPU_SHADER, program, program_size);
+}
+
+#endif
+
+// Relocate the pointers, then prepare the assets that need it
+static bool WindowAssetPackPrepare(WindowAssetPack* pack)
+{
+    const WindowPackHeader* header = pack->header;
+
+#ifdef TEST_WIN
+    // Pointers are 64-bit on PC, so PC packs only use offsets
+    if (header->num_fixups > 0)
+        return false;
+#endif
+
+    // The pack was just read (or mapped), and the fixups below write to it
+    COHERENCY_ALLOC(pack->data, header->size);
+
+    const u32* fixups = (const u32*)(pack->data + header->fixups_offset);
+    for (u32 i = 0; i < header->num_fixups; i++)
+    {
+        if (fixups[i] > header->size - 4 || (fixups[i] & 3) != 0)
+            return false;
+
+        u32* pointer = (u32*)(pack->data + fixups[i]);
+        if (*pointer >= header->size)
+            return false;
+
+        *pointer += (u32)(uintptr_t)pack->data;
+    }
+
+    for (u32 i = 0; i < header->num_entries; i++)
+    {
+        const WindowPackEntry* entry = &pack->entries[i];
+        if (entry->offset > header->size || entry->size > header->size - entry->offset ||
+            entry->name_offset >= header->size - header->names_offset)
+            return false;
+
+#ifdef TEST_WIN
+        if (entry->type == WINDOW_PACK_ASSET_TEXTURE && entry->size >= sizeof(WindowPackTexture))
+            WindowAssetPackCreateTexture(pack, i);
+#else
+        if (entry->type == WINDOW_PACK_ASSET_TEXTURE && entry->size >= sizeof(GX2Texture))
+            GX2InitTextureRegs((GX2Texture*)(pack->data + entry->offset));
+        else if (entry->type == WINDOW_PACK_ASSET_FETCH_SHADER && entry->size >= sizeof(WindowPackFetchShader))
+            WindowAssetPackInitFetchShader(pack, i);
+#endif
+    }
+
+#ifdef TEST_GX2
+    // A single invalidation for the whole pack: it is flushed from the CPU cache, and the GPU caches
+    // that read buffers, textures and shaders are invalidated
+    GX2Invalidate((GX2InvalidateMode)(GX2_INVALIDATE_MODE_CPU_ATTRIBUTE_BUFFER | GX2_INVALIDATE_MODE_TEXTURE | GX2_INVALIDATE_MODE_SHADER),
+                  pack->data, header->size);
+#endif
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Packs
+//------------------------------------------------------------------------------
+
+WindowAssetPack* WindowAssetPackLoad(const char* path)
+{
+    WindowAssetPack* pack = (WindowAssetPack*)calloc(1, sizeof(WindowAssetPack));
+    if (!pack)
+        return NULL;
+
+    f64 start = WindowGetTime();
+
+    u32 size = 0;
+#ifdef WINDOW_ASSET_PACK_MMAP
+    pack->data = WindowAssetPackMap(path, &size);
+    pack->stats.mapped = pack->data != NULL;
+#endif // WINDOW_ASSET_PACK_MMAP
+    if (!pack->data)
+        pack->data = WindowAssetPackRead(path, &size);
+
+    pack->stats.size = size;
+    pack->stats.read_ms = (WindowGetTime() - start) * 1000.0;
+
+    pack->header = (const WindowPackHeader*)pack->data;
+    if (!pack->data || !WindowAssetPackCheckHeader(pack->header, size))
+    {
+        WindowAssetPackRelease(pack);
+        free(pack);
+        return NULL;
+    }
+
+    pack->entries = (const WindowPackEntry*)(pack->data + pack->header->entries_offset);
+    pack->slots = (const u32*)(pack->data + pack->header->slots_offset);
+    pack->names = (const char*)(pack->data + pack->header->names_offset);
+    pack->stats.num_entries = pack->header->num_entries;
+    pack->stats.num_fixups = pack->header->num_fixups;
+
+#ifdef TEST_WIN
+    pack->textures = (u32*)calloc(pack->header->num_entries + 1, sizeof(u32));
+    bool allocated = pack->textures != NULL;
+#else
+    pack->programs = (void**)calloc(pack->header->num_entries + 1, sizeof(void*));
+    bool allocated = pack->programs != NULL;
+#endif
+
+    start = WindowGetTime();
+    if (!allocated || !WindowAssetPackPrepare(pack))
+    {
+        WindowAssetPackFree(pack);
+        return NULL;
+    }
+    pack->stats.fixup_ms = (WindowGetTime() - start) * 1000.0;
+
+    return pack;
+}
+
+bool WindowAssetPackFind(const WindowAssetPack* pack, const char* name, WindowAsset* pAsset)
+{
+    const WindowPackHeader* header = pack->header;
+    u32 hash = WindowPackHashName(name);
+    u32 mask = header->num_slots - 1;
+
+    // Open addressing with linear probing, up to the first empty slot
+    for (u32 probe = 0, slot = hash & mask; probe < header->num_slots; probe++, slot = (slot + 1) & mask)
+    {
+        u32 index = pack->slots[slot];
+        if (index == 0 || index > header->num_entries)
+            return false;
+
+        const WindowPackEntry* entry = &pack->entries[index - 1];
+        if (entry->hash != hash || strcmp(pack->names + entry->name_offset, name) != 0)
+            continue;
+
+        memset(pAsset, 0, sizeof(WindowAsset));
+        pAsset->type = (WindowPackAssetType)entry->type;
+        pAsset->data = pack->data + entry->offset;
+        pAsset->size = entry->size;
+
+        if (entry->type == WINDOW_PACK_ASSET_FETCH_SHADER)
+        {
+            const WindowPackFetchShader* fetch = (const WindowPackFetchShader*)pAsset->data;
+            pAsset->count = fetch->num_attribs;
+            pAsset->attribs = (const WindowPackAttrib*)(fetch + 1);
+        }
+
+#ifdef TEST_WIN
+        pAsset->texture = pack->textures[index - 1];
+#endif
+        return true;
+    }
+
+    return false;
+}
+
+WindowBuffer* WindowAssetPackCreateBuffer(const WindowAssetPack* pack, const char* name)
+{
+    WindowAsset asset;
+    if (!WindowAssetPackFind(pack, name, &asset))
+        return NULL;
+
+    if (asset.type == WINDOW_PACK_ASSET_VERTEX_BUFFER)
+        return WindowBufferCreateFromMemory(WINDOW_BUFFER_TYPE_VERTEX, asset.size, asset.data);
+    if (asset.type == WINDOW_PACK_ASSET_INDEX_BUFFER)
+        return WindowBufferCreateFromMemory(WINDOW_BUFFER_TYPE_INDEX, asset.size, asset.data);
+
+    return NULL;
+}
+
+#ifdef TEST_WIN
+
+static u32 WindowAssetPackCompileShader(GLenum type, const char* source)
+{
+    u32 shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        printf("Asset pack shader compilation failed:\n%s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+#endif // TEST_WIN
+
+bool WindowAssetPackGetShaders(const WindowAssetPack* pack, const char* vertex_shader, const char* pixel_shader, const char* fetch_shader, WindowShaderSet* pShaders)
+{
+    WindowAsset vertex, pixel, fetch;
+    if (!WindowAssetPackFind(pack, vertex_shader, &vertex) || vertex.type != WINDOW_PACK_ASSET_VERTEX_SHADER ||
+        !WindowAssetPackFind(pack, pixel_shader, &pixel) || pixel.type != WINDOW_PACK_ASSET_PIXEL_SHADER ||
+        !WindowAssetPackFind(pack, fetch_shader, &fetch) || fetch.type != WINDOW_PACK_ASSET_FETCH_SHADER)
+        return false;
+
+#ifdef TEST_WIN
+
+    u32 vs = WindowAssetPackCompileShader(GL_VERTEX_SHADER, (const char*)vertex.data);
+    u32 fs = WindowAssetPackCompileShader(GL_FRAGMENT_SHADER, (const char*)pixel.data);
+    if (!vs || !fs)
+    {
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        return false;
+    }
+
+    u32 program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+
+    // The program keeps what it needs
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(program);
+        return false;
+    }
+
+    pShaders->program = program;
+
+#else // TEST_GX2
+
+    pShaders->fetch_shader = (const GX2FetchShader*)((const WindowPackFetchShader*)fetch.data)->shader;
+    pShaders->vertex_shader = (const GX2VertexShader*)vertex.data;
+    pShaders->pixel_shader = (const GX2PixelShader*)pixel.data;
+
+#endif
+
+    return true;
+}
+
+void WindowAssetPackGetStats(const WindowAssetPack* pack, WindowAssetPackStats* pStats)
+{
+    *pStats = pack->stats;
+}
+
+void WindowAssetPackFree(WindowAssetPack* pack)
+{
+    if (!pack)
+        return;
+
+#ifdef TEST_WIN
+    if (pack->textures)
+    {
+        for (u32 i = 0; i < pack->header->num_entries; i++)
+        {
+            if (pack->textures[i] != 0)
+                glDeleteTextures(1, &pack->textures[i]);
+        }
+        free(pack->textures);
+    }
+#else
+    if (pack->programs)
+    {
+        for (u32 i = 0; i < pack->header->num_entries; i++)
+        {
+            if (pack->programs[i])
+                MEMFreeToDefaultHeap(pack->programs[i]);
+        }
+        free(pack->programs);
+    }
+#endif
+
+    WindowAssetPackRelease(pack);
+    free(pack);
+}
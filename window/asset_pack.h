@@ -0,0 +1,97 @@
+// Asset packs
+// Loads a pack built by the packer (tools/asset_packer, format in asset_pack_format.h) and finds its
+// assets by name through its hash table
+// Loading is a single read of the whole pack, followed by the pointer fixups, and the assets are used
+// in place, without copying them:
+// - Wii U: the pack is read into MEM2 at its alignment, so that buffers, shader programs and surfaces
+//          keep the alignment they were stored with, then flushed from the CPU cache once; textures
+//          get their registers and fetch shaders their program at load time
+// - PC: the pack is mapped with mmap (read into memory if it can't be); shaders are GLSL sources, and
+//       textures are uploaded to texture objects at load time, so packs must be loaded after WindowInit
+
+#ifndef ASSET_PACK_H_
+#define ASSET_PACK_H_
+
+#include "asset_pack_format.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef struct WindowAssetPack WindowAssetPack;
+
+// Asset found in a pack
+typedef struct WindowAsset
+{
+    WindowPackAssetType type;
+    void* data;             // Object of the asset, in the pack (see WindowPackAssetType):
+                            // - Wii U: GX2VertexShader, GX2PixelShader, GX2FetchShader (first field of
+                            //          the WindowPackFetchShader) and GX2Texture objects are ready to use
+                            // - PC: the GLSL source of shaders, the WindowPackFetchShader, and the
+                            //       WindowPackTexture of textures
+    u32 size;               // Size of the object in bytes
+    u32 count;              // Number of attributes of fetch shaders
+    const WindowPackAttrib* attribs;  // Attributes of fetch shaders (NULL for the other types)
+#ifdef TEST_WIN
+    u32 texture;            // Texture object of textures (0 for the other types)
+#endif // TEST_WIN
+} WindowAsset;
+
+// Loading statistics of a pack
+typedef struct WindowAssetPackStats
+{
+    u32 size;               // Size of the pack in bytes
+    u32 num_entries;
+    u32 num_fixups;
+    bool mapped;            // PC: the pack is mapped rather than read
+    f64 read_ms;            // Time spent reading (or mapping) the pack (once mapped, pages are read
+                            // when they are first touched, while preparing the assets or using them)
+    f64 fixup_ms;           // Time spent relocating the pointers and preparing the assets
+} WindowAssetPackStats;
+
+// Load a pack
+// Parameters:
+// - path: Path of the pack
+// Returns NULL if the file could not be read, or is not a pack for this platform
+WindowAssetPack* WindowAssetPackLoad(const char* path);
+
+// Find an asset
+// Parameters:
+// - pack: The pack
+// - name: Name of the asset
+// - pAsset: Receives the asset
+// Returns false if the pack has no asset of this name
+bool WindowAssetPackFind(const WindowAssetPack* pack, const char* name, WindowAsset* pAsset);
+
+// Create a buffer from a vertex or index buffer asset
+// On Wii U, the buffer uses the data of the pack in place (see WindowBufferCreateFromMemory), so it must
+// be destroyed before the pack is freed
+// Returns NULL if the pack has no buffer of this name
+WindowBuffer* WindowAssetPackCreateBuffer(const WindowAssetPack* pack, const char* name);
+
+// Set up a shader set from shader assets
+// - Wii U: the shaders of the pack are used in place
+// - PC: the sources are compiled and linked into a program, which the caller deletes with
+//       glDeleteProgram (the fetch shader is not needed, since the attributes are set up with
+//       glVertexAttribPointer)
+// Parameters:
+// - pack: The pack
+// - vertex_shader, pixel_shader, fetch_shader: Names of the assets
+// - pShaders: Receives the shader set
+// Returns false if an asset is missing, or if the program could not be linked (PC)
+bool WindowAssetPackGetShaders(const WindowAssetPack* pack, const char* vertex_shader, const char* pixel_shader, const char* fetch_shader, WindowShaderSet* pShaders);
+
+// Get the loading statistics of a pack
+void WindowAssetPackGetStats(const WindowAssetPack* pack, WindowAssetPackStats* pStats);
+
+// Free a pack
+// On Wii U, the GPU must be done with its assets
+void WindowAssetPackFree(WindowAssetPack* pack);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ASSET_PACK_H_
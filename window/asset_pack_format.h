@@ -0,0 +1,193 @@
+// Asset pack file format, and the writer the packer (tools/asset_packer) builds packs with
+// A pack is loaded with one read (or mmap) and used in place (see asset_pack.h), so its contents are
+// laid out the way the GPU wants them:
+// - Payloads are stored at offsets aligned to the GX2 alignment constants, and the pack is loaded at an
+//   address aligned to the largest of them, so they keep their alignment in memory
+// - All fields and payloads are stored in the byte order of the target (big-endian for Wii U packs,
+//   little-endian for PC packs), so nothing is swapped at load time
+// - Pointers inside the objects (e.g. GX2VertexShader::program) are stored as offsets from the start of
+//   the pack, and listed in a fixup table: loading adds the address of the pack to each of them
+// Layout: header, payloads, then the entries, the hash table, the names and the fixup table
+// This header only depends on test_types.h, so that host tools can include it
+
+#ifndef ASSET_PACK_FORMAT_H_
+#define ASSET_PACK_FORMAT_H_
+
+#include <test_types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#define WINDOW_PACK_MAGIC   0x5750414B  // "WPAK", in the byte order of the target
+#define WINDOW_PACK_VERSION 1
+
+// Alignments of the payloads (GX2_SHADER_PROGRAM_ALIGNMENT, GX2_VERTEX_BUFFER_ALIGNMENT and
+// GX2_INDEX_BUFFER_ALIGNMENT; textures use the alignment of their surface)
+#define WINDOW_PACK_ALIGN_DEFAULT   64
+#define WINDOW_PACK_ALIGN_PROGRAM   0x100
+#define WINDOW_PACK_ALIGN_VERTEX    0x40
+#define WINDOW_PACK_ALIGN_INDEX     0x20
+
+// Space reserved in fetch shader templates for the GX2FetchShader built at load time
+#define WINDOW_PACK_FETCH_SHADER_SIZE 64
+
+// Most levels of a texture (8192x8192)
+#define WINDOW_PACK_MAX_LEVELS 14
+
+typedef enum WindowPackPlatform
+{
+    WINDOW_PACK_PLATFORM_WIIU,  // Big-endian, GX2 objects
+    WINDOW_PACK_PLATFORM_PC,    // Little-endian, GLSL sources and untiled textures
+    WINDOW_PACK_PLATFORM_COUNT
+} WindowPackPlatform;
+
+// Types of assets, and what the object at the offset of their entry is
+typedef enum WindowPackAssetType
+{
+    WINDOW_PACK_ASSET_BLOB,             // Bytes
+    WINDOW_PACK_ASSET_VERTEX_BUFFER,    // Vertex data (Wii U: swapped to big-endian by element)
+    WINDOW_PACK_ASSET_INDEX_BUFFER,     // 32-bit indices
+    WINDOW_PACK_ASSET_VERTEX_SHADER,    // Wii U: GX2VertexShader, with its variables and program
+                                        // PC: GLSL source, NUL-terminated
+    WINDOW_PACK_ASSET_PIXEL_SHADER,     // Wii U: GX2PixelShader, with its variables and program
+                                        // PC: GLSL source, NUL-terminated
+    WINDOW_PACK_ASSET_FETCH_SHADER,     // WindowPackFetchShader, followed by its attributes
+    WINDOW_PACK_ASSET_TEXTURE,          // Wii U: GX2Texture, with its tiled image and mipmaps
+                                        // PC: WindowPackTexture, followed by its levels
+    WINDOW_PACK_ASSET_COUNT
+} WindowPackAssetType;
+
+// Formats of the attributes of fetch shader templates
+typedef enum WindowPackAttribFormat
+{
+    WINDOW_PACK_ATTRIB_FLOAT1,          // 32-bit floats
+    WINDOW_PACK_ATTRIB_FLOAT2,
+    WINDOW_PACK_ATTRIB_FLOAT3,
+    WINDOW_PACK_ATTRIB_FLOAT4,
+    WINDOW_PACK_ATTRIB_UNORM8X4,        // 8-bit unsigned normalized
+    WINDOW_PACK_ATTRIB_COUNT
+} WindowPackAttribFormat;
+
+typedef struct WindowPackHeader
+{
+    u32 magic;
+    u32 version;
+    u32 platform;           // WindowPackPlatform
+    u32 size;               // Size of the pack in bytes
+    u32 alignment;          // Alignment the pack must be loaded at (the largest alignment of its payloads)
+    u32 num_entries;
+    u32 entries_offset;     // WindowPackEntry[num_entries]
+    u32 num_slots;          // Slots of the hash table (a power of two)
+    u32 slots_offset;       // u32[num_slots]: index of an entry + 1, or 0 for an empty slot
+    u32 names_offset;       // Names of the entries, NUL-terminated
+    u32 num_fixups;
+    u32 fixups_offset;      // u32[num_fixups]: offsets of the pointers to relocate
+    u32 reserved[4];
+} WindowPackHeader;
+
+typedef struct WindowPackEntry
+{
+    u32 hash;               // Hash of the name (WindowPackHashName)
+    u32 name_offset;        // Offset of the name from names_offset
+    u32 type;               // WindowPackAssetType
+    u32 offset;             // Offset of the object
+    u32 size;               // Size of the object in bytes (including the payloads it points to)
+    u32 info;               // Number of attributes of fetch shaders, 0 for the other types
+} WindowPackEntry;
+
+typedef struct WindowPackAttrib
+{
+    u32 location;           // Shader attribute location
+    u32 buffer;             // Attribute buffer slot
+    u32 offset;             // Offset in the vertex, in bytes
+    u32 format;             // WindowPackAttribFormat
+} WindowPackAttrib;
+
+// Fetch shader template: the attributes are stored, and the fetch shader is built from them at load
+// time into the space reserved for it (its program is as large as the GX2 library makes it)
+typedef struct WindowPackFetchShader
+{
+    u8 shader[WINDOW_PACK_FETCH_SHADER_SIZE];   // Wii U: GX2FetchShader, built at load time
+    u32 program;            // Space reserved for the program, aligned to WINDOW_PACK_ALIGN_PROGRAM
+                            // (pointer once loaded; 0 in PC packs)
+    u32 program_size;       // Size of the space reserved for the program
+    u32 num_attribs;
+    u32 reserved;
+    // Followed by WindowPackAttrib[num_attribs]
+} WindowPackFetchShader;
+
+// Texture of a PC pack (in Wii U packs, textures are GX2Texture objects)
+typedef struct WindowPackTexture
+{
+    u32 format;             // WindowTextureFormat
+    u32 width;              // Size of level 0 in pixels
+    u32 height;
+    u32 levels;
+    u32 level_offsets[WINDOW_PACK_MAX_LEVELS];  // Offsets of the levels from this header, with tightly
+                                                // packed rows of elements
+    u32 level_sizes[WINDOW_PACK_MAX_LEVELS];
+} WindowPackTexture;
+
+// Space to reserve for the program of a fetch shader with this many attributes (an upper bound of
+// GX2CalcFetchShaderSizeEx without tessellation: a vertex fetch instruction per attribute, and the
+// control flow instructions around them)
+#define WINDOW_PACK_FETCH_PROGRAM_SIZE(num_attribs) (((num_attribs) * 16 + 256 + 255) & ~255u)
+
+// Hash of an asset name (32-bit FNV-1a)
+u32 WindowPackHashName(const char* name);
+
+//------------------------------------------------------------------------------
+// Writer
+//------------------------------------------------------------------------------
+
+typedef struct WindowPackWriter WindowPackWriter;
+
+// Create a writer for a pack of a platform
+// Returns NULL if out of memory
+WindowPackWriter* WindowPackWriterCreate(WindowPackPlatform platform);
+
+// Append a payload at an aligned offset
+// Parameters:
+// - data: Payload, stored as it is (NULL to fill it with zeros)
+// - size: Size of the payload in bytes
+// - alignment: Alignment of its offset (a power of two)
+// Returns the offset of the payload, or 0 if out of memory
+u32 WindowPackWriterAppend(WindowPackWriter* writer, const void* data, u32 size, u32 alignment);
+
+// Append 32-bit words, swapped to the byte order of the target
+u32 WindowPackWriterAppendWords(WindowPackWriter* writer, const u32* words, u32 count, u32 alignment);
+
+// Pointer to the data at an offset (valid until the next append)
+u8* WindowPackWriterGetData(WindowPackWriter* writer, u32 offset);
+
+// Read and write a 32-bit word at an offset, in the byte order of the target
+u32 WindowPackWriterGet32(WindowPackWriter* writer, u32 offset);
+void WindowPackWriterSet32(WindowPackWriter* writer, u32 offset, u32 value);
+
+// Write a pointer: stores the offset of its target, and adds the pointer to the fixup table
+// Returns false if out of memory
+bool WindowPackWriterSetPointer(WindowPackWriter* writer, u32 offset, u32 target);
+
+// Add an entry to the table of contents
+// Parameters:
+// - name: Name to find the asset with
+// - type: WindowPackAssetType
+// - offset, size: Object of the asset (see WindowPackAssetType)
+// - info: See WindowPackEntry::info
+// Returns false if the name is already used, or if out of memory
+bool WindowPackWriterAddEntry(WindowPackWriter* writer, const char* name, WindowPackAssetType type, u32 offset, u32 size, u32 info);
+
+// Write the pack to a file
+// Returns false if the file could not be written
+bool WindowPackWriterSave(WindowPackWriter* writer, const char* path);
+
+// Free a writer
+void WindowPackWriterDestroy(WindowPackWriter* writer);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ASSET_PACK_FORMAT_H_
@@ -0,0 +1,298 @@
+// Asset pack writer
+// Also built into the packer, so it only uses the standard C library
+
+#include "asset_pack_format.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct WindowPackWriter
+{
+    WindowPackPlatform platform;
+    bool swap;              // The byte order of the target is not the one of the host
+
+    u8* data;               // Header and payloads
+    u32 size;
+    u32 capacity;
+    u32 alignment;          // Largest alignment of the payloads
+
+    WindowPackEntry* entries;
+    char** names;
+    u32 num_entries;
+    u32 max_entries;
+
+    u32* fixups;
+    u32 num_fixups;
+    u32 max_fixups;
+};
+
+static u32 WindowPackSwap32(u32 value)
+{
+    return (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+}
+
+static bool WindowPackIsHostBigEndian()
+{
+    const u32 value = 1;
+    return *(const u8*)&value == 0;
+}
+
+u32 WindowPackHashName(const char* name)
+{
+    u32 hash = 0x811C9DC5;
+    for (const u8* c = (const u8*)name; *c; c++)
+    {
+        hash ^= *c;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+static bool WindowPackWriterReserve(WindowPackWriter* writer, u32 size)
+{
+    if (size <= writer->capacity)
+        return true;
+
+    u32 capacity = writer->capacity ? writer->capacity : 64 * 1024;
+    while (capacity < size)
+        capacity *= 2;
+
+    u8* data = (u8*)realloc(writer->data, capacity);
+    if (!data)
+        return false;
+
+    writer->data = data;
+    writer->capacity = capacity;
+    return true;
+}
+
+WindowPackWriter* WindowPackWriterCreate(WindowPackPlatform platform)
+{
+    WindowPackWriter* writer = (WindowPackWriter*)calloc(1, sizeof(WindowPackWriter));
+    if (!writer)
+        return NULL;
+
+    writer->platform = platform;
+    writer->swap = (platform == WINDOW_PACK_PLATFORM_WIIU) != WindowPackIsHostBigEndian();
+    writer->alignment = WINDOW_PACK_ALIGN_DEFAULT;
+
+    // The header is written by WindowPackWriterSave
+    if (!WindowPackWriterReserve(writer, sizeof(WindowPackHeader)))
+    {
+        free(writer);
+        return NULL;
+    }
+
+    memset(writer->data, 0, sizeof(WindowPackHeader));
+    writer->size = sizeof(WindowPackHeader);
+    return writer;
+}
+
+u32 WindowPackWriterAppend(WindowPackWriter* writer, const void* data, u32 size, u32 alignment)
+{
+    if (alignment == 0)
+        alignment = 1;
+
+    u32 offset = (writer->size + alignment - 1) & ~(alignment - 1);
+    if (!WindowPackWriterReserve(writer, offset + size))
+        return 0;
+
+    // Padding and zero-filled payloads
+    memset(writer->data + writer->size, 0, offset - writer->size);
+    if (data)
+        memcpy(writer->data + offset, data, size);
+    else
+        memset(writer->data + offset, 0, size);
+
+    writer->size = offset + size;
+    if (alignment > writer->alignment)
+        writer->alignment = alignment;
+
+    return offset;
+}
+
+u32 WindowPackWriterAppendWords(WindowPackWriter* writer, const u32* words, u32 count, u32 alignment)
+{
+    u32 offset = WindowPackWriterAppend(writer, NULL, count * 4, alignment);
+    if (offset == 0)
+        return 0;
+
+    for (u32 i = 0; i < count; i++)
+        WindowPackWriterSet32(writer, offset + i * 4, words[i]);
+
+    return offset;
+}
+
+u8* WindowPackWriterGetData(WindowPackWriter* writer, u32 offset)
+{
+    return writer->data + offset;
+}
+
+u32 WindowPackWriterGet32(WindowPackWriter* writer, u32 offset)
+{
+    u32 value;
+    memcpy(&value, writer->data + offset, 4);
+    return writer->swap ? WindowPackSwap32(value) : value;
+}
+
+void WindowPackWriterSet32(WindowPackWriter* writer, u32 offset, u32 value)
+{
+    if (writer->swap)
+        value = WindowPackSwap32(value);
+    memcpy(writer->data + offset, &value, 4);
+}
+
+bool WindowPackWriterSetPointer(WindowPackWriter* writer, u32 offset, u32 target)
+{
+    if (writer->num_fixups == writer->max_fixups)
+    {
+        u32 max_fixups = writer->max_fixups ? writer->max_fixups * 2 : 256;
+        u32* fixups = (u32*)realloc(writer->fixups, max_fixups * sizeof(u32));
+        if (!fixups)
+            return false;
+
+        writer->fixups = fixups;
+        writer->max_fixups = max_fixups;
+    }
+
+    WindowPackWriterSet32(writer, offset, target);
+    writer->fixups[writer->num_fixups++] = offset;
+    return true;
+}
+
+bool WindowPackWriterAddEntry(WindowPackWriter* writer, const char* name, WindowPackAssetType type, u32 offset, u32 size, u32 info)
+{
+    u32 hash = WindowPackHashName(name);
+    for (u32 i = 0; i < writer->num_entries; i++)
+    {
+        if (writer->entries[i].hash == hash && strcmp(writer->names[i], name) == 0)
+            return false;
+    }
+
+    if (writer->num_entries == writer->max_entries)
+    {
+        u32 max_entries = writer->max_entries ? writer->max_entries * 2 : 64;
+        WindowPackEntry* entries = (WindowPackEntry*)realloc(writer->entries, max_entries * sizeof(WindowPackEntry));
+        if (!entries)
+            return false;
+        writer->entries = entries;
+
+        char** names = (char**)realloc(writer->names, max_entries * sizeof(char*));
+        if (!names)
+            return false;
+        writer->names = names;
+
+        writer->max_entries = max_entries;
+    }
+
+    char* name_copy = strdup(name);
+    if (!name_copy)
+        return false;
+
+    WindowPackEntry* entry = &writer->entries[writer->num_entries];
+    entry->hash = hash;
+    entry->name_offset = 0;
+    entry->type = type;
+    entry->offset = offset;
+    entry->size = size;
+    entry->info = info;
+
+    writer->names[writer->num_entries++] = name_copy;
+    return true;
+}
+
+bool WindowPackWriterSave(WindowPackWriter* writer, const char* path)
+{
+    // The table of contents is appended after the payloads, then removed again, so that more payloads
+    // can be added and the pack saved again
+    u32 payloads_size = writer->size;
+    u32 payloads_alignment = writer->alignment;
+
+    // Hash table, at most half full
+    u32 num_slots = 16;
+    while (num_slots < writer->num_entries * 2)
+        num_slots *= 2;
+
+    u32* slots = (u32*)calloc(num_slots, sizeof(u32));
+    if (!slots)
+        return false;
+
+    for (u32 i = 0; i < writer->num_entries; i++)
+    {
+        u32 slot = writer->entries[i].hash & (num_slots - 1);
+        while (slots[slot] != 0)
+            slot = (slot + 1) & (num_slots - 1);
+        slots[slot] = i + 1;
+    }
+
+    bool success = true;
+
+    u32 names_size = 0;
+    for (u32 i = 0; i < writer->num_entries; i++)
+    {
+        writer->entries[i].name_offset = names_size;
+        names_size += (u32)strlen(writer->names[i]) + 1;
+    }
+
+    u32 entries_offset = WindowPackWriterAppendWords(writer, (const u32*)writer->entries, writer->num_entries * sizeof(WindowPackEntry) / 4, 4);
+    u32 slots_offset = WindowPackWriterAppendWords(writer, slots, num_slots, 4);
+    u32 names_offset = WindowPackWriterAppend(writer, NULL, names_size, 4);
+    if (entries_offset == 0 || slots_offset == 0 || names_offset == 0)
+        success = false;
+
+    for (u32 i = 0; success && i < writer->num_entries; i++)
+        strcpy((char*)writer->data + names_offset + writer->entries[i].name_offset, writer->names[i]);
+
+    u32 fixups_offset = success ? WindowPackWriterAppendWords(writer, writer->fixups, writer->num_fixups, 4) : 0;
+    if (fixups_offset == 0)
+        success = false;
+
+    free(slots);
+
+    if (success)
+    {
+        WindowPackHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = WINDOW_PACK_MAGIC;
+        header.version = WINDOW_PACK_VERSION;
+        header.platform = writer->platform;
+        header.size = writer->size;
+        header.alignment = payloads_alignment;
+        header.num_entries = writer->num_entries;
+        header.entries_offset = entries_offset;
+        header.num_slots = num_slots;
+        header.slots_offset = slots_offset;
+        header.names_offset = names_offset;
+        header.num_fixups = writer->num_fixups;
+        header.fixups_offset = fixups_offset;
+
+        const u32* words = (const u32*)&header;
+        for (u32 i = 0; i < sizeof(header) / 4; i++)
+            WindowPackWriterSet32(writer, i * 4, words[i]);
+
+        FILE* file = fopen(path, "wb");
+        success = file && fwrite(writer->data, 1, writer->size, file) == writer->size;
+        if (file)
+            success = fclose(file) == 0 && success;
+    }
+
+    writer->size = payloads_size;
+    writer->alignment = payloads_alignment;
+    return success;
+}
+
+void WindowPackWriterDestroy(WindowPackWriter* writer)
+{
+    if (!writer)
+        return;
+
+    for (u32 i = 0; i < writer->num_entries; i++)
+        free(writer->names[i]);
+
+    free(writer->names);
+    free(writer->entries);
+    free(writer->fixups);
+    free(writer->data);
+    free(writer);
+}
@@ -0,0 +1,254 @@
+// Geometry batcher
+
+#include "batcher.h"
+#include "buffer.h"
+#include "coherency.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+#else // TEST_GX2
+
+#include <gx2/event.h>
+
+#endif
+
+// Dynamic batchers fill one half while the GPU may still read the other
+#define WINDOW_BATCH_HALVES 2
+
+typedef struct WindowBatchHalf
+{
+    WindowBuffer* vertex_buffer;
+    WindowBuffer* index_buffer;
+#ifdef TEST_WIN
+    u32 vertex_array;           // Holds the attribute layout and the index buffer
+    GLsync fence;
+#else
+    OSTime fence;
+#endif // TEST_WIN
+} WindowBatchHalf;
+
+struct WindowBatcher
+{
+    WindowBatchLayout layout;
+    u32 max_vertices;
+    u32 max_indices;
+    u32 num_halves;
+    u32 half;                   // Half being filled
+    u32 vertices;               // Vertices added to the current half
+    u32 indices;                // Indices added to the current half
+    u32 flushed_vertices;       // Vertices of the current half made visible to the GPU
+    u32 flushed_indices;        // Indices of the current half made visible to the GPU
+    WindowBatcherStats stats;
+    WindowBatchHalf halves[WINDOW_BATCH_HALVES];
+};
+
+WindowBatcher* WindowBatcherCreate(const WindowBatchLayout* layout, u32 max_vertices, u32 max_indices, bool dynamic)
+{
+    if (layout->stride == 0 || layout->num_attribs > WINDOW_BATCH_MAX_ATTRIBS || max_vertices == 0 || max_indices == 0)
+        return NULL;
+
+    WindowBatcher* batcher = (WindowBatcher*)malloc(sizeof(WindowBatcher));
+    if (!batcher)
+        return NULL;
+
+    memset(batcher, 0, sizeof(WindowBatcher));
+    batcher->layout = *layout;
+    batcher->max_vertices = max_vertices;
+    batcher->max_indices = max_indices;
+    batcher->num_halves = dynamic ? WINDOW_BATCH_HALVES : 1;
+
+    for (u32 i = 0; i < batcher->num_halves; i++)
+    {
+        WindowBatchHalf* half = &batcher->halves[i];
+
+        half->vertex_buffer = WindowBufferCreate(WINDOW_BUFFER_TYPE_VERTEX, max_vertices * layout->stride, NULL);
+        half->index_buffer = WindowBufferCreate(WINDOW_BUFFER_TYPE_INDEX, max_indices * sizeof(u32), NULL);
+        if (!half->vertex_buffer || !half->index_buffer)
+        {
+            WindowBatcherDestroy(batcher);
+            return NULL;
+        }
+
+#ifdef TEST_WIN
+        // Keep the caller's vertex array object and vertex buffer bound
+        GLint current_vertex_array, current_array_buffer;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &current_vertex_array);
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &current_array_buffer);
+
+        glGenVertexArrays(1, &half->vertex_array);
+        glBindVertexArray(half->vertex_array);
+
+        glBindBuffer(GL_ARRAY_BUFFER, half->vertex_buffer->buffer);
+        for (u32 j = 0; j < layout->num_attribs; j++)
+        {
+            const WindowBatchAttrib* attrib = &layout->attribs[j];
+            glEnableVertexAttribArray(attrib->location);
+            glVertexAttribPointer(attrib->location, attrib->components, GL_FLOAT, GL_FALSE, layout->stride, (void*)(uintptr_t)attrib->offset);
+        }
+
+        // The index buffer is bound to the vertex array object once
+        // (Directly, so that the current index buffer of WindowDrawIndexed does not change)
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, half->index_buffer->buffer);
+
+        glBindVertexArray(current_vertex_array);
+        glBindBuffer(GL_ARRAY_BUFFER, current_array_buffer);
+#endif
+    }
+
+    return batcher;
+}
+
+void WindowBatcherBegin(WindowBatcher* batcher)
+{
+    if (batcher->num_halves > 1)
+    {
+        // All commands using the current half have been issued by now: fence it
+        WindowBatchHalf* half = &batcher->halves[batcher->half];
+#ifdef TEST_WIN
+        if (half->fence)
+            glDeleteSync(half->fence);
+        half->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#else
+        GX2Flush();
+        half->fence = GX2GetLastSubmittedTimeStamp();
+#endif
+
+        batcher->half = (batcher->half + 1) % batcher->num_halves;
+
+        // Wait until the GPU is done with the half about to be filled
+        half = &batcher->halves[batcher->half];
+#ifdef TEST_WIN
+        if (half->fence)
+        {
+            if (glClientWaitSync(half->fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                batcher->stats.fence_waits++;
+                while (glClientWaitSync(half->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+                    continue;
+            }
+
+            glDeleteSync(half->fence);
+            half->fence = NULL;
+        }
+#else
+        if (half->fence != 0 && GX2GetRetiredTimeStamp() < half->fence)
+        {
+            batcher->stats.fence_waits++;
+            GX2WaitTimeStamp(half->fence);
+        }
+#endif
+    }
+
+    batcher->vertices = 0;
+    batcher->indices = 0;
+    batcher->flushed_vertices = 0;
+    batcher->flushed_indices = 0;
+
+    batcher->stats.meshes = 0;
+    batcher->stats.vertices = 0;
+    batcher->stats.indices = 0;
+}
+
+void* WindowBatcherAdd(WindowBatcher* batcher, const void* vertices, u32 vertex_count, const u32* indices, u32 index_count)
+{
+    if (vertex_count > batcher->max_vertices - batcher->vertices || index_count > batcher->max_indices - batcher->indices)
+    {
+        batcher->stats.failed_adds++;
+        return NULL;
+    }
+
+    WindowBatchHalf* half = &batcher->halves[batcher->half];
+    u32 stride = batcher->layout.stride;
+
+    u8* dst_vertices = (u8*)half->vertex_buffer->data + batcher->vertices * stride;
+    if (vertices)
+        memcpy(dst_vertices, vertices, vertex_count * stride);
+
+    // Rebase the indices on the first vertex of the mesh in the arena
+    u32* dst_indices = (u32*)half->index_buffer->data + batcher->indices;
+    u32 base = batcher->vertices;
+    for (u32 i = 0; i < index_count; i++)
+        dst_indices[i] = indices[i] + base;
+
+    // Without vertices, the caller writes them through the pointer returned
+    COHERENCY_CPU_WRITE(dst_vertices, vertex_count * stride);
+    COHERENCY_CPU_WRITE(dst_indices, index_count * sizeof(u32));
+
+    batcher->vertices += vertex_count;
+    batcher->indices += index_count;
+
+    batcher->stats.meshes++;
+    batcher->stats.vertices = batcher->vertices;
+    batcher->stats.indices = batcher->indices;
+
+    return dst_vertices;
+}
+
+void WindowBatcherDraw(WindowBatcher* batcher)
+{
+    if (batcher->indices == 0)
+        return;
+
+    WindowBatchHalf* half = &batcher->halves[batcher->half];
+    u32 stride = batcher->layout.stride;
+
+    // Make the meshes added since the last draw visible to the GPU
+    if (batcher->vertices > batcher->flushed_vertices)
+    {
+        WindowBufferFlush(half->vertex_buffer, batcher->flushed_vertices * stride, (batcher->vertices - batcher->flushed_vertices) * stride);
+        batcher->flushed_vertices = batcher->vertices;
+    }
+
+    if (batcher->indices > batcher->flushed_indices)
+    {
+        WindowBufferFlush(half->index_buffer, batcher->flushed_indices * sizeof(u32), (batcher->indices - batcher->flushed_indices) * sizeof(u32));
+        batcher->flushed_indices = batcher->indices;
+    }
+
+#ifdef TEST_WIN
+    glBindVertexArray(half->vertex_array);
+#else
+    WindowSetVertexBuffer(0, half->vertex_buffer, stride);
+#endif
+    WindowSetIndexBuffer(half->index_buffer);
+
+    WindowDrawIndexed(batcher->indices, 0);
+
+    batcher->stats.draws++;
+    batcher->stats.draws_saved += batcher->stats.meshes - 1;
+}
+
+void WindowBatcherGetStats(const WindowBatcher* batcher, WindowBatcherStats* pStats)
+{
+    *pStats = batcher->stats;
+}
+
+void WindowBatcherDestroy(WindowBatcher* batcher)
+{
+    if (!batcher)
+        return;
+
+    for (u32 i = 0; i < batcher->num_halves; i++)
+    {
+        WindowBatchHalf* half = &batcher->halves[i];
+
+#ifdef TEST_WIN
+        if (half->fence)
+            glDeleteSync(half->fence);
+
+        if (half->vertex_array != GL_NONE)
+            glDeleteVertexArrays(1, &half->vertex_array);
+#endif
+
+        WindowBufferDestroy(half->vertex_buffer);
+        WindowBufferDestroy(half->index_buffer);
+    }
+
+    free(batcher);
+}
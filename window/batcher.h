@@ -0,0 +1,98 @@
+// Geometry batcher
+// Packs many small meshes sharing a vertex layout (and drawn with the same shaders) into one vertex
+// buffer and one index buffer, rebasing the indices of each mesh, so that they are drawn with a single
+// indexed draw instead of one attribute buffer binding and one draw each
+// - Static batchers are filled once and drawn every frame
+// - Dynamic batchers are filled again every frame; they are double-buffered, and a fence makes sure
+//   the GPU is done with a half before it is filled again (like the per-frame uniform buffer)
+// The vertex and index arenas are WindowBuffers (see buffer.h): in MEM2 with the GX2 vertex and index
+// buffer alignments on Wii U, and in the current buffer mode on PC
+
+#ifndef BATCHER_H_
+#define BATCHER_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Most attributes per vertex
+#define WINDOW_BATCH_MAX_ATTRIBS 8
+
+typedef struct WindowBatcher WindowBatcher;
+
+// Float vertex attribute
+typedef struct WindowBatchAttrib
+{
+    u32 location;               // Attribute location in the vertex shader
+    u32 components;             // Number of floats (1 to 4)
+    u32 offset;                 // Offset in the vertex, in bytes
+} WindowBatchAttrib;
+
+// Vertex layout of the meshes of a batcher
+// - Wii U: the layout is described by the fetch shader; the arena is bound to attribute buffer slot 0
+// - PC: the attributes are set up in the vertex array object of the batcher
+typedef struct WindowBatchLayout
+{
+    u32 stride;                 // Size of each vertex in bytes
+    u32 num_attribs;
+    WindowBatchAttrib attribs[WINDOW_BATCH_MAX_ATTRIBS];
+} WindowBatchLayout;
+
+// Batcher statistics
+typedef struct WindowBatcherStats
+{
+    u32 meshes;                 // Meshes in the current fill
+    u32 vertices;               // Vertices in the current fill
+    u32 indices;                // Indices in the current fill
+    u32 draws;                  // Draws issued since the batcher was created
+    u32 draws_saved;            // Draws saved since the batcher was created (meshes drawn minus draws issued)
+    u32 failed_adds;            // Meshes that did not fit in the arenas
+    u32 fence_waits;            // Number of times the CPU had to wait for the GPU to be done with a half
+} WindowBatcherStats;
+
+// Create a batcher
+// Parameters:
+// - layout: Vertex layout of the meshes (copied)
+// - max_vertices, max_indices: Size of the arenas (per half for dynamic batchers)
+// - dynamic: Whether the batcher is filled again every frame
+// Returns NULL if the arenas could not be allocated
+WindowBatcher* WindowBatcherCreate(const WindowBatchLayout* layout, u32 max_vertices, u32 max_indices, bool dynamic);
+
+// Start filling the batcher, dropping the meshes added so far
+// Dynamic batchers: call it once per frame, before any add (e.g. right after WindowSwapBuffers);
+// the CPU waits if the GPU is not done with the half being filled
+// Static batchers: the GPU must be done with previous draws of the batcher
+void WindowBatcherBegin(WindowBatcher* batcher);
+
+// Add a mesh
+// Parameters:
+// - vertices: Vertex data (vertex_count * stride bytes; NULL to leave the vertices to the caller)
+// - vertex_count: Number of vertices
+// - indices: 32-bit indices, relative to the first vertex of the mesh
+// - index_count: Number of indices
+// Returns the address of the vertices in the arena, which may be written until the next draw
+// (e.g. to transform them), or NULL if the mesh does not fit
+void* WindowBatcherAdd(WindowBatcher* batcher, const void* vertices, u32 vertex_count, const u32* indices, u32 index_count);
+
+// Draw every mesh added so far with one indexed draw
+// The shaders must have been set by the caller
+// The batcher's buffers stay bound afterwards (its vertex array object on PC, attribute buffer slot 0
+// on Wii U, and the current index buffer): the caller must set its own vertex input and index buffer
+// again before its next draws
+void WindowBatcherDraw(WindowBatcher* batcher);
+
+// Get the statistics of a batcher
+void WindowBatcherGetStats(const WindowBatcher* batcher, WindowBatcherStats* pStats);
+
+// Free a batcher
+// On Wii U, the GPU must be done with it
+void WindowBatcherDestroy(WindowBatcher* batcher);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // BATCHER_H_
@@ -0,0 +1,335 @@
+// Vertex and index buffers
+
+#include "buffer.h"
+#include "coherency.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+static bool gModeSetWin = false;
+static WindowBufferMode gModeWin = WINDOW_BUFFER_MODE_COPY;
+
+#else // TEST_GX2
+
+#include <coreinit/memdefaultheap.h>
+#include <gx2/draw.h>
+#include <gx2/mem.h>
+#include <gx2/shaders.h>
+
+// Audits the GX2 calls of this file when built with WINDOW_COHERENCY
+#include "coherency_calls.h"
+
+#endif
+
+static const WindowBuffer* gIndexBuffer = NULL;
+static WindowBufferStats gStats;
+
+#ifdef TEST_WIN
+
+// Persistent mapping is used by default when it is supported
+// (decided on first use, since GLEW is only initialized by WindowInit)
+static void WindowBufferInitModeWin()
+{
+    if (gModeSetWin)
+        return;
+
+    gModeWin = GLEW_ARB_buffer_storage ? WINDOW_BUFFER_MODE_PERSISTENT : WINDOW_BUFFER_MODE_COPY;
+    gModeSetWin = true;
+}
+
+#endif // TEST_WIN
+
+bool WindowSetBufferMode(WindowBufferMode mode)
+{
+#ifdef TEST_WIN
+    if (mode == WINDOW_BUFFER_MODE_PERSISTENT && !GLEW_ARB_buffer_storage)
+        return false;
+
+    gModeWin = mode;
+    gModeSetWin = true;
+#else
+    (void)mode;
+#endif
+
+    return true;
+}
+
+WindowBufferMode WindowGetBufferMode()
+{
+#ifdef TEST_WIN
+    WindowBufferInitModeWin();
+    return gModeWin;
+#else
+    // Shared memory behaves like a persistent mapping
+    return WINDOW_BUFFER_MODE_PERSISTENT;
+#endif
+}
+
+WindowBuffer* WindowBufferCreate(WindowBufferType type, u32 size, const void* data)
+{
+    if (size == 0)
+        return NULL;
+
+    WindowBuffer* buffer = (WindowBuffer*)malloc(sizeof(WindowBuffer));
+    if (!buffer)
+        return NULL;
+
+    memset(buffer, 0, sizeof(WindowBuffer));
+    buffer->type = type;
+    buffer->size = size;
+
+#ifdef TEST_WIN
+
+    WindowBufferInitModeWin();
+    buffer->mode = gModeWin;
+
+    // There are no client vertex arrays in the core profile
+    if (buffer->mode == WINDOW_BUFFER_MODE_CLIENT && type == WINDOW_BUFFER_TYPE_VERTEX)
+        buffer->mode = WINDOW_BUFFER_MODE_COPY;
+
+    if (buffer->mode != WINDOW_BUFFER_MODE_CLIENT)
+    {
+        glGenBuffers(1, &buffer->buffer);
+
+        // Bound to the copy target, so that the element buffer of the current vertex array object
+        // is not replaced
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->buffer);
+
+        if (buffer->mode == WINDOW_BUFFER_MODE_PERSISTENT)
+        {
+            // Map the buffer once for its lifetime
+            // Coherent, so that writes are visible to the GPU without explicit flushes
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, size, data, flags);
+            buffer->data = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+
+            if (!buffer->data)
+            {
+                // Buffer storage is immutable, so start over with a new buffer
+                glDeleteBuffers(1, &buffer->buffer);
+                glGenBuffers(1, &buffer->buffer);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->buffer);
+
+                buffer->mode = WINDOW_BUFFER_MODE_COPY;
+            }
+        }
+
+        if (buffer->mode == WINDOW_BUFFER_MODE_COPY)
+            glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+    }
+
+    // Client and copy modes keep the contents in CPU memory
+    if (!buffer->data)
+    {
+        buffer->data = malloc(size);
+        if (!buffer->data)
+        {
+            if (buffer->buffer != GL_NONE)
+                glDeleteBuffers(1, &buffer->buffer);
+
+            free(buffer);
+            return NULL;
+        }
+
+        if (data)
+            memcpy(buffer->data, data, size);
+    }
+
+    // The initial contents are visible to the GPU, like after a flush
+    if (data)
+    {
+        COHERENCY_CPU_WRITE(buffer->data, size);
+        COHERENCY_INVALIDATE(COHERENCY_CACHE_CPU | COHERENCY_CACHE_ATTRIBUTE_BUFFER, buffer->data, size);
+    }
+
+#else // TEST_GX2
+
+    buffer->mode = WINDOW_BUFFER_MODE_PERSISTENT;
+
+    u32 alignment = type == WINDOW_BUFFER_TYPE_VERTEX ? GX2_VERTEX_BUFFER_ALIGNMENT : GX2_INDEX_BUFFER_ALIGNMENT;
+    buffer->data = MEMAllocFromDefaultHeapEx(size, alignment);
+    if (!buffer->data)
+    {
+        free(buffer);
+        return NULL;
+    }
+
+    COHERENCY_ALLOC(buffer->data, size);
+
+    if (data)
+    {
+        memcpy(buffer->data, data, size);
+        COHERENCY_CPU_WRITE(buffer->data, size);
+        GX2Invalidate(GX2_INVALIDATE_MODE_CPU_ATTRIBUTE_BUFFER, buffer->data, size);
+    }
+
+#endif
+
+    gStats.num_buffers++;
+    gStats.total_size += size;
+    return buffer;
+}
+
+WindowBuffer* WindowBufferCreateFromMemory(WindowBufferType type, u32 size, void* data)
+{
+#ifdef TEST_WIN
+    return WindowBufferCreate(type, size, data);
+#else
+    u32 alignment = type == WINDOW_BUFFER_TYPE_VERTEX ? GX2_VERTEX_BUFFER_ALIGNMENT : GX2_INDEX_BUFFER_ALIGNMENT;
+    if (size == 0 || !data || ((uintptr_t)data & (alignment - 1)) != 0)
+        return NULL;
+
+    WindowBuffer* buffer = (WindowBuffer*)malloc(sizeof(WindowBuffer));
+    if (!buffer)
+        return NULL;
+
+    memset(buffer, 0, sizeof(WindowBuffer));
+    buffer->type = type;
+    buffer->mode = WINDOW_BUFFER_MODE_PERSISTENT;
+    buffer->size = size;
+    buffer->data = data;
+    buffer->external = true;
+
+    gStats.num_buffers++;
+    gStats.total_size += size;
+    return buffer;
+#endif
+}
+
+void WindowBufferFlush(WindowBuffer* buffer, u32 offset, u32 size)
+{
+    if (offset >= buffer->size || size == 0)
+        return;
+
+    if (size > buffer->size - offset)
+        size = buffer->size - offset;
+
+    gStats.flushed_bytes += size;
+
+#ifdef TEST_WIN
+    // Persistent coherent mappings need no flush, and client index buffers are read by the draws
+    if (buffer->mode == WINDOW_BUFFER_MODE_COPY)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, (const u8*)buffer->data + offset);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+
+        gStats.copied_bytes += size;
+    }
+
+    // The Wii U contract: the range is flushed from the CPU cache and the vertex cache invalidated
+    COHERENCY_INVALIDATE(COHERENCY_CACHE_CPU | COHERENCY_CACHE_ATTRIBUTE_BUFFER, (u8*)buffer->data + offset, size);
+#else
+    // Flush the range from the CPU cache and invalidate the GPU vertex cache
+    // (index buffers are read through the same cache)
+    GX2Invalidate(GX2_INVALIDATE_MODE_CPU_ATTRIBUTE_BUFFER, (u8*)buffer->data + offset, size);
+#endif
+}
+
+void WindowSetVertexBuffer(u32 slot, const WindowBuffer* buffer, u32 stride)
+{
+#ifdef TEST_WIN
+    (void)slot;
+    (void)stride;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer->buffer);
+    COHERENCY_BIND(COHERENCY_BINDING_ATTRIB_BUFFER(slot), COHERENCY_CACHE_ATTRIBUTE_BUFFER, buffer->data, buffer->size);
+#else
+    GX2SetAttribBuffer(slot, buffer->size, stride, buffer->data);
+#endif
+}
+
+void WindowSetIndexBuffer(const WindowBuffer* buffer)
+{
+    gIndexBuffer = buffer;
+
+#ifdef TEST_WIN
+    // No buffer object in client mode: the indices are passed to each draw
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer->buffer);
+#endif
+}
+
+void WindowDrawIndexed(u32 count, u32 first)
+{
+    if (!gIndexBuffer)
+        return;
+
+    gStats.indexed_draws++;
+
+#ifdef TEST_WIN
+    if (gIndexBuffer->buffer != GL_NONE)
+    {
+        // Offset into the element buffer bound to the vertex array object
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (const void*)(uintptr_t)(first * sizeof(u32)));
+    }
+    else
+    {
+        // The driver copies the indices to the GPU during the call
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (const u32*)gIndexBuffer->data + first);
+        gStats.copied_bytes += count * sizeof(u32);
+    }
+
+    COHERENCY_GPU_READ(COHERENCY_CACHE_ATTRIBUTE_BUFFER, (const u32*)gIndexBuffer->data + first, count * sizeof(u32));
+    COHERENCY_DRAW();
+#else
+    // The GPU reads the indices straight from the buffer
+    GX2DrawIndexedEx(GX2_PRIMITIVE_MODE_TRIANGLES, count, GX2_INDEX_TYPE_U32, (const u32*)gIndexBuffer->data + first, 0, 1);
+#endif
+}
+
+void WindowGetBufferStats(WindowBufferStats* pStats)
+{
+    *pStats = gStats;
+}
+
+void WindowBufferDestroy(WindowBuffer* buffer)
+{
+    if (!buffer)
+        return;
+
+    if (gIndexBuffer == buffer)
+        gIndexBuffer = NULL;
+
+    COHERENCY_FORGET(buffer->data, buffer->size);
+
+#ifdef TEST_WIN
+
+    if (buffer->buffer != GL_NONE)
+    {
+        if (buffer->mode == WINDOW_BUFFER_MODE_PERSISTENT)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+        }
+        else
+        {
+            free(buffer->data);
+        }
+
+        // OpenGL keeps the buffer alive until the GPU is done with it
+        glDeleteBuffers(1, &buffer->buffer);
+    }
+    else
+    {
+        free(buffer->data);
+    }
+
+#else // TEST_GX2
+
+    if (buffer->data && !buffer->external)
+        MEMFreeToDefaultHeap(buffer->data);
+
+#endif
+
+    gStats.num_buffers--;
+    gStats.total_size -= buffer->size;
+    free(buffer);
+}
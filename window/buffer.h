@@ -0,0 +1,136 @@
+// Vertex and index buffers
+// Buffers are written in place by the CPU and read by the GPU from the same memory, like on Wii U:
+// the contents are written through WindowBuffer::data, then made visible with WindowBufferFlush
+// - Wii U: the buffer is in MEM2, shared between the CPU and GPU; flushing invalidates the caches
+// - PC: how the data reaches the GPU depends on the buffer mode (see WindowSetBufferMode), so that
+//       the upload cost of each path can be compared; by default, the buffer is persistently mapped
+//       (ARB_buffer_storage), which behaves like the Wii U shared memory
+// Like on Wii U, a persistently-mapped buffer must not be written while the GPU may still be reading
+// the data being overwritten (e.g. double-buffer dynamic data, or wait for the draws to be done)
+
+#ifndef BUFFER_H_
+#define BUFFER_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef enum WindowBufferType
+{
+    WINDOW_BUFFER_TYPE_VERTEX,  // Vertex attribute data
+    WINDOW_BUFFER_TYPE_INDEX    // 32-bit indices
+} WindowBufferType;
+
+// How buffer data reaches the GPU on PC (Wii U buffers are always in shared memory)
+typedef enum WindowBufferMode
+{
+    WINDOW_BUFFER_MODE_CLIENT,      // Index buffers stay in CPU memory and every indexed draw passes them
+                                    // as a client pointer, so they are copied to the GPU on every draw
+                                    // (vertex buffers use WINDOW_BUFFER_MODE_COPY, since the core profile
+                                    // has no client vertex arrays)
+    WINDOW_BUFFER_MODE_COPY,        // The data is written to a copy in CPU memory, and each flush copies
+                                    // it to a buffer object with glBufferSubData
+    WINDOW_BUFFER_MODE_PERSISTENT   // The buffer object is mapped persistently and coherently for its
+                                    // whole lifetime, and the data is written in place (default if
+                                    // ARB_buffer_storage is supported)
+} WindowBufferMode;
+
+// Buffer
+// Fields must not be modified by the user
+typedef struct WindowBuffer
+{
+    WindowBufferType type;
+    WindowBufferMode mode;      // Mode the buffer was created with
+    u32 size;                   // Size of the buffer in bytes
+    void* data;                 // Memory to write the contents to
+#ifdef TEST_WIN
+    u32 buffer;                 // Buffer object (0 for index buffers in WINDOW_BUFFER_MODE_CLIENT)
+#else
+    bool external;              // The data is owned by the caller (see WindowBufferCreateFromMemory)
+#endif // TEST_WIN
+} WindowBuffer;
+
+// Buffer statistics
+typedef struct WindowBufferStats
+{
+    u32 num_buffers;            // Buffers currently created
+    u32 total_size;             // Bytes of all buffers currently created
+    u64 flushed_bytes;          // Bytes made visible to the GPU with WindowBufferFlush
+    u64 copied_bytes;           // PC: bytes copied to the GPU (by flushes and client-pointer draws)
+    u32 indexed_draws;          // Indexed draws issued with WindowDrawIndexed
+} WindowBufferStats;
+
+// Set the mode of the buffers created afterwards (PC)
+// Existing buffers keep their mode, so buffers of every mode can be used side by side
+// Must be called after WindowInit; does nothing on Wii U
+// Parameters:
+// - mode: Buffer mode
+// Returns false if the mode is not supported (the mode is not changed)
+bool WindowSetBufferMode(WindowBufferMode mode);
+
+// Get the mode of the buffers created from now on
+WindowBufferMode WindowGetBufferMode();
+
+// Create a buffer
+// Parameters:
+// - type: Type of the buffer
+// - size: Size of the buffer in bytes
+// - data: Initial contents (NULL to leave them undefined)
+// Returns NULL if the buffer could not be allocated
+WindowBuffer* WindowBufferCreate(WindowBufferType type, u32 size, const void* data);
+
+// Create a buffer from contents already in memory
+// - Wii U: the buffer uses the memory in place, without copying it: it must be aligned to
+//          GX2_VERTEX_BUFFER_ALIGNMENT or GX2_INDEX_BUFFER_ALIGNMENT, flushed from the CPU cache, and
+//          outlive the buffer (e.g. a loaded asset pack, see asset_pack.h)
+// - PC: same as WindowBufferCreate (the contents are copied to the buffer)
+// Parameters:
+// - type: Type of the buffer
+// - size: Size of the buffer in bytes
+// - data: Contents
+// Returns NULL if the buffer could not be allocated, or if the memory is not aligned (Wii U)
+WindowBuffer* WindowBufferCreateFromMemory(WindowBufferType type, u32 size, void* data);
+
+// Make the contents written to a range of the buffer visible to the GPU
+// Parameters:
+// - buffer: The buffer
+// - offset, size: Range written, in bytes
+void WindowBufferFlush(WindowBuffer* buffer, u32 offset, u32 size);
+
+// Use a vertex buffer for an attribute buffer slot
+// - Wii U: sets the attribute buffer of the slot
+// - PC: binds the buffer to GL_ARRAY_BUFFER, for the glVertexAttribPointer calls that use the slot
+//       (the slot and stride are given to glVertexAttribPointer instead)
+// Parameters:
+// - slot: Attribute buffer slot
+// - buffer: Vertex buffer
+// - stride: Size of each vertex in bytes
+void WindowSetVertexBuffer(u32 slot, const WindowBuffer* buffer, u32 stride);
+
+// Use an index buffer for the next indexed draws
+// On PC, the buffer object is bound to the current vertex array object, which remembers it
+// Parameters:
+// - buffer: Index buffer
+void WindowSetIndexBuffer(const WindowBuffer* buffer);
+
+// Draw indexed triangles with the current index buffer
+// Parameters:
+// - count: Number of indices
+// - first: First index
+void WindowDrawIndexed(u32 count, u32 first);
+
+// Get buffer statistics
+void WindowGetBufferStats(WindowBufferStats* pStats);
+
+// Free a buffer
+// On Wii U, the GPU must be done with it
+void WindowBufferDestroy(WindowBuffer* buffer);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // BUFFER_H_
@@ -0,0 +1,1250 @@
+// API call capture
+
+#include "capture.h"
+#include "capture_format.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <thread>
+
+static std::thread gWriterThread;
+
+#else // TEST_GX2
+
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+#include <gx2/clear.h>
+#include <gx2/draw.h>
+#include <gx2/mem.h>
+#include <gx2/registers.h>
+
+// Stack size of the writer thread
+#define CAPTURE_WRITER_STACK_SIZE 0x8000
+
+static OSThread* gWriterThread = NULL;
+static void* gWriterStack = NULL;
+
+#endif
+
+// Time the writer thread sleeps when the ring is empty, in milliseconds
+#define CAPTURE_WRITE_INTERVAL_MS 10
+
+// Time a wrapper sleeps while the ring is full, in milliseconds
+#define CAPTURE_STALL_INTERVAL_MS 1
+
+// Index mask of the ring buffer
+#define CAPTURE_RING_MASK (CAPTURE_RING_SIZE - 1)
+
+static_assert((CAPTURE_RING_SIZE & CAPTURE_RING_MASK) == 0, "CAPTURE_RING_SIZE must be a power of two");
+
+// Sizes of the hash tables of objects (buffers and shaders) and of contents (powers of two)
+// The tables are filled up to three quarters: past that, new objects are recorded with id 0 and new
+// contents are recorded every time they are used
+#define CAPTURE_MAX_OBJECTS  4096
+#define CAPTURE_MAX_CONTENTS 16384
+
+// Object the wrappers have given an id
+struct CaptureObject
+{
+    const void* key;            // Address of the object (NULL: free slot)
+    u32 id;                     // 0 once the object has been destroyed
+};
+
+// Contents recorded in a CAPTURE_OP_DATA record
+struct CaptureContent
+{
+    u64 hash;
+    u32 size;
+    u32 id;                     // 0: free slot
+};
+
+// Ring buffer, written by the wrappers and read by the writer thread
+static u8* gRing = NULL;
+static std::atomic<u32> gHead(0);   // Bytes recorded (wraps around)
+static std::atomic<u32> gTail(0);   // Bytes written to the file (wraps around)
+
+static std::atomic<bool> gQuit(false);
+static std::atomic<u64> gWritten(0);
+
+// Capture file, only accessed by the writer thread (and by CaptureInit/CaptureExit when it is not running)
+static FILE* gFile = NULL;
+
+// State of the wrappers, only accessed by the rendering thread
+static bool gEnabled = false;
+static CaptureStats gStats;
+static CaptureObject* gObjects = NULL;
+static u32 gNumObjects = 0;
+static u32 gNextObjectId = 1;
+static CaptureContent* gContents = NULL;
+static u32 gNumContents = 0;
+static u32 gNextDataId = 1;
+static f64 gFrameStartTime = 0.0;
+
+static void CaptureSleep(u32 ms)
+{
+#ifdef TEST_WIN
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+#else
+    OSSleepTicks(OSMillisecondsToTicks(ms));
+#endif
+}
+
+// Copy bytes into the ring, waiting for the writer thread when it is full
+static void CaptureWrite(const void* data, u32 size)
+{
+    const u8* src = (const u8*)data;
+    bool stalled = false;
+
+    gStats.bytes += size;
+
+    while (size > 0)
+    {
+        // Only this thread writes head, and only the writer thread writes tail
+        u32 head = gHead.load(std::memory_order_relaxed);
+        u32 space = CAPTURE_RING_SIZE - (head - gTail.load(std::memory_order_acquire));
+        if (space == 0)
+        {
+            if (!stalled)
+                gStats.stalls++;
+            stalled = true;
+
+            CaptureSleep(CAPTURE_STALL_INTERVAL_MS);
+            continue;
+        }
+
+        // Up to the end of the ring at most
+        u32 chunk = CAPTURE_RING_SIZE - (head & CAPTURE_RING_MASK);
+        if (chunk > space)
+            chunk = space;
+        if (chunk > size)
+            chunk = size;
+
+        memcpy(gRing + (head & CAPTURE_RING_MASK), src, chunk);
+
+        // Publish the bytes to the writer thread
+        gHead.store(head + chunk, std::memory_order_release);
+
+        src += chunk;
+        size -= chunk;
+    }
+}
+
+// Start a record (its num_words argument words must follow)
+static inline void CaptureBeginRecord(CaptureOp op, u32 num_words)
+{
+    u32 word = CAPTURE_RECORD(op, num_words);
+    CaptureWrite(&word, sizeof(word));
+}
+
+// Write a record with its arguments
+static inline void CaptureRecord(CaptureOp op, const u32* args, u32 num_args)
+{
+    CaptureBeginRecord(op, num_args);
+    if (num_args > 0)
+        CaptureWrite(args, num_args * sizeof(u32));
+}
+
+static inline u32 CaptureFloatBits(f32 value)
+{
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// 64-bit FNV-1a, eight bytes at a time
+static u64 CaptureHash(const void* data, u32 size)
+{
+    const u8* bytes = (const u8*)data;
+    u64 hash = 0xCBF29CE484222325ull ^ size;
+
+    for (; size >= 8; size -= 8, bytes += 8)
+    {
+        u64 word;
+        memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+    }
+
+    for (; size > 0; size--, bytes++)
+        hash = (hash ^ *bytes) * 0x100000001B3ull;
+
+    return hash;
+}
+
+// Record contents, unless the same contents were recorded before
+// Returns the id of the data record (0 for no contents)
+static u32 CaptureData(const void* data, u32 size)
+{
+    if (!data || size == 0)
+        return 0;
+
+    u64 hash = CaptureHash(data, size);
+    u32 index = (u32)hash & (CAPTURE_MAX_CONTENTS - 1);
+
+    CaptureContent* content;
+    for (;; index = (index + 1) & (CAPTURE_MAX_CONTENTS - 1))
+    {
+        content = &gContents[index];
+        if (content->id == 0)
+            break;
+
+        if (content->hash == hash && content->size == size)
+        {
+            gStats.deduplicated_bytes += size;
+            return content->id;
+        }
+    }
+
+    u32 id = gNextDataId++;
+    if (gNumContents < CAPTURE_MAX_CONTENTS / 4 * 3)
+    {
+        content->hash = hash;
+        content->size = size;
+        content->id = id;
+        gNumContents++;
+    }
+
+    u32 words = CAPTURE_DATA_WORDS(size);
+    u32 args[2] = { id, size };
+    CaptureBeginRecord(CAPTURE_OP_DATA, 2 + words);
+    CaptureWrite(args, sizeof(args));
+    CaptureWrite(data, size);
+
+    static const u8 padding[4] = { 0, 0, 0, 0 };
+    CaptureWrite(padding, words * 4 - size);
+
+    gStats.data_bytes += size;
+    return id;
+}
+
+// Find the slot of an object, or the free slot it would take
+static CaptureObject* CaptureFindObject(const void* key)
+{
+    u32 index = (u32)(((uintptr_t)key >> 4) * 0x9E3779B1u) & (CAPTURE_MAX_OBJECTS - 1);
+    for (;; index = (index + 1) & (CAPTURE_MAX_OBJECTS - 1))
+    {
+        CaptureObject* object = &gObjects[index];
+        if (object->key == key || object->key == NULL)
+            return object;
+    }
+}
+
+// Get the id of an object (0 if the wrappers have not seen it)
+static u32 CaptureGetObjectId(const void* key)
+{
+    if (!key)
+        return 0;
+
+    return CaptureFindObject(key)->id;
+}
+
+// Give an object a new id (objects created at the address of a destroyed one keep its slot)
+static u32 CaptureNewObjectId(const void* key)
+{
+    CaptureObject* object = CaptureFindObject(key);
+    if (object->key == NULL)
+    {
+        if (gNumObjects >= CAPTURE_MAX_OBJECTS / 4 * 3)
+            return 0;
+
+        object->key = key;
+        gNumObjects++;
+    }
+
+    object->id = gNextObjectId++;
+    return object->id;
+}
+
+static void CaptureForgetObject(const void* key)
+{
+    if (key)
+        CaptureFindObject(key)->id = 0;
+}
+
+// Write the bytes recorded since the last drain
+// Returns false if there was nothing to write
+static bool CaptureDrain()
+{
+    u32 tail = gTail.load(std::memory_order_relaxed);
+    u32 head = gHead.load(std::memory_order_acquire);
+    if (tail == head)
+        return false;
+
+    while (tail != head)
+    {
+        // Up to the end of the ring at most
+        u32 chunk = CAPTURE_RING_SIZE - (tail & CAPTURE_RING_MASK);
+        if (chunk > head - tail)
+            chunk = head - tail;
+
+        fwrite(gRing + (tail & CAPTURE_RING_MASK), 1, chunk, gFile);
+        tail += chunk;
+
+        // Hand the space back to the wrappers
+        gTail.store(tail, std::memory_order_release);
+        gWritten.fetch_add(chunk, std::memory_order_relaxed);
+    }
+
+    return true;
+}
+
+static void CaptureWriterLoop()
+{
+    while (!gQuit.load())
+    {
+        if (!CaptureDrain())
+            CaptureSleep(CAPTURE_WRITE_INTERVAL_MS);
+    }
+}
+
+#ifdef TEST_GX2
+
+static int CaptureWriterMain(int argc, const char** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    CaptureWriterLoop();
+    return 0;
+}
+
+#endif
+
+static void CaptureFreeTables()
+{
+    free(gRing);
+    free(gObjects);
+    free(gContents);
+    gRing = NULL;
+    gObjects = NULL;
+    gContents = NULL;
+}
+
+bool CaptureInit(const char* path)
+{
+    if (gFile)
+        return false;
+
+    // Zero-initialized, which marks every slot as free
+    gRing = (u8*)malloc(CAPTURE_RING_SIZE);
+    gObjects = (CaptureObject*)calloc(CAPTURE_MAX_OBJECTS, sizeof(CaptureObject));
+    gContents = (CaptureContent*)calloc(CAPTURE_MAX_CONTENTS, sizeof(CaptureContent));
+    if (!gRing || !gObjects || !gContents)
+    {
+        CaptureFreeTables();
+        return false;
+    }
+
+    gFile = fopen(path, "wb");
+    if (!gFile)
+    {
+        CaptureFreeTables();
+        return false;
+    }
+
+    memset(&gStats, 0, sizeof(gStats));
+    gNumObjects = 0;
+    gNextObjectId = 1;
+    gNumContents = 0;
+    gNextDataId = 1;
+    gHead.store(0);
+    gTail.store(0);
+    gWritten.store(0);
+    gQuit.store(false);
+
+    CaptureHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CAPTURE_MAGIC;
+    header.version = CAPTURE_VERSION;
+#ifdef TEST_WIN
+    header.platform = CAPTURE_PLATFORM_PC;
+#else
+    header.platform = CAPTURE_PLATFORM_WIIU;
+#endif
+    CaptureWrite(&header, sizeof(header));
+
+#ifdef TEST_WIN
+
+    gWriterThread = std::thread(CaptureWriterLoop);
+
+#else // TEST_GX2
+
+    // OSThread instances must be 8-byte aligned, stacks 16-byte aligned
+    gWriterThread = (OSThread*)MEMAllocFromDefaultHeapEx(sizeof(OSThread), 8);
+    gWriterStack = MEMAllocFromDefaultHeapEx(CAPTURE_WRITER_STACK_SIZE, 16);
+
+    // Low priority (high value) on the last core, like the trace writer
+    if (!gWriterThread || !gWriterStack ||
+        !OSCreateThread(gWriterThread, CaptureWriterMain, 0, NULL,
+                        (u8*)gWriterStack + CAPTURE_WRITER_STACK_SIZE, CAPTURE_WRITER_STACK_SIZE, 30, OS_THREAD_ATTRIB_AFFINITY_CPU2))
+    {
+        if (gWriterThread)
+            MEMFreeToDefaultHeap(gWriterThread);
+        if (gWriterStack)
+            MEMFreeToDefaultHeap(gWriterStack);
+        gWriterThread = NULL;
+        gWriterStack = NULL;
+
+        fclose(gFile);
+        gFile = NULL;
+        CaptureFreeTables();
+        return false;
+    }
+
+    OSSetThreadName(gWriterThread, "Capture writer");
+    OSResumeThread(gWriterThread);
+
+#endif
+
+    gFrameStartTime = WindowGetTime();
+    gEnabled = true;
+    return true;
+}
+
+void CaptureGetStats(CaptureStats* pStats)
+{
+    *pStats = gStats;
+    pStats->written = gWritten.load(std::memory_order_relaxed);
+}
+
+void CaptureExit()
+{
+    if (!gFile)
+        return;
+
+    gEnabled = false;
+    gQuit.store(true);
+
+#ifdef TEST_WIN
+
+    gWriterThread.join();
+
+#else // TEST_GX2
+
+    OSJoinThread(gWriterThread, NULL);
+
+    MEMFreeToDefaultHeap(gWriterThread);
+    MEMFreeToDefaultHeap(gWriterStack);
+    gWriterThread = NULL;
+    gWriterStack = NULL;
+
+#endif
+
+    // Records made after the last drain
+    CaptureDrain();
+
+    fclose(gFile);
+    gFile = NULL;
+
+    gStats.written = gWritten.load();
+    CaptureFreeTables();
+}
+
+/*        Window* API        */
+
+bool CaptureWindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
+{
+    bool success = WindowInit(width, height, pWidth, pHeight);
+
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[5] = { width, height, success ? *pWidth : 0, success ? *pHeight : 0, success ? 1u : 0u };
+        CaptureRecord(CAPTURE_OP_WINDOW_INIT, args, 5);
+        gFrameStartTime = WindowGetTime();
+    }
+
+    return success;
+}
+
+void CaptureWindowExit()
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_WINDOW_EXIT, NULL, 0);
+    }
+
+    WindowExit();
+}
+
+void CaptureWindowSwapBuffers()
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { gStats.frames++, (u32)((WindowGetTime() - gFrameStartTime) * 1000000.0) };
+        CaptureRecord(CAPTURE_OP_FRAME, args, 2);
+    }
+
+    WindowSwapBuffers();
+
+    gFrameStartTime = WindowGetTime();
+}
+
+void CaptureWindowMakeContextCurrent()
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_MAKE_CONTEXT_CURRENT, NULL, 0);
+    }
+
+    WindowMakeContextCurrent();
+}
+
+void CaptureWindowSetSwapInterval(u32 swap_interval)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_SET_SWAP_INTERVAL, &swap_interval, 1);
+    }
+
+    WindowSetSwapInterval(swap_interval);
+}
+
+bool CaptureWindowSetBufferMode(WindowBufferMode mode)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 arg = mode;
+        CaptureRecord(CAPTURE_OP_SET_BUFFER_MODE, &arg, 1);
+    }
+
+    return WindowSetBufferMode(mode);
+}
+
+// Record the creation of a buffer, with its initial contents
+static void CaptureBufferCreate(const WindowBuffer* buffer, WindowBufferType type, u32 size, const void* data)
+{
+    gStats.calls++;
+    if (!buffer)
+        return;
+
+    u32 id = CaptureNewObjectId(buffer);
+    u32 args[4] = { id, (u32)type, size, CaptureData(data, size) };
+    CaptureRecord(CAPTURE_OP_BUFFER_CREATE, args, 4);
+}
+
+WindowBuffer* CaptureWindowBufferCreate(WindowBufferType type, u32 size, const void* data)
+{
+    WindowBuffer* buffer = WindowBufferCreate(type, size, data);
+
+    if (gEnabled)
+        CaptureBufferCreate(buffer, type, size, data);
+
+    return buffer;
+}
+
+WindowBuffer* CaptureWindowBufferCreateFromMemory(WindowBufferType type, u32 size, void* data)
+{
+    WindowBuffer* buffer = WindowBufferCreateFromMemory(type, size, data);
+
+    // Replayed as a buffer of its own, with the contents the memory had at creation
+    if (gEnabled)
+        CaptureBufferCreate(buffer, type, size, data);
+
+    return buffer;
+}
+
+void CaptureWindowBufferFlush(WindowBuffer* buffer, u32 offset, u32 size)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[4] = { CaptureGetObjectId(buffer), offset, size, CaptureData((const u8*)buffer->data + offset, size) };
+        CaptureRecord(CAPTURE_OP_BUFFER_FLUSH, args, 4);
+    }
+
+    WindowBufferFlush(buffer, offset, size);
+}
+
+void CaptureWindowBufferDestroy(WindowBuffer* buffer)
+{
+    if (gEnabled && buffer)
+    {
+        gStats.calls++;
+        u32 id = CaptureGetObjectId(buffer);
+        CaptureRecord(CAPTURE_OP_BUFFER_DESTROY, &id, 1);
+        CaptureForgetObject(buffer);
+    }
+
+    WindowBufferDestroy(buffer);
+}
+
+void CaptureWindowSetVertexBuffer(u32 slot, const WindowBuffer* buffer, u32 stride)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[3] = { slot, CaptureGetObjectId(buffer), stride };
+        CaptureRecord(CAPTURE_OP_SET_VERTEX_BUFFER, args, 3);
+    }
+
+    WindowSetVertexBuffer(slot, buffer, stride);
+}
+
+void CaptureWindowSetIndexBuffer(const WindowBuffer* buffer)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 id = CaptureGetObjectId(buffer);
+        CaptureRecord(CAPTURE_OP_SET_INDEX_BUFFER, &id, 1);
+    }
+
+    WindowSetIndexBuffer(buffer);
+}
+
+void CaptureWindowDrawIndexed(u32 count, u32 first)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { count, first };
+        CaptureRecord(CAPTURE_OP_DRAW_INDEXED, args, 2);
+    }
+
+    WindowDrawIndexed(count, first);
+}
+
+#ifdef TEST_GX2
+
+/*        GX2        */
+
+static u32 CaptureGetPrimitive(GX2PrimitiveMode mode)
+{
+    switch (mode)
+    {
+    case GX2_PRIMITIVE_MODE_POINTS:         return CAPTURE_PRIMITIVE_POINTS;
+    case GX2_PRIMITIVE_MODE_LINES:          return CAPTURE_PRIMITIVE_LINES;
+    case GX2_PRIMITIVE_MODE_LINE_STRIP:     return CAPTURE_PRIMITIVE_LINE_STRIP;
+    case GX2_PRIMITIVE_MODE_TRIANGLES:      return CAPTURE_PRIMITIVE_TRIANGLES;
+    case GX2_PRIMITIVE_MODE_TRIANGLE_FAN:   return CAPTURE_PRIMITIVE_TRIANGLE_FAN;
+    case GX2_PRIMITIVE_MODE_TRIANGLE_STRIP: return CAPTURE_PRIMITIVE_TRIANGLE_STRIP;
+    default:                                return CAPTURE_PRIMITIVE_UNSUPPORTED;
+    }
+}
+
+static u32 CaptureGetPolygonMode(GX2PolygonMode mode)
+{
+    switch (mode)
+    {
+    case GX2_POLYGON_MODE_POINT: return CAPTURE_POLYGON_POINT;
+    case GX2_POLYGON_MODE_LINE:  return CAPTURE_POLYGON_LINE;
+    default:                     return CAPTURE_POLYGON_FILL;
+    }
+}
+
+// Describe an attribute stream with OpenGL types
+static void CaptureGetAttrib(const GX2AttribStream* stream, CaptureAttrib* attrib)
+{
+    memset(attrib, 0, sizeof(CaptureAttrib));
+    attrib->location = stream->location;
+    attrib->buffer = stream->buffer;
+    attrib->offset = stream->offset;
+    attrib->divisor = stream->type == GX2_ATTRIB_INDEX_PER_INSTANCE ? stream->aluDivisor : 0;
+
+    u32 element_size = 4;
+    switch (stream->format)
+    {
+    case GX2_ATTRIB_FORMAT_FLOAT_32:          attrib->components = 1; attrib->type = CAPTURE_TYPE_FLOAT; break;
+    case GX2_ATTRIB_FORMAT_FLOAT_32_32:       attrib->components = 2; attrib->type = CAPTURE_TYPE_FLOAT; break;
+    case GX2_ATTRIB_FORMAT_FLOAT_32_32_32:    attrib->components = 3; attrib->type = CAPTURE_TYPE_FLOAT; break;
+    case GX2_ATTRIB_FORMAT_FLOAT_32_32_32_32: attrib->components = 4; attrib->type = CAPTURE_TYPE_FLOAT; break;
+    case GX2_ATTRIB_FORMAT_UNORM_8_8_8_8:
+        attrib->components = 4;
+        attrib->type = CAPTURE_TYPE_UNSIGNED_BYTE;
+        attrib->normalized = 1;
+        element_size = 1;
+        break;
+    default:
+        // Not replayed
+        break;
+    }
+
+    switch (stream->endianSwap)
+    {
+    case GX2_ENDIAN_SWAP_DEFAULT:  attrib->swap_size = element_size; break;
+    case GX2_ENDIAN_SWAP_8_IN_16:  attrib->swap_size = 2; break;
+    case GX2_ENDIAN_SWAP_8_IN_32:  attrib->swap_size = 4; break;
+    default:                       attrib->swap_size = 1; break;
+    }
+}
+
+void CaptureGX2ClearColor(GX2ColorBuffer* buffer, f32 r, f32 g, f32 b, f32 a)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[5] = {
+            buffer == WindowGetColorBuffer() ? 1u : 0u,
+            CaptureFloatBits(r), CaptureFloatBits(g), CaptureFloatBits(b), CaptureFloatBits(a)
+        };
+        CaptureRecord(CAPTURE_OP_GX2_CLEAR_COLOR, args, 5);
+    }
+
+    GX2ClearColor(buffer, r, g, b, a);
+}
+
+void CaptureGX2ClearDepthStencilEx(GX2DepthBuffer* buffer, f32 depth, u8 stencil, GX2ClearFlags flags)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[4] = { buffer == WindowGetDepthBuffer() ? 1u : 0u, CaptureFloatBits(depth), stencil, (u32)flags };
+        CaptureRecord(CAPTURE_OP_GX2_CLEAR_DEPTH_STENCIL, args, 4);
+    }
+
+    GX2ClearDepthStencilEx(buffer, depth, stencil, flags);
+}
+
+void CaptureGX2SetShaderModeEx(GX2ShaderMode mode, u32 num_vs_gpr, u32 num_vs_stack_entries, u32 num_gs_gpr,
+                               u32 num_gs_stack_entries, u32 num_ps_gpr, u32 num_ps_stack_entries)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[7] = {
+            (u32)mode, num_vs_gpr, num_vs_stack_entries, num_gs_gpr, num_gs_stack_entries, num_ps_gpr, num_ps_stack_entries
+        };
+        CaptureRecord(CAPTURE_OP_GX2_SET_SHADER_MODE, args, 7);
+    }
+
+    GX2SetShaderModeEx(mode, num_vs_gpr, num_vs_stack_entries, num_gs_gpr, num_gs_stack_entries, num_ps_gpr, num_ps_stack_entries);
+}
+
+void CaptureGX2InitFetchShaderEx(GX2FetchShader* shader, u8* program, u32 count, const GX2AttribStream* attribs,
+                                 GX2FetchShaderType type, GX2TessellationMode tess_mode)
+{
+    GX2InitFetchShaderEx(shader, program, count, attribs, type, tess_mode);
+
+    // The attribute streams are only known here: the fetch shader program encodes them
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { CaptureNewObjectId(shader), count };
+        CaptureBeginRecord(CAPTURE_OP_GX2_FETCH_SHADER, 2 + count * (sizeof(CaptureAttrib) / sizeof(u32)));
+        CaptureWrite(args, sizeof(args));
+
+        for (u32 i = 0; i < count; i++)
+        {
+            CaptureAttrib attrib;
+            CaptureGetAttrib(&attribs[i], &attrib);
+            CaptureWrite(&attrib, sizeof(attrib));
+        }
+    }
+}
+
+// Record the program of a vertex or pixel shader the first time it is set
+static u32 CaptureGetShaderId(const void* shader, CaptureShaderStage stage, const void* program, u32 size)
+{
+    u32 id = CaptureGetObjectId(shader);
+    if (id == 0 && shader)
+    {
+        id = CaptureNewObjectId(shader);
+        if (id != 0)
+        {
+            u32 args[3] = { id, (u32)stage, CaptureData(program, size) };
+            CaptureRecord(CAPTURE_OP_GX2_SHADER, args, 3);
+        }
+    }
+
+    return id;
+}
+
+void CaptureGX2SetFetchShader(const GX2FetchShader* shader)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { CAPTURE_SHADER_FETCH, CaptureGetObjectId(shader) };
+        CaptureRecord(CAPTURE_OP_GX2_SET_SHADER, args, 2);
+    }
+
+    GX2SetFetchShader(shader);
+}
+
+void CaptureGX2SetVertexShader(const GX2VertexShader* shader)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { CAPTURE_SHADER_VERTEX, CaptureGetShaderId(shader, CAPTURE_SHADER_VERTEX, shader->program, shader->size) };
+        CaptureRecord(CAPTURE_OP_GX2_SET_SHADER, args, 2);
+    }
+
+    GX2SetVertexShader(shader);
+}
+
+void CaptureGX2SetPixelShader(const GX2PixelShader* shader)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { CAPTURE_SHADER_PIXEL, CaptureGetShaderId(shader, CAPTURE_SHADER_PIXEL, shader->program, shader->size) };
+        CaptureRecord(CAPTURE_OP_GX2_SET_SHADER, args, 2);
+    }
+
+    GX2SetPixelShader(shader);
+}
+
+void CaptureGX2SetAttribBuffer(u32 index, u32 size, u32 stride, const void* buffer)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[4] = { index, size, stride, CaptureData(buffer, size) };
+        CaptureRecord(CAPTURE_OP_GX2_SET_ATTRIB_BUFFER, args, 4);
+    }
+
+    GX2SetAttribBuffer(index, size, stride, buffer);
+}
+
+void CaptureGX2DrawEx(GX2PrimitiveMode mode, u32 count, u32 offset, u32 num_instances)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[4] = { CaptureGetPrimitive(mode), count, offset, num_instances };
+        CaptureRecord(CAPTURE_OP_GX2_DRAW, args, 4);
+    }
+
+    GX2DrawEx(mode, count, offset, num_instances);
+}
+
+void CaptureGX2DrawIndexedEx(GX2PrimitiveMode mode, u32 count, GX2IndexType index_type, const void* indices,
+                             u32 offset, u32 num_instances)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 index_size = (index_type == GX2_INDEX_TYPE_U16 || index_type == GX2_INDEX_TYPE_U16_LE) ? 2 : 4;
+        u32 little_endian = (index_type == GX2_INDEX_TYPE_U16_LE || index_type == GX2_INDEX_TYPE_U32_LE) ? 1 : 0;
+        u32 args[7] = {
+            CaptureGetPrimitive(mode), count, index_size, little_endian,
+            CaptureData(indices, count * index_size), offset, num_instances
+        };
+        CaptureRecord(CAPTURE_OP_GX2_DRAW_INDEXED, args, 7);
+    }
+
+    GX2DrawIndexedEx(mode, count, index_type, indices, offset, num_instances);
+}
+
+void CaptureGX2Invalidate(GX2InvalidateMode mode, void* buffer, u32 size)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { (u32)mode, size };
+        CaptureRecord(CAPTURE_OP_GX2_INVALIDATE, args, 2);
+    }
+
+    GX2Invalidate(mode, buffer, size);
+}
+
+void CaptureGX2SetPolygonControl(GX2FrontFace front_face, BOOL cull_front, BOOL cull_back, BOOL poly_mode,
+                                 GX2PolygonMode mode_front, GX2PolygonMode mode_back, BOOL poly_offset_front,
+                                 BOOL poly_offset_back, BOOL point_line_offset)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[9] = {
+            (u32)front_face, (u32)cull_front, (u32)cull_back, (u32)poly_mode,
+            CaptureGetPolygonMode(mode_front), CaptureGetPolygonMode(mode_back),
+            (u32)poly_offset_front, (u32)poly_offset_back, (u32)point_line_offset
+        };
+        CaptureRecord(CAPTURE_OP_GX2_SET_POLYGON_CONTROL, args, 9);
+    }
+
+    GX2SetPolygonControl(front_face, cull_front, cull_back, poly_mode, mode_front, mode_back,
+                         poly_offset_front, poly_offset_back, point_line_offset);
+}
+
+static void CaptureUniformReg(CaptureShaderStage stage, u32 offset, u32 count, const void* data)
+{
+    gStats.calls++;
+    u32 args[3] = { (u32)stage, offset, count };
+    CaptureBeginRecord(CAPTURE_OP_GX2_SET_UNIFORM_REG, 3 + count);
+    CaptureWrite(args, sizeof(args));
+    CaptureWrite(data, count * sizeof(u32));
+}
+
+void CaptureGX2SetVertexUniformReg(u32 offset, u32 count, const void* data)
+{
+    if (gEnabled)
+        CaptureUniformReg(CAPTURE_SHADER_VERTEX, offset, count, data);
+
+    GX2SetVertexUniformReg(offset, count, data);
+}
+
+void CaptureGX2SetPixelUniformReg(u32 offset, u32 count, const void* data)
+{
+    if (gEnabled)
+        CaptureUniformReg(CAPTURE_SHADER_PIXEL, offset, count, data);
+
+    GX2SetPixelUniformReg(offset, count, data);
+}
+
+#endif // TEST_GX2
+
+#ifdef TEST_WIN
+
+/*        OpenGL        */
+
+void CaptureGLClearColor(f32 r, f32 g, f32 b, f32 a)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[4] = { CaptureFloatBits(r), CaptureFloatBits(g), CaptureFloatBits(b), CaptureFloatBits(a) };
+        CaptureRecord(CAPTURE_OP_GL_CLEAR_COLOR, args, 4);
+    }
+
+    glClearColor(r, g, b, a);
+}
+
+void CaptureGLClear(u32 mask)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_GL_CLEAR, &mask, 1);
+    }
+
+    glClear(mask);
+}
+
+void CaptureGLViewport(s32 x, s32 y, s32 width, s32 height)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[4] = { (u32)x, (u32)y, (u32)width, (u32)height };
+        CaptureRecord(CAPTURE_OP_GL_VIEWPORT, args, 4);
+    }
+
+    glViewport(x, y, width, height);
+}
+
+void CaptureGLPolygonMode(u32 face, u32 mode)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { face, mode };
+        CaptureRecord(CAPTURE_OP_GL_POLYGON_MODE, args, 2);
+    }
+
+    glPolygonMode(face, mode);
+}
+
+u32 CaptureGLCreateShader(u32 type)
+{
+    u32 shader = glCreateShader(type);
+
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { shader, type };
+        CaptureRecord(CAPTURE_OP_GL_CREATE_SHADER, args, 2);
+    }
+
+    return shader;
+}
+
+void CaptureGLShaderSource(u32 shader, s32 count, const char* const* string, const s32* length)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+
+        // The strings are joined into one source
+        u32 size = 0;
+        for (s32 i = 0; i < count; i++)
+            size += (length && length[i] >= 0) ? (u32)length[i] : (u32)strlen(string[i]);
+
+        char* source = (char*)malloc(size + 1);
+        u32 data = 0;
+        if (source)
+        {
+            char* dst = source;
+            for (s32 i = 0; i < count; i++)
+            {
+                u32 string_size = (length && length[i] >= 0) ? (u32)length[i] : (u32)strlen(string[i]);
+                memcpy(dst, string[i], string_size);
+                dst += string_size;
+            }
+
+            data = CaptureData(source, size);
+            free(source);
+        }
+
+        u32 args[2] = { shader, data };
+        CaptureRecord(CAPTURE_OP_GL_SHADER_SOURCE, args, 2);
+    }
+
+    glShaderSource(shader, count, string, length);
+}
+
+void CaptureGLCompileShader(u32 shader)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_GL_COMPILE_SHADER, &shader, 1);
+    }
+
+    glCompileShader(shader);
+}
+
+void CaptureGLDeleteShader(u32 shader)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_GL_DELETE_SHADER, &shader, 1);
+    }
+
+    glDeleteShader(shader);
+}
+
+u32 CaptureGLCreateProgram()
+{
+    u32 program = glCreateProgram();
+
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_GL_CREATE_PROGRAM, &program, 1);
+    }
+
+    return program;
+}
+
+void CaptureGLAttachShader(u32 program, u32 shader)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { program, shader };
+        CaptureRecord(CAPTURE_OP_GL_ATTACH_SHADER, args, 2);
+    }
+
+    glAttachShader(program, shader);
+}
+
+void CaptureGLLinkProgram(u32 program)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_GL_LINK_PROGRAM, &program, 1);
+    }
+
+    glLinkProgram(program);
+}
+
+void CaptureGLUseProgram(u32 program)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_GL_USE_PROGRAM, &program, 1);
+    }
+
+    glUseProgram(program);
+}
+
+void CaptureGLDeleteProgram(u32 program)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_GL_DELETE_PROGRAM, &program, 1);
+    }
+
+    glDeleteProgram(program);
+}
+
+void CaptureGLUniform4fv(s32 location, s32 count, const f32* value)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { (u32)location, (u32)count };
+        CaptureBeginRecord(CAPTURE_OP_GL_UNIFORM4FV, 2 + 4 * count);
+        CaptureWrite(args, sizeof(args));
+        CaptureWrite(value, 4 * count * sizeof(f32));
+    }
+
+    glUniform4fv(location, count, value);
+}
+
+void CaptureGLGenVertexArrays(s32 n, u32* arrays)
+{
+    glGenVertexArrays(n, arrays);
+
+    if (gEnabled)
+    {
+        gStats.calls++;
+        for (s32 i = 0; i < n; i++)
+            CaptureRecord(CAPTURE_OP_GL_GEN_VERTEX_ARRAY, &arrays[i], 1);
+    }
+}
+
+void CaptureGLBindVertexArray(u32 array)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_GL_BIND_VERTEX_ARRAY, &array, 1);
+    }
+
+    glBindVertexArray(array);
+}
+
+void CaptureGLDeleteVertexArrays(s32 n, const u32* arrays)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        for (s32 i = 0; i < n; i++)
+            CaptureRecord(CAPTURE_OP_GL_DELETE_VERTEX_ARRAY, &arrays[i], 1);
+    }
+
+    glDeleteVertexArrays(n, arrays);
+}
+
+void CaptureGLGenBuffers(s32 n, u32* buffers)
+{
+    glGenBuffers(n, buffers);
+
+    if (gEnabled)
+    {
+        gStats.calls++;
+        for (s32 i = 0; i < n; i++)
+            CaptureRecord(CAPTURE_OP_GL_GEN_BUFFER, &buffers[i], 1);
+    }
+}
+
+void CaptureGLBindBuffer(u32 target, u32 buffer)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[2] = { target, buffer };
+        CaptureRecord(CAPTURE_OP_GL_BIND_BUFFER, args, 2);
+    }
+
+    glBindBuffer(target, buffer);
+}
+
+void CaptureGLBufferData(u32 target, ptrdiff_t size, const void* data, u32 usage)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[4] = { target, (u32)size, CaptureData(data, (u32)size), usage };
+        CaptureRecord(CAPTURE_OP_GL_BUFFER_DATA, args, 4);
+    }
+
+    glBufferData(target, size, data, usage);
+}
+
+void CaptureGLBufferSubData(u32 target, ptrdiff_t offset, ptrdiff_t size, const void* data)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[4] = { target, (u32)offset, (u32)size, CaptureData(data, (u32)size) };
+        CaptureRecord(CAPTURE_OP_GL_BUFFER_SUB_DATA, args, 4);
+    }
+
+    glBufferSubData(target, offset, size, data);
+}
+
+void CaptureGLDeleteBuffers(s32 n, const u32* buffers)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        for (s32 i = 0; i < n; i++)
+            CaptureRecord(CAPTURE_OP_GL_DELETE_BUFFER, &buffers[i], 1);
+    }
+
+    glDeleteBuffers(n, buffers);
+}
+
+void CaptureGLEnableVertexAttribArray(u32 index)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        CaptureRecord(CAPTURE_OP_GL_ENABLE_ATTRIB_ARRAY, &index, 1);
+    }
+
+    glEnableVertexAttribArray(index);
+}
+
+void CaptureGLVertexAttribPointer(u32 index, s32 size, u32 type, u8 normalized, s32 stride, const void* pointer)
+{
+    // The pointer is an offset into the bound buffer (the core profile has no client vertex arrays)
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[6] = { index, (u32)size, type, normalized, (u32)stride, (u32)(uintptr_t)pointer };
+        CaptureRecord(CAPTURE_OP_GL_ATTRIB_POINTER, args, 6);
+    }
+
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void CaptureGLDrawArrays(u32 mode, s32 first, s32 count)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+        u32 args[3] = { mode, (u32)first, (u32)count };
+        CaptureRecord(CAPTURE_OP_GL_DRAW_ARRAYS, args, 3);
+    }
+
+    glDrawArrays(mode, first, count);
+}
+
+void CaptureGLDrawElements(u32 mode, s32 count, u32 type, const void* indices)
+{
+    if (gEnabled)
+    {
+        gStats.calls++;
+
+        // Without an element buffer, indices point to client memory, whose contents are recorded
+        GLint element_buffer = 0;
+        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &element_buffer);
+
+        u32 args[5] = { mode, (u32)count, type, 0, (u32)(uintptr_t)indices };
+        if (element_buffer == 0)
+        {
+            u32 index_size = type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT ? 2 : 4);
+            args[3] = 1;
+            args[4] = CaptureData(indices, count * index_size);
+        }
+        CaptureRecord(CAPTURE_OP_GL_DRAW_ELEMENTS, args, 5);
+    }
+
+    glDrawElements(mode, count, type, indices);
+}
+
+#endif // TEST_WIN
@@ -0,0 +1,148 @@
+// API call capture
+// Records the calls a program makes to the Window* API and to GX2 (Wii U) or OpenGL (PC), with the
+// contents of the buffers and shaders they reference, into a capture file (see capture_format.h)
+// The capture can be replayed headless on a PC with tools/capture_replay, as fast as possible, to
+// measure the cost of each call and each frame of a fixed workload: a slow frame captured on the
+// console can be replayed on every revision of the library to find where it regressed
+// - The calls are recorded by wrappers (Capture*), which make the call and record it; including
+//   capture_calls.h in a source file built with WINDOW_CAPTURE defined redirects the calls of that file
+//   to the wrappers, so the program itself does not change
+// - Records are written into a ring buffer and a background thread writes them to the file; if the
+//   writer falls behind and the ring is full, the calling thread waits (stalls are counted)
+// - Contents are hashed, and contents that were already recorded are referred to by id instead of
+//   being written again, so static data costs a hash per call after its first frame
+// The wrappers must be called from the rendering thread only
+// Objects the wrappers have not seen (e.g. created before CaptureInit, or by the library itself) are
+// recorded with id 0, and the replayer skips the calls using them
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include "buffer.h"
+
+#ifdef TEST_GX2
+#include <gx2/enum.h>
+#include <gx2/shaders.h>
+#include <gx2/surface.h>
+#endif // TEST_GX2
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Default path of the capture file (on the SD card on Wii U)
+#ifdef TEST_WIN
+#define CAPTURE_DEFAULT_PATH "capture.wcap"
+#else
+#define CAPTURE_DEFAULT_PATH "fs:/vol/external01/capture.wcap"
+#endif // TEST_WIN
+
+// Size of the ring buffer between the wrappers and the writer thread, in bytes (a power of two)
+#define CAPTURE_RING_SIZE (4 * 1024 * 1024)
+
+// Statistics of the capture
+typedef struct CaptureStats
+{
+    u64 calls;                  // Calls recorded
+    u32 frames;                 // Frames recorded (WindowSwapBuffers calls)
+    u64 bytes;                  // Bytes recorded (records and data)
+    u64 data_bytes;             // Bytes of contents recorded
+    u64 deduplicated_bytes;     // Bytes of contents referred to by id instead of being recorded again
+    u64 written;                // Bytes written to the file
+    u32 stalls;                 // Times a wrapper waited for the writer thread
+} CaptureStats;
+
+// Start capturing, and start the thread writing the capture file
+// Call it before WindowInit, so that the capture can be replayed from the start
+// Parameters:
+// - path: Path of the capture file
+// Returns false if capturing has already started or the file or thread could not be created
+bool CaptureInit(const char* path);
+
+// Get the statistics of the capture
+// Parameters:
+// - pStats: Output statistics
+void CaptureGetStats(CaptureStats* pStats);
+
+// Stop capturing, write the remaining records and close the capture file
+// Must be called before the program ends if CaptureInit succeeded (it stops the writer thread)
+void CaptureExit();
+
+// Wrappers of the Window* API
+bool CaptureWindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight);
+void CaptureWindowExit();
+void CaptureWindowSwapBuffers();
+void CaptureWindowMakeContextCurrent();
+void CaptureWindowSetSwapInterval(u32 swap_interval);
+bool CaptureWindowSetBufferMode(WindowBufferMode mode);
+WindowBuffer* CaptureWindowBufferCreate(WindowBufferType type, u32 size, const void* data);
+WindowBuffer* CaptureWindowBufferCreateFromMemory(WindowBufferType type, u32 size, void* data);
+void CaptureWindowBufferFlush(WindowBuffer* buffer, u32 offset, u32 size);
+void CaptureWindowBufferDestroy(WindowBuffer* buffer);
+void CaptureWindowSetVertexBuffer(u32 slot, const WindowBuffer* buffer, u32 stride);
+void CaptureWindowSetIndexBuffer(const WindowBuffer* buffer);
+void CaptureWindowDrawIndexed(u32 count, u32 first);
+
+#ifdef TEST_GX2
+
+// Wrappers of GX2
+void CaptureGX2ClearColor(GX2ColorBuffer* buffer, f32 r, f32 g, f32 b, f32 a);
+void CaptureGX2ClearDepthStencilEx(GX2DepthBuffer* buffer, f32 depth, u8 stencil, GX2ClearFlags flags);
+void CaptureGX2SetShaderModeEx(GX2ShaderMode mode, u32 num_vs_gpr, u32 num_vs_stack_entries, u32 num_gs_gpr,
+                               u32 num_gs_stack_entries, u32 num_ps_gpr, u32 num_ps_stack_entries);
+void CaptureGX2InitFetchShaderEx(GX2FetchShader* shader, u8* program, u32 count, const GX2AttribStream* attribs,
+                                 GX2FetchShaderType type, GX2TessellationMode tess_mode);
+void CaptureGX2SetFetchShader(const GX2FetchShader* shader);
+void CaptureGX2SetVertexShader(const GX2VertexShader* shader);
+void CaptureGX2SetPixelShader(const GX2PixelShader* shader);
+void CaptureGX2SetAttribBuffer(u32 index, u32 size, u32 stride, const void* buffer);
+void CaptureGX2DrawEx(GX2PrimitiveMode mode, u32 count, u32 offset, u32 num_instances);
+void CaptureGX2DrawIndexedEx(GX2PrimitiveMode mode, u32 count, GX2IndexType index_type, const void* indices,
+                             u32 offset, u32 num_instances);
+void CaptureGX2Invalidate(GX2InvalidateMode mode, void* buffer, u32 size);
+void CaptureGX2SetPolygonControl(GX2FrontFace front_face, BOOL cull_front, BOOL cull_back, BOOL poly_mode,
+                                 GX2PolygonMode mode_front, GX2PolygonMode mode_back, BOOL poly_offset_front,
+                                 BOOL poly_offset_back, BOOL point_line_offset);
+void CaptureGX2SetVertexUniformReg(u32 offset, u32 count, const void* data);
+void CaptureGX2SetPixelUniformReg(u32 offset, u32 count, const void* data);
+
+#endif // TEST_GX2
+
+#ifdef TEST_WIN
+
+// Wrappers of OpenGL (with the GL types spelled out, so that this header does not need GLEW)
+void CaptureGLClearColor(f32 r, f32 g, f32 b, f32 a);
+void CaptureGLClear(u32 mask);
+void CaptureGLViewport(s32 x, s32 y, s32 width, s32 height);
+void CaptureGLPolygonMode(u32 face, u32 mode);
+u32 CaptureGLCreateShader(u32 type);
+void CaptureGLShaderSource(u32 shader, s32 count, const char* const* string, const s32* length);
+void CaptureGLCompileShader(u32 shader);
+void CaptureGLDeleteShader(u32 shader);
+u32 CaptureGLCreateProgram();
+void CaptureGLAttachShader(u32 program, u32 shader);
+void CaptureGLLinkProgram(u32 program);
+void CaptureGLUseProgram(u32 program);
+void CaptureGLDeleteProgram(u32 program);
+void CaptureGLUniform4fv(s32 location, s32 count, const f32* value);
+void CaptureGLGenVertexArrays(s32 n, u32* arrays);
+void CaptureGLBindVertexArray(u32 array);
+void CaptureGLDeleteVertexArrays(s32 n, const u32* arrays);
+void CaptureGLGenBuffers(s32 n, u32* buffers);
+void CaptureGLBindBuffer(u32 target, u32 buffer);
+void CaptureGLBufferData(u32 target, ptrdiff_t size, const void* data, u32 usage);
+void CaptureGLBufferSubData(u32 target, ptrdiff_t offset, ptrdiff_t size, const void* data);
+void CaptureGLDeleteBuffers(s32 n, const u32* buffers);
+void CaptureGLEnableVertexAttribArray(u32 index);
+void CaptureGLVertexAttribPointer(u32 index, s32 size, u32 type, u8 normalized, s32 stride, const void* pointer);
+void CaptureGLDrawArrays(u32 mode, s32 first, s32 count);
+void CaptureGLDrawElements(u32 mode, s32 count, u32 type, const void* indices);
+
+#endif // TEST_WIN
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // CAPTURE_H_
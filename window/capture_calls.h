@@ -0,0 +1,107 @@
+// Redirects the calls of a source file to the capture wrappers (see capture.h)
+// Include it after the window, GX2 and OpenGL headers, in the source files whose calls should be
+// captured; it does nothing unless WINDOW_CAPTURE is defined, so it can stay included
+// (The library's own calls are not redirected: they are part of the calls being replayed)
+
+#ifndef CAPTURE_CALLS_H_
+#define CAPTURE_CALLS_H_
+
+#ifdef WINDOW_CAPTURE
+
+#include "capture.h"
+
+#define WindowInit                      CaptureWindowInit
+#define WindowExit                      CaptureWindowExit
+#define WindowSwapBuffers               CaptureWindowSwapBuffers
+#define WindowMakeContextCurrent        CaptureWindowMakeContextCurrent
+#define WindowSetSwapInterval           CaptureWindowSetSwapInterval
+#define WindowSetBufferMode             CaptureWindowSetBufferMode
+#define WindowBufferCreate              CaptureWindowBufferCreate
+#define WindowBufferCreateFromMemory    CaptureWindowBufferCreateFromMemory
+#define WindowBufferFlush               CaptureWindowBufferFlush
+#define WindowBufferDestroy             CaptureWindowBufferDestroy
+#define WindowSetVertexBuffer           CaptureWindowSetVertexBuffer
+#define WindowSetIndexBuffer            CaptureWindowSetIndexBuffer
+#define WindowDrawIndexed               CaptureWindowDrawIndexed
+
+#ifdef TEST_GX2
+
+#define GX2ClearColor                   CaptureGX2ClearColor
+#define GX2ClearDepthStencilEx          CaptureGX2ClearDepthStencilEx
+#define GX2SetShaderModeEx              CaptureGX2SetShaderModeEx
+#define GX2InitFetchShaderEx            CaptureGX2InitFetchShaderEx
+#define GX2SetFetchShader               CaptureGX2SetFetchShader
+#define GX2SetVertexShader              CaptureGX2SetVertexShader
+#define GX2SetPixelShader               CaptureGX2SetPixelShader
+#define GX2SetAttribBuffer              CaptureGX2SetAttribBuffer
+#define GX2DrawEx                       CaptureGX2DrawEx
+#define GX2DrawIndexedEx                CaptureGX2DrawIndexedEx
+#define GX2Invalidate                   CaptureGX2Invalidate
+#define GX2SetPolygonControl            CaptureGX2SetPolygonControl
+#define GX2SetVertexUniformReg          CaptureGX2SetVertexUniformReg
+#define GX2SetPixelUniformReg           CaptureGX2SetPixelUniformReg
+
+#endif // TEST_GX2
+
+#ifdef TEST_WIN
+
+// GLEW defines most of these as macros already
+#undef glClearColor
+#undef glClear
+#undef glViewport
+#undef glPolygonMode
+#undef glCreateShader
+#undef glShaderSource
+#undef glCompileShader
+#undef glDeleteShader
+#undef glCreateProgram
+#undef glAttachShader
+#undef glLinkProgram
+#undef glUseProgram
+#undef glDeleteProgram
+#undef glUniform4fv
+#undef glGenVertexArrays
+#undef glBindVertexArray
+#undef glDeleteVertexArrays
+#undef glGenBuffers
+#undef glBindBuffer
+#undef glBufferData
+#undef glBufferSubData
+#undef glDeleteBuffers
+#undef glEnableVertexAttribArray
+#undef glVertexAttribPointer
+#undef glDrawArrays
+#undef glDrawElements
+
+#define glClearColor                    CaptureGLClearColor
+#define glClear                         CaptureGLClear
+#define glViewport                      CaptureGLViewport
+#define glPolygonMode                   CaptureGLPolygonMode
+#define glCreateShader                  CaptureGLCreateShader
+#define glShaderSource                  CaptureGLShaderSource
+#define glCompileShader                 CaptureGLCompileShader
+#define glDeleteShader                  CaptureGLDeleteShader
+#define glCreateProgram                 CaptureGLCreateProgram
+#define glAttachShader                  CaptureGLAttachShader
+#define glLinkProgram                   CaptureGLLinkProgram
+#define glUseProgram                    CaptureGLUseProgram
+#define glDeleteProgram                 CaptureGLDeleteProgram
+#define glUniform4fv                    CaptureGLUniform4fv
+#define glGenVertexArrays               CaptureGLGenVertexArrays
+#define glBindVertexArray               CaptureGLBindVertexArray
+#define glDeleteVertexArrays            CaptureGLDeleteVertexArrays
+#define glGenBuffers                    CaptureGLGenBuffers
+#define glBindBuffer                    CaptureGLBindBuffer
+#define glBufferData                    CaptureGLBufferData
+#define glBufferSubData                 CaptureGLBufferSubData
+#define glDeleteBuffers                 CaptureGLDeleteBuffers
+#define glEnableVertexAttribArray       CaptureGLEnableVertexAttribArray
+#define glVertexAttribPointer           CaptureGLVertexAttribPointer
+#define glDrawArrays                    CaptureGLDrawArrays
+#define glDrawElements                  CaptureGLDrawElements
+
+#endif // TEST_WIN
+
+#endif // WINDOW_CAPTURE
+
+#endif // CAPTURE_CALLS_H_
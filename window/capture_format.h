@@ -0,0 +1,163 @@
+// API capture file format, shared by the capture layer (capture.h) and the replayer (tools/capture_replay)
+// A capture is a header followed by a stream of records, one per captured call, in the order of the
+// calls; each record is a word holding its opcode and the number of argument words that follow
+// - All words are in the byte order of the platform that wrote the capture (big-endian on Wii U):
+//   the replayer tells from the magic whether it has to swap them
+// - Contents referenced by calls (buffer data, index data, shader programs and sources) are written
+//   once in a CAPTURE_OP_DATA record and referred to by id afterwards: contents are hashed, so data that
+//   does not change between frames is only written once. The bytes of a data record are not swapped:
+//   they are the contents the call saw (e.g. big-endian vertex data on Wii U)
+// - Enumerations are stored with their OpenGL values (GX2 values are translated when capturing), so
+//   that captures of both platforms share the same opcodes where they can
+// This header only depends on test_types.h, so that host tools can include it
+
+#ifndef CAPTURE_FORMAT_H_
+#define CAPTURE_FORMAT_H_
+
+#include <test_types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#define CAPTURE_MAGIC   0x57434150  // "WCAP", in the byte order of the platform
+#define CAPTURE_VERSION 1
+
+// Record word: opcode in the low 8 bits, number of argument words in the upper 24 bits
+#define CAPTURE_RECORD(op, num_words)   ((u32)(op) | ((u32)(num_words) << 8))
+#define CAPTURE_RECORD_OP(word)         ((word) & 0xFF)
+#define CAPTURE_RECORD_WORDS(word)      ((word) >> 8)
+
+// Words needed for a number of bytes of data
+#define CAPTURE_DATA_WORDS(size)        (((size) + 3) / 4)
+
+typedef enum CapturePlatform
+{
+    CAPTURE_PLATFORM_WIIU,      // GX2 calls, big-endian data
+    CAPTURE_PLATFORM_PC,        // OpenGL calls, little-endian data
+    CAPTURE_PLATFORM_COUNT
+} CapturePlatform;
+
+typedef struct CaptureHeader
+{
+    u32 magic;
+    u32 version;
+    u32 platform;               // CapturePlatform
+    u32 timer_frequency;        // Unused, reserved for timestamps
+    u32 reserved[4];
+} CaptureHeader;
+
+// Opcodes, with their arguments (f: float bits, data: id of a CAPTURE_OP_DATA record, 0 for none)
+typedef enum CaptureOp
+{
+    CAPTURE_OP_DATA,                    // id, size in bytes, then the bytes (padded to a word)
+
+    // Window API (both platforms)
+    CAPTURE_OP_WINDOW_INIT,             // requested width, height, framebuffer width, height, success
+    CAPTURE_OP_WINDOW_EXIT,             //
+    CAPTURE_OP_FRAME,                   // frame number, CPU time of the frame in microseconds
+                                        // (written by WindowSwapBuffers, before swapping)
+    CAPTURE_OP_MAKE_CONTEXT_CURRENT,    //
+    CAPTURE_OP_SET_SWAP_INTERVAL,       // interval
+    CAPTURE_OP_SET_BUFFER_MODE,         // WindowBufferMode
+    CAPTURE_OP_BUFFER_CREATE,           // buffer id, WindowBufferType, size, data
+    CAPTURE_OP_BUFFER_FLUSH,            // buffer id, offset, size, data (the contents of the range)
+    CAPTURE_OP_BUFFER_DESTROY,          // buffer id
+    CAPTURE_OP_SET_VERTEX_BUFFER,       // slot, buffer id, stride
+    CAPTURE_OP_SET_INDEX_BUFFER,        // buffer id
+    CAPTURE_OP_DRAW_INDEXED,            // count, first
+
+    // GX2 (Wii U)
+    CAPTURE_OP_GX2_CLEAR_COLOR,         // window (1 if the window color buffer), f red, green, blue, alpha
+    CAPTURE_OP_GX2_CLEAR_DEPTH_STENCIL, // window, f depth, stencil, GX2ClearFlags
+    CAPTURE_OP_GX2_SET_SHADER_MODE,     // GX2ShaderMode, then the 6 GPR and stack sizes
+    CAPTURE_OP_GX2_SHADER,              // shader id, stage (CaptureShaderStage), data (the program)
+    CAPTURE_OP_GX2_FETCH_SHADER,        // shader id, number of attributes, then a CaptureAttrib each
+    CAPTURE_OP_GX2_SET_SHADER,          // stage, shader id (0 if it was set up before the capture)
+    CAPTURE_OP_GX2_SET_ATTRIB_BUFFER,   // slot, size, stride, data
+    CAPTURE_OP_GX2_DRAW,                // primitive, count, first vertex, instances
+    CAPTURE_OP_GX2_DRAW_INDEXED,        // primitive, count, index size (2 or 4), little-endian (the _LE index types),
+                                        // data, first vertex, instances
+    CAPTURE_OP_GX2_INVALIDATE,          // GX2InvalidateMode, size
+    CAPTURE_OP_GX2_SET_POLYGON_CONTROL, // front face, cull front, cull back, polygon mode enable,
+                                        // front mode, back mode, offset front, back, point/line enable
+    CAPTURE_OP_GX2_SET_UNIFORM_REG,     // stage, offset, count, then the count values
+
+    // OpenGL (PC), with the object names of the application
+    CAPTURE_OP_GL_CLEAR_COLOR,          // f red, green, blue, alpha
+    CAPTURE_OP_GL_CLEAR,                // mask
+    CAPTURE_OP_GL_VIEWPORT,             // x, y, width, height
+    CAPTURE_OP_GL_POLYGON_MODE,         // face, mode
+    CAPTURE_OP_GL_CREATE_SHADER,        // shader, type
+    CAPTURE_OP_GL_SHADER_SOURCE,        // shader, data (the source, with its strings joined)
+    CAPTURE_OP_GL_COMPILE_SHADER,       // shader
+    CAPTURE_OP_GL_DELETE_SHADER,        // shader
+    CAPTURE_OP_GL_CREATE_PROGRAM,       // program
+    CAPTURE_OP_GL_ATTACH_SHADER,        // program, shader
+    CAPTURE_OP_GL_LINK_PROGRAM,         // program
+    CAPTURE_OP_GL_USE_PROGRAM,          // program
+    CAPTURE_OP_GL_DELETE_PROGRAM,       // program
+    CAPTURE_OP_GL_UNIFORM4FV,           // location, count, then the 4 * count values
+    CAPTURE_OP_GL_GEN_VERTEX_ARRAY,     // vertex array
+    CAPTURE_OP_GL_BIND_VERTEX_ARRAY,    // vertex array
+    CAPTURE_OP_GL_DELETE_VERTEX_ARRAY,  // vertex array
+    CAPTURE_OP_GL_GEN_BUFFER,           // buffer
+    CAPTURE_OP_GL_BIND_BUFFER,          // target, buffer
+    CAPTURE_OP_GL_BUFFER_DATA,          // target, size, data, usage
+    CAPTURE_OP_GL_BUFFER_SUB_DATA,      // target, offset, size, data
+    CAPTURE_OP_GL_DELETE_BUFFER,        // buffer
+    CAPTURE_OP_GL_ENABLE_ATTRIB_ARRAY,  // index
+    CAPTURE_OP_GL_ATTRIB_POINTER,       // index, size, type, normalized, stride, offset
+    CAPTURE_OP_GL_DRAW_ARRAYS,          // primitive, first, count
+    CAPTURE_OP_GL_DRAW_ELEMENTS,        // primitive, count, type, client (1 if the indices are in data), offset or data
+
+    CAPTURE_OP_COUNT
+} CaptureOp;
+
+typedef enum CaptureShaderStage
+{
+    CAPTURE_SHADER_FETCH,
+    CAPTURE_SHADER_VERTEX,
+    CAPTURE_SHADER_PIXEL
+} CaptureShaderStage;
+
+// Primitives (OpenGL values)
+#define CAPTURE_PRIMITIVE_POINTS            0x0000
+#define CAPTURE_PRIMITIVE_LINES             0x0001
+#define CAPTURE_PRIMITIVE_LINE_LOOP         0x0002
+#define CAPTURE_PRIMITIVE_LINE_STRIP        0x0003
+#define CAPTURE_PRIMITIVE_TRIANGLES         0x0004
+#define CAPTURE_PRIMITIVE_TRIANGLE_STRIP    0x0005
+#define CAPTURE_PRIMITIVE_TRIANGLE_FAN      0x0006
+#define CAPTURE_PRIMITIVE_UNSUPPORTED       0xFFFF  // (e.g. GX2 quads and rectangles)
+
+// Attribute component types (OpenGL values)
+#define CAPTURE_TYPE_UNSIGNED_BYTE          0x1401
+#define CAPTURE_TYPE_UNSIGNED_SHORT         0x1403
+#define CAPTURE_TYPE_UNSIGNED_INT           0x1405
+#define CAPTURE_TYPE_FLOAT                  0x1406
+
+// Polygon modes (OpenGL values)
+#define CAPTURE_POLYGON_POINT               0x1B00
+#define CAPTURE_POLYGON_LINE                0x1B01
+#define CAPTURE_POLYGON_FILL                0x1B02
+
+// Attribute of a GX2 fetch shader (from its GX2AttribStream)
+typedef struct CaptureAttrib
+{
+    u32 location;
+    u32 buffer;                 // Attribute buffer slot
+    u32 offset;
+    u32 components;             // 1 to 4 (0 if the format is not supported by the replayer)
+    u32 type;                   // CAPTURE_TYPE_*
+    u32 normalized;
+    u32 divisor;                // 0 per vertex, otherwise per instance
+    u32 swap_size;              // Size of the elements to swap to little-endian (1, 2 or 4 bytes)
+} CaptureAttrib;
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // CAPTURE_FORMAT_H_
@@ -0,0 +1,528 @@
+// Multi-core command generation
+
+#include "cmd_list.h"
+#include "coherency.h"
+#include "jobs.h"
+#include "shader_mode.h"
+#include "trace.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+typedef enum WindowCmdOpType
+{
+    WINDOW_CMD_OP_SET_SHADERS,
+    WINDOW_CMD_OP_SET_VERTEX_INPUT,
+    WINDOW_CMD_OP_SET_UNIFORMS,
+    WINDOW_CMD_OP_SET_UNIFORM_BLOCK,
+    WINDOW_CMD_OP_DRAW,
+    WINDOW_CMD_OP_DRAW_INDEXED
+} WindowCmdOpType;
+
+typedef struct WindowCmdOp
+{
+    u32 type;
+    u32 arg0;
+    u32 arg1;
+    u32 arg2;
+    const void* ptr;
+} WindowCmdOp;
+
+struct WindowCmdList
+{
+    WindowCmdOp* ops;
+    u32 num_ops;
+    u32 ops_capacity;
+    f32* values;
+    u32 num_values;
+    u32 values_capacity;
+};
+
+#else // TEST_GX2
+
+#include <coreinit/memdefaultheap.h>
+#include <gx2/display_list.h>
+#include <gx2/draw.h>
+#include <gx2/event.h>
+#include <gx2/mem.h>
+
+// Audits the GX2 calls of this file when built with WINDOW_COHERENCY
+#include "coherency_calls.h"
+
+// Display lists are double-buffered so that the next recording does not have to wait for the GPU
+// to be done with the lists just submitted, and a fence per buffer makes sure it is done with the
+// older ones before they are recorded again (there may be several recordings per frame)
+#define WINDOW_CMD_BUFFER_COUNT 2
+
+// GX2 keeps display list recording state per core, so at most one list per core is recorded at a time
+#define WINDOW_CMD_NUM_CORES 3
+
+struct WindowCmdList
+{
+    void* buffers[WINDOW_CMD_BUFFER_COUNT];
+    u32 used;
+    WindowShaderNeeds shader_needs;  // Largest needs of the shaders set in the list
+};
+
+static u32 gBufferIndex = 0;
+static OSTime gFences[WINDOW_CMD_BUFFER_COUNT] = { 0, 0 };
+
+#endif
+
+static WindowCmdList* gLists = NULL;
+static u32 gNumLists = 0;
+static u32 gListSize = 0;
+static WindowRecordFunc gRecordFunc = NULL;
+static void* gRecordUserData = NULL;
+static WindowCmdStats gStats;
+
+bool WindowCmdInit(u32 num_lists, u32 list_size)
+{
+    if (gLists || num_lists == 0)
+        return false;
+
+    gLists = (WindowCmdList*)calloc(num_lists, sizeof(WindowCmdList));
+    if (!gLists)
+        return false;
+
+    gNumLists = num_lists;
+    gListSize = list_size;
+
+#ifdef TEST_WIN
+
+    // Start with the requested capacity, in operations
+    for (u32 i = 0; i < num_lists; i++)
+    {
+        gLists[i].ops_capacity = list_size / sizeof(WindowCmdOp);
+        if (gLists[i].ops_capacity == 0)
+            gLists[i].ops_capacity = 64;
+
+        gLists[i].ops = (WindowCmdOp*)malloc(gLists[i].ops_capacity * sizeof(WindowCmdOp));
+        if (!gLists[i].ops)
+        {
+            WindowCmdExit();
+            return false;
+        }
+    }
+
+#else // TEST_GX2
+
+    // Display lists are read directly by the GPU, so they require special alignment
+    for (u32 i = 0; i < num_lists; i++)
+    {
+        for (u32 j = 0; j < WINDOW_CMD_BUFFER_COUNT; j++)
+        {
+            gLists[i].buffers[j] = MEMAllocFromDefaultHeapEx(list_size, GX2_DISPLAY_LIST_ALIGNMENT);
+            if (!gLists[i].buffers[j])
+            {
+                WindowCmdExit();
+                return false;
+            }
+
+            COHERENCY_ALLOC(gLists[i].buffers[j], list_size);
+        }
+    }
+
+    gBufferIndex = 0;
+    memset(gFences, 0, sizeof(gFences));
+
+#endif
+
+    memset(&gStats, 0, sizeof(gStats));
+    gStats.num_lists = num_lists;
+    return true;
+}
+
+static void WindowCmdRecordList(u32 index)
+{
+    WindowCmdList* cmd_list = &gLists[index];
+
+    TraceBegin("WindowCmdRecordList");
+
+#ifdef TEST_WIN
+
+    cmd_list->num_ops = 0;
+    cmd_list->num_values = 0;
+
+    gRecordFunc(cmd_list, index, gNumLists, gRecordUserData);
+
+#else // TEST_GX2
+
+    // Every GX2 command issued by this thread from now on goes to the display list
+    // instead of the main command buffer
+    void* buffer = cmd_list->buffers[gBufferIndex];
+    memset(&cmd_list->shader_needs, 0, sizeof(WindowShaderNeeds));
+    GX2BeginDisplayList(buffer, gListSize);
+
+    gRecordFunc(cmd_list, index, gNumLists, gRecordUserData);
+
+    cmd_list->used = GX2EndDisplayList(buffer);
+
+#endif
+
+    TraceEnd();
+}
+
+static void WindowCmdRecordJob(u32 worker, u32 worker_count, void* user_data)
+{
+    (void)user_data;
+
+#ifdef TEST_GX2
+    // Only one list per core may be recorded at a time: extra workers sit this out
+    if (worker >= WINDOW_CMD_NUM_CORES)
+        return;
+
+    if (worker_count > WINDOW_CMD_NUM_CORES)
+        worker_count = WINDOW_CMD_NUM_CORES;
+#endif
+
+    // Each worker records every worker_count-th list
+    for (u32 i = worker; i < gNumLists; i += worker_count)
+        WindowCmdRecordList(i);
+}
+
+void WindowCmdRecord(WindowRecordFunc func, void* user_data)
+{
+    if (!gLists)
+        return;
+
+    TraceBegin("WindowCmdRecord");
+    f64 start = WindowGetTime();
+
+    gRecordFunc = func;
+    gRecordUserData = user_data;
+
+#ifdef TEST_GX2
+    // All commands calling the lists of the current buffer have been issued by now: fence it
+    GX2Flush();
+    gFences[gBufferIndex] = GX2GetLastSubmittedTimeStamp();
+
+    gBufferIndex = (gBufferIndex + 1) % WINDOW_CMD_BUFFER_COUNT;
+
+    // Wait until the GPU is done with the lists about to be recorded again
+    if (gFences[gBufferIndex] != 0 && GX2GetRetiredTimeStamp() < gFences[gBufferIndex])
+    {
+        gStats.fence_waits++;
+        GX2WaitTimeStamp(gFences[gBufferIndex]);
+    }
+#endif
+
+    u32 num_workers = JobsGetWorkerCount();
+    if (num_workers > 0)
+    {
+        JobsRun(WindowCmdRecordJob, NULL);
+    }
+    else
+    {
+        for (u32 i = 0; i < gNumLists; i++)
+            WindowCmdRecordList(i);
+        num_workers = 1;
+    }
+
+#ifdef TEST_GX2
+    if (num_workers > WINDOW_CMD_NUM_CORES)
+        num_workers = WINDOW_CMD_NUM_CORES;
+#endif
+
+    gStats.num_workers = num_workers;
+    gStats.bytes_used = 0;
+    for (u32 i = 0; i < gNumLists; i++)
+    {
+#ifdef TEST_WIN
+        u32 used = gLists[i].num_ops * sizeof(WindowCmdOp) + gLists[i].num_values * sizeof(f32);
+#else
+        u32 used = gLists[i].used;
+#endif
+        gStats.bytes_used += used;
+        if (used > gStats.peak_list_bytes)
+            gStats.peak_list_bytes = used;
+    }
+
+    gStats.record_ms = (WindowGetTime() - start) * 1000.0;
+    TraceEnd();
+}
+
+#ifdef TEST_WIN
+
+static void WindowCmdReplayList(const WindowCmdList* cmd_list)
+{
+    for (u32 i = 0; i < cmd_list->num_ops; i++)
+    {
+        const WindowCmdOp* op = &cmd_list->ops[i];
+        switch (op->type)
+        {
+        case WINDOW_CMD_OP_SET_SHADERS:
+            glUseProgram(((const WindowShaderSet*)op->ptr)->program);
+            break;
+        case WINDOW_CMD_OP_SET_VERTEX_INPUT:
+            glBindVertexArray(((const WindowVertexInput*)op->ptr)->vertex_array);
+            break;
+        case WINDOW_CMD_OP_SET_UNIFORMS:
+            glUniform4fv(op->arg0, op->arg1, &cmd_list->values[op->arg2]);
+            break;
+        case WINDOW_CMD_OP_SET_UNIFORM_BLOCK:
+            glBindBufferRange(GL_UNIFORM_BUFFER, op->arg0, (GLuint)(uintptr_t)op->ptr, op->arg1, op->arg2);
+            break;
+        case WINDOW_CMD_OP_DRAW:
+            glDrawArrays(GL_TRIANGLES, op->arg1, op->arg0);
+            break;
+        case WINDOW_CMD_OP_DRAW_INDEXED:
+            glDrawElements(GL_TRIANGLES, op->arg0, GL_UNSIGNED_INT, op->ptr);
+            break;
+        }
+    }
+}
+
+#endif // TEST_WIN
+
+void WindowCmdSubmit()
+{
+    if (!gLists)
+        return;
+
+    TraceBegin("WindowCmdSubmit");
+    f64 start = WindowGetTime();
+
+    // The lists may bind blocks written while recording them
+    // (WindowCmdRecord has waited for the workers, so every block allocated has been written)
+    WindowUniformFlush();
+
+#ifdef TEST_GX2
+    // The GPR and stack partition can't change in the middle of the lists (they are recorded in parallel),
+    // so pick one that fits every shader set they use
+    WindowShaderNeeds shader_needs;
+    memset(&shader_needs, 0, sizeof(shader_needs));
+    for (u32 i = 0; i < gNumLists; i++)
+    {
+        if (gLists[i].used != 0)
+            WindowMergeShaderNeeds(&shader_needs, &gLists[i].shader_needs);
+    }
+    WindowApplyShaderNeeds(&shader_needs);
+#endif
+
+    for (u32 i = 0; i < gNumLists; i++)
+    {
+#ifdef TEST_WIN
+        WindowCmdReplayList(&gLists[i]);
+#else
+        if (gLists[i].used == 0)
+            continue;
+
+        // Make sure the list has reached main memory before the GPU reads it
+        void* buffer = gLists[i].buffers[gBufferIndex];
+        GX2Invalidate(GX2_INVALIDATE_MODE_CPU, buffer, gLists[i].used);
+
+        // The GPU jumps to the list and comes back; nothing is copied
+        GX2CallDisplayList(buffer, gLists[i].used);
+#endif
+    }
+
+    gStats.submit_ms = (WindowGetTime() - start) * 1000.0;
+    TraceEnd();
+}
+
+void WindowCmdGetStats(WindowCmdStats* pStats)
+{
+    *pStats = gStats;
+}
+
+void WindowCmdExit()
+{
+    if (!gLists)
+        return;
+
+    for (u32 i = 0; i < gNumLists; i++)
+    {
+#ifdef TEST_WIN
+        free(gLists[i].ops);
+        free(gLists[i].values);
+#else
+        for (u32 j = 0; j < WINDOW_CMD_BUFFER_COUNT; j++)
+        {
+            if (gLists[i].buffers[j])
+                MEMFreeToDefaultHeap(gLists[i].buffers[j]);
+        }
+#endif
+    }
+
+    free(gLists);
+    gLists = NULL;
+    gNumLists = 0;
+}
+
+#ifdef TEST_WIN
+
+static WindowCmdOp* WindowCmdPushOp(WindowCmdList* cmd_list, u32 type)
+{
+    // Grow geometrically; the capacity is kept across frames, so this stops allocating quickly
+    if (cmd_list->num_ops == cmd_list->ops_capacity)
+    {
+        u32 capacity = cmd_list->ops_capacity * 2;
+        WindowCmdOp* ops = (WindowCmdOp*)realloc(cmd_list->ops, capacity * sizeof(WindowCmdOp));
+        if (!ops)
+            return NULL;
+
+        cmd_list->ops = ops;
+        cmd_list->ops_capacity = capacity;
+    }
+
+    WindowCmdOp* op = &cmd_list->ops[cmd_list->num_ops++];
+    op->type = type;
+    op->arg0 = 0;
+    op->arg1 = 0;
+    op->arg2 = 0;
+    op->ptr = NULL;
+    return op;
+}
+
+static void WindowCmdPushUniforms(WindowCmdList* cmd_list, u32 location, u32 count, const f32* values)
+{
+    u32 num_values = count * 4;
+    if (cmd_list->num_values + num_values > cmd_list->values_capacity)
+    {
+        u32 capacity = cmd_list->values_capacity ? cmd_list->values_capacity : 256;
+        while (cmd_list->num_values + num_values > capacity)
+            capacity *= 2;
+
+        f32* new_values = (f32*)realloc(cmd_list->values, capacity * sizeof(f32));
+        if (!new_values)
+            return;
+
+        cmd_list->values = new_values;
+        cmd_list->values_capacity = capacity;
+    }
+
+    WindowCmdOp* op = WindowCmdPushOp(cmd_list, WINDOW_CMD_OP_SET_UNIFORMS);
+    if (!op)
+        return;
+
+    op->arg0 = location;
+    op->arg1 = count;
+    op->arg2 = cmd_list->num_values;
+
+    memcpy(&cmd_list->values[cmd_list->num_values], values, num_values * sizeof(f32));
+    cmd_list->num_values += num_values;
+}
+
+#endif // TEST_WIN
+
+void WindowCmdSetShaders(WindowCmdList* cmd_list, const WindowShaderSet* shaders)
+{
+#ifdef TEST_WIN
+    WindowCmdOp* op = WindowCmdPushOp(cmd_list, WINDOW_CMD_OP_SET_SHADERS);
+    if (op)
+        op->ptr = shaders;
+#else
+    WindowShaderNeeds needs;
+    WindowGetShaderNeeds(shaders, &needs);
+    WindowMergeShaderNeeds(&cmd_list->shader_needs, &needs);
+
+    GX2SetFetchShader(shaders->fetch_shader);
+    GX2SetVertexShader(shaders->vertex_shader);
+    GX2SetPixelShader(shaders->pixel_shader);
+#endif
+}
+
+void WindowCmdSetVertexInput(WindowCmdList* cmd_list, const WindowVertexInput* input)
+{
+#ifdef TEST_WIN
+    WindowCmdOp* op = WindowCmdPushOp(cmd_list, WINDOW_CMD_OP_SET_VERTEX_INPUT);
+    if (op)
+        op->ptr = input;
+#else
+    (void)cmd_list;
+
+    GX2SetAttribBuffer(input->slot, input->size, input->stride, input->data);
+#endif
+}
+
+void WindowCmdSetVertexUniforms(WindowCmdList* cmd_list, u32 location, u32 count, const f32* values)
+{
+#ifdef TEST_WIN
+    WindowCmdPushUniforms(cmd_list, location, count, values);
+#else
+    (void)cmd_list;
+
+    // Uniform registers are addressed in 32-bit units; the values are written into the list itself
+    GX2SetVertexUniformReg(location * 4, count * 4, values);
+#endif
+}
+
+void WindowCmdSetPixelUniforms(WindowCmdList* cmd_list, u32 location, u32 count, const f32* values)
+{
+#ifdef TEST_WIN
+    WindowCmdPushUniforms(cmd_list, location, count, values);
+#else
+    (void)cmd_list;
+
+    GX2SetPixelUniformReg(location * 4, count * 4, values);
+#endif
+}
+
+void WindowCmdSetVertexUniformBlock(WindowCmdList* cmd_list, u32 index, const WindowUniformBlock* block)
+{
+#ifdef TEST_WIN
+    WindowCmdOp* op = WindowCmdPushOp(cmd_list, WINDOW_CMD_OP_SET_UNIFORM_BLOCK);
+    if (op)
+    {
+        op->arg0 = index;
+        op->arg1 = block->offset;
+        op->arg2 = block->size;
+        op->ptr = (const void*)(uintptr_t)WindowUniformGetBuffer();
+    }
+#else
+    (void)cmd_list;
+
+    // Only the address is written into the list; the GPU reads the block when drawing
+    GX2SetVertexUniformBlock(index, block->size, block->data);
+#endif
+}
+
+void WindowCmdSetPixelUniformBlock(WindowCmdList* cmd_list, u32 index, const WindowUniformBlock* block)
+{
+#ifdef TEST_WIN
+    // OpenGL binding points are shared between stages
+    WindowCmdSetVertexUniformBlock(cmd_list, WINDOW_UNIFORM_PIXEL_BINDING_BASE + index, block);
+#else
+    (void)cmd_list;
+
+    GX2SetPixelUniformBlock(index, block->size, block->data);
+#endif
+}
+
+void WindowCmdDraw(WindowCmdList* cmd_list, u32 count, u32 first)
+{
+#ifdef TEST_WIN
+    WindowCmdOp* op = WindowCmdPushOp(cmd_list, WINDOW_CMD_OP_DRAW);
+    if (op)
+    {
+        op->arg0 = count;
+        op->arg1 = first;
+    }
+#else
+    (void)cmd_list;
+
+    GX2DrawEx(GX2_PRIMITIVE_MODE_TRIANGLES, count, first, 1);
+#endif
+}
+
+void WindowCmdDrawIndexed(WindowCmdList* cmd_list, u32 count, const void* indices)
+{
+#ifdef TEST_WIN
+    WindowCmdOp* op = WindowCmdPushOp(cmd_list, WINDOW_CMD_OP_DRAW_INDEXED);
+    if (op)
+    {
+        op->arg0 = count;
+        op->ptr = indices;
+    }
+#else
+    (void)cmd_list;
+
+    GX2DrawIndexedEx(GX2_PRIMITIVE_MODE_TRIANGLES, count, GX2_INDEX_TYPE_U32, indices, 0, 1);
+#endif
+}
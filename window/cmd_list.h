@@ -0,0 +1,110 @@
+// Multi-core command generation
+// Hands one command recording context per list to the worker threads of the job pool (jobs.h)
+// and stitches the recorded lists into the frame in a deterministic order (list index order)
+// - Wii U: each list is a GX2 display list, recorded in parallel on the workers' cores
+// - PC: each list is an array of recorded operations, replayed through OpenGL by the submitting thread
+//       (OpenGL contexts can only be used by one thread)
+
+#ifndef CMD_LIST_H_
+#define CMD_LIST_H_
+
+#include "window.h"
+#include "uniform_buffer.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Recording context
+typedef struct WindowCmdList WindowCmdList;
+
+// Function recording commands into one list
+// Parameters:
+// - cmd_list: The list to record into (only valid for the duration of the call)
+// - index: Index of the list (lists are submitted in increasing index order)
+// - count: Total number of lists
+// - user_data: Pointer passed to WindowCmdRecord
+typedef void (*WindowRecordFunc)(WindowCmdList* cmd_list, u32 index, u32 count, void* user_data);
+
+// Command list statistics
+typedef struct WindowCmdStats
+{
+    u32 num_lists;       // Number of lists
+    u32 num_workers;     // Number of threads that recorded lists in parallel
+    u32 bytes_used;      // Total size of the lists recorded in the last frame
+    u32 peak_list_bytes; // Size of the largest list recorded so far
+    f64 record_ms;       // Time spent in WindowCmdRecord in the last frame (wall clock)
+    f64 submit_ms;       // Time spent in WindowCmdSubmit in the last frame
+    u32 fence_waits;     // Wii U: number of times recording had to wait for the GPU to be done with the display lists
+} WindowCmdStats;
+
+// Create the recording contexts
+// The job pool should be running (see JobsInit), otherwise all lists are recorded on the calling thread
+// Parameters:
+// - num_lists: Number of lists (typically the number of workers)
+// - list_size: Size of each display list in bytes on Wii U (must be large enough for a frame's worth
+//              of commands; see WindowCmdStats::peak_list_bytes), or initial capacity on PC
+bool WindowCmdInit(u32 num_lists, u32 list_size);
+
+// Record all lists in parallel on the job pool workers and block until done
+// Lists from the previous call are discarded
+void WindowCmdRecord(WindowRecordFunc func, void* user_data);
+
+// Stitch the recorded lists into the current frame, in list index order
+// Uniform blocks allocated so far in the frame are flushed first (see WindowUniformFlush)
+// and the GPR partition is updated if needed (see WindowSetShaderPartitionAuto)
+// Must be called from the thread that owns the window context
+void WindowCmdSubmit();
+
+// Get command list statistics
+void WindowCmdGetStats(WindowCmdStats* pStats);
+
+// Free the recording contexts
+void WindowCmdExit();
+
+// Recording functions
+// Only valid inside a WindowRecordFunc; pointers passed to them must stay valid until WindowCmdSubmit
+// has been called and the GPU is done with the frame
+
+// Set the shaders to draw with
+// With automatic GPR partitioning (see shader_mode.h), WindowCmdSubmit applies one partition
+// fitting all the shader sets used by the lists
+void WindowCmdSetShaders(WindowCmdList* cmd_list, const WindowShaderSet* shaders);
+
+// Set the vertex input to draw with
+void WindowCmdSetVertexInput(WindowCmdList* cmd_list, const WindowVertexInput* input);
+
+// Set vec4 uniforms of the vertex or pixel shader (values are copied)
+// Parameters:
+// - location: First uniform register (Wii U, uniform register mode), or uniform location (PC)
+// - count: Number of vec4 values
+// - values: 4 * count floats
+void WindowCmdSetVertexUniforms(WindowCmdList* cmd_list, u32 location, u32 count, const f32* values);
+void WindowCmdSetPixelUniforms(WindowCmdList* cmd_list, u32 location, u32 count, const f32* values);
+
+// Bind a uniform block of the vertex or pixel shader (WINDOW_SHADER_MODE_UNIFORM_BLOCK on Wii U)
+// Only the binding is recorded; the block data is read by the GPU from the per-frame uniform buffer
+// Parameters:
+// - index: Uniform block index
+// - block: Block allocated with WindowUniformAlloc in the current frame (copied)
+void WindowCmdSetVertexUniformBlock(WindowCmdList* cmd_list, u32 index, const WindowUniformBlock* block);
+void WindowCmdSetPixelUniformBlock(WindowCmdList* cmd_list, u32 index, const WindowUniformBlock* block);
+
+// Draw triangles
+// Parameters:
+// - count: Number of vertices
+// - first: First vertex
+void WindowCmdDraw(WindowCmdList* cmd_list, u32 count, u32 first);
+
+// Draw indexed triangles
+// Parameters:
+// - count: Number of indices
+// - indices: 32-bit index buffer (or offset into the bound element buffer on PC)
+void WindowCmdDrawIndexed(WindowCmdList* cmd_list, u32 count, const void* indices);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // CMD_LIST_H_
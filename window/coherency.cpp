@@ -0,0 +1,869 @@
+// Cache coherency auditor
+
+#include "coherency.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <mutex>
+
+static std::mutex gMutex;
+
+#else // TEST_GX2
+
+#include <coreinit/debug.h>
+#include <coreinit/mutex.h>
+#include <coreinit/thread.h>
+#include <gx2/clear.h>
+#include <gx2/display_list.h>
+#include <gx2/draw.h>
+#include <gx2/mem.h>
+#include <gx2/registers.h>
+#include <gx2/shaders.h>
+#include <gx2/surface.h>
+#include <gx2/swap.h>
+#include <gx2/texture.h>
+
+static OSMutex gMutex;
+static bool gMutexInitialized = false;
+
+// Most display lists recorded at once (one per thread)
+#define COHERENCY_MAX_OPEN_LISTS 8
+
+#endif
+
+// Memory followed: a state byte per line, with the bits of the caches that hold stale or dirty data
+// for the line (COHERENCY_CACHE_*)
+struct CoherencyRegion
+{
+    uintptr_t start;            // Aligned to COHERENCY_LINE_SIZE
+    uintptr_t end;
+    u8* lines;
+    const char* file;           // Where the memory was last written or allocated
+    u32 line;
+};
+
+enum CoherencySiteType
+{
+    COHERENCY_SITE_INVALIDATE,
+    COHERENCY_SITE_READ,        // A GPU read found lines dirty or stale
+    COHERENCY_SITE_GPU_WRITE    // A GPU write found lines dirty in the CPU cache
+};
+
+// Place reported
+struct CoherencySite
+{
+    CoherencySiteType type;
+    const char* file;
+    u32 line;
+    u32 caches;                 // Invalidation: caches named; read: cache read through
+    u32 found;                  // Read or write: caches found dirty or stale
+    const char* write_file;     // Read or write: where the lines were last written
+    u32 write_line;
+    u64 count;
+    u64 redundant;              // Invalidation: calls none of whose lines needed it
+    u64 bytes;                  // Invalidation: bytes covered
+    u64 needed_bytes;           // Invalidation: bytes that needed it
+    u32 needed_caches;          // Invalidation: caches needed by at least one call
+};
+
+struct CoherencyBinding
+{
+    const void* data;
+    u32 size;
+    u32 cache;
+};
+
+static CoherencyRegion* gRegions = NULL;
+static u32 gNumRegions = 0;
+static u32 gMaxRegions = 0;
+
+static CoherencySite gSites[COHERENCY_MAX_SITES];
+static CoherencyBinding gBindings[COHERENCY_BINDING_COUNT];
+static CoherencyStats gStats;
+
+static void CoherencyLock()
+{
+#ifdef TEST_WIN
+    gMutex.lock();
+#else
+    if (!gMutexInitialized)
+    {
+        // The first hooks are called by WindowInit, before there are other threads
+        OSInitMutex(&gMutex);
+        gMutexInitialized = true;
+    }
+
+    OSLockMutex(&gMutex);
+#endif
+}
+
+static void CoherencyUnlock()
+{
+#ifdef TEST_WIN
+    gMutex.unlock();
+#else
+    OSUnlockMutex(&gMutex);
+#endif
+}
+
+static void CoherencyLog(const char* line)
+{
+#ifdef TEST_WIN
+    printf("%s", line);
+#else
+    OSReport("%s", line);
+#endif
+}
+
+static inline uintptr_t CoherencyLineStart(const void* data)
+{
+    return (uintptr_t)data & ~(uintptr_t)(COHERENCY_LINE_SIZE - 1);
+}
+
+static inline uintptr_t CoherencyLineEnd(const void* data, u32 size)
+{
+    return ((uintptr_t)data + size + COHERENCY_LINE_SIZE - 1) & ~(uintptr_t)(COHERENCY_LINE_SIZE - 1);
+}
+
+// Index of the first region that ends after an address
+static u32 CoherencyFindRegion(uintptr_t address)
+{
+    u32 first = 0, last = gNumRegions;
+    while (first < last)
+    {
+        u32 middle = (first + last) / 2;
+        if (gRegions[middle].end <= address)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    return first;
+}
+
+// Get the region covering a range, merging the regions it overlaps into a new one if needed
+// Lines not followed before start clean
+static CoherencyRegion* CoherencyCover(uintptr_t start, uintptr_t end, const char* file, u32 line)
+{
+    u32 first = CoherencyFindRegion(start);
+    u32 last = first;
+    while (last < gNumRegions && gRegions[last].start < end)
+        last++;
+
+    if (last == first + 1 && gRegions[first].start <= start && gRegions[first].end >= end)
+        return &gRegions[first];
+
+    if (first < last)
+    {
+        if (gRegions[first].start < start)
+            start = gRegions[first].start;
+        if (gRegions[last - 1].end > end)
+            end = gRegions[last - 1].end;
+    }
+
+    u8* lines = (u8*)calloc((end - start) / COHERENCY_LINE_SIZE, 1);
+    if (!lines)
+        return NULL;
+
+    // One region replaces the regions from first to last
+    if (first == last && gNumRegions == gMaxRegions)
+    {
+        u32 max_regions = gMaxRegions ? gMaxRegions * 2 : 64;
+        CoherencyRegion* regions = (CoherencyRegion*)realloc(gRegions, max_regions * sizeof(CoherencyRegion));
+        if (!regions)
+        {
+            free(lines);
+            return NULL;
+        }
+
+        gRegions = regions;
+        gMaxRegions = max_regions;
+    }
+
+    for (u32 i = first; i < last; i++)
+    {
+        const CoherencyRegion* region = &gRegions[i];
+        memcpy(lines + (region->start - start) / COHERENCY_LINE_SIZE, region->lines, (region->end - region->start) / COHERENCY_LINE_SIZE);
+        gStats.tracked_bytes -= region->end - region->start;
+        free(region->lines);
+    }
+
+    u32 removed = last - first;
+    if (removed != 1)
+        memmove(&gRegions[first + 1], &gRegions[last], (gNumRegions - last) * sizeof(CoherencyRegion));
+    gNumRegions = gNumRegions + 1 - removed;
+
+    CoherencyRegion* region = &gRegions[first];
+    region->start = start;
+    region->end = end;
+    region->lines = lines;
+    region->file = file;
+    region->line = line;
+
+    gStats.tracked_bytes += end - start;
+    return region;
+}
+
+// Update the lines of a range that are followed: the bits of clear are cleared and those of set are set
+// Returns the bits of mask the lines had; pLines receives the number of lines that had some, and
+// pWriter the region of the last of them
+static u32 CoherencyUpdate(uintptr_t start, uintptr_t end, u32 mask, u32 clear, u32 set, u32* pLines,
+                           const CoherencyRegion** pWriter)
+{
+    u32 found = 0;
+    u32 num_lines = 0;
+
+    for (u32 i = CoherencyFindRegion(start); i < gNumRegions && gRegions[i].start < end; i++)
+    {
+        const CoherencyRegion* region = &gRegions[i];
+        uintptr_t first = start > region->start ? start : region->start;
+        uintptr_t last = end < region->end ? end : region->end;
+
+        u8* lines = region->lines + (first - region->start) / COHERENCY_LINE_SIZE;
+        u8* lines_end = region->lines + (last - region->start) / COHERENCY_LINE_SIZE;
+        for (; lines < lines_end; lines++)
+        {
+            u32 state = *lines & mask;
+            if (state != 0)
+            {
+                found |= state;
+                num_lines++;
+                if (pWriter)
+                    *pWriter = region;
+            }
+
+            *lines = (u8)((*lines & ~clear) | set);
+        }
+    }
+
+    if (pLines)
+        *pLines = num_lines;
+
+    return found;
+}
+
+static CoherencySite* CoherencyGetSite(CoherencySiteType type, const char* file, u32 line, u32 caches, u32 found,
+                                       const CoherencyRegion* writer)
+{
+    const char* write_file = writer ? writer->file : NULL;
+    u32 write_line = writer ? writer->line : 0;
+
+    for (u32 i = 0; i < gStats.sites; i++)
+    {
+        CoherencySite* site = &gSites[i];
+        if (site->type == type && site->line == line && site->caches == caches && site->found == found &&
+            site->write_line == write_line && site->file == file && site->write_file == write_file)
+            return site;
+    }
+
+    if (gStats.sites == COHERENCY_MAX_SITES)
+    {
+        gStats.dropped_sites++;
+        return NULL;
+    }
+
+    CoherencySite* site = &gSites[gStats.sites++];
+    memset(site, 0, sizeof(CoherencySite));
+    site->type = type;
+    site->file = file;
+    site->line = line;
+    site->caches = caches;
+    site->found = found;
+    site->write_file = write_file;
+    site->write_line = write_line;
+    return site;
+}
+
+// Check a GPU read (the lock must be held)
+static void CoherencyCheckRead(u32 cache, const void* data, u32 size, const char* file, u32 line)
+{
+    if (!data || size == 0)
+        return;
+
+    gStats.reads++;
+
+    // The read needs the lines flushed from the CPU cache, and the GPU cache it reads through invalidated
+    const CoherencyRegion* writer = NULL;
+    u32 found = CoherencyUpdate(CoherencyLineStart(data), CoherencyLineEnd(data, size), COHERENCY_CACHE_CPU | cache,
+                                0, 0, NULL, &writer);
+    if (found == 0)
+        return;
+
+    gStats.missing++;
+
+    CoherencySite* site = CoherencyGetSite(COHERENCY_SITE_READ, file, line, cache, found, writer);
+    if (site)
+        site->count++;
+}
+
+// Mark the lines of a range as written (the lock must be held)
+static void CoherencyMark(const void* data, u32 size, u32 caches, const char* file, u32 line)
+{
+    CoherencyRegion* region = CoherencyCover(CoherencyLineStart(data), CoherencyLineEnd(data, size), file, line);
+    if (!region)
+        return;
+
+    CoherencyUpdate(CoherencyLineStart(data), CoherencyLineEnd(data, size), 0, 0, caches, NULL, NULL);
+    region->file = file;
+    region->line = line;
+}
+
+void CoherencyAlloc(const void* data, u32 size, const char* file, u32 line)
+{
+    if (!data || size == 0)
+        return;
+
+    CoherencyLock();
+    CoherencyMark(data, size, COHERENCY_CACHE_CPU | COHERENCY_CACHE_GPU, file, line);
+    CoherencyUnlock();
+}
+
+void CoherencyCpuWrite(const void* data, u32 size, const char* file, u32 line)
+{
+    if (!data || size == 0)
+        return;
+
+    CoherencyLock();
+    CoherencyMark(data, size, COHERENCY_CACHE_CPU | COHERENCY_CACHE_GPU, file, line);
+    CoherencyUnlock();
+}
+
+void CoherencyGpuWrite(const void* data, u32 size, const char* file, u32 line)
+{
+    if (!data || size == 0)
+        return;
+
+    CoherencyLock();
+
+    // Lines dirty in the CPU cache would overwrite what the GPU writes when they are evicted
+    const CoherencyRegion* writer = NULL;
+    u32 found = CoherencyUpdate(CoherencyLineStart(data), CoherencyLineEnd(data, size), COHERENCY_CACHE_CPU, 0, 0, NULL, &writer);
+    if (found != 0)
+    {
+        gStats.missing++;
+
+        CoherencySite* site = CoherencyGetSite(COHERENCY_SITE_GPU_WRITE, file, line, 0, found, writer);
+        if (site)
+            site->count++;
+    }
+
+    // The GPU caches that read the memory now hold older data
+    CoherencyMark(data, size, COHERENCY_CACHE_GPU, file, line);
+
+    CoherencyUnlock();
+}
+
+void CoherencyInvalidate(u32 caches, const void* data, u32 size, const char* file, u32 line)
+{
+    caches &= COHERENCY_CACHE_CPU | COHERENCY_CACHE_GPU;
+    if (caches == 0 || !data || size == 0)
+        return;
+
+    CoherencyLock();
+
+    u32 num_lines;
+    u32 needed = CoherencyUpdate(CoherencyLineStart(data), CoherencyLineEnd(data, size), caches, caches, 0, &num_lines, NULL);
+
+    u64 needed_bytes = (u64)num_lines * COHERENCY_LINE_SIZE;
+    if (needed_bytes > size)
+        needed_bytes = size;
+
+    gStats.invalidations++;
+    gStats.invalidated_bytes += size;
+    gStats.needed_bytes += needed_bytes;
+    if (needed == 0)
+        gStats.redundant++;
+
+    CoherencySite* site = CoherencyGetSite(COHERENCY_SITE_INVALIDATE, file, line, caches, 0, NULL);
+    if (site)
+    {
+        site->count++;
+        site->bytes += size;
+        site->needed_bytes += needed_bytes;
+        site->needed_caches |= needed;
+        if (needed == 0)
+            site->redundant++;
+    }
+
+    CoherencyUnlock();
+}
+
+void CoherencyGpuRead(u32 cache, const void* data, u32 size, const char* file, u32 line)
+{
+    CoherencyLock();
+    CoherencyCheckRead(cache, data, size, file, line);
+    CoherencyUnlock();
+}
+
+void CoherencyForget(const void* data, u32 size)
+{
+    if (!data || size == 0)
+        return;
+
+    CoherencyLock();
+
+    uintptr_t start = (uintptr_t)data;
+    uintptr_t end = start + size;
+    CoherencyUpdate(CoherencyLineStart(data), CoherencyLineEnd(data, size), 0, 0xFF, 0, NULL, NULL);
+
+    for (u32 i = 0; i < COHERENCY_BINDING_COUNT; i++)
+    {
+        CoherencyBinding* binding = &gBindings[i];
+        if ((uintptr_t)binding->data >= start && (uintptr_t)binding->data < end)
+            memset(binding, 0, sizeof(CoherencyBinding));
+    }
+
+    CoherencyUnlock();
+}
+
+void CoherencyBind(u32 binding, u32 cache, const void* data, u32 size)
+{
+    if (binding >= COHERENCY_BINDING_COUNT)
+        return;
+
+    CoherencyLock();
+    gBindings[binding].data = data;
+    gBindings[binding].size = data ? size : 0;
+    gBindings[binding].cache = cache;
+    CoherencyUnlock();
+}
+
+void CoherencyDraw(const char* file, u32 line)
+{
+    CoherencyLock();
+
+    for (u32 i = 0; i < COHERENCY_BINDING_COUNT; i++)
+    {
+        const CoherencyBinding* binding = &gBindings[i];
+        if (binding->data)
+            CoherencyCheckRead(binding->cache, binding->data, binding->size, file, line);
+    }
+
+    CoherencyUnlock();
+}
+
+void CoherencyGetStats(CoherencyStats* pStats)
+{
+    CoherencyLock();
+    *pStats = gStats;
+    CoherencyUnlock();
+}
+
+// Names of the caches of a mask, separated by '|'
+static void CoherencyGetCacheNames(u32 caches, char* names, u32 size)
+{
+    static const struct { u32 cache; const char* name; } sCaches[] = {
+        { COHERENCY_CACHE_CPU,              "CPU" },
+        { COHERENCY_CACHE_ATTRIBUTE_BUFFER, "ATTRIBUTE_BUFFER" },
+        { COHERENCY_CACHE_TEXTURE,          "TEXTURE" },
+        { COHERENCY_CACHE_UNIFORM_BLOCK,    "UNIFORM_BLOCK" },
+        { COHERENCY_CACHE_SHADER,           "SHADER" }
+    };
+
+    names[0] = '\0';
+    for (u32 i = 0; i < sizeof(sCaches) / sizeof(sCaches[0]); i++)
+    {
+        if (caches & sCaches[i].cache)
+        {
+            size_t length = strlen(names);
+            snprintf(names + length, size - length, "%s%s", length ? "|" : "", sCaches[i].name);
+        }
+    }
+
+    if (names[0] == '\0')
+        snprintf(names, size, "DIRECT");
+}
+
+void CoherencyPrint()
+{
+    CoherencyLock();
+
+    char line[512];
+    char caches[64];
+    char found[64];
+
+    snprintf(line, sizeof(line), "Cache coherency: %llu invalidations, %llu redundant, %llu of %llu bytes needed; %llu of %llu GPU accesses found lines dirty or stale\n",
+             (unsigned long long)gStats.invalidations, (unsigned long long)gStats.redundant, (unsigned long long)gStats.needed_bytes,
+             (unsigned long long)gStats.invalidated_bytes, (unsigned long long)gStats.missing, (unsigned long long)gStats.reads);
+    CoherencyLog(line);
+
+    // Invalidations: those never needed can be removed, those needed for a fraction of their bytes narrowed
+    for (u32 i = 0; i < gStats.sites; i++)
+    {
+        const CoherencySite* site = &gSites[i];
+        if (site->type != COHERENCY_SITE_INVALIDATE)
+            continue;
+
+        CoherencyGetCacheNames(site->caches, caches, sizeof(caches));
+        const char* verdict = site->redundant == site->count ? "never needed" : site->redundant > 0 ? "sometimes needed" : "needed";
+
+        u32 unneeded = site->caches & ~site->needed_caches;
+        if (unneeded != 0 && site->needed_caches != 0)
+        {
+            CoherencyGetCacheNames(unneeded, found, sizeof(found));
+            snprintf(line, sizeof(line), "  %s:%u: invalidate %s: %s (%llu of %llu calls redundant), %llu of %llu bytes needed, %s never needed\n",
+                     site->file, site->line, caches, verdict, (unsigned long long)site->redundant, (unsigned long long)site->count,
+                     (unsigned long long)site->needed_bytes, (unsigned long long)site->bytes, found);
+        }
+        else
+        {
+            snprintf(line, sizeof(line), "  %s:%u: invalidate %s: %s (%llu of %llu calls redundant), %llu of %llu bytes needed\n",
+                     site->file, site->line, caches, verdict, (unsigned long long)site->redundant, (unsigned long long)site->count,
+                     (unsigned long long)site->needed_bytes, (unsigned long long)site->bytes);
+        }
+        CoherencyLog(line);
+    }
+
+    // Missing invalidations
+    for (u32 i = 0; i < gStats.sites; i++)
+    {
+        const CoherencySite* site = &gSites[i];
+        if (site->type == COHERENCY_SITE_INVALIDATE)
+            continue;
+
+        CoherencyGetCacheNames(site->found, found, sizeof(found));
+        if (site->type == COHERENCY_SITE_READ)
+        {
+            CoherencyGetCacheNames(site->caches, caches, sizeof(caches));
+            snprintf(line, sizeof(line), "  %s:%u: MISSING invalidation of %s before a GPU read through %s of memory written at %s:%u (%llu times)\n",
+                     site->file, site->line, found, caches, site->write_file ? site->write_file : "?", site->write_line,
+                     (unsigned long long)site->count);
+        }
+        else
+        {
+            snprintf(line, sizeof(line), "  %s:%u: MISSING invalidation of CPU before a GPU write to memory written at %s:%u (%llu times)\n",
+                     site->file, site->line, site->write_file ? site->write_file : "?", site->write_line, (unsigned long long)site->count);
+        }
+        CoherencyLog(line);
+    }
+
+    if (gStats.dropped_sites > 0)
+    {
+        snprintf(line, sizeof(line), "  (%u more places not reported, see COHERENCY_MAX_SITES)\n", gStats.dropped_sites);
+        CoherencyLog(line);
+    }
+
+    CoherencyUnlock();
+}
+
+void CoherencyReset()
+{
+    CoherencyLock();
+
+    for (u32 i = 0; i < gNumRegions; i++)
+        free(gRegions[i].lines);
+
+    free(gRegions);
+    gRegions = NULL;
+    gNumRegions = 0;
+    gMaxRegions = 0;
+
+    memset(gBindings, 0, sizeof(gBindings));
+    memset(&gStats, 0, sizeof(gStats));
+
+    CoherencyUnlock();
+}
+
+#ifdef TEST_GX2
+
+/*        GX2        */
+
+// Display lists being recorded, by thread
+static OSThread* gOpenListThreads[COHERENCY_MAX_OPEN_LISTS];
+static void* gOpenLists[COHERENCY_MAX_OPEN_LISTS];
+
+// Scan buffers, written by GX2CopyColorBufferToScanBuffer
+static void* gTVScanBuffer = NULL;
+static u32 gTVScanBufferSize = 0;
+static void* gDRCScanBuffer = NULL;
+static u32 gDRCScanBufferSize = 0;
+
+// Returns true if the calling thread records a display list: its calls run when the list is called
+static bool CoherencyInDisplayList()
+{
+    OSThread* thread = OSGetCurrentThread();
+
+    CoherencyLock();
+
+    bool recording = false;
+    for (u32 i = 0; i < COHERENCY_MAX_OPEN_LISTS; i++)
+    {
+        if (gOpenListThreads[i] == thread)
+            recording = true;
+    }
+
+    CoherencyUnlock();
+    return recording;
+}
+
+// Memory of a level of a surface (level 0 in the image, the others in the mipmaps)
+static void CoherencyGetLevel(const GX2Surface* surface, u32 level, const void** pData, u32* pSize)
+{
+    if (level == 0)
+    {
+        *pData = surface->image;
+        *pSize = surface->imageSize;
+    }
+    else
+    {
+        *pData = surface->mipmaps;
+        *pSize = surface->mipmapSize;
+    }
+}
+
+void CoherencyGX2Invalidate(GX2InvalidateMode mode, void* buffer, u32 size, const char* file, u32 line)
+{
+    GX2Invalidate(mode, buffer, size);
+    CoherencyInvalidate((u32)mode, buffer, size, file, line);
+}
+
+void CoherencyGX2InitFetchShaderEx(GX2FetchShader* shader, u8* program, u32 count, const GX2AttribStream* attribs,
+                                   GX2FetchShaderType type, GX2TessellationMode tess_mode, const char* file, u32 line)
+{
+    GX2InitFetchShaderEx(shader, program, count, attribs, type, tess_mode);
+
+    // The CPU writes the program
+    CoherencyCpuWrite(program, GX2CalcFetchShaderSizeEx(count, type, tess_mode), file, line);
+}
+
+void CoherencyGX2SetFetchShader(const GX2FetchShader* shader)
+{
+    GX2SetFetchShader(shader);
+
+    if (!CoherencyInDisplayList())
+        CoherencyBind(COHERENCY_BINDING_FETCH_SHADER, COHERENCY_CACHE_SHADER, shader->program, shader->size);
+}
+
+void CoherencyGX2SetVertexShader(const GX2VertexShader* shader)
+{
+    GX2SetVertexShader(shader);
+
+    if (!CoherencyInDisplayList())
+        CoherencyBind(COHERENCY_BINDING_VERTEX_SHADER, COHERENCY_CACHE_SHADER, shader->program, shader->size);
+}
+
+void CoherencyGX2SetPixelShader(const GX2PixelShader* shader)
+{
+    GX2SetPixelShader(shader);
+
+    if (!CoherencyInDisplayList())
+        CoherencyBind(COHERENCY_BINDING_PIXEL_SHADER, COHERENCY_CACHE_SHADER, shader->program, shader->size);
+}
+
+void CoherencyGX2SetAttribBuffer(u32 index, u32 size, u32 stride, const void* buffer)
+{
+    GX2SetAttribBuffer(index, size, stride, buffer);
+
+    if (index < 16 && !CoherencyInDisplayList())
+        CoherencyBind(COHERENCY_BINDING_ATTRIB_BUFFER(index), COHERENCY_CACHE_ATTRIBUTE_BUFFER, buffer, size);
+}
+
+void CoherencyGX2SetPixelTexture(const GX2Texture* texture, u32 unit)
+{
+    GX2SetPixelTexture(texture, unit);
+
+    if (unit >= 16 || CoherencyInDisplayList())
+        return;
+
+    // The mipmaps are only followed when they come right after the image, as they usually do
+    const GX2Surface* surface = &texture->surface;
+    u32 size = surface->imageSize;
+    if ((const u8*)surface->mipmaps == (const u8*)surface->image + surface->imageSize)
+        size += surface->mipmapSize;
+
+    CoherencyBind(COHERENCY_BINDING_PIXEL_TEXTURE(unit), COHERENCY_CACHE_TEXTURE, surface->image, size);
+}
+
+void CoherencyGX2SetVertexUniformBlock(u32 location, u32 size, const void* data)
+{
+    GX2SetVertexUniformBlock(location, size, data);
+
+    if (location < 16 && !CoherencyInDisplayList())
+        CoherencyBind(COHERENCY_BINDING_VERTEX_UNIFORM_BLOCK(location), COHERENCY_CACHE_UNIFORM_BLOCK, data, size);
+}
+
+void CoherencyGX2SetPixelUniformBlock(u32 location, u32 size, const void* data)
+{
+    GX2SetPixelUniformBlock(location, size, data);
+
+    if (location < 16 && !CoherencyInDisplayList())
+        CoherencyBind(COHERENCY_BINDING_PIXEL_UNIFORM_BLOCK(location), COHERENCY_CACHE_UNIFORM_BLOCK, data, size);
+}
+
+void CoherencyGX2DrawEx(GX2PrimitiveMode mode, u32 count, u32 offset, u32 num_instances, const char* file, u32 line)
+{
+    GX2DrawEx(mode, count, offset, num_instances);
+
+    if (!CoherencyInDisplayList())
+        CoherencyDraw(file, line);
+}
+
+void CoherencyGX2DrawIndexedEx(GX2PrimitiveMode mode, u32 count, GX2IndexType index_type, const void* indices,
+                               u32 offset, u32 num_instances, const char* file, u32 line)
+{
+    GX2DrawIndexedEx(mode, count, index_type, indices, offset, num_instances);
+
+    if (CoherencyInDisplayList())
+        return;
+
+    // Indices are read through the vertex cache
+    u32 index_size = (index_type == GX2_INDEX_TYPE_U16 || index_type == GX2_INDEX_TYPE_U16_LE) ? 2 : 4;
+    CoherencyGpuRead(COHERENCY_CACHE_ATTRIBUTE_BUFFER, indices, count * index_size, file, line);
+    CoherencyDraw(file, line);
+}
+
+void CoherencyGX2SetColorBuffer(const GX2ColorBuffer* buffer, GX2RenderTarget target, const char* file, u32 line)
+{
+    GX2SetColorBuffer(buffer, target);
+
+    // Counted as written when it is set, since the draws that follow write it
+    if (!CoherencyInDisplayList())
+    {
+        CoherencyGpuWrite(buffer->surface.image, buffer->surface.imageSize, file, line);
+        CoherencyGpuWrite(buffer->aaBuffer, buffer->aaSize, file, line);
+    }
+}
+
+void CoherencyGX2SetDepthBuffer(const GX2DepthBuffer* buffer, const char* file, u32 line)
+{
+    GX2SetDepthBuffer(buffer);
+
+    if (!CoherencyInDisplayList())
+    {
+        CoherencyGpuWrite(buffer->surface.image, buffer->surface.imageSize, file, line);
+        CoherencyGpuWrite(buffer->hiZPtr, buffer->hiZSize, file, line);
+    }
+}
+
+void CoherencyGX2ClearColor(GX2ColorBuffer* buffer, f32 r, f32 g, f32 b, f32 a, const char* file, u32 line)
+{
+    GX2ClearColor(buffer, r, g, b, a);
+
+    if (!CoherencyInDisplayList())
+        CoherencyGpuWrite(buffer->surface.image, buffer->surface.imageSize, file, line);
+}
+
+void CoherencyGX2ClearDepthStencilEx(GX2DepthBuffer* buffer, f32 depth, u8 stencil, GX2ClearFlags flags,
+                                     const char* file, u32 line)
+{
+    GX2ClearDepthStencilEx(buffer, depth, stencil, flags);
+
+    if (!CoherencyInDisplayList())
+        CoherencyGpuWrite(buffer->surface.image, buffer->surface.imageSize, file, line);
+}
+
+void CoherencyGX2CopySurface(const GX2Surface* src, u32 src_level, u32 src_slice, GX2Surface* dst, u32 dst_level,
+                             u32 dst_slice, const char* file, u32 line)
+{
+    GX2CopySurface(src, src_level, src_slice, dst, dst_level, dst_slice);
+
+    if (CoherencyInDisplayList())
+        return;
+
+    const void* data;
+    u32 size;
+    CoherencyGetLevel(src, src_level, &data, &size);
+    CoherencyGpuRead(COHERENCY_CACHE_DIRECT, data, size, file, line);
+
+    CoherencyGetLevel(dst, dst_level, &data, &size);
+    CoherencyGpuWrite(data, size, file, line);
+}
+
+void CoherencyGX2ResolveAAColorBuffer(const GX2ColorBuffer* src, GX2Surface* dst, u32 dst_level, u32 dst_slice,
+                                      const char* file, u32 line)
+{
+    GX2ResolveAAColorBuffer(src, dst, dst_level, dst_slice);
+
+    if (CoherencyInDisplayList())
+        return;
+
+    const void* data;
+    u32 size;
+    CoherencyGetLevel(dst, dst_level, &data, &size);
+    CoherencyGpuWrite(data, size, file, line);
+}
+
+void CoherencyGX2SetTVBuffer(void* buffer, u32 size, GX2TVRenderMode mode, GX2SurfaceFormat format,
+                             GX2BufferingMode buffering_mode)
+{
+    GX2SetTVBuffer(buffer, size, mode, format, buffering_mode);
+
+    gTVScanBuffer = buffer;
+    gTVScanBufferSize = size;
+}
+
+void CoherencyGX2SetDRCBuffer(void* buffer, u32 size, GX2DrcRenderMode mode, GX2SurfaceFormat format,
+                              GX2BufferingMode buffering_mode)
+{
+    GX2SetDRCBuffer(buffer, size, mode, format, buffering_mode);
+
+    gDRCScanBuffer = buffer;
+    gDRCScanBufferSize = size;
+}
+
+void CoherencyGX2CopyColorBufferToScanBuffer(const GX2ColorBuffer* buffer, GX2ScanTarget target, const char* file, u32 line)
+{
+    GX2CopyColorBufferToScanBuffer(buffer, target);
+
+    CoherencyGpuRead(COHERENCY_CACHE_DIRECT, buffer->surface.image, buffer->surface.imageSize, file, line);
+    if (target == GX2_SCAN_TARGET_TV)
+        CoherencyGpuWrite(gTVScanBuffer, gTVScanBufferSize, file, line);
+    else
+        CoherencyGpuWrite(gDRCScanBuffer, gDRCScanBufferSize, file, line);
+}
+
+void CoherencyGX2BeginDisplayList(void* list, u32 size)
+{
+    GX2BeginDisplayList(list, size);
+
+    OSThread* thread = OSGetCurrentThread();
+
+    CoherencyLock();
+    for (u32 i = 0; i < COHERENCY_MAX_OPEN_LISTS; i++)
+    {
+        if (!gOpenListThreads[i])
+        {
+            gOpenListThreads[i] = thread;
+            gOpenLists[i] = list;
+            break;
+        }
+    }
+    CoherencyUnlock();
+}
+
+u32 CoherencyGX2EndDisplayList(void* list, const char* file, u32 line)
+{
+    u32 size = GX2EndDisplayList(list);
+
+    CoherencyLock();
+    for (u32 i = 0; i < COHERENCY_MAX_OPEN_LISTS; i++)
+    {
+        if (gOpenLists[i] == list)
+        {
+            gOpenListThreads[i] = NULL;
+            gOpenLists[i] = NULL;
+            break;
+        }
+    }
+    CoherencyUnlock();
+
+    // The CPU wrote the commands
+    CoherencyCpuWrite(list, size, file, line);
+    return size;
+}
+
+void CoherencyGX2CallDisplayList(const void* list, u32 size, const char* file, u32 line)
+{
+    GX2CallDisplayList(list, size);
+
+    // The command processor reads the list from memory
+    if (!CoherencyInDisplayList())
+        CoherencyGpuRead(COHERENCY_CACHE_DIRECT, list, size, file, line);
+}
+
+#endif // TEST_GX2
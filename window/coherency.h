@@ -0,0 +1,183 @@
+// Cache coherency auditor
+// On Wii U, the CPU and GPU share memory but not caches: what the CPU writes must be flushed from its
+// data cache, and the GPU cache that reads it must be invalidated, before the GPU reads it
+// (GX2Invalidate). Missing one corrupts the rendering in ways that are hard to debug, so invalidations
+// tend to be issued "just in case"; the auditor tells which ones are needed
+// Built with WINDOW_COHERENCY defined, it follows the state of every 32-byte line of the memory it is
+// told about:
+// - CPU writes (COHERENCY_CPU_WRITE) leave the CPU cache dirty and the GPU caches stale for the line
+// - Allocations (COHERENCY_ALLOC) leave them dirty and stale as well, since the previous user of the
+//   memory may have left dirty lines in the CPU cache and the GPU may have cached its contents
+// - GPU writes (render targets, copies) leave the GPU caches stale, and must not land on lines that are
+//   dirty in the CPU cache (they would be overwritten when the CPU evicts them)
+// - Invalidations clean the caches they name for the lines they cover
+// - GPU reads (draws, display lists, copies) must find the line flushed from the CPU cache and
+//   invalidated from the GPU cache they read through
+// It reports, for each place an invalidation is issued, how often it was redundant (none of its lines
+// needed it) and how many of the bytes it covered needed it, and for each read or write that found a
+// line dirty or stale, where it happened and where the line was last written
+// Memory the auditor has not been told about counts as clean: static data and memory loaded by the
+// system (the loader flushes what it loads)
+// - Wii U: the GX2 calls of the library are redirected to wrappers that feed the auditor (see
+//          coherency_calls.h); CPU writes need explicit hooks (there is no write protection)
+// - PC: there is no GX2, but the Window* buffer API (buffer.h) has the same contract: WindowBufferFlush
+//       counts as the invalidation and WindowDrawIndexed as the read, so a missing flush is found on
+//       the host before it corrupts the rendering on the console
+// Without WINDOW_COHERENCY, the hooks compile to nothing
+
+#ifndef COHERENCY_H_
+#define COHERENCY_H_
+
+#include <test_types.h>
+
+#ifdef TEST_GX2
+#include <gx2/display.h>
+#include <gx2/enum.h>
+#include <gx2/shaders.h>
+#include <gx2/surface.h>
+#include <gx2/texture.h>
+#endif // TEST_GX2
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Caches (same bits as GX2InvalidateMode)
+#define COHERENCY_CACHE_ATTRIBUTE_BUFFER    0x01    // GPU vertex cache (attribute and index data)
+#define COHERENCY_CACHE_TEXTURE             0x02    // GPU texture cache
+#define COHERENCY_CACHE_UNIFORM_BLOCK       0x04    // GPU uniform block cache
+#define COHERENCY_CACHE_SHADER              0x08    // GPU shader program cache
+#define COHERENCY_CACHE_CPU                 0x40    // CPU data cache (flushed to memory)
+#define COHERENCY_CACHE_GPU                 0x0F    // Every GPU cache the auditor follows
+
+// Reads of memory that do not go through a GPU cache (command processor, copies): only the CPU cache
+// has to be flushed
+#define COHERENCY_CACHE_DIRECT              0x00
+
+// Granularity of the tracking, in bytes (the CPU cache line size)
+#define COHERENCY_LINE_SIZE 32
+
+// Most places (invalidations, reads and writes that found a problem) reported
+#define COHERENCY_MAX_SITES 256
+
+// Memory the GPU reads when it draws, set by the state calls and checked by COHERENCY_DRAW
+#define COHERENCY_BINDING_ATTRIB_BUFFER(slot)       (slot)          // 16 slots
+#define COHERENCY_BINDING_FETCH_SHADER              16
+#define COHERENCY_BINDING_VERTEX_SHADER             17
+#define COHERENCY_BINDING_PIXEL_SHADER              18
+#define COHERENCY_BINDING_PIXEL_TEXTURE(unit)       (19 + (unit))   // 16 units
+#define COHERENCY_BINDING_VERTEX_UNIFORM_BLOCK(i)   (35 + (i))      // 16 blocks
+#define COHERENCY_BINDING_PIXEL_UNIFORM_BLOCK(i)    (51 + (i))      // 16 blocks
+#define COHERENCY_BINDING_COUNT                     67
+
+// Statistics of the auditor
+typedef struct CoherencyStats
+{
+    u64 tracked_bytes;          // Bytes of memory followed
+    u64 invalidations;          // Invalidations audited
+    u64 redundant;              // Invalidations none of whose lines needed it
+    u64 invalidated_bytes;      // Bytes covered by the invalidations
+    u64 needed_bytes;           // Bytes of them that needed it
+    u64 reads;                  // GPU reads checked
+    u64 missing;                // GPU reads and writes that found a line dirty or stale
+    u32 sites;                  // Places reported
+    u32 dropped_sites;          // Places not reported because COHERENCY_MAX_SITES was reached
+} CoherencyStats;
+
+// Hooks (file and line are those of the call, to report it)
+// They may be called from any thread
+void CoherencyAlloc(const void* data, u32 size, const char* file, u32 line);
+void CoherencyCpuWrite(const void* data, u32 size, const char* file, u32 line);
+void CoherencyGpuWrite(const void* data, u32 size, const char* file, u32 line);
+void CoherencyInvalidate(u32 caches, const void* data, u32 size, const char* file, u32 line);
+void CoherencyGpuRead(u32 cache, const void* data, u32 size, const char* file, u32 line);
+
+// Stop following memory that is freed (it counts as clean again) and clear the bindings into it
+void CoherencyForget(const void* data, u32 size);
+
+// Set the memory read by draws through a binding (NULL data to clear it)
+void CoherencyBind(u32 binding, u32 cache, const void* data, u32 size);
+
+// Check the memory of every binding, as a draw reads it
+void CoherencyDraw(const char* file, u32 line);
+
+// Get the statistics of the auditor
+// Parameters:
+// - pStats: Output statistics
+void CoherencyGetStats(CoherencyStats* pStats);
+
+// Print the report: the invalidations and the problems found, by place
+// (to stdout on PC, to the system log on Wii U)
+void CoherencyPrint();
+
+// Forget the memory followed, the bindings and the places reported
+void CoherencyReset();
+
+#ifdef TEST_GX2
+
+// Wrappers of GX2, which make the call and feed the auditor (see coherency_calls.h)
+// Draws and state set while the calling thread records a display list are not checked: they run when
+// the list is called
+void CoherencyGX2Invalidate(GX2InvalidateMode mode, void* buffer, u32 size, const char* file, u32 line);
+void CoherencyGX2InitFetchShaderEx(GX2FetchShader* shader, u8* program, u32 count, const GX2AttribStream* attribs,
+                                   GX2FetchShaderType type, GX2TessellationMode tess_mode, const char* file, u32 line);
+void CoherencyGX2SetFetchShader(const GX2FetchShader* shader);
+void CoherencyGX2SetVertexShader(const GX2VertexShader* shader);
+void CoherencyGX2SetPixelShader(const GX2PixelShader* shader);
+void CoherencyGX2SetAttribBuffer(u32 index, u32 size, u32 stride, const void* buffer);
+void CoherencyGX2SetPixelTexture(const GX2Texture* texture, u32 unit);
+void CoherencyGX2SetVertexUniformBlock(u32 location, u32 size, const void* data);
+void CoherencyGX2SetPixelUniformBlock(u32 location, u32 size, const void* data);
+void CoherencyGX2DrawEx(GX2PrimitiveMode mode, u32 count, u32 offset, u32 num_instances, const char* file, u32 line);
+void CoherencyGX2DrawIndexedEx(GX2PrimitiveMode mode, u32 count, GX2IndexType index_type, const void* indices,
+                               u32 offset, u32 num_instances, const char* file, u32 line);
+void CoherencyGX2SetColorBuffer(const GX2ColorBuffer* buffer, GX2RenderTarget target, const char* file, u32 line);
+void CoherencyGX2SetDepthBuffer(const GX2DepthBuffer* buffer, const char* file, u32 line);
+void CoherencyGX2ClearColor(GX2ColorBuffer* buffer, f32 r, f32 g, f32 b, f32 a, const char* file, u32 line);
+void CoherencyGX2ClearDepthStencilEx(GX2DepthBuffer* buffer, f32 depth, u8 stencil, GX2ClearFlags flags,
+                                     const char* file, u32 line);
+void CoherencyGX2CopySurface(const GX2Surface* src, u32 src_level, u32 src_slice, GX2Surface* dst, u32 dst_level,
+                             u32 dst_slice, const char* file, u32 line);
+void CoherencyGX2ResolveAAColorBuffer(const GX2ColorBuffer* src, GX2Surface* dst, u32 dst_level, u32 dst_slice,
+                                      const char* file, u32 line);
+void CoherencyGX2SetTVBuffer(void* buffer, u32 size, GX2TVRenderMode mode, GX2SurfaceFormat format,
+                             GX2BufferingMode buffering_mode);
+void CoherencyGX2SetDRCBuffer(void* buffer, u32 size, GX2DrcRenderMode mode, GX2SurfaceFormat format,
+                              GX2BufferingMode buffering_mode);
+void CoherencyGX2CopyColorBufferToScanBuffer(const GX2ColorBuffer* buffer, GX2ScanTarget target, const char* file, u32 line);
+void CoherencyGX2BeginDisplayList(void* list, u32 size);
+u32 CoherencyGX2EndDisplayList(void* list, const char* file, u32 line);
+void CoherencyGX2CallDisplayList(const void* list, u32 size, const char* file, u32 line);
+
+#endif // TEST_GX2
+
+#ifdef WINDOW_COHERENCY
+
+#define COHERENCY_ALLOC(data, size)                 CoherencyAlloc((data), (size), __FILE__, __LINE__)
+#define COHERENCY_CPU_WRITE(data, size)             CoherencyCpuWrite((data), (size), __FILE__, __LINE__)
+#define COHERENCY_GPU_WRITE(data, size)             CoherencyGpuWrite((data), (size), __FILE__, __LINE__)
+#define COHERENCY_INVALIDATE(caches, data, size)    CoherencyInvalidate((caches), (data), (size), __FILE__, __LINE__)
+#define COHERENCY_GPU_READ(cache, data, size)       CoherencyGpuRead((cache), (data), (size), __FILE__, __LINE__)
+#define COHERENCY_FORGET(data, size)                CoherencyForget((data), (size))
+#define COHERENCY_BIND(binding, cache, data, size)  CoherencyBind((binding), (cache), (data), (size))
+#define COHERENCY_DRAW()                            CoherencyDraw(__FILE__, __LINE__)
+
+#else
+
+#define COHERENCY_ALLOC(data, size)                 ((void)0)
+#define COHERENCY_CPU_WRITE(data, size)             ((void)0)
+#define COHERENCY_GPU_WRITE(data, size)             ((void)0)
+#define COHERENCY_INVALIDATE(caches, data, size)    ((void)0)
+#define COHERENCY_GPU_READ(cache, data, size)       ((void)0)
+#define COHERENCY_FORGET(data, size)                ((void)0)
+#define COHERENCY_BIND(binding, cache, data, size)  ((void)0)
+#define COHERENCY_DRAW()                            ((void)0)
+
+#endif // WINDOW_COHERENCY
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // COHERENCY_H_
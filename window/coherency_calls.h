@@ -0,0 +1,73 @@
+// Redirects the GX2 calls of a source file to the coherency auditor's wrappers (see coherency.h)
+// Include it after the GX2 headers, in the source files whose invalidations and GPU accesses should
+// be audited; it does nothing unless WINDOW_COHERENCY is defined, so it can stay included
+// (Unlike capture_calls.h, the library includes it too: most invalidations are the library's)
+
+#ifndef COHERENCY_CALLS_H_
+#define COHERENCY_CALLS_H_
+
+#if defined(WINDOW_COHERENCY) && defined(TEST_GX2)
+
+#ifdef WINDOW_CAPTURE
+#error "WINDOW_COHERENCY and WINDOW_CAPTURE both redirect the GX2 calls: define only one of them"
+#endif // WINDOW_CAPTURE
+
+#include "coherency.h"
+
+#include <gx2/clear.h>
+#include <gx2/display_list.h>
+#include <gx2/draw.h>
+#include <gx2/mem.h>
+#include <gx2/registers.h>
+#include <gx2/swap.h>
+
+#define GX2Invalidate(mode, buffer, size) \
+    CoherencyGX2Invalidate((mode), (buffer), (size), __FILE__, __LINE__)
+#define GX2InitFetchShaderEx(shader, program, count, attribs, type, tess_mode) \
+    CoherencyGX2InitFetchShaderEx((shader), (program), (count), (attribs), (type), (tess_mode), __FILE__, __LINE__)
+#define GX2SetFetchShader(shader) \
+    CoherencyGX2SetFetchShader(shader)
+#define GX2SetVertexShader(shader) \
+    CoherencyGX2SetVertexShader(shader)
+#define GX2SetPixelShader(shader) \
+    CoherencyGX2SetPixelShader(shader)
+#define GX2SetAttribBuffer(index, size, stride, buffer) \
+    CoherencyGX2SetAttribBuffer((index), (size), (stride), (buffer))
+#define GX2SetPixelTexture(texture, unit) \
+    CoherencyGX2SetPixelTexture((texture), (unit))
+#define GX2SetVertexUniformBlock(location, size, data) \
+    CoherencyGX2SetVertexUniformBlock((location), (size), (data))
+#define GX2SetPixelUniformBlock(location, size, data) \
+    CoherencyGX2SetPixelUniformBlock((location), (size), (data))
+#define GX2DrawEx(mode, count, offset, num_instances) \
+    CoherencyGX2DrawEx((mode), (count), (offset), (num_instances), __FILE__, __LINE__)
+#define GX2DrawIndexedEx(mode, count, index_type, indices, offset, num_instances) \
+    CoherencyGX2DrawIndexedEx((mode), (count), (index_type), (indices), (offset), (num_instances), __FILE__, __LINE__)
+#define GX2SetColorBuffer(buffer, target) \
+    CoherencyGX2SetColorBuffer((buffer), (target), __FILE__, __LINE__)
+#define GX2SetDepthBuffer(buffer) \
+    CoherencyGX2SetDepthBuffer((buffer), __FILE__, __LINE__)
+#define GX2ClearColor(buffer, r, g, b, a) \
+    CoherencyGX2ClearColor((buffer), (r), (g), (b), (a), __FILE__, __LINE__)
+#define GX2ClearDepthStencilEx(buffer, depth, stencil, flags) \
+    CoherencyGX2ClearDepthStencilEx((buffer), (depth), (stencil), (flags), __FILE__, __LINE__)
+#define GX2CopySurface(src, src_level, src_slice, dst, dst_level, dst_slice) \
+    CoherencyGX2CopySurface((src), (src_level), (src_slice), (dst), (dst_level), (dst_slice), __FILE__, __LINE__)
+#define GX2ResolveAAColorBuffer(src, dst, dst_level, dst_slice) \
+    CoherencyGX2ResolveAAColorBuffer((src), (dst), (dst_level), (dst_slice), __FILE__, __LINE__)
+#define GX2SetTVBuffer(buffer, size, mode, format, buffering_mode) \
+    CoherencyGX2SetTVBuffer((buffer), (size), (mode), (format), (buffering_mode))
+#define GX2SetDRCBuffer(buffer, size, mode, format, buffering_mode) \
+    CoherencyGX2SetDRCBuffer((buffer), (size), (mode), (format), (buffering_mode))
+#define GX2CopyColorBufferToScanBuffer(buffer, target) \
+    CoherencyGX2CopyColorBufferToScanBuffer((buffer), (target), __FILE__, __LINE__)
+#define GX2BeginDisplayList(list, size) \
+    CoherencyGX2BeginDisplayList((list), (size))
+#define GX2EndDisplayList(list) \
+    CoherencyGX2EndDisplayList((list), __FILE__, __LINE__)
+#define GX2CallDisplayList(list, size) \
+    CoherencyGX2CallDisplayList((list), (size), __FILE__, __LINE__)
+
+#endif // WINDOW_COHERENCY && TEST_GX2
+
+#endif // COHERENCY_CALLS_H_
@@ -0,0 +1,344 @@
+// Frustum culling
+
+#include "culling.h"
+#include "jobs.h"
+#include "trace.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#define WINDOW_CULL_SSE
+#include <immintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// AVX code is compiled for its own functions only, and used if the CPU supports it
+#define WINDOW_CULL_AVX
+#endif
+#endif
+
+// Below this many objects, splitting the work over the workers costs more than it saves
+#define WINDOW_CULL_PARALLEL_MIN 16384
+
+static WindowCullPath gPath = WINDOW_CULL_PATH_SCALAR;
+static bool gPathSet = false;
+static WindowCullStats gStats;
+
+static bool WindowCullPathSupported(WindowCullPath path)
+{
+    switch (path)
+    {
+    case WINDOW_CULL_PATH_SCALAR:
+        return true;
+    case WINDOW_CULL_PATH_SSE:
+#ifdef WINDOW_CULL_SSE
+        return true;
+#else
+        return false;
+#endif
+    case WINDOW_CULL_PATH_AVX:
+#ifdef WINDOW_CULL_AVX
+        return __builtin_cpu_supports("avx");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+bool WindowCullBoundsInit(WindowCullBounds* pBounds, u32 capacity)
+{
+    memset(pBounds, 0, sizeof(WindowCullBounds));
+    if (capacity == 0)
+        return false;
+
+    // Each array starts on a 32-byte boundary and is padded to whole batches
+    u32 padded = (capacity + WINDOW_CULL_BATCH - 1) & ~(WINDOW_CULL_BATCH - 1);
+    u32 array_size = padded * sizeof(f32);
+
+    pBounds->memory = malloc(array_size * 4 + 32);
+    if (!pBounds->memory)
+        return false;
+
+    f32* base = (f32*)(((uintptr_t)pBounds->memory + 31) & ~(uintptr_t)31);
+    memset(base, 0, array_size * 4);
+
+    pBounds->x = base;
+    pBounds->y = base + padded;
+    pBounds->z = base + padded * 2;
+    pBounds->radius = base + padded * 3;
+    pBounds->capacity = capacity;
+    return true;
+}
+
+void WindowCullBoundsFree(WindowCullBounds* pBounds)
+{
+    free(pBounds->memory);
+    memset(pBounds, 0, sizeof(WindowCullBounds));
+}
+
+void WindowFrustumFromMatrix(WindowFrustum* pFrustum, const f32* m)
+{
+    // Gribb-Hartmann: each plane is the last row of the matrix plus or minus one of the other rows
+    for (u32 i = 0; i < 3; i++)
+    {
+        for (u32 j = 0; j < 4; j++)
+        {
+            pFrustum->planes[i * 2 + 0][j] = m[j * 4 + 3] + m[j * 4 + i];
+            pFrustum->planes[i * 2 + 1][j] = m[j * 4 + 3] - m[j * 4 + i];
+        }
+    }
+
+    for (u32 i = 0; i < 6; i++)
+    {
+        f32* plane = pFrustum->planes[i];
+        f32 length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f)
+        {
+            for (u32 j = 0; j < 4; j++)
+                plane[j] /= length;
+        }
+    }
+}
+
+bool WindowCullSetPath(WindowCullPath path)
+{
+    if (!WindowCullPathSupported(path))
+        return false;
+
+    gPath = path;
+    gPathSet = true;
+    return true;
+}
+
+WindowCullPath WindowCullGetPath()
+{
+    if (!gPathSet)
+    {
+        if (WindowCullPathSupported(WINDOW_CULL_PATH_AVX))
+            gPath = WINDOW_CULL_PATH_AVX;
+        else if (WindowCullPathSupported(WINDOW_CULL_PATH_SSE))
+            gPath = WINDOW_CULL_PATH_SSE;
+        else
+            gPath = WINDOW_CULL_PATH_SCALAR;
+
+        gPathSet = true;
+    }
+
+    return gPath;
+}
+
+static u32 WindowCullRangeScalar(const WindowFrustum* frustum, const WindowCullBounds* bounds, u32 begin, u32 end, u32* visible)
+{
+    u32 num_visible = 0;
+
+    for (u32 i = begin; i < end; i++)
+    {
+        f32 x = bounds->x[i], y = bounds->y[i], z = bounds->z[i];
+        f32 neg_radius = -bounds->radius[i];
+
+        // No early out: the object is written and kept only if it is inside all planes
+        bool inside = true;
+        for (u32 p = 0; p < 6; p++)
+        {
+            const f32* plane = frustum->planes[p];
+            inside &= plane[0] * x + plane[1] * y + plane[2] * z + plane[3] >= neg_radius;
+        }
+
+        visible[num_visible] = i;
+        num_visible += inside;
+    }
+
+    return num_visible;
+}
+
+#ifdef WINDOW_CULL_SSE
+
+static u32 WindowCullRangeSSE(const WindowFrustum* frustum, const WindowCullBounds* bounds, u32 begin, u32 end, u32* visible)
+{
+    // Objects before the first group of 4 and after the last one
+    u32 simd_begin = (begin + 3) & ~3u;
+    if (simd_begin > end)
+        simd_begin = end;
+    u32 simd_end = simd_begin + ((end - simd_begin) & ~3u);
+
+    u32 num_visible = WindowCullRangeScalar(frustum, bounds, begin, simd_begin, visible);
+
+    __m128 planes[6][4];
+    for (u32 p = 0; p < 6; p++)
+        for (u32 j = 0; j < 4; j++)
+            planes[p][j] = _mm_set1_ps(frustum->planes[p][j]);
+
+    for (u32 i = simd_begin; i < simd_end; i += 4)
+    {
+        __m128 x = _mm_load_ps(&bounds->x[i]);
+        __m128 y = _mm_load_ps(&bounds->y[i]);
+        __m128 z = _mm_load_ps(&bounds->z[i]);
+        __m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_load_ps(&bounds->radius[i]));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (u32 p = 0; p < 6; p++)
+        {
+            __m128 dist = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3])
+            );
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, neg_radius));
+        }
+
+        // Compact the visible objects of the group without branches
+        u32 mask = (u32)_mm_movemask_ps(inside);
+        for (u32 j = 0; j < 4; j++)
+        {
+            visible[num_visible] = i + j;
+            num_visible += (mask >> j) & 1;
+        }
+    }
+
+    return num_visible + WindowCullRangeScalar(frustum, bounds, simd_end, end, visible + num_visible);
+}
+
+#endif // WINDOW_CULL_SSE
+
+#ifdef WINDOW_CULL_AVX
+
+__attribute__((target("avx")))
+static u32 WindowCullRangeAVX(const WindowFrustum* frustum, const WindowCullBounds* bounds, u32 begin, u32 end, u32* visible)
+{
+    // Objects before the first group of 8 and after the last one
+    u32 simd_begin = (begin + 7) & ~7u;
+    if (simd_begin > end)
+        simd_begin = end;
+    u32 simd_end = simd_begin + ((end - simd_begin) & ~7u);
+
+    u32 num_visible = WindowCullRangeScalar(frustum, bounds, begin, simd_begin, visible);
+
+    __m256 planes[6][4];
+    for (u32 p = 0; p < 6; p++)
+        for (u32 j = 0; j < 4; j++)
+            planes[p][j] = _mm256_set1_ps(frustum->planes[p][j]);
+
+    for (u32 i = simd_begin; i < simd_end; i += 8)
+    {
+        __m256 x = _mm256_load_ps(&bounds->x[i]);
+        __m256 y = _mm256_load_ps(&bounds->y[i]);
+        __m256 z = _mm256_load_ps(&bounds->z[i]);
+        __m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_load_ps(&bounds->radius[i]));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (u32 p = 0; p < 6; p++)
+        {
+            __m256 dist = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)),
+                _mm256_add_ps(_mm256_mul_ps(planes[p][2], z), planes[p][3])
+            );
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, neg_radius, _CMP_GE_OQ));
+        }
+
+        u32 mask = (u32)_mm256_movemask_ps(inside);
+        for (u32 j = 0; j < 8; j++)
+        {
+            visible[num_visible] = i + j;
+            num_visible += (mask >> j) & 1;
+        }
+    }
+
+    return num_visible + WindowCullRangeScalar(frustum, bounds, simd_end, end, visible + num_visible);
+}
+
+#endif // WINDOW_CULL_AVX
+
+u32 WindowCullRange(const WindowFrustum* frustum, const WindowCullBounds* bounds, u32 begin, u32 end, u32* visible)
+{
+    if (end > bounds->count)
+        end = bounds->count;
+    if (begin >= end)
+        return 0;
+
+    switch (WindowCullGetPath())
+    {
+#ifdef WINDOW_CULL_AVX
+    case WINDOW_CULL_PATH_AVX:
+        return WindowCullRangeAVX(frustum, bounds, begin, end, visible);
+#endif
+#ifdef WINDOW_CULL_SSE
+    case WINDOW_CULL_PATH_SSE:
+        return WindowCullRangeSSE(frustum, bounds, begin, end, visible);
+#endif
+    default:
+        return WindowCullRangeScalar(frustum, bounds, begin, end, visible);
+    }
+}
+
+typedef struct WindowCullJob
+{
+    const WindowFrustum* frustum;
+    const WindowCullBounds* bounds;
+    u32* visible;
+    u32 begins[JOBS_MAX_WORKERS];
+    u32 counts[JOBS_MAX_WORKERS];
+} WindowCullJob;
+
+static void WindowCullWorker(u32 worker, u32 worker_count, void* user_data)
+{
+    WindowCullJob* job = (WindowCullJob*)user_data;
+
+    // Split on whole batches, so that every worker but the last starts and ends on aligned groups
+    u32 num_batches = (job->bounds->count + WINDOW_CULL_BATCH - 1) / WINDOW_CULL_BATCH;
+    u32 batch_begin, batch_end;
+    JobsSplitRange(num_batches, worker, worker_count, &batch_begin, &batch_end);
+
+    u32 begin = batch_begin * WINDOW_CULL_BATCH;
+    u32 end = batch_end * WINDOW_CULL_BATCH;
+
+    // Each worker writes its visible objects where its range starts in the output
+    job->begins[worker] = begin;
+    job->counts[worker] = WindowCullRange(job->frustum, job->bounds, begin, end, job->visible + begin);
+}
+
+u32 WindowCull(const WindowFrustum* frustum, const WindowCullBounds* bounds, u32* visible)
+{
+    TraceBegin("WindowCull");
+    f64 start_time = WindowGetTime();
+
+    u32 num_workers = JobsGetWorkerCount();
+    u32 num_visible = 0;
+
+    if (num_workers > 1 && bounds->count >= WINDOW_CULL_PARALLEL_MIN)
+    {
+        WindowCullJob job;
+        job.frustum = frustum;
+        job.bounds = bounds;
+        job.visible = visible;
+
+        JobsRun(WindowCullWorker, &job);
+
+        // Pack the lists of the workers together, in worker order (the first one is already in place)
+        num_visible = job.counts[0];
+        for (u32 i = 1; i < num_workers; i++)
+        {
+            memmove(visible + num_visible, visible + job.begins[i], job.counts[i] * sizeof(u32));
+            num_visible += job.counts[i];
+        }
+    }
+    else
+    {
+        num_workers = 1;
+        num_visible = WindowCullRange(frustum, bounds, 0, bounds->count, visible);
+    }
+
+    gStats.tested = bounds->count;
+    gStats.visible = num_visible;
+    gStats.num_workers = num_workers;
+    gStats.path = WindowCullGetPath();
+    gStats.cull_ms = (WindowGetTime() - start_time) * 1000.0;
+
+    TraceEnd();
+    return num_visible;
+}
+
+void WindowCullGetStats(WindowCullStats* pStats)
+{
+    *pStats = gStats;
+}
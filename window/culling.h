@@ -0,0 +1,107 @@
+// Frustum culling
+// Tests object bounding spheres against the view frustum before the draws are submitted, and hands
+// back a compact list of the visible objects for the draw loop
+// Bounds are stored as structure of arrays (one array per component), so that several objects are
+// tested at once with SIMD instructions:
+// - PC (x86): SSE (4 objects at a time), or AVX (8 objects at a time) if the CPU supports it
+// - Wii U: portable loop over the same layout (the compiler has no paired-single intrinsics)
+// Large scenes are split over the workers of the job pool (jobs.h) when it is running
+
+#ifndef CULLING_H_
+#define CULLING_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Objects are tested in batches of this many (the arrays are padded to a multiple of it)
+#define WINDOW_CULL_BATCH 8
+
+// Bounding spheres, as structure of arrays
+// Write the spheres of the objects 0 to count - 1 directly into the arrays
+typedef struct WindowCullBounds
+{
+    f32* x;                     // Sphere centers
+    f32* y;
+    f32* z;
+    f32* radius;                // Sphere radii
+    u32 count;                  // Number of objects
+    u32 capacity;               // Most objects the arrays can hold
+    void* memory;               // Allocation holding the arrays
+} WindowCullBounds;
+
+// View frustum, as 6 planes (a, b, c, d) with a * x + b * y + c * z + d >= 0 inside
+typedef struct WindowFrustum
+{
+    f32 planes[6][4];
+} WindowFrustum;
+
+// Implementation used to test the spheres
+typedef enum WindowCullPath
+{
+    WINDOW_CULL_PATH_SCALAR,    // Portable loop
+    WINDOW_CULL_PATH_SSE,       // 4 objects per instruction (x86)
+    WINDOW_CULL_PATH_AVX        // 8 objects per instruction (x86 CPUs with AVX)
+} WindowCullPath;
+
+// Culling statistics (of the last WindowCull)
+typedef struct WindowCullStats
+{
+    u32 tested;                 // Objects tested
+    u32 visible;                // Objects found visible
+    u32 num_workers;            // Threads the objects were split over
+    WindowCullPath path;        // Implementation used
+    f64 cull_ms;                // Time spent in WindowCull
+} WindowCullStats;
+
+// Allocate the bounds arrays (aligned for SIMD loads)
+// Parameters:
+// - pBounds: Bounds to initialize (count is set to 0)
+// - capacity: Most objects
+bool WindowCullBoundsInit(WindowCullBounds* pBounds, u32 capacity);
+
+// Free the bounds arrays
+void WindowCullBoundsFree(WindowCullBounds* pBounds);
+
+// Extract the frustum planes of a view-projection matrix (column-major, as OpenGL expects them,
+// with clip space z from -w to w)
+// Parameters:
+// - pFrustum: Output frustum (the planes are normalized, so that distances are in world units)
+// - view_proj: 16 floats
+void WindowFrustumFromMatrix(WindowFrustum* pFrustum, const f32* view_proj);
+
+// Choose the implementation (the fastest one supported is used by default)
+// Returns false if the implementation is not supported on this CPU (the implementation is not changed)
+bool WindowCullSetPath(WindowCullPath path);
+
+// Get the implementation in use
+WindowCullPath WindowCullGetPath();
+
+// Test a range of objects on the calling thread
+// Parameters:
+// - frustum: View frustum
+// - bounds: Object bounds
+// - begin, end: Range of objects to test
+// - visible: Output indices of the visible objects, in increasing order (room for end - begin indices)
+// Returns the number of visible objects
+u32 WindowCullRange(const WindowFrustum* frustum, const WindowCullBounds* bounds, u32 begin, u32 end, u32* visible);
+
+// Test all objects, split over the job pool workers if it is running and the scene is large enough
+// Parameters:
+// - frustum: View frustum
+// - bounds: Object bounds
+// - visible: Output indices of the visible objects, in increasing order (room for bounds->count indices)
+// Returns the number of visible objects
+u32 WindowCull(const WindowFrustum* frustum, const WindowCullBounds* bounds, u32* visible);
+
+// Get culling statistics
+void WindowCullGetStats(WindowCullStats* pStats);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // CULLING_H_
@@ -0,0 +1,79 @@
+// Dynamic resolution controller used by the swap path of the windowing library
+
+#include "dynamic_resolution.h"
+
+#include <math.h>
+
+// Fraction of the target frame time the controller aims for, to leave room for spikes
+#define DYNAMIC_RESOLUTION_HEADROOM 0.9
+
+// Weight of the newest frame in the filtered frame time
+#define DYNAMIC_RESOLUTION_AVG_WEIGHT 0.2
+
+// Scales are multiples of this step, so that small variations do not change the resolution every frame
+#define DYNAMIC_RESOLUTION_STEP 0.025f
+
+// Largest increase of the scale at once, and number of frames to wait between increases
+// (Going down is immediate, since a frame over the target means a dropped frame)
+#define DYNAMIC_RESOLUTION_MAX_RAISE 0.05f
+#define DYNAMIC_RESOLUTION_RAISE_DELAY 30
+
+void DynamicResolutionInit(DynamicResolution* dynres, f32 min_scale, f32 max_scale, f64 target_time)
+{
+    dynres->min_scale = min_scale;
+    dynres->max_scale = max_scale;
+    dynres->target_time = target_time;
+
+    dynres->scale = max_scale;
+    dynres->avg_frame_time = 0.0;
+    dynres->frames_since_change = 0;
+
+    dynres->scale_changes = 0;
+}
+
+f32 DynamicResolutionUpdate(DynamicResolution* dynres, f64 frame_time)
+{
+    dynres->frames_since_change++;
+
+    if (frame_time <= 0.0 || dynres->target_time <= 0.0)
+        return dynres->scale;
+
+    if (dynres->avg_frame_time == 0.0)
+        dynres->avg_frame_time = frame_time;
+    else
+        dynres->avg_frame_time += (frame_time - dynres->avg_frame_time) * DYNAMIC_RESOLUTION_AVG_WEIGHT;
+
+    // React to the worst of the last frame and the average, so that a single slow frame lowers the
+    // resolution right away but a single fast frame does not raise it
+    f64 time = frame_time > dynres->avg_frame_time ? frame_time : dynres->avg_frame_time;
+
+    // The cost of a frame is proportional to the area, i.e. the square of the scale
+    f32 scale = dynres->scale * (f32)sqrt(dynres->target_time * DYNAMIC_RESOLUTION_HEADROOM / time);
+    scale = floorf(scale / DYNAMIC_RESOLUTION_STEP + 0.001f) * DYNAMIC_RESOLUTION_STEP;
+
+    if (scale > dynres->scale)
+    {
+        if (dynres->frames_since_change < DYNAMIC_RESOLUTION_RAISE_DELAY)
+            return dynres->scale;
+
+        if (scale > dynres->scale + DYNAMIC_RESOLUTION_MAX_RAISE)
+            scale = dynres->scale + DYNAMIC_RESOLUTION_MAX_RAISE;
+    }
+
+    if (scale < dynres->min_scale)
+        scale = dynres->min_scale;
+    if (scale > dynres->max_scale)
+        scale = dynres->max_scale;
+
+    if (scale != dynres->scale)
+    {
+        // The frame time measured so far was for the previous resolution
+        dynres->avg_frame_time *= (f64)(scale * scale) / (dynres->scale * dynres->scale);
+
+        dynres->scale = scale;
+        dynres->frames_since_change = 0;
+        dynres->scale_changes++;
+    }
+
+    return dynres->scale;
+}
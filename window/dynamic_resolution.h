@@ -0,0 +1,47 @@
+// Dynamic resolution controller used by the swap path of the windowing library
+// Scales the render resolution so that the measured frame time stays within a target,
+// assuming the cost of a frame is proportional to the number of pixels rendered
+
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+#include <test_types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef struct DynamicResolution
+{
+    // Configuration
+    f32 min_scale;         // Lowest scale of the render width and height
+    f32 max_scale;         // Highest scale of the render width and height
+    f64 target_time;       // Frame time to stay within, in seconds
+
+    // Controller state
+    f32 scale;             // Scale currently in use
+    f64 avg_frame_time;    // Filtered frame time, in seconds (0 if no frame measured yet)
+    u32 frames_since_change;
+
+    // Statistics
+    u32 scale_changes;
+} DynamicResolution;
+
+// Reset the controller
+// Parameters:
+// - min_scale, max_scale: Range of the scale of the render width and height (e.g. 0.5 to 1.0)
+// - target_time: Frame time to stay within, in seconds
+void DynamicResolutionInit(DynamicResolution* dynres, f32 min_scale, f32 max_scale, f64 target_time);
+
+// Feed the controller with the time the last frame took to render
+// Parameters:
+// - frame_time: Time taken by the frame, in seconds (the GPU time if known, or the CPU time otherwise)
+// Returns the scale to use from now on
+f32 DynamicResolutionUpdate(DynamicResolution* dynres, f64 frame_time);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // DYNAMIC_RESOLUTION_H_
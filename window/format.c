@@ -0,0 +1,195 @@
+// Buffer and texture format helpers shared by the window, framebuffer planner, render target and
+// texture streaming code
+
+#include "format.h"
+
+#ifdef TEST_WIN
+#include <GL/glew.h>
+#endif // TEST_WIN
+
+bool WindowFormatIsDepth(WindowRenderTargetFormat format)
+{
+    return format == WINDOW_RT_FORMAT_D32F
+        || format == WINDOW_RT_FORMAT_D24S8
+        || format == WINDOW_RT_FORMAT_D16;
+}
+
+u32 WindowFormatGetBytesPerPixel(WindowRenderTargetFormat format)
+{
+    switch (format)
+    {
+    case WINDOW_RT_FORMAT_RGBA16F: return 8;
+    case WINDOW_RT_FORMAT_D16:     return 2;
+    default:                       return 4;
+    }
+}
+
+const char* WindowFormatGetName(WindowRenderTargetFormat format)
+{
+    static const char* const names[WINDOW_RT_FORMAT_COUNT] = {
+        "RGBA8", "RGB10_A2", "RGBA16F", "R32F", "D32F", "D24S8", "D16"
+    };
+
+    return format < WINDOW_RT_FORMAT_COUNT ? names[format] : "?";
+}
+
+bool WindowTextureFormatIsCompressed(WindowTextureFormat format)
+{
+    return format != WINDOW_TEXTURE_FORMAT_RGBA8;
+}
+
+u32 WindowTextureFormatGetElementSize(WindowTextureFormat format)
+{
+    switch (format)
+    {
+    case WINDOW_TEXTURE_FORMAT_BC1: return 8;
+    case WINDOW_TEXTURE_FORMAT_BC3: return 16;
+    case WINDOW_TEXTURE_FORMAT_BC4: return 8;
+    case WINDOW_TEXTURE_FORMAT_BC5: return 16;
+    default:                        return 4;
+    }
+}
+
+u32 WindowTextureFormatGetLevelSize(WindowTextureFormat format, u32 width, u32 height)
+{
+    if (WindowTextureFormatIsCompressed(format))
+    {
+        width = (width + 3) / 4;
+        height = (height + 3) / 4;
+    }
+
+    return width * height * WindowTextureFormatGetElementSize(format);
+}
+
+const char* WindowTextureFormatGetName(WindowTextureFormat format)
+{
+    static const char* const names[WINDOW_TEXTURE_FORMAT_COUNT] = {
+        "RGBA8", "BC1", "BC3", "BC4", "BC5"
+    };
+
+    return format < WINDOW_TEXTURE_FORMAT_COUNT ? names[format] : "?";
+}
+
+bool WindowIsTextureFormatSupported(WindowTextureFormat format)
+{
+    if (format >= WINDOW_TEXTURE_FORMAT_COUNT)
+        return false;
+
+#ifdef TEST_WIN
+    if (format == WINDOW_TEXTURE_FORMAT_BC1 || format == WINDOW_TEXTURE_FORMAT_BC3)
+        return GLEW_EXT_texture_compression_s3tc;
+#endif // TEST_WIN
+
+    return true;
+}
+
+#ifdef TEST_WIN
+
+void WindowFormatGetGL(WindowRenderTargetFormat format, u32* pInternalFormat, u32* pFormat, u32* pType)
+{
+    switch (format)
+    {
+    default:
+    case WINDOW_RT_FORMAT_RGBA8:
+        *pInternalFormat = GL_RGBA8; *pFormat = GL_RGBA; *pType = GL_UNSIGNED_BYTE;
+        break;
+    case WINDOW_RT_FORMAT_RGB10_A2:
+        *pInternalFormat = GL_RGB10_A2; *pFormat = GL_RGBA; *pType = GL_UNSIGNED_INT_2_10_10_10_REV;
+        break;
+    case WINDOW_RT_FORMAT_RGBA16F:
+        *pInternalFormat = GL_RGBA16F; *pFormat = GL_RGBA; *pType = GL_HALF_FLOAT;
+        break;
+    case WINDOW_RT_FORMAT_R32F:
+        *pInternalFormat = GL_R32F; *pFormat = GL_RED; *pType = GL_FLOAT;
+        break;
+    case WINDOW_RT_FORMAT_D32F:
+        *pInternalFormat = GL_DEPTH_COMPONENT32F; *pFormat = GL_DEPTH_COMPONENT; *pType = GL_FLOAT;
+        break;
+    case WINDOW_RT_FORMAT_D24S8:
+        *pInternalFormat = GL_DEPTH24_STENCIL8; *pFormat = GL_DEPTH_STENCIL; *pType = GL_UNSIGNED_INT_24_8;
+        break;
+    case WINDOW_RT_FORMAT_D16:
+        *pInternalFormat = GL_DEPTH_COMPONENT16; *pFormat = GL_DEPTH_COMPONENT; *pType = GL_UNSIGNED_SHORT;
+        break;
+    }
+}
+
+void WindowTextureFormatGetGL(WindowTextureFormat format, u32* pInternalFormat, u32* pFormat, u32* pType)
+{
+    *pFormat = 0;
+    *pType = 0;
+
+    switch (format)
+    {
+    default:
+    case WINDOW_TEXTURE_FORMAT_RGBA8:
+        *pInternalFormat = GL_RGBA8; *pFormat = GL_RGBA; *pType = GL_UNSIGNED_BYTE;
+        break;
+    case WINDOW_TEXTURE_FORMAT_BC1:
+        *pInternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        break;
+    case WINDOW_TEXTURE_FORMAT_BC3:
+        *pInternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        break;
+    case WINDOW_TEXTURE_FORMAT_BC4:
+        *pInternalFormat = GL_COMPRESSED_RED_RGTC1;
+        break;
+    case WINDOW_TEXTURE_FORMAT_BC5:
+        *pInternalFormat = GL_COMPRESSED_RG_RGTC2;
+        break;
+    }
+}
+
+#else // TEST_GX2
+
+GX2SurfaceFormat WindowFormatGetSurfaceFormat(WindowRenderTargetFormat format)
+{
+    switch (format)
+    {
+    case WINDOW_RT_FORMAT_RGBA8:    return GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8;
+    case WINDOW_RT_FORMAT_RGB10_A2: return GX2_SURFACE_FORMAT_UNORM_R10_G10_B10_A2;
+    case WINDOW_RT_FORMAT_RGBA16F:  return GX2_SURFACE_FORMAT_FLOAT_R16_G16_B16_A16;
+    case WINDOW_RT_FORMAT_R32F:     return GX2_SURFACE_FORMAT_FLOAT_R32;
+    case WINDOW_RT_FORMAT_D32F:     return GX2_SURFACE_FORMAT_FLOAT_R32;
+    case WINDOW_RT_FORMAT_D24S8:    return GX2_SURFACE_FORMAT_UNORM_R24_X8;
+    case WINDOW_RT_FORMAT_D16:      return GX2_SURFACE_FORMAT_UNORM_R16;
+    default:                        return GX2_SURFACE_FORMAT_INVALID;
+    }
+}
+
+GX2SurfaceFormat WindowTextureFormatGetSurfaceFormat(WindowTextureFormat format)
+{
+    switch (format)
+    {
+    case WINDOW_TEXTURE_FORMAT_RGBA8: return GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8;
+    case WINDOW_TEXTURE_FORMAT_BC1:   return GX2_SURFACE_FORMAT_UNORM_BC1;
+    case WINDOW_TEXTURE_FORMAT_BC3:   return GX2_SURFACE_FORMAT_UNORM_BC3;
+    case WINDOW_TEXTURE_FORMAT_BC4:   return GX2_SURFACE_FORMAT_UNORM_BC4;
+    case WINDOW_TEXTURE_FORMAT_BC5:   return GX2_SURFACE_FORMAT_UNORM_BC5;
+    default:                          return GX2_SURFACE_FORMAT_INVALID;
+    }
+}
+
+GX2AAMode WindowFormatGetAAMode(u32 samples)
+{
+    switch (samples)
+    {
+    case 2:  return GX2_AA_MODE2X;
+    case 4:  return GX2_AA_MODE4X;
+    case 8:  return GX2_AA_MODE8X;
+    default: return GX2_AA_MODE1X;
+    }
+}
+
+GX2TVRenderMode WindowFormatGetTVRenderMode(u32 fb_width)
+{
+    switch (fb_width)
+    {
+    case 1920: return GX2_TV_RENDER_MODE_WIDE_1080P;
+    case 1280: return GX2_TV_RENDER_MODE_WIDE_720P;
+    case 854:  return GX2_TV_RENDER_MODE_WIDE_480P;
+    default:   return GX2_TV_RENDER_MODE_STANDARD_480P;
+    }
+}
+
+#endif // TEST_WIN
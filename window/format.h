@@ -0,0 +1,72 @@
+// Buffer and texture format helpers shared by the window, framebuffer planner, render target and
+// texture streaming code (internal)
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include "window.h"
+
+#ifdef TEST_GX2
+#include <gx2/display.h>
+#endif // TEST_GX2
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Whether the format is a depth (and stencil) format
+bool WindowFormatIsDepth(WindowRenderTargetFormat format);
+
+// Size of one sample of the format in bytes
+u32 WindowFormatGetBytesPerPixel(WindowRenderTargetFormat format);
+
+// Name of the format (e.g. "RGBA8")
+const char* WindowFormatGetName(WindowRenderTargetFormat format);
+
+// Whether the texture format is block-compressed (4x4 pixels per block)
+bool WindowTextureFormatIsCompressed(WindowTextureFormat format);
+
+// Size of one element of the texture format in bytes (a pixel, or a block if compressed)
+u32 WindowTextureFormatGetElementSize(WindowTextureFormat format);
+
+// Size of a texture level in bytes, with tightly packed rows of elements
+u32 WindowTextureFormatGetLevelSize(WindowTextureFormat format, u32 width, u32 height);
+
+// Name of the texture format (e.g. "BC1")
+const char* WindowTextureFormatGetName(WindowTextureFormat format);
+
+#ifdef TEST_WIN
+
+// Get the OpenGL internal format, and the format and type to use with glTexImage2D
+void WindowFormatGetGL(WindowRenderTargetFormat format, u32* pInternalFormat, u32* pFormat, u32* pType);
+
+// Get the OpenGL internal format of the texture format, and the format and type to use with
+// glTexImage2D (0 if compressed, for glCompressedTexImage2D)
+void WindowTextureFormatGetGL(WindowTextureFormat format, u32* pInternalFormat, u32* pFormat, u32* pType);
+
+#else // TEST_GX2
+
+// Value the auxiliary buffer of multisampled color buffers must be initialized with
+#define WINDOW_AA_BUFFER_CLEAR_VALUE 0xCC
+
+// Get the GX2 surface format
+GX2SurfaceFormat WindowFormatGetSurfaceFormat(WindowRenderTargetFormat format);
+
+// Get the GX2 surface format of the texture format
+GX2SurfaceFormat WindowTextureFormatGetSurfaceFormat(WindowTextureFormat format);
+
+// Get the GX2 AA mode for a number of samples per pixel
+GX2AAMode WindowFormatGetAAMode(u32 samples);
+
+// Get the TV render mode (scan buffer size) matching a framebuffer width
+// (1920: 1080p, 1280: 720p, 854: wide 480p, otherwise standard 480p)
+GX2TVRenderMode WindowFormatGetTVRenderMode(u32 fb_width);
+
+#endif // TEST_WIN
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // FORMAT_H_
@@ -0,0 +1,950 @@
+// Frame graph
+
+#include "frame_graph.h"
+#include "format.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+#else // TEST_GX2
+
+#include <coreinit/debug.h>
+#include <gx2/clear.h>
+#include <gx2/event.h>
+#include <gx2/mem.h>
+
+// Audits the GX2 calls of this file when built with WINDOW_COHERENCY
+#include "coherency_calls.h"
+
+#endif
+
+// Physical targets are kept from one compile to the next, so a compile can briefly have both the
+// targets of the last compile and new ones
+#define WINDOW_GRAPH_MAX_PHYSICAL (WINDOW_GRAPH_MAX_RESOURCES * 2)
+
+// Each flush clears the dirty state set by a write (at most two per pass) or by an import
+#define WINDOW_GRAPH_MAX_BARRIERS (WINDOW_GRAPH_MAX_PASSES * 2 + WINDOW_GRAPH_MAX_RESOURCES)
+
+typedef struct WindowGraphAccess
+{
+    u32 resource;
+    bool write;
+    bool clear;
+} WindowGraphAccess;
+
+typedef struct WindowGraphPass
+{
+    const char* name;
+    WindowGraphPassFunc func;
+    void* user_data;
+    WindowGraphAccess accesses[WINDOW_GRAPH_MAX_ACCESSES];
+    u32 num_accesses;
+    bool side_effects;
+    bool live;                  // Not culled
+    u32 color;                  // Color target written (WINDOW_GRAPH_INVALID if none)
+    u32 depth;                  // Depth target written (WINDOW_GRAPH_INVALID if none)
+} WindowGraphPass;
+
+typedef struct WindowGraphResource
+{
+    const char* name;
+    u32 width;
+    u32 height;
+    WindowRenderTargetFormat format;
+    bool is_depth;
+    bool imported;
+    f32 clear_color[4];
+    WindowRenderTarget* target; // Imported target, or physical target of a transient target
+                                // (NULL for the window buffers and culled transient targets)
+    u32 first_pass;             // First and last passes using the target that were not culled
+    u32 last_pass;              // (WINDOW_GRAPH_INVALID if none)
+    u32 size;                   // Memory of transient targets
+    u32 alignment;
+    u32 offset;
+} WindowGraphResource;
+
+// Target backing transient targets
+typedef struct WindowGraphPhysical
+{
+    WindowRenderTarget* target;
+    u32 size;
+    u32 alignment;
+    u32 last_pass;              // Last pass of the transient targets given this target in the current
+                                // compile (WINDOW_GRAPH_INVALID if none)
+} WindowGraphPhysical;
+
+// Flush of a target from the color or depth cache
+typedef struct WindowGraphBarrier
+{
+    u32 pass;                   // Issued before this pass (or after the last pass if gNumPasses)
+    u32 resource;
+    bool texture;               // Also invalidate the texture cache, since the target is read next
+} WindowGraphBarrier;
+
+static WindowGraphPass gPasses[WINDOW_GRAPH_MAX_PASSES];
+static u32 gNumPasses = 0;
+static WindowGraphResource gResources[WINDOW_GRAPH_MAX_RESOURCES];
+static u32 gNumResources = 0;
+static bool gValid = true;      // No declaration failed since WindowGraphBegin
+static bool gCompiled = false;
+
+static WindowGraphPhysical gPhysical[WINDOW_GRAPH_MAX_PHYSICAL];
+static u32 gNumPhysical = 0;
+
+static WindowGraphBarrier gBarriers[WINDOW_GRAPH_MAX_BARRIERS];
+static u32 gNumBarriers = 0;
+
+// Transient memory, in which the targets are placed
+static u8* gMemory = NULL;
+static u32 gMemorySize = 0;
+static u32 gMemoryAlignment = 0;
+static bool gMemoryInMEM1 = false;
+
+static WindowGraphStats gStats;
+
+static void WindowGraphLog(const char* line)
+{
+#ifdef TEST_WIN
+    printf("%s", line);
+#else
+    OSReport("%s", line);
+#endif
+}
+
+static bool WindowGraphError(const WindowGraphPass* pass, const char* error)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "Frame graph: pass \"%s\" %s\n", pass->name, error);
+    WindowGraphLog(line);
+    return false;
+}
+
+static bool WindowGraphIsTransient(u32 resource)
+{
+    return !gResources[resource].imported;
+}
+
+static bool WindowGraphLifetimesOverlap(const WindowGraphResource* a, const WindowGraphResource* b)
+{
+    return a->first_pass <= b->last_pass && b->first_pass <= a->last_pass;
+}
+
+static bool WindowGraphMemoryOverlaps(const WindowGraphResource* a, const WindowGraphResource* b)
+{
+    return a->offset < b->offset + b->size && b->offset < a->offset + a->size;
+}
+
+static u32 WindowGraphAlign(u32 value, u32 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static u32 WindowGraphAddResource(const char* name, u32 width, u32 height, WindowRenderTargetFormat format, bool imported, WindowRenderTarget* target)
+{
+    if (gNumResources == WINDOW_GRAPH_MAX_RESOURCES)
+    {
+        gValid = false;
+        return WINDOW_GRAPH_INVALID;
+    }
+
+    WindowGraphResource* resource = &gResources[gNumResources];
+    memset(resource, 0, sizeof(WindowGraphResource));
+    resource->name = name;
+    resource->width = width;
+    resource->height = height;
+    resource->format = format;
+    resource->is_depth = WindowFormatIsDepth(format);
+    resource->imported = imported;
+    resource->target = target;
+    resource->clear_color[0] = resource->is_depth ? 1.0f : 0.0f;
+    resource->clear_color[3] = 1.0f;
+
+    return gNumResources++;
+}
+
+void WindowGraphBegin()
+{
+    gNumPasses = 0;
+    gNumResources = 0;
+    gValid = true;
+    gCompiled = false;
+
+    // The formats of the window buffers only tell color from depth
+    u32 width, height;
+    WindowGetRenderSize(&width, &height);
+    WindowGraphAddResource("window color", width, height, WINDOW_RT_FORMAT_RGBA8, true, NULL);
+    WindowGraphAddResource("window depth", width, height, WINDOW_RT_FORMAT_D24S8, true, NULL);
+}
+
+u32 WindowGraphCreateTarget(const char* name, u32 width, u32 height, WindowRenderTargetFormat format)
+{
+    if (width == 0 || height == 0 || format >= WINDOW_RT_FORMAT_COUNT)
+    {
+        gValid = false;
+        return WINDOW_GRAPH_INVALID;
+    }
+
+    return WindowGraphAddResource(name, width, height, format, false, NULL);
+}
+
+u32 WindowGraphImportTarget(const char* name, WindowRenderTarget* target)
+{
+    if (!target)
+    {
+        gValid = false;
+        return WINDOW_GRAPH_INVALID;
+    }
+
+    return WindowGraphAddResource(name, target->width, target->height, target->format, true, target);
+}
+
+void WindowGraphSetClearColor(u32 resource, f32 r, f32 g, f32 b, f32 a)
+{
+    if (resource >= gNumResources)
+        return;
+
+    f32* color = gResources[resource].clear_color;
+    color[0] = r;
+    color[1] = g;
+    color[2] = b;
+    color[3] = a;
+}
+
+u32 WindowGraphAddPass(const char* name, WindowGraphPassFunc func, void* user_data)
+{
+    if (gNumPasses == WINDOW_GRAPH_MAX_PASSES)
+    {
+        gValid = false;
+        return WINDOW_GRAPH_INVALID;
+    }
+
+    WindowGraphPass* pass = &gPasses[gNumPasses];
+    memset(pass, 0, sizeof(WindowGraphPass));
+    pass->name = name;
+    pass->func = func;
+    pass->user_data = user_data;
+
+    return gNumPasses++;
+}
+
+static void WindowGraphAddAccess(u32 pass, u32 resource, bool write, bool clear)
+{
+    if (pass >= gNumPasses || resource >= gNumResources || gPasses[pass].num_accesses == WINDOW_GRAPH_MAX_ACCESSES)
+    {
+        gValid = false;
+        return;
+    }
+
+    WindowGraphAccess* access = &gPasses[pass].accesses[gPasses[pass].num_accesses++];
+    access->resource = resource;
+    access->write = write;
+    access->clear = clear;
+}
+
+void WindowGraphRead(u32 pass, u32 resource)
+{
+    WindowGraphAddAccess(pass, resource, false, false);
+}
+
+void WindowGraphWrite(u32 pass, u32 resource, bool clear)
+{
+    WindowGraphAddAccess(pass, resource, true, clear);
+}
+
+void WindowGraphSetSideEffects(u32 pass)
+{
+    if (pass < gNumPasses)
+        gPasses[pass].side_effects = true;
+}
+
+// Find the targets each pass renders to, and check that it can
+static bool WindowGraphValidate()
+{
+    for (u32 p = 0; p < gNumPasses; p++)
+    {
+        WindowGraphPass* pass = &gPasses[p];
+        pass->color = WINDOW_GRAPH_INVALID;
+        pass->depth = WINDOW_GRAPH_INVALID;
+
+        for (u32 i = 0; i < pass->num_accesses; i++)
+        {
+            const WindowGraphAccess* access = &pass->accesses[i];
+            const WindowGraphResource* resource = &gResources[access->resource];
+
+            if (!access->write)
+            {
+                if (access->resource == WINDOW_GRAPH_WINDOW_COLOR || access->resource == WINDOW_GRAPH_WINDOW_DEPTH)
+                    return WindowGraphError(pass, "reads a window buffer");
+
+                if (resource->target && resource->target->samples > 1)
+                    return WindowGraphError(pass, "reads a multisampled target");
+
+                for (u32 j = 0; j < pass->num_accesses; j++)
+                {
+                    if (pass->accesses[j].write && pass->accesses[j].resource == access->resource)
+                        return WindowGraphError(pass, "reads a target it writes");
+                }
+
+                continue;
+            }
+
+            u32* written = resource->is_depth ? &pass->depth : &pass->color;
+            if (*written != WINDOW_GRAPH_INVALID && *written != access->resource)
+                return WindowGraphError(pass, "writes more than one color or depth target");
+
+            *written = access->resource;
+        }
+
+        // The window depth buffer is only attached to the window color buffer (on PC, it is part of
+        // the default framebuffer)
+        bool window_color = pass->color == WINDOW_GRAPH_WINDOW_COLOR;
+        bool window_depth = pass->depth == WINDOW_GRAPH_WINDOW_DEPTH;
+        if ((window_color && pass->depth != WINDOW_GRAPH_INVALID && !window_depth) || (window_depth && !window_color))
+            return WindowGraphError(pass, "mixes a window buffer with another target");
+
+        if (!window_color && pass->color != WINDOW_GRAPH_INVALID && pass->depth != WINDOW_GRAPH_INVALID
+            && (gResources[pass->color].width != gResources[pass->depth].width
+                || gResources[pass->color].height != gResources[pass->depth].height))
+            return WindowGraphError(pass, "writes targets of different sizes");
+    }
+
+    return true;
+}
+
+// Walk the passes backwards from the outputs, keeping those writing a target that is needed later
+static void WindowGraphCull()
+{
+    // The contents of imported targets outlive the frame
+    bool needed[WINDOW_GRAPH_MAX_RESOURCES];
+    for (u32 r = 0; r < gNumResources; r++)
+        needed[r] = gResources[r].imported;
+
+    for (u32 p = gNumPasses; p-- > 0;)
+    {
+        WindowGraphPass* pass = &gPasses[p];
+
+        pass->live = pass->side_effects;
+        for (u32 i = 0; i < pass->num_accesses; i++)
+        {
+            if (pass->accesses[i].write && needed[pass->accesses[i].resource])
+                pass->live = true;
+        }
+
+        if (!pass->live)
+        {
+            gStats.num_culled_passes++;
+            continue;
+        }
+
+        // A pass that clears a target does not need what earlier passes wrote to it, while a pass that
+        // renders over it (or tests against its depth) does
+        for (u32 i = 0; i < pass->num_accesses; i++)
+        {
+            const WindowGraphAccess* access = &pass->accesses[i];
+            if (access->write)
+                needed[access->resource] = !access->clear;
+        }
+
+        for (u32 i = 0; i < pass->num_accesses; i++)
+        {
+            const WindowGraphAccess* access = &pass->accesses[i];
+            if (!access->write)
+                needed[access->resource] = true;
+        }
+    }
+}
+
+// Find the first and last passes using each target
+static bool WindowGraphComputeLifetimes()
+{
+    bool written[WINDOW_GRAPH_MAX_RESOURCES];
+
+    for (u32 r = 0; r < gNumResources; r++)
+    {
+        gResources[r].first_pass = WINDOW_GRAPH_INVALID;
+        gResources[r].last_pass = WINDOW_GRAPH_INVALID;
+        written[r] = gResources[r].imported;
+    }
+
+    for (u32 p = 0; p < gNumPasses; p++)
+    {
+        const WindowGraphPass* pass = &gPasses[p];
+        if (!pass->live)
+            continue;
+
+        for (u32 i = 0; i < pass->num_accesses; i++)
+        {
+            const WindowGraphAccess* access = &pass->accesses[i];
+            WindowGraphResource* resource = &gResources[access->resource];
+
+            if (!access->write && !written[access->resource])
+                return WindowGraphError(pass, "reads a transient target before it is written");
+
+            written[access->resource] = true;
+
+            if (resource->first_pass == WINDOW_GRAPH_INVALID)
+                resource->first_pass = p;
+            resource->last_pass = p;
+        }
+    }
+
+    return true;
+}
+
+// Give each transient target a physical target, creating those missing
+static bool WindowGraphAssignTargets()
+{
+    for (u32 i = 0; i < gNumPhysical; i++)
+        gPhysical[i].last_pass = WINDOW_GRAPH_INVALID;
+
+    for (u32 r = 0; r < gNumResources; r++)
+    {
+        if (WindowGraphIsTransient(r))
+            gResources[r].target = NULL;
+    }
+
+    // In order of first use, so that a target is free once the last pass of the previous one is over
+    bool success = true;
+    for (u32 p = 0; p < gNumPasses && success; p++)
+    {
+        const WindowGraphPass* pass = &gPasses[p];
+        if (!pass->live)
+            continue;
+
+        for (u32 i = 0; i < pass->num_accesses; i++)
+        {
+            u32 r = pass->accesses[i].resource;
+            WindowGraphResource* resource = &gResources[r];
+            if (!WindowGraphIsTransient(r) || resource->first_pass != p || resource->target)
+                continue;
+
+            WindowGraphPhysical* physical = NULL;
+            for (u32 j = 0; j < gNumPhysical; j++)
+            {
+                WindowGraphPhysical* candidate = &gPhysical[j];
+                const WindowRenderTarget* target = candidate->target;
+                if (target->width != resource->width || target->height != resource->height || target->format != resource->format)
+                    continue;
+
+#ifdef TEST_WIN
+                // Targets with the same description share the texture if their lifetimes don't overlap
+                bool free = candidate->last_pass == WINDOW_GRAPH_INVALID || candidate->last_pass < p;
+#else
+                // Each transient target has its own buffer, and they share memory instead
+                bool free = candidate->last_pass == WINDOW_GRAPH_INVALID;
+#endif
+                if (free)
+                {
+                    physical = candidate;
+                    break;
+                }
+            }
+
+            if (!physical)
+            {
+                if (gNumPhysical == WINDOW_GRAPH_MAX_PHYSICAL)
+                {
+                    success = false;
+                    break;
+                }
+
+                physical = &gPhysical[gNumPhysical];
+                physical->target = WindowCreatePlacedRenderTarget(resource->width, resource->height, resource->format,
+                                                                  &physical->size, &physical->alignment);
+                if (!physical->target)
+                {
+                    success = false;
+                    break;
+                }
+
+                gNumPhysical++;
+            }
+
+            physical->last_pass = resource->last_pass;
+            resource->target = physical->target;
+            resource->size = physical->size;
+            resource->alignment = physical->alignment;
+        }
+    }
+
+    // Destroy the targets that are not needed anymore
+    // (The GPU does not need them: the command buffer holds copies of their registers)
+    u32 num_physical = 0;
+    for (u32 i = 0; i < gNumPhysical; i++)
+    {
+        if (gPhysical[i].last_pass == WINDOW_GRAPH_INVALID)
+            WindowDestroyPlacedRenderTarget(gPhysical[i].target);
+        else
+            gPhysical[num_physical++] = gPhysical[i];
+    }
+    gNumPhysical = num_physical;
+
+    return success;
+}
+
+// Place the transient targets in memory, so that targets used at the same time never overlap
+// Largest targets first: smaller ones then fill the gaps left around them
+static void WindowGraphPlaceTargets()
+{
+    u32 order[WINDOW_GRAPH_MAX_RESOURCES];
+    u32 count = 0;
+
+    for (u32 r = 0; r < gNumResources; r++)
+    {
+        if (!WindowGraphIsTransient(r))
+            continue;
+
+        gStats.num_transients++;
+        if (gResources[r].first_pass == WINDOW_GRAPH_INVALID)
+        {
+            gStats.num_culled_transients++;
+            continue;
+        }
+
+        // Insertion sort, by decreasing size
+        u32 i = count++;
+        while (i > 0 && gResources[order[i - 1]].size < gResources[r].size)
+        {
+            order[i] = order[i - 1];
+            i--;
+        }
+        order[i] = r;
+    }
+
+    u32 peak = 0;
+    u32 unaliased = 0;
+    u32 alignment = 1;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        WindowGraphResource* resource = &gResources[order[i]];
+        resource->offset = 0;
+
+        // Move past every target already placed that is in use at the same time and in the way
+        bool moved = true;
+        while (moved)
+        {
+            moved = false;
+            for (u32 j = 0; j < i; j++)
+            {
+                const WindowGraphResource* placed = &gResources[order[j]];
+                if (WindowGraphLifetimesOverlap(resource, placed) && WindowGraphMemoryOverlaps(resource, placed))
+                {
+                    resource->offset = WindowGraphAlign(placed->offset + placed->size, resource->alignment);
+                    moved = true;
+                }
+            }
+        }
+
+        if (resource->offset + resource->size > peak)
+            peak = resource->offset + resource->size;
+
+        unaliased = WindowGraphAlign(unaliased, resource->alignment) + resource->size;
+        if (resource->alignment > alignment)
+            alignment = resource->alignment;
+    }
+
+    gStats.aliased_size = peak;
+    gStats.unaliased_size = unaliased;
+
+    // Kept for when the memory is allocated again
+    if (alignment > gMemoryAlignment)
+        gMemoryAlignment = alignment;
+}
+
+// Allocate the transient memory if it grew, and give the targets their place in it
+static bool WindowGraphAllocMemory()
+{
+#ifdef TEST_GX2
+    u32 size = gStats.aliased_size;
+    if (size == 0)
+        return true;
+
+    if (!gMemory || size > gMemorySize || ((uintptr_t)gMemory & (gMemoryAlignment - 1)) != 0)
+    {
+        if (gMemory)
+        {
+            // The GPU may still be using it
+            GX2DrawDone();
+            WindowFreeRenderTargetMemory(gMemory, gMemorySize, gMemoryInMEM1);
+        }
+
+        gMemory = (u8*)WindowAllocRenderTargetMemory(size, gMemoryAlignment, &gMemoryInMEM1);
+        gMemorySize = gMemory ? size : 0;
+        if (!gMemory)
+            return false;
+    }
+
+    for (u32 r = 0; r < gNumResources; r++)
+    {
+        const WindowGraphResource* resource = &gResources[r];
+        if (WindowGraphIsTransient(r) && resource->target)
+            WindowPlaceRenderTarget(resource->target, gMemory + resource->offset);
+    }
+
+    gStats.in_mem1 = gMemoryInMEM1;
+#endif // TEST_GX2
+
+    return true;
+}
+
+static void WindowGraphAddBarrier(u32 pass, u32 resource, bool texture)
+{
+    WindowGraphBarrier* barrier = &gBarriers[gNumBarriers++];
+    barrier->pass = pass;
+    barrier->resource = resource;
+    barrier->texture = texture;
+}
+
+// Plan the flushes: a target written by a pass must be flushed from the color or depth cache (and the
+// texture cache invalidated) before a later pass samples it, or before another target placed in the
+// same memory is rendered to (so that the cache does not write stale lines over it later)
+static void WindowGraphPlanBarriers()
+{
+    // Imported targets may have been rendered to before the graph
+    bool dirty[WINDOW_GRAPH_MAX_RESOURCES];
+    for (u32 r = 0; r < gNumResources; r++)
+        dirty[r] = gResources[r].imported;
+
+    gNumBarriers = 0;
+
+    for (u32 p = 0; p < gNumPasses; p++)
+    {
+        const WindowGraphPass* pass = &gPasses[p];
+        if (!pass->live)
+            continue;
+
+        for (u32 i = 0; i < pass->num_accesses; i++)
+        {
+            const WindowGraphAccess* access = &pass->accesses[i];
+            const WindowGraphResource* resource = &gResources[access->resource];
+
+            if (access->clear)
+                gStats.num_clears++;
+
+            if (!access->write || !WindowGraphIsTransient(access->resource) || resource->first_pass != p)
+                continue;
+
+            // The target takes over memory from targets whose lifetime is over
+            for (u32 r = 0; r < gNumResources; r++)
+            {
+                const WindowGraphResource* previous = &gResources[r];
+                if (dirty[r] && WindowGraphIsTransient(r) && previous->last_pass < p
+                    && WindowGraphMemoryOverlaps(resource, previous))
+                {
+                    WindowGraphAddBarrier(p, r, false);
+                    dirty[r] = false;
+                }
+            }
+        }
+
+        for (u32 i = 0; i < pass->num_accesses; i++)
+        {
+            const WindowGraphAccess* access = &pass->accesses[i];
+            if (!access->write && dirty[access->resource])
+            {
+                WindowGraphAddBarrier(p, access->resource, true);
+                dirty[access->resource] = false;
+            }
+        }
+
+        for (u32 i = 0; i < pass->num_accesses; i++)
+        {
+            if (pass->accesses[i].write)
+                dirty[pass->accesses[i].resource] = true;
+        }
+    }
+
+    // The next compile may place other targets over them
+    for (u32 r = 0; r < gNumResources; r++)
+    {
+        if (dirty[r] && WindowGraphIsTransient(r))
+            WindowGraphAddBarrier(gNumPasses, r, false);
+    }
+
+    gStats.num_invalidates = gNumBarriers;
+}
+
+bool WindowGraphCompile()
+{
+    f64 start = WindowGetTime();
+
+    memset(&gStats, 0, sizeof(gStats));
+    gStats.num_passes = gNumPasses;
+    gCompiled = false;
+
+    bool success = gValid && WindowGraphValidate();
+    if (success)
+    {
+        WindowGraphCull();
+        success = WindowGraphComputeLifetimes() && WindowGraphAssignTargets();
+    }
+
+    if (success)
+    {
+        WindowGraphPlaceTargets();
+        success = WindowGraphAllocMemory();
+    }
+
+    if (success)
+    {
+        WindowGraphPlanBarriers();
+        gStats.num_physical_targets = gNumPhysical;
+    }
+
+    gCompiled = success;
+    gStats.compile_ms = (WindowGetTime() - start) * 1000.0;
+    return success;
+}
+
+static void WindowGraphIssueBarrier(const WindowGraphBarrier* barrier)
+{
+#ifdef TEST_GX2
+    const WindowGraphResource* resource = &gResources[barrier->resource];
+    const WindowRenderTarget* target = resource->target;
+    const GX2Surface* surface = resource->is_depth ? &target->depth_buffer.surface : &target->color_buffer.surface;
+
+    u32 mode = resource->is_depth ? GX2_INVALIDATE_MODE_DEPTH_BUFFER : GX2_INVALIDATE_MODE_COLOR_BUFFER;
+    if (barrier->texture)
+        mode |= GX2_INVALIDATE_MODE_TEXTURE;
+
+    GX2Invalidate((GX2InvalidateMode)mode, surface->image, surface->imageSize);
+#else
+    // OpenGL takes care of it
+    (void)barrier;
+#endif
+}
+
+// Clear the targets of the pass that it asks for, and render to its targets
+static void WindowGraphBeginPass(const WindowGraphPass* pass)
+{
+    if (pass->color == WINDOW_GRAPH_INVALID && pass->depth == WINDOW_GRAPH_INVALID)
+        return;
+
+    // The window buffers are set together
+    bool window = pass->color == WINDOW_GRAPH_WINDOW_COLOR;
+    const WindowRenderTarget* color = window || pass->color == WINDOW_GRAPH_INVALID ? NULL : gResources[pass->color].target;
+    const WindowRenderTarget* depth = window || pass->depth == WINDOW_GRAPH_INVALID ? NULL : gResources[pass->depth].target;
+
+#ifdef TEST_WIN
+
+    WindowSetRenderTargets(color, depth);
+
+    GLbitfield mask = 0;
+    for (u32 i = 0; i < pass->num_accesses; i++)
+    {
+        const WindowGraphAccess* access = &pass->accesses[i];
+        if (!access->clear)
+            continue;
+
+        const f32* clear_color = gResources[access->resource].clear_color;
+        if (gResources[access->resource].is_depth)
+        {
+            glClearDepth(clear_color[0]);
+            glClearStencil(0);
+            mask |= GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+        }
+        else
+        {
+            glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+            mask |= GL_COLOR_BUFFER_BIT;
+        }
+    }
+
+    if (mask != 0)
+        glClear(mask);
+
+#else // TEST_GX2
+
+    bool cleared = false;
+    for (u32 i = 0; i < pass->num_accesses; i++)
+    {
+        const WindowGraphAccess* access = &pass->accesses[i];
+        if (!access->clear)
+            continue;
+
+        const WindowGraphResource* resource = &gResources[access->resource];
+        const f32* clear_color = resource->clear_color;
+
+        if (access->resource == WINDOW_GRAPH_WINDOW_COLOR)
+            GX2ClearColor(WindowGetColorBuffer(), clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+        else if (access->resource == WINDOW_GRAPH_WINDOW_DEPTH)
+            GX2ClearDepthStencilEx(WindowGetDepthBuffer(), clear_color[0], 0, GX2_CLEAR_FLAGS_DEPTH);
+        else if (resource->is_depth)
+            GX2ClearDepthStencilEx(&resource->target->depth_buffer, clear_color[0], 0,
+                                   resource->format == WINDOW_RT_FORMAT_D24S8 ? GX2_CLEAR_FLAGS_BOTH : GX2_CLEAR_FLAGS_DEPTH);
+        else
+            GX2ClearColor(&resource->target->color_buffer, clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+
+        cleared = true;
+    }
+
+    // Clearing resets the state
+    if (cleared)
+        WindowMakeContextCurrent();
+
+    WindowSetRenderTargets(color, depth);
+
+#endif
+}
+
+void WindowGraphExecute()
+{
+    if (!gCompiled)
+        return;
+
+    u32 barrier = 0;
+
+    for (u32 p = 0; p < gNumPasses; p++)
+    {
+        const WindowGraphPass* pass = &gPasses[p];
+        if (!pass->live)
+            continue;
+
+        for (; barrier < gNumBarriers && gBarriers[barrier].pass == p; barrier++)
+            WindowGraphIssueBarrier(&gBarriers[barrier]);
+
+        WindowGraphBeginPass(pass);
+
+        if (pass->func)
+            pass->func(pass->user_data);
+    }
+
+    for (; barrier < gNumBarriers; barrier++)
+        WindowGraphIssueBarrier(&gBarriers[barrier]);
+
+    WindowSetRenderTargets(NULL, NULL);
+}
+
+const WindowRenderTarget* WindowGraphGetTarget(u32 resource)
+{
+    if (!gCompiled || resource >= gNumResources)
+        return NULL;
+
+    return gResources[resource].target;
+}
+
+void WindowGraphGetStats(WindowGraphStats* pStats)
+{
+    *pStats = gStats;
+}
+
+void WindowGraphPrint()
+{
+    char line[256];
+
+    snprintf(
+        line, sizeof(line),
+        "Frame graph: %u passes (%u culled), %u transient targets (%u culled) in %u targets\n",
+        gStats.num_passes, gStats.num_culled_passes,
+        gStats.num_transients, gStats.num_culled_transients, gStats.num_physical_targets
+    );
+    WindowGraphLog(line);
+
+    for (u32 p = 0; p < gNumPasses; p++)
+    {
+        snprintf(line, sizeof(line), "  Pass %2u %-20s%s\n", p, gPasses[p].name, gPasses[p].live ? "" : " (culled)");
+        WindowGraphLog(line);
+    }
+
+    for (u32 r = 0; r < gNumResources; r++)
+    {
+        const WindowGraphResource* resource = &gResources[r];
+        if (!WindowGraphIsTransient(r))
+            continue;
+
+        if (resource->first_pass == WINDOW_GRAPH_INVALID)
+        {
+            snprintf(line, sizeof(line), "  %-20s %4ux%-4u %-8s culled\n", resource->name,
+                     resource->width, resource->height, WindowFormatGetName(resource->format));
+        }
+        else
+        {
+            snprintf(line, sizeof(line), "  %-20s %4ux%-4u %-8s passes %2u-%-2u at %6u KB, %5u KB\n", resource->name,
+                     resource->width, resource->height, WindowFormatGetName(resource->format),
+                     resource->first_pass, resource->last_pass, resource->offset / 1024, resource->size / 1024);
+        }
+        WindowGraphLog(line);
+    }
+
+#ifdef TEST_WIN
+    const char* memory = "estimated";
+#else
+    const char* memory = gStats.in_mem1 ? "MEM1" : "MEM2";
+#endif
+
+    snprintf(
+        line, sizeof(line),
+        "  Peak %s: %u KB aliased, %u KB without aliasing; %u invalidates, %u clears\n",
+        memory, gStats.aliased_size / 1024, gStats.unaliased_size / 1024,
+        gStats.num_invalidates, gStats.num_clears
+    );
+    WindowGraphLog(line);
+}
+
+void WindowGraphReleaseForeground()
+{
+#ifdef TEST_GX2
+    // The memory goes away with the pool heap (the size is kept to allocate it again)
+    if (gMemory)
+    {
+        WindowFreeRenderTargetMemory(gMemory, gMemorySize, gMemoryInMEM1);
+        gMemory = NULL;
+    }
+#endif // TEST_GX2
+}
+
+void WindowGraphAcquireForeground()
+{
+#ifdef TEST_GX2
+    if (gMemory || gMemorySize == 0)
+        return;
+
+    gMemory = (u8*)WindowAllocRenderTargetMemory(gMemorySize, gMemoryAlignment, &gMemoryInMEM1);
+    if (!gMemory)
+    {
+        // Nothing is executed until the next compile manages to allocate it
+        gMemorySize = 0;
+        gCompiled = false;
+        return;
+    }
+
+    for (u32 r = 0; r < gNumResources; r++)
+    {
+        const WindowGraphResource* resource = &gResources[r];
+        if (WindowGraphIsTransient(r) && resource->target)
+            WindowPlaceRenderTarget(resource->target, gMemory + resource->offset);
+    }
+
+    gStats.in_mem1 = gMemoryInMEM1;
+#endif // TEST_GX2
+}
+
+void WindowGraphExit()
+{
+#ifdef TEST_GX2
+    if (gMemory || gNumPhysical != 0)
+        GX2DrawDone();
+
+    WindowFreeRenderTargetMemory(gMemory, gMemorySize, gMemoryInMEM1);
+#endif // TEST_GX2
+
+    for (u32 i = 0; i < gNumPhysical; i++)
+        WindowDestroyPlacedRenderTarget(gPhysical[i].target);
+
+    gNumPhysical = 0;
+    gMemory = NULL;
+    gMemorySize = 0;
+    gMemoryAlignment = 0;
+    gMemoryInMEM1 = false;
+
+    gNumPasses = 0;
+    gNumResources = 0;
+    gNumBarriers = 0;
+    gCompiled = false;
+    memset(&gStats, 0, sizeof(gStats));
+}
@@ -0,0 +1,147 @@
+// Frame graph
+// The passes of a frame are declared with the targets they read (sample as textures) and write
+// (render to), then compiled into a plan before they are executed:
+// - Passes that contribute nothing to an output (the window buffers, imported targets, or a pass
+//   with side effects) are culled
+// - The lifetime of each transient target is the span of passes using it, and targets whose
+//   lifetimes don't overlap share the same memory (aliasing)
+// - The cache flushes and invalidations needed between a pass writing a target and a pass reading it
+//   (or reusing its memory) are inserted, and nothing else
+// Transient targets exist only within a frame: their contents are undefined before the first pass
+// writing them, so that pass usually clears them
+// - Wii U: transient targets are placed in one block of memory taken from the render target pool
+//          (in MEM1 while its budget allows, see render_target.h), at offsets chosen so that targets
+//          used at the same time never overlap; targets are flushed from the color or depth cache and
+//          the texture cache is invalidated with GX2Invalidate where the plan needs it
+// - PC: targets can't share memory, so transient targets with the same description and lifetimes that
+//       don't overlap share the same texture and framebuffer object instead; OpenGL tracks the hazards
+//       itself, so no flushes are issued. Memory sizes are estimates, computed as on Wii U
+// The graph is meant to be built, compiled and executed every frame (targets and memory are kept
+// from one compile to the next), so passes can be enabled or resized freely
+
+#ifndef FRAME_GRAPH_H_
+#define FRAME_GRAPH_H_
+
+#include "render_target.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#define WINDOW_GRAPH_MAX_PASSES     64
+#define WINDOW_GRAPH_MAX_RESOURCES  64
+#define WINDOW_GRAPH_MAX_ACCESSES   8   // Most targets read and written by a pass
+
+// Returned when a table is full
+#define WINDOW_GRAPH_INVALID        0xFFFFFFFF
+
+// The window color and depth buffers, imported into every graph
+#define WINDOW_GRAPH_WINDOW_COLOR   0
+#define WINDOW_GRAPH_WINDOW_DEPTH   1
+
+// Called to record the commands of a pass, with its targets set (see WindowSetRenderTargets)
+typedef void (*WindowGraphPassFunc)(void* user_data);
+
+// Frame graph statistics (of the last compile)
+typedef struct WindowGraphStats
+{
+    u32 num_passes;             // Passes added
+    u32 num_culled_passes;      // Passes culled
+    u32 num_transients;         // Transient targets created
+    u32 num_culled_transients;  // Transient targets only used by culled passes (given no memory)
+    u32 num_physical_targets;   // Targets backing the transient targets (PC: targets with the same
+                                // description share one)
+    u32 num_invalidates;        // GX2Invalidate calls per execution (counted, not issued, on PC)
+    u32 num_clears;             // Targets cleared per execution
+    u32 unaliased_size;         // Bytes the transient targets would take with memory of their own
+    u32 aliased_size;           // Bytes they take when sharing memory (the peak of the plan)
+    bool in_mem1;               // Wii U: the transient memory is in MEM1
+    f64 compile_ms;             // Time spent in the last WindowGraphCompile
+} WindowGraphStats;
+
+// Start a new graph, with only the window buffers declared
+void WindowGraphBegin();
+
+// Declare a transient target
+// Parameters:
+// - name: Name of the target (for the report; the string must outlive the graph)
+// - width, height: Size of the target
+// - format: Format of the target (transient targets are single-sample: multisampled targets can be
+//           acquired from the pool and imported)
+// Returns the resource, or WINDOW_GRAPH_INVALID if the table is full
+u32 WindowGraphCreateTarget(const char* name, u32 width, u32 height, WindowRenderTargetFormat format);
+
+// Import a target that lives outside of the graph (e.g. one kept from frame to frame)
+// Its contents are kept, so the passes writing it are never culled
+// Returns the resource, or WINDOW_GRAPH_INVALID if the table is full
+u32 WindowGraphImportTarget(const char* name, WindowRenderTarget* target);
+
+// Set the color (or the depth, in r) targets are cleared to (default: 0, 0, 0, 1 and a depth of 1)
+void WindowGraphSetClearColor(u32 resource, f32 r, f32 g, f32 b, f32 a);
+
+// Add a pass
+// Passes execute in the order they are added
+// Parameters:
+// - name: Name of the pass (for the report; the string must outlive the graph)
+// - func: Records the commands of the pass
+// - user_data: Passed to func
+// Returns the pass, or WINDOW_GRAPH_INVALID if the table is full
+u32 WindowGraphAddPass(const char* name, WindowGraphPassFunc func, void* user_data);
+
+// Declare that a pass samples a target as a texture (see WindowGraphGetTarget)
+// The window buffers can't be read
+void WindowGraphRead(u32 pass, u32 resource);
+
+// Declare that a pass renders to a target
+// A pass writes at most one color and one depth target, of the same size; the window color buffer can
+// only be written with the window depth buffer (or no depth buffer)
+// Parameters:
+// - pass: The pass
+// - resource: The target
+// - clear: Whether the target is cleared before the pass (its previous contents are not needed)
+void WindowGraphWrite(u32 pass, u32 resource, bool clear);
+
+// Keep a pass even if nothing reads what it writes (e.g. it reads back results)
+void WindowGraphSetSideEffects(u32 pass);
+
+// Compile the graph: cull passes, compute lifetimes, place transient targets and plan the flushes
+// Returns false if the graph is invalid (a target read before it is written, or a pass with targets
+// it can't render to) or if the memory of the transient targets could not be allocated
+bool WindowGraphCompile();
+
+// Execute the passes that were not culled, with their flushes, clears and targets
+// The window buffers are set as render targets afterwards
+void WindowGraphExecute();
+
+// Get the target of a resource, to sample it in a pass reading it
+// Transient targets are only valid from WindowGraphCompile to the next WindowGraphBegin, and only
+// hold the contents written by the graph within the passes reading them
+// Returns NULL for the window buffers and culled transient targets
+const WindowRenderTarget* WindowGraphGetTarget(u32 resource);
+
+// Get the statistics of the last compile
+void WindowGraphGetStats(WindowGraphStats* pStats);
+
+// Print the plan of the last compile: passes, lifetimes and placement of the transient targets, and
+// memory with and without aliasing (to stdout on PC, to the system log on Wii U)
+void WindowGraphPrint();
+
+// Give back the transient memory when the application releases the foreground (Wii U)
+// Called by the window before the render target pool releases its MEM1 memory (does nothing on PC)
+void WindowGraphReleaseForeground();
+
+// Allocate the transient memory again when the application acquires the foreground (Wii U); the
+// contents of transient targets are undefined anyway
+// Called by the window after the render target pool (does nothing on PC)
+void WindowGraphAcquireForeground();
+
+// Destroy the transient targets and free their memory
+// Must be called before WindowRenderTargetExit
+void WindowGraphExit();
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // FRAME_GRAPH_H_
@@ -0,0 +1,153 @@
+// Frame pacing controller used by the swap path of the windowing library
+
+#include "frame_pacing.h"
+
+// Number of late frames within the last 64 frames that triggers raising the swap interval
+#define FRAME_PACING_LATE_THRESHOLD 4
+
+// A frame counts as "calm" if its work fits in this fraction of the base interval
+#define FRAME_PACING_CALM_MARGIN 0.8
+
+// Calm frames required before returning to the base interval (~2 s at 60 Hz)
+// Doubled every time returning to the base interval fails quickly, up to the maximum
+#define FRAME_PACING_CALM_MIN 120
+#define FRAME_PACING_CALM_MAX 1920
+
+// Raising the interval again within this many frames of lowering it counts as a failed attempt
+#define FRAME_PACING_RELAPSE_FRAMES 120
+
+// Staying at the base interval for this many frames forgets previous failed attempts
+#define FRAME_PACING_STABLE_FRAMES 1800
+
+// Weight of the newest frame in the average frame time
+#define FRAME_PACING_AVG_WEIGHT 0.05
+
+static u32 FramePacingCountBits(u64 bits)
+{
+    u32 count = 0;
+    while (bits)
+    {
+        bits &= bits - 1;
+        count++;
+    }
+    return count;
+}
+
+static void FramePacingSwitch(FramePacing* pacing, u32 interval)
+{
+    pacing->interval = interval;
+    pacing->late_history = 0;
+    pacing->calm_frames = 0;
+    pacing->frames_since_switch = 0;
+    pacing->interval_switches++;
+}
+
+void FramePacingInit(FramePacing* pacing, f64 refresh_period, u32 swap_interval)
+{
+    pacing->refresh_period = refresh_period;
+    pacing->base_interval = swap_interval;
+    pacing->adaptive = false;
+
+    pacing->interval = swap_interval;
+    pacing->late_history = 0;
+    pacing->calm_frames = 0;
+    pacing->calm_required = FRAME_PACING_CALM_MIN;
+    pacing->frames_since_switch = 0;
+    pacing->last_flip_time = 0.0;
+
+    pacing->frames = 0;
+    pacing->late_frames = 0;
+    pacing->missed_vblanks = 0;
+    pacing->interval_switches = 0;
+    pacing->last_frame_time = 0.0;
+    pacing->avg_frame_time = 0.0;
+}
+
+void FramePacingSetBaseInterval(FramePacing* pacing, u32 swap_interval)
+{
+    pacing->base_interval = swap_interval;
+    pacing->interval = swap_interval;
+    pacing->late_history = 0;
+    pacing->calm_frames = 0;
+    pacing->calm_required = FRAME_PACING_CALM_MIN;
+    pacing->frames_since_switch = 0;
+}
+
+u32 FramePacingUpdate(FramePacing* pacing, f64 flip_time, u32 vblanks, f64 work_time)
+{
+    pacing->frames++;
+
+    // The first frame has nothing to be compared with
+    if (pacing->last_flip_time == 0.0)
+    {
+        pacing->last_flip_time = flip_time;
+        return pacing->interval;
+    }
+
+    f64 frame_time = flip_time - pacing->last_flip_time;
+    pacing->last_flip_time = flip_time;
+
+    pacing->last_frame_time = frame_time;
+    if (pacing->avg_frame_time == 0.0)
+        pacing->avg_frame_time = frame_time;
+    else
+        pacing->avg_frame_time += (frame_time - pacing->avg_frame_time) * FRAME_PACING_AVG_WEIGHT;
+
+    // Without vsync, no frame can be late
+    if (pacing->refresh_period <= 0.0 || pacing->interval == 0)
+        return pacing->interval;
+
+    // Number of refreshes this frame was on screen for
+    if (vblanks == 0)
+    {
+        vblanks = (u32)(frame_time / pacing->refresh_period + 0.5);
+        if (vblanks == 0)
+            vblanks = 1;
+    }
+
+    bool late = vblanks > pacing->interval;
+    pacing->late_history = (pacing->late_history << 1) | (late ? 1 : 0);
+    if (late)
+    {
+        pacing->late_frames++;
+        pacing->missed_vblanks += vblanks - pacing->interval;
+    }
+
+    pacing->frames_since_switch++;
+
+    if (!pacing->adaptive || pacing->base_interval == 0)
+        return pacing->interval;
+
+    if (pacing->interval == pacing->base_interval)
+    {
+        if (pacing->frames_since_switch >= FRAME_PACING_STABLE_FRAMES)
+            pacing->calm_required = FRAME_PACING_CALM_MIN;
+
+        if (FramePacingCountBits(pacing->late_history) >= FRAME_PACING_LATE_THRESHOLD)
+        {
+            // Going back up right after coming down means the last attempt was premature
+            if (pacing->interval_switches > 0 && pacing->frames_since_switch < FRAME_PACING_RELAPSE_FRAMES)
+            {
+                pacing->calm_required *= 2;
+                if (pacing->calm_required > FRAME_PACING_CALM_MAX)
+                    pacing->calm_required = FRAME_PACING_CALM_MAX;
+            }
+
+            // Present every other refresh instead of juddering between the two rates
+            FramePacingSwitch(pacing, pacing->base_interval * 2);
+        }
+    }
+    else
+    {
+        f64 budget = pacing->base_interval * pacing->refresh_period * FRAME_PACING_CALM_MARGIN;
+        if (!late && work_time <= budget)
+            pacing->calm_frames++;
+        else
+            pacing->calm_frames = 0;
+
+        if (pacing->calm_frames >= pacing->calm_required)
+            FramePacingSwitch(pacing, pacing->base_interval);
+    }
+
+    return pacing->interval;
+}
@@ -0,0 +1,61 @@
+// Frame pacing controller used by the swap path of the windowing library
+// Detects late frames from flip timestamps and optionally switches the swap interval
+// between the requested value and twice that value, with hysteresis
+
+#ifndef FRAME_PACING_H_
+#define FRAME_PACING_H_
+
+#include <test_types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef struct FramePacing
+{
+    // Configuration
+    f64 refresh_period;   // Duration of one display refresh, in seconds
+    u32 base_interval;    // Swap interval requested by the user
+    bool adaptive;        // Whether the swap interval may be raised automatically
+
+    // Controller state
+    u32 interval;         // Swap interval currently in use
+    u64 late_history;     // One bit per recent frame, set if that frame was late
+    u32 calm_frames;      // Consecutive frames that would have fit in the base interval
+    u32 calm_required;    // Calm frames required before returning to the base interval
+    u32 frames_since_switch;
+    f64 last_flip_time;   // Timestamp of the previous flip, in seconds (0 if none yet)
+
+    // Statistics
+    u64 frames;
+    u64 late_frames;
+    u64 missed_vblanks;
+    u32 interval_switches;
+    f64 last_frame_time;
+    f64 avg_frame_time;
+} FramePacing;
+
+// Reset the controller
+// Parameters:
+// - refresh_period: Duration of one display refresh in seconds (0 if there is no display to sync to)
+// - swap_interval: The swap interval requested by the user
+void FramePacingInit(FramePacing* pacing, f64 refresh_period, u32 swap_interval);
+
+// Change the swap interval requested by the user (resets the adaptive state, keeps statistics)
+void FramePacingSetBaseInterval(FramePacing* pacing, u32 swap_interval);
+
+// Feed the controller with the timing of the frame that was just presented
+// Parameters:
+// - flip_time: Timestamp at which the frame was flipped, in seconds
+// - vblanks: Number of refreshes elapsed since the previous flip, if known exactly
+//            (e.g. from the hardware vsync counter), or 0 to derive it from flip_time
+// - work_time: Time spent producing the frame before presenting it, in seconds
+// Returns the swap interval to use from now on
+u32 FramePacingUpdate(FramePacing* pacing, f64 flip_time, u32 vblanks, f64 work_time);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // FRAME_PACING_H_
@@ -0,0 +1,384 @@
+// Framebuffer format and memory layout planner
+
+#include "window.h"
+#include "format.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef TEST_GX2
+
+#include <coreinit/debug.h>
+#include <coreinit/memfrmheap.h>
+#include <coreinit/memheap.h>
+#include <gx2/display.h>
+#include <gx2/surface.h>
+
+#endif // TEST_GX2
+
+// Size of MEM1
+#define WINDOW_MEM1_SIZE 0x2000000
+
+// MEM2 has a fraction of the bandwidth of MEM1, so the same traffic costs this many times more there
+#define WINDOW_MEM2_TRAFFIC_FACTOR 4
+
+typedef struct WindowHints
+{
+    WindowRenderTargetFormat color_format;
+    WindowRenderTargetFormat depth_format;
+    u32 samples;
+    u32 mem1_budget;
+    u32 downgrade;
+} WindowHints;
+
+static WindowHints gHints = {
+    WINDOW_RT_FORMAT_RGBA8,
+    WINDOW_RT_FORMAT_D32F,
+    1,
+    0,
+    0
+};
+
+void WindowHint(WindowHintType hint, u32 value)
+{
+    switch (hint)
+    {
+    case WINDOW_HINT_COLOR_FORMAT:
+        gHints.color_format = (WindowRenderTargetFormat)value;
+        break;
+    case WINDOW_HINT_DEPTH_FORMAT:
+        gHints.depth_format = (WindowRenderTargetFormat)value;
+        break;
+    case WINDOW_HINT_SAMPLES:
+        gHints.samples = value;
+        break;
+    case WINDOW_HINT_MEM1_BUDGET:
+        gHints.mem1_budget = value;
+        break;
+    case WINDOW_HINT_DOWNGRADE:
+        gHints.downgrade = value;
+        break;
+    }
+}
+
+void WindowDefaultHints()
+{
+    gHints.color_format = WINDOW_RT_FORMAT_RGBA8;
+    gHints.depth_format = WINDOW_RT_FORMAT_D32F;
+    gHints.samples = 1;
+    gHints.mem1_budget = 0;
+    gHints.downgrade = 0;
+}
+
+// Determine the framebuffer size for the desired size
+static void WindowPlanGetSize(u32 width, u32 height, u32* pWidth, u32* pHeight)
+{
+#ifdef TEST_WIN
+
+    // Any size is fine on PC
+    *pWidth = width;
+    *pHeight = height;
+
+#else // TEST_GX2
+
+    // The framebuffer has the size of the TV scan buffer
+    GX2TVScanMode tv_scan_mode = GX2GetSystemTVScanMode();
+
+    if (tv_scan_mode != GX2_TV_SCAN_MODE_576I && tv_scan_mode != GX2_TV_SCAN_MODE_480I
+        && width >= 1920 && height >= 1080)
+    {
+        *pWidth = 1920;
+        *pHeight = 1080;
+    }
+    else if (width >= 1280 && height >= 720)
+    {
+        *pWidth = 1280;
+        *pHeight = 720;
+    }
+    else if (width >= 850 && height >= 480)
+    {
+        *pWidth = 854;
+        *pHeight = 480;
+    }
+    else // if (width >= 640 && height >= 480)
+    {
+        *pWidth = 640;
+        *pHeight = 480;
+    }
+
+#endif
+}
+
+// Size of a buffer surface
+static u32 WindowPlanGetSurfaceSize(u32 width, u32 height, WindowRenderTargetFormat format, u32 samples)
+{
+#ifdef TEST_WIN
+
+    // Estimate: surfaces are tiled in blocks of 32x32 pixels at most
+    // (AA auxiliary buffers are not included)
+    return ((width + 31) & ~31) * ((height + 31) & ~31) * WindowFormatGetBytesPerPixel(format) * samples;
+
+#else // TEST_GX2
+
+    if (WindowFormatIsDepth(format))
+    {
+        GX2DepthBuffer depth_buffer;
+        memset(&depth_buffer, 0, sizeof(depth_buffer));
+
+        GX2Surface* surface = &depth_buffer.surface;
+        surface->dim = GX2_SURFACE_DIM_TEXTURE_2D;
+        surface->width = width;
+        surface->height = height;
+        surface->depth = 1;
+        surface->mipLevels = 1;
+        surface->format = WindowFormatGetSurfaceFormat(format);
+        surface->aa = WindowFormatGetAAMode(samples);
+        surface->use = GX2_SURFACE_USE_TEXTURE | GX2_SURFACE_USE_DEPTH_BUFFER;
+        surface->tileMode = GX2_TILE_MODE_DEFAULT;
+        GX2CalcSurfaceSizeAndAlignment(surface);
+
+        return surface->imageSize;
+    }
+
+    GX2ColorBuffer color_buffer;
+    memset(&color_buffer, 0, sizeof(color_buffer));
+
+    GX2Surface* surface = &color_buffer.surface;
+    surface->dim = GX2_SURFACE_DIM_TEXTURE_2D;
+    surface->width = width;
+    surface->height = height;
+    surface->depth = 1;
+    surface->mipLevels = 1;
+    surface->format = WindowFormatGetSurfaceFormat(format);
+    surface->aa = WindowFormatGetAAMode(samples);
+    surface->use = samples > 1 ? GX2_SURFACE_USE_COLOR_BUFFER : GX2_SURFACE_USE_TEXTURE_COLOR_BUFFER_TV;
+    surface->tileMode = GX2_TILE_MODE_DEFAULT;
+    GX2CalcSurfaceSizeAndAlignment(surface);
+
+    u32 size = surface->imageSize;
+
+    // Multisampled color buffers need an auxiliary buffer
+    if (samples > 1)
+    {
+        u32 aa_size, aa_alignment;
+        GX2InitColorBufferRegs(&color_buffer);
+        GX2CalcColorBufferAuxInfo(&color_buffer, &aa_size, &aa_alignment);
+        size += aa_size;
+    }
+
+    return size;
+
+#endif
+}
+
+// Size of the TV and DRC scan buffers
+static u32 WindowPlanGetScanBuffersSize(u32 width, u32 height)
+{
+#ifdef TEST_WIN
+
+    // Estimate: double-buffered RGBA8 TV and DRC (854x480) scan buffers
+    return width * height * 4 * 2 + 854 * 480 * 4 * 2;
+
+#else // TEST_GX2
+
+    u32 tv_scan_buffer_size, drc_scan_buffer_size, unk;
+    GX2CalcTVSize(
+        WindowFormatGetTVRenderMode(width),
+        GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8,
+        GX2_BUFFERING_MODE_DOUBLE,
+        &tv_scan_buffer_size,
+        &unk
+    );
+    GX2CalcDRCSize(
+        GX2_DRC_RENDER_MODE_SINGLE,
+        GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8,
+        GX2_BUFFERING_MODE_DOUBLE,
+        &drc_scan_buffer_size,
+        &unk
+    );
+
+    (void)height;
+    return tv_scan_buffer_size + drc_scan_buffer_size;
+
+#endif
+}
+
+// Estimate the memory traffic of a frame in KB, assuming every sample of the color and depth buffers
+// is read and written once (blending, depth test), and the color buffer is read once more to be
+// copied to the scan buffers
+// Multisampled color buffers are also read once more to be resolved, and the resolved pixels written
+static u32 WindowPlanGetTrafficCost(const WindowFramebufferPlan* plan)
+{
+    u64 pixels = (u64)plan->width * plan->height;
+
+    u32 color_accesses = plan->samples * 2 + 1;
+    if (plan->samples > 1)
+        color_accesses += plan->samples + 1;
+
+    u64 color_traffic = pixels * WindowFormatGetBytesPerPixel(plan->color_format) * color_accesses;
+    u64 depth_traffic = pixels * WindowFormatGetBytesPerPixel(plan->depth_format) * plan->samples * 2;
+
+    if (plan->color_memory == WINDOW_MEMORY_MEM2)
+        color_traffic *= WINDOW_MEM2_TRAFFIC_FACTOR;
+    if (plan->depth_memory == WINDOW_MEMORY_MEM2)
+        depth_traffic *= WINDOW_MEM2_TRAFFIC_FACTOR;
+
+    return (u32)((color_traffic + depth_traffic) / 1024);
+}
+
+// Place the buffers of the plan in the cheapest layout that fits the MEM1 budget
+static void WindowPlanLayout(WindowFramebufferPlan* plan)
+{
+    plan->color_size = WindowPlanGetSurfaceSize(plan->width, plan->height, plan->color_format, plan->samples);
+    if (plan->samples > 1)
+        plan->color_size += WindowPlanGetSurfaceSize(plan->width, plan->height, plan->color_format, 1);
+    plan->depth_size = WindowPlanGetSurfaceSize(plan->width, plan->height, plan->depth_format, plan->samples);
+
+    static const WindowMemory layouts[4][2] = {
+        { WINDOW_MEMORY_MEM1, WINDOW_MEMORY_MEM1 },
+        { WINDOW_MEMORY_MEM1, WINDOW_MEMORY_MEM2 },
+        { WINDOW_MEMORY_MEM2, WINDOW_MEMORY_MEM1 },
+        { WINDOW_MEMORY_MEM2, WINDOW_MEMORY_MEM2 }
+    };
+
+    WindowFramebufferPlan best;
+    best.traffic_cost = 0xFFFFFFFF;
+
+    for (u32 i = 0; i < 4; i++)
+    {
+        WindowFramebufferPlan candidate = *plan;
+        candidate.color_memory = layouts[i][0];
+        candidate.depth_memory = layouts[i][1];
+
+        candidate.mem1_used = 0;
+        candidate.mem2_used = 0;
+
+        if (candidate.color_memory == WINDOW_MEMORY_MEM1)
+            candidate.mem1_used += candidate.color_size;
+        else
+            candidate.mem2_used += candidate.color_size;
+
+        if (candidate.depth_memory == WINDOW_MEMORY_MEM1)
+            candidate.mem1_used += candidate.depth_size;
+        else
+            candidate.mem2_used += candidate.depth_size;
+
+        if (candidate.mem1_used > candidate.mem1_budget)
+            continue;
+
+        candidate.traffic_cost = WindowPlanGetTrafficCost(&candidate);
+        if (candidate.traffic_cost < best.traffic_cost)
+            best = candidate;
+    }
+
+    // Placing everything in MEM2 always fits
+    *plan = best;
+}
+
+// Lower the quality of the plan by one step, in the order allowed by the downgrade flags
+// Returns false if there is nothing left to downgrade
+static bool WindowPlanDowngrade(WindowFramebufferPlan* plan, u32 flags)
+{
+    if ((flags & WINDOW_DOWNGRADE_SAMPLES) && plan->samples > 1)
+    {
+        plan->samples /= 2;
+        return true;
+    }
+
+    if ((flags & WINDOW_DOWNGRADE_DEPTH) && plan->depth_format != WINDOW_RT_FORMAT_D16)
+    {
+        plan->depth_format = WINDOW_RT_FORMAT_D16;
+        return true;
+    }
+
+    if ((flags & WINDOW_DOWNGRADE_COLOR) && plan->color_format == WINDOW_RT_FORMAT_RGBA16F)
+    {
+        plan->color_format = WINDOW_RT_FORMAT_RGB10_A2;
+        return true;
+    }
+
+    return false;
+}
+
+bool WindowPlanFramebuffer(u32 width, u32 height, WindowFramebufferPlan* pPlan)
+{
+    if (gHints.color_format != WINDOW_RT_FORMAT_RGBA8
+        && gHints.color_format != WINDOW_RT_FORMAT_RGB10_A2
+        && gHints.color_format != WINDOW_RT_FORMAT_RGBA16F)
+        return false;
+
+    if (gHints.depth_format != WINDOW_RT_FORMAT_D32F
+        && gHints.depth_format != WINDOW_RT_FORMAT_D24S8
+        && gHints.depth_format != WINDOW_RT_FORMAT_D16)
+        return false;
+
+    if (gHints.samples != 1 && gHints.samples != 2 && gHints.samples != 4 && gHints.samples != 8)
+        return false;
+
+    // Budget: all of the MEM1 available, unless a lower budget was requested
+#ifdef TEST_WIN
+    u32 mem1_available = WINDOW_MEM1_SIZE;
+#else
+    u32 mem1_available = MEMGetAllocatableSizeForFrmHeapEx(MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM1), 4);
+#endif
+    u32 mem1_budget = gHints.mem1_budget;
+    if (mem1_budget == 0 || mem1_budget > mem1_available)
+        mem1_budget = mem1_available;
+
+    WindowFramebufferPlan plan;
+    memset(&plan, 0, sizeof(plan));
+
+    WindowPlanGetSize(width, height, &plan.width, &plan.height);
+    plan.color_format = gHints.color_format;
+    plan.depth_format = gHints.depth_format;
+    plan.samples = gHints.samples;
+    plan.scan_buffers_size = WindowPlanGetScanBuffersSize(plan.width, plan.height);
+    plan.mem1_budget = mem1_budget;
+
+    // Keep the requested formats if they fit in MEM1, otherwise lower their quality as allowed until
+    // they do; if they never do, take the cheapest of the layouts that spill into MEM2
+    WindowPlanLayout(&plan);
+    WindowFramebufferPlan best = plan;
+
+    while (plan.mem2_used != 0 && WindowPlanDowngrade(&plan, gHints.downgrade))
+    {
+        plan.downgraded = true;
+        WindowPlanLayout(&plan);
+
+        if (plan.mem2_used == 0 || plan.traffic_cost < best.traffic_cost)
+            best = plan;
+    }
+
+    *pPlan = best;
+    return true;
+}
+
+void WindowPrintFramebufferPlan(const WindowFramebufferPlan* pPlan)
+{
+    char line[512];
+    snprintf(
+        line, sizeof(line),
+        "Framebuffer plan: %ux%u, %ux\n"
+        "  Color: %s in %s (%u KB)\n"
+        "  Depth: %s in %s (%u KB)\n"
+        "  MEM1: %u / %u KB, MEM2: %u KB, scan buffers: %u KB\n"
+        "  Traffic cost: %u KB/frame%s\n",
+        pPlan->width, pPlan->height, pPlan->samples,
+        WindowFormatGetName(pPlan->color_format),
+        pPlan->color_memory == WINDOW_MEMORY_MEM1 ? "MEM1" : "MEM2",
+        pPlan->color_size / 1024,
+        WindowFormatGetName(pPlan->depth_format),
+        pPlan->depth_memory == WINDOW_MEMORY_MEM1 ? "MEM1" : "MEM2",
+        pPlan->depth_size / 1024,
+        pPlan->mem1_used / 1024, pPlan->mem1_budget / 1024, pPlan->mem2_used / 1024,
+        pPlan->scan_buffers_size / 1024,
+        pPlan->traffic_cost,
+        pPlan->downgraded ? " (downgraded)" : ""
+    );
+
+#ifdef TEST_WIN
+    printf("%s", line);
+#else
+    OSReport("%s", line);
+#endif
+}
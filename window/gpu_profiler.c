@@ -0,0 +1,265 @@
+// GPU profiler
+
+#include "gpu_profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+// Timestamp queries of the start and end of each scope, per frame
+static GLuint gQueriesWin[WINDOW_GPU_PROFILER_FRAMES][WINDOW_GPU_PROFILER_MAX_SCOPES][2];
+
+#else // TEST_GX2
+
+#include <coreinit/cache.h>
+#include <coreinit/debug.h>
+#include <coreinit/time.h>
+#include <gx2/event.h>
+#include <gx2/query.h>
+
+// GPU timestamps of the start and end of each scope, per frame, written by the GPU
+// (Each frame's timestamps fill whole cache lines)
+static u64 gTimestamps[WINDOW_GPU_PROFILER_FRAMES][WINDOW_GPU_PROFILER_MAX_SCOPES][2] __attribute__((aligned(0x40)));
+
+#endif // TEST_WIN
+
+// Index pushed on the scope stack for scopes that did not fit
+#define WINDOW_GPU_SCOPE_IGNORED WINDOW_GPU_PROFILER_MAX_SCOPES
+
+typedef struct WindowGpuProfilerFrame
+{
+    WindowGpuScopeTiming scopes[WINDOW_GPU_PROFILER_MAX_SCOPES];
+    u32 num_scopes;
+    bool pending;               // Whether the frame has been submitted and not read back yet
+#ifdef TEST_WIN
+    GLuint last_query;          // Last query issued in the frame (scopes can end after later ones)
+#endif
+} WindowGpuProfilerFrame;
+
+static bool gInitialized = false;
+static WindowGpuProfilerFrame gFrames[WINDOW_GPU_PROFILER_FRAMES];
+static u32 gFrameIndex = 0;
+
+// Open scopes of the current frame
+static u32 gScopeStack[WINDOW_GPU_PROFILER_MAX_DEPTH];
+static f64 gScopeCpuStart[WINDOW_GPU_PROFILER_MAX_DEPTH];
+static u32 gScopeDepth = 0;
+static u32 gIgnoredDepth = 0;   // Scopes opened past the deepest nesting
+
+// Results of the most recent frame read back
+static WindowGpuScopeTiming gResults[WINDOW_GPU_PROFILER_MAX_SCOPES];
+static u32 gNumResults = 0;
+
+// Clear the timestamps of a frame before it is recorded again
+static void WindowGpuProfilerResetFrame(u32 frame)
+{
+    gFrames[frame].num_scopes = 0;
+    gFrames[frame].pending = false;
+#ifdef TEST_WIN
+    gFrames[frame].last_query = GL_NONE;
+#endif
+
+#ifdef TEST_GX2
+    // Flush the cleared timestamps out of the CPU cache, so that a later eviction of the cache lines
+    // cannot overwrite what the GPU writes
+    memset(gTimestamps[frame], 0, sizeof(gTimestamps[frame]));
+    DCFlushRange(gTimestamps[frame], sizeof(gTimestamps[frame]));
+#endif
+}
+
+bool WindowGpuProfilerInit()
+{
+    if (gInitialized)
+        return true;
+
+#ifdef TEST_WIN
+    glGenQueries(WINDOW_GPU_PROFILER_FRAMES * WINDOW_GPU_PROFILER_MAX_SCOPES * 2, &gQueriesWin[0][0][0]);
+#endif
+
+    for (u32 i = 0; i < WINDOW_GPU_PROFILER_FRAMES; i++)
+        WindowGpuProfilerResetFrame(i);
+
+    gFrameIndex = 0;
+    gScopeDepth = 0;
+    gIgnoredDepth = 0;
+    gNumResults = 0;
+    gInitialized = true;
+    return true;
+}
+
+void WindowGpuScopeBegin(const char* name)
+{
+    if (!gInitialized)
+        return;
+
+    if (gScopeDepth == WINDOW_GPU_PROFILER_MAX_DEPTH)
+    {
+        gIgnoredDepth++;
+        return;
+    }
+
+    WindowGpuProfilerFrame* frame = &gFrames[gFrameIndex];
+    if (frame->num_scopes == WINDOW_GPU_PROFILER_MAX_SCOPES)
+    {
+        gScopeStack[gScopeDepth++] = WINDOW_GPU_SCOPE_IGNORED;
+        return;
+    }
+
+    u32 scope = frame->num_scopes++;
+    frame->scopes[scope].name = name;
+    frame->scopes[scope].depth = gScopeDepth;
+    frame->scopes[scope].gpu_ms = 0.0;
+    frame->scopes[scope].cpu_ms = 0.0;
+
+    gScopeCpuStart[gScopeDepth] = WindowGetTime();
+    gScopeStack[gScopeDepth++] = scope;
+
+#ifdef TEST_WIN
+    glQueryCounter(gQueriesWin[gFrameIndex][scope][0], GL_TIMESTAMP);
+    frame->last_query = gQueriesWin[gFrameIndex][scope][0];
+#else
+    // Sampled when the GPU starts processing the commands of the scope
+    GX2SampleTopGPUCycle(&gTimestamps[gFrameIndex][scope][0]);
+#endif
+}
+
+void WindowGpuScopeEnd()
+{
+    if (!gInitialized)
+        return;
+
+    if (gIgnoredDepth > 0)
+    {
+        gIgnoredDepth--;
+        return;
+    }
+
+    if (gScopeDepth == 0)
+        return;
+
+    u32 scope = gScopeStack[--gScopeDepth];
+    if (scope == WINDOW_GPU_SCOPE_IGNORED)
+        return;
+
+#ifdef TEST_WIN
+    glQueryCounter(gQueriesWin[gFrameIndex][scope][1], GL_TIMESTAMP);
+    gFrames[gFrameIndex].last_query = gQueriesWin[gFrameIndex][scope][1];
+#else
+    // Sampled once all commands of the scope have finished
+    GX2SampleBottomGPUCycle(&gTimestamps[gFrameIndex][scope][1]);
+#endif
+
+    gFrames[gFrameIndex].scopes[scope].cpu_ms = (WindowGetTime() - gScopeCpuStart[gScopeDepth]) * 1000.0;
+}
+
+// Read back the GPU times of a frame, if they are all available
+static bool WindowGpuProfilerReadFrame(u32 frame_index)
+{
+    WindowGpuProfilerFrame* frame = &gFrames[frame_index];
+    if (frame->num_scopes == 0)
+        return false;
+
+#ifdef TEST_WIN
+
+    // Queries complete in order, so if the last one issued is available, all of them are
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(frame->last_query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    for (u32 i = 0; i < frame->num_scopes; i++)
+    {
+        GLuint64 start, end;
+        glGetQueryObjectui64v(gQueriesWin[frame_index][i][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(gQueriesWin[frame_index][i][1], GL_QUERY_RESULT, &end);
+        frame->scopes[i].gpu_ms = end > start ? (f64)(end - start) * 1e-6 : 0.0;
+    }
+
+#else // TEST_GX2
+
+    DCInvalidateRange(gTimestamps[frame_index], sizeof(gTimestamps[frame_index]));
+
+    for (u32 i = 0; i < frame->num_scopes; i++)
+    {
+        u64 start = gTimestamps[frame_index][i][0];
+        u64 end = gTimestamps[frame_index][i][1];
+
+        // Not written yet: the GPU is further behind than expected
+        if (start == 0 || end == 0)
+            return false;
+
+        frame->scopes[i].gpu_ms = end > start ? (f64)GX2GPUTimeToCPUTime(end - start) * 1000.0 / OSTimerClockSpeed : 0.0;
+    }
+
+#endif // TEST_WIN
+
+    memcpy(gResults, frame->scopes, frame->num_scopes * sizeof(WindowGpuScopeTiming));
+    gNumResults = frame->num_scopes;
+    return true;
+}
+
+void WindowGpuProfilerEndFrame()
+{
+    if (!gInitialized)
+        return;
+
+    // Close scopes left open
+    while (gScopeDepth > 0 || gIgnoredDepth > 0)
+        WindowGpuScopeEnd();
+
+    gFrames[gFrameIndex].pending = true;
+    gFrameIndex = (gFrameIndex + 1) % WINDOW_GPU_PROFILER_FRAMES;
+
+    // The slot of the next frame holds the oldest frame in flight: read it back before reusing it
+    // (If the GPU has not finished it yet, its results are skipped rather than waited for)
+    if (gFrames[gFrameIndex].pending)
+        WindowGpuProfilerReadFrame(gFrameIndex);
+
+    WindowGpuProfilerResetFrame(gFrameIndex);
+}
+
+u32 WindowGpuProfilerGetResults(const WindowGpuScopeTiming** pScopes)
+{
+    *pScopes = gResults;
+    return gNumResults;
+}
+
+void WindowGpuProfilerPrint()
+{
+    char line[WINDOW_GPU_PROFILER_MAX_SCOPES * 80];
+    u32 length = snprintf(line, sizeof(line), "GPU scopes (GPU ms / CPU ms):\n");
+
+    for (u32 i = 0; i < gNumResults && length < sizeof(line); i++)
+    {
+        length += snprintf(
+            line + length, sizeof(line) - length,
+            "  %*s%-*s %8.3f %8.3f\n",
+            (int)(gResults[i].depth * 2), "", (int)(32 - gResults[i].depth * 2), gResults[i].name, gResults[i].gpu_ms, gResults[i].cpu_ms
+        );
+    }
+
+#ifdef TEST_WIN
+    printf("%s", line);
+#else
+    OSReport("%s", line);
+#endif
+}
+
+void WindowGpuProfilerExit()
+{
+    if (!gInitialized)
+        return;
+
+#ifdef TEST_WIN
+    glDeleteQueries(WINDOW_GPU_PROFILER_FRAMES * WINDOW_GPU_PROFILER_MAX_SCOPES * 2, &gQueriesWin[0][0][0]);
+#else
+    // The GPU may still write timestamps of the frames in flight
+    GX2DrawDone();
+#endif
+
+    gNumResults = 0;
+    gInitialized = false;
+}
@@ -0,0 +1,68 @@
+// GPU profiler
+// Measures how long the GPU spends on named parts of a frame (scopes), alongside the CPU time spent
+// issuing them. The GPU writes a timestamp at the start and at the end of each scope into a ring of
+// query slots, which is read back a few frames later so that reading the results never stalls
+// - Wii U: timestamps are written with GX2SampleTopGPUCycle / GX2SampleBottomGPUCycle
+// - PC: timestamps are GL_TIMESTAMP queries
+// WindowSwapBuffers ends the profiled frame, and times its own work in a "Swap" scope
+// (the resolve, upscale and copy to the scan buffers on Wii U, or to the window framebuffer on PC)
+
+#ifndef GPU_PROFILER_H_
+#define GPU_PROFILER_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Most scopes per frame (further scopes are ignored) and deepest nesting of scopes
+#define WINDOW_GPU_PROFILER_MAX_SCOPES 64
+#define WINDOW_GPU_PROFILER_MAX_DEPTH  8
+
+// Number of frames the results are read back after
+#define WINDOW_GPU_PROFILER_FRAMES 4
+
+// Timing of one scope
+typedef struct WindowGpuScopeTiming
+{
+    const char* name;           // Name passed to WindowGpuScopeBegin
+    u32 depth;                  // Nesting depth (0 for top-level scopes)
+    f64 gpu_ms;                 // GPU time between the start and the end of the scope
+    f64 cpu_ms;                 // CPU time between WindowGpuScopeBegin and WindowGpuScopeEnd
+} WindowGpuScopeTiming;
+
+// Start profiling (disabled by default; scopes do nothing until then)
+bool WindowGpuProfilerInit();
+
+// Open a scope
+// Must be called from the thread owning the window context, outside of command list recording
+// Parameters:
+// - name: Name of the scope (the string must stay valid until the results have been read)
+void WindowGpuScopeBegin(const char* name);
+
+// Close the innermost open scope
+void WindowGpuScopeEnd();
+
+// End the profiled frame and read back the results of the oldest frame in flight
+// Called by WindowSwapBuffers
+void WindowGpuProfilerEndFrame();
+
+// Get the scopes of the most recent frame read back, in the order they were opened
+// Parameters:
+// - pScopes: Output pointer to the scopes (valid until the next swap)
+// Returns the number of scopes (0 if no frame has been read back yet)
+u32 WindowGpuProfilerGetResults(const WindowGpuScopeTiming** pScopes);
+
+// Print the scopes of the most recent frame read back (to stdout on PC, to the system log on Wii U)
+void WindowGpuProfilerPrint();
+
+// Stop profiling and free the query slots
+void WindowGpuProfilerExit();
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // GPU_PROFILER_H_
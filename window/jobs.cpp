@@ -0,0 +1,250 @@
+// Minimal pool of worker threads, used to spread work over several cores
+
+#include "jobs.h"
+#include "trace.h"
+
+#include <atomic>
+#include <stdio.h>
+
+#ifdef TEST_WIN
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+static std::thread gThreads[JOBS_MAX_WORKERS];
+static std::mutex gMutex;
+static std::condition_variable gStartCondition;
+static std::condition_variable gDoneCondition;
+static u32 gGeneration = 0;
+
+#else // TEST_GX2
+
+#include <coreinit/event.h>
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/thread.h>
+
+// Stack size of each worker thread
+#define JOBS_STACK_SIZE 0x10000
+
+// Number of CPU cores on Wii U
+#define JOBS_NUM_CORES 3
+
+static OSThread* gThreads[JOBS_MAX_WORKERS] = { NULL };
+static void* gStacks[JOBS_MAX_WORKERS] = { NULL };
+static OSEvent gStartEvents[JOBS_MAX_WORKERS];
+static OSEvent gDoneEvent;
+
+#endif
+
+static u32 gNumWorkers = 0;
+static JobFunc gFunc = NULL;
+static void* gUserData = NULL;
+static std::atomic<u32> gRemaining(0);
+static std::atomic<bool> gQuit(false);
+
+// Returns false once the pool is shutting down
+static bool JobsWaitForWork(u32 worker, u32* pGeneration)
+{
+#ifdef TEST_WIN
+    (void)worker;
+
+    std::unique_lock<std::mutex> lock(gMutex);
+    gStartCondition.wait(lock, [pGeneration] { return gGeneration != *pGeneration || gQuit.load(); });
+    *pGeneration = gGeneration;
+#else
+    (void)pGeneration;
+
+    OSWaitEvent(&gStartEvents[worker]);
+#endif
+
+    return !gQuit.load();
+}
+
+static void JobsSignalDone()
+{
+    // The last worker to finish wakes up the caller of JobsRun
+    if (gRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+#ifdef TEST_WIN
+        std::lock_guard<std::mutex> lock(gMutex);
+        gDoneCondition.notify_one();
+#else
+        OSSignalEvent(&gDoneEvent);
+#endif
+    }
+}
+
+static void JobsWorkerLoop(u32 worker)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "Worker %u", worker);
+    TraceSetThreadName(name);
+
+    u32 generation = 0;
+    while (JobsWaitForWork(worker, &generation))
+    {
+        TraceBegin("Job");
+        gFunc(worker, gNumWorkers, gUserData);
+        TraceEnd();
+
+        JobsSignalDone();
+    }
+}
+
+#ifdef TEST_GX2
+
+static int JobsWorkerMain(int argc, const char** argv)
+{
+    (void)argv;
+
+    JobsWorkerLoop((u32)argc);
+    return 0;
+}
+
+#endif
+
+bool JobsInit(u32 num_workers)
+{
+    if (gNumWorkers != 0)
+        return false;
+
+    if (num_workers == 0)
+    {
+#ifdef TEST_WIN
+        num_workers = std::thread::hardware_concurrency();
+        if (num_workers == 0)
+            num_workers = 1;
+#else
+        num_workers = JOBS_NUM_CORES;
+#endif
+    }
+
+    if (num_workers > JOBS_MAX_WORKERS)
+        num_workers = JOBS_MAX_WORKERS;
+
+    gQuit.store(false);
+
+#ifdef TEST_WIN
+
+    gGeneration = 0;
+
+    for (u32 i = 0; i < num_workers; i++)
+        gThreads[i] = std::thread(JobsWorkerLoop, i);
+
+#else // TEST_GX2
+
+    OSInitEvent(&gDoneEvent, FALSE, OS_EVENT_MODE_AUTO);
+
+    for (u32 i = 0; i < num_workers; i++)
+    {
+        OSInitEvent(&gStartEvents[i], FALSE, OS_EVENT_MODE_AUTO);
+
+        // OSThread instances must be 8-byte aligned, stacks 16-byte aligned
+        gThreads[i] = (OSThread*)MEMAllocFromDefaultHeapEx(sizeof(OSThread), 8);
+        gStacks[i] = MEMAllocFromDefaultHeapEx(JOBS_STACK_SIZE, 16);
+
+        if (!gThreads[i] || !gStacks[i])
+        {
+            gNumWorkers = i;
+            JobsExit();
+            return false;
+        }
+
+        // Spread the workers over the cores, starting with core 0
+        // (Stacks grow downwards, so the top of the stack is passed)
+        OSThreadAttributes affinity = (OSThreadAttributes)(OS_THREAD_ATTRIB_AFFINITY_CPU0 << (i % JOBS_NUM_CORES));
+        if (!OSCreateThread(gThreads[i], JobsWorkerMain, (int32_t)i, NULL,
+                            (u8*)gStacks[i] + JOBS_STACK_SIZE, JOBS_STACK_SIZE, 16, affinity))
+        {
+            MEMFreeToDefaultHeap(gThreads[i]);
+            MEMFreeToDefaultHeap(gStacks[i]);
+            gThreads[i] = NULL;
+            gStacks[i] = NULL;
+
+            gNumWorkers = i;
+            JobsExit();
+            return false;
+        }
+
+        OSResumeThread(gThreads[i]);
+    }
+
+#endif
+
+    gNumWorkers = num_workers;
+    return true;
+}
+
+u32 JobsGetWorkerCount()
+{
+    return gNumWorkers;
+}
+
+void JobsRun(JobFunc func, void* user_data)
+{
+    if (gNumWorkers == 0)
+        return;
+
+    gFunc = func;
+    gUserData = user_data;
+    gRemaining.store(gNumWorkers, std::memory_order_release);
+
+    TraceBegin("JobsRun");
+
+#ifdef TEST_WIN
+
+    std::unique_lock<std::mutex> lock(gMutex);
+    gGeneration++;
+    gStartCondition.notify_all();
+    gDoneCondition.wait(lock, [] { return gRemaining.load(std::memory_order_acquire) == 0; });
+
+#else // TEST_GX2
+
+    for (u32 i = 0; i < gNumWorkers; i++)
+        OSSignalEvent(&gStartEvents[i]);
+
+    OSWaitEvent(&gDoneEvent);
+
+#endif
+
+    TraceEnd();
+}
+
+void JobsSplitRange(u32 count, u32 worker, u32 worker_count, u32* pBegin, u32* pEnd)
+{
+    *pBegin = (u32)(((u64)count * worker) / worker_count);
+    *pEnd = (u32)(((u64)count * (worker + 1)) / worker_count);
+}
+
+void JobsExit()
+{
+    gQuit.store(true);
+
+#ifdef TEST_WIN
+
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        gStartCondition.notify_all();
+    }
+
+    for (u32 i = 0; i < gNumWorkers; i++)
+        gThreads[i].join();
+
+#else // TEST_GX2
+
+    for (u32 i = 0; i < gNumWorkers; i++)
+    {
+        OSSignalEvent(&gStartEvents[i]);
+        OSJoinThread(gThreads[i], NULL);
+
+        MEMFreeToDefaultHeap(gThreads[i]);
+        MEMFreeToDefaultHeap(gStacks[i]);
+        gThreads[i] = NULL;
+        gStacks[i] = NULL;
+    }
+
+#endif
+
+    gNumWorkers = 0;
+}
@@ -0,0 +1,51 @@
+// Minimal pool of worker threads, used to spread work over several cores
+// OSThreads (one per core, round-robin) on Wii U, std::thread on PC
+
+#ifndef JOBS_H_
+#define JOBS_H_
+
+#include <test_types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Maximum number of worker threads
+#define JOBS_MAX_WORKERS 16
+
+// Function run by each worker
+// Parameters:
+// - worker: Index of the worker running the function (0 to worker_count - 1)
+// - worker_count: Total number of workers
+// - user_data: Pointer passed to JobsRun
+typedef void (*JobFunc)(u32 worker, u32 worker_count, void* user_data);
+
+// Start the worker threads
+// Parameters:
+// - num_workers: Number of worker threads to start (0 to use one per hardware core)
+// Returns false if the pool is already running or the threads could not be created
+bool JobsInit(u32 num_workers);
+
+// Get the number of worker threads (0 if the pool is not running)
+u32 JobsGetWorkerCount();
+
+// Run a function once on every worker, in parallel, and block until all of them have returned
+// Must be called from a single thread at a time (typically the main thread)
+void JobsRun(JobFunc func, void* user_data);
+
+// Split the range [0, count) into contiguous chunks, one per worker, in worker order
+// Parameters:
+// - count: Number of elements in the range
+// - worker, worker_count: As passed to the JobFunc
+// - pBegin, pEnd: Output range of elements for this worker
+void JobsSplitRange(u32 count, u32 worker, u32 worker_count, u32* pBegin, u32* pEnd);
+
+// Stop the worker threads
+void JobsExit();
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // JOBS_H_
@@ -0,0 +1,289 @@
+// Sort-key render queue
+
+#include "render_queue.h"
+#include "cmd_list.h"
+#include "jobs.h"
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WINDOW_QUEUE_MAX_SHADERS    (1u << WINDOW_QUEUE_SHADERS_BITS)
+#define WINDOW_QUEUE_MAX_INPUTS     (1u << WINDOW_QUEUE_INPUT_BITS)
+#define WINDOW_QUEUE_MAX_MATERIALS  (1u << WINDOW_QUEUE_MATERIAL_BITS)
+
+#define WINDOW_QUEUE_DEPTH_SHIFT    0
+#define WINDOW_QUEUE_MATERIAL_SHIFT (WINDOW_QUEUE_DEPTH_SHIFT + WINDOW_QUEUE_DEPTH_BITS)
+#define WINDOW_QUEUE_INPUT_SHIFT    (WINDOW_QUEUE_MATERIAL_SHIFT + WINDOW_QUEUE_MATERIAL_BITS)
+#define WINDOW_QUEUE_SHADERS_SHIFT  (WINDOW_QUEUE_INPUT_SHIFT + WINDOW_QUEUE_INPUT_BITS)
+#define WINDOW_QUEUE_PASS_SHIFT     (WINDOW_QUEUE_SHADERS_SHIFT + WINDOW_QUEUE_SHADERS_BITS)
+
+#define WINDOW_QUEUE_FIELD(key, name) \
+    ((u32)((key) >> WINDOW_QUEUE_##name##_SHIFT) & ((1u << WINDOW_QUEUE_##name##_BITS) - 1))
+
+// The key is sorted 8 bits at a time
+#define WINDOW_QUEUE_RADIX_PASSES   8
+
+// Key of a draw and where its payload is
+typedef struct WindowQueueEntry
+{
+    u64 key;
+    u32 index;
+} WindowQueueEntry;
+
+static WindowQueueEntry* gEntries = NULL;
+static WindowQueueEntry* gSortBuffer = NULL;
+static WindowQueueDraw* gPayloads = NULL;
+static u32 gMaxDraws = 0;
+static u32 gCount = 0;          // Draws queued (may exceed gMaxDraws if the queue is full)
+
+static const WindowShaderSet* gShaders[WINDOW_QUEUE_MAX_SHADERS];
+static const WindowVertexInput* gInputs[WINDOW_QUEUE_MAX_INPUTS];
+static WindowQueueMaterial* gMaterials = NULL;
+static u32 gNumShaders = 0;
+static u32 gNumInputs = 0;
+static u32 gNumMaterials = 0;
+
+static WindowQueueStats gStats;
+
+bool WindowQueueInit(u32 max_draws)
+{
+    if (gEntries || max_draws == 0)
+        return false;
+
+    gEntries = (WindowQueueEntry*)malloc(max_draws * sizeof(WindowQueueEntry));
+    gSortBuffer = (WindowQueueEntry*)malloc(max_draws * sizeof(WindowQueueEntry));
+    gPayloads = (WindowQueueDraw*)malloc(max_draws * sizeof(WindowQueueDraw));
+    gMaterials = (WindowQueueMaterial*)malloc(WINDOW_QUEUE_MAX_MATERIALS * sizeof(WindowQueueMaterial));
+    if (!gEntries || !gSortBuffer || !gPayloads || !gMaterials)
+    {
+        WindowQueueExit();
+        return false;
+    }
+
+    gMaxDraws = max_draws;
+    gCount = 0;
+    gNumShaders = 0;
+    gNumInputs = 0;
+    gNumMaterials = 0;
+    memset(&gStats, 0, sizeof(gStats));
+    return true;
+}
+
+u32 WindowQueueAddShaders(const WindowShaderSet* shaders)
+{
+    if (gNumShaders == WINDOW_QUEUE_MAX_SHADERS)
+        return WINDOW_QUEUE_INVALID_ID;
+
+    gShaders[gNumShaders] = shaders;
+    return gNumShaders++;
+}
+
+u32 WindowQueueAddInput(const WindowVertexInput* input)
+{
+    if (gNumInputs == WINDOW_QUEUE_MAX_INPUTS)
+        return WINDOW_QUEUE_INVALID_ID;
+
+    gInputs[gNumInputs] = input;
+    return gNumInputs++;
+}
+
+u32 WindowQueueAddMaterial(const WindowQueueMaterial* material)
+{
+    if (!gMaterials || gNumMaterials == WINDOW_QUEUE_MAX_MATERIALS || material->count > WINDOW_QUEUE_MATERIAL_MAX_VALUES)
+        return WINDOW_QUEUE_INVALID_ID;
+
+    gMaterials[gNumMaterials] = *material;
+    return gNumMaterials++;
+}
+
+void WindowQueueBegin()
+{
+    gCount = 0;
+    gStats.dropped = 0;
+}
+
+u64 WindowQueueMakeKey(u32 pass, u32 shaders, u32 input, u32 material, f32 depth)
+{
+    // Quantize the depth to the bits available
+    const u32 depth_max = (1u << WINDOW_QUEUE_DEPTH_BITS) - 1;
+    u32 depth_bits = depth <= 0.0f ? 0 : depth >= 1.0f ? depth_max : (u32)(depth * (f32)depth_max);
+
+    return ((u64)(pass     & ((1u << WINDOW_QUEUE_PASS_BITS) - 1))     << WINDOW_QUEUE_PASS_SHIFT)
+         | ((u64)(shaders  & ((1u << WINDOW_QUEUE_SHADERS_BITS) - 1))  << WINDOW_QUEUE_SHADERS_SHIFT)
+         | ((u64)(input    & ((1u << WINDOW_QUEUE_INPUT_BITS) - 1))    << WINDOW_QUEUE_INPUT_SHIFT)
+         | ((u64)(material & ((1u << WINDOW_QUEUE_MATERIAL_BITS) - 1)) << WINDOW_QUEUE_MATERIAL_SHIFT)
+         | ((u64)depth_bits << WINDOW_QUEUE_DEPTH_SHIFT);
+}
+
+void WindowQueueSubmitDraw(u32 pass, u32 shaders, u32 input, u32 material, f32 depth, const WindowQueueDraw* draw)
+{
+    // Several threads may queue draws at the same time
+    u32 slot = __atomic_fetch_add(&gCount, 1, __ATOMIC_RELAXED);
+    if (slot >= gMaxDraws)
+    {
+        __atomic_fetch_add(&gStats.dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    gEntries[slot].key = WindowQueueMakeKey(pass, shaders, input, material, depth);
+    gEntries[slot].index = slot;
+    gPayloads[slot] = *draw;
+}
+
+void WindowQueueSort()
+{
+    u32 count = gCount < gMaxDraws ? gCount : gMaxDraws;
+
+    TraceBegin("WindowQueueSort");
+    f64 start_time = WindowGetTime();
+
+    // Histograms of every digit, built in a single pass over the keys
+    static u32 histograms[WINDOW_QUEUE_RADIX_PASSES][256];
+    memset(histograms, 0, sizeof(histograms));
+
+    for (u32 i = 0; i < count; i++)
+    {
+        u64 key = gEntries[i].key;
+        for (u32 pass = 0; pass < WINDOW_QUEUE_RADIX_PASSES; pass++)
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+    }
+
+    u32 radix_passes = 0;
+
+    // Least significant digit first: each pass is stable, so the order of the previous passes is kept
+    for (u32 pass = 0; pass < WINDOW_QUEUE_RADIX_PASSES && count > 1; pass++)
+    {
+        u32* histogram = histograms[pass];
+        u32 shift = pass * 8;
+
+        // All keys share this digit (e.g. unused material or pass bits): nothing to do
+        if (histogram[(gEntries[0].key >> shift) & 0xFF] == count)
+            continue;
+
+        u32 offset = 0;
+        for (u32 digit = 0; digit < 256; digit++)
+        {
+            u32 digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+
+        for (u32 i = 0; i < count; i++)
+        {
+            const WindowQueueEntry* entry = &gEntries[i];
+            gSortBuffer[histogram[(entry->key >> shift) & 0xFF]++] = *entry;
+        }
+
+        WindowQueueEntry* sorted = gSortBuffer;
+        gSortBuffer = gEntries;
+        gEntries = sorted;
+
+        radix_passes++;
+    }
+
+    gStats.radix_passes = radix_passes;
+    gStats.sort_ms = (WindowGetTime() - start_time) * 1000.0;
+    TraceEnd();
+}
+
+static void WindowQueueRecord(WindowCmdList* cmd_list, u32 index, u32 list_count, void* user_data)
+{
+    u32 count = *(const u32*)user_data;
+
+    u32 begin, end;
+    JobsSplitRange(count, index, list_count, &begin, &end);
+
+    u32 shaders = WINDOW_QUEUE_INVALID_ID;
+    u32 input = WINDOW_QUEUE_INVALID_ID;
+    u32 material = WINDOW_QUEUE_INVALID_ID;
+    u32 shader_changes = 0, input_changes = 0, material_changes = 0;
+
+    for (u32 i = begin; i < end; i++)
+    {
+        u64 key = gEntries[i].key;
+
+        // Only set the state that differs from the previous draw of this list
+        u32 draw_shaders = WINDOW_QUEUE_FIELD(key, SHADERS);
+        if (draw_shaders != shaders && draw_shaders < gNumShaders)
+        {
+            WindowCmdSetShaders(cmd_list, gShaders[draw_shaders]);
+            shaders = draw_shaders;
+            shader_changes++;
+
+            // Uniforms belong to the program on PC, so the material is set again
+            material = WINDOW_QUEUE_INVALID_ID;
+        }
+
+        u32 draw_input = WINDOW_QUEUE_FIELD(key, INPUT);
+        if (draw_input != input && draw_input < gNumInputs)
+        {
+            WindowCmdSetVertexInput(cmd_list, gInputs[draw_input]);
+            input = draw_input;
+            input_changes++;
+        }
+
+        u32 draw_material = WINDOW_QUEUE_FIELD(key, MATERIAL);
+        if (draw_material != material && draw_material < gNumMaterials)
+        {
+            const WindowQueueMaterial* m = &gMaterials[draw_material];
+            if (m->count > 0)
+                WindowCmdSetVertexUniforms(cmd_list, m->location, m->count, m->values);
+            material = draw_material;
+            material_changes++;
+        }
+
+        const WindowQueueDraw* draw = &gPayloads[gEntries[i].index];
+        if (draw->indices)
+            WindowCmdDrawIndexed(cmd_list, draw->count, draw->indices);
+        else
+            WindowCmdDraw(cmd_list, draw->count, draw->first);
+    }
+
+    __atomic_fetch_add(&gStats.shader_changes, shader_changes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&gStats.input_changes, input_changes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&gStats.material_changes, material_changes, __ATOMIC_RELAXED);
+}
+
+void WindowQueueFlush()
+{
+    u32 count = gCount < gMaxDraws ? gCount : gMaxDraws;
+
+    TraceBegin("WindowQueueFlush");
+
+    gStats.draws = count;
+    gStats.shader_changes = 0;
+    gStats.input_changes = 0;
+    gStats.material_changes = 0;
+
+    WindowCmdRecord(WindowQueueRecord, &count);
+    WindowCmdSubmit();
+
+    gStats.state_changes = gStats.shader_changes + gStats.input_changes + gStats.material_changes;
+
+    TraceEnd();
+}
+
+void WindowQueueGetStats(WindowQueueStats* pStats)
+{
+    *pStats = gStats;
+}
+
+void WindowQueueExit()
+{
+    free(gEntries);
+    free(gSortBuffer);
+    free(gPayloads);
+    free(gMaterials);
+
+    gEntries = NULL;
+    gSortBuffer = NULL;
+    gPayloads = NULL;
+    gMaterials = NULL;
+
+    gMaxDraws = 0;
+    gCount = 0;
+    gNumShaders = 0;
+    gNumInputs = 0;
+    gNumMaterials = 0;
+}
@@ -0,0 +1,116 @@
+// Sort-key render queue
+// Draws are queued with a packed 64-bit key describing the state they need and a small payload,
+// sorted once per frame with an LSD radix sort, then replayed through the command lists (cmd_list.h),
+// so that draws sharing the same state follow each other and state changes are kept to a minimum
+// Key layout, most significant bits first:
+//   pass (4) | shader set (10) | vertex input (10) | material (12) | depth (28)
+// - pass: draws of a lower pass are always replayed first (e.g. opaque before transparent)
+// - shader set: the fetch, vertex and pixel shaders (the fetch shader is part of the shader set)
+// - vertex input: the attribute buffer
+// - material: a few vec4 vertex uniforms
+// - depth: within the same state, draws are replayed in increasing depth (front to back for opaque
+//          draws; pass 1 - depth for back to front)
+// Shader sets, vertex inputs and materials are registered first, and draws refer to them by id
+
+#ifndef RENDER_QUEUE_H_
+#define RENDER_QUEUE_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#define WINDOW_QUEUE_PASS_BITS      4
+#define WINDOW_QUEUE_SHADERS_BITS   10
+#define WINDOW_QUEUE_INPUT_BITS     10
+#define WINDOW_QUEUE_MATERIAL_BITS  12
+#define WINDOW_QUEUE_DEPTH_BITS     28
+
+// Most vec4 uniforms per material
+#define WINDOW_QUEUE_MATERIAL_MAX_VALUES 4
+
+// Returned by the registration functions when a table is full
+#define WINDOW_QUEUE_INVALID_ID 0xFFFFFFFF
+
+// Material: vec4 uniforms of the vertex shader, set when a draw uses a different material
+typedef struct WindowQueueMaterial
+{
+    u32 location;               // First uniform register (Wii U) or uniform location (PC)
+    u32 count;                  // Number of vec4 values
+    f32 values[4 * WINDOW_QUEUE_MATERIAL_MAX_VALUES];
+} WindowQueueMaterial;
+
+// Payload of a draw
+typedef struct WindowQueueDraw
+{
+    u32 count;                  // Number of vertices (or indices)
+    u32 first;                  // First vertex (non-indexed draws)
+    const void* indices;        // 32-bit index buffer (or offset into the bound element buffer on PC),
+                                // NULL for a non-indexed draw
+} WindowQueueDraw;
+
+// Render queue statistics (of the last replay)
+typedef struct WindowQueueStats
+{
+    u32 draws;                  // Draws replayed
+    u32 shader_changes;         // Shader set changes
+    u32 input_changes;          // Vertex input changes
+    u32 material_changes;       // Material changes
+    u32 state_changes;          // Sum of the above
+    u32 dropped;                // Draws that did not fit in the queue
+    u32 radix_passes;           // 8-bit radix passes run by the last sort (passes where all keys share
+                                // the same digit are skipped)
+    f64 sort_ms;                // Time spent in the last WindowQueueSort
+} WindowQueueStats;
+
+// Allocate the queue
+// Command lists must have been created (see WindowCmdInit)
+// Parameters:
+// - max_draws: Most draws per frame
+bool WindowQueueInit(u32 max_draws);
+
+// Register a shader set, vertex input or material
+// Shader sets and vertex inputs must stay valid until WindowQueueExit; materials are copied
+// Returns the id to queue draws with, or WINDOW_QUEUE_INVALID_ID if the table is full
+u32 WindowQueueAddShaders(const WindowShaderSet* shaders);
+u32 WindowQueueAddInput(const WindowVertexInput* input);
+u32 WindowQueueAddMaterial(const WindowQueueMaterial* material);
+
+// Empty the queue for a new frame
+void WindowQueueBegin();
+
+// Queue a draw
+// May be called from several threads at once
+// Parameters:
+// - pass: Pass of the draw (0 to 15)
+// - shaders, input, material: Registered ids
+// - depth: Depth of the draw, from 0 to 1
+// - draw: Payload (copied)
+void WindowQueueSubmitDraw(u32 pass, u32 shaders, u32 input, u32 material, f32 depth, const WindowQueueDraw* draw);
+
+// Sort the queued draws by key
+// Without it, WindowQueueFlush replays the draws in the order they were queued
+void WindowQueueSort();
+
+// Record the queued draws into the command lists and submit them
+// (WindowCmdRecord and WindowCmdSubmit); each list sets the state of its first draw, then only
+// the state that changes from one draw to the next
+// Must be called from the thread that owns the window context
+void WindowQueueFlush();
+
+// Build the key of a draw (as WindowQueueSubmitDraw does)
+u64 WindowQueueMakeKey(u32 pass, u32 shaders, u32 input, u32 material, f32 depth);
+
+// Get render queue statistics
+void WindowQueueGetStats(WindowQueueStats* pStats);
+
+// Free the queue and clear the registered state
+void WindowQueueExit();
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // RENDER_QUEUE_H_
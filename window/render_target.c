@@ -0,0 +1,867 @@
+// Pool of off-screen render targets
+
+#include "render_target.h"
+#include "coherency.h"
+#include "format.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+#else // TEST_GX2
+
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/memexpheap.h>
+#include <coreinit/memfrmheap.h>
+#include <gx2/event.h>
+#include <gx2/mem.h>
+#include <gx2/registers.h>
+#include <gx2/state.h>
+
+// Audits the GX2 calls of this file when built with WINDOW_COHERENCY
+#include "coherency_calls.h"
+
+#endif
+
+#ifdef TEST_WIN
+#define WINDOW_RT_PLACED_ALIGNMENT_WIN 0x800
+#endif // TEST_WIN
+
+typedef struct WindowRenderTargetEntry
+{
+    WindowRenderTarget target; // Must be first (the user gets a pointer to it)
+    struct WindowRenderTargetEntry* next;
+    bool in_use;
+    bool in_mem1;
+    u32 size;                  // Bytes of memory used by the target
+    u64 last_used_frame;       // Frame the target was last released in
+#ifdef TEST_WIN
+    u32 id;                    // Unique id of the target (a freed target's address can be reused)
+    u32 attached_depth_id;     // Id of the depth target currently attached to the framebuffer (0 if none)
+#else
+    void* image;
+    void* aa_buffer;
+    bool lost;                 // Whether the target lost its MEM1 memory when the foreground was released
+#endif // TEST_WIN
+} WindowRenderTargetEntry;
+
+static WindowRenderTargetEntry* gTargets = NULL;
+static WindowRenderTargetStats gStats;
+
+#ifdef TEST_WIN
+static u32 gNextId = 1;
+#endif // TEST_WIN
+
+#ifdef TEST_GX2
+
+// MEM1 is a frame heap, which can't free individual allocations,
+// so the pool takes its whole budget at once and manages it as an expanded heap
+static bool gMEM1Initialized = false;
+static u32 gMEM1BudgetRequest = 0;
+static void* gMEM1Arena = NULL;
+static MEMHeapHandle gMEM1Pool = NULL;
+
+static void WindowRenderTargetInitMEM1()
+{
+    gMEM1Initialized = true;
+
+    MEMHeapHandle mem1_heap_handle = MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM1);
+
+    u32 available = MEMGetAllocatableSizeForFrmHeapEx(mem1_heap_handle, 4);
+    u32 budget = gMEM1BudgetRequest;
+    if (budget == 0 || budget > available)
+        budget = available;
+
+    if (budget == 0)
+        return;
+
+    // Allocate from the tail so that the head of the heap is left as WindowInit set it up
+    // (A negative alignment allocates from the tail of a frame heap)
+    gMEM1Arena = MEMAllocFromFrmHeapEx(mem1_heap_handle, budget, -4);
+    if (!gMEM1Arena)
+        return;
+
+    gMEM1Pool = MEMCreateExpHeapEx(gMEM1Arena, budget, 0);
+    if (!gMEM1Pool)
+    {
+        MEMFreeToFrmHeap(mem1_heap_handle, MEM_FRM_HEAP_FREE_TAIL);
+        gMEM1Arena = NULL;
+        return;
+    }
+
+    gStats.mem1_budget = budget;
+}
+
+// Allocate target memory in MEM1 if it fits in the budget, or in MEM2 otherwise
+static void* WindowRenderTargetAlloc(WindowRenderTargetEntry* entry, u32 size, u32 alignment)
+{
+    void* ptr;
+
+    if (entry->in_mem1)
+    {
+        // This can fail even if the budget allows it, if MEM1 is too fragmented
+        ptr = MEMAllocFromExpHeapEx(gMEM1Pool, size, alignment);
+    }
+    else
+    {
+        ptr = MEMAllocFromDefaultHeapEx(size, alignment);
+    }
+
+    if (ptr)
+        COHERENCY_ALLOC(ptr, size);
+
+    return ptr;
+}
+
+static void WindowRenderTargetFree(WindowRenderTargetEntry* entry, void* ptr)
+{
+    if (!ptr)
+        return;
+
+    if (entry->in_mem1)
+        MEMFreeToExpHeap(gMEM1Pool, ptr);
+    else
+        MEMFreeToDefaultHeap(ptr);
+}
+
+static void WindowRenderTargetInitSurface(GX2Surface* surface, const WindowRenderTarget* target)
+{
+    surface->dim = GX2_SURFACE_DIM_TEXTURE_2D;
+    surface->width = target->width;
+    surface->height = target->height;
+    surface->depth = 1;
+    surface->mipLevels = 1;
+    surface->format = WindowFormatGetSurfaceFormat(target->format);
+    surface->aa = WindowFormatGetAAMode(target->samples);
+    surface->mipmaps = NULL;
+    surface->tileMode = GX2_TILE_MODE_DEFAULT;
+    surface->swizzle  = 0;
+
+    // Multisampled surfaces can't be sampled from directly (they have to be resolved first)
+    if (target->is_depth)
+        surface->use = target->samples > 1 ? GX2_SURFACE_USE_DEPTH_BUFFER
+                                           : (GX2SurfaceUse)(GX2_SURFACE_USE_TEXTURE | GX2_SURFACE_USE_DEPTH_BUFFER);
+    else
+        surface->use = target->samples > 1 ? GX2_SURFACE_USE_COLOR_BUFFER
+                                           : (GX2SurfaceUse)(GX2_SURFACE_USE_TEXTURE | GX2_SURFACE_USE_COLOR_BUFFER);
+
+    GX2CalcSurfaceSizeAndAlignment(surface);
+}
+
+// Set up the color or depth buffer of the target, without memory
+// Returns the surface, and the size and alignment of the auxiliary buffer of multisampled color targets
+static GX2Surface* WindowRenderTargetInitBuffer(WindowRenderTarget* target, u32* pAASize, u32* pAAAlignment)
+{
+    GX2Surface* surface;
+
+    *pAASize = 0;
+    *pAAAlignment = 0;
+
+    if (target->is_depth)
+    {
+        surface = &target->depth_buffer.surface;
+        WindowRenderTargetInitSurface(surface, target);
+
+        target->depth_buffer.viewMip = 0;
+        target->depth_buffer.viewFirstSlice = 0;
+        target->depth_buffer.viewNumSlices = 1;
+        target->depth_buffer.hiZPtr = NULL;
+        target->depth_buffer.hiZSize = 0;
+        target->depth_buffer.depthClear = 1.0f;
+        target->depth_buffer.stencilClear = 0;
+        GX2InitDepthBufferRegs(&target->depth_buffer);
+    }
+    else
+    {
+        surface = &target->color_buffer.surface;
+        WindowRenderTargetInitSurface(surface, target);
+
+        target->color_buffer.viewMip = 0;
+        target->color_buffer.viewFirstSlice = 0;
+        target->color_buffer.viewNumSlices = 1;
+        target->color_buffer.aaBuffer = NULL;
+        target->color_buffer.aaSize = 0;
+        GX2InitColorBufferRegs(&target->color_buffer);
+
+        // Multisampled color buffers need an auxiliary buffer
+        if (target->samples > 1)
+            GX2CalcColorBufferAuxInfo(&target->color_buffer, pAASize, pAAAlignment);
+    }
+
+    return surface;
+}
+
+// Point the buffer and the texture of the target at its image
+static void WindowRenderTargetSetImage(WindowRenderTarget* target, GX2Surface* surface, void* image)
+{
+    surface->image = image;
+
+    // The texture shares the surface of the buffer
+    if (target->samples == 1)
+    {
+        target->texture.surface = *surface;
+        target->texture.viewFirstMip = 0;
+        target->texture.viewNumMips = 1;
+        target->texture.viewFirstSlice = 0;
+        target->texture.viewNumSlices = 1;
+        target->texture.compMap = GX2_COMP_MAP(GX2_SQ_SEL_X, GX2_SQ_SEL_Y, GX2_SQ_SEL_Z, GX2_SQ_SEL_W);
+        GX2InitTextureRegs(&target->texture);
+    }
+}
+
+// Set up the color or depth buffer of the target and allocate its memory
+static bool WindowRenderTargetCreate(WindowRenderTargetEntry* entry)
+{
+    WindowRenderTarget* target = &entry->target;
+
+    u32 aa_size, aa_alignment;
+    GX2Surface* surface = WindowRenderTargetInitBuffer(target, &aa_size, &aa_alignment);
+
+    entry->size = surface->imageSize + aa_size;
+
+    // Place the target in MEM1 if it fits in the budget
+    entry->in_mem1 = gMEM1Pool && gStats.mem1_used + entry->size <= gStats.mem1_budget;
+
+    for (;;)
+    {
+        entry->image = WindowRenderTargetAlloc(entry, surface->imageSize, surface->alignment);
+        if (entry->image && aa_size != 0)
+            entry->aa_buffer = WindowRenderTargetAlloc(entry, aa_size, aa_alignment);
+
+        if (entry->image && (aa_size == 0 || entry->aa_buffer))
+            break;
+
+        WindowRenderTargetFree(entry, entry->image);
+        entry->image = NULL;
+
+        // Fall back to MEM2 if MEM1 is too fragmented
+        if (!entry->in_mem1)
+            return false;
+
+        entry->in_mem1 = false;
+    }
+
+    // Flush allocated buffer from CPU cache
+    GX2Invalidate(GX2_INVALIDATE_MODE_CPU, entry->image, surface->imageSize);
+
+    if (aa_size != 0)
+    {
+        target->color_buffer.aaBuffer = entry->aa_buffer;
+        target->color_buffer.aaSize = aa_size;
+
+        memset(entry->aa_buffer, WINDOW_AA_BUFFER_CLEAR_VALUE, aa_size);
+        GX2Invalidate(GX2_INVALIDATE_MODE_CPU, entry->aa_buffer, aa_size);
+    }
+
+    WindowRenderTargetSetImage(target, surface, entry->image);
+    return true;
+}
+
+static void WindowRenderTargetDestroy(WindowRenderTargetEntry* entry)
+{
+    WindowRenderTargetFree(entry, entry->aa_buffer);
+    WindowRenderTargetFree(entry, entry->image);
+}
+
+#else // TEST_WIN
+
+static GLenum WindowRenderTargetGetAttachmentWin(const WindowRenderTarget* target)
+{
+    if (!target->is_depth)
+        return GL_COLOR_ATTACHMENT0;
+
+    return target->format == WINDOW_RT_FORMAT_D24S8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+}
+
+static void WindowRenderTargetAttachWin(GLenum attachment, const WindowRenderTarget* target)
+{
+    if (target->renderbuffer != GL_NONE)
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, target->renderbuffer);
+    else
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, target->texture, 0);
+}
+
+static bool WindowRenderTargetCreate(WindowRenderTargetEntry* entry)
+{
+    WindowRenderTarget* target = &entry->target;
+
+    u32 internal_format, format, type;
+    WindowFormatGetGL(target->format, &internal_format, &format, &type);
+
+    // Estimate, since OpenGL does not tell where or how targets are stored
+    entry->size = target->width * target->height * WindowFormatGetBytesPerPixel(target->format) * target->samples;
+    entry->in_mem1 = false;
+
+    // Multisampled targets can't be sampled from directly (they have to be resolved first),
+    // so they are renderbuffers
+    if (target->samples > 1)
+    {
+        glGenRenderbuffers(1, &target->renderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target->renderbuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, target->samples, internal_format, target->width, target->height);
+    }
+    else
+    {
+        GLenum filter = target->is_depth ? GL_NEAREST : GL_LINEAR;
+
+        glGenTextures(1, &target->texture);
+        glBindTexture(GL_TEXTURE_2D, target->texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internal_format, target->width, target->height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, GL_NONE);
+    }
+
+    // Keep the current framebuffer bound
+    GLint current_framebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &current_framebuffer);
+
+    glGenFramebuffers(1, &target->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    WindowRenderTargetAttachWin(WindowRenderTargetGetAttachmentWin(target), target);
+
+    // Depth-only framebuffers have no color to draw to
+    if (target->is_depth)
+    {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, current_framebuffer);
+
+    entry->id = gNextId++;
+    entry->attached_depth_id = 0;
+    return complete;
+}
+
+static void WindowRenderTargetDestroy(WindowRenderTargetEntry* entry)
+{
+    WindowRenderTarget* target = &entry->target;
+
+    if (target->framebuffer != GL_NONE)
+        glDeleteFramebuffers(1, &target->framebuffer);
+    if (target->texture != GL_NONE)
+        glDeleteTextures(1, &target->texture);
+    if (target->renderbuffer != GL_NONE)
+        glDeleteRenderbuffers(1, &target->renderbuffer);
+}
+
+#endif
+
+static u64 WindowRenderTargetGetFrame()
+{
+    WindowFrameStats frame_stats;
+    WindowGetFrameStats(&frame_stats);
+    return frame_stats.frames;
+}
+
+void WindowSetRenderTargetBudget(u32 mem1_bytes)
+{
+#ifdef TEST_GX2
+    // Once the pool has taken its memory, the budget can only be lowered
+    if (gMEM1Initialized)
+    {
+        if (mem1_bytes != 0 && mem1_bytes < gStats.mem1_budget)
+            gStats.mem1_budget = mem1_bytes;
+        return;
+    }
+
+    gMEM1BudgetRequest = mem1_bytes;
+#else
+    // There is no MEM1 on PC
+    (void)mem1_bytes;
+#endif
+}
+
+WindowRenderTarget* WindowAcquireRenderTarget(u32 width, u32 height, WindowRenderTargetFormat format, u32 samples)
+{
+    if (width == 0 || height == 0 || format >= WINDOW_RT_FORMAT_COUNT)
+        return NULL;
+
+    if (samples != 2 && samples != 4 && samples != 8)
+        samples = 1;
+
+    gStats.acquires++;
+
+    // Reuse an idle target with the same description
+    for (WindowRenderTargetEntry* entry = gTargets; entry; entry = entry->next)
+    {
+        const WindowRenderTarget* target = &entry->target;
+        if (!entry->in_use && target->width == width && target->height == height
+            && target->format == format && target->samples == samples)
+        {
+            entry->in_use = true;
+            gStats.num_in_use++;
+            if (gStats.num_in_use > gStats.peak_in_use)
+                gStats.peak_in_use = gStats.num_in_use;
+
+            return &entry->target;
+        }
+    }
+
+#ifdef TEST_GX2
+    if (!gMEM1Initialized)
+        WindowRenderTargetInitMEM1();
+#endif
+
+    WindowRenderTargetEntry* entry = (WindowRenderTargetEntry*)calloc(1, sizeof(WindowRenderTargetEntry));
+    if (!entry)
+        return NULL;
+
+    entry->target.width = width;
+    entry->target.height = height;
+    entry->target.format = format;
+    entry->target.samples = samples;
+    entry->target.is_depth = WindowFormatIsDepth(format);
+
+    if (!WindowRenderTargetCreate(entry))
+    {
+        WindowRenderTargetDestroy(entry);
+        free(entry);
+        return NULL;
+    }
+
+    if (entry->in_mem1)
+        gStats.mem1_used += entry->size;
+    else
+        gStats.mem2_used += entry->size;
+
+    entry->in_use = true;
+    entry->next = gTargets;
+    gTargets = entry;
+
+    gStats.allocations++;
+    gStats.num_targets++;
+    gStats.num_in_use++;
+    if (gStats.num_in_use > gStats.peak_in_use)
+        gStats.peak_in_use = gStats.num_in_use;
+
+    return &entry->target;
+}
+
+void WindowReleaseRenderTarget(WindowRenderTarget* target)
+{
+    if (!target)
+        return;
+
+    WindowRenderTargetEntry* entry = (WindowRenderTargetEntry*)target;
+    if (!entry->in_use)
+        return;
+
+    entry->in_use = false;
+    entry->last_used_frame = WindowRenderTargetGetFrame();
+    gStats.num_in_use--;
+}
+
+void WindowSetRenderTargets(const WindowRenderTarget* color, const WindowRenderTarget* depth)
+{
+    u32 width, height;
+
+    if (color)
+    {
+        width = color->width;
+        height = color->height;
+    }
+    else if (depth)
+    {
+        width = depth->width;
+        height = depth->height;
+    }
+    else
+    {
+        // The window buffers are only used at the render size
+        WindowGetRenderSize(&width, &height);
+    }
+
+#ifdef TEST_WIN
+
+    if (color)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, color->framebuffer);
+
+        // Attach the depth target to the framebuffer of the color target if it changed
+        // (Compared by id, as a new target can be given the address of a freed one)
+        WindowRenderTargetEntry* entry = (WindowRenderTargetEntry*)color;
+        u32 depth_id = depth ? ((const WindowRenderTargetEntry*)depth)->id : 0;
+        if (entry->attached_depth_id != depth_id)
+        {
+            // Detaching the depth-stencil attachment detaches both depth and stencil
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, GL_NONE);
+            if (depth)
+                WindowRenderTargetAttachWin(WindowRenderTargetGetAttachmentWin(depth), depth);
+
+            entry->attached_depth_id = depth_id;
+        }
+    }
+    else if (depth)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, depth->framebuffer);
+    }
+    else
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, WindowGetFramebuffer());
+    }
+
+    glViewport(0, 0, width, height);
+    glScissor(0, 0, width, height);
+
+#else // TEST_GX2
+
+    // GX2 has no way to unbind the color or depth buffer:
+    // If one of them is NULL, color writes or the depth test must be disabled while drawing
+    // (Depth test is disabled by default)
+    if (!color && !depth)
+    {
+        GX2SetColorBuffer(WindowGetColorBuffer(), GX2_RENDER_TARGET_0);
+        GX2SetDepthBuffer(WindowGetDepthBuffer());
+    }
+    else
+    {
+        if (color)
+            GX2SetColorBuffer(&color->color_buffer, GX2_RENDER_TARGET_0);
+        if (depth)
+            GX2SetDepthBuffer(&depth->depth_buffer);
+    }
+
+    GX2SetViewport(0, 0, width, height, 0.0f, 1.0f);
+    GX2SetScissor(0, 0, width, height);
+
+#endif
+}
+
+bool WindowResolveRenderTarget(const WindowRenderTarget* src, WindowRenderTarget* dst)
+{
+    if (src->is_depth || dst->is_depth || src->samples == 1 || dst->samples != 1
+        || src->width != dst->width || src->height != dst->height || src->format != dst->format)
+        return false;
+
+#ifdef TEST_WIN
+
+    GLint current_framebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &current_framebuffer);
+
+    // The scissor test also applies to blits
+    GLboolean scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+    glDisable(GL_SCISSOR_TEST);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, src->framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dst->framebuffer);
+    glBlitFramebuffer(0, 0, src->width, src->height, 0, 0, dst->width, dst->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, current_framebuffer);
+    if (scissor_test)
+        glEnable(GL_SCISSOR_TEST);
+
+#else // TEST_GX2
+
+    GX2ResolveAAColorBuffer(&src->color_buffer, &dst->color_buffer.surface, 0, 0);
+
+#endif
+
+    return true;
+}
+
+void WindowTrimRenderTargets(u32 max_idle_frames)
+{
+    u64 frame = WindowRenderTargetGetFrame();
+
+#ifdef TEST_GX2
+    bool gpu_idle = false;
+#endif
+
+    WindowRenderTargetEntry** link = &gTargets;
+    while (*link)
+    {
+        WindowRenderTargetEntry* entry = *link;
+        if (entry->in_use || (max_idle_frames != 0 && frame - entry->last_used_frame <= max_idle_frames))
+        {
+            link = &entry->next;
+            continue;
+        }
+
+#ifdef TEST_GX2
+        // The GPU may still be using the target (OpenGL takes care of this itself)
+        if (!gpu_idle)
+        {
+            GX2DrawDone();
+            gpu_idle = true;
+        }
+#endif
+
+        if (entry->in_mem1)
+            gStats.mem1_used -= entry->size;
+        else
+            gStats.mem2_used -= entry->size;
+
+        gStats.num_targets--;
+
+        *link = entry->next;
+        WindowRenderTargetDestroy(entry);
+        free(entry);
+    }
+}
+
+void WindowRenderTargetReleaseForeground()
+{
+#ifdef TEST_GX2
+    WindowRenderTargetEntry** link = &gTargets;
+    while (*link)
+    {
+        WindowRenderTargetEntry* entry = *link;
+        if (!entry->in_mem1)
+        {
+            link = &entry->next;
+            continue;
+        }
+
+        gStats.mem1_used -= entry->size;
+
+        // The memory goes away with the pool heap
+        entry->image = NULL;
+        entry->aa_buffer = NULL;
+
+        if (entry->in_use)
+        {
+            entry->target.color_buffer.surface.image = NULL;
+            entry->target.depth_buffer.surface.image = NULL;
+            entry->target.texture.surface.image = NULL;
+            entry->lost = true;
+
+            // The target holds no memory until it is recreated (so trimming it subtracts nothing)
+            entry->in_mem1 = false;
+            entry->size = 0;
+
+            link = &entry->next;
+            continue;
+        }
+
+        gStats.num_targets--;
+
+        *link = entry->next;
+        free(entry);
+    }
+
+    if (gMEM1Pool)
+    {
+        MEMDestroyExpHeap(gMEM1Pool);
+        gMEM1Pool = NULL;
+    }
+
+    if (gMEM1Arena)
+    {
+        MEMFreeToFrmHeap(MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM1), MEM_FRM_HEAP_FREE_TAIL);
+        gMEM1Arena = NULL;
+    }
+
+    // Taken again with the same budget by the next target created
+    if (gMEM1Initialized)
+    {
+        gMEM1BudgetRequest = gStats.mem1_budget;
+        gStats.mem1_budget = 0;
+        gMEM1Initialized = false;
+    }
+#endif // TEST_GX2
+}
+
+void WindowRenderTargetAcquireForeground()
+{
+#ifdef TEST_GX2
+    for (WindowRenderTargetEntry* entry = gTargets; entry; entry = entry->next)
+    {
+        if (!entry->lost)
+            continue;
+
+        if (!gMEM1Initialized)
+            WindowRenderTargetInitMEM1();
+
+        entry->lost = false;
+
+        // Same description, so the target keeps its address and the user's pointer stays valid
+        // (If it can't be allocated, its surface has no memory and rendering to it does nothing)
+        if (!WindowRenderTargetCreate(entry))
+        {
+            // Nothing was allocated in either pool, so nothing is accounted
+            entry->in_mem1 = false;
+            entry->size = 0;
+            continue;
+        }
+
+        if (entry->in_mem1)
+            gStats.mem1_used += entry->size;
+        else
+            gStats.mem2_used += entry->size;
+    }
+#endif // TEST_GX2
+}
+
+WindowRenderTarget* WindowCreatePlacedRenderTarget(u32 width, u32 height, WindowRenderTargetFormat format, u32* pSize, u32* pAlignment)
+{
+    if (width == 0 || height == 0 || format >= WINDOW_RT_FORMAT_COUNT)
+        return NULL;
+
+    // Not linked into the pool, but an entry all the same, so that WindowSetRenderTargets can use it
+    WindowRenderTargetEntry* entry = (WindowRenderTargetEntry*)calloc(1, sizeof(WindowRenderTargetEntry));
+    if (!entry)
+        return NULL;
+
+    entry->target.width = width;
+    entry->target.height = height;
+    entry->target.format = format;
+    entry->target.samples = 1;
+    entry->target.is_depth = WindowFormatIsDepth(format);
+
+#ifdef TEST_GX2
+    u32 aa_size, aa_alignment;
+    GX2Surface* surface = WindowRenderTargetInitBuffer(&entry->target, &aa_size, &aa_alignment);
+
+    entry->size = surface->imageSize;
+    *pAlignment = surface->alignment;
+#else
+    if (!WindowRenderTargetCreate(entry))
+    {
+        WindowRenderTargetDestroy(entry);
+        free(entry);
+        return NULL;
+    }
+
+    // Estimated like the size, from the usual alignment of tiled GX2 surfaces
+    *pAlignment = WINDOW_RT_PLACED_ALIGNMENT_WIN;
+#endif
+
+    *pSize = entry->size;
+    return &entry->target;
+}
+
+void WindowPlaceRenderTarget(WindowRenderTarget* target, void* memory)
+{
+#ifdef TEST_GX2
+    GX2Surface* surface = target->is_depth ? &target->depth_buffer.surface : &target->color_buffer.surface;
+    WindowRenderTargetSetImage(target, surface, memory);
+#else
+    // Each target has its own texture on PC
+    (void)target;
+    (void)memory;
+#endif
+}
+
+void WindowDestroyPlacedRenderTarget(WindowRenderTarget* target)
+{
+    if (!target)
+        return;
+
+    // The memory belongs to the caller (the entry has no image of its own)
+    WindowRenderTargetEntry* entry = (WindowRenderTargetEntry*)target;
+    WindowRenderTargetDestroy(entry);
+    free(entry);
+}
+
+void* WindowAllocRenderTargetMemory(u32 size, u32 alignment, bool* pInMEM1)
+{
+    *pInMEM1 = false;
+
+#ifdef TEST_GX2
+    if (!gMEM1Initialized)
+        WindowRenderTargetInitMEM1();
+
+    void* memory = NULL;
+
+    // Same placement as targets: MEM1 if it fits in the budget, MEM2 otherwise
+    if (gMEM1Pool && gStats.mem1_used + size <= gStats.mem1_budget)
+    {
+        memory = MEMAllocFromExpHeapEx(gMEM1Pool, size, alignment);
+        *pInMEM1 = memory != NULL;
+    }
+
+    if (!memory)
+        memory = MEMAllocFromDefaultHeapEx(size, alignment);
+
+    if (!memory)
+        return NULL;
+
+    if (*pInMEM1)
+        gStats.mem1_used += size;
+    else
+        gStats.mem2_used += size;
+
+    COHERENCY_ALLOC(memory, size);
+
+    // Flush allocated memory from CPU cache
+    GX2Invalidate(GX2_INVALIDATE_MODE_CPU, memory, size);
+    return memory;
+#else
+    // Targets can't share memory on PC
+    (void)size;
+    (void)alignment;
+    return NULL;
+#endif
+}
+
+void WindowFreeRenderTargetMemory(void* memory, u32 size, bool in_mem1)
+{
+#ifdef TEST_GX2
+    if (!memory)
+        return;
+
+    if (in_mem1)
+    {
+        MEMFreeToExpHeap(gMEM1Pool, memory);
+        gStats.mem1_used -= size;
+    }
+    else
+    {
+        MEMFreeToDefaultHeap(memory);
+        gStats.mem2_used -= size;
+    }
+#else
+    (void)memory;
+    (void)size;
+    (void)in_mem1;
+#endif
+}
+
+void WindowGetRenderTargetStats(WindowRenderTargetStats* pStats)
+{
+    *pStats = gStats;
+}
+
+void WindowRenderTargetExit()
+{
+#ifdef TEST_GX2
+    if (gTargets)
+        GX2DrawDone();
+#endif
+
+    while (gTargets)
+    {
+        WindowRenderTargetEntry* entry = gTargets;
+        gTargets = entry->next;
+
+        WindowRenderTargetDestroy(entry);
+        free(entry);
+    }
+
+#ifdef TEST_GX2
+    if (gMEM1Pool)
+    {
+        MEMDestroyExpHeap(gMEM1Pool);
+        gMEM1Pool = NULL;
+    }
+
+    // The arena is the only allocation from the tail of MEM1
+    if (gMEM1Arena)
+    {
+        MEMFreeToFrmHeap(MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM1), MEM_FRM_HEAP_FREE_TAIL);
+        gMEM1Arena = NULL;
+    }
+
+    gMEM1Initialized = false;
+#endif
+
+    memset(&gStats, 0, sizeof(gStats));
+}
@@ -0,0 +1,148 @@
+// Pool of off-screen render targets
+// Targets are pooled by (width, height, format, samples): released targets are kept and handed out
+// again by later acquires with the same description, so steady-state frames never allocate
+// - Wii U: target memory is placed in MEM1 (fast embedded memory, only 32 MB, part of which holds
+//          the window color and depth buffers) while the budget allows, and in MEM2 otherwise
+// - PC: each target is a texture (or a multisample renderbuffer) with its own framebuffer object;
+//       there is no MEM1, so all memory is counted as MEM2 in the statistics
+
+#ifndef RENDER_TARGET_H_
+#define RENDER_TARGET_H_
+
+#include "window.h"
+
+#ifdef TEST_GX2
+#include <gx2/texture.h>
+#endif // TEST_GX2
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Render target
+// Fields must not be modified by the user
+typedef struct WindowRenderTarget
+{
+    u32 width;
+    u32 height;
+    WindowRenderTargetFormat format;
+    u32 samples;                // Number of samples per pixel (1, 2, 4 or 8)
+    bool is_depth;              // Whether this is a depth (and stencil) target
+#ifdef TEST_WIN
+    u32 framebuffer;            // Framebuffer object with this target attached
+    u32 texture;                // Texture to sample this target from (0 if multisampled)
+    u32 renderbuffer;           // Multisample renderbuffer (0 if not multisampled)
+#else
+    GX2ColorBuffer color_buffer; // Valid if this is not a depth target
+    GX2DepthBuffer depth_buffer; // Valid if this is a depth target
+    GX2Texture texture;          // Texture to sample this target from (Only valid if not multisampled)
+#endif // TEST_WIN
+} WindowRenderTarget;
+
+// Render target pool statistics
+typedef struct WindowRenderTargetStats
+{
+    u32 num_targets;            // Number of targets in the pool (in use and idle)
+    u32 num_in_use;             // Number of targets currently acquired
+    u32 peak_in_use;            // Highest number of targets acquired at once
+    u32 mem1_budget;            // Bytes of MEM1 the pool may use
+    u32 mem1_used;              // Bytes of MEM1 used by pooled targets
+    u32 mem2_used;              // Bytes of MEM2 used by pooled targets (targets that did not fit in the budget)
+    u32 acquires;               // Total number of acquires
+    u32 allocations;            // Number of acquires that could not reuse a pooled target
+} WindowRenderTargetStats;
+
+// Set the MEM1 budget of the pool (Wii U)
+// Must be called after WindowInit and before the first acquire; by default, the pool may use
+// all MEM1 left after WindowInit
+// Parameters:
+// - mem1_bytes: Bytes of MEM1 the pool may use (0 for all remaining MEM1)
+void WindowSetRenderTargetBudget(u32 mem1_bytes);
+
+// Get a render target from the pool, allocating one if none is available with this description
+// Parameters:
+// - width, height: Size of the target
+// - format: Format of the target
+// - samples: Number of samples per pixel (1, 2, 4 or 8)
+// Returns NULL if the target could not be allocated
+WindowRenderTarget* WindowAcquireRenderTarget(u32 width, u32 height, WindowRenderTargetFormat format, u32 samples);
+
+// Give a render target back to the pool
+// It may be handed out again by the next acquire, even in the same frame
+// (GPU commands execute in order, so commands already issued with it are not affected)
+void WindowReleaseRenderTarget(WindowRenderTarget* target);
+
+// Render to the given targets, and set the viewport and scissor to cover them
+// Parameters:
+// - color: Color target (NULL for the window color buffer)
+// - depth: Depth target (NULL for the window depth buffer if color is also NULL, or no depth buffer otherwise)
+void WindowSetRenderTargets(const WindowRenderTarget* color, const WindowRenderTarget* depth);
+
+// Resolve a multisampled color target into a single-sample color target, so that it can be sampled from
+// On Wii U, this resets the current render targets like a clear does (call WindowSetRenderTargets again)
+// Parameters:
+// - src: Multisampled color target
+// - dst: Single-sample color target of the same size and format
+// Returns false if the targets do not match
+bool WindowResolveRenderTarget(const WindowRenderTarget* src, WindowRenderTarget* dst);
+
+// Free idle targets that have not been used for more than max_idle_frames frames
+// Waits for the GPU to be idle on Wii U if anything is freed
+// Parameters:
+// - max_idle_frames: Number of frames a target may stay idle in the pool (0 to free all idle targets)
+void WindowTrimRenderTargets(u32 max_idle_frames);
+
+// Create a single-sample render target whose memory is placed by the caller rather than taken from
+// the pool, so that several targets can share the same memory (see frame_graph.h)
+// - Wii U: the target has no memory until WindowPlaceRenderTarget is called
+// - PC: the target gets its own texture and framebuffer object, and the size and alignment are estimates
+// Parameters:
+// - width, height: Size of the target
+// - format: Format of the target
+// - pSize, pAlignment: Receive the size and alignment of the memory the target needs
+// Returns NULL if the target could not be created
+WindowRenderTarget* WindowCreatePlacedRenderTarget(u32 width, u32 height, WindowRenderTargetFormat format, u32* pSize, u32* pAlignment);
+
+// Give a placed target its memory (Wii U; does nothing on PC)
+// The memory must have the size and alignment returned by WindowCreatePlacedRenderTarget,
+// and its contents are undefined until the target is rendered to
+void WindowPlaceRenderTarget(WindowRenderTarget* target, void* memory);
+
+// Destroy a placed target (its memory belongs to the caller)
+void WindowDestroyPlacedRenderTarget(WindowRenderTarget* target);
+
+// Allocate memory for placed targets, in MEM1 if it fits in the budget of the pool and in MEM2 otherwise
+// (Wii U; returns NULL on PC, where targets can't share memory)
+// The memory is counted in the pool statistics, and must be freed before the pool gives back its MEM1
+// memory when the foreground is released
+// Parameters:
+// - size, alignment: Size and alignment of the memory
+// - pInMEM1: Receives whether the memory was placed in MEM1
+void* WindowAllocRenderTargetMemory(u32 size, u32 alignment, bool* pInMEM1);
+
+// Free memory allocated by WindowAllocRenderTargetMemory, with the size and placement it was allocated with
+void WindowFreeRenderTargetMemory(void* memory, u32 size, bool in_mem1);
+
+// Get render target pool statistics
+void WindowGetRenderTargetStats(WindowRenderTargetStats* pStats);
+
+// Give back the MEM1 memory of the pool when the application releases the foreground (Wii U)
+// Called by the window with the GPU idle: idle targets in MEM1 are freed, and targets in use in MEM1
+// keep their description but lose their memory (does nothing on PC)
+void WindowRenderTargetReleaseForeground();
+
+// Give the targets in use that lost their memory new memory, when the application acquires the
+// foreground again (Wii U); their contents are undefined
+// Called by the window (does nothing on PC)
+void WindowRenderTargetAcquireForeground();
+
+// Free all targets and the pool memory
+// All targets must have been released
+void WindowRenderTargetExit();
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // RENDER_TARGET_H_
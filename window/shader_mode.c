@@ -0,0 +1,195 @@
+// Shader mode and GPR / stack partition
+
+#include "shader_mode.h"
+
+#include <string.h>
+
+#ifdef TEST_WIN
+#include <GL/glew.h>
+#endif
+
+// Wavefronts per stage are also limited by the thread slots of the shader sequencer,
+// so GPRs for more wavefronts than this would be wasted
+#define WINDOW_SHADER_MAX_WAVES 32
+
+// Wavefronts of pixel shaders wanted per wavefront of vertex shaders
+#define WINDOW_SHADER_PS_PER_VS 2
+
+// SQ_PGM_RESOURCES_VS / SQ_PGM_RESOURCES_PS fields
+#define WINDOW_SQ_PGM_RESOURCES_NUM_GPRS(reg)   ((reg) & 0xFF)
+#define WINDOW_SQ_PGM_RESOURCES_STACK_SIZE(reg) (((reg) >> 8) & 0xFF)
+
+static WindowShaderMode gShaderMode = WINDOW_SHADER_MODE_UNIFORM_REGISTER;
+static bool gPartitionAuto = false;
+static WindowShaderPartition gPartition = { 48, 64, 0, 0, 200, 192, 0, 0 };
+
+void WindowGetShaderNeeds(const WindowShaderSet* shaders, WindowShaderNeeds* pNeeds)
+{
+#ifdef TEST_WIN
+    (void)shaders;
+    memset(pNeeds, 0, sizeof(WindowShaderNeeds));
+#else
+    u32 vs_resources = shaders->vertex_shader->regs.sq_pgm_resources_vs;
+    u32 ps_resources = shaders->pixel_shader->regs.sq_pgm_resources_ps;
+
+    pNeeds->vs_gprs = WINDOW_SQ_PGM_RESOURCES_NUM_GPRS(vs_resources);
+    pNeeds->vs_stack = WINDOW_SQ_PGM_RESOURCES_STACK_SIZE(vs_resources);
+    pNeeds->ps_gprs = WINDOW_SQ_PGM_RESOURCES_NUM_GPRS(ps_resources);
+    pNeeds->ps_stack = WINDOW_SQ_PGM_RESOURCES_STACK_SIZE(ps_resources);
+#endif
+}
+
+void WindowMergeShaderNeeds(WindowShaderNeeds* pNeeds, const WindowShaderNeeds* other)
+{
+    if (other->vs_gprs > pNeeds->vs_gprs)
+        pNeeds->vs_gprs = other->vs_gprs;
+    if (other->vs_stack > pNeeds->vs_stack)
+        pNeeds->vs_stack = other->vs_stack;
+    if (other->ps_gprs > pNeeds->ps_gprs)
+        pNeeds->ps_gprs = other->ps_gprs;
+    if (other->ps_stack > pNeeds->ps_stack)
+        pNeeds->ps_stack = other->ps_stack;
+}
+
+void WindowGetDefaultShaderPartition(WindowShaderPartition* pPartition)
+{
+    pPartition->vs_gprs = 48;
+    pPartition->vs_stack = 64;
+    pPartition->gs_gprs = 0;
+    pPartition->gs_stack = 0;
+    pPartition->ps_gprs = 200;
+    pPartition->ps_stack = 192;
+    pPartition->vs_waves = 0;
+    pPartition->ps_waves = 0;
+}
+
+void WindowComputeShaderPartition(const WindowShaderNeeds* needs, WindowShaderPartition* pPartition)
+{
+    // Every shader uses at least one GPR
+    u32 vs_need = needs->vs_gprs > 0 ? needs->vs_gprs : 1;
+    u32 ps_need = needs->ps_gprs > 0 ? needs->ps_gprs : 1;
+
+    WindowGetDefaultShaderPartition(pPartition);
+    if (vs_need + ps_need > WINDOW_SHADER_TOTAL_GPRS || needs->vs_stack + needs->ps_stack > WINDOW_SHADER_TOTAL_STACK)
+        return;
+
+    // Try every number of vertex shader wavefronts, giving the rest to the pixel shader,
+    // and keep the one where the scarcer stage has the most wavefronts
+    // (On a tie, the pixel shader wins)
+    u32 best_vs_waves = 1;
+    u32 best_ps_waves = 0;
+    u32 best_score = 0;
+
+    for (u32 vs_waves = 1; vs_waves <= WINDOW_SHADER_MAX_WAVES; vs_waves++)
+    {
+        u32 vs_gprs = vs_need * vs_waves;
+        if (vs_gprs + ps_need > WINDOW_SHADER_TOTAL_GPRS)
+            break;
+
+        u32 ps_waves = (WINDOW_SHADER_TOTAL_GPRS - vs_gprs) / ps_need;
+        if (ps_waves > WINDOW_SHADER_MAX_WAVES)
+            ps_waves = WINDOW_SHADER_MAX_WAVES;
+
+        u32 score = vs_waves * WINDOW_SHADER_PS_PER_VS < ps_waves ? vs_waves * WINDOW_SHADER_PS_PER_VS : ps_waves;
+        if (score > best_score || (score == best_score && ps_waves > best_ps_waves))
+        {
+            best_vs_waves = vs_waves;
+            best_ps_waves = ps_waves;
+            best_score = score;
+        }
+    }
+
+    pPartition->vs_gprs = vs_need * best_vs_waves;
+    pPartition->ps_gprs = WINDOW_SHADER_TOTAL_GPRS - pPartition->vs_gprs;
+
+    // The stack is split the same way, leaving room for at least one pixel shader wavefront
+    u32 vs_stack = needs->vs_stack * best_vs_waves;
+    if (vs_stack > WINDOW_SHADER_TOTAL_STACK - needs->ps_stack)
+    {
+        vs_stack = WINDOW_SHADER_TOTAL_STACK - needs->ps_stack;
+        vs_stack -= vs_stack % needs->vs_stack;
+        best_vs_waves = vs_stack / needs->vs_stack;
+    }
+
+    pPartition->vs_stack = vs_stack;
+    pPartition->ps_stack = WINDOW_SHADER_TOTAL_STACK - vs_stack;
+
+    if (needs->ps_stack > 0 && pPartition->ps_stack / needs->ps_stack < best_ps_waves)
+        best_ps_waves = pPartition->ps_stack / needs->ps_stack;
+
+    pPartition->vs_waves = best_vs_waves;
+    pPartition->ps_waves = best_ps_waves;
+}
+
+static void WindowApplyShaderPartition(const WindowShaderPartition* partition)
+{
+    gPartition = *partition;
+
+#ifdef TEST_GX2
+    GX2SetShaderModeEx(
+        gShaderMode == WINDOW_SHADER_MODE_UNIFORM_BLOCK ? GX2_SHADER_MODE_UNIFORM_BLOCK : GX2_SHADER_MODE_UNIFORM_REGISTER,
+        partition->vs_gprs, partition->vs_stack,
+        partition->gs_gprs, partition->gs_stack,
+        partition->ps_gprs, partition->ps_stack
+    );
+#endif
+}
+
+void WindowSetShaderMode(WindowShaderMode mode)
+{
+    gShaderMode = mode;
+    WindowApplyShaderPartition(&gPartition);
+}
+
+void WindowSetShaderPartitionAuto(bool enable)
+{
+    gPartitionAuto = enable;
+
+    if (!enable)
+    {
+        WindowShaderPartition partition;
+        WindowGetDefaultShaderPartition(&partition);
+        WindowApplyShaderPartition(&partition);
+    }
+}
+
+void WindowApplyShaderNeeds(const WindowShaderNeeds* needs)
+{
+    if (!gPartitionAuto)
+        return;
+
+    WindowShaderPartition partition;
+    WindowComputeShaderPartition(needs, &partition);
+
+    // Changing the partition drains the shader core, so only do it when needed
+    if (partition.vs_gprs != gPartition.vs_gprs || partition.vs_stack != gPartition.vs_stack ||
+        partition.ps_gprs != gPartition.ps_gprs || partition.ps_stack != gPartition.ps_stack)
+    {
+        WindowApplyShaderPartition(&partition);
+    }
+    else
+    {
+        gPartition.vs_waves = partition.vs_waves;
+        gPartition.ps_waves = partition.ps_waves;
+    }
+}
+
+void WindowSetShaders(const WindowShaderSet* shaders)
+{
+#ifdef TEST_WIN
+    glUseProgram(shaders->program);
+#else
+    WindowShaderNeeds needs;
+    WindowGetShaderNeeds(shaders, &needs);
+    WindowApplyShaderNeeds(&needs);
+
+    GX2SetFetchShader(shaders->fetch_shader);
+    GX2SetVertexShader(shaders->vertex_shader);
+    GX2SetPixelShader(shaders->pixel_shader);
+#endif
+}
+
+void WindowGetShaderPartition(WindowShaderPartition* pPartition)
+{
+    *pPartition = gPartition;
+}
@@ -0,0 +1,86 @@
+// Shader mode and GPR / stack partition
+// On Wii U, the register file and the stack of the shader core are split between the shader stages by
+// GX2SetShaderModeEx. The number of wavefronts of a stage that can be in flight at once (and so how well
+// memory latency is hidden) is the number of GPRs given to the stage divided by the GPRs its shader uses,
+// which is recorded in the SQ_PGM_RESOURCES register of the shader header
+// This module reads those registers and computes the split that keeps the most wavefronts in flight,
+// and can apply it automatically whenever the shaders in use change
+// On PC, the driver takes care of this; only the computation is available
+
+#ifndef SHADER_MODE_H_
+#define SHADER_MODE_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Total number of GPRs and stack entries split between the stages
+// (The hardware has 256 GPRs; GX2 reserves 2 x 4 of them as clause temporaries)
+#define WINDOW_SHADER_TOTAL_GPRS  248
+#define WINDOW_SHADER_TOTAL_STACK 256
+
+// Resources used by one wavefront of each stage
+typedef struct WindowShaderNeeds
+{
+    u32 vs_gprs;
+    u32 vs_stack;
+    u32 ps_gprs;
+    u32 ps_stack;
+} WindowShaderNeeds;
+
+// Split of the GPRs and stack entries between the stages, as passed to GX2SetShaderModeEx
+typedef struct WindowShaderPartition
+{
+    u32 vs_gprs;
+    u32 vs_stack;
+    u32 gs_gprs;                // Always 0 (geometry shaders are not used)
+    u32 gs_stack;
+    u32 ps_gprs;
+    u32 ps_stack;
+
+    // Wavefronts of each stage that fit in the split, for the needs it was computed for (0 if unknown)
+    u32 vs_waves;
+    u32 ps_waves;
+} WindowShaderPartition;
+
+// Get the resources used by a shader set
+// On PC, the needs are not known and are all 0
+void WindowGetShaderNeeds(const WindowShaderSet* shaders, WindowShaderNeeds* pNeeds);
+
+// Combine the needs of two shader sets (the largest of each), so that one partition fits both
+void WindowMergeShaderNeeds(WindowShaderNeeds* pNeeds, const WindowShaderNeeds* other);
+
+// Compute the partition maximizing the wavefronts in flight for the given needs
+// Pixel shaders get up to twice as many wavefronts as vertex shaders, as there are usually many more
+// pixels than vertices; any GPRs and stack entries left over go to the pixel shader
+void WindowComputeShaderPartition(const WindowShaderNeeds* needs, WindowShaderPartition* pPartition);
+
+// Get the fixed partition used when automatic partitioning is disabled
+// (48 GPRs and 64 stack entries for the vertex shader, 200 GPRs and 192 stack entries for the pixel shader)
+void WindowGetDefaultShaderPartition(WindowShaderPartition* pPartition);
+
+// Enable or disable automatic partitioning (disabled by default)
+// When enabled, the partition is recomputed from the needs of the shaders passed to WindowSetShaders
+// (or recorded in command lists; see WindowCmdSubmit) and applied when it changes
+// When disabled, the fixed partition is applied again
+void WindowSetShaderPartitionAuto(bool enable);
+
+// Make sure the partition in use fits the given needs (only if automatic partitioning is enabled)
+// Changing the partition makes the GPU wait for the shaders in flight, so sets with similar needs
+// should be drawn together
+void WindowApplyShaderNeeds(const WindowShaderNeeds* needs);
+
+// Set the shaders to draw with, updating the partition first if needed
+void WindowSetShaders(const WindowShaderSet* shaders);
+
+// Get the partition in use
+void WindowGetShaderPartition(WindowShaderPartition* pPartition);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // SHADER_MODE_H_
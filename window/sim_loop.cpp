@@ -0,0 +1,319 @@
+// Simulation loop with a fixed timestep, publishing snapshots through a triple buffer
+
+#include "sim_loop.h"
+#include "trace.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <chrono>
+#include <thread>
+
+#else // TEST_GX2
+
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+
+// Stack size of the simulation thread
+#define WINDOW_SIM_STACK_SIZE 0x10000
+
+#endif
+
+// The middle slot of the triple buffer, and whether it holds a snapshot the render thread has not
+// acquired yet
+#define WINDOW_SIM_SLOT_MASK  0x3
+#define WINDOW_SIM_SLOT_FRESH 0x4
+
+typedef struct WindowSimSlot
+{
+    u8* prev;                   // State of the step before the last one
+    u8* next;                   // State of the last step
+    f64 time;                   // Time the last step was due at
+
+    // Statistics of the simulation when the snapshot was published, so that the render thread can read
+    // them without sharing anything else with the simulation thread
+    u64 steps;
+    u64 published;
+    u64 dropped_steps;
+    f64 step_time;
+} WindowSimSlot;
+
+struct WindowSimLoop
+{
+    WindowSimDesc desc;
+    u8* memory;
+
+    WindowSimSlot slots[3];
+    std::atomic<u32> middle;    // Slot exchanged between the two threads, with WINDOW_SIM_SLOT_FRESH
+
+    // Owned by the simulation thread (or by the render thread without a thread)
+    u32 back;
+    u8* state;
+    u8* prev;
+    f64 next_step_time;
+    u64 steps;
+    u64 published;
+    u64 dropped_steps;
+    f64 step_time;
+
+    // Owned by the render thread
+    u32 front;
+    u8* output;
+    u64 consumed;
+    u64 acquires;
+    f32 last_alpha;
+
+    std::atomic<bool> quit;
+#ifdef TEST_WIN
+    std::thread thread;
+#else
+    OSThread* thread;
+    void* stack;
+#endif
+};
+
+// Run the steps that are due, and publish a snapshot if any ran
+static void WindowSimRunSteps(WindowSimLoop* loop, f64 now)
+{
+    const WindowSimDesc* desc = &loop->desc;
+    u32 steps = 0;
+    f64 step_due = 0.0;
+
+    while (loop->next_step_time <= now)
+    {
+        if (steps == WINDOW_SIM_MAX_CATCH_UP_STEPS)
+        {
+            // Drop the time that can't be caught up with, and carry on from now
+            u64 dropped = (u64)((now - loop->next_step_time) / desc->timestep) + 1;
+            loop->dropped_steps += dropped;
+            loop->next_step_time += (f64)dropped * desc->timestep;
+            break;
+        }
+
+        memcpy(loop->prev, loop->state, desc->state_size);
+
+        f64 start = WindowGetTime();
+        desc->step(loop->state, desc->timestep, ++loop->steps, desc->user_data);
+        loop->step_time += WindowGetTime() - start;
+
+        step_due = loop->next_step_time;
+        loop->next_step_time += desc->timestep;
+        steps++;
+    }
+
+    if (steps == 0)
+        return;
+
+    WindowSimSlot* slot = &loop->slots[loop->back];
+    memcpy(slot->prev, loop->prev, desc->state_size);
+    memcpy(slot->next, loop->state, desc->state_size);
+    slot->time = step_due;
+    slot->steps = loop->steps;
+    slot->published = ++loop->published;
+    slot->dropped_steps = loop->dropped_steps;
+    slot->step_time = loop->step_time;
+
+    // Publish the snapshot and take the previous middle slot to write the next one
+    loop->back = loop->middle.exchange(loop->back | WINDOW_SIM_SLOT_FRESH, std::memory_order_acq_rel) & WINDOW_SIM_SLOT_MASK;
+}
+
+static void WindowSimThreadLoop(WindowSimLoop* loop)
+{
+    TraceSetThreadName("Simulation");
+
+    while (!loop->quit.load(std::memory_order_relaxed))
+    {
+        WindowSimRunSteps(loop, WindowGetTime());
+
+        // Sleep until the next step is due
+        f64 wait = loop->next_step_time - WindowGetTime();
+        if (wait <= 0.0)
+            continue;
+
+#ifdef TEST_WIN
+        std::this_thread::sleep_for(std::chrono::duration<f64>(wait));
+#else
+        OSSleepTicks(OSNanosecondsToTicks((OSTime)(wait * 1e9)));
+#endif
+    }
+}
+
+#ifdef TEST_GX2
+
+static int WindowSimThreadMain(int argc, const char** argv)
+{
+    (void)argc;
+
+    WindowSimThreadLoop((WindowSimLoop*)argv);
+    return 0;
+}
+
+#endif
+
+WindowSimLoop* WindowSimLoopCreate(const WindowSimDesc* desc)
+{
+    if (desc->state_size == 0 || !desc->initial_state || desc->timestep <= 0.0 || !desc->step)
+        return NULL;
+
+    WindowSimLoop* loop = new (std::nothrow) WindowSimLoop();
+    if (!loop)
+        return NULL;
+
+    // Both states of the three slots, the state of the simulation and the one before, and the output
+    u32 size = desc->state_size;
+    loop->memory = (u8*)malloc(size * 9);
+    if (!loop->memory)
+    {
+        delete loop;
+        return NULL;
+    }
+
+    loop->desc = *desc;
+
+    f64 now = WindowGetTime();
+    for (u32 i = 0; i < 3; i++)
+    {
+        WindowSimSlot* slot = &loop->slots[i];
+        slot->prev = loop->memory + size * (i * 2);
+        slot->next = loop->memory + size * (i * 2 + 1);
+        slot->time = now;
+        slot->steps = 0;
+        slot->published = 0;
+        slot->dropped_steps = 0;
+        slot->step_time = 0.0;
+
+        memcpy(slot->prev, desc->initial_state, size);
+        memcpy(slot->next, desc->initial_state, size);
+    }
+
+    loop->front = 0;
+    loop->middle.store(1);
+    loop->back = 2;
+
+    loop->state = loop->memory + size * 6;
+    loop->prev = loop->memory + size * 7;
+    loop->output = loop->memory + size * 8;
+    memcpy(loop->state, desc->initial_state, size);
+
+    loop->next_step_time = now + desc->timestep;
+    loop->steps = 0;
+    loop->published = 0;
+    loop->dropped_steps = 0;
+    loop->step_time = 0.0;
+
+    loop->consumed = 0;
+    loop->acquires = 0;
+    loop->last_alpha = 1.0f;
+
+    loop->quit.store(false);
+
+    if (!desc->threaded)
+        return loop;
+
+#ifdef TEST_WIN
+
+    loop->thread = std::thread(WindowSimThreadLoop, loop);
+
+#else // TEST_GX2
+
+    // OSThread instances must be 8-byte aligned, stacks 16-byte aligned
+    loop->thread = (OSThread*)MEMAllocFromDefaultHeapEx(sizeof(OSThread), 8);
+    loop->stack = MEMAllocFromDefaultHeapEx(WINDOW_SIM_STACK_SIZE, 16);
+
+    // Same priority as the main thread (16), on the core next to it
+    if (!loop->thread || !loop->stack
+        || !OSCreateThread(loop->thread, WindowSimThreadMain, 0, (char*)loop,
+                           (u8*)loop->stack + WINDOW_SIM_STACK_SIZE, WINDOW_SIM_STACK_SIZE,
+                           16, OS_THREAD_ATTRIB_AFFINITY_CPU2))
+    {
+        if (loop->thread)
+            MEMFreeToDefaultHeap(loop->thread);
+        if (loop->stack)
+            MEMFreeToDefaultHeap(loop->stack);
+        free(loop->memory);
+        delete loop;
+        return NULL;
+    }
+
+    OSResumeThread(loop->thread);
+
+#endif
+
+    return loop;
+}
+
+const void* WindowSimLoopAcquire(WindowSimLoop* loop)
+{
+    const WindowSimDesc* desc = &loop->desc;
+    f64 now = WindowGetTime();
+
+    if (!desc->threaded)
+        WindowSimRunSteps(loop, now);
+
+    // Take the newest snapshot, if one was published since the last acquire
+    if (loop->middle.load(std::memory_order_acquire) & WINDOW_SIM_SLOT_FRESH)
+    {
+        loop->front = loop->middle.exchange(loop->front, std::memory_order_acq_rel) & WINDOW_SIM_SLOT_MASK;
+        loop->consumed++;
+    }
+
+    loop->acquires++;
+
+    // The snapshot is rendered one step in the past: at the time its last step was due, it shows the
+    // previous step, and it reaches the last step one timestep later
+    const WindowSimSlot* slot = &loop->slots[loop->front];
+    f32 alpha = (f32)((now - slot->time) / desc->timestep);
+    if (alpha < 0.0f)
+        alpha = 0.0f;
+    else if (alpha > 1.0f)
+        alpha = 1.0f;
+
+    loop->last_alpha = alpha;
+
+    if (!desc->interpolate)
+        return slot->next;
+
+    desc->interpolate(loop->output, slot->prev, slot->next, alpha, desc->user_data);
+    return loop->output;
+}
+
+void WindowSimLoopGetStats(WindowSimLoop* loop, WindowSimStats* pStats)
+{
+    // Counts of the simulation as of the newest snapshot acquired
+    const WindowSimSlot* slot = &loop->slots[loop->front];
+    pStats->steps = slot->steps;
+    pStats->published = slot->published;
+    pStats->dropped_steps = slot->dropped_steps;
+    pStats->step_ms = slot->step_time * 1000.0;
+
+    pStats->consumed = loop->consumed;
+    pStats->acquires = loop->acquires;
+    pStats->last_alpha = loop->last_alpha;
+}
+
+void WindowSimLoopDestroy(WindowSimLoop* loop)
+{
+    if (!loop)
+        return;
+
+    if (loop->desc.threaded)
+    {
+        loop->quit.store(true);
+
+#ifdef TEST_WIN
+        loop->thread.join();
+#else
+        OSJoinThread(loop->thread, NULL);
+        MEMFreeToDefaultHeap(loop->thread);
+        MEMFreeToDefaultHeap(loop->stack);
+#endif
+    }
+
+    free(loop->memory);
+    delete loop;
+}
@@ -0,0 +1,93 @@
+// Simulation loop
+// The simulation advances at a fixed timestep on its own thread, independently of the frame rate,
+// and publishes snapshots of its state through a triple buffer: the simulation always has a slot
+// to write, the render thread always has the newest complete snapshot to read, and neither ever
+// waits for the other (the two exchange slots with an atomic swap)
+// A snapshot holds the state of the last two steps, so that the render thread can interpolate
+// between them: it renders the simulation one step in the past, which keeps motion smooth when the
+// frame rate and the simulation rate differ
+// Without a thread (WindowSimDesc.threaded false), the steps that are due run when the render thread
+// acquires a snapshot instead, for comparison and for single-core targets
+// - Wii U: the simulation thread runs on core 2 (the main thread runs on core 1)
+// - PC: std::thread
+
+#ifndef SIM_LOOP_H_
+#define SIM_LOOP_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Most steps run at once to catch up: beyond that, the simulation drops time instead of spiraling
+// (e.g. after a breakpoint, or when a step costs more than the timestep)
+#define WINDOW_SIM_MAX_CATCH_UP_STEPS 8
+
+// Function advancing the state by one step, called on the simulation thread
+// Parameters:
+// - state: State to update in place (the state of the previous step)
+// - timestep: Duration of the step in seconds
+// - step: Number of the step (1 for the first one)
+// - user_data: Pointer given in the description
+typedef void (*WindowSimStepFunc)(void* state, f64 timestep, u64 step, void* user_data);
+
+// Function interpolating between two states, called by WindowSimLoopAcquire
+// Parameters:
+// - dst: Output state
+// - prev, next: States of two consecutive steps
+// - alpha: Position between them (0 for prev, 1 for next)
+// - user_data: Pointer given in the description
+typedef void (*WindowSimInterpolateFunc)(void* dst, const void* prev, const void* next, f32 alpha, void* user_data);
+
+// Description of a simulation loop
+typedef struct WindowSimDesc
+{
+    u32 state_size;                         // Size of the state in bytes
+    const void* initial_state;              // State before the first step
+    f64 timestep;                           // Fixed duration of a step in seconds (e.g. 1 / 120)
+    bool threaded;                          // Whether to run the steps on the simulation thread
+    WindowSimStepFunc step;                 // Advances the state
+    WindowSimInterpolateFunc interpolate;   // Interpolates between two states (NULL: the newest state is used)
+    void* user_data;                        // Passed to step and interpolate
+} WindowSimDesc;
+
+typedef struct WindowSimLoop WindowSimLoop;
+
+// Simulation loop statistics
+typedef struct WindowSimStats
+{
+    u64 steps;                  // Steps run
+    u64 published;              // Snapshots published (one per batch of steps)
+    u64 consumed;               // Snapshots the render thread acquired
+    u64 acquires;               // Calls to WindowSimLoopAcquire
+    u64 dropped_steps;          // Steps skipped because the simulation fell too far behind
+    f64 step_ms;                // Total time spent in the step function, in milliseconds
+    f32 last_alpha;             // Interpolation position of the last acquire
+} WindowSimStats;
+
+// Create a simulation loop and start it
+// The time of the first step is one timestep after creation
+// Returns NULL if the loop could not be created (the description is invalid, or out of memory)
+WindowSimLoop* WindowSimLoopCreate(const WindowSimDesc* desc);
+
+// Get the state to render: the newest snapshot, interpolated between its two steps at the current time
+// Must always be called from the same thread (the render thread)
+// Returns a pointer to the state, valid until the next call
+const void* WindowSimLoopAcquire(WindowSimLoop* loop);
+
+// Get the statistics
+// The counts of the simulation are those of the newest snapshot acquired
+// Parameters:
+// - pStats: Output statistics
+void WindowSimLoopGetStats(WindowSimLoop* loop, WindowSimStats* pStats);
+
+// Stop the simulation and free the loop
+void WindowSimLoopDestroy(WindowSimLoop* loop);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // SIM_LOOP_H_
@@ -0,0 +1,1059 @@
+// Texture streaming
+
+#include "texture_stream.h"
+#include "format.h"
+#include "trace.h"
+
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+static std::thread gLoaderThread;
+static std::mutex gMutex;
+static std::condition_variable gCondition;
+
+#else // TEST_GX2
+
+#include <coreinit/cache.h>
+#include <coreinit/event.h>
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/thread.h>
+#include <gx2/event.h>
+#include <gx2/mem.h>
+#include <gx2/sampler.h>
+#include <gx2/state.h>
+#include <gx2/surface.h>
+#include <gx2/texture.h>
+
+// Stack size of the loader thread
+#define WINDOW_STREAM_LOADER_STACK_SIZE 0x8000
+
+// Most memory blocks waiting for the GPU to be done with them before they are freed
+#define WINDOW_STREAM_MAX_RETIRED 64
+
+static OSThread* gLoaderThread = NULL;
+static void* gLoaderStack = NULL;
+static OSEvent gLoaderEvent;
+
+// Memory replaced in this or earlier frames, freed once the GPU has executed the commands using it
+static void* gRetired[WINDOW_STREAM_MAX_RETIRED];
+static OSTime gRetiredFences[WINDOW_STREAM_MAX_RETIRED]; // 0 until the commands have been flushed
+static u32 gNumRetired = 0;
+
+// Whether GPU copies were issued since the last update
+static bool gCopied = false;
+
+#endif
+
+// Most loads queued or in progress at once
+#define WINDOW_STREAM_MAX_LOADS 4
+
+enum WindowStreamLoadState
+{
+    WINDOW_STREAM_LOAD_FREE,    // Unused
+    WINDOW_STREAM_LOAD_QUEUED,  // Handed to the loader thread
+    WINDOW_STREAM_LOAD_DONE     // Read by the loader thread, waiting for WindowStreamUpdate
+};
+
+// Levels read for a texture, and the memory they go to
+struct WindowStreamLoad
+{
+    WindowStreamTexture* texture;
+    u32 first_level;            // Levels read: first_level to end_level - 1
+    u32 end_level;              // (The finest level resident when the load was queued)
+    u32 new_size;               // Bytes of the resident levels of the texture once the load is placed
+    u32 sequence;               // Loads are read in the order they were queued
+    std::atomic<u32> state;
+
+    // Written by the loader thread
+    bool success;
+    u32 size;                   // Bytes read
+    f64 ms;                     // Time spent reading
+
+#ifdef TEST_WIN
+    u8* data;                   // Levels, one after the other
+    u32 offsets[WINDOW_STREAM_MAX_LEVELS];
+#else
+    GX2Surface staging[WINDOW_STREAM_MAX_LEVELS]; // Linear surface of each level read
+    void* staging_memory;
+    u32 staging_size;
+    GX2Surface surface;         // New surface of the texture, holding levels first_level and up
+    void* memory;
+#endif
+};
+
+struct WindowStreamTexture
+{
+    u32 width;
+    u32 height;
+    u32 levels;
+    WindowTextureFormat format;
+    WindowStreamReadFunc read;
+    void* user_data;
+
+    u32 tail_level;             // First level of the mip tail
+    u32 resident_level;         // Finest resident level (all levels from it to the last are resident)
+    u32 wanted_level;           // Finest level requested
+    u32 resident_size;          // Bytes used by the resident levels
+    u32 tail_size;              // Bytes used by the mip tail alone
+    u64 last_used_frame;        // Frame the texture was last requested or bound in
+    u64 skipped_frame;          // Frame a load of the texture could not be queued in
+    WindowStreamLoad* load;     // Load in progress (NULL if none)
+    WindowStreamTexture* next;
+
+#ifdef TEST_WIN
+    u32 texture;
+#else
+    GX2Texture texture;
+    GX2Sampler sampler;
+    void* memory;               // Memory of the texture surface
+    u32 swizzle;                // Bank and pipe swizzle of the texture surface
+#endif
+};
+
+// Scratch buffer of a thread, for levels whose rows have to be realigned (Wii U)
+struct WindowStreamScratch
+{
+    void* data;
+    u32 size;
+};
+
+static bool gRunning = false;
+static std::atomic<bool> gQuit(false);
+static WindowStreamLoad gLoads[WINDOW_STREAM_MAX_LOADS];
+static u32 gNextSequence = 0;
+
+static WindowStreamTexture* gTextures = NULL;
+static WindowStreamScratch gMainScratch = { NULL, 0 };
+static WindowStreamStats gStats;
+static u64 gFrame = 1;
+
+static u32 WindowStreamGetLevelWidth(const WindowStreamTexture* texture, u32 level)
+{
+    u32 width = texture->width >> level;
+    return width != 0 ? width : 1;
+}
+
+static u32 WindowStreamGetLevelHeight(const WindowStreamTexture* texture, u32 level)
+{
+    u32 height = texture->height >> level;
+    return height != 0 ? height : 1;
+}
+
+static u32 WindowStreamGetLevelSize(const WindowStreamTexture* texture, u32 level)
+{
+    return WindowTextureFormatGetLevelSize(
+        texture->format,
+        WindowStreamGetLevelWidth(texture, level),
+        WindowStreamGetLevelHeight(texture, level)
+    );
+}
+
+static void WindowStreamFreeScratch(WindowStreamScratch* scratch)
+{
+#ifdef TEST_GX2
+    if (scratch->data)
+        MEMFreeToDefaultHeap(scratch->data);
+#endif
+    scratch->data = NULL;
+    scratch->size = 0;
+}
+
+#ifdef TEST_GX2
+
+static void WindowStreamInitSurface(GX2Surface* surface, const WindowStreamTexture* texture,
+                                    u32 first_level, u32 levels, GX2TileMode tile_mode)
+{
+    surface->dim = GX2_SURFACE_DIM_TEXTURE_2D;
+    surface->width = WindowStreamGetLevelWidth(texture, first_level);
+    surface->height = WindowStreamGetLevelHeight(texture, first_level);
+    surface->depth = 1;
+    surface->mipLevels = levels;
+    surface->format = WindowTextureFormatGetSurfaceFormat(texture->format);
+    surface->aa = GX2_AA_MODE1X;
+    surface->use = GX2_SURFACE_USE_TEXTURE;
+    surface->image = NULL;
+    surface->mipmaps = NULL;
+    surface->tileMode = tile_mode;
+    surface->swizzle = 0;
+
+    GX2CalcSurfaceSizeAndAlignment(surface);
+}
+
+// Allocate the surface holding the levels of a texture from first_level to the last
+static bool WindowStreamAllocSurface(const WindowStreamTexture* texture, u32 first_level, GX2Surface* surface, void** pMemory)
+{
+    WindowStreamInitSurface(surface, texture, first_level, texture->levels - first_level, GX2_TILE_MODE_DEFAULT);
+
+    // Textures sampled together are spread over the memory banks by giving them different swizzles
+    GX2SetSurfaceSwizzle(surface, texture->swizzle);
+
+    // The levels after the first one follow it in the same allocation
+    void* memory = MEMAllocFromDefaultHeapEx(surface->imageSize + surface->mipmapSize, surface->alignment);
+    if (!memory)
+        return false;
+
+    surface->image = memory;
+    if (surface->mipLevels > 1)
+        surface->mipmaps = (u8*)memory + surface->mipLevelOffset[0];
+
+    *pMemory = memory;
+    return true;
+}
+
+// Free memory the GPU may still be using, once it is done with it
+static void WindowStreamRetire(void* memory)
+{
+    if (!memory)
+        return;
+
+    if (gNumRetired == WINDOW_STREAM_MAX_RETIRED)
+    {
+        GX2DrawDone();
+
+        for (u32 i = 0; i < gNumRetired; i++)
+            MEMFreeToDefaultHeap(gRetired[i]);
+        gNumRetired = 0;
+    }
+
+    gRetired[gNumRetired] = memory;
+    gRetiredFences[gNumRetired] = 0;
+    gNumRetired++;
+}
+
+// Free the retired memory the GPU is done with
+static void WindowStreamFreeRetired()
+{
+    OSTime retired = GX2GetRetiredTimeStamp();
+
+    u32 kept = 0;
+    for (u32 i = 0; i < gNumRetired; i++)
+    {
+        if (gRetiredFences[i] != 0 && gRetiredFences[i] <= retired)
+        {
+            MEMFreeToDefaultHeap(gRetired[i]);
+            continue;
+        }
+
+        gRetired[kept] = gRetired[i];
+        gRetiredFences[kept] = gRetiredFences[i];
+        kept++;
+    }
+
+    gNumRetired = kept;
+}
+
+// Make the texture use a new surface, and retire its previous one
+static void WindowStreamSetSurface(WindowStreamTexture* texture, const GX2Surface* surface, void* memory)
+{
+    WindowStreamRetire(texture->memory);
+    texture->memory = memory;
+
+    texture->texture.surface = *surface;
+    texture->texture.viewFirstMip = 0;
+    texture->texture.viewNumMips = surface->mipLevels;
+    texture->texture.viewFirstSlice = 0;
+    texture->texture.viewNumSlices = 1;
+    texture->texture.compMap = GX2_COMP_MAP(GX2_SQ_SEL_X, GX2_SQ_SEL_Y, GX2_SQ_SEL_Z, GX2_SQ_SEL_W);
+    GX2InitTextureRegs(&texture->texture);
+
+    // The GPU copies just wrote the surface: make sure the texture cache does not hold older data
+    GX2Invalidate(GX2_INVALIDATE_MODE_TEXTURE, memory, surface->imageSize + surface->mipmapSize);
+
+    gCopied = true;
+}
+
+#else // TEST_WIN
+
+// Bytes of the levels of a texture from first_level to the last
+// (an estimate, since OpenGL does not tell how textures are stored)
+static u32 WindowStreamGetSizeWin(const WindowStreamTexture* texture, u32 first_level)
+{
+    u32 size = 0;
+    for (u32 level = first_level; level < texture->levels; level++)
+        size += WindowStreamGetLevelSize(texture, level);
+
+    return size;
+}
+
+static void WindowStreamUploadWin(const WindowStreamTexture* texture, u32 level, const void* data)
+{
+    u32 internal_format, format, type;
+    WindowTextureFormatGetGL(texture->format, &internal_format, &format, &type);
+
+    u32 width = WindowStreamGetLevelWidth(texture, level);
+    u32 height = WindowStreamGetLevelHeight(texture, level);
+
+    if (WindowTextureFormatIsCompressed(texture->format))
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height, 0, WindowStreamGetLevelSize(texture, level), data);
+    else
+        glTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height, 0, format, type, data);
+}
+
+#endif
+
+// Allocate the memory of a load of the levels of a texture from first_level to its finest resident level
+static bool WindowStreamPrepareLoad(WindowStreamTexture* texture, WindowStreamLoad* load, u32 first_level)
+{
+    load->texture = texture;
+    load->first_level = first_level;
+    load->end_level = texture->resident_level;
+    load->success = false;
+    load->size = 0;
+    load->ms = 0.0;
+
+#ifdef TEST_WIN
+
+    u32 data_size = 0;
+    for (u32 level = first_level; level < load->end_level; level++)
+    {
+        load->offsets[level - first_level] = data_size;
+        data_size += WindowStreamGetLevelSize(texture, level);
+    }
+
+    load->data = (u8*)malloc(data_size);
+    load->new_size = WindowStreamGetSizeWin(texture, first_level);
+    return load->data != NULL;
+
+#else // TEST_GX2
+
+    load->staging_memory = NULL;
+    load->memory = NULL;
+
+    // Linear staging surfaces, one after the other
+    u32 staging_size = 0, staging_alignment = 1;
+    for (u32 level = first_level; level < load->end_level; level++)
+    {
+        GX2Surface* staging = &load->staging[level - first_level];
+        WindowStreamInitSurface(staging, texture, level, 1, GX2_TILE_MODE_LINEAR_ALIGNED);
+
+        staging_size = (staging_size + staging->alignment - 1) & ~(staging->alignment - 1);
+        staging->image = (void*)(uintptr_t)staging_size;
+        staging_size += staging->imageSize;
+
+        if (staging->alignment > staging_alignment)
+            staging_alignment = staging->alignment;
+    }
+
+    load->staging_memory = MEMAllocFromDefaultHeapEx(staging_size, staging_alignment);
+    load->staging_size = staging_size;
+    if (!load->staging_memory)
+        return false;
+
+    for (u32 level = first_level; level < load->end_level; level++)
+    {
+        GX2Surface* staging = &load->staging[level - first_level];
+        staging->image = (u8*)load->staging_memory + (uintptr_t)staging->image;
+    }
+
+    if (!WindowStreamAllocSurface(texture, first_level, &load->surface, &load->memory))
+    {
+        MEMFreeToDefaultHeap(load->staging_memory);
+        load->staging_memory = NULL;
+        return false;
+    }
+
+    load->new_size = load->surface.imageSize + load->surface.mipmapSize;
+    return true;
+
+#endif
+}
+
+// Free the memory of a load that was not placed into its texture
+static void WindowStreamDiscardLoad(WindowStreamLoad* load)
+{
+#ifdef TEST_WIN
+    free(load->data);
+    load->data = NULL;
+#else
+    if (load->staging_memory)
+        MEMFreeToDefaultHeap(load->staging_memory);
+    if (load->memory)
+        MEMFreeToDefaultHeap(load->memory);
+    load->staging_memory = NULL;
+    load->memory = NULL;
+#endif
+}
+
+// Read the levels of a load (on the loader thread, or on the calling thread for mip tails)
+static void WindowStreamRead(WindowStreamLoad* load, WindowStreamScratch* scratch)
+{
+    TraceBegin("WindowStreamRead");
+    f64 start_time = WindowGetTime();
+
+    const WindowStreamTexture* texture = load->texture;
+    load->success = true;
+
+    for (u32 level = load->first_level; level < load->end_level && load->success; level++)
+    {
+        u32 size = WindowStreamGetLevelSize(texture, level);
+
+#ifdef TEST_WIN
+
+        (void)scratch;
+
+        load->success = texture->read(texture->user_data, level, load->data + load->offsets[level - load->first_level], size);
+
+#else // TEST_GX2
+
+        GX2Surface* staging = &load->staging[level - load->first_level];
+
+        // Rows of the staging surface are aligned to its pitch (in pixels, or blocks if compressed)
+        u32 row_size = WindowTextureFormatGetLevelSize(texture->format, WindowStreamGetLevelWidth(texture, level), 1);
+        u32 pitch_size = staging->pitch * WindowTextureFormatGetElementSize(texture->format);
+
+        if (row_size == pitch_size)
+            load->success = texture->read(texture->user_data, level, staging->image, size);
+        else
+        {
+            if (scratch->size < size)
+            {
+                WindowStreamFreeScratch(scratch);
+                scratch->data = MEMAllocFromDefaultHeapEx(size, 64);
+                scratch->size = scratch->data ? size : 0;
+            }
+
+            load->success = scratch->data && texture->read(texture->user_data, level, scratch->data, size);
+
+            for (u32 row = 0; load->success && row < size / row_size; row++)
+                memcpy((u8*)staging->image + row * pitch_size, (const u8*)scratch->data + row * row_size, row_size);
+        }
+
+        // The GPU reads the staging surface from memory
+        DCFlushRange(staging->image, staging->imageSize);
+
+#endif
+
+        load->size += size;
+    }
+
+    load->ms = (WindowGetTime() - start_time) * 1000.0;
+    TraceEnd();
+}
+
+// Place the levels of a load into its texture (on the thread owning the window context)
+static void WindowStreamPlace(WindowStreamLoad* load)
+{
+    WindowStreamTexture* texture = load->texture;
+
+#ifdef TEST_WIN
+
+    glBindTexture(GL_TEXTURE_2D, texture->texture);
+    for (u32 level = load->first_level; level < load->end_level; level++)
+        WindowStreamUploadWin(texture, level, load->data + load->offsets[level - load->first_level]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, load->first_level);
+    glBindTexture(GL_TEXTURE_2D, GL_NONE);
+
+    free(load->data);
+    load->data = NULL;
+
+#else // TEST_GX2
+
+    // The texture cache may hold older data from where the staging surfaces are
+    GX2Invalidate(GX2_INVALIDATE_MODE_TEXTURE, load->staging_memory, load->staging_size);
+
+    // New levels from the staging surfaces, then the levels already resident from the current surface
+    for (u32 level = load->first_level; level < load->end_level; level++)
+        GX2CopySurface(&load->staging[level - load->first_level], 0, 0, &load->surface, level - load->first_level, 0);
+
+    if (texture->memory)
+    {
+        for (u32 level = load->end_level; level < texture->levels; level++)
+            GX2CopySurface(&texture->texture.surface, level - texture->resident_level, 0, &load->surface, level - load->first_level, 0);
+    }
+
+    WindowStreamSetSurface(texture, &load->surface, load->memory);
+    WindowStreamRetire(load->staging_memory);
+    load->memory = NULL;
+    load->staging_memory = NULL;
+
+#endif
+
+    gStats.resident_bytes += load->new_size - texture->resident_size;
+    gStats.uploaded_bytes += load->size;
+
+    texture->resident_level = load->first_level;
+    texture->resident_size = load->new_size;
+}
+
+// Evict the finest resident level of a texture
+static bool WindowStreamEvict(WindowStreamTexture* texture)
+{
+    u32 first_level = texture->resident_level + 1;
+
+#ifdef TEST_WIN
+
+    u32 internal_format, format, type;
+    WindowTextureFormatGetGL(texture->format, &internal_format, &format, &type);
+
+    // Hide the level, then give its memory back by making it empty
+    glBindTexture(GL_TEXTURE_2D, texture->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first_level);
+    if (WindowTextureFormatIsCompressed(texture->format))
+        glCompressedTexImage2D(GL_TEXTURE_2D, texture->resident_level, internal_format, 0, 0, 0, 0, NULL);
+    else
+        glTexImage2D(GL_TEXTURE_2D, texture->resident_level, internal_format, 0, 0, 0, format, type, NULL);
+    glBindTexture(GL_TEXTURE_2D, GL_NONE);
+
+    u32 new_size = WindowStreamGetSizeWin(texture, first_level);
+
+#else // TEST_GX2
+
+    // Copy the levels that stay resident into a smaller surface
+    GX2Surface surface;
+    void* memory;
+    if (!WindowStreamAllocSurface(texture, first_level, &surface, &memory))
+        return false;
+
+    for (u32 level = first_level; level < texture->levels; level++)
+        GX2CopySurface(&texture->texture.surface, level - texture->resident_level, 0, &surface, level - first_level, 0);
+
+    WindowStreamSetSurface(texture, &surface, memory);
+
+    u32 new_size = surface.imageSize + surface.mipmapSize;
+
+#endif
+
+    gStats.resident_bytes -= texture->resident_size - new_size;
+    gStats.evictions++;
+
+    texture->resident_level = first_level;
+    texture->resident_size = new_size;
+    return true;
+}
+
+// Find the texture to evict a level of, to make room for a load of requester (NULL if over budget)
+// Levels finer than their texture needs go first, then levels of the least recently used textures;
+// levels needed by textures used in this frame are never evicted
+static WindowStreamTexture* WindowStreamFindVictim(const WindowStreamTexture* requester)
+{
+    WindowStreamTexture* victim = NULL;
+    bool victim_surplus = false;
+
+    for (WindowStreamTexture* texture = gTextures; texture; texture = texture->next)
+    {
+        if (texture == requester || texture->load || texture->resident_level >= texture->tail_level)
+            continue;
+
+        bool surplus = texture->resident_level < texture->wanted_level;
+        if (!surplus)
+        {
+            if (texture->last_used_frame == gFrame)
+                continue;
+            if (requester && texture->last_used_frame >= requester->last_used_frame)
+                continue;
+        }
+
+        if (!victim || (surplus && !victim_surplus)
+            || (surplus == victim_surplus && texture->last_used_frame < victim->last_used_frame))
+        {
+            victim = texture;
+            victim_surplus = surplus;
+        }
+    }
+
+    return victim;
+}
+
+// Queue a load of the levels a texture needs, or of as many of them as the budget allows
+static bool WindowStreamQueue(WindowStreamTexture* texture, WindowStreamLoad* load)
+{
+    u32 first_level = texture->wanted_level;
+    for (; first_level < texture->resident_level; first_level++)
+    {
+        u32 size = WindowStreamGetLevelSize(texture, first_level);
+        for (u32 level = first_level + 1; level < texture->resident_level; level++)
+            size += WindowStreamGetLevelSize(texture, level);
+
+        // Make room by evicting levels of less recently used textures
+        while (gStats.resident_bytes + gStats.loading_bytes + size > gStats.budget)
+        {
+            WindowStreamTexture* victim = WindowStreamFindVictim(texture);
+            if (!victim || !WindowStreamEvict(victim))
+                break;
+        }
+
+        if (gStats.resident_bytes + gStats.loading_bytes + size <= gStats.budget)
+            break;
+    }
+
+    if (first_level >= texture->resident_level || !WindowStreamPrepareLoad(texture, load, first_level))
+        return false;
+
+    texture->load = load;
+    gStats.loading_bytes += load->new_size - texture->resident_size;
+
+    load->sequence = gNextSequence++;
+
+#ifdef TEST_WIN
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        load->state.store(WINDOW_STREAM_LOAD_QUEUED, std::memory_order_release);
+    }
+    gCondition.notify_one();
+#else
+    load->state.store(WINDOW_STREAM_LOAD_QUEUED, std::memory_order_release);
+    OSSignalEvent(&gLoaderEvent);
+#endif
+
+    return true;
+}
+
+// Give back the memory reserved for a load, and detach it from its texture
+// (before the load is placed, since placing it changes the size of the texture)
+static void WindowStreamDetachLoad(WindowStreamLoad* load)
+{
+    WindowStreamTexture* texture = load->texture;
+
+    gStats.loading_bytes -= load->new_size - texture->resident_size;
+    texture->load = NULL;
+}
+
+static WindowStreamLoad* WindowStreamGetNextQueued()
+{
+    WindowStreamLoad* next = NULL;
+    for (u32 i = 0; i < WINDOW_STREAM_MAX_LOADS; i++)
+    {
+        WindowStreamLoad* load = &gLoads[i];
+        if (load->state.load(std::memory_order_acquire) == WINDOW_STREAM_LOAD_QUEUED
+            && (!next || (s32)(load->sequence - next->sequence) < 0))
+            next = load;
+    }
+
+    return next;
+}
+
+// Returns NULL once streaming is stopping
+static WindowStreamLoad* WindowStreamWaitForLoad()
+{
+#ifdef TEST_WIN
+    std::unique_lock<std::mutex> lock(gMutex);
+
+    WindowStreamLoad* load = NULL;
+    gCondition.wait(lock, [&load] { return gQuit.load() || (load = WindowStreamGetNextQueued()) != NULL; });
+
+    return gQuit.load() ? NULL : load;
+#else
+    for (;;)
+    {
+        if (gQuit.load())
+            return NULL;
+
+        WindowStreamLoad* load = WindowStreamGetNextQueued();
+        if (load)
+            return load;
+
+        OSWaitEvent(&gLoaderEvent);
+    }
+#endif
+}
+
+static void WindowStreamLoaderLoop()
+{
+    TraceSetThreadName("Texture loader");
+
+    WindowStreamScratch scratch = { NULL, 0 };
+
+    while (WindowStreamLoad* load = WindowStreamWaitForLoad())
+    {
+        WindowStreamRead(load, &scratch);
+        load->state.store(WINDOW_STREAM_LOAD_DONE, std::memory_order_release);
+    }
+
+    WindowStreamFreeScratch(&scratch);
+}
+
+#ifdef TEST_GX2
+
+static int WindowStreamLoaderMain(int argc, const char** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    WindowStreamLoaderLoop();
+    return 0;
+}
+
+#endif
+
+bool WindowStreamInit(u32 budget)
+{
+    if (gRunning)
+        return false;
+
+    memset(&gStats, 0, sizeof(gStats));
+    gStats.budget = budget;
+    gQuit.store(false);
+
+    for (u32 i = 0; i < WINDOW_STREAM_MAX_LOADS; i++)
+    {
+        gLoads[i].texture = NULL;
+        gLoads[i].state.store(WINDOW_STREAM_LOAD_FREE);
+    }
+
+#ifdef TEST_WIN
+
+    gLoaderThread = std::thread(WindowStreamLoaderLoop);
+
+#else // TEST_GX2
+
+    OSInitEvent(&gLoaderEvent, FALSE, OS_EVENT_MODE_AUTO);
+
+    // OSThread instances must be 8-byte aligned, stacks 16-byte aligned
+    gLoaderThread = (OSThread*)MEMAllocFromDefaultHeapEx(sizeof(OSThread), 8);
+    gLoaderStack = MEMAllocFromDefaultHeapEx(WINDOW_STREAM_LOADER_STACK_SIZE, 16);
+
+    // Below the priority of the main thread (16), on any core
+    if (!gLoaderThread || !gLoaderStack
+        || !OSCreateThread(gLoaderThread, WindowStreamLoaderMain, 0, NULL,
+                           (u8*)gLoaderStack + WINDOW_STREAM_LOADER_STACK_SIZE, WINDOW_STREAM_LOADER_STACK_SIZE,
+                           20, OS_THREAD_ATTRIB_AFFINITY_ANY))
+    {
+        if (gLoaderThread)
+            MEMFreeToDefaultHeap(gLoaderThread);
+        if (gLoaderStack)
+            MEMFreeToDefaultHeap(gLoaderStack);
+        gLoaderThread = NULL;
+        gLoaderStack = NULL;
+        return false;
+    }
+
+    OSResumeThread(gLoaderThread);
+
+#endif
+
+    gRunning = true;
+    return true;
+}
+
+void WindowStreamSetBudget(u32 budget)
+{
+    gStats.budget = budget;
+}
+
+WindowStreamTexture* WindowStreamCreateTexture(const WindowStreamTextureDesc* desc)
+{
+    if (!gRunning || desc->width == 0 || desc->height == 0 || !WindowIsTextureFormatSupported(desc->format) || !desc->read)
+        return NULL;
+
+    u32 largest = desc->width > desc->height ? desc->width : desc->height;
+    u32 max_levels = 1;
+    while ((largest >> max_levels) != 0)
+        max_levels++;
+
+    if (max_levels > WINDOW_STREAM_MAX_LEVELS)
+        return NULL;
+
+    WindowStreamTexture* texture = (WindowStreamTexture*)calloc(1, sizeof(WindowStreamTexture));
+    if (!texture)
+        return NULL;
+
+    texture->width = desc->width;
+    texture->height = desc->height;
+    texture->levels = desc->levels == 0 || desc->levels > max_levels ? max_levels : desc->levels;
+    texture->format = desc->format;
+    texture->read = desc->read;
+    texture->user_data = desc->user_data;
+
+    texture->tail_level = 0;
+    while (texture->tail_level < texture->levels - 1 && (largest >> texture->tail_level) > WINDOW_STREAM_TAIL_SIZE)
+        texture->tail_level++;
+
+    texture->resident_level = texture->levels;
+    texture->wanted_level = texture->tail_level;
+    texture->last_used_frame = gFrame;
+
+#ifdef TEST_WIN
+
+    glGenTextures(1, &texture->texture);
+    glBindTexture(GL_TEXTURE_2D, texture->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture->levels - 1);
+    glBindTexture(GL_TEXTURE_2D, GL_NONE);
+
+#else // TEST_GX2
+
+    static u32 next_swizzle = 0;
+    texture->swizzle = next_swizzle++ & 7;
+
+    GX2InitSampler(&texture->sampler, GX2_TEX_CLAMP_MODE_WRAP, GX2_TEX_XY_FILTER_MODE_LINEAR);
+    GX2InitSamplerZMFilter(&texture->sampler, GX2_TEX_Z_FILTER_MODE_LINEAR, GX2_TEX_MIP_FILTER_MODE_LINEAR);
+
+#endif
+
+    // Read the mip tail right away, so that the texture can be used from now on
+    WindowStreamLoad load;
+    bool success = WindowStreamPrepareLoad(texture, &load, texture->tail_level);
+    if (success)
+    {
+        WindowStreamRead(&load, &gMainScratch);
+        success = load.success;
+    }
+
+    if (!success)
+    {
+        WindowStreamDiscardLoad(&load);
+#ifdef TEST_WIN
+        glDeleteTextures(1, &texture->texture);
+#endif
+        free(texture);
+        return NULL;
+    }
+
+    WindowStreamPlace(&load);
+
+    texture->tail_size = texture->resident_size;
+    gStats.tail_bytes += texture->tail_size;
+    gStats.num_textures++;
+
+    texture->next = gTextures;
+    gTextures = texture;
+    return texture;
+}
+
+void WindowStreamDestroyTexture(WindowStreamTexture* texture)
+{
+    if (!texture)
+        return;
+
+    WindowStreamLoad* load = texture->load;
+    if (load)
+    {
+        // The loader thread may be writing into the memory of the load
+        while (load->state.load(std::memory_order_acquire) != WINDOW_STREAM_LOAD_DONE)
+        {
+#ifdef TEST_WIN
+            std::this_thread::yield();
+#else
+            OSYieldThread();
+#endif
+        }
+
+        WindowStreamDetachLoad(load);
+        WindowStreamDiscardLoad(load);
+        load->texture = NULL;
+        load->state.store(WINDOW_STREAM_LOAD_FREE, std::memory_order_relaxed);
+    }
+
+    WindowStreamTexture** link = &gTextures;
+    while (*link != texture)
+        link = &(*link)->next;
+    *link = texture->next;
+
+    gStats.resident_bytes -= texture->resident_size;
+    gStats.tail_bytes -= texture->tail_size;
+    gStats.num_textures--;
+
+#ifdef TEST_WIN
+    glDeleteTextures(1, &texture->texture);
+#else
+    WindowStreamRetire(texture->memory);
+#endif
+
+    free(texture);
+}
+
+void WindowStreamRequest(WindowStreamTexture* texture, u32 level)
+{
+    if (level > texture->tail_level)
+        level = texture->tail_level;
+
+    // Several draws may use the texture in the same frame: keep the finest level
+    if (texture->last_used_frame != gFrame || level < texture->wanted_level)
+        texture->wanted_level = level;
+
+    texture->last_used_frame = gFrame;
+}
+
+u32 WindowStreamGetLevelForSize(const WindowStreamTexture* texture, u32 screen_size)
+{
+    u32 largest = texture->width > texture->height ? texture->width : texture->height;
+
+    u32 level = 0;
+    while (level < texture->tail_level && (largest >> (level + 1)) >= screen_size)
+        level++;
+
+    return level;
+}
+
+u32 WindowStreamGetResidentLevel(const WindowStreamTexture* texture)
+{
+    return texture->resident_level;
+}
+
+void WindowStreamUpdate()
+{
+    TraceBegin("WindowStreamUpdate");
+
+#ifdef TEST_GX2
+    WindowStreamFreeRetired();
+#endif
+
+    // Place the loads the loader thread is done with
+    f64 start_time = WindowGetTime();
+
+    for (u32 i = 0; i < WINDOW_STREAM_MAX_LOADS; i++)
+    {
+        WindowStreamLoad* load = &gLoads[i];
+        if (load->state.load(std::memory_order_acquire) != WINDOW_STREAM_LOAD_DONE)
+            continue;
+
+        gStats.loaded_bytes += load->size;
+        gStats.load_ms += load->ms;
+
+        WindowStreamDetachLoad(load);
+        if (load->success)
+        {
+            WindowStreamPlace(load);
+            gStats.loads++;
+        }
+        else
+        {
+            WindowStreamDiscardLoad(load);
+            gStats.failed_loads++;
+        }
+
+        load->texture = NULL;
+        load->state.store(WINDOW_STREAM_LOAD_FREE, std::memory_order_relaxed);
+    }
+
+    gStats.upload_ms += (WindowGetTime() - start_time) * 1000.0;
+
+    // The budget may have been lowered
+    while (gStats.resident_bytes + gStats.loading_bytes > gStats.budget)
+    {
+        WindowStreamTexture* victim = WindowStreamFindVictim(NULL);
+        if (!victim || !WindowStreamEvict(victim))
+            break;
+    }
+
+    // Queue loads for the textures used in this frame, those missing the most levels first
+    for (u32 i = 0; i < WINDOW_STREAM_MAX_LOADS; i++)
+    {
+        WindowStreamLoad* load = &gLoads[i];
+        if (load->state.load(std::memory_order_relaxed) != WINDOW_STREAM_LOAD_FREE)
+            continue;
+
+        for (;;)
+        {
+            WindowStreamTexture* next = NULL;
+            for (WindowStreamTexture* texture = gTextures; texture; texture = texture->next)
+            {
+                if (texture->load || texture->last_used_frame != gFrame || texture->skipped_frame == gFrame
+                    || texture->wanted_level >= texture->resident_level)
+                    continue;
+
+                if (!next || texture->resident_level - texture->wanted_level > next->resident_level - next->wanted_level)
+                    next = texture;
+            }
+
+            if (!next || WindowStreamQueue(next, load))
+                break;
+
+            // Not enough memory for it in this frame
+            next->skipped_frame = gFrame;
+        }
+    }
+
+    gStats.missing_levels = 0;
+    for (WindowStreamTexture* texture = gTextures; texture; texture = texture->next)
+    {
+        if (texture->last_used_frame == gFrame && texture->wanted_level < texture->resident_level)
+            gStats.missing_levels += texture->resident_level - texture->wanted_level;
+    }
+
+#ifdef TEST_GX2
+    // Fence the memory retired so far, and put back the state the GPU copies changed
+    if (gCopied)
+    {
+        GX2Flush();
+        OSTime fence = GX2GetLastSubmittedTimeStamp();
+        for (u32 i = 0; i < gNumRetired; i++)
+        {
+            if (gRetiredFences[i] == 0)
+                gRetiredFences[i] = fence;
+        }
+
+        WindowMakeContextCurrent();
+        gCopied = false;
+    }
+#endif
+
+    gFrame++;
+    TraceEnd();
+}
+
+void WindowStreamBindTexture(WindowStreamTexture* texture, u32 unit)
+{
+    texture->last_used_frame = gFrame;
+
+#ifdef TEST_WIN
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture->texture);
+#else
+    GX2SetPixelTexture(&texture->texture, unit);
+    GX2SetPixelSampler(&texture->sampler, unit);
+#endif
+}
+
+void WindowStreamGetStats(WindowStreamStats* pStats)
+{
+    *pStats = gStats;
+
+    pStats->pending_loads = 0;
+    for (u32 i = 0; i < WINDOW_STREAM_MAX_LOADS; i++)
+    {
+        if (gLoads[i].state.load(std::memory_order_relaxed) != WINDOW_STREAM_LOAD_FREE)
+            pStats->pending_loads++;
+    }
+
+    pStats->load_mb_per_s = gStats.load_ms > 0.0 ? (f64)gStats.loaded_bytes / (1024.0 * 1024.0) / (gStats.load_ms / 1000.0) : 0.0;
+}
+
+void WindowStreamExit()
+{
+    if (!gRunning)
+        return;
+
+#ifdef TEST_WIN
+
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        gQuit.store(true);
+    }
+    gCondition.notify_one();
+    gLoaderThread.join();
+
+#else // TEST_GX2
+
+    gQuit.store(true);
+    OSSignalEvent(&gLoaderEvent);
+    OSJoinThread(gLoaderThread, NULL);
+
+    MEMFreeToDefaultHeap(gLoaderThread);
+    MEMFreeToDefaultHeap(gLoaderStack);
+    gLoaderThread = NULL;
+    gLoaderStack = NULL;
+
+    // Free everything retired
+    GX2DrawDone();
+    for (u32 i = 0; i < gNumRetired; i++)
+        MEMFreeToDefaultHeap(gRetired[i]);
+    gNumRetired = 0;
+
+#endif
+
+    WindowStreamFreeScratch(&gMainScratch);
+    gRunning = false;
+}
@@ -0,0 +1,134 @@
+// Texture streaming
+// Textures are created with only their mip tail (their smallest levels) resident, and their finer
+// levels are loaded on demand by a background loader thread, within a memory budget: when the budget
+// is full, the finest levels of the least recently used textures are evicted to make room
+// Texture data is read through a callback (e.g. from a file), one level at a time, as tightly packed
+// rows of pixels (or of 4x4 blocks for compressed formats)
+// - Wii U: the loader reads each level into a linear staging surface, which the GPU then copies into
+//          the tiled surface of the texture (GX2CopySurface), so that the tile mode, alignment and
+//          swizzle chosen for the texture are respected. The resident levels of a texture form one
+//          surface: changing them allocates a new surface and copies the levels that stay resident
+//          into it. Texture memory is taken from MEM2
+// - PC: the loader reads the levels into memory, and they are uploaded with glTexImage2D by the thread
+//       owning the context; the base level of the texture hides the levels that are not resident
+
+#ifndef TEXTURE_STREAM_H_
+#define TEXTURE_STREAM_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Most levels a texture can have (8192x8192)
+#define WINDOW_STREAM_MAX_LEVELS 14
+
+// Levels this size and smaller (in both dimensions) form the mip tail, which is always resident
+#define WINDOW_STREAM_TAIL_SIZE 64
+
+// Function reading the data of a texture level, called on the loader thread
+// (and on the calling thread of WindowStreamCreateTexture for the mip tail)
+// Parameters:
+// - user_data: Pointer given in the texture description
+// - level: Level to read (0 is the full size level)
+// - dst: Where to write the level, with tightly packed rows
+// - size: Size of the level in bytes
+// Returns false if the level could not be read
+typedef bool (*WindowStreamReadFunc)(void* user_data, u32 level, void* dst, u32 size);
+
+// Description of a streamed texture
+typedef struct WindowStreamTextureDesc
+{
+    u32 width;                  // Size of level 0
+    u32 height;
+    u32 levels;                 // Number of levels (0 for the full chain, down to 1x1)
+    WindowTextureFormat format;
+    WindowStreamReadFunc read;  // Reads the data of a level
+    void* user_data;            // Passed to read
+} WindowStreamTextureDesc;
+
+typedef struct WindowStreamTexture WindowStreamTexture;
+
+// Texture streaming statistics
+typedef struct WindowStreamStats
+{
+    u32 num_textures;           // Textures created
+    u32 budget;                 // Bytes the textures may use
+    u32 resident_bytes;         // Bytes used by the resident levels of all textures (mip tails included)
+    u32 tail_bytes;             // Bytes used by the mip tails alone
+    u32 loading_bytes;          // Bytes reserved for the loads in progress
+    u32 pending_loads;          // Loads queued or in progress
+    u32 missing_levels;         // Levels requested but not resident, over all textures (at the last update)
+    u32 loads;                  // Loads completed
+    u32 failed_loads;           // Loads that could not read their levels
+    u32 evictions;              // Levels evicted
+    u64 loaded_bytes;           // Bytes read by the loader thread
+    f64 load_ms;                // Time the loader thread spent reading levels
+    f64 load_mb_per_s;          // Loader bandwidth (loaded_bytes over load_ms)
+    u64 uploaded_bytes;         // Bytes copied into textures, by the GPU (Wii U) or by OpenGL (PC)
+    f64 upload_ms;              // Time the window thread spent placing loaded levels into textures
+} WindowStreamStats;
+
+// Start the loader thread
+// Parameters:
+// - budget: Bytes the textures may use (mip tails are always resident, even past the budget)
+// Returns false if streaming has already started or the thread could not be created
+bool WindowStreamInit(u32 budget);
+
+// Change the memory budget (levels are evicted by the next WindowStreamUpdate if it is exceeded)
+void WindowStreamSetBudget(u32 budget);
+
+// Create a texture, and read its mip tail on the calling thread
+// Must be called from the thread owning the window context, outside of rendering (on Wii U, the GPU
+// copies reset the render targets to the window buffers like a clear does)
+// Returns NULL if the description is invalid, the format is not supported (see
+// WindowIsTextureFormatSupported), or the mip tail could not be allocated or read
+WindowStreamTexture* WindowStreamCreateTexture(const WindowStreamTextureDesc* desc);
+
+// Destroy a texture (waits for its load if one is in progress)
+// Must be called from the thread owning the window context
+void WindowStreamDestroyTexture(WindowStreamTexture* texture);
+
+// Ask for a level of a texture to be resident, and mark the texture as used in this frame
+// The finest resident level is used until it is loaded
+// Parameters:
+// - texture: Texture
+// - level: Finest level needed (levels past the mip tail are clamped to it)
+void WindowStreamRequest(WindowStreamTexture* texture, u32 level);
+
+// Get the finest level needed to draw a texture covering a number of pixels on screen
+// Parameters:
+// - texture: Texture
+// - screen_size: Size of the texture on screen, in pixels (along its largest dimension)
+u32 WindowStreamGetLevelForSize(const WindowStreamTexture* texture, u32 screen_size);
+
+// Get the finest resident level of a texture
+u32 WindowStreamGetResidentLevel(const WindowStreamTexture* texture);
+
+// Place the levels loaded since the last update into their textures, evict least recently used
+// levels if the budget is exceeded, and queue the loads of the levels requested in this frame
+// Call it once per frame, from the thread owning the window context, before rendering
+// On Wii U, the GPU copies reset the render targets to the window buffers like a clear does
+void WindowStreamUpdate();
+
+// Bind a texture and its sampler (trilinear filtering, repeat) to a texture unit, and mark the
+// texture as used in this frame
+// Parameters:
+// - texture: Texture
+// - unit: Texture unit (pixel shader sampler on Wii U)
+void WindowStreamBindTexture(WindowStreamTexture* texture, u32 unit);
+
+// Get texture streaming statistics
+void WindowStreamGetStats(WindowStreamStats* pStats);
+
+// Stop the loader thread
+// All textures must have been destroyed
+void WindowStreamExit();
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // TEXTURE_STREAM_H_
@@ -0,0 +1,559 @@
+// CPU trace recorder
+
+#include "trace.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <chrono>
+#include <thread>
+
+// On x86, timestamps are read from the time stamp counter, which costs about half as much as
+// steady_clock (the counter runs at a constant rate on every processor of the last decade)
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TRACE_USE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Time spent measuring the rate of the time stamp counter in TraceInit, in milliseconds
+#define TRACE_CALIBRATION_MS 10
+
+static std::thread gWriterThread;
+
+#else // TEST_GX2
+
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+
+// Stack size of the writer thread
+#define TRACE_WRITER_STACK_SIZE 0x8000
+
+static OSThread* gWriterThread = NULL;
+static void* gWriterStack = NULL;
+
+#endif
+
+// Time between two drains of the rings by the writer thread, in milliseconds
+#define TRACE_WRITE_INTERVAL_MS 50
+
+// Index mask of the ring buffers
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+static_assert((TRACE_RING_SIZE & TRACE_RING_MASK) == 0, "TRACE_RING_SIZE must be a power of two");
+
+// Longest thread name, including the terminating null character
+#define TRACE_THREAD_NAME_SIZE 32
+
+// A scope that has ended
+struct TraceEvent
+{
+    const char* name;
+    u64 start;                  // Timestamps (see TraceGetTimestamp)
+    u64 end;
+};
+
+// States of a thread's ring
+enum TraceThreadState
+{
+    TRACE_THREAD_FREE,          // Not owned by any thread
+    TRACE_THREAD_OWNED,         // Owned by a running thread
+    TRACE_THREAD_RETIRED        // Its thread has ended; becomes free once the writer has drained it
+};
+
+struct TraceThread
+{
+    // Written by the owning thread only
+    TraceEvent events[TRACE_RING_SIZE];
+    std::atomic<u32> head;      // Number of scopes recorded (wraps around)
+    std::atomic<u32> dropped;   // Number of scopes dropped because the ring was full
+    u32 tid;                    // Thread id in the trace
+    std::atomic<u32> name_version;
+    char name[TRACE_THREAD_NAME_SIZE];
+
+    // Open scopes
+    const char* open_names[TRACE_MAX_DEPTH];
+    u64 open_starts[TRACE_MAX_DEPTH];
+    u32 depth;
+    u32 ignored_depth;          // Scopes opened past the deepest nesting
+
+    // Written by the writer thread only
+    std::atomic<u32> tail;      // Number of scopes written (wraps around)
+    u32 written_name_version;
+
+    std::atomic<u32> state;
+};
+
+static std::atomic<bool> gEnabled(false);
+static std::atomic<bool> gQuit(false);
+
+// Rings, allocated the first time they are claimed and kept until the program ends
+// (A thread may still be inside TraceBegin/TraceEnd when recording stops)
+static std::atomic<TraceThread*> gThreads[TRACE_MAX_THREADS];
+static std::atomic<u32> gNextTid(0);
+
+// Trace file, only accessed by the writer thread (and by TraceInit/TraceExit when it is not running)
+static FILE* gFile = NULL;
+static u32 gNumWritten = 0;     // Number of JSON objects written so far
+static u64 gStartTime = 0;
+static f64 gTicksPerUs = 1.0;   // Rate of the timestamps
+
+static inline u64 TraceGetTimestamp()
+{
+#if defined(TEST_WIN) && defined(TRACE_USE_TSC)
+    return (u64)__rdtsc();
+#elif defined(TEST_WIN)
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+#else
+    return (u64)OSGetSystemTime();
+#endif
+}
+
+// Get the number of timestamp ticks per microsecond
+static f64 TraceGetTicksPerUs()
+{
+#if defined(TEST_WIN) && defined(TRACE_USE_TSC)
+    // The rate of the time stamp counter is not reported, so it is measured against steady_clock
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    u64 start_ticks = TraceGetTimestamp();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_CALIBRATION_MS));
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    u64 end_ticks = TraceGetTimestamp();
+
+    return (f64)(end_ticks - start_ticks) / std::chrono::duration<f64, std::micro>(end - start).count();
+#elif defined(TEST_WIN)
+    return 1e3;
+#else
+    return OSTimerClockSpeed * 1e-6;
+#endif
+}
+
+// Convert a timestamp to microseconds since TraceInit
+static f64 TraceTimestampToUs(u64 timestamp)
+{
+    return (f64)(s64)(timestamp - gStartTime) / gTicksPerUs;
+}
+
+// Get the ring at an index, allocating it the first time
+static TraceThread* TraceGetRing(u32 index)
+{
+    TraceThread* thread = gThreads[index].load(std::memory_order_acquire);
+    if (thread)
+        return thread;
+
+    // Zero-initialized, which is a valid state for all members
+    TraceThread* new_thread = (TraceThread*)calloc(1, sizeof(TraceThread));
+    if (!new_thread)
+        return NULL;
+
+    if (gThreads[index].compare_exchange_strong(thread, new_thread, std::memory_order_acq_rel))
+        return new_thread;
+
+    // Another thread allocated it first
+    free(new_thread);
+    return thread;
+}
+
+// Hand a ring over to the calling thread
+// (The scopes of its previous owner have all been written, or the ring is new)
+static void TraceResetRing(TraceThread* thread)
+{
+    thread->depth = 0;
+    thread->ignored_depth = 0;
+    thread->tid = gNextTid.fetch_add(1, std::memory_order_relaxed);
+    thread->name[0] = '\0';
+    thread->name_version.fetch_add(1, std::memory_order_release);
+    thread->state.store(TRACE_THREAD_OWNED, std::memory_order_release);
+}
+
+#ifdef TEST_WIN
+
+// Ring of the calling thread, handed back when the thread ends
+struct TraceThreadSlot
+{
+    TraceThread* thread = NULL;
+    bool claimed = false;
+
+    ~TraceThreadSlot()
+    {
+        if (thread)
+            thread->state.store(TRACE_THREAD_RETIRED, std::memory_order_release);
+    }
+};
+
+static thread_local TraceThreadSlot tThreadSlot;
+
+// Get the ring of the calling thread, claiming a free one the first time if claim is true
+static inline TraceThread* TraceGetThread(bool claim)
+{
+    TraceThreadSlot& slot = tThreadSlot;
+    if (slot.claimed || !claim)
+        return slot.thread;
+
+    slot.claimed = true;
+    for (u32 i = 0; i < TRACE_MAX_THREADS; i++)
+    {
+        TraceThread* thread = TraceGetRing(i);
+        if (!thread)
+            break;
+
+        u32 state = TRACE_THREAD_FREE;
+        if (thread->state.compare_exchange_strong(state, TRACE_THREAD_OWNED, std::memory_order_acq_rel))
+        {
+            TraceResetRing(thread);
+            slot.thread = thread;
+            break;
+        }
+    }
+
+    return slot.thread;
+}
+
+#else // TEST_GX2
+
+// Threads owning each ring, looked up by address
+// (Threads created later at the address of a thread that has ended take over its ring)
+static std::atomic<OSThread*> gThreadKeys[TRACE_MAX_THREADS];
+
+// Thread-specific value caching the ring of each thread, so that it is only looked up once
+// (The last one that applications can use, the others are left to the program)
+#define TRACE_THREAD_SPECIFIC OS_THREAD_SPECIFIC_13
+
+// Look up the ring of the calling thread, claiming a free one if claim is true
+static TraceThread* TraceFindThread(OSThread* self, bool claim)
+{
+    u32 first_index = (u32)((uintptr_t)self >> 6) % TRACE_MAX_THREADS;
+
+    for (u32 i = 0; i < TRACE_MAX_THREADS; i++)
+    {
+        u32 index = (first_index + i) % TRACE_MAX_THREADS;
+
+        OSThread* key = gThreadKeys[index].load(std::memory_order_acquire);
+        if (key == self)
+            return gThreads[index].load(std::memory_order_acquire);
+
+        // A free key: claim it along with the ring at the same index
+        // (Keys are never released, so only this thread can use the ring from now on)
+        if (key == NULL && claim && gThreadKeys[index].compare_exchange_strong(key, self, std::memory_order_acq_rel))
+        {
+            TraceThread* thread = TraceGetRing(index);
+            if (thread)
+                TraceResetRing(thread);
+            return thread;
+        }
+    }
+
+    return NULL;
+}
+
+// Get the ring of the calling thread, claiming a free one the first time if claim is true
+static inline TraceThread* TraceGetThread(bool claim)
+{
+    TraceThread* thread = (TraceThread*)OSGetThreadSpecific(TRACE_THREAD_SPECIFIC);
+    if (thread)
+        return thread;
+
+    thread = TraceFindThread(OSGetCurrentThread(), claim);
+    if (thread)
+        OSSetThreadSpecific(TRACE_THREAD_SPECIFIC, thread);
+
+    return thread;
+}
+
+#endif
+
+void TraceBegin(const char* name)
+{
+    if (!gEnabled.load(std::memory_order_relaxed))
+        return;
+
+    TraceThread* thread = TraceGetThread(true);
+    if (!thread)
+        return;
+
+    if (thread->depth == TRACE_MAX_DEPTH)
+    {
+        thread->ignored_depth++;
+        return;
+    }
+
+    u32 depth = thread->depth++;
+    thread->open_names[depth] = name;
+    thread->open_starts[depth] = TraceGetTimestamp();
+}
+
+void TraceEnd()
+{
+    TraceThread* thread = TraceGetThread(false);
+    if (!thread)
+        return;
+
+    if (thread->ignored_depth > 0)
+    {
+        thread->ignored_depth--;
+        return;
+    }
+
+    if (thread->depth == 0)
+        return;
+
+    u64 end = TraceGetTimestamp();
+    u32 depth = --thread->depth;
+
+    if (!gEnabled.load(std::memory_order_relaxed))
+        return;
+
+    // Only this thread writes head, and only the writer thread writes tail
+    u32 head = thread->head.load(std::memory_order_relaxed);
+    if (head - thread->tail.load(std::memory_order_acquire) == TRACE_RING_SIZE)
+    {
+        thread->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent* event = &thread->events[head & TRACE_RING_MASK];
+    event->name = thread->open_names[depth];
+    event->start = thread->open_starts[depth];
+    event->end = end;
+
+    // Publish the scope to the writer thread
+    thread->head.store(head + 1, std::memory_order_release);
+}
+
+void TraceSetThreadName(const char* name)
+{
+    if (!gEnabled.load(std::memory_order_relaxed))
+        return;
+
+    TraceThread* thread = TraceGetThread(true);
+    if (!thread)
+        return;
+
+    snprintf(thread->name, sizeof(thread->name), "%s", name);
+    thread->name_version.fetch_add(1, std::memory_order_release);
+}
+
+// Write a string as a JSON string
+static void TraceWriteString(const char* str)
+{
+    fputc('"', gFile);
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', gFile);
+
+        // Control characters are not allowed in JSON strings
+        fputc((u8)*str < 0x20 ? ' ' : *str, gFile);
+    }
+    fputc('"', gFile);
+}
+
+static void TraceWriteSeparator()
+{
+    if (gNumWritten++ > 0)
+        fputs(",\n", gFile);
+}
+
+// Write the scopes recorded since the last drain
+static void TraceDrain()
+{
+    for (u32 i = 0; i < TRACE_MAX_THREADS; i++)
+    {
+        TraceThread* thread = gThreads[i].load(std::memory_order_acquire);
+        if (!thread)
+            continue;
+
+        u32 state = thread->state.load(std::memory_order_acquire);
+        if (state == TRACE_THREAD_FREE)
+            continue;
+
+        // Name the thread in the trace ("M" metadata events can appear anywhere in the file)
+        u32 name_version = thread->name_version.load(std::memory_order_acquire);
+        if (name_version != thread->written_name_version && thread->name[0] != '\0')
+        {
+            TraceWriteSeparator();
+            fprintf(gFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", thread->tid);
+            TraceWriteString(thread->name);
+            fputs("}}", gFile);
+            thread->written_name_version = name_version;
+        }
+
+        u32 head = thread->head.load(std::memory_order_acquire);
+        u32 tail = thread->tail.load(std::memory_order_relaxed);
+
+        // Each scope is written as a complete ("X") event
+        for (; tail != head; tail++)
+        {
+            const TraceEvent* event = &thread->events[tail & TRACE_RING_MASK];
+            f64 start = TraceTimestampToUs(event->start);
+            f64 end = TraceTimestampToUs(event->end);
+
+            TraceWriteSeparator();
+            fputs("{\"name\":", gFile);
+            TraceWriteString(event->name);
+            fprintf(gFile, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", thread->tid, start, end - start);
+        }
+
+        // Hand the space back to the thread
+        thread->tail.store(tail, std::memory_order_release);
+
+        // Rings of threads that have ended can be reused once drained
+        if (state == TRACE_THREAD_RETIRED)
+            thread->state.store(TRACE_THREAD_FREE, std::memory_order_release);
+    }
+
+    fflush(gFile);
+}
+
+static void TraceWriterLoop()
+{
+    while (!gQuit.load())
+    {
+#ifdef TEST_WIN
+        std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_WRITE_INTERVAL_MS));
+#else
+        OSSleepTicks(OSMillisecondsToTicks(TRACE_WRITE_INTERVAL_MS));
+#endif
+
+        TraceDrain();
+    }
+}
+
+#ifdef TEST_GX2
+
+static int TraceWriterMain(int argc, const char** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    TraceWriterLoop();
+    return 0;
+}
+
+#endif
+
+bool TraceInit(const char* path)
+{
+    if (gFile)
+        return false;
+
+    gFile = fopen(path, "w");
+    if (!gFile)
+        return false;
+
+    fputs("[\n", gFile);
+    gNumWritten = 0;
+
+    // Scopes left in the rings by a previous recording are skipped
+    for (u32 i = 0; i < TRACE_MAX_THREADS; i++)
+    {
+        TraceThread* thread = gThreads[i].load(std::memory_order_acquire);
+        if (thread)
+        {
+            thread->tail.store(thread->head.load(std::memory_order_acquire), std::memory_order_release);
+            thread->written_name_version = 0;
+        }
+    }
+
+    gTicksPerUs = TraceGetTicksPerUs();
+    gStartTime = TraceGetTimestamp();
+    gQuit.store(false);
+
+#ifdef TEST_WIN
+
+    gWriterThread = std::thread(TraceWriterLoop);
+
+#else // TEST_GX2
+
+    // OSThread instances must be 8-byte aligned, stacks 16-byte aligned
+    gWriterThread = (OSThread*)MEMAllocFromDefaultHeapEx(sizeof(OSThread), 8);
+    gWriterStack = MEMAllocFromDefaultHeapEx(TRACE_WRITER_STACK_SIZE, 16);
+
+    // Low priority (high value) on the last core, where it is least in the way of the game threads
+    if (!gWriterThread || !gWriterStack ||
+        !OSCreateThread(gWriterThread, TraceWriterMain, 0, NULL,
+                        (u8*)gWriterStack + TRACE_WRITER_STACK_SIZE, TRACE_WRITER_STACK_SIZE, 30, OS_THREAD_ATTRIB_AFFINITY_CPU2))
+    {
+        if (gWriterThread)
+            MEMFreeToDefaultHeap(gWriterThread);
+        if (gWriterStack)
+            MEMFreeToDefaultHeap(gWriterStack);
+        gWriterThread = NULL;
+        gWriterStack = NULL;
+
+        fclose(gFile);
+        gFile = NULL;
+        return false;
+    }
+
+    OSSetThreadName(gWriterThread, "Trace writer");
+    OSResumeThread(gWriterThread);
+
+#endif
+
+    gEnabled.store(true);
+    return true;
+}
+
+void TraceGetStats(TraceStats* pStats)
+{
+    memset(pStats, 0, sizeof(TraceStats));
+    pStats->num_threads = gNextTid.load(std::memory_order_relaxed);
+
+    for (u32 i = 0; i < TRACE_MAX_THREADS; i++)
+    {
+        TraceThread* thread = gThreads[i].load(std::memory_order_acquire);
+        if (!thread)
+            continue;
+
+        u32 head = thread->head.load(std::memory_order_relaxed);
+        u32 tail = thread->tail.load(std::memory_order_relaxed);
+        pStats->recorded += head;
+        pStats->written += tail;
+        pStats->dropped += thread->dropped.load(std::memory_order_relaxed);
+    }
+}
+
+void TraceExit()
+{
+    if (!gFile)
+        return;
+
+    gEnabled.store(false);
+    gQuit.store(true);
+
+#ifdef TEST_WIN
+
+    gWriterThread.join();
+
+#else // TEST_GX2
+
+    OSJoinThread(gWriterThread, NULL);
+
+    MEMFreeToDefaultHeap(gWriterThread);
+    MEMFreeToDefaultHeap(gWriterStack);
+    gWriterThread = NULL;
+    gWriterStack = NULL;
+
+#endif
+
+    // Scopes that ended after the last drain
+    TraceDrain();
+
+    fputs("\n]\n", gFile);
+    fclose(gFile);
+    gFile = NULL;
+}
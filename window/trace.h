@@ -0,0 +1,90 @@
+// CPU trace recorder
+// Records when named parts of the program (scopes) start and end on every thread, so that a hitch can be
+// traced back to where the time went. Each thread writes its scopes into its own ring buffer without
+// locking, and a background thread drains the rings into a Chrome trace JSON file, which can be opened
+// in chrome://tracing or https://ui.perfetto.dev
+// (The file is in the JSON array format, which loads even if the program never reached TraceExit)
+// - Wii U: timestamps are OSGetSystemTime ticks, the file is written with the standard C library
+//          (e.g. to "fs:/vol/external01/trace.json" on the SD card)
+// - PC: timestamps are read from the time stamp counter on x86 (its rate is measured against
+//       std::chrono::steady_clock in TraceInit), and come from steady_clock elsewhere
+// Recording a scope costs two clock reads and a few stores (each thread's ring is looked up once and
+// cached), so it can stay enabled in release builds
+// The Window* API (WindowInit, WindowSwapBuffers, command list recording and submission) and the job
+// workers are instrumented
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <test_types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Most threads that can record scopes (further threads are ignored)
+#define TRACE_MAX_THREADS 32
+
+// Deepest nesting of scopes per thread (deeper scopes are ignored)
+#define TRACE_MAX_DEPTH 32
+
+// Number of scopes each thread's ring buffer holds (a power of two)
+// When the writer thread falls behind and a ring is full, new scopes are dropped
+#define TRACE_RING_SIZE 8192
+
+// Statistics of the recorder
+typedef struct TraceStats
+{
+    u32 num_threads;            // Threads that have recorded scopes
+    u64 recorded;               // Scopes recorded
+    u64 written;                // Scopes written to the file
+    u64 dropped;                // Scopes dropped because a ring buffer was full
+} TraceStats;
+
+// Start recording, and start the thread writing the trace file
+// Parameters:
+// - path: Path of the trace file
+// Returns false if recording has already started or the file or thread could not be created
+bool TraceInit(const char* path);
+
+// Open a scope on the calling thread
+// Does nothing if recording has not started
+// Parameters:
+// - name: Name of the scope (the string must stay valid until TraceExit, e.g. a string literal)
+void TraceBegin(const char* name);
+
+// Close the innermost scope of the calling thread
+void TraceEnd();
+
+// Name the calling thread in the trace (the name is copied)
+// Does nothing if recording has not started
+void TraceSetThreadName(const char* name);
+
+// Get the statistics of the recorder
+// Parameters:
+// - pStats: Output statistics
+void TraceGetStats(TraceStats* pStats);
+
+// Stop recording, write the remaining scopes and close the trace file
+// Must be called before the program ends if TraceInit succeeded (it stops the writer thread)
+// Scopes still open are not written
+void TraceExit();
+
+#ifdef __cplusplus
+}
+
+// Scope closed at the end of the C++ block it is declared in
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) { TraceBegin(name); }
+    ~TraceScope() { TraceEnd(); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#endif // __cplusplus
+
+#endif // TRACE_H_
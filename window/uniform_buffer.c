@@ -0,0 +1,321 @@
+// Per-frame uniform block allocator
+
+#include "uniform_buffer.h"
+#include "coherency.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_WIN
+
+#include <GL/glew.h>
+
+static GLuint gBufferWin = GL_NONE;
+static u8* gMappedWin = NULL;   // Persistent mapping of the buffer (NULL if not supported)
+static u8* gStagingWin = NULL;  // CPU copy of the buffer if it can't be mapped persistently
+static GLsync gFencesWin[2] = { NULL, NULL };
+
+#else // TEST_GX2
+
+#include <coreinit/memdefaultheap.h>
+#include <gx2/event.h>
+#include <gx2/mem.h>
+#include <gx2/shaders.h>
+
+// Audits the GX2 calls of this file when built with WINDOW_COHERENCY
+#include "coherency_calls.h"
+
+static u8* gBuffer = NULL;
+static OSTime gFences[2] = { 0, 0 };
+
+#endif
+
+// Each half of the buffer holds one frame
+#define WINDOW_UNIFORM_BUFFER_COUNT 2
+
+static u32 gFrameSize = 0;
+static u32 gAlignment = 0;
+static u32 gBufferIndex = 0;
+static u32 gUsed = 0;           // Bytes allocated in the current half (may exceed gFrameSize if full)
+static u32 gFlushed = 0;        // Bytes of the current half made visible to the GPU (all written by then)
+static WindowUniformStats gStats;
+
+// Address of the current half
+static u8* WindowUniformGetFrameData()
+{
+    u32 base = gBufferIndex * gFrameSize;
+
+#ifdef TEST_WIN
+    return (gMappedWin ? gMappedWin : gStagingWin) + base;
+#else
+    return gBuffer + base;
+#endif
+}
+
+bool WindowUniformInit(u32 frame_size)
+{
+#ifdef TEST_WIN
+    if (gBufferWin != GL_NONE || frame_size == 0)
+        return false;
+
+    // Blocks must start at a multiple of the offset alignment of the implementation
+    GLint offset_alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+    gAlignment = offset_alignment > 256 ? (u32)offset_alignment : 256;
+#else
+    if (gBuffer || frame_size == 0)
+        return false;
+
+    gAlignment = GX2_UNIFORM_BLOCK_ALIGNMENT;
+#endif
+
+    gFrameSize = (frame_size + gAlignment - 1) & ~(gAlignment - 1);
+    u32 buffer_size = gFrameSize * WINDOW_UNIFORM_BUFFER_COUNT;
+
+    memset(&gStats, 0, sizeof(gStats));
+    gStats.frame_size = gFrameSize;
+    gStats.alignment = gAlignment;
+
+#ifdef TEST_WIN
+
+    glGenBuffers(1, &gBufferWin);
+    glBindBuffer(GL_UNIFORM_BUFFER, gBufferWin);
+
+    if (GLEW_ARB_buffer_storage)
+    {
+        // Map the buffer once for the lifetime of the allocator
+        // Coherent, so that writes are visible to the GPU without explicit flushes
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, buffer_size, NULL, flags);
+        gMappedWin = (u8*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, buffer_size, flags);
+    }
+
+    if (!gMappedWin)
+    {
+        // Buffer storage is immutable, so start over with a new buffer
+        if (GLEW_ARB_buffer_storage)
+        {
+            glDeleteBuffers(1, &gBufferWin);
+            glGenBuffers(1, &gBufferWin);
+            glBindBuffer(GL_UNIFORM_BUFFER, gBufferWin);
+        }
+
+        glBufferData(GL_UNIFORM_BUFFER, buffer_size, NULL, GL_STREAM_DRAW);
+        gStagingWin = (u8*)malloc(buffer_size);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, GL_NONE);
+
+    if (!gMappedWin && !gStagingWin)
+    {
+        WindowUniformExit();
+        return false;
+    }
+
+    gStats.persistent = gMappedWin != NULL;
+
+#else // TEST_GX2
+
+    gBuffer = (u8*)MEMAllocFromDefaultHeapEx(buffer_size, GX2_UNIFORM_BLOCK_ALIGNMENT);
+    if (!gBuffer)
+        return false;
+
+    COHERENCY_ALLOC(gBuffer, buffer_size);
+
+#endif
+
+    gBufferIndex = 0;
+    gUsed = 0;
+    gFlushed = 0;
+    return true;
+}
+
+void WindowUniformBeginFrame()
+{
+#ifdef TEST_WIN
+    if (gBufferWin == GL_NONE)
+        return;
+#else
+    if (!gBuffer)
+        return;
+#endif
+
+    u32 used = gUsed < gFrameSize ? gUsed : gFrameSize;
+    gStats.bytes_used = used;
+    if (used > gStats.peak_bytes)
+        gStats.peak_bytes = used;
+
+    // All commands of the previous frame have been issued by now: fence its half
+#ifdef TEST_WIN
+    if (gFencesWin[gBufferIndex])
+        glDeleteSync(gFencesWin[gBufferIndex]);
+    gFencesWin[gBufferIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#else
+    GX2Flush();
+    gFences[gBufferIndex] = GX2GetLastSubmittedTimeStamp();
+#endif
+
+    gBufferIndex = (gBufferIndex + 1) % WINDOW_UNIFORM_BUFFER_COUNT;
+
+    // Wait until the GPU is done with the frame that used the other half
+#ifdef TEST_WIN
+    if (gFencesWin[gBufferIndex])
+    {
+        if (glClientWaitSync(gFencesWin[gBufferIndex], 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            gStats.fence_waits++;
+            while (glClientWaitSync(gFencesWin[gBufferIndex], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+                continue;
+        }
+
+        glDeleteSync(gFencesWin[gBufferIndex]);
+        gFencesWin[gBufferIndex] = NULL;
+    }
+#else
+    if (gFences[gBufferIndex] != 0 && GX2GetRetiredTimeStamp() < gFences[gBufferIndex])
+    {
+        gStats.fence_waits++;
+        GX2WaitTimeStamp(gFences[gBufferIndex]);
+    }
+#endif
+
+    gUsed = 0;
+    gFlushed = 0;
+}
+
+void* WindowUniformAlloc(u32 size, WindowUniformBlock* pBlock)
+{
+    u32 aligned_size = (size + gAlignment - 1) & ~(gAlignment - 1);
+    if (size == 0 || aligned_size > gFrameSize)
+        return NULL;
+
+    // Several threads may allocate at the same time
+    u32 offset = __atomic_fetch_add(&gUsed, aligned_size, __ATOMIC_RELAXED);
+    if (offset + aligned_size > gFrameSize)
+    {
+        __atomic_fetch_add(&gStats.failed_allocs, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    u8* data = WindowUniformGetFrameData() + offset;
+
+    // The caller writes the block through the pointer returned
+    COHERENCY_CPU_WRITE(data, size);
+
+#ifdef TEST_WIN
+    pBlock->offset = gBufferIndex * gFrameSize + offset;
+#else
+    pBlock->data = data;
+#endif
+    pBlock->size = size;
+
+    return data;
+}
+
+void WindowUniformFlush()
+{
+    u32 used = gUsed < gFrameSize ? gUsed : gFrameSize;
+    if (used <= gFlushed)
+        return;
+
+    u8* data = WindowUniformGetFrameData() + gFlushed;
+    u32 size = used - gFlushed;
+
+#ifdef TEST_WIN
+    // Persistent coherent mappings need no flush
+    if (gStagingWin)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, gBufferWin);
+        glBufferSubData(GL_UNIFORM_BUFFER, gBufferIndex * gFrameSize + gFlushed, size, data);
+        glBindBuffer(GL_UNIFORM_BUFFER, GL_NONE);
+    }
+
+    COHERENCY_INVALIDATE(COHERENCY_CACHE_CPU | COHERENCY_CACHE_UNIFORM_BLOCK, data, size);
+#else
+    // Flush the blocks from the CPU cache and invalidate the GPU uniform block cache
+    GX2Invalidate(GX2_INVALIDATE_MODE_CPU_UNIFORM_BLOCK, data, size);
+#endif
+
+    gFlushed = used;
+}
+
+void WindowSetVertexUniformBlock(u32 index, const WindowUniformBlock* block)
+{
+#ifdef TEST_WIN
+    glBindBufferRange(GL_UNIFORM_BUFFER, index, gBufferWin, block->offset, block->size);
+#else
+    GX2SetVertexUniformBlock(index, block->size, block->data);
+#endif
+}
+
+void WindowSetPixelUniformBlock(u32 index, const WindowUniformBlock* block)
+{
+#ifdef TEST_WIN
+    glBindBufferRange(GL_UNIFORM_BUFFER, WINDOW_UNIFORM_PIXEL_BINDING_BASE + index, gBufferWin, block->offset, block->size);
+#else
+    GX2SetPixelUniformBlock(index, block->size, block->data);
+#endif
+}
+
+#ifdef TEST_WIN
+
+u32 WindowUniformGetBuffer()
+{
+    return gBufferWin;
+}
+
+#endif // TEST_WIN
+
+void WindowUniformGetStats(WindowUniformStats* pStats)
+{
+    *pStats = gStats;
+}
+
+void WindowUniformExit()
+{
+#ifdef TEST_WIN
+
+    for (u32 i = 0; i < WINDOW_UNIFORM_BUFFER_COUNT; i++)
+    {
+        if (gFencesWin[i])
+        {
+            glDeleteSync(gFencesWin[i]);
+            gFencesWin[i] = NULL;
+        }
+    }
+
+    if (gBufferWin != GL_NONE)
+    {
+        if (gMappedWin)
+        {
+            glBindBuffer(GL_UNIFORM_BUFFER, gBufferWin);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, GL_NONE);
+            gMappedWin = NULL;
+        }
+
+        // OpenGL keeps the buffer alive until the GPU is done with it
+        glDeleteBuffers(1, &gBufferWin);
+        gBufferWin = GL_NONE;
+    }
+
+    free(gStagingWin);
+    gStagingWin = NULL;
+
+#else // TEST_GX2
+
+    if (gBuffer)
+    {
+        // The GPU may still be reading the buffer
+        GX2DrawDone();
+
+        MEMFreeToDefaultHeap(gBuffer);
+        gBuffer = NULL;
+    }
+
+    gFences[0] = gFences[1] = 0;
+
+#endif
+
+    gFrameSize = 0;
+}
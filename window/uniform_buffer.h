@@ -0,0 +1,99 @@
+// Per-frame uniform block allocator
+// Uniform data (transforms, material constants...) is written once per frame into one large buffer,
+// and draws only bind the block they use, instead of each draw writing its uniforms into registers
+// The buffer is double-buffered: the CPU fills one half while the GPU may still read the other,
+// and a fence makes sure the GPU is done with a half before it is filled again
+// - Wii U: the buffer is in MEM2, and blocks are bound with GX2SetVertexUniformBlock / GX2SetPixelUniformBlock
+//          (requires WINDOW_SHADER_MODE_UNIFORM_BLOCK; see WindowSetShaderMode)
+// - PC: the buffer is a persistently-mapped uniform buffer object (ARB_buffer_storage), or a copy in
+//       CPU memory uploaded with glBufferSubData if that is not supported; blocks are bound with glBindBufferRange
+
+#ifndef UNIFORM_BUFFER_H_
+#define UNIFORM_BUFFER_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// On PC, pixel shader block N is bound to binding point WINDOW_UNIFORM_PIXEL_BINDING_BASE + N
+// (OpenGL shares binding points between stages; vertex shader block N is bound to binding point N)
+#define WINDOW_UNIFORM_PIXEL_BINDING_BASE 16
+
+// Block allocated for the current frame
+typedef struct WindowUniformBlock
+{
+#ifdef TEST_WIN
+    u32 offset;                 // Offset of the block in the uniform buffer object
+#else
+    void* data;                 // Address of the block
+#endif // TEST_WIN
+    u32 size;                   // Size of the block in bytes
+} WindowUniformBlock;
+
+// Uniform buffer statistics
+typedef struct WindowUniformStats
+{
+    u32 frame_size;             // Bytes available per frame
+    u32 alignment;              // Alignment of the blocks
+    u32 bytes_used;             // Bytes allocated in the last complete frame
+    u32 peak_bytes;             // Highest number of bytes allocated in a frame
+    u32 failed_allocs;          // Number of allocations that did not fit in the frame
+    u32 fence_waits;            // Number of times the CPU had to wait for the GPU to be done with a buffer half
+    bool persistent;            // PC: whether the buffer is persistently mapped
+} WindowUniformStats;
+
+// Create the buffer
+// Parameters:
+// - frame_size: Bytes of uniform data per frame (twice as much memory is allocated)
+bool WindowUniformInit(u32 frame_size);
+
+// Start a new frame: the buffer half used by the previous frame is fenced,
+// and the CPU waits until the GPU is done with the other half before it is reused
+// Call it once per frame, from the thread owning the window context, before any allocation
+// (e.g. right after WindowSwapBuffers); blocks from the previous frame may no longer be bound
+void WindowUniformBeginFrame();
+
+// Allocate a block in the current frame
+// May be called from any thread (e.g. while recording command lists on the job pool)
+// Parameters:
+// - size: Size of the block in bytes (rounded up to the block alignment)
+// - pBlock: Output block, to bind with WindowSetVertexUniformBlock / WindowCmdSetVertexUniformBlock
+// Returns the address to write the block to, or NULL if the frame is full
+void* WindowUniformAlloc(u32 size, WindowUniformBlock* pBlock);
+
+// Make the blocks allocated so far in this frame visible to the GPU
+// Must be called from the thread owning the window context before the draws using them are submitted,
+// once every block allocated has been written: never while command lists are being recorded, as the
+// workers may still be writing blocks they allocated (WindowCmdSubmit does so already, after recording)
+void WindowUniformFlush();
+
+// Bind a block to a uniform block slot of the vertex or pixel shader
+// The block is not flushed: call WindowUniformFlush before the draws that use it
+// Parameters:
+// - index: Uniform block index (location of the block in the shader on Wii U)
+// - block: The block to bind
+void WindowSetVertexUniformBlock(u32 index, const WindowUniformBlock* block);
+void WindowSetPixelUniformBlock(u32 index, const WindowUniformBlock* block);
+
+#ifdef TEST_WIN
+
+// Get the uniform buffer object holding the blocks
+u32 WindowUniformGetBuffer();
+
+#endif // TEST_WIN
+
+// Get uniform buffer statistics
+void WindowUniformGetStats(WindowUniformStats* pStats);
+
+// Free the buffer
+// Waits for the GPU to be done with it
+void WindowUniformExit();
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // UNIFORM_BUFFER_H_
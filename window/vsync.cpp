@@ -0,0 +1,374 @@
+// Display events: GX2 event callbacks on Wii U, swap completion and a timing thread on PC
+
+#include "vsync.h"
+#include "trace.h"
+
+#include <atomic>
+
+#ifdef TEST_WIN
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Refresh rate of the timing thread when there is no display
+#define WINDOW_VSYNC_DEFAULT_PERIOD (1.0 / 60.0)
+
+static std::thread gTimingThread;
+static std::mutex gMutex;
+static std::condition_variable gCondition; // Notified on every event, and on exit
+static bool gQuit = false;
+static f64 gRefreshPeriod = 0.0;
+static std::recursive_mutex gDispatchMutex; // Held while callbacks run (they may remove themselves)
+static std::atomic<u32> gSwaps(0);         // Frames swapped
+static f64 gPhaseTime = 0.0;               // Time of the last swap completed with driver vsync (0 if none)
+
+#else // TEST_GX2
+
+#include <gx2/event.h>
+#include <gx2/swap.h>
+
+static u32 gSwapBase = 0;                  // Swap count of GX2 at WindowVsyncInit
+
+#endif
+
+typedef struct WindowVsyncCallbackEntry
+{
+    std::atomic<WindowVsyncCallback> callback;
+    void* user_data;
+} WindowVsyncCallbackEntry;
+
+static WindowVsyncCallbackEntry gCallbacks[WINDOW_VSYNC_MAX_CALLBACKS];
+static std::atomic<u32> gCounts[2];
+static f64 gFlipTimes[WINDOW_VSYNC_FLIP_HISTORY];
+static bool gInitialized = false;
+
+// Accessed by the thread owning the window only
+static u32 gWaits = 0;
+static f64 gWaitTime = 0.0;
+static f64 gLastWaitTime = 0.0;
+
+// Whether an event count has reached a count, as they wrap around
+static bool WindowVsyncReached(u32 current, u32 count)
+{
+    return (s32)(current - count) >= 0;
+}
+
+// Callbacks to run for an event, copied when the event is counted
+typedef struct WindowVsyncDispatch
+{
+    WindowVsyncEvent event;
+    u32 count;
+    u32 num_callbacks;
+    u32 slots[WINDOW_VSYNC_MAX_CALLBACKS];
+    WindowVsyncCallback callbacks[WINDOW_VSYNC_MAX_CALLBACKS];
+    void* user_data[WINDOW_VSYNC_MAX_CALLBACKS];
+} WindowVsyncDispatch;
+
+// Count an event and copy the callbacks to run for it
+// (On PC, with gMutex locked)
+static void WindowVsyncSignal(WindowVsyncEvent event, f64 time, WindowVsyncDispatch* pDispatch)
+{
+    // The time is stored before the count is published
+    if (event == WINDOW_VSYNC_EVENT_FLIP)
+        gFlipTimes[gCounts[event].load(std::memory_order_relaxed) % WINDOW_VSYNC_FLIP_HISTORY] = time;
+
+    pDispatch->event = event;
+    pDispatch->count = gCounts[event].fetch_add(1, std::memory_order_release) + 1;
+    pDispatch->num_callbacks = 0;
+
+    for (u32 i = 0; i < WINDOW_VSYNC_MAX_CALLBACKS; i++)
+    {
+        WindowVsyncCallback callback = gCallbacks[i].callback.load(std::memory_order_acquire);
+        if (!callback)
+            continue;
+
+        u32 index = pDispatch->num_callbacks++;
+        pDispatch->slots[index] = i;
+        pDispatch->callbacks[index] = callback;
+        pDispatch->user_data[index] = gCallbacks[i].user_data;
+    }
+}
+
+// Run the callbacks copied by WindowVsyncSignal
+// (On PC, with gMutex unlocked, so that callbacks can add and remove callbacks, and wait for events)
+static void WindowVsyncRunCallbacks(const WindowVsyncDispatch* dispatch)
+{
+    if (dispatch->num_callbacks == 0)
+        return;
+
+#ifdef TEST_WIN
+    std::lock_guard<std::recursive_mutex> lock(gDispatchMutex);
+#endif
+
+    for (u32 i = 0; i < dispatch->num_callbacks; i++)
+    {
+        // Skip the callbacks removed since they were copied (e.g. by an earlier callback)
+        const WindowVsyncCallbackEntry* entry = &gCallbacks[dispatch->slots[i]];
+        if (entry->callback.load(std::memory_order_acquire) != dispatch->callbacks[i] || entry->user_data != dispatch->user_data[i])
+            continue;
+
+        dispatch->callbacks[i](dispatch->event, dispatch->count, dispatch->user_data[i]);
+    }
+}
+
+#ifdef TEST_WIN
+
+static void WindowVsyncTimingLoop()
+{
+    std::unique_lock<std::mutex> lock(gMutex);
+    f64 next = WindowGetTime() + gRefreshPeriod;
+
+    while (true)
+    {
+        f64 wait = next - WindowGetTime();
+        if (wait > 0.0 && gCondition.wait_for(lock, std::chrono::duration<f64>(wait), [] { return gQuit; }))
+            break;
+
+        if (gQuit)
+            break;
+
+        f64 now = WindowGetTime();
+        WindowVsyncDispatch dispatch;
+        WindowVsyncSignal(WINDOW_VSYNC_EVENT_VSYNC, now, &dispatch);
+        gCondition.notify_all();
+
+        lock.unlock();
+        WindowVsyncRunCallbacks(&dispatch);
+        lock.lock();
+
+        if (gQuit)
+            break;
+
+        // With driver vsync, swaps complete on the refreshes of the display: keep the ticks in phase with
+        // the last one. Otherwise, tick every refresh period from now on (no burst after a stall)
+        if (gPhaseTime > 0.0)
+            next = gPhaseTime + (std::floor((now - gPhaseTime) / gRefreshPeriod) + 1.0) * gRefreshPeriod;
+        else
+            next += gRefreshPeriod;
+
+        if (next <= now)
+            next = now + gRefreshPeriod;
+    }
+}
+
+#else // TEST_GX2
+
+static void WindowVsyncEventCallback(GX2EventType type, void* user_data)
+{
+    (void)user_data;
+
+    WindowVsyncDispatch dispatch;
+    WindowVsyncSignal(type == GX2_EVENT_TYPE_FLIP ? WINDOW_VSYNC_EVENT_FLIP : WINDOW_VSYNC_EVENT_VSYNC, WindowGetTime(), &dispatch);
+    WindowVsyncRunCallbacks(&dispatch);
+}
+
+#endif
+
+bool WindowVsyncAddCallback(WindowVsyncCallback callback, void* user_data)
+{
+    for (u32 i = 0; i < WINDOW_VSYNC_MAX_CALLBACKS; i++)
+    {
+        if (!gCallbacks[i].callback.load())
+        {
+            // The user data must be set before the callback can be seen
+            gCallbacks[i].user_data = user_data;
+            gCallbacks[i].callback.store(callback, std::memory_order_release);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WindowVsyncRemoveCallback(WindowVsyncCallback callback, void* user_data)
+{
+    for (u32 i = 0; i < WINDOW_VSYNC_MAX_CALLBACKS; i++)
+    {
+        if (gCallbacks[i].callback.load() == callback && gCallbacks[i].user_data == user_data)
+        {
+            gCallbacks[i].callback.store(NULL);
+            break;
+        }
+    }
+
+#ifdef TEST_WIN
+    // Once this returns, no other thread is running the callback anymore
+    // (The dispatch lock is recursive, so that a callback can remove itself)
+    std::lock_guard<std::recursive_mutex> lock(gDispatchMutex);
+#endif
+}
+
+u32 WindowVsyncGetCount(WindowVsyncEvent event)
+{
+    return gCounts[event].load(std::memory_order_acquire);
+}
+
+u32 WindowVsyncGetPendingFlips()
+{
+#ifdef TEST_WIN
+    return gSwaps.load() - gCounts[WINDOW_VSYNC_EVENT_FLIP].load();
+#else
+    u32 swap_count, flip_count;
+    OSTime last_flip, last_vsync;
+    GX2GetSwapStatus(&swap_count, &flip_count, &last_flip, &last_vsync);
+    return swap_count - flip_count;
+#endif
+}
+
+void WindowVsyncWait(WindowVsyncEvent event, u32 count)
+{
+    if (!gInitialized)
+        return;
+
+    TraceBegin(event == WINDOW_VSYNC_EVENT_FLIP ? "Wait for flip" : "Wait for vsync");
+
+#ifdef TEST_WIN
+    std::unique_lock<std::mutex> lock(gMutex);
+    gCondition.wait(lock, [event, count] {
+        return gQuit || WindowVsyncReached(gCounts[event].load(), count) ||
+               (event == WINDOW_VSYNC_EVENT_FLIP && gSwaps == gCounts[event].load());
+    });
+#else
+    while (!WindowVsyncReached(gCounts[event].load(), count))
+    {
+        if (event == WINDOW_VSYNC_EVENT_VSYNC)
+            GX2WaitForVsync();
+        else if (WindowVsyncGetPendingFlips() > 0)
+            GX2WaitForFlip();
+        else
+            break;
+    }
+#endif
+
+    TraceEnd();
+}
+
+void WindowVsyncGetStats(WindowVsyncStats* pStats)
+{
+    pStats->vsyncs = gCounts[WINDOW_VSYNC_EVENT_VSYNC].load();
+    pStats->flips = gCounts[WINDOW_VSYNC_EVENT_FLIP].load();
+#ifdef TEST_WIN
+    pStats->swaps = gSwaps.load();
+#else
+    u32 swap_count, flip_count;
+    OSTime last_flip, last_vsync;
+    GX2GetSwapStatus(&swap_count, &flip_count, &last_flip, &last_vsync);
+    pStats->swaps = swap_count - gSwapBase;
+#endif
+    pStats->waits = gWaits;
+    pStats->wait_ms = gWaitTime * 1000.0;
+    pStats->last_wait_ms = gLastWaitTime * 1000.0;
+}
+
+bool WindowVsyncInit(f64 refresh_period)
+{
+    if (gInitialized)
+        return true;
+
+    gCounts[WINDOW_VSYNC_EVENT_VSYNC].store(0);
+    gCounts[WINDOW_VSYNC_EVENT_FLIP].store(0);
+    gWaits = 0;
+    gWaitTime = 0.0;
+    gLastWaitTime = 0.0;
+
+#ifdef TEST_WIN
+    gQuit = false;
+    gRefreshPeriod = refresh_period > 0.0 ? refresh_period : WINDOW_VSYNC_DEFAULT_PERIOD;
+    gSwaps.store(0);
+    gPhaseTime = 0.0;
+    gTimingThread = std::thread(WindowVsyncTimingLoop);
+#else
+    (void)refresh_period;
+
+    u32 flip_count;
+    OSTime last_flip, last_vsync;
+    GX2GetSwapStatus(&gSwapBase, &flip_count, &last_flip, &last_vsync);
+
+    GX2SetEventCallback(GX2_EVENT_TYPE_VSYNC, WindowVsyncEventCallback, NULL);
+    GX2SetEventCallback(GX2_EVENT_TYPE_FLIP, WindowVsyncEventCallback, NULL);
+#endif
+
+    gInitialized = true;
+    return true;
+}
+
+void WindowVsyncSwapDone(bool vsync)
+{
+#ifdef TEST_WIN
+    WindowVsyncDispatch dispatch;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+
+        // The driver queued the frame: it counts as flipped now
+        f64 time = WindowGetTime();
+        gSwaps.fetch_add(1);
+        WindowVsyncSignal(WINDOW_VSYNC_EVENT_FLIP, time, &dispatch);
+
+        gPhaseTime = vsync ? time : 0.0;
+        gCondition.notify_all();
+    }
+
+    WindowVsyncRunCallbacks(&dispatch);
+#else
+    // GX2SwapScanBuffers queues the flip, and the flip event counts it
+    (void)vsync;
+#endif
+}
+
+void WindowVsyncWaitForPendingFlips(u32 max_pending)
+{
+    gLastWaitTime = 0.0;
+    if (!gInitialized || WindowVsyncGetPendingFlips() <= max_pending)
+        return;
+
+    TraceBegin("Wait for flip");
+    f64 start = WindowGetTime();
+
+#ifdef TEST_WIN
+    {
+        std::unique_lock<std::mutex> lock(gMutex);
+        gCondition.wait(lock, [max_pending] { return gQuit || gSwaps - gCounts[WINDOW_VSYNC_EVENT_FLIP].load() <= max_pending; });
+    }
+#else
+    while (WindowVsyncGetPendingFlips() > max_pending)
+        GX2WaitForFlip();
+#endif
+
+    gLastWaitTime = WindowGetTime() - start;
+    gWaitTime += gLastWaitTime;
+    gWaits++;
+    TraceEnd();
+}
+
+bool WindowVsyncGetFlipTime(u32 flip, f64* pTime)
+{
+    u32 flips = gCounts[WINDOW_VSYNC_EVENT_FLIP].load(std::memory_order_acquire);
+    if (flip == 0 || !WindowVsyncReached(flips, flip) || flips - flip >= WINDOW_VSYNC_FLIP_HISTORY)
+        return false;
+
+    *pTime = gFlipTimes[(flip - 1) % WINDOW_VSYNC_FLIP_HISTORY];
+    return true;
+}
+
+void WindowVsyncExit()
+{
+    if (!gInitialized)
+        return;
+
+#ifdef TEST_WIN
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        gQuit = true;
+    }
+    gCondition.notify_all();
+    gTimingThread.join();
+#else
+    GX2SetEventCallback(GX2_EVENT_TYPE_VSYNC, NULL, NULL);
+    GX2SetEventCallback(GX2_EVENT_TYPE_FLIP, NULL, NULL);
+#endif
+
+    gInitialized = false;
+}
@@ -0,0 +1,119 @@
+// Display events
+// WindowSwapBuffers queues the flip of the frame and returns, instead of waiting for the flip to happen:
+// the CPU can start on the next frame while the display catches up, and only waits when it has queued
+// as many frames as there are buffers to hold them (WINDOW_VSYNC_MAX_PENDING_FLIPS)
+// The application can be woken by the display instead, with a callback run on every vsync (start of a
+// refresh) and flip (a queued frame reaching the screen), or by waiting for a given event count
+// - Wii U: GX2 event callbacks (GX2SetEventCallback), run from the GX2 interrupt handler;
+//          waits use GX2WaitForVsync and GX2WaitForFlip
+// - PC: the swap interval is the driver's (glfwSwapInterval): glfwSwapBuffers returns once the driver
+//       has queued the frame, and only blocks when all of its buffers are in use. A frame counts as
+//       flipped when the swap completes; a timing thread ticks the vsyncs at the refresh rate of the
+//       monitor (60 Hz in headless mode), in phase with the swaps completed with driver vsync
+
+#ifndef VSYNC_H_
+#define VSYNC_H_
+
+#include "window.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+// Most frames queued and not flipped yet: WindowSwapBuffers waits for a flip before queuing more
+// (The scan buffers are double-buffered: the frame on screen and one queued frame)
+#define WINDOW_VSYNC_MAX_PENDING_FLIPS 1
+
+// Most callbacks registered at once
+#define WINDOW_VSYNC_MAX_CALLBACKS 8
+
+// Number of flip times kept for frame pacing
+#define WINDOW_VSYNC_FLIP_HISTORY 8
+
+typedef enum WindowVsyncEvent
+{
+    WINDOW_VSYNC_EVENT_VSYNC,   // Start of a display refresh
+    WINDOW_VSYNC_EVENT_FLIP     // A queued frame reached the screen
+} WindowVsyncEvent;
+
+// Function called on display events
+// Wii U: called from the GX2 interrupt handler, so it must be short and must not block
+// PC: called from the timing thread for vsyncs, and from WindowSwapBuffers for flips
+// Parameters:
+// - event: The event
+// - count: Number of such events so far, including this one
+// - user_data: Pointer passed to WindowVsyncAddCallback
+typedef void (*WindowVsyncCallback)(WindowVsyncEvent event, u32 count, void* user_data);
+
+// Statistics
+typedef struct WindowVsyncStats
+{
+    u32 vsyncs;                 // Vsyncs since WindowInit
+    u32 flips;                  // Flips since WindowInit
+    u32 swaps;                  // Frames queued since WindowInit
+    u32 waits;                  // Times WindowSwapBuffers had to wait for a flip
+    f64 wait_ms;                // Total time spent in those waits, in milliseconds
+    f64 last_wait_ms;           // Time spent waiting by the last WindowSwapBuffers
+} WindowVsyncStats;
+
+// Register a function to call on display events
+// Callbacks must be added and removed from the thread owning the window, or from a callback
+// (e.g. a callback removing itself after the first event)
+// Returns false if WINDOW_VSYNC_MAX_CALLBACKS are registered already
+bool WindowVsyncAddCallback(WindowVsyncCallback callback, void* user_data);
+
+// Unregister a function registered with the same user data
+void WindowVsyncRemoveCallback(WindowVsyncCallback callback, void* user_data);
+
+// Get the number of events so far (it wraps around)
+u32 WindowVsyncGetCount(WindowVsyncEvent event);
+
+// Block until the number of events reaches a count (returns right away if it has)
+// Waiting for a flip returns as well once no frame is queued anymore
+// e.g. WindowVsyncWait(WINDOW_VSYNC_EVENT_VSYNC, WindowVsyncGetCount(WINDOW_VSYNC_EVENT_VSYNC) + 1)
+// waits for the next vsync
+void WindowVsyncWait(WindowVsyncEvent event, u32 count);
+
+// Get the number of frames queued and not flipped yet
+u32 WindowVsyncGetPendingFlips();
+
+// Get the statistics
+// Parameters:
+// - pStats: Output statistics
+void WindowVsyncGetStats(WindowVsyncStats* pStats);
+
+// Start the display events
+// Called by WindowInit
+// Parameters:
+// - refresh_period: Duration of one display refresh in seconds (0 if there is no display)
+bool WindowVsyncInit(f64 refresh_period);
+
+// Count the flip of a frame whose swap just completed (PC; on Wii U, the flip event does)
+// Called by WindowSwapBuffers
+// Parameters:
+// - vsync: Whether the swap was synchronized with the display (swap interval above 0), in which case
+//          the vsync ticks are put in phase with it
+void WindowVsyncSwapDone(bool vsync);
+
+// Block while more than a number of frames are queued and not flipped yet
+// Called by WindowSwapBuffers before it queues a frame, to make room for it, and with 0 before the
+// scan buffers are freed
+void WindowVsyncWaitForPendingFlips(u32 max_pending);
+
+// Get the time of a flip, for frame pacing
+// Parameters:
+// - flip: Number of the flip (1 for the first one), within the last WINDOW_VSYNC_FLIP_HISTORY flips
+// - pTime: Output time of the flip, in seconds (as returned by WindowGetTime)
+// Returns false if the flip has not happened yet or is too old
+bool WindowVsyncGetFlipTime(u32 flip, f64* pTime);
+
+// Stop the display events
+// Called by WindowExit
+void WindowVsyncExit();
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // VSYNC_H_
@@ -1,26 +1,87 @@
 // Windowing library built on GX2 with basic operations inspired by glfw
 
 #include "window.h"
+#include "coherency.h"
+#include "dynamic_resolution.h"
+#include "format.h"
+#include "frame_graph.h"
+#include "frame_pacing.h"
+#include "gpu_profiler.h"
+#include "render_target.h"
+#include "trace.h"
+#include "vsync.h"
 
 #ifdef TEST_WIN
 
 #include <GL/glew.h>
+
+// Framebuffer the scene is rendered into at the render size, then blitted to the window framebuffer
+// (Created if multisampled, or otherwise the first time the render scale is changed)
+static GLuint gSceneFramebufferWin = GL_NONE;
+static GLuint gSceneColorRenderbufferWin = GL_NONE;
+static GLuint gSceneDepthRenderbufferWin = GL_NONE;
+
+// Single-sample framebuffer the scene is resolved into before being upscaled
+// (Multisample resolve blits can't scale)
+static GLuint gResolveFramebufferWin = GL_NONE;
+static GLuint gResolveColorRenderbufferWin = GL_NONE;
+
+#ifdef TEST_WIN_HEADLESS
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Number of frames the CPU may queue ahead of the GPU before WindowSwapBuffers blocks
+#define WINDOW_HEADLESS_FRAMES_IN_FLIGHT 2
+
+static EGLDisplay gDisplayWin = EGL_NO_DISPLAY;
+static EGLContext gContextWin = EGL_NO_CONTEXT;
+static EGLSurface gSurfaceWin = EGL_NO_SURFACE;
+static GLuint gFramebufferWin = GL_NONE;
+static GLuint gColorRenderbufferWin = GL_NONE;
+static GLuint gDepthRenderbufferWin = GL_NONE;
+static GLsync gFrameFenceWin[WINDOW_HEADLESS_FRAMES_IN_FLIGHT] = { NULL };
+static u32 gFrameCountWin = 0;
+static u32 gFrameLimitWin = 0;
+static f64 gStartTimeWin = 0.0;
+
+#else
+
 #include <GLFW/glfw3.h>
 
+#include <string.h>
+
 static GLFWwindow* gWindowHandleWin = NULL;
 
+#endif // TEST_WIN_HEADLESS
+
 #else // TEST_GX2
 
+#include <coreinit/cache.h>
+#include <coreinit/foreground.h>
 #include <coreinit/memdefaultheap.h>
 #include <coreinit/memfrmheap.h>
 #include <coreinit/memheap.h>
+#include <coreinit/time.h>
 #include <gx2/context.h>
 #include <gx2/display.h>
 #include <gx2/event.h>
 #include <gx2/mem.h>
+#include <gx2/query.h>
 #include <gx2/registers.h>
 #include <gx2/state.h>
 #include <gx2/swap.h>
+#include <proc_ui/procui.h>
+
+#include <string.h>
+
+// Audits the GX2 calls of this file when built with WINDOW_COHERENCY
+#include "coherency_calls.h"
 
 static void* gCmdlist = NULL;
 static GX2ContextState* gContext = NULL;
@@ -28,22 +89,605 @@ static void* gTvScanBuffer = NULL;
 static void* gDrcScanBuffer = NULL;
 static GX2ColorBuffer gColorBuffer;
 static void* gColorBufferImageData = NULL;
+static void* gColorBufferAuxData = NULL;
+static GX2ColorBuffer gResolveColorBuffer; // Single-sample copy of the color buffer (if multisampled)
+static void* gResolveColorBufferImageData = NULL;
 static GX2DepthBuffer gDepthBuffer;
 static void* gDepthBufferImageData = NULL;
 static MEMHeapHandle gMEM1HeapHandle;
 static MEMHeapHandle gFgHeapHandle;
+static u32 gTvScanBufferSize = 0;
+static u32 gDrcScanBufferSize = 0;
+static u32 gColorBufferAuxSize = 0;
+static bool gOwnsProcUI = false;   // Whether WindowInit initialized ProcUI
+static bool gHeapStatesRecorded = false; // Whether the window holds allocations in MEM1 and the Foreground bucket
+
+// Tag of the frame heap states recorded before the window allocates from MEM1 and the Foreground bucket
+#define WINDOW_FRM_HEAP_STATE 0x57494E44 // "WIND"
+
+// Most buffers allocated in MEM1 and the Foreground bucket (scan buffers, color, AA, resolve, depth)
+#define WINDOW_MAX_FOREGROUND_BUFFERS 6
+
+// A buffer only available while the application is in the foreground, allocated again on each resume
+typedef struct WindowForegroundBuffer
+{
+    void** pData;               // Variable holding the address of the buffer
+    MEMHeapHandle heap;         // MEM1 or Foreground bucket frame heap
+    u32 size;
+    u32 alignment;
+} WindowForegroundBuffer;
+
+// In allocation order
+static WindowForegroundBuffer gForegroundBuffers[WINDOW_MAX_FOREGROUND_BUFFERS];
+static u32 gNumForegroundBuffers = 0;
 
 #endif
 
 static bool gInitialized = false;
+static u32 gFramebufferWidth = 0;
+static u32 gFramebufferHeight = 0;
+static WindowFramebufferPlan gFramebufferPlan;
 
-bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
+static FramePacing gFramePacing;
+static f64 gFrameWorkStart = 0.0;
+static u32 gPacedFlips = 0; // Flips fed to the frame pacing controller
+
+// Number of frames the GPU timings are read back after, so that reading them never stalls
+#define WINDOW_GPU_TIMER_FRAMES 3
+
+#ifdef TEST_WIN
+static GLuint gGpuTimerQueriesWin[WINDOW_GPU_TIMER_FRAMES][2];
+static bool gGpuTimerPendingWin[WINDOW_GPU_TIMER_FRAMES];
+#else
+// GPU timestamps of the start and end of each frame, written by the GPU
+// (Padded so that each frame has a 32-byte cache line of its own)
+static u64 gGpuTimestamps[WINDOW_GPU_TIMER_FRAMES][4] __attribute__((aligned(0x40)));
+#endif // TEST_WIN
+static f32 gGpuTimerScale[WINDOW_GPU_TIMER_FRAMES]; // Render scale each timed frame used
+static u32 gGpuTimerFrame = 0;
+static f64 gGpuFrameTime = 0.0;
+static bool gGpuTimerUsable = false; // Whether the GPU timer measures anything (checked once at init)
+static f64 gSwapFrameTime = 0.0;    // Time between the ends of the last two swaps
+
+// Application lifecycle
+static bool gInForeground = false;
+static bool gExitRequested = false;
+static WindowLifecycleCallback gLifecycleCallback = NULL;
+static void* gLifecycleUserData = NULL;
+static WindowLifecycleStats gLifecycleStats;
+static f64 gReleaseTime = 0.0;
+
+#ifdef TEST_WIN
+
+// Simulated lifecycle events, waiting for WindowIsRunning
+#define WINDOW_LIFECYCLE_QUEUE_SIZE 16
+static WindowLifecycleEvent gLifecycleQueueWin[WINDOW_LIFECYCLE_QUEUE_SIZE];
+static u32 gLifecycleQueueStartWin = 0;
+static u32 gLifecycleQueueCountWin = 0;
+
+// Whether the scene framebuffer existed when the foreground was released
+static bool gSceneFramebufferReleasedWin = false;
+
+#endif // TEST_WIN
+
+static DynamicResolution gDynamicResolution;
+static bool gDynamicResolutionEnabled = false;
+static f32 gRenderScale = 1.0f;
+static u32 gRenderWidth = 0;
+static u32 gRenderHeight = 0;
+
+#ifdef TEST_GX2
+
+// Allocate a buffer in MEM1 or the Foreground bucket, and remember it so that it can be allocated again
+// when the application acquires the foreground back
+static void* WindowAllocForegroundBuffer(void** pData, MEMHeapHandle heap, u32 size, u32 alignment)
+{
+    *pData = MEMAllocFromFrmHeapEx(heap, size, alignment);
+    COHERENCY_ALLOC(*pData, size);
+
+    if (*pData && gNumForegroundBuffers < WINDOW_MAX_FOREGROUND_BUFFERS)
+    {
+        WindowForegroundBuffer* buffer = &gForegroundBuffers[gNumForegroundBuffers++];
+        buffer->pData = pData;
+        buffer->heap = heap;
+        buffer->size = size;
+        buffer->alignment = alignment;
+    }
+
+    return *pData;
+}
+
+// Allocate a buffer in MEM1 or MEM2, and store its address in *pData
+static void* WindowAllocBuffer(void** pData, WindowMemory memory, u32 size, u32 alignment)
+{
+    if (memory == WINDOW_MEMORY_MEM1)
+        return WindowAllocForegroundBuffer(pData, gMEM1HeapHandle, size, alignment);
+
+    *pData = MEMAllocFromDefaultHeapEx(size, alignment);
+    COHERENCY_ALLOC(*pData, size);
+    return *pData;
+}
+
+#endif // TEST_GX2
+
+#ifdef TEST_WIN
+
+// Create a framebuffer object with color and depth renderbuffers in the planned formats
+// (No depth renderbuffer if pDepthRenderbuffer is NULL)
+static bool WindowCreateFramebufferWin(u32 width, u32 height, u32 samples, GLuint* pFramebuffer, GLuint* pColorRenderbuffer, GLuint* pDepthRenderbuffer)
+{
+    u32 color_internal_format, depth_internal_format, format, type;
+    WindowFormatGetGL(gFramebufferPlan.color_format, &color_internal_format, &format, &type);
+    WindowFormatGetGL(gFramebufferPlan.depth_format, &depth_internal_format, &format, &type);
+
+    glGenRenderbuffers(1, pColorRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, *pColorRenderbuffer);
+    if (samples > 1)
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, color_internal_format, width, height);
+    else
+        glRenderbufferStorage(GL_RENDERBUFFER, color_internal_format, width, height);
+
+    if (pDepthRenderbuffer)
+    {
+        glGenRenderbuffers(1, pDepthRenderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, *pDepthRenderbuffer);
+        if (samples > 1)
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, depth_internal_format, width, height);
+        else
+            glRenderbufferStorage(GL_RENDERBUFFER, depth_internal_format, width, height);
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, GL_NONE);
+
+    glGenFramebuffers(1, pFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, *pFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, *pColorRenderbuffer);
+    if (pDepthRenderbuffer)
+    {
+        glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER,
+            gFramebufferPlan.depth_format == WINDOW_RT_FORMAT_D24S8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+            GL_RENDERBUFFER,
+            *pDepthRenderbuffer
+        );
+    }
+
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void WindowDestroyFramebufferWin(GLuint* pFramebuffer, GLuint* pColorRenderbuffer, GLuint* pDepthRenderbuffer)
+{
+    if (*pFramebuffer == GL_NONE)
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+    glDeleteFramebuffers(1, pFramebuffer);
+    glDeleteRenderbuffers(1, pColorRenderbuffer);
+    *pFramebuffer = GL_NONE;
+    *pColorRenderbuffer = GL_NONE;
+
+    if (pDepthRenderbuffer)
+    {
+        glDeleteRenderbuffers(1, pDepthRenderbuffer);
+        *pDepthRenderbuffer = GL_NONE;
+    }
+}
+
+// Resolve and upscale the scene framebuffer to the window framebuffer
+static void WindowPresentSceneWin()
+{
+#ifdef TEST_WIN_HEADLESS
+    GLuint output_framebuffer = gFramebufferWin;
+#else
+    GLuint output_framebuffer = 0;
+#endif // TEST_WIN_HEADLESS
+
+    bool scaled = gRenderWidth != gFramebufferWidth || gRenderHeight != gFramebufferHeight;
+    GLuint source_framebuffer = gSceneFramebufferWin;
+
+    // The scissor test also applies to blits
+    glDisable(GL_SCISSOR_TEST);
+
+    if (gFramebufferPlan.samples > 1)
+    {
+        // Resolve blits must not scale, and the default framebuffer may not have the format of the scene,
+        // so resolve straight to the window framebuffer only when rendering off-screen at full size
+#ifdef TEST_WIN_HEADLESS
+        bool direct = !scaled;
+#else
+        bool direct = false;
+#endif // TEST_WIN_HEADLESS
+
+        GLuint resolve_framebuffer = output_framebuffer;
+        if (!direct)
+        {
+            if (gResolveFramebufferWin == GL_NONE
+                && !WindowCreateFramebufferWin(gFramebufferWidth, gFramebufferHeight, 1, &gResolveFramebufferWin,
+                                               &gResolveColorRenderbufferWin, NULL))
+            {
+                WindowDestroyFramebufferWin(&gResolveFramebufferWin, &gResolveColorRenderbufferWin, NULL);
+            }
+
+            resolve_framebuffer = gResolveFramebufferWin;
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gSceneFramebufferWin);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_framebuffer);
+        glBlitFramebuffer(0, 0, gRenderWidth, gRenderHeight,
+                          0, 0, gRenderWidth, gRenderHeight,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        source_framebuffer = resolve_framebuffer;
+    }
+
+    if (source_framebuffer != output_framebuffer)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source_framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output_framebuffer);
+        glBlitFramebuffer(0, 0, gRenderWidth, gRenderHeight,
+                          0, 0, gFramebufferWidth, gFramebufferHeight,
+                          GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, gSceneFramebufferWin);
+    glEnable(GL_SCISSOR_TEST);
+}
+
+#endif // TEST_WIN
+
+#ifdef TEST_WIN
+
+// Number of full-screen triangles drawn to check the GPU timer, and GPU time under which they are
+// too quick to tell anything (the timer is then trusted)
+#define WINDOW_GPU_TIMER_PROBE_DRAWS    8
+#define WINDOW_GPU_TIMER_PROBE_MIN_TIME 0.001
+
+static GLuint WindowCompileShaderWin(GLenum type, const char* source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+// Draw full-screen triangles between two timestamps, and check that the timestamps are as far apart as
+// the GPU took to draw them
+// Some implementations (e.g. software renderers) write the same timestamp for every command they run at
+// once, however long those commands take
+static bool WindowGpuTimerProbeWin()
+{
+    GLuint vertex_shader = WindowCompileShaderWin(GL_VERTEX_SHADER,
+        "#version 330 core\n"
+        "void main() { gl_Position = vec4(float(gl_VertexID & 1) * 4.0 - 1.0, float(gl_VertexID & 2) * 2.0 - 1.0, 0.0, 1.0); }\n");
+    GLuint pixel_shader = WindowCompileShaderWin(GL_FRAGMENT_SHADER,
+        "#version 330 core\n"
+        "out vec4 o_FragColor;\n"
+        "void main() { o_FragColor = vec4(fract(gl_FragCoord.xy * 0.01), 0.0, 1.0); }\n");
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, pixel_shader);
+    glLinkProgram(program);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(pixel_shader);
+
+    GLuint vertex_array;
+    glGenVertexArrays(1, &vertex_array);
+    glBindVertexArray(vertex_array);
+    glUseProgram(program);
+
+    // Once first, so that compiling the program is not part of the time measured
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glFinish();
+
+    // Time from submitting the draws to the GPU being done with them
+    // (Software renderers may draw while flushing: glFinish alone would return at once)
+    f64 start_time = WindowGetTime();
+    glQueryCounter(gGpuTimerQueriesWin[0][0], GL_TIMESTAMP);
+    for (u32 i = 0; i < WINDOW_GPU_TIMER_PROBE_DRAWS; i++)
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    glQueryCounter(gGpuTimerQueriesWin[0][1], GL_TIMESTAMP);
+    glFinish();
+    f64 wait_time = WindowGetTime() - start_time;
+
+    GLuint64 start = 0, end = 0;
+    glGetQueryObjectui64v(gGpuTimerQueriesWin[0][0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(gGpuTimerQueriesWin[0][1], GL_QUERY_RESULT, &end);
+
+    glUseProgram(GL_NONE);
+    glBindVertexArray(GL_NONE);
+    glDeleteVertexArrays(1, &vertex_array);
+    glDeleteProgram(program);
+
+    if (start == 0 || end <= start)
+        return false;
+
+    // The draws took long enough to be seen: the timer must have seen at least a part of them
+    f64 gpu_time = (f64)(end - start) * 1e-9;
+    return wait_time < WINDOW_GPU_TIMER_PROBE_MIN_TIME || gpu_time >= wait_time * 0.1;
+}
+
+#endif // TEST_WIN
+
+// Create the GPU timer and check once that it measures anything
+// If it does not, dynamic resolution is driven by the CPU time of the frames instead, for good
+static void WindowGpuTimerInit()
+{
+    gGpuTimerFrame = 0;
+    gGpuFrameTime = 0.0;
+    gSwapFrameTime = 0.0;
+
+#ifdef TEST_WIN
+    glGenQueries(WINDOW_GPU_TIMER_FRAMES * 2, &gGpuTimerQueriesWin[0][0]);
+    memset(gGpuTimerPendingWin, 0, sizeof(gGpuTimerPendingWin));
+
+    GLint counter_bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &counter_bits);
+    gGpuTimerUsable = counter_bits > 0 && WindowGpuTimerProbeWin();
+#else
+    gGpuTimerUsable = true;
+#endif // TEST_WIN
+}
+
+// Mark the start of a frame on the GPU
+static void WindowGpuTimerBegin()
+{
+    if (!gGpuTimerUsable)
+        return;
+
+    u32 slot = gGpuTimerFrame % WINDOW_GPU_TIMER_FRAMES;
+    gGpuTimerScale[slot] = gRenderScale;
+
+#ifdef TEST_WIN
+    glQueryCounter(gGpuTimerQueriesWin[slot][0], GL_TIMESTAMP);
+#else
+    // Clear the timestamps and flush them out of the CPU cache,
+    // so that a later eviction of the cache line cannot overwrite what the GPU writes
+    gGpuTimestamps[slot][0] = 0;
+    gGpuTimestamps[slot][1] = 0;
+    DCFlushRange(gGpuTimestamps[slot], sizeof(gGpuTimestamps[slot]));
+
+    // Sampled when the GPU starts processing the commands of the frame
+    GX2SampleTopGPUCycle(&gGpuTimestamps[slot][0]);
+#endif // TEST_WIN
+}
+
+// Mark the end of a frame on the GPU
+static void WindowGpuTimerEnd()
+{
+    if (!gGpuTimerUsable)
+        return;
+
+    u32 slot = gGpuTimerFrame % WINDOW_GPU_TIMER_FRAMES;
+
+#ifdef TEST_WIN
+    glQueryCounter(gGpuTimerQueriesWin[slot][1], GL_TIMESTAMP);
+    gGpuTimerPendingWin[slot] = true;
+#else
+    // Sampled once all previous commands have finished
+    GX2SampleBottomGPUCycle(&gGpuTimestamps[slot][1]);
+#endif // TEST_WIN
+
+    gGpuTimerFrame++;
+}
+
+// Read the GPU time of the oldest frame being timed
+// Returns 0 if it is not known (yet)
+static f64 WindowGpuTimerRead(f32* pScale)
+{
+    *pScale = gRenderScale;
+    if (!gGpuTimerUsable)
+        return 0.0;
+
+    u32 slot = gGpuTimerFrame % WINDOW_GPU_TIMER_FRAMES;
+    *pScale = gGpuTimerScale[slot];
+
+#ifdef TEST_WIN
+    if (!gGpuTimerPendingWin[slot])
+        return 0.0;
+
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(gGpuTimerQueriesWin[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return 0.0;
+
+    GLuint64 start, end;
+    glGetQueryObjectui64v(gGpuTimerQueriesWin[slot][0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(gGpuTimerQueriesWin[slot][1], GL_QUERY_RESULT, &end);
+    gGpuTimerPendingWin[slot] = false;
+
+    return end > start ? (f64)(end - start) * 1e-9 : 0.0;
+#else
+    DCInvalidateRange(gGpuTimestamps[slot], sizeof(gGpuTimestamps[slot]));
+
+    u64 start = gGpuTimestamps[slot][0];
+    u64 end = gGpuTimestamps[slot][1];
+    if (start == 0 || end <= start)
+        return 0.0;
+
+    return (f64)GX2GPUTimeToCPUTime(end - start) / OSTimerClockSpeed;
+#endif // TEST_WIN
+}
+
+// Resize the buffers the scene is rendered into and set the default viewport and scissor to match
+static void WindowApplyRenderScale(f32 scale)
+{
+    u32 width = gFramebufferWidth;
+    u32 height = gFramebufferHeight;
+
+    // Below full resolution, round down to a multiple of 8 pixels (the tile size on Wii U)
+    if (scale < 1.0f)
+    {
+        width = (u32)(gFramebufferWidth * scale) & ~7u;
+        height = (u32)(gFramebufferHeight * scale) & ~7u;
+        if (width < 8)
+            width = 8;
+        if (height < 8)
+            height = 8;
+    }
+
+    gRenderScale = scale;
+    gRenderWidth = width;
+    gRenderHeight = height;
+
+#ifdef TEST_WIN
+
+    // The window framebuffer cannot be resized, so render into a framebuffer of the full size instead
+    // and only use the render size region of it (blitted to the window framebuffer when swapping)
+    if (gSceneFramebufferWin == GL_NONE)
+    {
+        if (!WindowCreateFramebufferWin(gFramebufferWidth, gFramebufferHeight, gFramebufferPlan.samples, &gSceneFramebufferWin,
+                                        &gSceneColorRenderbufferWin, &gSceneDepthRenderbufferWin))
+        {
+            WindowDestroyFramebufferWin(&gSceneFramebufferWin, &gSceneColorRenderbufferWin, &gSceneDepthRenderbufferWin);
+            gRenderScale = 1.0f;
+            gRenderWidth = width = gFramebufferWidth;
+            gRenderHeight = height = gFramebufferHeight;
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, WindowGetFramebuffer());
+    glViewport(0, 0, width, height);
+    glScissor(0, 0, width, height);
+
+#else
+
+    // The buffers keep their memory (allocated for the full size), only their surface size changes
+    // GX2CopyColorBufferToScanBuffer then upscales the color buffer to the TV and DRC scan buffers
+    gColorBuffer.surface.width = width;
+    gColorBuffer.surface.height = height;
+    GX2CalcSurfaceSizeAndAlignment(&gColorBuffer.surface);
+    GX2InitColorBufferRegs(&gColorBuffer);
+
+    if (gColorBufferAuxData)
+    {
+        u32 aa_size, aa_alignment;
+        GX2CalcColorBufferAuxInfo(&gColorBuffer, &aa_size, &aa_alignment);
+        gColorBuffer.aaSize = aa_size;
+
+        gResolveColorBuffer.surface.width = width;
+        gResolveColorBuffer.surface.height = height;
+        GX2CalcSurfaceSizeAndAlignment(&gResolveColorBuffer.surface);
+        GX2InitColorBufferRegs(&gResolveColorBuffer);
+    }
+
+    gDepthBuffer.surface.width = width;
+    gDepthBuffer.surface.height = height;
+    GX2CalcSurfaceSizeAndAlignment(&gDepthBuffer.surface);
+    GX2InitDepthBufferRegs(&gDepthBuffer);
+
+    GX2SetColorBuffer(&gColorBuffer, GX2_RENDER_TARGET_0);
+    GX2SetDepthBuffer(&gDepthBuffer);
+    GX2SetViewport(0, 0, width, height, 0.0f, 1.0f);
+    GX2SetScissor(0, 0, width, height);
+
+#endif // TEST_WIN
+}
+
+#ifdef TEST_WIN_HEADLESS
+
+static bool WindowInitEGL()
+{
+    // Prefer the Mesa surfaceless platform, which does not need any display server
+    const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (client_extensions && strstr(client_extensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay)
+        gDisplayWin = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+    // Otherwise, fall back to the default display and a pbuffer surface
+    if (gDisplayWin == EGL_NO_DISPLAY)
+        gDisplayWin = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (gDisplayWin == EGL_NO_DISPLAY || !eglInitialize(gDisplayWin, NULL, NULL))
+        return false;
+
+    // Request desktop OpenGL rather than OpenGL ES
+    if (!eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE,        8,
+        EGL_GREEN_SIZE,      8,
+        EGL_BLUE_SIZE,       8,
+        EGL_ALPHA_SIZE,      8,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint num_configs = 0;
+    if (!eglChooseConfig(gDisplayWin, config_attribs, &config, 1, &num_configs) || num_configs < 1)
+        return false;
+
+    // Request OpenGL v3.3 Core
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION,       3,
+        EGL_CONTEXT_MINOR_VERSION,       3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    gContextWin = eglCreateContext(gDisplayWin, config, EGL_NO_CONTEXT, context_attribs);
+    if (gContextWin == EGL_NO_CONTEXT)
+        return false;
+
+    // We never render to the EGL surface itself (rendering goes to an FBO),
+    // so only create a tiny pbuffer if surfaceless contexts are not supported
+    const char* display_extensions = eglQueryString(gDisplayWin, EGL_EXTENSIONS);
+    if (!display_extensions || !strstr(display_extensions, "EGL_KHR_surfaceless_context"))
+    {
+        const EGLint pbuffer_attribs[] = {
+            EGL_WIDTH,  1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+
+        gSurfaceWin = eglCreatePbufferSurface(gDisplayWin, config, pbuffer_attribs);
+        if (gSurfaceWin == EGL_NO_SURFACE)
+            return false;
+    }
+
+    return true;
+}
+
+#endif // TEST_WIN_HEADLESS
+
+static bool WindowInitImpl(u32 width, u32 height, u32* pWidth, u32* pHeight)
 {
     // Prevent re-initialization
     if (gInitialized)
         return false;
 
 #ifdef TEST_WIN
+    // Choose the formats and memory layout of the window buffers from the window hints
+    if (!WindowPlanFramebuffer(width, height, &gFramebufferPlan))
+        return false;
+#endif // TEST_WIN
+
+#ifdef TEST_WIN
+
+#ifdef TEST_WIN_HEADLESS
+
+    // Create an off-screen OpenGL v3.3 Core context through EGL
+    if (!WindowInitEGL())
+    {
+        WindowExit();
+        return false;
+    }
+
+    // The framebuffer is an FBO of exactly the requested size
+    u32 fb_width = gFramebufferPlan.width;
+    u32 fb_height = gFramebufferPlan.height;
+
+    // Optional frame limit so that a headless run can terminate on its own
+    const char* frame_limit = getenv("TEST_HEADLESS_FRAMES");
+    if (frame_limit)
+        gFrameLimitWin = (u32)strtoul(frame_limit, NULL, 10);
+
+#else
 
     // Initialize GLFW
     if (!glfwInit())
@@ -57,6 +701,25 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    // Request the planned color and depth precision
+    // (GLFW picks the closest match; there is no floating-point default framebuffer)
+    static const int color_bits[WINDOW_RT_FORMAT_COUNT][4] = {
+        { 8, 8, 8, 8 },      // RGBA8
+        { 10, 10, 10, 2 },   // RGB10_A2
+        { 16, 16, 16, 16 },  // RGBA16F
+    };
+    static const int depth_bits[WINDOW_RT_FORMAT_COUNT][2] = {
+        [WINDOW_RT_FORMAT_D32F] = { 32, 0 },
+        [WINDOW_RT_FORMAT_D24S8] = { 24, 8 },
+        [WINDOW_RT_FORMAT_D16] = { 16, 0 },
+    };
+    glfwWindowHint(GLFW_RED_BITS, color_bits[gFramebufferPlan.color_format][0]);
+    glfwWindowHint(GLFW_GREEN_BITS, color_bits[gFramebufferPlan.color_format][1]);
+    glfwWindowHint(GLFW_BLUE_BITS, color_bits[gFramebufferPlan.color_format][2]);
+    glfwWindowHint(GLFW_ALPHA_BITS, color_bits[gFramebufferPlan.color_format][3]);
+    glfwWindowHint(GLFW_DEPTH_BITS, depth_bits[gFramebufferPlan.depth_format][0]);
+    glfwWindowHint(GLFW_STENCIL_BITS, depth_bits[gFramebufferPlan.depth_format][1]);
+
     // Assume double-buffering is already on
 
     // Create the window instance
@@ -70,8 +733,18 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
     int fb_width, fb_height;
     glfwGetFramebufferSize(gWindowHandleWin, &fb_width, &fb_height);
 
+#endif // TEST_WIN_HEADLESS
+
 #else // TEST_GX2
 
+    // ProcUI tells the application when it must release or can acquire the foreground, or must exit
+    // (see WindowIsRunning); it may already have been initialized by the application
+    if (!ProcUIIsRunning())
+    {
+        ProcUIInit(OSSavesDone_ReadyToRelease);
+        gOwnsProcUI = true;
+    }
+
     // Allocate GX2 command buffer
     gCmdlist = MEMAllocFromDefaultHeapEx(
         0x400000,                    // A very commonly used size in Nintendo games
@@ -97,42 +770,28 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
     gMEM1HeapHandle = MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM1);
     gFgHeapHandle = MEMGetBaseHeapHandle(MEM_BASE_HEAP_FG);
 
-    u32 fb_width, fb_height;
-    u32 drc_width, drc_height;
+    // Everything allocated from them from now on is freed at once when the foreground is released
+    MEMRecordStateForFrmHeap(gMEM1HeapHandle, WINDOW_FRM_HEAP_STATE);
+    MEMRecordStateForFrmHeap(gFgHeapHandle, WINDOW_FRM_HEAP_STATE);
+    gHeapStatesRecorded = true;
+    gNumForegroundBuffers = 0;
 
-    // Allocate TV scan buffer
+    // Choose the formats and memory layout of the window buffers from the window hints
+    // (The planner uses GX2 to calculate surface sizes, so it must run after GX2Init)
+    if (!WindowPlanFramebuffer(width, height, &gFramebufferPlan))
     {
-        GX2TVRenderMode tv_render_mode;
+        WindowExit();
+        return false;
+    }
 
-        // Get current TV scan mode
-        GX2TVScanMode tv_scan_mode = GX2GetSystemTVScanMode();
+    // The framebuffer has the size of the TV scan buffer chosen by the planner
+    u32 fb_width = gFramebufferPlan.width;
+    u32 fb_height = gFramebufferPlan.height;
+    u32 drc_width, drc_height;
 
-        // Determine TV framebuffer dimensions (scan buffer, specifically)
-        if (tv_scan_mode != GX2_TV_SCAN_MODE_576I && tv_scan_mode != GX2_TV_SCAN_MODE_480I
-            && width >= 1920 && height >= 1080)
-        {
-            fb_width = 1920;
-            fb_height = 1080;
-            tv_render_mode = GX2_TV_RENDER_MODE_WIDE_1080P;
-        }
-        else if (width >= 1280 && height >= 720)
-        {
-            fb_width = 1280;
-            fb_height = 720;
-            tv_render_mode = GX2_TV_RENDER_MODE_WIDE_720P;
-        }
-        else if (width >= 850 && height >= 480)
-        {
-            fb_width = 854;
-            fb_height = 480;
-            tv_render_mode = GX2_TV_RENDER_MODE_WIDE_480P;
-        }
-        else // if (width >= 640 && height >= 480)
-        {
-            fb_width = 640;
-            fb_height = 480;
-            tv_render_mode = GX2_TV_RENDER_MODE_STANDARD_480P;
-        }
+    // Allocate TV scan buffer
+    {
+        GX2TVRenderMode tv_render_mode = WindowFormatGetTVRenderMode(fb_width);
 
         // Calculate TV scan buffer byte size
         u32 tv_scan_buffer_size, unk;
@@ -145,11 +804,13 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
         );
 
         // Allocate TV scan buffer
-        gTvScanBuffer = MEMAllocFromFrmHeapEx(
+        WindowAllocForegroundBuffer(
+            &gTvScanBuffer,
             gFgHeapHandle,
             tv_scan_buffer_size,
             GX2_SCAN_BUFFER_ALIGNMENT // Required alignment
         );
+        gTvScanBufferSize = tv_scan_buffer_size;
 
         if (!gTvScanBuffer)
         {
@@ -189,11 +850,13 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
         );
 
         // Allocate DRC scan buffer
-        gDrcScanBuffer = MEMAllocFromFrmHeapEx(
+        WindowAllocForegroundBuffer(
+            &gDrcScanBuffer,
             gFgHeapHandle,
             drc_scan_buffer_size,
             GX2_SCAN_BUFFER_ALIGNMENT // Required alignment
         );
+        gDrcScanBufferSize = drc_scan_buffer_size;
 
         if (!gDrcScanBuffer)
         {
@@ -223,21 +886,26 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
     gColorBuffer.surface.height = fb_height;
     gColorBuffer.surface.depth = 1;
     gColorBuffer.surface.mipLevels = 1;
-    gColorBuffer.surface.format = GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8;
-    gColorBuffer.surface.aa = GX2_AA_MODE1X;
-    gColorBuffer.surface.use = GX2_SURFACE_USE_TEXTURE_COLOR_BUFFER_TV;
+    gColorBuffer.surface.format = WindowFormatGetSurfaceFormat(gFramebufferPlan.color_format);
+    gColorBuffer.surface.aa = WindowFormatGetAAMode(gFramebufferPlan.samples);
+    // A multisampled color buffer can't be copied to the scan buffers (its resolve buffer is instead)
+    gColorBuffer.surface.use = gFramebufferPlan.samples > 1 ? GX2_SURFACE_USE_COLOR_BUFFER
+                                                            : GX2_SURFACE_USE_TEXTURE_COLOR_BUFFER_TV;
     gColorBuffer.surface.mipmaps = NULL;
     gColorBuffer.surface.tileMode = GX2_TILE_MODE_DEFAULT;
     gColorBuffer.surface.swizzle  = 0;
     gColorBuffer.viewMip = 0;
     gColorBuffer.viewFirstSlice = 0;
     gColorBuffer.viewNumSlices = 1;
+    gColorBuffer.aaBuffer = NULL;
+    gColorBuffer.aaSize = 0;
     GX2CalcSurfaceSizeAndAlignment(&gColorBuffer.surface);
     GX2InitColorBufferRegs(&gColorBuffer);
 
-    // Allocate color buffer data
-    gColorBufferImageData = MEMAllocFromFrmHeapEx(
-        gMEM1HeapHandle,
+    // Allocate color buffer data in the memory chosen by the planner
+    WindowAllocBuffer(
+        &gColorBufferImageData,
+        gFramebufferPlan.color_memory,
         gColorBuffer.surface.imageSize, // Data byte size
         gColorBuffer.surface.alignment  // Required alignment
     );
@@ -253,14 +921,64 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
     // Flush allocated buffer from CPU cache
     GX2Invalidate(GX2_INVALIDATE_MODE_CPU, gColorBufferImageData, gColorBuffer.surface.imageSize);
 
+    if (gFramebufferPlan.samples > 1)
+    {
+        // Allocate the auxiliary buffer of the multisampled color buffer
+        u32 aa_size, aa_alignment;
+        GX2CalcColorBufferAuxInfo(&gColorBuffer, &aa_size, &aa_alignment);
+
+        WindowAllocBuffer(&gColorBufferAuxData, gFramebufferPlan.color_memory, aa_size, aa_alignment);
+        if (!gColorBufferAuxData)
+        {
+            WindowExit();
+            return false;
+        }
+
+        gColorBuffer.aaBuffer = gColorBufferAuxData;
+        gColorBuffer.aaSize = aa_size;
+        gColorBufferAuxSize = aa_size;
+
+        // The auxiliary buffer must start out in its cleared state
+        memset(gColorBufferAuxData, WINDOW_AA_BUFFER_CLEAR_VALUE, aa_size);
+        COHERENCY_CPU_WRITE(gColorBufferAuxData, aa_size);
+        GX2Invalidate(GX2_INVALIDATE_MODE_CPU, gColorBufferAuxData, aa_size);
+
+        // Initialize the resolve buffer, a single-sample color buffer copied to the scan buffers
+        gResolveColorBuffer = gColorBuffer;
+        gResolveColorBuffer.surface.aa = GX2_AA_MODE1X;
+        gResolveColorBuffer.surface.use = GX2_SURFACE_USE_TEXTURE_COLOR_BUFFER_TV;
+        gResolveColorBuffer.surface.tileMode = GX2_TILE_MODE_DEFAULT;
+        gResolveColorBuffer.surface.image = NULL;
+        gResolveColorBuffer.aaBuffer = NULL;
+        gResolveColorBuffer.aaSize = 0;
+        GX2CalcSurfaceSizeAndAlignment(&gResolveColorBuffer.surface);
+        GX2InitColorBufferRegs(&gResolveColorBuffer);
+
+        WindowAllocBuffer(
+            &gResolveColorBufferImageData,
+            gFramebufferPlan.color_memory,
+            gResolveColorBuffer.surface.imageSize,
+            gResolveColorBuffer.surface.alignment
+        );
+
+        if (!gResolveColorBufferImageData)
+        {
+            WindowExit();
+            return false;
+        }
+
+        gResolveColorBuffer.surface.image = gResolveColorBufferImageData;
+        GX2Invalidate(GX2_INVALIDATE_MODE_CPU, gResolveColorBufferImageData, gResolveColorBuffer.surface.imageSize);
+    }
+
     // Initialize depth buffer
     gDepthBuffer.surface.dim = GX2_SURFACE_DIM_TEXTURE_2D;
     gDepthBuffer.surface.width = fb_width;
     gDepthBuffer.surface.height = fb_height;
     gDepthBuffer.surface.depth = 1;
     gDepthBuffer.surface.mipLevels = 1;
-    gDepthBuffer.surface.format = GX2_SURFACE_FORMAT_FLOAT_R32;
-    gDepthBuffer.surface.aa = GX2_AA_MODE1X;
+    gDepthBuffer.surface.format = WindowFormatGetSurfaceFormat(gFramebufferPlan.depth_format);
+    gDepthBuffer.surface.aa = WindowFormatGetAAMode(gFramebufferPlan.samples);
     gDepthBuffer.surface.use = GX2_SURFACE_USE_TEXTURE | GX2_SURFACE_USE_DEPTH_BUFFER;
     gDepthBuffer.surface.mipmaps = NULL;
     gDepthBuffer.surface.tileMode = GX2_TILE_MODE_DEFAULT;
@@ -275,9 +993,10 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
     GX2CalcSurfaceSizeAndAlignment(&gDepthBuffer.surface);
     GX2InitDepthBufferRegs(&gDepthBuffer);
 
-    // Allocate depth buffer data
-    gDepthBufferImageData = MEMAllocFromFrmHeapEx(
-        gMEM1HeapHandle,
+    // Allocate depth buffer data in the memory chosen by the planner
+    WindowAllocBuffer(
+        &gDepthBufferImageData,
+        gFramebufferPlan.depth_memory,
         gDepthBuffer.surface.imageSize, // Data byte size
         gDepthBuffer.surface.alignment  // Required alignment
     );
@@ -313,18 +1032,68 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
     // Make context of window current
     WindowMakeContextCurrent();
 
+    // Determine the duration of one display refresh for frame pacing
+    f64 refresh_period;
+#ifdef TEST_WIN
+#ifdef TEST_WIN_HEADLESS
+    refresh_period = 0.0; // No display
+#else
+    const GLFWvidmode* video_mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    refresh_period = (video_mode && video_mode->refreshRate > 0) ? 1.0 / video_mode->refreshRate : 1.0 / 60.0;
+#endif // TEST_WIN_HEADLESS
+#else
+    refresh_period = GX2GetSystemTVScanMode() == GX2_TV_SCAN_MODE_576I ? 1.0 / 50.0 : 1001.0 / 60000.0;
+#endif
+    FramePacingInit(&gFramePacing, refresh_period, 1);
+
+    // Start the vsync and flip events, so that swapping does not have to wait for the flip
+    WindowVsyncInit(refresh_period);
+    gPacedFlips = 0;
+
     // Set swap interval to 1 by default
     WindowSetSwapInterval(1);
 
 #ifdef TEST_WIN
 
     // Initialize GLEW
-    if (glewInit() != GLEW_OK)
+    GLenum glew_result = glewInit();
+#ifdef TEST_WIN_HEADLESS
+    // Unless GLEW was built with GLEW_EGL, it also looks for a GLX display after loading the GL entry
+    // points, and fails without one: that is fine under EGL, as long as the entry points were loaded
+    if (glew_result == GLEW_ERROR_NO_GLX_DISPLAY && glGenFramebuffers && glFenceSync && glQueryCounter)
+        glew_result = GLEW_OK;
+#endif // TEST_WIN_HEADLESS
+    if (glew_result != GLEW_OK)
     {
         WindowExit();
         return false;
     }
 
+#ifdef TEST_WIN_HEADLESS
+
+    // Create the off-screen framebuffer and make it the current one
+    // (Color and depth storage equivalent to the default framebuffer of a GLFW window)
+    if (!WindowCreateFramebufferWin(fb_width, fb_height, 1, &gFramebufferWin, &gColorRenderbufferWin, &gDepthRenderbufferWin))
+    {
+        WindowExit();
+        return false;
+    }
+
+    gStartTimeWin = WindowGetTime();
+
+#endif // TEST_WIN_HEADLESS
+
+    // Render into a multisampled framebuffer, resolved to the window framebuffer when swapping
+    if (gFramebufferPlan.samples > 1)
+    {
+        if (!WindowCreateFramebufferWin(fb_width, fb_height, gFramebufferPlan.samples, &gSceneFramebufferWin,
+                                        &gSceneColorRenderbufferWin, &gSceneDepthRenderbufferWin))
+        {
+            WindowExit();
+            return false;
+        }
+    }
+
     // Enable scissor test
     glEnable(GL_SCISSOR_TEST);
 
@@ -349,24 +1118,54 @@ bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
         GX2_COMPARE_FUNC_LEQUAL // Depth Function; equivalent to glDepthFunc(GL_LEQUAL)
     );
 
-    // TODO: ProcUI
-
 #endif
 
+    gFramebufferWidth = fb_width;
+    gFramebufferHeight = fb_height;
+
+    gRenderScale = 1.0f;
+    gRenderWidth = fb_width;
+    gRenderHeight = fb_height;
+
+    // Time the first frame on the GPU
+    WindowGpuTimerInit();
+    WindowGpuTimerBegin();
+    gFrameWorkStart = WindowGetTime();
+
     // Set the output framebuffer size pointers
     if (pWidth)
         *pWidth = fb_width;
     if (pHeight)
         *pHeight = fb_height;
 
+    gInForeground = true;
+    gExitRequested = false;
+    memset(&gLifecycleStats, 0, sizeof(gLifecycleStats));
+
     gInitialized = true;
     return true;
 }
 
+bool WindowInit(u32 width, u32 height, u32* pWidth, u32* pHeight)
+{
+    TraceBegin("WindowInit");
+    bool success = WindowInitImpl(width, height, pWidth, pHeight);
+    TraceEnd();
+    return success;
+}
+
 void WindowMakeContextCurrent()
 {
 #ifdef TEST_WIN
+#ifdef TEST_WIN_HEADLESS
+    eglMakeCurrent(gDisplayWin, gSurfaceWin, gSurfaceWin, gContextWin);
+    if (gFramebufferWin != GL_NONE)
+        glBindFramebuffer(GL_FRAMEBUFFER, WindowGetFramebuffer());
+#else
     glfwMakeContextCurrent(gWindowHandleWin);
+    if (gSceneFramebufferWin != GL_NONE)
+        glBindFramebuffer(GL_FRAMEBUFFER, gSceneFramebufferWin);
+#endif // TEST_WIN_HEADLESS
 #else
     GX2SetContextState(gContext);
     GX2SetColorBuffer(&gColorBuffer, GX2_RENDER_TARGET_0);
@@ -374,67 +1173,702 @@ void WindowMakeContextCurrent()
 #endif
 }
 
-void WindowSetSwapInterval(u32 swap_interval)
+static void WindowApplySwapInterval(u32 swap_interval)
 {
 #ifdef TEST_WIN
+#ifdef TEST_WIN_HEADLESS
+    // There is no display to synchronize with when rendering off-screen
+    (void)swap_interval;
+#else
     glfwSwapInterval(swap_interval);
+#endif // TEST_WIN_HEADLESS
 #else
     GX2SetSwapInterval(swap_interval);
 #endif
 }
 
-bool WindowIsRunning()
+void WindowSetSwapInterval(u32 swap_interval)
+{
+    FramePacingSetBaseInterval(&gFramePacing, swap_interval);
+    WindowApplySwapInterval(swap_interval);
+}
+
+void WindowSetAdaptiveSwapInterval(bool enable)
+{
+    gFramePacing.adaptive = enable;
+
+    // Go back to the requested swap interval when disabling
+    if (!enable && gFramePacing.interval != gFramePacing.base_interval)
+        WindowSetSwapInterval(gFramePacing.base_interval);
+}
+
+void WindowGetFrameStats(WindowFrameStats* pStats)
+{
+    pStats->frames = gFramePacing.frames;
+    pStats->late_frames = gFramePacing.late_frames;
+    pStats->missed_vblanks = gFramePacing.missed_vblanks;
+    pStats->swap_interval = gFramePacing.interval;
+    pStats->interval_switches = gFramePacing.interval_switches;
+    pStats->last_frame_ms = gFramePacing.last_frame_time * 1000.0;
+    pStats->avg_frame_ms = gFramePacing.avg_frame_time * 1000.0;
+    pStats->refresh_ms = gFramePacing.refresh_period * 1000.0;
+    pStats->gpu_frame_ms = gGpuFrameTime * 1000.0;
+    pStats->swap_frame_ms = gSwapFrameTime * 1000.0;
+    pStats->gpu_timer = gGpuTimerUsable;
+    pStats->render_scale = gRenderScale;
+    pStats->scale_changes = gDynamicResolution.scale_changes;
+}
+
+void WindowSetRenderScale(f32 scale)
+{
+    if (scale < 0.25f)
+        scale = 0.25f;
+    if (scale > 1.0f)
+        scale = 1.0f;
+
+    if (gDynamicResolutionEnabled)
+        gDynamicResolution.scale = scale;
+
+    if (scale != gRenderScale)
+        WindowApplyRenderScale(scale);
+}
+
+f32 WindowGetRenderScale()
+{
+    return gRenderScale;
+}
+
+void WindowGetRenderSize(u32* pWidth, u32* pHeight)
+{
+    if (pWidth)
+        *pWidth = gRenderWidth;
+    if (pHeight)
+        *pHeight = gRenderHeight;
+}
+
+void WindowSetDynamicResolution(bool enable, f32 min_scale, f64 target_ms)
+{
+    gDynamicResolutionEnabled = enable;
+
+    // Go back to full resolution when disabling
+    if (!enable)
+    {
+        WindowSetRenderScale(1.0f);
+        return;
+    }
+
+    if (min_scale < 0.25f)
+        min_scale = 0.25f;
+    if (min_scale > 1.0f)
+        min_scale = 1.0f;
+
+    // By default, aim for the duration of the swap interval
+    f64 target_time = target_ms / 1000.0;
+    if (target_time <= 0.0)
+    {
+        if (gFramePacing.refresh_period > 0.0 && gFramePacing.base_interval > 0)
+            target_time = gFramePacing.refresh_period * gFramePacing.base_interval;
+        else
+            target_time = 1.0 / 60.0;
+    }
+
+    // Start from the current scale
+    DynamicResolutionInit(&gDynamicResolution, min_scale, 1.0f, target_time);
+    gDynamicResolution.scale = gRenderScale;
+}
+
+void WindowGetFramebufferPlan(WindowFramebufferPlan* pPlan)
+{
+    *pPlan = gFramebufferPlan;
+}
+
+void WindowGetFramebufferSize(u32* pWidth, u32* pHeight)
+{
+    if (pWidth)
+        *pWidth = gFramebufferWidth;
+    if (pHeight)
+        *pHeight = gFramebufferHeight;
+}
+
+f64 WindowGetTime()
+{
+#ifdef TEST_WIN
+#ifdef TEST_WIN_HEADLESS
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+#else
+    return glfwGetTime();
+#endif // TEST_WIN_HEADLESS
+#else
+    return (f64)OSGetSystemTime() / OSTimerClockSpeed;
+#endif
+}
+
+// Free the window buffers that only exist while the application is in the foreground
+// Returns the number of bytes given back
+static u32 WindowFreeForegroundBuffers()
+{
+#ifdef TEST_WIN
+
+    // Nothing is given back to a system on PC, so count what the buffers would take on Wii U
+    u32 size = gFramebufferPlan.scan_buffers_size;
+    if (gFramebufferPlan.color_memory == WINDOW_MEMORY_MEM1)
+        size += gFramebufferPlan.color_size;
+    if (gFramebufferPlan.depth_memory == WINDOW_MEMORY_MEM1)
+        size += gFramebufferPlan.depth_size;
+
+    gSceneFramebufferReleasedWin = gSceneFramebufferWin != GL_NONE;
+    WindowDestroyFramebufferWin(&gResolveFramebufferWin, &gResolveColorRenderbufferWin, NULL);
+    WindowDestroyFramebufferWin(&gSceneFramebufferWin, &gSceneColorRenderbufferWin, &gSceneDepthRenderbufferWin);
+#ifdef TEST_WIN_HEADLESS
+    WindowDestroyFramebufferWin(&gFramebufferWin, &gColorRenderbufferWin, &gDepthRenderbufferWin);
+#endif // TEST_WIN_HEADLESS
+
+    return size;
+
+#else // TEST_GX2
+
+    u32 size = 0;
+    for (u32 i = 0; i < gNumForegroundBuffers; i++)
+    {
+        size += gForegroundBuffers[i].size;
+        *gForegroundBuffers[i].pData = NULL;
+    }
+
+    // Free everything allocated since WindowInit recorded the state of the heaps
+    // (The render target pool has already freed the tail of MEM1)
+    if (gHeapStatesRecorded)
+    {
+        MEMFreeByStateToFrmHeap(gMEM1HeapHandle, WINDOW_FRM_HEAP_STATE);
+        MEMFreeByStateToFrmHeap(gFgHeapHandle, WINDOW_FRM_HEAP_STATE);
+        gHeapStatesRecorded = false;
+    }
+
+    return size;
+
+#endif // TEST_WIN
+}
+
+// Allocate the buffers freed by WindowFreeForegroundBuffers again, with the plan chosen by WindowInit
+static bool WindowRestoreForegroundBuffers()
+{
+#ifdef TEST_WIN
+
+#ifdef TEST_WIN_HEADLESS
+    if (!WindowCreateFramebufferWin(gFramebufferWidth, gFramebufferHeight, 1, &gFramebufferWin, &gColorRenderbufferWin, &gDepthRenderbufferWin))
+        return false;
+#endif // TEST_WIN_HEADLESS
+
+    if (gSceneFramebufferReleasedWin
+        && !WindowCreateFramebufferWin(gFramebufferWidth, gFramebufferHeight, gFramebufferPlan.samples, &gSceneFramebufferWin,
+                                       &gSceneColorRenderbufferWin, &gSceneDepthRenderbufferWin))
+    {
+        return false;
+    }
+
+    // The viewport and scissor are context state, which was kept
+    WindowMakeContextCurrent();
+    return true;
+
+#else // TEST_GX2
+
+    // Same sizes in the same order as WindowInit, so that there is room for all of them
+    MEMRecordStateForFrmHeap(gMEM1HeapHandle, WINDOW_FRM_HEAP_STATE);
+    MEMRecordStateForFrmHeap(gFgHeapHandle, WINDOW_FRM_HEAP_STATE);
+    gHeapStatesRecorded = true;
+
+    for (u32 i = 0; i < gNumForegroundBuffers; i++)
+    {
+        const WindowForegroundBuffer* buffer = &gForegroundBuffers[i];
+        *buffer->pData = MEMAllocFromFrmHeapEx(buffer->heap, buffer->size, buffer->alignment);
+        if (!*buffer->pData)
+            return false;
+
+        COHERENCY_ALLOC(*buffer->pData, buffer->size);
+
+        GX2Invalidate(GX2_INVALIDATE_MODE_CPU, *buffer->pData, buffer->size);
+    }
+
+    // Point the scan buffers and the surfaces to the new memory
+    GX2SetTVBuffer(gTvScanBuffer, gTvScanBufferSize, WindowFormatGetTVRenderMode(gFramebufferWidth),
+                   GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8, GX2_BUFFERING_MODE_DOUBLE);
+    GX2SetTVScale(gFramebufferWidth, gFramebufferHeight);
+    GX2SetDRCBuffer(gDrcScanBuffer, gDrcScanBufferSize, GX2_DRC_RENDER_MODE_SINGLE,
+                    GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8, GX2_BUFFERING_MODE_DOUBLE);
+    GX2SetDRCScale(854, 480);
+
+    gColorBuffer.surface.image = gColorBufferImageData;
+    gDepthBuffer.surface.image = gDepthBufferImageData;
+
+    if (gColorBufferAuxData)
+    {
+        gColorBuffer.aaBuffer = gColorBufferAuxData;
+        gResolveColorBuffer.surface.image = gResolveColorBufferImageData;
+
+        // The auxiliary buffer must start out in its cleared state again
+        memset(gColorBufferAuxData, WINDOW_AA_BUFFER_CLEAR_VALUE, gColorBufferAuxSize);
+        COHERENCY_CPU_WRITE(gColorBufferAuxData, gColorBufferAuxSize);
+        GX2Invalidate(GX2_INVALIDATE_MODE_CPU, gColorBufferAuxData, gColorBufferAuxSize);
+    }
+
+    // Set the buffers, viewport and scissor for the current render scale
+    GX2SetContextState(gContext);
+    WindowApplyRenderScale(gRenderScale);
+    return true;
+
+#endif // TEST_WIN
+}
+
+// Give back the foreground-only memory before the application goes to the background
+static void WindowReleaseForeground()
 {
+    TraceBegin("WindowReleaseForeground");
+    f64 start = WindowGetTime();
+
+    // Nothing may use the buffers anymore, and the scan buffers must not have a frame left to flip
 #ifdef TEST_WIN
-    return !glfwWindowShouldClose(gWindowHandleWin);
+    glFinish();
 #else
-    // TODO: ProcUI
+    GX2DrawDone();
+#endif
+    WindowVsyncWaitForPendingFlips(0);
+
+    if (gLifecycleCallback)
+        gLifecycleCallback(WINDOW_LIFECYCLE_RELEASE_FOREGROUND, gLifecycleUserData);
+
+    // The frame graph memory is taken from the render target pool
+    WindowGraphReleaseForeground();
+    WindowRenderTargetReleaseForeground();
+    gLifecycleStats.released_bytes = WindowFreeForegroundBuffers();
+
+    gInForeground = false;
+    gReleaseTime = WindowGetTime();
+    gLifecycleStats.releases++;
+    gLifecycleStats.last_release_ms = (gReleaseTime - start) * 1000.0;
+    TraceEnd();
+}
+
+// Allocate the foreground-only memory again when the application is back in the foreground
+// Returns false if it could not be allocated
+static bool WindowAcquireForeground()
+{
+    TraceBegin("WindowAcquireForeground");
+    f64 start = WindowGetTime();
+
+    if (!WindowRestoreForegroundBuffers())
+    {
+        TraceEnd();
+        return false;
+    }
+
+    WindowRenderTargetAcquireForeground();
+    WindowGraphAcquireForeground();
+    gInForeground = true;
+
+    if (gLifecycleCallback)
+        gLifecycleCallback(WINDOW_LIFECYCLE_ACQUIRE_FOREGROUND, gLifecycleUserData);
+
+    // The time spent in the background is neither a late frame nor GPU or CPU time of the next frame
+    gFramePacing.last_flip_time = 0.0;
+    gPacedFlips = WindowVsyncGetCount(WINDOW_VSYNC_EVENT_FLIP);
+    WindowGpuTimerBegin();
+
+    f64 end = WindowGetTime();
+    gFrameWorkStart = end;
+
+    gLifecycleStats.resumes++;
+    gLifecycleStats.last_background_ms = (start - gReleaseTime) * 1000.0;
+    gLifecycleStats.last_resume_ms = (end - start) * 1000.0;
+    if (gLifecycleStats.last_resume_ms > gLifecycleStats.max_resume_ms)
+        gLifecycleStats.max_resume_ms = gLifecycleStats.last_resume_ms;
+
+    TraceEnd();
+    return true;
+}
+
+// Process the pending lifecycle events, and wait in the background until the application is back in
+// the foreground
+// Returns false if the application must exit
+static bool WindowProcessLifecycle()
+{
+    if (gExitRequested)
+        return false;
+
+#ifdef TEST_WIN
+
+    while (gLifecycleQueueCountWin > 0 || !gInForeground)
+    {
+        // A dry queue in the background means the user comes back right away
+        WindowLifecycleEvent event = WINDOW_LIFECYCLE_ACQUIRE_FOREGROUND;
+        if (gLifecycleQueueCountWin > 0)
+        {
+            event = gLifecycleQueueWin[gLifecycleQueueStartWin];
+            gLifecycleQueueStartWin = (gLifecycleQueueStartWin + 1) % WINDOW_LIFECYCLE_QUEUE_SIZE;
+            gLifecycleQueueCountWin--;
+        }
+
+        switch (event)
+        {
+        case WINDOW_LIFECYCLE_RELEASE_FOREGROUND:
+            if (gInForeground)
+                WindowReleaseForeground();
+            break;
+        case WINDOW_LIFECYCLE_ACQUIRE_FOREGROUND:
+            if (!gInForeground && !WindowAcquireForeground())
+                gExitRequested = true;
+            break;
+        case WINDOW_LIFECYCLE_EXIT:
+            gExitRequested = true;
+            break;
+        }
+
+        if (gExitRequested)
+            return false;
+    }
+
     return true;
+
+#else // TEST_GX2
+
+    for (;;)
+    {
+        // Returns right away in the foreground, and blocks in the background until the next message
+        switch (ProcUIProcessMessages(TRUE))
+        {
+        case PROCUI_STATUS_IN_FOREGROUND:
+            if (!gInForeground && !WindowAcquireForeground())
+            {
+                gExitRequested = true;
+                return false;
+            }
+            return true;
+
+        case PROCUI_STATUS_RELEASE_FOREGROUND:
+            if (gInForeground)
+                WindowReleaseForeground();
+
+            // Let the system take the foreground
+            ProcUIDrawDoneRelease();
+            break;
+
+        case PROCUI_STATUS_IN_BACKGROUND:
+            break;
+
+        case PROCUI_STATUS_EXITING:
+            gExitRequested = true;
+            return false;
+        }
+    }
+
+#endif // TEST_WIN
+}
+
+bool WindowIsRunning()
+{
+#ifdef TEST_WIN
+#ifdef TEST_WIN_HEADLESS
+    // A frame limit of 0 means run forever
+    if (gFrameLimitWin != 0 && gFrameCountWin >= gFrameLimitWin)
+        return false;
+#else
+    if (glfwWindowShouldClose(gWindowHandleWin))
+        return false;
+#endif // TEST_WIN_HEADLESS
+#endif // TEST_WIN
+
+    return WindowProcessLifecycle();
+}
+
+void WindowSetLifecycleCallback(WindowLifecycleCallback callback, void* user_data)
+{
+    gLifecycleCallback = callback;
+    gLifecycleUserData = user_data;
+}
+
+void WindowPostLifecycleEvent(WindowLifecycleEvent event)
+{
+#ifdef TEST_WIN
+    if (gLifecycleQueueCountWin == WINDOW_LIFECYCLE_QUEUE_SIZE)
+        return;
+
+    u32 index = (gLifecycleQueueStartWin + gLifecycleQueueCountWin) % WINDOW_LIFECYCLE_QUEUE_SIZE;
+    gLifecycleQueueWin[index] = event;
+    gLifecycleQueueCountWin++;
+#else
+    // ProcUI is the only source of events
+    (void)event;
 #endif
 }
 
+void WindowGetLifecycleStats(WindowLifecycleStats* pStats)
+{
+    *pStats = gLifecycleStats;
+    pStats->in_foreground = gInForeground;
+}
+
 void WindowSwapBuffers()
 {
+    TraceBegin("WindowSwapBuffers");
+
+    // Time the CPU spent on this frame since the previous swap returned
+    f64 work_time = WindowGetTime() - gFrameWorkStart;
+
 #ifdef TEST_WIN
 
+    // Mark the end of the frame's rendering, before the upscale to the window framebuffer
+    WindowGpuTimerEnd();
+
+    // Resolve and upscale the scene to the window framebuffer
+    WindowGpuScopeBegin("Swap");
+    if (gSceneFramebufferWin != GL_NONE)
+        WindowPresentSceneWin();
+    WindowGpuScopeEnd();
+
+    WindowGpuProfilerEndFrame();
+
+#ifdef TEST_WIN_HEADLESS
+
+    // There is nothing to present, so the frame boundary is a fence instead:
+    // Mark the end of this frame's commands, then wait for the oldest frame still in flight
+    // This keeps the CPU at most WINDOW_HEADLESS_FRAMES_IN_FLIGHT frames ahead of the GPU
+    u32 slot = gFrameCountWin % WINDOW_HEADLESS_FRAMES_IN_FLIGHT;
+    gFrameFenceWin[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    u32 oldest = (gFrameCountWin + 1) % WINDOW_HEADLESS_FRAMES_IN_FLIGHT;
+    if (gFrameFenceWin[oldest])
+    {
+        TraceBegin("Wait for GPU");
+        while (glClientWaitSync(gFrameFenceWin[oldest], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            continue;
+
+        TraceEnd();
+
+        glDeleteSync(gFrameFenceWin[oldest]);
+        gFrameFenceWin[oldest] = NULL;
+    }
+
+    gFrameCountWin++;
+
+    // There is no display, so the frame counts as flipped right away
+    WindowVsyncSwapDone(false);
+
+#else
+
+    // The driver queues the frame and returns: it only blocks when all of its buffers are in use
+    TraceBegin("glfwSwapBuffers");
     glfwSwapBuffers(gWindowHandleWin);
+    TraceEnd();
+    WindowVsyncSwapDone(gFramePacing.interval > 0);
     glfwPollEvents();
 
+#endif // TEST_WIN_HEADLESS
+
 #else
 
+    WindowGpuScopeBegin("Swap");
+
+    // Resolve the samples of a multisampled color buffer, which can't be copied to the scan buffers as is
+    GX2ColorBuffer* scan_source = &gColorBuffer;
+    if (gColorBufferAuxData)
+    {
+        GX2ResolveAAColorBuffer(&gColorBuffer, &gResolveColorBuffer.surface, 0, 0);
+        scan_source = &gResolveColorBuffer;
+    }
+
+    // Mark the end of the frame's rendering, before the copy to the scan buffers
+    WindowGpuTimerEnd();
+
     // Make sure to flush all commands to GPU before copying the color buffer to the scan buffers
     // (Calling GX2DrawDone instead here causes slow downs)
     GX2Flush();
 
+    // If the previous frame has not been flipped yet, the scan buffers hold it and the frame on screen:
+    // wait for the flip to make room for this frame
+    // This is the only place the CPU waits for the display, and only once it is a full frame ahead
+    WindowVsyncWaitForPendingFlips(WINDOW_VSYNC_MAX_PENDING_FLIPS - 1);
+
     // Copy the color buffer to the TV and DRC scan buffers
-    GX2CopyColorBufferToScanBuffer(&gColorBuffer, GX2_SCAN_TARGET_TV);
-    GX2CopyColorBufferToScanBuffer(&gColorBuffer, GX2_SCAN_TARGET_DRC);
+    GX2CopyColorBufferToScanBuffer(scan_source, GX2_SCAN_TARGET_TV);
+    GX2CopyColorBufferToScanBuffer(scan_source, GX2_SCAN_TARGET_DRC);
+
+    WindowGpuScopeEnd();
+    WindowGpuProfilerEndFrame();
+
     // Flip
     GX2SwapScanBuffers();
 
     // Reset context state for next frame
     GX2SetContextState(gContext);
 
-    // Flush all commands to GPU before GX2WaitForFlip since it will block the CPU
+    // Flush all commands to GPU, so that it works on them while the CPU starts on the next frame
     GX2Flush();
 
     // Make sure TV and DRC are enabled
     GX2SetTVEnable(true);
     GX2SetDRCEnable(true);
 
-    // Wait until swapping is done
-    GX2WaitForFlip();
+    // The flip happens on a later vsync, without waiting for it here: the flip event counts it
 
 #endif
+
+    // Detect late frames from the flips that happened since the previous swap, and adapt the swap
+    // interval if enabled
+    u32 swap_interval = gFramePacing.interval;
+    u32 flips = WindowVsyncGetCount(WINDOW_VSYNC_EVENT_FLIP);
+    while (gPacedFlips != flips)
+    {
+        f64 flip_time;
+        gPacedFlips++;
+        if (WindowVsyncGetFlipTime(gPacedFlips, &flip_time))
+            FramePacingUpdate(&gFramePacing, flip_time, 0, work_time);
+    }
+
+    if (gFramePacing.interval != swap_interval)
+        WindowApplySwapInterval(gFramePacing.interval);
+
+    // GPU time of the oldest frame being timed
+    f32 gpu_time_scale;
+    f64 gpu_time = WindowGpuTimerRead(&gpu_time_scale);
+    if (gpu_time > 0.0)
+        gGpuFrameTime = gpu_time;
+
+    // Whole time of the frame, including the waits for the GPU
+    gSwapFrameTime = WindowGetTime() - gFrameWorkStart;
+
+    // Adjust the render scale for the next frame, always from the same measure: the GPU time of the
+    // frames, or their whole time if the GPU timer is not usable
+    // (Frames whose GPU time is not known yet, or was measured before the last change of scale, are skipped)
+    if (gDynamicResolutionEnabled)
+    {
+        f64 frame_time = gGpuTimerUsable ? (gpu_time_scale == gRenderScale ? gpu_time : 0.0) : gSwapFrameTime;
+        if (frame_time > 0.0)
+        {
+            f32 scale = DynamicResolutionUpdate(&gDynamicResolution, frame_time);
+            if (scale != gRenderScale)
+                WindowApplyRenderScale(scale);
+        }
+    }
+
+    WindowGpuTimerBegin();
+
+    gFrameWorkStart = WindowGetTime();
+
+    TraceEnd();
 }
 
 void WindowExit()
 {
+    WindowGpuProfilerExit();
+
+    // Let the last frame queued flip before the scan buffers are freed
+    WindowVsyncWaitForPendingFlips(0);
+    WindowVsyncExit();
+
 #ifdef TEST_WIN
+    // Before the context is destroyed (WindowExit may also be called before they were created)
+    if (gGpuTimerQueriesWin[0][0] != GL_NONE)
+    {
+        glDeleteQueries(WINDOW_GPU_TIMER_FRAMES * 2, &gGpuTimerQueriesWin[0][0]);
+        memset(gGpuTimerQueriesWin, 0, sizeof(gGpuTimerQueriesWin));
+    }
+
+#ifdef TEST_WIN_HEADLESS
+    if (gFrameCountWin > 0)
+    {
+        f64 elapsed = WindowGetTime() - gStartTimeWin;
+        printf("Headless: %u frames in %.3f s (%.1f fps)\n",
+               gFrameCountWin, elapsed, elapsed > 0.0 ? gFrameCountWin / elapsed : 0.0);
+        gFrameCountWin = 0;
+    }
+
+    if (gContextWin != EGL_NO_CONTEXT)
+    {
+        for (u32 i = 0; i < WINDOW_HEADLESS_FRAMES_IN_FLIGHT; i++)
+        {
+            if (gFrameFenceWin[i])
+            {
+                glDeleteSync(gFrameFenceWin[i]);
+                gFrameFenceWin[i] = NULL;
+            }
+        }
+
+        WindowDestroyFramebufferWin(&gResolveFramebufferWin, &gResolveColorRenderbufferWin, NULL);
+        WindowDestroyFramebufferWin(&gSceneFramebufferWin, &gSceneColorRenderbufferWin, &gSceneDepthRenderbufferWin);
+        WindowDestroyFramebufferWin(&gFramebufferWin, &gColorRenderbufferWin, &gDepthRenderbufferWin);
+
+        eglMakeCurrent(gDisplayWin, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(gDisplayWin, gContextWin);
+        gContextWin = EGL_NO_CONTEXT;
+    }
+
+    if (gSurfaceWin != EGL_NO_SURFACE)
+    {
+        eglDestroySurface(gDisplayWin, gSurfaceWin);
+        gSurfaceWin = EGL_NO_SURFACE;
+    }
+
+    if (gDisplayWin != EGL_NO_DISPLAY)
+    {
+        eglTerminate(gDisplayWin);
+        gDisplayWin = EGL_NO_DISPLAY;
+    }
+#else
     glfwTerminate();
+#endif // TEST_WIN_HEADLESS
 #else
-    // TODO: There is currently no way to exit the application until I implement ProcUI
+    if (gCmdlist)
+    {
+        // The GPU must be done with all buffers before they are freed
+        GX2DrawDone();
+        GX2SetTVEnable(FALSE);
+        GX2SetDRCEnable(FALSE);
+
+        // Buffers in MEM2 (the window buffers in MEM1 are freed with the scan buffers below)
+        if (gFramebufferPlan.color_memory == WINDOW_MEMORY_MEM2)
+        {
+            if (gColorBufferImageData)
+                MEMFreeToDefaultHeap(gColorBufferImageData);
+            if (gColorBufferAuxData)
+                MEMFreeToDefaultHeap(gColorBufferAuxData);
+            if (gResolveColorBufferImageData)
+                MEMFreeToDefaultHeap(gResolveColorBufferImageData);
+        }
+
+        if (gFramebufferPlan.depth_memory == WINDOW_MEMORY_MEM2 && gDepthBufferImageData)
+            MEMFreeToDefaultHeap(gDepthBufferImageData);
+
+        gColorBufferImageData = NULL;
+        gColorBufferAuxData = NULL;
+        gResolveColorBufferImageData = NULL;
+        gDepthBufferImageData = NULL;
+
+        // Everything in MEM1 and the Foreground bucket (if the foreground has not been released)
+        WindowFreeForegroundBuffers();
+        gNumForegroundBuffers = 0;
+
+        if (gContext)
+        {
+            MEMFreeToDefaultHeap(gContext);
+            gContext = NULL;
+        }
+
+        GX2Shutdown();
+
+        MEMFreeToDefaultHeap(gCmdlist);
+        gCmdlist = NULL;
+    }
+
+    if (gOwnsProcUI)
+    {
+        ProcUIShutdown();
+        gOwnsProcUI = false;
+    }
 #endif
+
+    gInForeground = false;
+    gInitialized = false;
 }
 
 #ifdef TEST_GX2
@@ -450,3 +1884,19 @@ GX2DepthBuffer* WindowGetDepthBuffer()
 }
 
 #endif
+
+#ifdef TEST_WIN
+
+u32 WindowGetFramebuffer()
+{
+    if (gSceneFramebufferWin != GL_NONE)
+        return gSceneFramebufferWin;
+
+#ifdef TEST_WIN_HEADLESS
+    return gFramebufferWin;
+#else
+    return 0;
+#endif // TEST_WIN_HEADLESS
+}
+
+#endif // TEST_WIN
@@ -1,4 +1,6 @@
 // Windowing library built on GX2 with basic operations inspired by glfw
+// On PC (TEST_WIN), it is built on GLFW, or on EGL if TEST_WIN_HEADLESS is also defined
+// (Headless mode renders off-screen into an FBO of the requested size, with no window or vsync)
 
 #ifndef WINDOW_H_
 #define WINDOW_H_
@@ -10,7 +12,105 @@ extern "C"
 {
 #endif // __cplusplus
 
+// Formats of the window buffers and render targets
+typedef enum WindowRenderTargetFormat
+{
+    WINDOW_RT_FORMAT_RGBA8,     // 8-bit unsigned normalized RGBA
+    WINDOW_RT_FORMAT_RGB10_A2,  // 10-bit unsigned normalized RGB, 2-bit alpha
+    WINDOW_RT_FORMAT_RGBA16F,   // 16-bit float RGBA
+    WINDOW_RT_FORMAT_R32F,      // 32-bit float red
+    WINDOW_RT_FORMAT_D32F,      // 32-bit float depth
+    WINDOW_RT_FORMAT_D24S8,     // 24-bit depth with 8-bit stencil
+    WINDOW_RT_FORMAT_D16,       // 16-bit depth
+    WINDOW_RT_FORMAT_COUNT
+} WindowRenderTargetFormat;
+
+// Formats of textures
+// Compressed formats store blocks of 4x4 pixels
+typedef enum WindowTextureFormat
+{
+    WINDOW_TEXTURE_FORMAT_RGBA8,    // 8-bit unsigned normalized RGBA
+    WINDOW_TEXTURE_FORMAT_BC1,      // RGB with 1-bit alpha, 8 bytes per block (DXT1)
+    WINDOW_TEXTURE_FORMAT_BC3,      // RGBA, 16 bytes per block (DXT5)
+    WINDOW_TEXTURE_FORMAT_BC4,      // Red, 8 bytes per block (RGTC1)
+    WINDOW_TEXTURE_FORMAT_BC5,      // Red and green, 16 bytes per block (RGTC2)
+    WINDOW_TEXTURE_FORMAT_COUNT
+} WindowTextureFormat;
+
+// Window hints (set before WindowInit, like glfwWindowHint)
+typedef enum WindowHintType
+{
+    WINDOW_HINT_COLOR_FORMAT,   // Color buffer format: RGBA8 (default), RGB10_A2 or RGBA16F
+    WINDOW_HINT_DEPTH_FORMAT,   // Depth buffer format: D32F (default), D24S8 or D16
+    WINDOW_HINT_SAMPLES,        // Number of samples per pixel (MSAA): 1 (default), 2, 4 or 8
+    WINDOW_HINT_MEM1_BUDGET,    // Bytes of MEM1 the window buffers may use (default 0: all of MEM1)
+    WINDOW_HINT_DOWNGRADE       // WINDOW_DOWNGRADE_* flags (default 0: never change the requested formats)
+} WindowHintType;
+
+// Flags of WINDOW_HINT_DOWNGRADE
+// If the buffers do not all fit in the MEM1 budget, these allow the planner to lower the
+// quality of the buffers (in this order) until they do, instead of placing some of them in MEM2
+#define WINDOW_DOWNGRADE_SAMPLES 0x1 // Allow fewer samples per pixel (halved at each step)
+#define WINDOW_DOWNGRADE_DEPTH   0x2 // Allow a 16-bit depth buffer
+#define WINDOW_DOWNGRADE_COLOR   0x4 // Allow a 32-bit color buffer instead of RGBA16F
+
+// Set a window hint
+// Parameters:
+// - hint: The hint to set
+// - value: The new value of the hint
+void WindowHint(WindowHintType hint, u32 value);
+
+// Reset all window hints to their default values
+void WindowDefaultHints();
+
+// Memory a buffer is placed in
+typedef enum WindowMemory
+{
+    WINDOW_MEMORY_MEM1,         // Fast embedded memory (32 MB)
+    WINDOW_MEMORY_MEM2          // Main memory
+} WindowMemory;
+
+// Memory layout of the window buffers
+// On PC, sizes are estimates of what the same layout would take on Wii U
+typedef struct WindowFramebufferPlan
+{
+    u32 width;                  // Framebuffer size
+    u32 height;
+    WindowRenderTargetFormat color_format;
+    WindowRenderTargetFormat depth_format;
+    u32 samples;                // Number of samples per pixel
+    WindowMemory color_memory;  // Memory the color buffer is placed in
+    WindowMemory depth_memory;  // Memory the depth buffer is placed in
+    u32 color_size;             // Bytes of the color buffer (including its AA and resolve buffers)
+    u32 depth_size;             // Bytes of the depth buffer
+    u32 scan_buffers_size;      // Bytes of the TV and DRC scan buffers (Foreground bucket, Wii U)
+    u32 mem1_budget;            // Bytes of MEM1 the window buffers may use
+    u32 mem1_used;              // Bytes of MEM1 used by the window buffers
+    u32 mem2_used;              // Bytes of MEM2 used by the window buffers
+    u32 traffic_cost;           // Estimated memory traffic of a frame in KB, with MEM2 traffic weighted
+                                // by its lower bandwidth (used to pick the cheapest layout)
+    bool downgraded;            // Whether the formats or number of samples differ from the requested ones
+} WindowFramebufferPlan;
+
+// Plan the memory layout of the window buffers, without allocating anything
+// WindowInit uses the same planner with the current window hints
+// On Wii U, GX2 must be initialized (e.g. by WindowInit) since it calculates the buffer sizes
+// Parameters:
+// - width, height: The desired size (as passed to WindowInit)
+// - pPlan: Output plan
+// Returns false if the window hints are invalid
+bool WindowPlanFramebuffer(u32 width, u32 height, WindowFramebufferPlan* pPlan);
+
+// Print a plan (to stdout on PC, to the system log on Wii U)
+void WindowPrintFramebufferPlan(const WindowFramebufferPlan* pPlan);
+
+// Get the plan WindowInit used for the window buffers
+void WindowGetFramebufferPlan(WindowFramebufferPlan* pPlan);
+
 // Initialize the window
+// The buffer formats and their placement are chosen by WindowPlanFramebuffer from the window hints
+// With more than one sample per pixel, the color buffer is resolved to a single-sample buffer when
+// swapping (GX2ResolveAAColorBuffer on Wii U, a framebuffer blit on PC)
 // Parameters:
 // - width: The desired width.
 // - height: The desired height.
@@ -29,14 +129,147 @@ void WindowMakeContextCurrent();
 // - swap_interval: The swap interval is this value divided by the refresh rate (59.94 Hz on Wii U)
 //                  e.g. a value of 2 will give a swap interval of 2 / 59.94 = ~33 ms on Wii U
 //                  A value of 0 means swapping should happen as quickly as possible (For GLFW)
+// If adaptive swap interval is enabled, this is the preferred value (see WindowSetAdaptiveSwapInterval)
 void WindowSetSwapInterval(u32 swap_interval);
 
+// Enable or disable adaptive swap interval (disabled by default)
+// When enabled, repeated late frames (frames that missed their vblank) double the swap interval so that
+// pacing stays even (e.g. a steady 30 fps instead of juddering between 60 and 30 fps), and the
+// requested swap interval is restored once frames have consistently fit in it for long enough
+void WindowSetAdaptiveSwapInterval(bool enable);
+
+// Frame pacing statistics
+typedef struct WindowFrameStats
+{
+    u64 frames;            // Number of frames presented
+    u64 late_frames;       // Number of frames that stayed on screen longer than the swap interval
+    u64 missed_vblanks;    // Total number of refreshes lost to late frames
+    u32 swap_interval;     // Swap interval currently in use
+    u32 interval_switches; // Number of times the adaptive swap interval changed the swap interval
+    f64 last_frame_ms;     // Time between the last two flips, in milliseconds
+    f64 avg_frame_ms;      // Average time between flips, in milliseconds
+    f64 refresh_ms;        // Duration of one display refresh in milliseconds (0 if there is no display)
+    f64 gpu_frame_ms;      // GPU time of the last measured frame in milliseconds (0 if not measured yet)
+    f64 swap_frame_ms;     // Time between the ends of the last two swaps in milliseconds (CPU work, and waits for the GPU and the display)
+    bool gpu_timer;        // Whether the GPU timer is usable (checked once by WindowInit)
+                           // If not, gpu_frame_ms stays 0 and dynamic resolution uses swap_frame_ms instead
+    f32 render_scale;      // Render scale currently in use (see WindowSetRenderScale)
+    u32 scale_changes;     // Number of times dynamic resolution changed the render scale
+} WindowFrameStats;
+
+// Get the frame pacing statistics
+// Parameters:
+// - pStats: Output statistics
+void WindowGetFrameStats(WindowFrameStats* pStats);
+
+// Get the size of the window framebuffer
+// Parameters:
+// - pWidth, pHeight: Output size, as returned by WindowInit
+void WindowGetFramebufferSize(u32* pWidth, u32* pHeight);
+
+// Set the render scale (1.0 by default)
+// The scene is rendered at this fraction of the framebuffer width and height, then upscaled to the
+// framebuffer size when swapping (by the scan buffer copy on Wii U, and by a framebuffer blit on PC)
+// The render size is rounded down to a multiple of 8 pixels when the scale is below 1.0
+// Parameters:
+// - scale: The new render scale, between 0.25 and 1.0
+void WindowSetRenderScale(f32 scale);
+
+// Get the render scale currently in use
+f32 WindowGetRenderScale();
+
+// Get the size the scene is rendered at (the framebuffer size multiplied by the render scale)
+// This is what the default viewport and scissor cover
+// Parameters:
+// - pWidth, pHeight: Output size
+void WindowGetRenderSize(u32* pWidth, u32* pHeight);
+
+// Enable or disable dynamic resolution (disabled by default)
+// When enabled, the render scale is adjusted after every swap from the measured GPU time of the
+// frames (or the whole time between swaps if the GPU timer is not usable, see WindowFrameStats::gpu_timer),
+// so that frames stay within the target time
+// Disabling it goes back to full resolution
+// Parameters:
+// - enable: Whether to enable dynamic resolution
+// - min_scale: Lowest render scale allowed (e.g. 0.5)
+// - target_ms: Frame time to stay within, in milliseconds
+//              A value of 0 means the duration of the swap interval (16.7 ms if there is no display)
+void WindowSetDynamicResolution(bool enable, f32 min_scale, f64 target_ms);
+
+// Get the time in seconds since an arbitrary point (e.g. for measuring frame times)
+f64 WindowGetTime();
+
+// Whether textures of a format can be created (call after WindowInit)
+// The Wii U supports every format; on PC, BC1 and BC3 need GL_EXT_texture_compression_s3tc
+// (BC4 and BC5 are core since OpenGL 3.0)
+bool WindowIsTextureFormatSupported(WindowTextureFormat format);
+
 // Function to determine whether the program should continue running or exit
+// It also processes the lifecycle events (see WindowLifecycleEvent): while the application is in the
+// background, it blocks until the application is back in the foreground or must exit
+// In headless mode, it returns false once the number of frames in the TEST_HEADLESS_FRAMES
+// environment variable has been rendered (if set)
 bool WindowIsRunning();
 
+// Application lifecycle events
+// - Wii U: ProcUI messages (e.g. the HOME Menu being opened and closed, or the application being closed)
+// - PC: simulated events queued with WindowPostLifecycleEvent, so that the same paths can be tested
+// When the application releases the foreground, the window buffers placed in MEM1 and the Foreground
+// bucket (the scan buffers, and the color and depth buffers if planned in MEM1) are given back, along
+// with the MEM1 memory of the render target pool. When it acquires the foreground again, they are
+// allocated again with the same plan, without a full WindowInit (their contents are lost)
+// On PC, the framebuffer objects of the window are deleted and created again instead
+typedef enum WindowLifecycleEvent
+{
+    WINDOW_LIFECYCLE_RELEASE_FOREGROUND, // The application goes to the background
+    WINDOW_LIFECYCLE_ACQUIRE_FOREGROUND, // The application is back in the foreground
+    WINDOW_LIFECYCLE_EXIT                // The application must exit (WindowIsRunning returns false)
+} WindowLifecycleEvent;
+
+// Function called when the application releases or acquires the foreground
+// On release, it is called with the GPU idle and before the window buffers are freed: the application
+// must free its own MEM1 and Foreground bucket allocations
+// On acquire, it is called once the window buffers have been allocated again
+// Parameters:
+// - event: WINDOW_LIFECYCLE_RELEASE_FOREGROUND or WINDOW_LIFECYCLE_ACQUIRE_FOREGROUND
+// - user_data: Pointer passed to WindowSetLifecycleCallback
+typedef void (*WindowLifecycleCallback)(WindowLifecycleEvent event, void* user_data);
+
+// Set the function called when the application releases or acquires the foreground (NULL for none)
+void WindowSetLifecycleCallback(WindowLifecycleCallback callback, void* user_data);
+
+// Queue a simulated lifecycle event, processed by the next call to WindowIsRunning (PC)
+// If the application is still in the background once the queue is empty, it acquires the foreground
+// again (as if the user came back to it right away)
+// On Wii U, events come from ProcUI and this function does nothing
+void WindowPostLifecycleEvent(WindowLifecycleEvent event);
+
+// Lifecycle statistics
+typedef struct WindowLifecycleStats
+{
+    bool in_foreground;    // Whether the application is in the foreground
+    u32 releases;          // Number of times the foreground was released
+    u32 resumes;           // Number of times the foreground was acquired back
+    u32 released_bytes;    // Bytes of MEM1 and Foreground bucket given back at the last release
+                           // (On PC, what the window buffers would take on Wii U)
+    f64 last_release_ms;   // Time taken by the last release, in milliseconds
+    f64 last_resume_ms;    // Time taken by the last acquire until the application could render again
+    f64 max_resume_ms;     // Longest resume
+    f64 last_background_ms; // Time spent in the background before the last resume
+} WindowLifecycleStats;
+
+// Get the lifecycle statistics
+// Parameters:
+// - pStats: Output statistics
+void WindowGetLifecycleStats(WindowLifecycleStats* pStats);
+
 // Swap the front and back buffers
-// This function will perform a GPU flush and block until swapping is done
+// This function will perform a GPU flush and queue the flip, without waiting for it to happen: it only
+// blocks if the previous frame has not been flipped yet (on PC, if the driver has no free buffer)
+// (see vsync.h to be woken by the display)
 // For Wii U, TV output is automatically duplicated to the Gamepad
+// In headless mode, there is nothing to swap; the frame boundary is a fence instead and
+// this function only blocks if the GPU falls more than 2 frames behind
 void WindowSwapBuffers();
 
 // Function to be called by user at application exit to free resources allocated by this library
@@ -44,6 +277,7 @@ void WindowExit();
 
 #ifdef TEST_GX2
 
+#include <gx2/shaders.h>
 #include <gx2/surface.h>
 
 GX2ColorBuffer* WindowGetColorBuffer();
@@ -51,6 +285,53 @@ GX2DepthBuffer* WindowGetDepthBuffer();
 
 #endif // TEST_GX2
 
+#ifdef TEST_WIN
+
+// Get the framebuffer object to render the scene into (0 for the default framebuffer)
+// Once the render scale has been changed, this is an off-screen framebuffer of the render size
+u32 WindowGetFramebuffer();
+
+#endif // TEST_WIN
+
+// Set of shaders to draw with
+// (Used by the modules built on top of this library to refer to shaders in a backend-neutral way)
+typedef struct WindowShaderSet
+{
+#ifdef TEST_WIN
+    u32 program;                         // Linked shader program object
+#else
+    const GX2FetchShader* fetch_shader;  // Fetch shader
+    const GX2VertexShader* vertex_shader;
+    const GX2PixelShader* pixel_shader;
+#endif // TEST_WIN
+} WindowShaderSet;
+
+// Vertex input to draw with
+typedef struct WindowVertexInput
+{
+#ifdef TEST_WIN
+    u32 vertex_array;                    // VAO (holds the attribute buffers and their layout)
+#else
+    u32 slot;                            // Attribute buffer slot
+    u32 size;                            // Size of the buffer data
+    u32 stride;                          // Size of each vertex
+    const void* data;                    // Buffer data
+#endif // TEST_WIN
+} WindowVertexInput;
+
+// How shaders get their uniforms
+typedef enum WindowShaderMode
+{
+    WINDOW_SHADER_MODE_UNIFORM_REGISTER,  // Uniforms are written into registers for each draw
+    WINDOW_SHADER_MODE_UNIFORM_BLOCK      // Uniforms are read from blocks in memory (see uniform_buffer.h)
+} WindowShaderMode;
+
+// Set the shader mode (WINDOW_SHADER_MODE_UNIFORM_REGISTER by default)
+// On Wii U, this also sets the GPR and stack partition of the shader stages (see shader_mode.h);
+// shaders must have been compiled for the mode in use
+// On PC, both kinds of uniforms are always available, so this has no effect
+void WindowSetShaderMode(WindowShaderMode mode);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus